@@ -761,8 +761,8 @@ def section_tunables(*_):
 def section_vdev(kstats_dict):
     """Collect information on VDEV caches"""
 
-    # Currently [Nov 2017] the VDEV cache is disabled, because it is actually
-    # harmful. When this is the case, we just skip the whole entry. See
+    # The VDEV cache can be disabled by setting zfs_vdev_cache_size to zero.
+    # When this is the case, we just skip the whole entry. See
     # https://github.com/zfsonlinux/zfs/blob/master/module/zfs/vdev_cache.c
     # for details
     tunables = get_spl_tunables(TUNABLES_PATH)
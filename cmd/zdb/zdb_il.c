@@ -220,6 +220,16 @@ zil_prt_rec_truncate(zilog_t *zilog, int txtype, void *arg)
 	    (u_longlong_t)lr->lr_length);
 }
 
+/* ARGSUSED */
+static void
+zil_prt_rec_batch(zilog_t *zilog, int txtype, void *arg)
+{
+	lr_batch_t *lr = arg;
+
+	(void) printf("%sstart %llu, end %llu\n", tab_prefix,
+	    (u_longlong_t)lr->lr_start, (u_longlong_t)lr->lr_end);
+}
+
 /* ARGSUSED */
 static void
 zil_prt_rec_setattr(zilog_t *zilog, int txtype, void *arg)
@@ -305,6 +315,7 @@ static zil_rec_info_t zil_rec_info[TX_MAX_TYPE] = {
 	{.zri_print = zil_prt_rec_create,   .zri_name = "TX_MKDIR_ATTR      "},
 	{.zri_print = zil_prt_rec_create,   .zri_name = "TX_MKDIR_ACL_ATTR  "},
 	{.zri_print = zil_prt_rec_write,    .zri_name = "TX_WRITE2          "},
+	{.zri_print = zil_prt_rec_batch,    .zri_name = "TX_BATCH           "},
 };
 
 /* ARGSUSED */
@@ -400,10 +411,17 @@ void
 dump_intent_log(zilog_t *zilog)
 {
 	const zil_header_t *zh = zilog->zl_header;
+	const zil_chain_head_t *zch = zilog->zl_chain_heads;
 	int verbose = MAX(dump_opt['d'], dump_opt['i']);
+	boolean_t hole = BP_IS_HOLE(&zh->zh_log);
 	int i;
 
-	if (BP_IS_HOLE(&zh->zh_log) || verbose < 1)
+	for (i = 0; zch != NULL && i < ZIL_MAX_CHAINS - 1; i++) {
+		if (!BP_IS_HOLE(&zch[i].zch_log))
+			hole = B_FALSE;
+	}
+
+	if (hole || verbose < 1)
 		return;
 
 	(void) printf("\n    ZIL header: claim_txg %llu, "
@@ -414,6 +432,19 @@ dump_intent_log(zilog_t *zilog)
 	(void) printf(" replay_seq %llu, flags 0x%llx\n",
 	    (u_longlong_t)zh->zh_replay_seq, (u_longlong_t)zh->zh_flags);
 
+	if (zh->zh_flags & ZIL_MULTI_CHAIN) {
+		(void) printf("    ZIL batch_seq %llu\n",
+		    (u_longlong_t)zh->zh_batch_seq);
+	}
+	for (i = 0; zch != NULL && i < ZIL_MAX_CHAINS - 1; i++) {
+		if (BP_IS_HOLE(&zch[i].zch_log))
+			continue;
+		(void) printf("    ZIL chain %d: claim_blk_seq %llu, "
+		    "claim_lr_seq %llu\n", i + 1,
+		    (u_longlong_t)zch[i].zch_claim_blk_seq,
+		    (u_longlong_t)zch[i].zch_claim_lr_seq);
+	}
+
 	for (i = 0; i < TX_MAX_TYPE; i++)
 		zil_rec_info[i].zri_count = 0;
 
@@ -97,6 +97,7 @@ static int zpool_do_replace(int, char **);
 static int zpool_do_split(int, char **);
 
 static int zpool_do_scrub(int, char **);
+static int zpool_do_trim(int, char **);
 
 static int zpool_do_import(int, char **);
 static int zpool_do_export(int, char **);
@@ -150,6 +151,7 @@ typedef enum {
 	HELP_REMOVE,
 	HELP_SCRUB,
 	HELP_STATUS,
+	HELP_TRIM,
 	HELP_UPGRADE,
 	HELP_EVENTS,
 	HELP_GET,
@@ -170,6 +172,8 @@ enum iostat_type {
 	IOS_QUEUES = 2,
 	IOS_L_HISTO = 3,
 	IOS_RQ_HISTO = 4,
+	IOS_WEIGHT = 5,
+	IOS_ZIL_HISTO = 6,
 	IOS_COUNT,	/* always last element */
 };
 
@@ -179,9 +183,11 @@ enum iostat_type {
 #define	IOS_QUEUES_M	(1ULL << IOS_QUEUES)
 #define	IOS_L_HISTO_M	(1ULL << IOS_L_HISTO)
 #define	IOS_RQ_HISTO_M	(1ULL << IOS_RQ_HISTO)
+#define	IOS_WEIGHT_M	(1ULL << IOS_WEIGHT)
+#define	IOS_ZIL_HISTO_M	(1ULL << IOS_ZIL_HISTO)
 
 /* Mask of all the histo bits */
-#define	IOS_ANYHISTO_M (IOS_L_HISTO_M | IOS_RQ_HISTO_M)
+#define	IOS_ANYHISTO_M (IOS_L_HISTO_M | IOS_RQ_HISTO_M | IOS_ZIL_HISTO_M)
 
 /*
  * Lookup table for iostat flags to nvlist names.  Basically a list
@@ -225,6 +231,13 @@ static const char *vsx_type_to_nvlist[IOS_COUNT][11] = {
 	    ZPOOL_CONFIG_VDEV_IND_SCRUB_HISTO,
 	    ZPOOL_CONFIG_VDEV_AGG_SCRUB_HISTO,
 	    NULL},
+	[IOS_ZIL_HISTO] = {
+	    ZPOOL_CONFIG_ZIL_COMMIT_LAT_HISTO,
+	    ZPOOL_CONFIG_ZIL_GATHER_LAT_HISTO,
+	    ZPOOL_CONFIG_ZIL_ISSUE_LAT_HISTO,
+	    ZPOOL_CONFIG_ZIL_WAIT_LAT_HISTO,
+	    ZPOOL_CONFIG_ZIL_FLUSH_LAT_HISTO,
+	    NULL},
 };
 
 
@@ -276,6 +289,7 @@ static zpool_command_t command_table[] = {
 	{ "split",	zpool_do_split,		HELP_SPLIT		},
 	{ NULL },
 	{ "scrub",	zpool_do_scrub,		HELP_SCRUB		},
+	{ "trim",	zpool_do_trim,		HELP_TRIM		},
 	{ NULL },
 	{ "import",	zpool_do_import,	HELP_IMPORT		},
 	{ "export",	zpool_do_export,	HELP_EXPORT		},
@@ -336,7 +350,7 @@ get_usage(zpool_help_t idx)
 		    "\t    [--rewind-to-checkpoint] <pool | id> [newpool]\n"));
 	case HELP_IOSTAT:
 		return (gettext("\tiostat [[[-c [script1,script2,...]"
-		    "[-lq]]|[-rw]] [-T d | u] [-ghHLpPvy]\n"
+		    "[-lq]]|[-rwz]] [-T d | u] [-ghHLpPvy]\n"
 		    "\t    [[pool ...]|[pool vdev ...]|[vdev ...]]"
 		    " [interval [count]]\n"));
 	case HELP_LABELCLEAR:
@@ -362,6 +376,9 @@ get_usage(zpool_help_t idx)
 		return (gettext("\tstatus [-c [script1,script2,...]] [-gLPvxD]"
 		    "[-T d|u] [pool] ... \n"
 		    "\t    [interval [count]]\n"));
+	case HELP_TRIM:
+		return (gettext("\ttrim [-c | -s] [-r <rate>] <pool> "
+		    "[<device> ...]\n"));
 	case HELP_UPGRADE:
 		return (gettext("\tupgrade\n"
 		    "\tupgrade -v\n"
@@ -1735,6 +1752,60 @@ zpool_print_cmd(vdev_cmd_data_list_t *vcdl, const char *pool, char *path)
 	}
 }
 
+/*
+ * Print the state of the manual trim of a vdev.  Progress is reported on
+ * the top-level vdevs, leaves only note when they do not support trim.
+ */
+static void
+print_trim_status(vdev_stat_t *vs, uint_t vsc, boolean_t isleaf)
+{
+	char tbuf[256], rbuf[6];
+	time_t t;
+
+	/* Older kernel modules don't report trim state */
+	if (vsc < (offsetof(vdev_stat_t, vs_trim_notsup) +
+	    sizeof (vs->vs_trim_notsup)) / sizeof (uint64_t))
+		return;
+
+	if (vs->vs_trim_state == VDEV_TRIM_NONE ||
+	    vs->vs_trim_state == VDEV_TRIM_CANCELED)
+		return;
+
+	if (isleaf && vs->vs_trim_notsup) {
+		(void) printf(gettext("  (trim unsupported)"));
+		return;
+	}
+
+	if (vs->vs_trim_action_time == 0)
+		return;
+
+	t = vs->vs_trim_action_time;
+	(void) strftime(tbuf, sizeof (tbuf), "%c", localtime(&t));
+
+	if (vs->vs_trim_state == VDEV_TRIM_COMPLETE) {
+		(void) printf(gettext("  (trimmed, completed at %s)"), tbuf);
+		return;
+	}
+
+	uint64_t pct = 0;
+	if (vs->vs_trim_bytes_est != 0) {
+		pct = MIN(100, vs->vs_trim_bytes_done * 100 /
+		    vs->vs_trim_bytes_est);
+	}
+
+	if (vs->vs_trim_state == VDEV_TRIM_SUSPENDED) {
+		(void) printf(gettext("  (%llu%% trimmed, suspended at %s)"),
+		    (u_longlong_t)pct, tbuf);
+	} else if (vs->vs_trim_rate != 0) {
+		zfs_nicebytes(vs->vs_trim_rate, rbuf, sizeof (rbuf));
+		(void) printf(gettext("  (%llu%% trimmed, at %s/s, "
+		    "started at %s)"), (u_longlong_t)pct, rbuf, tbuf);
+	} else {
+		(void) printf(gettext("  (%llu%% trimmed, started at %s)"),
+		    (u_longlong_t)pct, tbuf);
+	}
+}
+
 /*
  * Print out configuration state as requested by status_callback.
  */
@@ -1743,7 +1814,7 @@ print_status_config(zpool_handle_t *zhp, status_cbdata_t *cb, const char *name,
     nvlist_t *nv, int depth, boolean_t isspare)
 {
 	nvlist_t **child;
-	uint_t c, children;
+	uint_t c, vsc, children;
 	pool_scan_stat_t *ps = NULL;
 	vdev_stat_t *vs;
 	char rbuf[6], wbuf[6], cbuf[6];
@@ -1759,7 +1830,7 @@ print_status_config(zpool_handle_t *zhp, status_cbdata_t *cb, const char *name,
 		children = 0;
 
 	verify(nvlist_lookup_uint64_array(nv, ZPOOL_CONFIG_VDEV_STATS,
-	    (uint64_t **)&vs, &c) == 0);
+	    (uint64_t **)&vs, &vsc) == 0);
 
 	verify(nvlist_lookup_string(nv, ZPOOL_CONFIG_TYPE, &type) == 0);
 
@@ -1878,6 +1949,9 @@ print_status_config(zpool_handle_t *zhp, status_cbdata_t *cb, const char *name,
 		    "resilvering" : "repairing");
 	}
 
+	if (!isspare)
+		print_trim_status(vs, vsc, children == 0);
+
 	if (cb->vcdl != NULL) {
 		if (nvlist_lookup_string(nv, ZPOOL_CONFIG_PATH, &path) == 0) {
 			printf("  ");
@@ -3116,7 +3190,7 @@ typedef struct name_and_columns {
 	unsigned int columns;	/* Center name to this number of columns */
 } name_and_columns_t;
 
-#define	IOSTAT_MAX_LABELS	11	/* Max number of labels on one line */
+#define	IOSTAT_MAX_LABELS	16	/* Max number of labels on one line */
 
 static const name_and_columns_t iostat_top_labels[][IOSTAT_MAX_LABELS] =
 {
@@ -3124,14 +3198,15 @@ static const name_and_columns_t iostat_top_labels[][IOSTAT_MAX_LABELS] =
 	    {NULL}},
 	[IOS_LATENCY] = {{"total_wait", 2}, {"disk_wait", 2}, {"syncq_wait", 2},
 	    {"asyncq_wait", 2}, {"scrub"}},
-	[IOS_QUEUES] = {{"syncq_read", 2}, {"syncq_write", 2},
-	    {"asyncq_read", 2}, {"asyncq_write", 2}, {"scrubq_read", 2},
+	[IOS_QUEUES] = {{"syncq_read", 3}, {"syncq_write", 3},
+	    {"asyncq_read", 3}, {"asyncq_write", 3}, {"scrubq_read", 3},
 	    {NULL}},
 	[IOS_L_HISTO] = {{"total_wait", 2}, {"disk_wait", 2},
 	    {"sync_queue", 2}, {"async_queue", 2}, {NULL}},
 	[IOS_RQ_HISTO] = {{"sync_read", 2}, {"sync_write", 2},
 	    {"async_read", 2}, {"async_write", 2}, {"scrub", 2}, {NULL}},
-
+	[IOS_WEIGHT] = {{"alloc"}, {NULL}},
+	[IOS_ZIL_HISTO] = {{"zil_commit", 5}, {NULL}},
 };
 
 /* Shorthand - if "columns" field not set, default to 1 column */
@@ -3141,17 +3216,22 @@ static const name_and_columns_t iostat_bottom_labels[][IOSTAT_MAX_LABELS] =
 	    {"write"}, {NULL}},
 	[IOS_LATENCY] = {{"read"}, {"write"}, {"read"}, {"write"}, {"read"},
 	    {"write"}, {"read"}, {"write"}, {"wait"}, {NULL}},
-	[IOS_QUEUES] = {{"pend"}, {"activ"}, {"pend"}, {"activ"}, {"pend"},
-	    {"activ"}, {"pend"}, {"activ"}, {"pend"}, {"activ"}, {NULL}},
+	[IOS_QUEUES] = {{"pend"}, {"activ"}, {"max"}, {"pend"}, {"activ"},
+	    {"max"}, {"pend"}, {"activ"}, {"max"}, {"pend"}, {"activ"},
+	    {"max"}, {"pend"}, {"activ"}, {"max"}, {NULL}},
 	[IOS_L_HISTO] = {{"read"}, {"write"}, {"read"}, {"write"}, {"read"},
 	    {"write"}, {"read"}, {"write"}, {"scrub"}, {NULL}},
 	[IOS_RQ_HISTO] = {{"ind"}, {"agg"}, {"ind"}, {"agg"}, {"ind"}, {"agg"},
 	    {"ind"}, {"agg"}, {"ind"}, {"agg"}, {NULL}},
+	[IOS_WEIGHT] = {{"weight"}, {NULL}},
+	[IOS_ZIL_HISTO] = {{"total"}, {"gather"}, {"issue"}, {"wait"},
+	    {"flush"}, {NULL}},
 };
 
 static const char *histo_to_title[] = {
 	[IOS_L_HISTO] = "latency",
 	[IOS_RQ_HISTO] = "req_size",
+	[IOS_ZIL_HISTO] = "latency",
 };
 
 /*
@@ -3205,9 +3285,10 @@ default_column_width(iostat_cbdata_t *cb, enum iostat_type type)
 		[IOS_DEFAULT] = 15, /* 1PB capacity */
 		[IOS_LATENCY] = 10, /* 1B ns = 10sec */
 		[IOS_QUEUES] = 6,   /* 1M queue entries */
+		[IOS_WEIGHT] = 6,   /* fits the "weight" label */
 	};
 
-	if (cb->cb_literal)
+	if (cb->cb_literal || type == IOS_WEIGHT)
 		column_width = widths[type];
 
 	return (column_width);
@@ -3634,7 +3715,7 @@ print_iostat_histo(struct stat_array *nva, unsigned int len,
 
 	for (j = start_bucket; j < buckets; j++) {
 		/* Print histogram bucket label */
-		if (cb->cb_flags & IOS_L_HISTO_M) {
+		if (cb->cb_flags & (IOS_L_HISTO_M | IOS_ZIL_HISTO_M)) {
 			/* Ending range of this bucket */
 			val = (1UL << (j + 1)) - 1;
 			zfs_nicetime(val, buf, sizeof (buf));
@@ -3771,13 +3852,23 @@ print_iostat_queues(iostat_cbdata_t *cb, nvlist_t *oldnv,
 		ZPOOL_CONFIG_VDEV_SCRUB_PEND_QUEUE,
 		ZPOOL_CONFIG_VDEV_SCRUB_ACTIVE_QUEUE,
 	};
+	const char *max_names[] = {
+		ZPOOL_CONFIG_VDEV_SYNC_R_MAX_QUEUE,
+		ZPOOL_CONFIG_VDEV_SYNC_W_MAX_QUEUE,
+		ZPOOL_CONFIG_VDEV_ASYNC_R_MAX_QUEUE,
+		ZPOOL_CONFIG_VDEV_ASYNC_W_MAX_QUEUE,
+		ZPOOL_CONFIG_VDEV_SCRUB_MAX_QUEUE,
+	};
 
 	struct stat_array *nva;
+	nvlist_t *nvx;
 
 	unsigned int column_width = default_column_width(cb, IOS_QUEUES);
 	enum zfs_nicenum_format format;
 
 	nva = calc_and_alloc_stats_ex(names, ARRAY_SIZE(names), NULL, newnv);
+	verify(nvlist_lookup_nvlist(newnv, ZPOOL_CONFIG_VDEV_STATS_EX,
+	    &nvx) == 0);
 
 	if (cb->cb_literal)
 		format = ZFS_NICENUM_RAW;
@@ -3787,6 +3878,21 @@ print_iostat_queues(iostat_cbdata_t *cb, nvlist_t *oldnv,
 	for (i = 0; i < ARRAY_SIZE(names); i++) {
 		val = nva[i].data[0];
 		print_one_stat(val, format, column_width, cb->cb_scripted);
+
+		/*
+		 * The queue depths follow each pend/activ pair.  Older
+		 * kernel modules don't report them.
+		 */
+		if (i % 2 == 0)
+			continue;
+		if (nvlist_lookup_uint64(nvx, max_names[i / 2], &val) == 0) {
+			print_one_stat(val, format, column_width,
+			    cb->cb_scripted);
+		} else if (cb->cb_scripted) {
+			printf("\t-");
+		} else {
+			printf("  %*s", column_width, "-");
+		}
 	}
 
 	free_calc_stats(nva, ARRAY_SIZE(names));
@@ -3830,6 +3936,30 @@ print_iostat_latency(iostat_cbdata_t *cb, nvlist_t *oldnv,
 	free_calc_stats(nva, ARRAY_SIZE(names));
 }
 
+/*
+ * Print the allocation weight of a top-level vdev, i.e. the percentage of
+ * its fair share of writes it is given based on its measured throughput.
+ * Other vdevs, and older kernel modules, don't report one.
+ */
+static void
+print_iostat_weight(iostat_cbdata_t *cb, nvlist_t *newnv)
+{
+	unsigned int column_width = default_column_width(cb, IOS_WEIGHT);
+	nvlist_t *nvx;
+	uint64_t val;
+
+	if (nvlist_lookup_nvlist(newnv, ZPOOL_CONFIG_VDEV_STATS_EX,
+	    &nvx) == 0 && nvlist_lookup_uint64(nvx,
+	    ZPOOL_CONFIG_VDEV_ALLOC_WEIGHT, &val) == 0) {
+		print_one_stat(val, ZFS_NICENUM_RAW, column_width,
+		    cb->cb_scripted);
+	} else if (cb->cb_scripted) {
+		printf("\t-");
+	} else {
+		printf("  %*s", column_width, "-");
+	}
+}
+
 /*
  * Print default statistics (capacity/operations/bandwidth)
  */
@@ -3975,6 +4105,8 @@ print_vdev_stats(zpool_handle_t *zhp, const char *name, nvlist_t *oldnv,
 		print_iostat_latency(cb, oldnv, newnv);
 	if (cb->cb_flags & IOS_QUEUES_M)
 		print_iostat_queues(cb, oldnv, newnv);
+	if (cb->cb_flags & IOS_WEIGHT_M)
+		print_iostat_weight(cb, newnv);
 	if (cb->cb_flags & IOS_ANYHISTO_M) {
 		printf("\n");
 		print_iostat_histos(cb, oldnv, newnv, scale, name);
@@ -4674,6 +4806,7 @@ zpool_do_iostat(int argc, char **argv)
 	zpool_list_t *list;
 	boolean_t verbose = B_FALSE;
 	boolean_t latency = B_FALSE, l_histo = B_FALSE, rq_histo = B_FALSE;
+	boolean_t zil_histo = B_FALSE;
 	boolean_t queues = B_FALSE, parsable = B_FALSE, scripted = B_FALSE;
 	boolean_t omit_since_boot = B_FALSE;
 	boolean_t guid = B_FALSE;
@@ -4684,12 +4817,12 @@ zpool_do_iostat(int argc, char **argv)
 
 	/* Used for printing error message */
 	const char flag_to_arg[] = {[IOS_LATENCY] = 'l', [IOS_QUEUES] = 'q',
-	    [IOS_L_HISTO] = 'w', [IOS_RQ_HISTO] = 'r'};
+	    [IOS_L_HISTO] = 'w', [IOS_RQ_HISTO] = 'r', [IOS_ZIL_HISTO] = 'z'};
 
 	uint64_t unsupported_flags;
 
 	/* check options */
-	while ((c = getopt(argc, argv, "c:gLPT:vyhplqrwH")) != -1) {
+	while ((c = getopt(argc, argv, "c:gLPT:vyhplqrwzH")) != -1) {
 		switch (c) {
 		case 'c':
 			if (cmd != NULL) {
@@ -4749,6 +4882,9 @@ zpool_do_iostat(int argc, char **argv)
 		case 'r':
 			rq_histo = B_TRUE;
 			break;
+		case 'z':
+			zil_histo = B_TRUE;
+			break;
 		case 'y':
 			omit_since_boot = B_TRUE;
 			break;
@@ -4853,18 +4989,28 @@ zpool_do_iostat(int argc, char **argv)
 		return (1);
 	}
 
-	if ((l_histo || rq_histo) && (cmd != NULL || latency || queues)) {
+	if ((l_histo || rq_histo || zil_histo) &&
+	    (cmd != NULL || latency || queues)) {
 		pool_list_free(list);
 		(void) fprintf(stderr,
-		    gettext("[-r|-w] isn't allowed with [-c|-l|-q]\n"));
+		    gettext("[-r|-w|-z] isn't allowed with [-c|-l|-q]\n"));
 		usage(B_FALSE);
 		return (1);
 	}
 
-	if (l_histo && rq_histo) {
+	if (l_histo + rq_histo + zil_histo > 1) {
+		pool_list_free(list);
+		(void) fprintf(stderr, gettext("Only one of [-r|-w|-z] can be "
+		    "passed at a time\n"));
+		usage(B_FALSE);
+		return (1);
+	}
+
+	if (zil_histo && cb.cb_verbose) {
 		pool_list_free(list);
 		(void) fprintf(stderr,
-		    gettext("Only one of [-r|-w] can be passed at a time\n"));
+		    gettext("-z reports pools only, it isn't allowed with "
+		    "[-v] or vdevs\n"));
 		usage(B_FALSE);
 		return (1);
 	}
@@ -4883,18 +5029,24 @@ zpool_do_iostat(int argc, char **argv)
 		cb.cb_flags = IOS_L_HISTO_M;
 	} else if (rq_histo) {
 		cb.cb_flags = IOS_RQ_HISTO_M;
+	} else if (zil_histo) {
+		cb.cb_flags = IOS_ZIL_HISTO_M;
 	} else {
 		cb.cb_flags = IOS_DEFAULT_M;
 		if (latency)
 			cb.cb_flags |= IOS_LATENCY_M;
 		if (queues)
 			cb.cb_flags |= IOS_QUEUES_M;
+		if (cb.cb_verbose)
+			cb.cb_flags |= IOS_WEIGHT_M;
 	}
 
 	/*
 	 * See if the module supports all the stats we want to display.
+	 * The allocation weights are simply shown as "-" when they aren't.
 	 */
-	unsupported_flags = cb.cb_flags & ~get_stat_flags(list);
+	unsupported_flags = cb.cb_flags & ~get_stat_flags(list) &
+	    ~IOS_WEIGHT_M;
 	if (unsupported_flags) {
 		uint64_t f;
 		int idx;
@@ -6315,6 +6467,120 @@ zpool_do_scrub(int argc, char **argv)
 	return (for_each_pool(argc, argv, B_TRUE, NULL, scrub_callback, &cb));
 }
 
+/*
+ * zpool trim [-c | -s] [-r <rate>] <pool> [<device> ...]
+ *
+ *	-c	Cancel. Ends trimming of the given devices.
+ *	-s	Suspend. Trimming can be resumed by running the command
+ *		again without -c or -s.
+ *	-r	Trim at no more than <rate> bytes per second.
+ *
+ * Trims the free space of the top-level vdevs of the pool, or only of the
+ * top-level vdevs containing the given devices.
+ */
+int
+zpool_do_trim(int argc, char **argv)
+{
+	pool_trim_func_t cmd_type = POOL_TRIM_START;
+	boolean_t rate_set = B_FALSE;
+	uint64_t rate = 0;
+	zpool_handle_t *zhp;
+	nvlist_t *vdevs;
+	char *poolname;
+	int c, err;
+
+	while ((c = getopt(argc, argv, "csr:")) != -1) {
+		switch (c) {
+		case 'c':
+			if (cmd_type != POOL_TRIM_START &&
+			    cmd_type != POOL_TRIM_CANCEL) {
+				(void) fprintf(stderr, gettext("-c cannot be "
+				    "combined with other options\n"));
+				usage(B_FALSE);
+			}
+			cmd_type = POOL_TRIM_CANCEL;
+			break;
+		case 's':
+			if (cmd_type != POOL_TRIM_START &&
+			    cmd_type != POOL_TRIM_SUSPEND) {
+				(void) fprintf(stderr, gettext("-s cannot be "
+				    "combined with other options\n"));
+				usage(B_FALSE);
+			}
+			cmd_type = POOL_TRIM_SUSPEND;
+			break;
+		case 'r':
+			if (zfs_nicestrtonum(NULL, optarg, &rate) == -1) {
+				(void) fprintf(stderr, gettext("invalid value "
+				    "for rate\n"));
+				usage(B_FALSE);
+			}
+			rate_set = B_TRUE;
+			break;
+		case '?':
+			(void) fprintf(stderr, gettext("invalid option '%c'\n"),
+			    optopt);
+			usage(B_FALSE);
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (rate_set && cmd_type != POOL_TRIM_START) {
+		(void) fprintf(stderr, gettext("-r cannot be combined with "
+		    "-c or -s\n"));
+		usage(B_FALSE);
+	}
+
+	if (argc < 1) {
+		(void) fprintf(stderr, gettext("missing pool name argument\n"));
+		usage(B_FALSE);
+	}
+
+	poolname = argv[0];
+	if ((zhp = zpool_open(g_zfs, poolname)) == NULL)
+		return (1);
+
+	vdevs = fnvlist_alloc();
+	if (argc == 1) {
+		nvlist_t *config, *nvroot, **child;
+		uint_t children;
+
+		/* trim all top-level vdevs which hold data */
+		config = zpool_get_config(zhp, NULL);
+		nvroot = fnvlist_lookup_nvlist(config, ZPOOL_CONFIG_VDEV_TREE);
+		if (nvlist_lookup_nvlist_array(nvroot, ZPOOL_CONFIG_CHILDREN,
+		    &child, &children) != 0)
+			children = 0;
+
+		for (uint_t i = 0; i < children; i++) {
+			char *type = fnvlist_lookup_string(child[i],
+			    ZPOOL_CONFIG_TYPE);
+			char *name;
+
+			if (strcmp(type, VDEV_TYPE_HOLE) == 0 ||
+			    strcmp(type, VDEV_TYPE_INDIRECT) == 0)
+				continue;
+
+			name = zpool_vdev_name(g_zfs, zhp, child[i],
+			    VDEV_NAME_TYPE_ID);
+			fnvlist_add_boolean(vdevs, name);
+			free(name);
+		}
+	} else {
+		for (int i = 1; i < argc; i++)
+			fnvlist_add_boolean(vdevs, argv[i]);
+	}
+
+	err = (zpool_trim(zhp, cmd_type, vdevs, rate) != 0);
+
+	fnvlist_free(vdevs);
+	zpool_close(zhp);
+
+	return (err);
+}
+
 /*
  * Print out detailed scrub status.
  */
@@ -95,6 +95,7 @@
 #include <sys/dbuf.h>
 #include <sys/zap.h>
 #include <sys/dmu_objset.h>
+#include <sys/dmu_impl.h>
 #include <sys/poll.h>
 #include <sys/stat.h>
 #include <sys/time.h>
@@ -211,7 +212,10 @@ extern unsigned long zfs_deadman_synctime_ms;
 extern int metaslab_preload_limit;
 extern boolean_t zfs_compressed_arc_enabled;
 extern int zfs_abd_scatter_enabled;
+extern int zfs_vdev_queue_adaptive;
+extern int zfs_vdev_fair_queue;
 extern int dmu_object_alloc_chunk_shift;
+extern int zil_chains;
 extern boolean_t zfs_force_some_double_word_sm_entries;
 extern unsigned long zio_decompress_fail_fraction;
 extern unsigned long zfs_reconstruct_indirect_damage_fraction;
@@ -360,6 +364,7 @@ ztest_func_t ztest_spa_upgrade;
 ztest_func_t ztest_device_removal;
 ztest_func_t ztest_remap_blocks;
 ztest_func_t ztest_spa_checkpoint_create_discard;
+ztest_func_t ztest_vdev_trim;
 ztest_func_t ztest_fletcher;
 ztest_func_t ztest_fletcher_incr;
 ztest_func_t ztest_verify_dnode_bt;
@@ -414,6 +419,7 @@ ztest_info_t ztest_info[] = {
 	ZTI_INIT(ztest_device_removal, 1, &zopt_sometimes),
 	ZTI_INIT(ztest_remap_blocks, 1, &zopt_sometimes),
 	ZTI_INIT(ztest_spa_checkpoint_create_discard, 1, &zopt_rarely),
+	ZTI_INIT(ztest_vdev_trim, 1, &zopt_sometimes),
 	ZTI_INIT(ztest_fletcher, 1, &zopt_rarely),
 	ZTI_INIT(ztest_fletcher_incr, 1, &zopt_rarely),
 	ZTI_INIT(ztest_verify_dnode_bt, 1, &zopt_sometimes),
@@ -1967,6 +1973,7 @@ ztest_replay_write(void *arg1, void *arg2, boolean_t byteswap)
 	dmu_tx_t *tx;
 	dmu_buf_t *db;
 	arc_buf_t *abuf = NULL;
+	boolean_t direct = B_FALSE;
 	ztest_zrl_t *rl;
 
 	if (byteswap)
@@ -2007,9 +2014,12 @@ ztest_replay_write(void *arg1, void *arg2, boolean_t byteswap)
 
 	dmu_tx_hold_write(tx, lr->lr_foid, offset, length);
 
-	if (ztest_random(8) == 0 && length == doi.doi_data_block_size &&
-	    P2PHASE(offset, length) == 0)
-		abuf = dmu_request_arcbuf(db, length);
+	if (length == doi.doi_data_block_size && P2PHASE(offset, length) == 0) {
+		if (ztest_random(8) == 0)
+			abuf = dmu_request_arcbuf(db, length);
+		else if (ztest_random(4) == 0)
+			direct = B_TRUE;
+	}
 
 	txg = ztest_tx_assign(tx, TXG_WAIT, FTAG);
 	if (txg == 0) {
@@ -2033,8 +2043,20 @@ ztest_replay_write(void *arg1, void *arg2, boolean_t byteswap)
 			    DMU_READ_PREFETCH : DMU_READ_NO_PREFETCH;
 			ztest_block_tag_t rbt;
 
-			VERIFY(dmu_read(os, lr->lr_foid, offset,
-			    sizeof (rbt), &rbt, prefetch) == 0);
+			if (direct && ztest_random(2) == 0) {
+				void *buf = umem_alloc_aligned(length,
+				    SPA_MINBLOCKSIZE, UMEM_NOFAIL);
+				abd_t *abd = abd_get_from_user_buf(buf, length);
+
+				VERIFY0(dmu_read_direct(db, offset, length,
+				    abd));
+				abd_put(abd);
+				bcopy(buf, &rbt, sizeof (rbt));
+				umem_free(buf, length);
+			} else {
+				VERIFY(dmu_read(os, lr->lr_foid, offset,
+				    sizeof (rbt), &rbt, prefetch) == 0);
+			}
 			if (rbt.bt_magic == BT_MAGIC) {
 				ztest_bt_verify(&rbt, os, lr->lr_foid, 0,
 				    offset, gen, txg, crtxg);
@@ -2061,7 +2083,21 @@ ztest_replay_write(void *arg1, void *arg2, boolean_t byteswap)
 		    crtxg);
 	}
 
-	if (abuf == NULL) {
+	if (direct) {
+		/*
+		 * Direct I/O buffers must be aligned like any other I/O
+		 * buffer, which the log record's data isn't.  Treat it as
+		 * a user's, so that each block is checked once written.
+		 */
+		void *buf = umem_alloc_aligned(length, SPA_MINBLOCKSIZE,
+		    UMEM_NOFAIL);
+		abd_t *abd = abd_get_from_user_buf(buf, length);
+
+		bcopy(data, buf, length);
+		VERIFY0(dmu_write_direct(db, offset, length, abd, tx));
+		abd_put(abd);
+		umem_free(buf, length);
+	} else if (abuf == NULL) {
 		dmu_write(os, lr->lr_foid, offset, length, data, tx);
 	} else {
 		bcopy(data, abuf->b_data, length);
@@ -2217,6 +2253,7 @@ zil_replay_func_t *ztest_replay_vector[TX_MAX_TYPE] = {
 	NULL,			/* TX_MKDIR_ATTR */
 	NULL,			/* TX_MKDIR_ACL_ATTR */
 	NULL,			/* TX_WRITE2 */
+	NULL,			/* TX_BATCH */
 };
 
 /*
@@ -2316,8 +2353,7 @@ ztest_get_data(void *arg, lr_write_t *lr, char *buf, struct lwb *lwb,
 		    RL_READER);
 		zgd->zgd_rl = zgd_private->z_rl->z_rl;
 
-		error = dmu_buf_hold(os, object, offset, zgd, &db,
-		    DMU_READ_NO_PREFETCH);
+		error = dmu_buf_hold_noread(os, object, offset, zgd, &db);
 
 		if (error == 0) {
 			blkptr_t *bp = &lr->lr_blkptr;
@@ -2991,6 +3027,46 @@ ztest_spa_checkpoint_create_discard(ztest_ds_t *zd, uint64_t id)
 	mutex_exit(&ztest_checkpoint_lock);
 }
 
+/*
+ * Start, suspend or cancel the manual trim of a random top-level vdev,
+ * optionally rate limited.
+ */
+/* ARGSUSED */
+void
+ztest_vdev_trim(ztest_ds_t *zd, uint64_t id)
+{
+	spa_t *spa = ztest_spa;
+	uint64_t cmd_type = ztest_random(POOL_TRIM_FUNCS);
+	uint64_t rate = 0;
+	nvlist_t *vdevs, *errlist;
+	uint64_t guid;
+	int error;
+
+	if (ztest_random(2) == 0)
+		rate = 1ULL << (20 + ztest_random(10));
+
+	mutex_enter(&ztest_vdev_lock);
+
+	spa_config_enter(spa, SCL_VDEV, FTAG, RW_READER);
+	guid = spa->spa_root_vdev->vdev_child[
+	    ztest_random_vdev_top(spa, B_TRUE)]->vdev_guid;
+	spa_config_exit(spa, SCL_VDEV, FTAG);
+
+	vdevs = fnvlist_alloc();
+	errlist = fnvlist_alloc();
+	fnvlist_add_uint64(vdevs, "vdev", guid);
+
+	error = spa_vdev_trim(spa, vdevs, cmd_type, rate, errlist);
+	if (ztest_opts.zo_verbose >= 4) {
+		(void) printf("trim command %llu on vdev %llu returned %d\n",
+		    (u_longlong_t)cmd_type, (u_longlong_t)guid, error);
+	}
+
+	fnvlist_free(vdevs);
+	fnvlist_free(errlist);
+
+	mutex_exit(&ztest_vdev_lock);
+}
 
 static vdev_t *
 vdev_lookup_by_path(vdev_t *vd, const char *path)
@@ -5591,7 +5667,9 @@ ztest_dsl_prop_get_set(ztest_ds_t *zd, uint64_t id)
 		ZFS_PROP_CHECKSUM,
 		ZFS_PROP_COMPRESSION,
 		ZFS_PROP_COPIES,
-		ZFS_PROP_DEDUP
+		ZFS_PROP_DEDUP,
+		ZFS_PROP_SCANCACHE,
+		ZFS_PROP_DIRECT
 	};
 	int p;
 
@@ -5632,6 +5710,8 @@ ztest_spa_prop_get_set(ztest_ds_t *zd, uint64_t id)
 	(void) ztest_spa_prop_set_uint64(ZPOOL_PROP_DEDUPDITTO,
 	    ZIO_DEDUPDITTO_MIN + ztest_random(ZIO_DEDUPDITTO_MIN));
 
+	(void) ztest_spa_prop_set_uint64(ZPOOL_PROP_AUTOTRIM, ztest_random(2));
+
 	VERIFY0(spa_prop_get(ztest_spa, &props));
 
 	if (ztest_opts.zo_verbose >= 6)
@@ -6644,6 +6724,26 @@ ztest_resume_thread(void *arg)
 		 */
 		if (ztest_random(10) == 0)
 			zfs_abd_scatter_enabled = ztest_random(2);
+
+		/*
+		 * Periodically toggle hedged reads.  The delayed dispatch
+		 * of the hedge timer always fails in userland, so when
+		 * enabled alternate reads are issued immediately.
+		 */
+		if (ztest_random(10) == 0)
+			zfs_vdev_hedge_read_ms = ztest_random(2);
+
+		/*
+		 * Periodically toggle the adaptive vdev queue depths.
+		 */
+		if (ztest_random(10) == 0)
+			zfs_vdev_queue_adaptive = ztest_random(2);
+
+		/*
+		 * Periodically toggle fair queueing between objsets.
+		 */
+		if (ztest_random(10) == 0)
+			zfs_vdev_fair_queue = ztest_random(2);
 	}
 
 	thread_exit();
@@ -6811,6 +6911,7 @@ ztest_dataset_open(int d)
 {
 	ztest_ds_t *zd = &ztest_ds[d];
 	uint64_t committed_seq = ZTEST_GET_SHARED_DS(d)->zd_seq;
+	uint64_t claim_lr_seq;
 	objset_t *os;
 	zilog_t *zilog;
 	char name[ZFS_MAX_DATASET_NAME_LEN];
@@ -6836,10 +6937,20 @@ ztest_dataset_open(int d)
 
 	zilog = zd->zd_zilog;
 
-	if (zilog->zl_header->zh_claim_lr_seq != 0 &&
-	    zilog->zl_header->zh_claim_lr_seq < committed_seq)
+	/*
+	 * The records of a log written as several chains are spread over
+	 * them, so the last one committed may be claimed in any chain.
+	 */
+	claim_lr_seq = zilog->zl_header->zh_claim_lr_seq;
+	for (int c = 0; zilog->zl_chain_heads != NULL &&
+	    c < ZIL_MAX_CHAINS - 1; c++) {
+		claim_lr_seq = MAX(claim_lr_seq,
+		    zilog->zl_chain_heads[c].zch_claim_lr_seq);
+	}
+
+	if (claim_lr_seq != 0 && claim_lr_seq < committed_seq)
 		fatal(0, "missing log records: claimed %llu < committed %llu",
-		    zilog->zl_header->zh_claim_lr_seq, committed_seq);
+		    claim_lr_seq, committed_seq);
 
 	ztest_dataset_dirobj_verify(zd);
 
@@ -6892,6 +7003,12 @@ ztest_run(ztest_shared_t *zs)
 
 	ztest_exiting = B_FALSE;
 
+	/*
+	 * Write the logs of the datasets opened by this run as a random
+	 * number of chains.
+	 */
+	zil_chains = 1 + ztest_random(ZIL_MAX_CHAINS);
+
 	/*
 	 * Initialize parent/child shared state.
 	 */
@@ -6920,6 +7037,15 @@ ztest_run(ztest_shared_t *zs)
 	kernel_init(FREAD | FWRITE);
 	VERIFY0(spa_open(ztest_opts.zo_pool, &spa, FTAG));
 	metaslab_preload_limit = ztest_random(20) + 1;
+
+	/*
+	 * Cycle through all available SHA2 and BLAKE3 implementations so
+	 * that blocks checksummed by one are verified by the others.
+	 */
+	VERIFY0(sha256_impl_set("cycle"));
+	VERIFY0(sha256_mb_impl_set("cycle"));
+	VERIFY0(sha512_impl_set("cycle"));
+	VERIFY0(blake3_impl_set("cycle"));
 	ztest_spa = spa;
 
 	dmu_objset_stats_t dds;
@@ -7059,6 +7185,24 @@ ztest_run(ztest_shared_t *zs)
 	mutex_destroy(&ztest_checkpoint_lock);
 }
 
+/*
+ * Return B_TRUE if any chain of the log has a block.
+ */
+static boolean_t
+ztest_zil_anchored(zilog_t *zilog)
+{
+	if (!BP_IS_HOLE(&zilog->zl_header->zh_log))
+		return (B_TRUE);
+
+	for (int c = 0; zilog->zl_chain_heads != NULL &&
+	    c < ZIL_MAX_CHAINS - 1; c++) {
+		if (!BP_IS_HOLE(&zilog->zl_chain_heads[c].zch_log))
+			return (B_TRUE);
+	}
+
+	return (B_FALSE);
+}
+
 static void
 ztest_freeze(void)
 {
@@ -7071,15 +7215,18 @@ ztest_freeze(void)
 
 	kernel_init(FREAD | FWRITE);
 	VERIFY3U(0, ==, spa_open(ztest_opts.zo_pool, &spa, FTAG));
+
+	zil_chains = 1 + ztest_random(ZIL_MAX_CHAINS);
 	VERIFY3U(0, ==, ztest_dataset_open(0));
 	ztest_spa = spa;
 
 	/*
 	 * Force the first log block to be transactionally allocated.
 	 * We have to do this before we freeze the pool -- otherwise
-	 * the log chain won't be anchored.
+	 * the log chain won't be anchored.  Only the chains anchored
+	 * here are written once the pool is frozen.
 	 */
-	while (BP_IS_HOLE(&zd->zd_zilog->zl_header->zh_log)) {
+	while (!ztest_zil_anchored(zd->zd_zilog)) {
 		ztest_dmu_object_alloc_free(zd, 0);
 		zil_commit(zd->zd_zilog, 0);
 	}
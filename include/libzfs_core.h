@@ -113,6 +113,9 @@ int lzc_reopen(const char *, boolean_t);
 int lzc_pool_checkpoint(const char *);
 int lzc_pool_checkpoint_discard(const char *);
 
+int lzc_trim(const char *, pool_trim_func_t, uint64_t, nvlist_t *,
+    nvlist_t **);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -150,7 +150,8 @@ typedef enum cpuid_inst_sets {
 	AVX512ER,
 	AVX512VL,
 	AES,
-	PCLMULQDQ
+	PCLMULQDQ,
+	SHA
 } cpuid_inst_sets_t;
 
 /*
@@ -174,6 +175,7 @@ typedef struct cpuid_feature_desc {
 #define	_AVX512VL_BIT		(1U << 31) /* if used also check other levels */
 #define	_AES_BIT		(1U << 25)
 #define	_PCLMULQDQ_BIT		(1U << 1)
+#define	_SHA_BIT		(1U << 29)
 
 /*
  * Descriptions of supported instruction sets
@@ -201,6 +203,7 @@ static const cpuid_feature_desc_t cpuid_features[] = {
 	[AVX512VL]	= {7U, 0U, _AVX512ER_BIT,	EBX	},
 	[AES]		= {1U, 0U, _AES_BIT,		ECX	},
 	[PCLMULQDQ]	= {1U, 0U, _PCLMULQDQ_BIT,	ECX	},
+	[SHA]		= {7U, 0U, _SHA_BIT,		EBX	},
 };
 
 /*
@@ -273,6 +276,7 @@ CPUID_FEATURE_CHECK(avx512er, AVX512ER);
 CPUID_FEATURE_CHECK(avx512vl, AVX512VL);
 CPUID_FEATURE_CHECK(aes, AES);
 CPUID_FEATURE_CHECK(pclmulqdq, PCLMULQDQ);
+CPUID_FEATURE_CHECK(sha, SHA);
 
 #endif /* !defined(_KERNEL) */
 
@@ -480,6 +484,21 @@ zfs_pclmulqdq_available(void)
 #endif
 }
 
+/*
+ * Check if SHA instruction set is available
+ */
+static inline boolean_t
+zfs_sha_available(void)
+{
+#if defined(_KERNEL) && defined(X86_FEATURE_SHA_NI)
+	return (!!boot_cpu_has(X86_FEATURE_SHA_NI));
+#elif defined(_KERNEL) && !defined(X86_FEATURE_SHA_NI)
+	return (B_FALSE);
+#else
+	return (__cpuid_has_sha());
+#endif
+}
+
 /*
  * AVX-512 family of instruction sets:
  *
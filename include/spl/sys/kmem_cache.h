@@ -26,6 +26,7 @@
 #define	_SPL_KMEM_CACHE_H
 
 #include <sys/taskq.h>
+#include <linux/rcupdate.h>
 
 /*
  * Slab allocation interfaces.  The SPL slab differs from the standard
@@ -46,6 +47,7 @@ enum {
 	KMC_BIT_SLAB		= 7,	/* Use Linux slab cache */
 	KMC_BIT_OFFSLAB		= 8,	/* Objects not on slab */
 	KMC_BIT_NOEMERGENCY	= 9,	/* Disable emergency objects */
+	KMC_BIT_TYPESAFE	= 10,	/* Objects keep their type */
 	KMC_BIT_DEADLOCKED	= 14,	/* Deadlock detected */
 	KMC_BIT_GROWING		= 15,	/* Growing in progress */
 	KMC_BIT_REAPING		= 16,	/* Reaping in progress */
@@ -74,6 +76,7 @@ typedef enum kmem_cbrc {
 #define	KMC_SLAB		(1 << KMC_BIT_SLAB)
 #define	KMC_OFFSLAB		(1 << KMC_BIT_OFFSLAB)
 #define	KMC_NOEMERGENCY		(1 << KMC_BIT_NOEMERGENCY)
+#define	KMC_TYPESAFE		(1 << KMC_BIT_TYPESAFE)
 #define	KMC_DEADLOCKED		(1 << KMC_BIT_DEADLOCKED)
 #define	KMC_GROWING		(1 << KMC_BIT_GROWING)
 #define	KMC_REAPING		(1 << KMC_BIT_REAPING)
@@ -229,6 +232,15 @@ extern void spl_kmem_reap(void);
 #define	kmem_cache_free(skc, obj)	spl_kmem_cache_free(skc, obj)
 #define	kmem_cache_reap_now(skc)	\
     spl_kmem_cache_reap_now(skc, skc->skc_reap)
+
+/*
+ * An object of a KMC_TYPESAFE cache which is freed while a reader found it
+ * without holding a lock may be reused for another object of the cache,
+ * but its memory remains an object of the cache until the reader calls
+ * kmem_cache_typesafe_exit().  The reader must not sleep in between.
+ */
+#define	kmem_cache_typesafe_enter()	rcu_read_lock()
+#define	kmem_cache_typesafe_exit()	rcu_read_unlock()
 #define	kmem_reap()			spl_kmem_reap()
 
 /*
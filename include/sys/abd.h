@@ -44,7 +44,8 @@ typedef enum abd_flags {
 	ABD_FLAG_OWNER	= 1 << 1,	/* does it own its data buffers? */
 	ABD_FLAG_META	= 1 << 2,	/* does this represent FS metadata? */
 	ABD_FLAG_MULTI_ZONE  = 1 << 3,	/* pages split over memory zones */
-	ABD_FLAG_MULTI_CHUNK = 1 << 4	/* pages split over multiple chunks */
+	ABD_FLAG_MULTI_CHUNK = 1 << 4,	/* pages split over multiple chunks */
+	ABD_FLAG_USER	= 1 << 5	/* may be changed by a user under I/O */
 } abd_flags_t;
 
 typedef struct abd {
@@ -66,6 +67,7 @@ typedef struct abd {
 
 typedef int abd_iter_func_t(void *buf, size_t len, void *private);
 typedef int abd_iter_func2_t(void *bufa, void *bufb, size_t len, void *private);
+typedef int abd_iter_many_func_t(void **bufs, size_t len, void *private);
 
 extern int zfs_abd_scatter_enabled;
 
@@ -75,11 +77,24 @@ abd_is_linear(abd_t *abd)
 	return ((abd->abd_flags & ABD_FLAG_LINEAR) != 0 ? B_TRUE : B_FALSE);
 }
 
+static inline boolean_t
+abd_is_user(abd_t *abd)
+{
+	return ((abd->abd_flags & ABD_FLAG_USER) != 0 ? B_TRUE : B_FALSE);
+}
+
 /*
  * Allocations and deallocations
  */
 
+/*
+ * A negative node passed to abd_alloc_node() requests memory local to
+ * the calling thread, which is also what abd_alloc() does.
+ */
+#define	ABD_NODE_LOCAL	(-1)
+
 abd_t *abd_alloc(size_t, boolean_t);
+abd_t *abd_alloc_node(size_t, boolean_t, int);
 abd_t *abd_alloc_linear(size_t, boolean_t);
 abd_t *abd_alloc_for_io(size_t, boolean_t);
 abd_t *abd_alloc_sametype(abd_t *, size_t);
@@ -87,6 +102,7 @@ void abd_free(abd_t *);
 abd_t *abd_get_offset(abd_t *, size_t);
 abd_t *abd_get_offset_size(abd_t *, size_t, size_t);
 abd_t *abd_get_from_buf(void *, size_t);
+abd_t *abd_get_from_user_buf(void *, size_t);
 void abd_put(abd_t *);
 
 /*
@@ -108,6 +124,8 @@ void abd_release_ownership_of_buf(abd_t *);
 int abd_iterate_func(abd_t *, size_t, size_t, abd_iter_func_t *, void *);
 int abd_iterate_func2(abd_t *, abd_t *, size_t, size_t, size_t,
     abd_iter_func2_t *, void *);
+int abd_iterate_many_func(abd_t **, const size_t *, int,
+    abd_iter_many_func_t *, void *);
 void abd_copy_off(abd_t *, abd_t *, size_t, size_t, size_t);
 void abd_copy_from_buf_off(abd_t *, const void *, size_t, size_t);
 void abd_copy_to_buf_off(void *, abd_t *, size_t, size_t);
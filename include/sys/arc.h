@@ -60,6 +60,7 @@ _NOTE(CONSTCOND) } while (0)
 typedef struct arc_buf_hdr arc_buf_hdr_t;
 typedef struct arc_buf arc_buf_t;
 typedef struct arc_prune arc_prune_t;
+typedef struct arc_tenant arc_tenant_t;
 
 /*
  * Because the ARC can store encrypted data, errors (not due to bugs) may arise
@@ -146,6 +147,13 @@ typedef enum arc_flags
 	ARC_FLAG_COMPRESSED_ARC		= 1 << 20,
 	ARC_FLAG_SHARED_DATA		= 1 << 21,
 
+	/*
+	 * The block is being read by a single-pass sequential scan.  It may
+	 * be passed into arc_read(); a header admitted with it is kept at the
+	 * cold end of its state's list so that it is evicted first.
+	 */
+	ARC_FLAG_SCAN			= 1 << 22,
+
 	/*
 	 * The arc buffer's compression mode is stored in the top 7 bits of the
 	 * flags field, so these dummy flags are included so that MDB can
@@ -292,6 +300,11 @@ void arc_tempreserve_clear(uint64_t reserve);
 int arc_tempreserve_space(spa_t *spa, uint64_t reserve, uint64_t txg);
 
 uint64_t arc_target_bytes(void);
+arc_tenant_t *arc_tenant_hold(spa_t *spa, uint64_t objset);
+void arc_tenant_rele(arc_tenant_t *at);
+void arc_tenant_set_quota(arc_tenant_t *at, uint64_t quota);
+void arc_tenant_set_reserve(arc_tenant_t *at, uint64_t reserve);
+uint64_t arc_tenant_size(arc_tenant_t *at);
 void arc_init(void);
 void arc_fini(void);
 
@@ -301,6 +314,7 @@ void arc_fini(void);
 
 void l2arc_add_vdev(spa_t *spa, vdev_t *vd);
 void l2arc_remove_vdev(vdev_t *vd);
+void l2arc_spa_rebuild_stop(spa_t *spa);
 boolean_t l2arc_vdev_present(vdev_t *vd);
 void l2arc_init(void);
 void l2arc_fini(void);
@@ -30,6 +30,7 @@
 
 #include <sys/arc.h>
 #include <sys/zio_crypt.h>
+#include <sys/aggsum.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -87,6 +88,23 @@ typedef struct arc_state {
 	arc_state_type_t arcs_state;
 } arc_state_t;
 
+/*
+ * Per-objset accounting of ARC residency. Every L1 header with data
+ * charges its bytes to the tenant of the objset that read or wrote it,
+ * which lets arc_adjust() trim tenants above their quota and lets
+ * arc_evict_state() pass over tenants below their reservation.
+ */
+struct arc_tenant {
+	avl_node_t		at_node;	/* arc_tenant_tree linkage */
+	uint64_t		at_spa;		/* spa_load_guid() */
+	uint64_t		at_objset;	/* objset id */
+	uint64_t		at_refcnt;	/* updated atomically */
+	uint64_t		at_quota;	/* 0 means no quota */
+	uint64_t		at_reserve;	/* 0 means no reservation */
+	boolean_t		at_unlinked;	/* under arc_tenant_lock */
+	aggsum_t		at_size;	/* bytes charged to tenant */
+};
+
 typedef struct arc_callback arc_callback_t;
 
 struct arc_callback {
@@ -153,6 +171,8 @@ typedef struct l1arc_buf_hdr {
 	/* for waiting on writes to complete */
 	kcondvar_t		b_cv;
 	uint8_t			b_byteswap;
+	/* NUMA node the hdr's data is allocated on, see arc_numa_node_id() */
+	uint16_t		b_node;
 
 
 	/* protected by arc state mutex */
@@ -172,6 +192,9 @@ typedef struct l1arc_buf_hdr {
 
 	arc_callback_t		*b_acb;
 	abd_t			*b_pabd;
+
+	/* objset this hdr's data is charged to, protected by hash lock */
+	arc_tenant_t		*b_tenant;
 } l1arc_buf_hdr_t;
 
 /*
@@ -204,6 +227,190 @@ typedef struct arc_buf_hdr_crypt {
 	uint8_t			b_mac[ZIO_DATA_MAC_LEN];
 } arc_buf_hdr_crypt_t;
 
+/*
+ * Persistent L2ARC
+ *
+ * To allow the L2ARC to survive a reboot or pool export/import, the L2ARC
+ * feed thread writes a log of the buffers it caches alongside the buffers
+ * themselves. The log consists of log blocks, each of which holds up to
+ * L2ARC_LOG_BLK_MAX_ENTRIES entries describing previously written buffers,
+ * and a device header at the start of the device which points to the two
+ * most recently written log blocks:
+ *
+ *	+------+------+------+------+------+------+------+------+---
+ *	|  DH  | bufs | bufs |  LB  | bufs |  LB  | bufs |  LB  | ...
+ *	+------+------+------+------+------+------+------+------+---
+ *	   |                    ^             ^             ^
+ *	   |                    |<-lb_prev----|-------------+
+ *	   |                                  |             |
+ *	   +----------- dh_start_lbps[1] -----+             |
+ *	   +----------- dh_start_lbps[0] -------------------+
+ *
+ * Each log block points to the log block written two commits before it,
+ * which forms two interleaved chains walking backwards through the
+ * device. This lets the rebuild keep two log block reads in flight. The
+ * rebuild walks the chains from the device header, recreating L2-only
+ * ARC headers for every entry, until it finds a log block which is
+ * invalid (bad checksum) or which was overwritten by later writes.
+ *
+ * On-disk structures are written in native byte order. A device written
+ * by a host of the other endianness fails the magic number check and is
+ * simply started afresh.
+ */
+#define	L2ARC_DEV_HDR_MAGIC	0x5a46534341434845LLU	/* ASCII: "ZFSCACHE" */
+#define	L2ARC_LOG_BLK_MAGIC	0x4c4f47424c4b4844LLU	/* ASCII: "LOGBLKHD" */
+#define	L2ARC_PERSISTENT_VERSION	1
+
+/*
+ * Log block pointer. This is not a blkptr_t; it describes the location,
+ * size and checksum of a log block on an L2ARC device, together with the
+ * range of the device covered by the buffers that the log block describes.
+ */
+typedef struct l2arc_log_blkptr {
+	/* offset of the log block within the device, in bytes */
+	uint64_t	lbp_daddr;
+	/* aligned size of the buffers described by the log block */
+	uint64_t	lbp_payload_asize;
+	/* offset of the first buffer described by the log block */
+	uint64_t	lbp_payload_start;
+	/*
+	 * lbp_prop has the following format:
+	 *	* logical size (in bytes)
+	 *	* aligned (after compression) size (in bytes)
+	 *	* compression algorithm (we always LZ4-compress l2arc logs)
+	 *	* checksum algorithm (used for lbp_cksum)
+	 */
+	uint64_t	lbp_prop;
+	zio_cksum_t	lbp_cksum;	/* checksum of log */
+} l2arc_log_blkptr_t;
+
+/*
+ * The persistent L2ARC device header, written at the start of each L2ARC
+ * device. It is always 512 bytes in size and is padded out to the
+ * device's allocation size.
+ */
+typedef struct l2arc_dev_hdr_phys {
+	uint64_t	dh_magic;	/* L2ARC_DEV_HDR_MAGIC */
+	uint64_t	dh_version;	/* L2ARC_PERSISTENT_VERSION */
+
+	/*
+	 * Global L2ARC device state and metadata.
+	 */
+	uint64_t	dh_spa_guid;
+	uint64_t	dh_vdev_guid;
+	uint64_t	dh_log_entries;		/* mirror of l2ad_log_entries */
+	uint64_t	dh_evict;		/* evicted offset in bytes */
+	uint64_t	dh_flags;		/* l2arc_dev_hdr_flags_t */
+	uint64_t	dh_start;		/* mirror of l2ad_start */
+	uint64_t	dh_end;			/* mirror of l2ad_end */
+	/*
+	 * Start of log block chain. [0] -> newest log, [1] -> one older (used
+	 * for initiating prefetch).
+	 */
+	l2arc_log_blkptr_t	dh_start_lbps[2];
+	/*
+	 * Aligned size of all log blocks as accounted by vdev_space_update().
+	 */
+	uint64_t	dh_lb_asize;		/* mirror of l2ad_lb_asize */
+	uint64_t	dh_lb_count;		/* mirror of l2ad_lb_count */
+	uint64_t	dh_pad[33];		/* pad to 512 bytes */
+	zio_cksum_t	dh_self_cksum;		/* fletcher4 of fields above */
+} l2arc_dev_hdr_phys_t;
+CTASSERT_GLOBAL(sizeof (l2arc_dev_hdr_phys_t) == SPA_MINBLOCKSIZE);
+
+typedef enum l2arc_dev_hdr_flags_t {
+	L2ARC_DEV_HDR_EVICT_FIRST = (1 << 0)	/* mirror of l2ad_first */
+} l2arc_dev_hdr_flags_t;
+
+/*
+ * A single ARC buffer header entry in a l2arc_log_blk_phys_t.
+ */
+typedef struct l2arc_log_ent_phys {
+	dva_t			le_dva;		/* dva of buffer */
+	uint64_t		le_birth;	/* birth txg of buffer */
+	/*
+	 * le_prop has the following format:
+	 *	* logical size (in bytes)
+	 *	* physical (compressed) size (in bytes)
+	 *	* compression algorithm
+	 *	* object type (used to restore arc_buf_contents_t)
+	 *	* protected status (used for encryption)
+	 *	* prefetch status (used in l2arc_read_done())
+	 */
+	uint64_t		le_prop;
+	uint64_t		le_daddr;	/* buf location on l2dev */
+	/*
+	 * We pad the size of each entry to a power of 2 so that the size of
+	 * l2arc_log_blk_phys_t is power-of-2 aligned with SPA_MINBLOCKSHIFT,
+	 * because of the L2ARC_SET_*SIZE macros.
+	 */
+	uint64_t		le_pad[3];	/* pad to 64 bytes */
+} l2arc_log_ent_phys_t;
+
+#define	L2ARC_LOG_BLK_MAX_ENTRIES	(1022)
+
+/*
+ * A log block of up to 1022 ARC buffer log entries, chained into the
+ * persistent L2ARC metadata linked list.
+ */
+typedef struct l2arc_log_blk_phys {
+	uint64_t		lb_magic;	/* L2ARC_LOG_BLK_MAGIC */
+	/*
+	 * There are 2 chains (headed by dh_start_lbps[2]), and this field
+	 * points back to the previous block in this chain. We alternate
+	 * which chain we append to, so they are time-wise and offset-wise
+	 * interleaved, but that is an optimization rather than for
+	 * correctness.
+	 */
+	l2arc_log_blkptr_t	lb_prev_lbp;	/* pointer to prev log block */
+	/*
+	 * Pad header section to 128 bytes
+	 */
+	uint64_t		lb_pad[7];
+	/* Payload */
+	l2arc_log_ent_phys_t	lb_entries[L2ARC_LOG_BLK_MAX_ENTRIES];
+} l2arc_log_blk_phys_t;				/* 64K total */
+
+/*
+ * The size of l2arc_log_blk_phys_t has to be power-of-2 aligned with
+ * SPA_MINBLOCKSHIFT because of L2BLK_SET_*SIZE macros.
+ */
+CTASSERT_GLOBAL(IS_P2ALIGNED(sizeof (l2arc_log_blk_phys_t),
+    1ULL << SPA_MINBLOCKSHIFT));
+CTASSERT_GLOBAL(sizeof (l2arc_log_blk_phys_t) >= SPA_MINBLOCKSIZE);
+CTASSERT_GLOBAL(sizeof (l2arc_log_blk_phys_t) <= SPA_MAXBLOCKSIZE);
+
+/*
+ * These structures hold pointers to log blocks present on the L2ARC device.
+ */
+typedef struct l2arc_lb_ptr_buf {
+	l2arc_log_blkptr_t	*lb_ptr;
+	list_node_t		node;
+} l2arc_lb_ptr_buf_t;
+
+/* Macros for setting fields in le_prop and lbp_prop */
+#define	L2BLK_GET_LSIZE(field)	\
+	BF64_GET_SB((field), 0, SPA_LSIZEBITS, SPA_MINBLOCKSHIFT, 1)
+#define	L2BLK_SET_LSIZE(field, x)	\
+	BF64_SET_SB((field), 0, SPA_LSIZEBITS, SPA_MINBLOCKSHIFT, 1, x)
+#define	L2BLK_GET_PSIZE(field)	\
+	BF64_GET_SB((field), 16, SPA_PSIZEBITS, SPA_MINBLOCKSHIFT, 1)
+#define	L2BLK_SET_PSIZE(field, x)	\
+	BF64_SET_SB((field), 16, SPA_PSIZEBITS, SPA_MINBLOCKSHIFT, 1, x)
+#define	L2BLK_GET_COMPRESS(field)	\
+	BF64_GET((field), 32, SPA_COMPRESSBITS)
+#define	L2BLK_SET_COMPRESS(field, x)	\
+	BF64_SET((field), 32, SPA_COMPRESSBITS, x)
+#define	L2BLK_GET_PREFETCH(field)	BF64_GET((field), 39, 1)
+#define	L2BLK_SET_PREFETCH(field, x)	BF64_SET((field), 39, 1, x)
+#define	L2BLK_GET_CHECKSUM(field)	BF64_GET((field), 40, 8)
+#define	L2BLK_SET_CHECKSUM(field, x)	BF64_SET((field), 40, 8, x)
+#define	L2BLK_GET_TYPE(field)		BF64_GET((field), 48, 8)
+#define	L2BLK_SET_TYPE(field, x)	BF64_SET((field), 48, 8, x)
+#define	L2BLK_GET_PROTECTED(field)	BF64_GET((field), 56, 1)
+#define	L2BLK_SET_PROTECTED(field, x)	BF64_SET((field), 56, 1, x)
+
+
 typedef struct l2arc_dev {
 	vdev_t			*l2ad_vdev;	/* vdev */
 	spa_t			*l2ad_spa;	/* spa */
@@ -216,6 +423,32 @@ typedef struct l2arc_dev {
 	list_t			l2ad_buflist;	/* buffer list */
 	list_node_t		l2ad_node;	/* device list node */
 	zfs_refcount_t		l2ad_alloc;	/* allocated bytes */
+	/*
+	 * Persistence-related stuff
+	 */
+	l2arc_dev_hdr_phys_t	*l2ad_dev_hdr;	/* persistent device header */
+	uint64_t		l2ad_dev_hdr_asize; /* aligned hdr size */
+	l2arc_log_blk_phys_t	l2ad_log_blk;	/* currently open log block */
+	int			l2ad_log_ent_idx; /* index into cur log blk */
+	/* Number of bytes in current log block's payload */
+	uint64_t		l2ad_log_blk_payload_asize;
+	/*
+	 * Offset (in bytes) of the first buffer in current log block's
+	 * payload.
+	 */
+	uint64_t		l2ad_log_blk_payload_start;
+	/* Flag indicating whether a rebuild is scheduled or is going on */
+	boolean_t		l2ad_rebuild;
+	boolean_t		l2ad_rebuild_cancel;
+	boolean_t		l2ad_rebuild_began;
+	uint64_t		l2ad_log_entries; /* entries per log blk */
+	uint64_t		l2ad_evict;	/* evicted offset in bytes */
+	/* List of pointers to log blocks present in the L2ARC device */
+	list_t			l2ad_lbptr_list;
+	/* Aligned size of all log blocks present on the device */
+	uint64_t		l2ad_lb_asize;
+	/* Number of log blocks present on the device */
+	uint64_t		l2ad_lb_count;
 } l2arc_dev_t;
 
 typedef struct l2arc_buf_hdr {
@@ -238,6 +471,8 @@ struct arc_buf_hdr {
 	uint64_t		b_birth;
 
 	arc_buf_contents_t	b_type;
+	/* keep the header allocated, see buf_hash_find_lockless() */
+	uint32_t		b_pins;
 	arc_buf_hdr_t		*b_hash_next;
 	arc_flags_t		b_flags;
 
@@ -0,0 +1,89 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Interface declarations for BLAKE3 hashing.
+ *
+ * BLAKE3 was designed by Jack O'Connor, Jean-Philippe Aumasson, Samuel
+ * Neves and Zooko Wilcox-O'Hearn; see https://github.com/BLAKE3-team/BLAKE3.
+ * Only the 256-bit hash and keyed hash modes are provided.
+ */
+
+#ifndef	_SYS_BLAKE3_H
+#define	_SYS_BLAKE3_H
+
+#ifdef  _KERNEL
+#include <sys/types.h>
+#else
+#include <stdint.h>
+#include <stdlib.h>
+#endif
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define	BLAKE3_KEY_LEN		32
+#define	BLAKE3_OUT_LEN		32
+#define	BLAKE3_BLOCK_LEN	64
+#define	BLAKE3_CHUNK_LEN	1024
+#define	BLAKE3_MAX_DEPTH	54
+
+/*
+ * Largest subtree of whole chunks that is hashed in one go; the chaining
+ * values of its chunks are reduced in bctx_cv_buf.
+ */
+#define	BLAKE3_MAX_SUBTREE_CHUNKS	32
+
+typedef struct blake3_chunk_state {
+	uint32_t	cs_cv[8];
+	uint64_t	cs_chunk_counter;
+	uint8_t		cs_buf[BLAKE3_BLOCK_LEN];
+	uint8_t		cs_buf_len;
+	uint8_t		cs_blocks_compressed;
+	uint8_t		cs_flags;
+} blake3_chunk_state_t;
+
+/*
+ * The context is a few kilobytes, so callers in the kernel should not
+ * keep it on the stack.
+ */
+typedef struct blake3_ctx {
+	uint32_t		bctx_key[8];
+	blake3_chunk_state_t	bctx_chunk;
+	uint8_t			bctx_cv_stack_len;
+	uint8_t			bctx_cv_stack[(BLAKE3_MAX_DEPTH + 1) *
+	    BLAKE3_OUT_LEN];
+	uint8_t			bctx_cv_buf[BLAKE3_MAX_SUBTREE_CHUNKS *
+	    BLAKE3_OUT_LEN];
+	const void		*bctx_ops;	/* implementation in use */
+} BLAKE3_CTX;
+
+extern void Blake3_Init(BLAKE3_CTX *ctx);
+extern void Blake3_InitKeyed(BLAKE3_CTX *ctx, const uint8_t *key);
+extern void Blake3_Update(BLAKE3_CTX *ctx, const void *data, size_t len);
+extern void Blake3_Final(const BLAKE3_CTX *ctx, uint8_t *digest);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_BLAKE3_H */
@@ -41,10 +41,17 @@ int sha2_mod_fini(void);
 int skein_mod_init(void);
 int skein_mod_fini(void);
 
+void blake3_impl_init(void);
+void blake3_impl_fini(void);
+
 int icp_init(void);
 void icp_fini(void);
 
 int aes_impl_set(const char *);
 int gcm_impl_set(const char *);
+int sha256_impl_set(const char *);
+int sha512_impl_set(const char *);
+int sha256_mb_impl_set(const char *);
+int blake3_impl_set(const char *);
 
 #endif /* _SYS_CRYPTO_ALGS_H */
@@ -27,14 +27,34 @@
 #define	_SYS_DATASET_KSTATS_H
 
 #include <sys/aggsum.h>
+#include <sys/arc.h>
+#include <sys/avl.h>
 #include <sys/dmu.h>
 #include <sys/kstat.h>
+#include <sys/zil.h>
+
+/*
+ * Time spent delayed by the readlimit/writelimit/iopslimit throttles, and
+ * the latency of zil_commit(), are counted in buckets of up to 100us, 1ms,
+ * 10ms, 100ms, 1s and longer.
+ */
+#define	DATASET_LATENCY_BUCKETS	6
 
 typedef struct dataset_aggsum_stats_t {
 	aggsum_t das_writes;
 	aggsum_t das_nwritten;
 	aggsum_t das_reads;
 	aggsum_t das_nread;
+	aggsum_t das_compress_aborts;
+	aggsum_t das_compress_abort_bytes;
+	aggsum_t das_compress_abort_ns;
+	aggsum_t das_queue_issued;
+	aggsum_t das_queue_issued_bytes;
+	aggsum_t das_queue_wait_ns;
+	aggsum_t das_zil_commits;
+	aggsum_t das_zil_commit_itxs;
+	aggsum_t das_zil_commit_bytes;
+	aggsum_t das_zil_commit_ns[ZIL_COMMIT_STAGES];
 } dataset_aggsum_stats_t;
 
 typedef struct dataset_kstat_values {
@@ -43,17 +63,71 @@ typedef struct dataset_kstat_values {
 	kstat_named_t dkv_nwritten;
 	kstat_named_t dkv_reads;
 	kstat_named_t dkv_nread;
+	kstat_named_t dkv_compress_aborts;
+	kstat_named_t dkv_compress_abort_bytes;
+	kstat_named_t dkv_compress_abort_ns;
+	kstat_named_t dkv_queue_issued;
+	kstat_named_t dkv_queue_issued_bytes;
+	kstat_named_t dkv_queue_wait_ns;
+	kstat_named_t dkv_arc_size;
+	kstat_named_t dkv_read_throttle_ns;
+	kstat_named_t dkv_read_throttle[DATASET_LATENCY_BUCKETS];
+	kstat_named_t dkv_write_throttle_ns;
+	kstat_named_t dkv_write_throttle[DATASET_LATENCY_BUCKETS];
+	kstat_named_t dkv_zil_commits;
+	kstat_named_t dkv_zil_commit_itxs;
+	kstat_named_t dkv_zil_commit_bytes;
+	kstat_named_t dkv_zil_commit_ns[ZIL_COMMIT_STAGES];
+	kstat_named_t dkv_zil_commit[DATASET_LATENCY_BUCKETS];
 } dataset_kstat_values_t;
 
 typedef struct dataset_kstats {
 	dataset_aggsum_stats_t dk_aggsums;
 	kstat_t *dk_kstats;
+	arc_tenant_t *dk_arc_tenant;
+
+	/* throttle delays, indexed by write, updated atomically */
+	uint64_t dk_throttle_ns[2];
+	uint64_t dk_throttle[2][DATASET_LATENCY_BUCKETS];
+
+	/* zil_commit() latencies, updated atomically */
+	uint64_t dk_zil_commit[DATASET_LATENCY_BUCKETS];
+
+	/*
+	 * The vdev queue looks kstats up by pool and objset id in a global
+	 * tree as it creates a flow, since the i/os it queues carry no
+	 * objset_t (see dataset_kstats_attach() for the rest).
+	 */
+	struct spa *dk_spa;
+	uint64_t dk_objset_id;
+	boolean_t dk_registered;
+	avl_node_t dk_node;
+
+	/* holds of vdev queue flows, see dataset_kstats_hold() */
+	uint64_t dk_holds;
+	kmutex_t dk_hold_lock;
+	kcondvar_t dk_hold_cv;
 } dataset_kstats_t;
 
+void dataset_kstats_init(void);
+void dataset_kstats_fini(void);
+
 void dataset_kstats_create(dataset_kstats_t *, objset_t *);
 void dataset_kstats_destroy(dataset_kstats_t *);
+void dataset_kstats_attach(dataset_kstats_t *, objset_t *);
+void dataset_kstats_detach(dataset_kstats_t *, objset_t *);
 
 void dataset_kstats_update_write_kstats(dataset_kstats_t *, int64_t);
 void dataset_kstats_update_read_kstats(dataset_kstats_t *, int64_t);
+void dataset_kstats_update_throttle_kstats(dataset_kstats_t *, boolean_t,
+    hrtime_t);
+void dataset_kstats_update_compress_kstats(dataset_kstats_t *, uint64_t,
+    hrtime_t);
+dataset_kstats_t *dataset_kstats_hold(struct spa *, uint64_t);
+void dataset_kstats_rele(dataset_kstats_t *);
+void dataset_kstats_update_queue_kstats(dataset_kstats_t *, uint64_t,
+    hrtime_t);
+void dataset_kstats_update_zil_kstats(dataset_kstats_t *, uint64_t, uint64_t,
+    const hrtime_t *);
 
 #endif /* _SYS_DATASET_KSTATS_H */
@@ -156,6 +156,13 @@ typedef struct dbuf_dirty_record {
 			boolean_t dr_nopwrite;
 			boolean_t dr_has_raw_params;
 
+			/*
+			 * dr_direct is set when dr_overridden_by was written
+			 * by dmu_write_direct(), in which case dr_data may be
+			 * NULL since the data was never copied into the dbuf.
+			 */
+			boolean_t dr_direct;
+
 			/*
 			 * If dr_has_raw_params is set, the following crypt
 			 * params will be set on the BP that's written.
@@ -332,6 +339,9 @@ void dmu_buf_write_embedded(dmu_buf_t *dbuf, void *data,
 void dbuf_destroy(dmu_buf_impl_t *db);
 
 void dbuf_unoverride(dbuf_dirty_record_t *dr);
+boolean_t dbuf_direct_read_bp(dmu_buf_impl_t *db, blkptr_t *bp);
+dbuf_dirty_record_t *dbuf_direct_dirty(dmu_buf_impl_t *db, dmu_tx_t *tx);
+void dbuf_direct_fallback(dbuf_dirty_record_t *dr, abd_t *data);
 void dbuf_sync_list(list_t *list, int level, dmu_tx_t *tx);
 void dbuf_release_bp(dmu_buf_impl_t *db);
 
@@ -364,6 +374,10 @@ boolean_t dbuf_is_metadata(dmu_buf_impl_t *db);
 	(dbuf_is_metadata(_db) &&					\
 	((_db)->db_objset->os_primary_cache == ZFS_CACHE_METADATA)))
 
+#define	DBUF_IS_SCAN_CACHED(_db)					\
+	((_db)->db_objset->os_scan_cache == ZFS_SCANCACHE_COLD &&	\
+	!dbuf_is_metadata(_db))
+
 #define	DBUF_IS_L2CACHEABLE(_db)					\
 	((_db)->db_objset->os_secondary_cache == ZFS_CACHE_ALL ||	\
 	(dbuf_is_metadata(_db) &&					\
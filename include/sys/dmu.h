@@ -70,6 +70,7 @@ struct zbookmark_phys;
 struct spa;
 struct nvlist;
 struct arc_buf;
+struct abd;
 struct zio_prop;
 struct sa_handle;
 struct dsl_crypto_params;
@@ -836,6 +837,10 @@ void dmu_write_by_dnode(dnode_t *dn, uint64_t offset, uint64_t size,
     const void *buf, dmu_tx_t *tx);
 void dmu_prealloc(objset_t *os, uint64_t object, uint64_t offset, uint64_t size,
 	dmu_tx_t *tx);
+int dmu_read_direct(dmu_buf_t *zdb, uint64_t offset, uint64_t size,
+    struct abd *data);
+int dmu_write_direct(dmu_buf_t *zdb, uint64_t offset, uint64_t size,
+    struct abd *data, dmu_tx_t *tx);
 #ifdef _KERNEL
 #include <linux/blkdev_compat.h>
 int dmu_read_uio(objset_t *os, uint64_t object, struct uio *uio, uint64_t size);
@@ -996,6 +1001,7 @@ extern uint64_t dmu_objset_id(objset_t *os);
 extern uint64_t dmu_objset_dnodesize(objset_t *os);
 extern zfs_sync_type_t dmu_objset_syncprop(objset_t *os);
 extern zfs_logbias_op_t dmu_objset_logbias(objset_t *os);
+extern zfs_direct_type_t dmu_objset_direct(objset_t *os);
 extern int dmu_snapshot_list_next(objset_t *os, int namelen, char *name,
     uint64_t *id, uint64_t *offp, boolean_t *case_conflict);
 extern int dmu_snapshot_lookup(objset_t *os, const char *name, uint64_t *val);
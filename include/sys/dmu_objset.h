@@ -85,8 +85,10 @@ typedef struct objset_phys {
 	dnode_phys_t os_userused_dnode;
 	dnode_phys_t os_groupused_dnode;
 	dnode_phys_t os_projectused_dnode;
+	zil_chain_head_t os_zil_chains[ZIL_MAX_CHAINS - 1];
 	char os_pad1[OBJSET_PHYS_SIZE_V3 - OBJSET_PHYS_SIZE_V2 -
-	    sizeof (dnode_phys_t)];
+	    sizeof (dnode_phys_t) -
+	    sizeof (zil_chain_head_t) * (ZIL_MAX_CHAINS - 1)];
 } objset_phys_t;
 
 typedef int (*dmu_objset_upgrade_cb_t)(objset_t *);
@@ -124,7 +126,10 @@ struct objset {
 	zfs_logbias_op_t os_logbias;
 	zfs_cache_type_t os_primary_cache;
 	zfs_cache_type_t os_secondary_cache;
+	zfs_scancache_type_t os_scan_cache;
+	struct arc_tenant *os_arc_tenant;	/* ARC accounting */
 	zfs_sync_type_t os_sync;
+	zfs_direct_type_t os_direct;
 	zfs_redundant_metadata_type_t os_redundant_metadata;
 	int os_recordsize;
 	/*
@@ -152,6 +157,7 @@ struct objset {
 	/* no lock needed: */
 	struct dmu_tx *os_synctx; /* XXX sketchy */
 	zil_header_t os_zil_header;
+	zil_chain_head_t os_zil_chains[ZIL_MAX_CHAINS - 1];
 	multilist_t *os_synced_dnodes;
 	uint64_t os_flags;
 	uint64_t os_freed_dnodes;
@@ -181,8 +187,22 @@ struct objset {
 	/* stuff we store for the user */
 	kmutex_t os_user_ptr_lock;
 	void *os_user_ptr;
+	struct dataset_kstats *os_kstats; /* see dataset_kstats_attach() */
 	sa_os_t *os_sa;
 
+	/*
+	 * readlimit/writelimit/iopslimit throttles.  The limits can change
+	 * under dsl_dir's locks; the time each throttle is next due to
+	 * admit an I/O is protected by os_iolimit_lock.
+	 */
+	uint64_t os_readlimit;
+	uint64_t os_writelimit;
+	uint64_t os_iopslimit;
+	kmutex_t os_iolimit_lock;
+	hrtime_t os_read_next;
+	hrtime_t os_write_next;
+	hrtime_t os_iops_next;
+
 	/* kernel thread to upgrade this dataset */
 	kmutex_t os_upgrade_lock;
 	taskqid_t os_upgrade_id;
@@ -259,6 +279,9 @@ int dmu_fsname(const char *snapname, char *buf);
 
 void dmu_objset_evict_done(objset_t *os);
 void dmu_objset_willuse_space(objset_t *os, int64_t space, dmu_tx_t *tx);
+hrtime_t dmu_objset_iolimit(objset_t *os, boolean_t write, uint64_t bytes);
+hrtime_t dmu_objset_iolimit_wakeup(objset_t *os, boolean_t write,
+    uint64_t bytes);
 
 void dmu_objset_init(void);
 void dmu_objset_fini(void);
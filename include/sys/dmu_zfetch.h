@@ -41,6 +41,7 @@ extern unsigned long	zfetch_array_rd_sz;
 struct dnode;				/* so we can reference dnode */
 
 typedef struct zstream {
+	uint64_t	zs_start_blkid;	/* first blkid accessed by stream */
 	uint64_t	zs_blkid;	/* expect next access at this blkid */
 	uint64_t	zs_pf_blkid;	/* next block to prefetch */
 
@@ -442,6 +442,10 @@ boolean_t dnode_needs_remap(const dnode_t *dn);
 	(DMU_OT_IS_METADATA((_dn)->dn_type) &&				\
 	(_dn)->dn_objset->os_primary_cache == ZFS_CACHE_METADATA))
 
+#define	DNODE_IS_SCAN_CACHED(_dn)					\
+	((_dn)->dn_objset->os_scan_cache == ZFS_SCANCACHE_COLD &&	\
+	!DMU_OT_IS_METADATA((_dn)->dn_type))
+
 #define	DNODE_META_IS_CACHEABLE(_dn)					\
 	((_dn)->dn_objset->os_primary_cache == ZFS_CACHE_ALL ||		\
 	(_dn)->dn_objset->os_primary_cache == ZFS_CACHE_METADATA)
@@ -183,6 +183,13 @@ typedef enum {
 	ZFS_PROP_KEYSTATUS,
 	ZFS_PROP_REMAPTXG,		/* not exposed to the user */
 	ZFS_PROP_SPECIAL_SMALL_BLOCKS,
+	ZFS_PROP_SCANCACHE,
+	ZFS_PROP_ARC_QUOTA,
+	ZFS_PROP_ARC_RESERVE,
+	ZFS_PROP_DIRECT,
+	ZFS_PROP_READLIMIT,
+	ZFS_PROP_WRITELIMIT,
+	ZFS_PROP_IOPSLIMIT,
 	ZFS_NUM_PROPS
 } zfs_prop_t;
 
@@ -243,6 +250,7 @@ typedef enum {
 	ZPOOL_PROP_MULTIHOST,
 	ZPOOL_PROP_CHECKPOINT,
 	ZPOOL_PROP_LOAD_GUID,
+	ZPOOL_PROP_AUTOTRIM,
 	ZPOOL_NUM_PROPS
 } zpool_prop_t;
 
@@ -395,12 +403,24 @@ typedef enum zfs_cache_type {
 	ZFS_CACHE_ALL = 2
 } zfs_cache_type_t;
 
+typedef enum {
+	ZFS_SCANCACHE_AUTO = 0,
+	ZFS_SCANCACHE_COLD = 1,
+	ZFS_SCANCACHE_NORMAL = 2
+} zfs_scancache_type_t;
+
 typedef enum {
 	ZFS_SYNC_STANDARD = 0,
 	ZFS_SYNC_ALWAYS = 1,
 	ZFS_SYNC_DISABLED = 2
 } zfs_sync_type_t;
 
+typedef enum {
+	ZFS_DIRECT_STANDARD = 0,
+	ZFS_DIRECT_ALWAYS = 1,
+	ZFS_DIRECT_DISABLED = 2
+} zfs_direct_type_t;
+
 typedef enum {
 	ZFS_XATTR_OFF = 0,
 	ZFS_XATTR_DIR = 1,
@@ -642,6 +662,16 @@ typedef struct zpool_load_policy {
 #define	ZPOOL_CONFIG_VDEV_ASYNC_W_PEND_QUEUE	"vdev_async_w_pend_queue"
 #define	ZPOOL_CONFIG_VDEV_SCRUB_PEND_QUEUE	"vdev_async_scrub_pend_queue"
 
+/* Queue depths */
+#define	ZPOOL_CONFIG_VDEV_SYNC_R_MAX_QUEUE	"vdev_sync_r_max_queue"
+#define	ZPOOL_CONFIG_VDEV_SYNC_W_MAX_QUEUE	"vdev_sync_w_max_queue"
+#define	ZPOOL_CONFIG_VDEV_ASYNC_R_MAX_QUEUE	"vdev_async_r_max_queue"
+#define	ZPOOL_CONFIG_VDEV_ASYNC_W_MAX_QUEUE	"vdev_async_w_max_queue"
+#define	ZPOOL_CONFIG_VDEV_SCRUB_MAX_QUEUE	"vdev_async_scrub_max_queue"
+
+/* Allocation weight of a top-level vdev, as a percentage */
+#define	ZPOOL_CONFIG_VDEV_ALLOC_WEIGHT	"vdev_alloc_weight"
+
 /* Latency read/write histogram stats */
 #define	ZPOOL_CONFIG_VDEV_TOT_R_LAT_HISTO	"vdev_tot_r_lat_histo"
 #define	ZPOOL_CONFIG_VDEV_TOT_W_LAT_HISTO	"vdev_tot_w_lat_histo"
@@ -665,6 +695,13 @@ typedef struct zpool_load_policy {
 #define	ZPOOL_CONFIG_VDEV_ASYNC_AGG_W_HISTO	"vdev_async_agg_w_histo"
 #define	ZPOOL_CONFIG_VDEV_AGG_SCRUB_HISTO	"vdev_agg_scrub_histo"
 
+/* zil_commit() latency histograms, only present for the root vdev */
+#define	ZPOOL_CONFIG_ZIL_COMMIT_LAT_HISTO	"zil_commit_lat_histo"
+#define	ZPOOL_CONFIG_ZIL_GATHER_LAT_HISTO	"zil_gather_lat_histo"
+#define	ZPOOL_CONFIG_ZIL_ISSUE_LAT_HISTO	"zil_issue_lat_histo"
+#define	ZPOOL_CONFIG_ZIL_WAIT_LAT_HISTO		"zil_wait_lat_histo"
+#define	ZPOOL_CONFIG_ZIL_FLUSH_LAT_HISTO	"zil_flush_lat_histo"
+
 /* vdev enclosure sysfs path */
 #define	ZPOOL_CONFIG_VDEV_ENC_SYSFS_PATH	"vdev_enc_sysfs_path"
 
@@ -885,6 +922,32 @@ typedef enum {
 	CS_NUM_STATES
 } checkpoint_state_t;
 
+/*
+ * Trim functions.
+ */
+typedef enum pool_trim_func {
+	POOL_TRIM_START,
+	POOL_TRIM_CANCEL,
+	POOL_TRIM_SUSPEND,
+	POOL_TRIM_FUNCS
+} pool_trim_func_t;
+
+/*
+ * State of a manual trim of a top-level vdev.
+ */
+typedef enum vdev_trim_state {
+	VDEV_TRIM_NONE,
+	VDEV_TRIM_ACTIVE,
+	VDEV_TRIM_CANCELED,
+	VDEV_TRIM_SUSPENDED,
+	VDEV_TRIM_COMPLETE
+} vdev_trim_state_t;
+
+typedef enum {
+	ZPOOL_AUTOTRIM_OFF = 0,
+	ZPOOL_AUTOTRIM_ON
+} zpool_autotrim_t;
+
 typedef struct pool_checkpoint_stat {
 	uint64_t pcs_state;		/* checkpoint_state_t */
 	uint64_t pcs_start_time;	/* time checkpoint/discard started */
@@ -901,9 +964,18 @@ typedef enum zio_type {
 	ZIO_TYPE_FREE,
 	ZIO_TYPE_CLAIM,
 	ZIO_TYPE_IOCTL,
+	ZIO_TYPE_TRIM,
 	ZIO_TYPES
 } zio_type_t;
 
+/*
+ * The number of zio types reported in vdev_stat_t.  This is fixed so that
+ * the layout of the vdev_stat_t array exchanged with userland does not
+ * change when new zio types are added; the counts of any newer types are
+ * folded into ZIO_TYPE_IOCTL.
+ */
+#define	VS_ZIO_TYPES	6
+
 /*
  * Pool statistics.  Note: all fields should be 64-bit because this
  * is passed between kernel and userland as an nvlist uint64 array.
@@ -978,8 +1050,8 @@ typedef struct vdev_stat {
 	uint64_t	vs_dspace;		/* deflated capacity	*/
 	uint64_t	vs_rsize;		/* replaceable dev size */
 	uint64_t	vs_esize;		/* expandable dev size */
-	uint64_t	vs_ops[ZIO_TYPES];	/* operation count	*/
-	uint64_t	vs_bytes[ZIO_TYPES];	/* bytes read/written	*/
+	uint64_t	vs_ops[VS_ZIO_TYPES];	/* operation count	*/
+	uint64_t	vs_bytes[VS_ZIO_TYPES];	/* bytes read/written	*/
 	uint64_t	vs_read_errors;		/* read errors		*/
 	uint64_t	vs_write_errors;	/* write errors		*/
 	uint64_t	vs_checksum_errors;	/* checksum errors	*/
@@ -988,6 +1060,12 @@ typedef struct vdev_stat {
 	uint64_t	vs_scan_processed;	/* scan processed bytes	*/
 	uint64_t	vs_fragmentation;	/* device fragmentation */
 	uint64_t	vs_checkpoint_space;    /* checkpoint-consumed space */
+	uint64_t	vs_trim_state;		/* vdev_trim_state_t	*/
+	uint64_t	vs_trim_action_time;	/* time of last trim action */
+	uint64_t	vs_trim_bytes_done;	/* bytes trimmed	*/
+	uint64_t	vs_trim_bytes_est;	/* total bytes to trim	*/
+	uint64_t	vs_trim_rate;		/* requested rate (bytes/s) */
+	uint64_t	vs_trim_notsup;		/* discard not supported */
 } vdev_stat_t;
 
 /*
@@ -1004,6 +1082,9 @@ typedef struct vdev_stat_ex {
 	/* Number of ZIOs pending to be issued to disk */
 	uint64_t vsx_pend_queue[ZIO_PRIORITY_NUM_QUEUEABLE];
 
+	/* Number of ZIOs which may currently be issued to disk */
+	uint64_t vsx_max_queue[ZIO_PRIORITY_NUM_QUEUEABLE];
+
 	/*
 	 * Below are the histograms for various latencies. Buckets are in
 	 * units of nanoseconds.
@@ -1177,6 +1258,7 @@ typedef enum zfs_ioc {
 	ZFS_IOC_REMAP,				/* 0x5a4c */
 	ZFS_IOC_POOL_CHECKPOINT,		/* 0x5a4d */
 	ZFS_IOC_POOL_DISCARD_CHECKPOINT,	/* 0x5a4e */
+	ZFS_IOC_POOL_TRIM,			/* 0x5a4f */
 
 	/*
 	 * Linux - 3/64 numbers reserved.
@@ -1270,6 +1352,13 @@ typedef enum {
  */
 #define	ZPOOL_HIDDEN_ARGS	"hidden_args"
 
+/*
+ * The following are names used when invoking ZFS_IOC_POOL_TRIM.
+ */
+#define	ZPOOL_TRIM_COMMAND	"trim_command"
+#define	ZPOOL_TRIM_VDEVS	"trim_vdevs"
+#define	ZPOOL_TRIM_RATE		"trim_rate"
+
 /*
  * Flags for ZFS_IOC_VDEV_SET_STATE
  */
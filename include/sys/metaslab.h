@@ -105,6 +105,7 @@ uint64_t metaslab_class_get_alloc(metaslab_class_t *);
 uint64_t metaslab_class_get_space(metaslab_class_t *);
 uint64_t metaslab_class_get_dspace(metaslab_class_t *);
 uint64_t metaslab_class_get_deferred(metaslab_class_t *);
+void metaslab_class_perf_update(metaslab_class_t *);
 
 metaslab_group_t *metaslab_group_create(metaslab_class_t *, vdev_t *, int);
 void metaslab_group_destroy(metaslab_group_t *);
@@ -118,6 +119,8 @@ void metaslab_group_histogram_remove(metaslab_group_t *, metaslab_t *);
 void metaslab_group_alloc_decrement(spa_t *, uint64_t, void *, int, int,
     boolean_t);
 void metaslab_group_alloc_verify(spa_t *, const blkptr_t *, void *, int);
+void metaslab_group_perf_sample(metaslab_group_t *, uint64_t, hrtime_t);
+uint64_t metaslab_group_perf_scale(metaslab_group_t *, uint64_t);
 
 #ifdef	__cplusplus
 }
@@ -68,7 +68,8 @@ typedef enum trace_alloc_type {
 	TRACE_GROUP_FAILURE	= -5ULL,
 	TRACE_ENOSPC		= -6ULL,
 	TRACE_CONDENSING	= -7ULL,
-	TRACE_VDEV_ERROR	= -8ULL
+	TRACE_VDEV_ERROR	= -8ULL,
+	TRACE_TRIMMING		= -9ULL
 } trace_alloc_type_t;
 
 #define	METASLAB_WEIGHT_PRIMARY		(1ULL << 63)
@@ -270,6 +271,21 @@ struct metaslab_group {
 	uint64_t		mg_failed_allocations;
 	uint64_t		mg_fragmentation;
 	uint64_t		mg_histogram[RANGE_TREE_HISTOGRAM_SIZE];
+
+	/*
+	 * The async write throughput of the group is measured each txg, from
+	 * when its first write is queued until its last write completes.  The
+	 * smoothed rate is compared with that of the other groups in the class
+	 * by metaslab_class_perf_update(), and the resulting weight scales the
+	 * group's allocation throttle queue depths and share of the rotor, so
+	 * faster groups absorb more of each txg.  A weight of 100 means the
+	 * group is as fast as the class average.
+	 */
+	uint64_t		mg_perf_bytes;
+	hrtime_t		mg_perf_start;
+	hrtime_t		mg_perf_end;
+	uint64_t		mg_perf_rate;		/* bytes per second */
+	uint64_t		mg_perf_weight;		/* percent */
 };
 
 /*
@@ -332,6 +348,13 @@ struct metaslab_group {
  * metaslab needs to condense then we must set the ms_condensing flag to
  * ensure that allocations are not performed on the metaslab that is
  * being written.
+ *
+ * When autotrim is enabled, the segments moved from ms_defer[] back into
+ * circulation are also added to ms_trim.  The trim threads periodically
+ * take the contents of ms_trim (or, for a manual trim, a copy of
+ * ms_allocatable) and discard it.  Allocations clear the allocated range
+ * from ms_trim, and while a trim of the metaslab is in flight ms_trimming
+ * is held so that none of the ranges being discarded can be allocated.
  */
 struct metaslab {
 	kmutex_t	ms_lock;
@@ -355,9 +378,11 @@ struct metaslab {
 	range_tree_t	*ms_freed;	/* already freed this syncing txg */
 	range_tree_t	*ms_defer[TXG_DEFER_SIZE];
 	range_tree_t	*ms_checkpointing; /* to add to the checkpoint */
+	range_tree_t	*ms_trim;	/* freed ranges awaiting autotrim */
 
 	boolean_t	ms_condensing;	/* condensing? */
 	boolean_t	ms_condense_wanted;
+	uint64_t	ms_trimming;	/* # of trims in flight */
 	uint64_t	ms_condense_checked_txg;
 
 	/*
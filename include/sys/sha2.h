@@ -94,6 +94,23 @@ typedef SHA2_CTX SHA256_CTX;
 typedef SHA2_CTX SHA384_CTX;
 typedef SHA2_CTX SHA512_CTX;
 
+#define	SHA256_BLOCK_LENGTH	64	/* SHA256 block length in bytes */
+#define	SHA256_MB_MAX_LANES	16	/* messages hashed in parallel */
+
+/*
+ * Context for hashing several messages with SHA256 in parallel.  The
+ * state is kept transposed, one row of lanes per state word, which is
+ * the layout the multi-buffer block transforms work on.
+ */
+typedef struct {
+	uint32_t	state[8][SHA256_MB_MAX_LANES];
+	uint64_t	count[SHA256_MB_MAX_LANES];	/* bytes hashed */
+	uint32_t	idle[8][SHA256_MB_MAX_LANES];	/* set aside state */
+	uint8_t		pad[SHA256_MB_MAX_LANES][64];	/* partial blocks */
+	size_t		buffered;	/* bytes in each partial block */
+	int		lanes;
+} SHA256_MB_CTX;
+
 extern void SHA2Init(uint64_t mech, SHA2_CTX *);
 
 extern void SHA2Update(SHA2_CTX *, const void *, size_t);
@@ -118,6 +135,14 @@ extern void SHA512Update(SHA512_CTX *, const void *, size_t);
 
 extern void SHA512Final(void *, SHA512_CTX *);
 
+extern size_t SHA256MBDegree(void);
+
+extern void SHA256MBInit(SHA256_MB_CTX *, int);
+
+extern void SHA256MBUpdate(SHA256_MB_CTX *, const void **, size_t);
+
+extern void SHA256MBFinal(void *, SHA256_MB_CTX *);
+
 #ifdef _SHA2_IMPL
 /*
  * The following types/functions are all private to the implementation
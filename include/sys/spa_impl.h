@@ -48,6 +48,7 @@
 #include <sys/dsl_crypt.h>
 #include <sys/zfeature.h>
 #include <sys/zthr.h>
+#include <sys/zil.h>
 #include <zfeature_common.h>
 
 #ifdef	__cplusplus
@@ -174,6 +175,21 @@ typedef enum spa_proc_state {
 	SPA_PROC_GONE		/* spa_thread() is exiting, spa_proc = &p0 */
 } spa_proc_state_t;
 
+/*
+ * Writes waiting for a full batch of blocks to checksum at once.  The
+ * flush task checksums whatever has been gathered once the issue taskq
+ * gets to it, so a write is never held back for long.
+ */
+typedef struct spa_cksum_batch {
+	kmutex_t	scb_lock;
+	int		scb_count;
+	boolean_t	scb_flush_pending;
+	zio_t		*scb_zios[ZIO_CHECKSUM_MANY_MAX];
+	taskq_ent_t	scb_flush_ent;
+	spa_t		*scb_spa;
+	enum zio_checksum scb_checksum;
+} spa_cksum_batch_t;
+
 typedef struct spa_taskqs {
 	uint_t stqs_count;
 	taskq_t **stqs_taskq;
@@ -264,6 +280,8 @@ struct spa {
 	/* checksum context templates */
 	kmutex_t	spa_cksum_tmpls_lock;
 	void		*spa_cksum_tmpls[ZIO_CHECKSUM_FUNCTIONS];
+	/* writes gathered for multi-block checksumming */
+	spa_cksum_batch_t spa_cksum_batch[ZIO_CHECKSUM_FUNCTIONS];
 	uberblock_t	spa_ubsync;		/* last synced uberblock */
 	uberblock_t	spa_uberblock;		/* current uberblock */
 	boolean_t	spa_extreme_rewind;	/* rewind past deferred frees */
@@ -340,6 +358,7 @@ struct spa {
 	int		spa_mode;		/* FREAD | FWRITE */
 	spa_log_state_t spa_log_state;		/* log state */
 	uint64_t	spa_autoexpand;		/* lun expansion on/off */
+	uint64_t	spa_autotrim;		/* automatic background trim? */
 	ddt_t		*spa_ddt[ZIO_CHECKSUM_FUNCTIONS]; /* in-core DDTs */
 	uint64_t	spa_ddt_stat_object;	/* DDT statistics */
 	uint64_t	spa_dedup_dspace;	/* Cache get_dedup_dspace() */
@@ -373,6 +392,8 @@ struct spa {
 	spa_avz_action_t	spa_avz_action;	/* destroy/rebuild AVZ? */
 	uint64_t	spa_errata;		/* errata issues detected */
 	spa_stats_t	spa_stats;		/* assorted spa statistics */
+	/* zil_commit() latencies, see zil_commit_impl() */
+	uint64_t	spa_zil_histo[ZIL_COMMIT_STAGES][VDEV_L_HISTO_BUCKETS];
 	spa_keystore_t	spa_keystore;		/* loaded crypto keys */
 
 	/* arc_memory_throttle() parameters during low memory condition */
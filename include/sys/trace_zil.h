@@ -71,7 +71,7 @@
 		__entry->zl_parse_lr_seq	= zilog->zl_parse_lr_seq;   \
 		__entry->zl_parse_blk_count	= zilog->zl_parse_blk_count;\
 		__entry->zl_parse_lr_count	= zilog->zl_parse_lr_count; \
-		__entry->zl_cur_used	= zilog->zl_cur_used;		    \
+		__entry->zl_cur_used	= zilog->zl_chains[0].zlc_cur_used; \
 		__entry->zl_replay_time	= zilog->zl_replay_time;	    \
 		__entry->zl_replay_blks	= zilog->zl_replay_blks;
 
@@ -132,17 +132,35 @@
 		__field(lwb_t *,	zcw_lwb)			    \
 		__field(boolean_t,	zcw_done)			    \
 		__field(int,		zcw_zio_error)			    \
+		__field(uint64_t,	zcw_nitxs)			    \
+		__field(uint64_t,	zcw_nbytes)			    \
+		__field(hrtime_t,	zcw_total)			    \
+		__field(hrtime_t,	zcw_gather)			    \
+		__field(hrtime_t,	zcw_issue)			    \
+		__field(hrtime_t,	zcw_wait)			    \
+		__field(hrtime_t,	zcw_flush)
 
 #define	ZCW_TP_FAST_ASSIGN						    \
 		__entry->zcw_lwb		= zcw->zcw_lwb;		    \
 		__entry->zcw_done		= zcw->zcw_done;	    \
-		__entry->zcw_zio_error		= zcw->zcw_zio_error;
+		__entry->zcw_zio_error		= zcw->zcw_zio_error;	    \
+		__entry->zcw_nitxs		= zcw->zcw_nitxs;	    \
+		__entry->zcw_nbytes		= zcw->zcw_nbytes;	    \
+		__entry->zcw_total	= zcw->zcw_time[ZIL_COMMIT_TOTAL];  \
+		__entry->zcw_gather	= zcw->zcw_time[ZIL_COMMIT_GATHER]; \
+		__entry->zcw_issue	= zcw->zcw_time[ZIL_COMMIT_ISSUE];  \
+		__entry->zcw_wait	= zcw->zcw_time[ZIL_COMMIT_WAIT];   \
+		__entry->zcw_flush	= zcw->zcw_time[ZIL_COMMIT_FLUSH];
 
 #define	ZCW_TP_PRINTK_FMT						    \
-	"zcw { lwb %p done %u error %u }"
+	"zcw { lwb %p done %u error %u nitxs %llu nbytes %llu "	    \
+	"total %lld gather %lld issue %lld wait %lld flush %lld }"
 
 #define	ZCW_TP_PRINTK_ARGS						    \
-	    __entry->zcw_lwb, __entry->zcw_done, __entry->zcw_zio_error
+	    __entry->zcw_lwb, __entry->zcw_done, __entry->zcw_zio_error,   \
+	    __entry->zcw_nitxs, __entry->zcw_nbytes, __entry->zcw_total,    \
+	    __entry->zcw_gather, __entry->zcw_issue, __entry->zcw_wait,	    \
+	    __entry->zcw_flush
 
 /*
  * Generic support for two argument tracepoints of the form:
@@ -186,7 +204,7 @@ DEFINE_ZIL_PROCESS_ITX_EVENT(zfs_zil__process__normal__itx);
  *     zil_commit_waiter_t *, ...);
  */
 /* BEGIN CSTYLED */
-DECLARE_EVENT_CLASS(zfs_zil_commit_io_error_class,
+DECLARE_EVENT_CLASS(zfs_zil_commit_class,
 	TP_PROTO(zilog_t *zilog, zil_commit_waiter_t *zcw),
 	TP_ARGS(zilog, zcw),
 	TP_STRUCT__entry(
@@ -203,11 +221,12 @@ DECLARE_EVENT_CLASS(zfs_zil_commit_io_error_class,
 );
 
 /* BEGIN CSTYLED */
-#define	DEFINE_ZIL_COMMIT_IO_ERROR_EVENT(name) \
-DEFINE_EVENT(zfs_zil_commit_io_error_class, name, \
+#define	DEFINE_ZIL_COMMIT_EVENT(name) \
+DEFINE_EVENT(zfs_zil_commit_class, name, \
 	TP_PROTO(zilog_t *zilog, zil_commit_waiter_t *zcw), \
 	TP_ARGS(zilog, zcw))
-DEFINE_ZIL_COMMIT_IO_ERROR_EVENT(zfs_zil__commit__io__error);
+DEFINE_ZIL_COMMIT_EVENT(zfs_zil__commit__done);
+DEFINE_ZIL_COMMIT_EVENT(zfs_zil__commit__io__error);
 /* END CSTYLED */
 
 #endif /* _TRACE_ZIL_H */
@@ -132,15 +132,20 @@ extern void vdev_cache_fini(vdev_t *vd);
 extern boolean_t vdev_cache_read(zio_t *zio);
 extern void vdev_cache_write(zio_t *zio);
 extern void vdev_cache_purge(vdev_t *vd);
+extern void vdev_cache_hint(spa_t *spa, const blkptr_t *bp);
 
 extern void vdev_queue_init(vdev_t *vd);
 extern void vdev_queue_fini(vdev_t *vd);
+extern void vdev_queue_cache_init(void);
+extern void vdev_queue_cache_fini(void);
 extern zio_t *vdev_queue_io(zio_t *zio);
 extern void vdev_queue_io_done(zio_t *zio);
 extern void vdev_queue_change_io_priority(zio_t *zio, zio_priority_t priority);
 
 extern int vdev_queue_length(vdev_t *vd);
 extern uint64_t vdev_queue_last_offset(vdev_t *vd);
+extern hrtime_t vdev_queue_latency(vdev_t *vd);
+extern int vdev_queue_max_active(vdev_t *vd, zio_priority_t p);
 
 extern void vdev_config_dirty(vdev_t *vd);
 extern void vdev_config_clean(vdev_t *vd);
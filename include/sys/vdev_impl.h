@@ -58,6 +58,7 @@ extern "C" {
 typedef struct vdev_queue vdev_queue_t;
 typedef struct vdev_cache vdev_cache_t;
 typedef struct vdev_cache_entry vdev_cache_entry_t;
+typedef struct vdev_cache_hint vdev_cache_hint_t;
 struct abd;
 
 extern int zfs_vdev_queue_depth_pct;
@@ -82,6 +83,12 @@ typedef void	vdev_remap_cb_t(uint64_t inner_offset, vdev_t *vd,
     uint64_t offset, uint64_t size, void *arg);
 typedef void	vdev_remap_func_t(vdev_t *vd, uint64_t offset, uint64_t size,
     vdev_remap_cb_t callback, void *arg);
+/*
+ * Given a target vdev, translates the logical range "in" to the physical
+ * range "res"
+ */
+typedef void vdev_xlation_func_t(vdev_t *cvd, const range_seg_t *in,
+    range_seg_t *res);
 
 typedef const struct vdev_ops {
 	vdev_open_func_t		*vdev_op_open;
@@ -94,6 +101,11 @@ typedef const struct vdev_ops {
 	vdev_hold_func_t		*vdev_op_hold;
 	vdev_rele_func_t		*vdev_op_rele;
 	vdev_remap_func_t		*vdev_op_remap;
+	/*
+	 * For translating ranges from non-leaf vdevs (e.g. raidz) to leaves.
+	 * Used when trimming free space.
+	 */
+	vdev_xlation_func_t		*vdev_op_xlate;
 	char				vdev_op_type[16];
 	boolean_t			vdev_op_leaf;
 } vdev_ops_t;
@@ -110,12 +122,23 @@ struct vdev_cache_entry {
 	uint32_t	ve_hits;
 	uint16_t	ve_missed_update;
 	zio_t		*ve_fill_io;
+	uint64_t	ve_used;
+};
+
+struct vdev_cache_hint {
+	uint64_t	vch_offset;
+	uint64_t	vch_size;
+	avl_node_t	vch_offset_node;
+	list_node_t	vch_list_node;
 };
 
 struct vdev_cache {
 	avl_tree_t	vc_offset_tree;
 	avl_tree_t	vc_lastused_tree;
 	kmutex_t	vc_lock;
+	avl_tree_t	vc_hint_tree;	/* hints by offset, top-level only */
+	list_t		vc_hint_list;	/* hints, oldest first */
+	kmutex_t	vc_hint_lock;
 };
 
 typedef struct vdev_queue_class {
@@ -126,17 +149,57 @@ typedef struct vdev_queue_class {
 	 * LBA-ordered vs FIFO.
 	 */
 	avl_tree_t	vqc_queued_tree;
+
+	/*
+	 * Adaptive queue depth, see vdev_queue_adapt().  The latency sum
+	 * and count cover the current adjustment interval only.
+	 */
+	uint32_t	vqc_max_active;	/* 0 until first adjustment */
+	boolean_t	vqc_limited;	/* i/o held back by vqc_max_active */
+	uint64_t	vqc_lat_count;
+	hrtime_t	vqc_lat_sum;
+	hrtime_t	vqc_lat_base;	/* uncongested service time */
+
+	/*
+	 * Fair queueing, see vdev_queue_fair_to_issue().  Flows with i/os
+	 * of this class queued are kept on vqc_flow_list in round-robin
+	 * order.  I/Os queued while fair queueing was disabled have no
+	 * flow, and are counted by vqc_unflowed.
+	 */
+	list_t		vqc_flow_list;
+	uint32_t	vqc_unflowed;
 } vdev_queue_class_t;
 
+/*
+ * The queued i/os of a single objset.
+ */
+typedef struct vdev_queue_flow_class {
+	avl_tree_t	vqfc_queued_tree; /* ordered as vqc_queued_tree */
+	list_node_t	vqfc_node;	/* on vqc_flow_list */
+	int64_t		vqfc_deficit;	/* bytes which may still be issued */
+} vdev_queue_flow_class_t;
+
+typedef struct vdev_queue_flow {
+	uint64_t	vqf_objset;
+	avl_node_t	vqf_node;	/* on vq_flow_tree */
+	uint64_t	vqf_queued;	/* i/os queued in all classes */
+	struct dataset_kstats *vqf_kstats; /* held, if the objset has any */
+	vdev_queue_flow_class_t vqf_class[ZIO_PRIORITY_NUM_QUEUEABLE];
+} vdev_queue_flow_t;
+
 struct vdev_queue {
 	vdev_t		*vq_vdev;
 	vdev_queue_class_t vq_class[ZIO_PRIORITY_NUM_QUEUEABLE];
 	avl_tree_t	vq_active_tree;
 	avl_tree_t	vq_read_offset_tree;
 	avl_tree_t	vq_write_offset_tree;
+	avl_tree_t	vq_trim_offset_tree;
+	avl_tree_t	vq_flow_tree;	/* flows by objset */
 	uint64_t	vq_last_offset;
 	hrtime_t	vq_io_complete_ts; /* time last i/o completed */
 	hrtime_t	vq_io_delta_ts;
+	hrtime_t	vq_io_lat_ewma; /* average device service time */
+	hrtime_t	vq_adapt_ts;	/* time of last depth adjustment */
 	zio_t		vq_io_search; /* used as local for stack reduction */
 	kmutex_t	vq_lock;
 };
@@ -219,6 +282,7 @@ struct vdev {
 	boolean_t	vdev_expanding;	/* expand the vdev?		*/
 	boolean_t	vdev_reopening;	/* reopen in progress?		*/
 	boolean_t	vdev_nonrot;	/* true if solid state		*/
+	boolean_t	vdev_has_trim;	/* true if leaf supports discard */
 	int		vdev_open_error; /* error on last open		*/
 	kthread_t	*vdev_open_thread; /* thread opening children	*/
 	uint64_t	vdev_crtxg;	/* txg when top-level was added */
@@ -250,6 +314,22 @@ struct vdev {
 	/* pool checkpoint related */
 	space_map_t	*vdev_checkpoint_sm;	/* contains reserved blocks */
 
+	/*
+	 * Trim state, protected by vdev_trim_lock.  Manual trims and
+	 * autotrim each run in their own thread per top-level vdev.
+	 */
+	kthread_t	*vdev_trim_thread;
+	boolean_t	vdev_trim_exit_wanted;
+	vdev_trim_state_t vdev_trim_state;
+	uint64_t	vdev_trim_rate;		/* requested rate (bytes/sec) */
+	uint64_t	vdev_trim_last_ms;	/* next metaslab to trim */
+	uint64_t	vdev_trim_action_time;	/* start and end time */
+	uint64_t	vdev_trim_bytes_done;
+	uint64_t	vdev_trim_bytes_est;
+	kthread_t	*vdev_autotrim_thread;
+	boolean_t	vdev_autotrim_exit_wanted;
+	uint64_t	vdev_autotrim_kicks;
+
 	/*
 	 * Values stored in the config for an indirect or removing vdev.
 	 */
@@ -354,6 +434,9 @@ struct vdev {
 	kmutex_t	vdev_dtl_lock;	/* vdev_dtl_{map,resilver}	*/
 	kmutex_t	vdev_stat_lock;	/* vdev_stat			*/
 	kmutex_t	vdev_probe_lock; /* protects vdev_probe_zio	*/
+	kmutex_t	vdev_trim_lock;	/* vdev_trim_* and vdev_autotrim_* */
+	kcondvar_t	vdev_trim_cv;
+	kcondvar_t	vdev_autotrim_cv;
 
 	/*
 	 * We rate limit ZIO delay and ZIO checksum events, since they
@@ -480,6 +563,12 @@ extern uint64_t vdev_default_asize(vdev_t *vd, uint64_t psize);
 extern uint64_t vdev_get_min_asize(vdev_t *vd);
 extern void vdev_set_min_asize(vdev_t *vd);
 
+/*
+ * Common range translation function
+ */
+extern void vdev_default_xlate(vdev_t *vd, const range_seg_t *in,
+    range_seg_t *out);
+
 /*
  * Global variables
  */
@@ -496,6 +585,49 @@ extern void spa_condense_indirect_start_sync(vdev_t *vd, dmu_tx_t *tx);
 extern int vdev_obsolete_sm_object(vdev_t *vd);
 extern boolean_t vdev_obsolete_counts_are_precise(vdev_t *vd);
 
+/*
+ * Hedged reads, see vdev_hedge.c.
+ */
+typedef struct vdev_hedge vdev_hedge_t;
+
+typedef struct vdev_hedge_ops {
+	/* a read of child c completed while the parent was still waiting */
+	void	(*vho_done)(vdev_hedge_t *vh, int c, zio_t *zio);
+	/* the parent has been waiting longer than zfs_vdev_hedge_read_ms */
+	void	(*vho_timeout)(vdev_hedge_t *vh);
+} vdev_hedge_ops_t;
+
+typedef struct vdev_hedge_child {
+	vdev_hedge_t	*vhc_hedge;
+	zio_t		*vhc_zio;	/* created but not yet issued */
+	int		vhc_next;	/* next child to issue */
+	boolean_t	vhc_issued;
+} vdev_hedge_child_t;
+
+struct vdev_hedge {
+	kmutex_t	vh_lock;
+	zio_t		*vh_zio;	/* waiting parent, NULL once released */
+	zio_t		*vh_gate;	/* child which holds up the parent */
+	boolean_t	vh_released;
+	const vdev_hedge_ops_t *vh_ops;
+	spa_t		*vh_spa;
+	uint64_t	vh_refs;
+	uint64_t	vh_pending;	/* reads in flight */
+	int		vh_issue;	/* first child to issue, or -1 */
+	int		vh_children;
+	vdev_hedge_child_t vh_child[];
+};
+
+extern int zfs_vdev_hedge_read_ms;
+
+extern boolean_t vdev_hedge_enabled(zio_t *zio);
+extern vdev_hedge_t *vdev_hedge_create(zio_t *zio, int children,
+    const vdev_hedge_ops_t *ops);
+extern void vdev_hedge_read(vdev_hedge_t *vh, int c, vdev_t *vd,
+    uint64_t offset, uint64_t size, blkptr_t *bp);
+extern void vdev_hedge_start(vdev_hedge_t *vh);
+extern void vdev_hedge_release(vdev_hedge_t *vh);
+
 /*
  * Other miscellaneous functions
  */
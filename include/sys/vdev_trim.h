@@ -0,0 +1,48 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef _SYS_VDEV_TRIM_H
+#define	_SYS_VDEV_TRIM_H
+
+#include <sys/spa.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+extern unsigned int zfs_trim_extent_bytes_max;
+extern unsigned int zfs_trim_extent_bytes_min;
+extern unsigned int zfs_trim_queue_limit;
+extern unsigned int zfs_trim_txg_batch;
+
+extern void vdev_trim(vdev_t *vd, uint64_t rate);
+extern void vdev_trim_stop(vdev_t *vd, vdev_trim_state_t tgt_state);
+extern void vdev_trim_stop_all(spa_t *spa, vdev_trim_state_t tgt_state);
+extern void vdev_trim_restart(spa_t *spa);
+extern void vdev_autotrim(spa_t *spa);
+extern void vdev_autotrim_stop_all(spa_t *spa);
+extern void vdev_autotrim_kick(spa_t *spa);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _SYS_VDEV_TRIM_H */
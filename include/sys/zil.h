@@ -52,6 +52,15 @@ struct lwb;
  * a log block trailer (zil_trailer_t).  The format of a log record
  * depends on the record (or transaction) type, but all records begin
  * with a common structure that defines the type, length, and txg.
+ *
+ * With the zil_chains feature a log may be written as up to ZIL_MAX_CHAINS
+ * independent chains of log blocks.  The first chain hangs off zh_log,
+ * the others off the zil_chain_head_t array kept after the objset's
+ * project used dnode.  Each commit writes its records to a single chain
+ * as a "batch" of sequence numbers reserved in advance, and ends it with
+ * a TX_BATCH record naming the range.  Replay merges the chains by
+ * sequence number, starting at zh_batch_seq and stopping at the first
+ * batch whose TX_BATCH record is missing.
  */
 
 /*
@@ -65,7 +74,8 @@ typedef struct zil_header {
 	uint64_t zh_claim_blk_seq; /* highest claimed block sequence number */
 	uint64_t zh_flags;	/* header flags */
 	uint64_t zh_claim_lr_seq; /* highest claimed lr sequence number */
-	uint64_t zh_pad[3];
+	uint64_t zh_batch_seq;	/* first batch to replay (ZIL_MULTI_CHAIN) */
+	uint64_t zh_pad[2];
 } zil_header_t;
 
 /*
@@ -73,6 +83,20 @@ typedef struct zil_header {
  */
 #define	ZIL_REPLAY_NEEDED	0x1	/* replay needed - internal only */
 #define	ZIL_CLAIM_LR_SEQ_VALID	0x2	/* zh_claim_lr_seq field is valid */
+#define	ZIL_MULTI_CHAIN		0x4	/* log is written as batches */
+
+/*
+ * Head of each additional log chain (zil_chains feature).  The header's
+ * zh_log, zh_claim_blk_seq and zh_claim_lr_seq describe the first chain.
+ */
+typedef struct zil_chain_head {
+	blkptr_t zch_log;	/* log chain */
+	uint64_t zch_claim_blk_seq; /* highest claimed block sequence number */
+	uint64_t zch_claim_lr_seq; /* highest claimed lr sequence number */
+	uint64_t zch_pad[2];
+} zil_chain_head_t;
+
+#define	ZIL_MAX_CHAINS	8
 
 /*
  * Log block chaining.
@@ -162,7 +186,8 @@ typedef enum zil_create {
 #define	TX_MKDIR_ATTR		18	/* mkdir with attr */
 #define	TX_MKDIR_ACL_ATTR	19	/* mkdir with ACL + attrs */
 #define	TX_WRITE2		20	/* dmu_sync EALREADY write */
-#define	TX_MAX_TYPE		21	/* Max transaction type */
+#define	TX_BATCH		21	/* End of a batch of records */
+#define	TX_MAX_TYPE		22	/* Max transaction type */
 
 /*
  * The transactions for mkdir, symlink, remove, rmdir, link, and rename
@@ -353,6 +378,12 @@ typedef struct {
 	/* lr_acl_bytes number of variable sized ace's follows */
 } lr_acl_t;
 
+typedef struct {
+	lr_t		lr_common;	/* common portion of log record */
+	uint64_t	lr_start;	/* first sequence number of the batch */
+	uint64_t	lr_end;		/* first sequence number after it */
+} lr_batch_t;
+
 /*
  * ZIL structure definitions, interface function prototype and globals.
  */
@@ -462,6 +493,19 @@ extern zil_stats_t zil_stats;
 #define	ZIL_STAT_BUMP(stat) \
     ZIL_STAT_INCR(stat, 1);
 
+/*
+ * The stages of a zil_commit() which are timed.  Each is recorded in a
+ * latency histogram of the pool and summed up in the dataset's kstats.
+ */
+typedef enum zil_commit_stage {
+	ZIL_COMMIT_TOTAL,	/* the entire zil_commit() */
+	ZIL_COMMIT_GATHER,	/* zlc_issuer_lock, zil_get_commit_list() */
+	ZIL_COMMIT_ISSUE,	/* zil_process_commit_list(), lwb issue */
+	ZIL_COMMIT_WAIT,	/* zil_commit_waiter() */
+	ZIL_COMMIT_FLUSH,	/* lwb write done to vdev flushes done */
+	ZIL_COMMIT_STAGES
+} zil_commit_stage_t;
+
 typedef int zil_parse_blk_func_t(zilog_t *zilog, blkptr_t *bp, void *arg,
     uint64_t txg);
 typedef int zil_parse_lr_func_t(zilog_t *zilog, lr_t *lr, void *arg,
@@ -477,7 +521,8 @@ extern int zil_parse(zilog_t *zilog, zil_parse_blk_func_t *parse_blk_func,
 extern void	zil_init(void);
 extern void	zil_fini(void);
 
-extern zilog_t	*zil_alloc(objset_t *os, zil_header_t *zh_phys);
+extern zilog_t	*zil_alloc(objset_t *os, zil_header_t *zh_phys,
+    zil_chain_head_t *zch_phys);
 extern void	zil_free(zilog_t *zilog);
 
 extern zilog_t	*zil_open(objset_t *os, zil_get_data_t *get_data);
@@ -40,22 +40,25 @@ extern "C" {
  *
  * An lwb will start out in the "closed" state, and then transition to
  * the "opened" state via a call to zil_lwb_write_open(). When
- * transitioning from "closed" to "opened" the zilog's "zl_issuer_lock"
- * must be held.
+ * transitioning from "closed" to "opened" the "zlc_issuer_lock" of the
+ * lwb's chain must be held.
  *
  * After the lwb is "opened", it can transition into the "issued" state
- * via zil_lwb_write_issue(). Again, the zilog's "zl_issuer_lock" must
- * be held when making this transition.
+ * via zil_lwb_write_issue(). Again, the chain's "zlc_issuer_lock" must
+ * be held when making this transition. The lwb's zios themselves are
+ * issued by zil_issue_lwbs(), usually after the "zlc_issuer_lock" has
+ * been dropped, so that checksumming, encrypting and submitting the
+ * log block doesn't hold up the next thread committing to the log.
  *
  * After the lwb's zio completes, and the vdev's are flushed, the lwb
  * will transition into the "done" state via zil_lwb_write_done(). When
  * transitioning from "issued" to "done", the zilog's "zl_lock" must be
- * held, *not* the "zl_issuer_lock".
+ * held, *not* the "zlc_issuer_lock".
  *
- * The zilog's "zl_issuer_lock" can become heavily contended in certain
+ * The "zlc_issuer_lock" can become heavily contended in certain
  * workloads, so we specifically avoid acquiring that lock when
  * transitioning an lwb from "issued" to "done". This allows us to avoid
- * having to acquire the "zl_issuer_lock" for each lwb ZIO completion,
+ * having to acquire the "zlc_issuer_lock" for each lwb ZIO completion,
  * which would have added more lock contention on an already heavily
  * contended lock.
  *
@@ -64,7 +67,7 @@ extern "C" {
  * this specific order; i.e. "closed" to "opened" to "issued" to "done".
  *
  * Thus, if an lwb is in the "closed" or "opened" state, holding the
- * "zl_issuer_lock" will prevent a concurrent thread from transitioning
+ * "zlc_issuer_lock" will prevent a concurrent thread from transitioning
  * that lwb to the "issued" state. Likewise, if an lwb is already in the
  * "issued" state, holding the "zl_lock" will prevent a concurrent
  * thread from transitioning that lwb to the "done" state.
@@ -81,13 +84,14 @@ typedef enum {
  * Log write block (lwb)
  *
  * Prior to an lwb being issued to disk via zil_lwb_write_issue(), it
- * will be protected by the zilog's "zl_issuer_lock". Basically, prior
+ * will be protected by its chain's "zlc_issuer_lock". Basically, prior
  * to it being issued, it will only be accessed by the thread that's
- * holding the "zl_issuer_lock". After the lwb is issued, the zilog's
+ * holding the "zlc_issuer_lock". After the lwb is issued, the zilog's
  * "zl_lock" is used to protect the lwb against concurrent access.
  */
 typedef struct lwb {
 	zilog_t		*lwb_zilog;	/* back pointer to log struct */
+	struct zilog_chain *lwb_chain;	/* chain this lwb belongs to */
 	blkptr_t	lwb_blk;	/* on disk address of this log blk */
 	boolean_t	lwb_fastwrite;	/* is blk marked for fastwrite? */
 	boolean_t	lwb_slog;	/* lwb_blk is on SLOG device */
@@ -99,12 +103,16 @@ typedef struct lwb {
 	zio_t		*lwb_root_zio;	/* root zio for lwb write and flushes */
 	dmu_tx_t	*lwb_tx;	/* tx for log block allocation */
 	uint64_t	lwb_max_txg;	/* highest txg in this lwb */
-	list_node_t	lwb_node;	/* zilog->zl_lwb_list linkage */
+	uint64_t	lwb_batch_start; /* batch of the records in this lwb */
+	struct zil_batch *lwb_batch;	/* batch whose TX_BATCH is in here */
+	list_node_t	lwb_node;	/* zlc_lwb_list linkage */
+	list_node_t	lwb_issue_node;	/* zil_issue_lwbs() linkage */
 	list_t		lwb_itxs;	/* list of itx's */
 	list_t		lwb_waiters;	/* list of zil_commit_waiter's */
 	avl_tree_t	lwb_vdev_tree;	/* vdevs to flush after lwb write */
 	kmutex_t	lwb_vdev_lock;	/* protects lwb_vdev_tree */
 	hrtime_t	lwb_issued_timestamp; /* when was the lwb issued? */
+	hrtime_t	lwb_written_timestamp; /* when was the lwb written? */
 } lwb_t;
 
 /*
@@ -117,10 +125,10 @@ typedef struct lwb {
  *
  * The "zcw_lock" field is used to protect the commit waiter against
  * concurrent access. This lock is often acquired while already holding
- * the zilog's "zl_issuer_lock" or "zl_lock"; see the functions
+ * a chain's "zlc_issuer_lock" or the zilog's "zl_lock"; see the functions
  * zil_process_commit_list() and zil_lwb_flush_vdevs_done() as examples
  * of this. Thus, one must be careful not to acquire the
- * "zl_issuer_lock" or "zl_lock" when already holding the "zcw_lock";
+ * "zlc_issuer_lock" or "zl_lock" when already holding the "zcw_lock";
  * e.g. see the zil_commit_waiter_timeout() function.
  */
 typedef struct zil_commit_waiter {
@@ -128,8 +136,12 @@ typedef struct zil_commit_waiter {
 	kmutex_t	zcw_lock;	/* protects fields of this struct */
 	list_node_t	zcw_node;	/* linkage in lwb_t:lwb_waiter list */
 	lwb_t		*zcw_lwb;	/* back pointer to lwb when linked */
+	struct zil_batch *zcw_batch;	/* or to the batch, see zil_batch_t */
 	boolean_t	zcw_done;	/* B_TRUE when "done", else B_FALSE */
 	int		zcw_zio_error;	/* contains the zio io_error value */
+	uint64_t	zcw_nitxs;	/* itxs written out for this commit */
+	uint64_t	zcw_nbytes;	/* bytes of those itxs */
+	hrtime_t	zcw_time[ZIL_COMMIT_STAGES]; /* see zil_commit_impl() */
 } zil_commit_waiter_t;
 
 /*
@@ -164,6 +176,47 @@ typedef struct zil_vdev_node {
 
 #define	ZIL_PREV_BLKS 16
 
+/*
+ * A chain of log blocks being written.  A zilog normally writes a single
+ * chain; with the zil_chains feature it writes up to ZIL_MAX_CHAINS of
+ * them concurrently, each with its own issuer lock.
+ */
+typedef struct zilog_chain {
+	zilog_t		*zlc_zilog;	/* back pointer to log struct */
+	int		zlc_id;		/* index in zl_chains[] */
+	kmutex_t	zlc_issuer_lock; /* single writer, per chain */
+	list_t		zlc_itx_commit_list; /* itx list to be committed */
+	uint64_t	zlc_cur_used;	/* current commit log size used */
+	list_t		zlc_lwb_list;	/* in-flight log write list */
+	lwb_t		*zlc_last_lwb_opened; /* most recent lwb opened */
+	uint_t		zlc_prev_blks[ZIL_PREV_BLKS]; /* sector rounded sizes */
+	uint_t		zlc_prev_rotor;	/* rotor for zlc_prev_blks[] */
+	uint64_t	zlc_parse_blk_seq; /* highest blk seq on last parse */
+	uint64_t	zlc_parse_lr_seq; /* highest lr seq on last parse */
+} zilog_chain_t;
+
+/*
+ * A batch is the set of itxs written out by one commit writer of a
+ * multi-chain log.  Its records get the sequence numbers reserved for it
+ * in [zib_start, zib_end), and the last of them is taken by the TX_BATCH
+ * record ending the batch.  Replay can only trust a batch once every
+ * batch before it is complete on disk, so batches are acknowledged in
+ * order of zib_start, from zl_batch_list, which is protected by zl_lock.
+ */
+typedef struct zil_batch {
+	list_node_t	zib_node;	/* zl_batch_list linkage */
+	uint64_t	zib_start;	/* first sequence number reserved */
+	uint64_t	zib_end;	/* first sequence number after them */
+	uint64_t	zib_next_seq;	/* next sequence number to hand out */
+	boolean_t	zib_placed;	/* all records are in lwbs */
+	boolean_t	zib_written;	/* TX_BATCH record is in an lwb */
+	boolean_t	zib_done;	/* TX_BATCH record is stable */
+	int		zib_error;	/* error of the lwb writes */
+	hrtime_t	zib_flush;	/* vdev flush time of the last lwb */
+	list_t		zib_itxs;	/* itxs to destroy when acknowledged */
+	list_t		zib_waiters;	/* zil_commit_waiters to notify */
+} zil_batch_t;
+
 /*
  * Stable storage intent log management structure.  One per dataset.
  */
@@ -172,10 +225,12 @@ struct zilog {
 	struct dsl_pool	*zl_dmu_pool;	/* DSL pool */
 	spa_t		*zl_spa;	/* handle for read/write log */
 	const zil_header_t *zl_header;	/* log header buffer */
+	zil_chain_head_t *zl_chain_heads; /* heads of chains 1.., or NULL */
 	objset_t	*zl_os;		/* object set we're logging */
 	zil_get_data_t	*zl_get_data;	/* callback to get object content */
-	lwb_t		*zl_last_lwb_opened; /* most recent lwb opened */
 	hrtime_t	zl_last_lwb_latency; /* zio latency of last lwb done */
+	hrtime_t	zl_last_commit;	/* when zil_commit() was last called */
+	hrtime_t	zl_commit_interval; /* avg time between zil_commit()s */
 	uint64_t	zl_lr_seq;	/* on-disk log record sequence number */
 	uint64_t	zl_commit_lr_seq; /* last committed on-disk lr seq */
 	uint64_t	zl_destroy_txg;	/* txg of last zil_destroy() */
@@ -187,7 +242,6 @@ struct zilog {
 	uint8_t		zl_keep_first;	/* keep first log block in destroy */
 	uint8_t		zl_replay;	/* replaying records while set */
 	uint8_t		zl_stop_sync;	/* for debugging */
-	kmutex_t	zl_issuer_lock;	/* single writer, per ZIL, at a time */
 	uint8_t		zl_logbias;	/* latency or throughput */
 	uint8_t		zl_sync;	/* synchronous or asynchronous */
 	int		zl_parse_error;	/* last zil_parse() error */
@@ -196,15 +250,18 @@ struct zilog {
 	uint64_t	zl_parse_blk_count; /* number of blocks parsed */
 	uint64_t	zl_parse_lr_count; /* number of log records parsed */
 	itxg_t		zl_itxg[TXG_SIZE]; /* intent log txg chains */
-	list_t		zl_itx_commit_list; /* itx list to be committed */
-	uint64_t	zl_cur_used;	/* current commit log size used */
-	list_t		zl_lwb_list;	/* in-flight log write list */
+	int		zl_nchains;	/* chains written, see zil_open() */
+	zilog_chain_t	zl_chains[ZIL_MAX_CHAINS]; /* log chains */
+	kmutex_t	zl_gather_lock;	/* orders batch gathering */
+	list_t		zl_batch_list;	/* batches not yet acknowledged */
+	uint64_t	zl_batch_floor;	/* batches below are in the pool */
+	uint64_t	zl_batch_safe;	/* zh_batch_seq is past batches below */
+	uint64_t	zl_batch_broken; /* first batch whose write failed */
+	uint64_t	zl_batch_broken_txg; /* txg replay skips past it */
 	avl_tree_t	zl_bp_tree;	/* track bps during log parse */
 	clock_t		zl_replay_time;	/* lbolt of when replay started */
 	uint64_t	zl_replay_blks;	/* number of log blocks replayed */
 	zil_header_t	zl_old_header;	/* debugging aid */
-	uint_t		zl_prev_blks[ZIL_PREV_BLKS]; /* size - sector rounded */
-	uint_t		zl_prev_rotor;	/* rotor for zl_prev[] */
 	txg_node_t	zl_dirty_link;	/* protected by dp_dirty_zilogs list */
 	uint64_t	zl_dirty_max_txg; /* highest txg used to dirty zilog */
 };
@@ -220,12 +277,25 @@ typedef struct zil_bp_node {
 #define	ZIL_MAX_LOG_DATA (SPA_OLD_MAXBLOCKSIZE - sizeof (zil_chain_t) - \
     sizeof (lr_write_t))
 
+/*
+ * Minimum amount of write data that fits into a log block started for
+ * the next chunk of a WR_NEED_COPY write.
+ */
+#define	ZIL_MIN_LOG_DATA (ZIL_MIN_BLKSZ - sizeof (zil_chain_t) - \
+    sizeof (lr_write_t))
+
 /*
  * Maximum amount of log space we agree to waste to reduce number of
  * WR_NEED_COPY chunks to reduce zl_get_data() overhead (~12%).
  */
 #define	ZIL_MAX_WASTE_SPACE (ZIL_MAX_LOG_DATA / 8)
 
+/*
+ * Weight of the moving average of zl_commit_interval; each new interval
+ * counts for 1/ZIL_COMMIT_INTERVAL_WEIGHT of it.
+ */
+#define	ZIL_COMMIT_INTERVAL_WEIGHT	8
+
 /*
  * Maximum amount of write data for WR_COPIED.  Fall back to WR_NEED_COPY
  * as more space efficient if we can't fit at least two log records into
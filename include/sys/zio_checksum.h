@@ -44,6 +44,9 @@ typedef void zio_checksum_t(struct abd *abd, uint64_t size,
     const void *ctx_template, zio_cksum_t *zcp);
 typedef void *zio_checksum_tmpl_init_t(const zio_cksum_salt_t *salt);
 typedef void zio_checksum_tmpl_free_t(void *ctx_template);
+typedef void zio_checksum_many_t(struct abd **abds, const uint64_t *sizes,
+    int n, const void *ctx_template, zio_cksum_t *zcps);
+typedef int zio_checksum_degree_t(uint64_t size);
 
 typedef enum zio_checksum_flags {
 	/* Strong enough for metadata? */
@@ -90,6 +93,10 @@ typedef const struct zio_checksum_info {
 	zio_checksum_tmpl_free_t	*ci_tmpl_free;
 	zio_checksum_flags_t		ci_flags;
 	char				*ci_name;	/* descriptive name */
+	/* native checksum function for several blocks at once */
+	zio_checksum_many_t		*ci_func_many;
+	/* blocks ci_func_many checksums at the cost of one */
+	zio_checksum_degree_t		*ci_degree;
 } zio_checksum_info_t;
 
 typedef struct zio_bad_cksum {
@@ -107,6 +114,8 @@ extern zio_checksum_info_t zio_checksum_table[ZIO_CHECKSUM_FUNCTIONS];
  * Checksum routines.
  */
 extern zio_checksum_t abd_checksum_SHA256;
+extern zio_checksum_many_t abd_checksum_SHA256_many;
+extern zio_checksum_degree_t abd_checksum_SHA256_degree;
 extern zio_checksum_t abd_checksum_SHA512_native;
 extern zio_checksum_t abd_checksum_SHA512_byteswap;
 
@@ -122,6 +131,12 @@ extern zio_checksum_t abd_checksum_edonr_byteswap;
 extern zio_checksum_tmpl_init_t abd_checksum_edonr_tmpl_init;
 extern zio_checksum_tmpl_free_t abd_checksum_edonr_tmpl_free;
 
+/* BLAKE3 */
+extern zio_checksum_t abd_checksum_blake3_native;
+extern zio_checksum_t abd_checksum_blake3_byteswap;
+extern zio_checksum_tmpl_init_t abd_checksum_blake3_tmpl_init;
+extern zio_checksum_tmpl_free_t abd_checksum_blake3_tmpl_free;
+
 extern zio_abd_checksum_func_t fletcher_4_abd_ops;
 extern zio_checksum_t abd_fletcher_4_native;
 extern zio_checksum_t abd_fletcher_4_byteswap;
@@ -130,6 +145,7 @@ extern int zio_checksum_equal(spa_t *, blkptr_t *, enum zio_checksum,
     void *, uint64_t, uint64_t, zio_bad_cksum_t *);
 extern void zio_checksum_compute(zio_t *, enum zio_checksum,
     struct abd *, uint64_t);
+extern void zio_checksum_compute_many(zio_t **, int, enum zio_checksum);
 extern int zio_checksum_error_impl(spa_t *, const blkptr_t *, enum zio_checksum,
     struct abd *, uint64_t, uint64_t, zio_bad_cksum_t *);
 extern int zio_checksum_error(zio_t *zio, zio_bad_cksum_t *out);
@@ -29,6 +29,7 @@
 #define	_SYS_ZIO_COMPRESS_H
 
 #include <sys/abd.h>
+#include <zfeature_common.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -51,6 +52,40 @@ enum zio_compress {
 	ZIO_COMPRESS_GZIP_9,
 	ZIO_COMPRESS_ZLE,
 	ZIO_COMPRESS_LZ4,
+	ZIO_COMPRESS_ZSTD_1,
+	ZIO_COMPRESS_ZSTD_2,
+	ZIO_COMPRESS_ZSTD_3,
+	ZIO_COMPRESS_ZSTD_4,
+	ZIO_COMPRESS_ZSTD_5,
+	ZIO_COMPRESS_ZSTD_6,
+	ZIO_COMPRESS_ZSTD_7,
+	ZIO_COMPRESS_ZSTD_8,
+	ZIO_COMPRESS_ZSTD_9,
+	ZIO_COMPRESS_ZSTD_10,
+	ZIO_COMPRESS_ZSTD_11,
+	ZIO_COMPRESS_ZSTD_12,
+	ZIO_COMPRESS_ZSTD_13,
+	ZIO_COMPRESS_ZSTD_14,
+	ZIO_COMPRESS_ZSTD_15,
+	ZIO_COMPRESS_ZSTD_16,
+	ZIO_COMPRESS_ZSTD_17,
+	ZIO_COMPRESS_ZSTD_18,
+	ZIO_COMPRESS_ZSTD_19,
+	ZIO_COMPRESS_ZSTD_FAST_1,
+	ZIO_COMPRESS_ZSTD_FAST_2,
+	ZIO_COMPRESS_ZSTD_FAST_3,
+	ZIO_COMPRESS_ZSTD_FAST_4,
+	ZIO_COMPRESS_ZSTD_FAST_5,
+	ZIO_COMPRESS_ZSTD_FAST_6,
+	ZIO_COMPRESS_ZSTD_FAST_7,
+	ZIO_COMPRESS_ZSTD_FAST_8,
+	ZIO_COMPRESS_ZSTD_FAST_9,
+	ZIO_COMPRESS_ZSTD_FAST_10,
+	ZIO_COMPRESS_ZSTD_FAST_20,
+	ZIO_COMPRESS_ZSTD_FAST_50,
+	ZIO_COMPRESS_ZSTD_FAST_100,
+	ZIO_COMPRESS_ZSTD_FAST_500,
+	ZIO_COMPRESS_ZSTD_FAST_1000,
 	ZIO_COMPRESS_FUNCTIONS
 };
 
@@ -80,12 +115,35 @@ typedef const struct zio_compress_info {
 
 extern zio_compress_info_t zio_compress_table[ZIO_COMPRESS_FUNCTIONS];
 
+/*
+ * Outcome of zio_compress_data_early_abort().
+ */
+typedef struct zio_compress_abort {
+	boolean_t	za_aborted;	/* expensive compression skipped */
+	hrtime_t	za_saved;	/* estimated CPU time saved (ns) */
+} zio_compress_abort_t;
+
+/*
+ * Each zstd level, including the negative "fast" levels, is a separate
+ * compression function so that the level is recorded in the block pointer.
+ */
+#define	ZIO_COMPRESS_IS_ZSTD(compress)			\
+	((compress) >= ZIO_COMPRESS_ZSTD_1 &&		\
+	(compress) <= ZIO_COMPRESS_ZSTD_FAST_1000)
+
 /*
  * lz4 compression init & free
  */
 extern void lz4_init(void);
 extern void lz4_fini(void);
 
+/*
+ * zstd compression init & free
+ */
+extern void zstd_init(void);
+extern void zstd_fini(void);
+extern void zfs_zstd_cache_reap_now(void);
+
 /*
  * Compression routines.
  */
@@ -107,15 +165,22 @@ extern int lz4_decompress_zfs(void *src, void *dst, size_t s_len, size_t d_len,
     int level);
 extern int lz4_decompress_abd(abd_t *src, void *dst, size_t s_len, size_t d_len,
     int level);
+extern size_t zfs_zstd_compress(void *src, void *dst, size_t s_len,
+    size_t d_len, int level);
+extern int zfs_zstd_decompress(void *src, void *dst, size_t s_len,
+    size_t d_len, int level);
 /*
  * Compress and decompress data if necessary.
  */
 extern size_t zio_compress_data(enum zio_compress c, abd_t *src, void *dst,
     size_t s_len);
+extern size_t zio_compress_data_early_abort(enum zio_compress c, abd_t *src,
+    void *dst, size_t s_len, zio_compress_abort_t *za);
 extern int zio_decompress_data(enum zio_compress c, abd_t *src, void *dst,
     size_t s_len, size_t d_len);
 extern int zio_decompress_data_buf(enum zio_compress c, void *src, void *dst,
     size_t s_len, size_t d_len);
+extern spa_feature_t zio_compress_to_feature(enum zio_compress comp);
 
 #ifdef	__cplusplus
 }
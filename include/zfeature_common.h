@@ -65,6 +65,9 @@ typedef enum spa_feature {
 	SPA_FEATURE_POOL_CHECKPOINT,
 	SPA_FEATURE_SPACEMAP_V2,
 	SPA_FEATURE_ALLOCATION_CLASSES,
+	SPA_FEATURE_ZSTD_COMPRESS,
+	SPA_FEATURE_BLAKE3,
+	SPA_FEATURE_ZIL_CHAINS,
 	SPA_FEATURES
 } spa_feature_t;
 
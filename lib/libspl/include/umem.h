@@ -40,6 +40,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 
 #ifdef  __cplusplus
 extern "C" {
@@ -60,6 +61,7 @@ typedef void vmem_t;
 #define	UMC_NODEBUG		0x00020000
 #define	UMC_NOMAGAZINE		0x00040000
 #define	UMC_NOHASH		0x00080000
+#define	UMC_TYPESAFE		0x00100000
 
 #define	UMEM_CACHE_NAMELEN	31
 
@@ -78,6 +80,8 @@ typedef struct umem_cache {
 	void			*cache_private;
 	void			*cache_arena;
 	int			cache_cflags;
+	pthread_mutex_t		cache_lock;
+	void			*cache_free;	/* UMC_TYPESAFE objects */
 } umem_cache_t;
 
 static inline void *
@@ -156,6 +160,8 @@ umem_cache_create(
 		cp->cache_private = priv;
 		cp->cache_arena = vmp;
 		cp->cache_cflags = cflags;
+		cp->cache_free = NULL;
+		(void) pthread_mutex_init(&cp->cache_lock, NULL);
 	}
 
 	return (cp);
@@ -164,6 +170,13 @@ umem_cache_create(
 static inline void
 umem_cache_destroy(umem_cache_t *cp)
 {
+	void *ptr;
+
+	while ((ptr = cp->cache_free) != NULL) {
+		cp->cache_free = *(void **)ptr;
+		umem_free(ptr, cp->cache_bufsize);
+	}
+	(void) pthread_mutex_destroy(&cp->cache_lock);
 	umem_free(cp, sizeof (umem_cache_t));
 }
 
@@ -172,10 +185,17 @@ umem_cache_alloc(umem_cache_t *cp, int flags)
 {
 	void *ptr = NULL;
 
-	if (cp->cache_align != 0)
+	if (cp->cache_cflags & UMC_TYPESAFE) {
+		(void) pthread_mutex_lock(&cp->cache_lock);
+		if ((ptr = cp->cache_free) != NULL)
+			cp->cache_free = *(void **)ptr;
+		(void) pthread_mutex_unlock(&cp->cache_lock);
+	}
+
+	if (ptr == NULL && cp->cache_align != 0)
 		ptr = umem_alloc_aligned(
 		    cp->cache_bufsize, cp->cache_align, flags);
-	else
+	else if (ptr == NULL)
 		ptr = umem_alloc(cp->cache_bufsize, flags);
 
 	if (ptr && cp->cache_constructor)
@@ -190,6 +210,18 @@ umem_cache_free(umem_cache_t *cp, void *ptr)
 	if (cp->cache_destructor)
 		cp->cache_destructor(ptr, cp->cache_private);
 
+	/*
+	 * The memory of UMC_TYPESAFE objects is never handed back, so that
+	 * readers which find them without a lock never touch anything else.
+	 */
+	if (cp->cache_cflags & UMC_TYPESAFE) {
+		(void) pthread_mutex_lock(&cp->cache_lock);
+		*(void **)ptr = cp->cache_free;
+		cp->cache_free = ptr;
+		(void) pthread_mutex_unlock(&cp->cache_lock);
+		return;
+	}
+
 	umem_free(ptr, cp->cache_bufsize);
 }
 
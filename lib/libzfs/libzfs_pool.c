@@ -2150,6 +2150,96 @@ zpool_scan(zpool_handle_t *zhp, pool_scan_func_t func, pool_scrub_cmd_t cmd)
 	}
 }
 
+/*
+ * Start, cancel or suspend the manual trim of the vdevs named by the keys
+ * of "vds".  Trims are performed on whole top-level vdevs, naming any
+ * leaf trims the top-level vdev which contains it.
+ */
+int
+zpool_trim(zpool_handle_t *zhp, pool_trim_func_t cmd_type, nvlist_t *vds,
+    uint64_t rate)
+{
+	libzfs_handle_t *hdl = zhp->zpool_hdl;
+	nvlist_t *vdev_guids = fnvlist_alloc();
+	nvlist_t *errlist = NULL;
+	char msg[1024];
+	int err;
+
+	for (nvpair_t *elem = nvlist_next_nvpair(vds, NULL); elem != NULL;
+	    elem = nvlist_next_nvpair(vds, elem)) {
+		char *vd_path = nvpair_name(elem);
+		boolean_t spare, cache;
+		nvlist_t *tgt;
+
+		(void) snprintf(msg, sizeof (msg),
+		    dgettext(TEXT_DOMAIN, "cannot trim '%s'"), vd_path);
+
+		tgt = zpool_find_vdev(zhp, vd_path, &spare, &cache, NULL);
+		if (tgt == NULL) {
+			fnvlist_free(vdev_guids);
+			return (zfs_error(hdl, EZFS_NODEVICE, msg));
+		}
+		if (spare) {
+			fnvlist_free(vdev_guids);
+			return (zfs_error(hdl, EZFS_ISSPARE, msg));
+		}
+		if (cache) {
+			fnvlist_free(vdev_guids);
+			return (zfs_error(hdl, EZFS_ISL2CACHE, msg));
+		}
+
+		fnvlist_add_uint64(vdev_guids, vd_path,
+		    fnvlist_lookup_uint64(tgt, ZPOOL_CONFIG_GUID));
+	}
+
+	err = lzc_trim(zhp->zpool_name, cmd_type, rate, vdev_guids, &errlist);
+	fnvlist_free(vdev_guids);
+
+	if (err == 0)
+		return (0);
+
+	if (errlist == NULL) {
+		(void) snprintf(msg, sizeof (msg),
+		    dgettext(TEXT_DOMAIN, "cannot trim '%s'"),
+		    zhp->zpool_name);
+		return (zpool_standard_error(hdl, err, msg));
+	}
+
+	for (nvpair_t *elem = nvlist_next_nvpair(errlist, NULL); elem != NULL;
+	    elem = nvlist_next_nvpair(errlist, elem)) {
+		int64_t vd_error = fnvpair_value_int64(elem);
+
+		(void) snprintf(msg, sizeof (msg), dgettext(TEXT_DOMAIN,
+		    "cannot %s '%s'"), cmd_type == POOL_TRIM_CANCEL ?
+		    "cancel trimming" : cmd_type == POOL_TRIM_SUSPEND ?
+		    "suspend trimming" : "trim", nvpair_name(elem));
+
+		switch (vd_error) {
+		case ESRCH:
+			zfs_error_aux(hdl, dgettext(TEXT_DOMAIN,
+			    "no trim is in progress"));
+			(void) zfs_error(hdl, EZFS_NOTSUP, msg);
+			break;
+		case EROFS:
+			zfs_error_aux(hdl, dgettext(TEXT_DOMAIN,
+			    "device is not writeable"));
+			(void) zfs_error(hdl, EZFS_BADDEV, msg);
+			break;
+		case EBUSY:
+			zfs_error_aux(hdl, dgettext(TEXT_DOMAIN,
+			    "device is being removed"));
+			(void) zfs_error(hdl, EZFS_BUSY, msg);
+			break;
+		default:
+			(void) zpool_standard_error(hdl, vd_error, msg);
+			break;
+		}
+	}
+	fnvlist_free(errlist);
+
+	return (-1);
+}
+
 /*
  * Find a vdev that matches the search criteria specified. We use the
  * the nvpair name to determine how we should look for the device.
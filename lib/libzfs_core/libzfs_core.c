@@ -1277,6 +1277,45 @@ lzc_pool_checkpoint_discard(const char *pool)
 	return (error);
 }
 
+/*
+ * Start, cancel or suspend the manual trim of the given vdevs, which are
+ * specified as a list of names mapped to vdev guids.  A rate of 0 trims
+ * as fast as the devices allow.
+ *
+ * If this function returns 0 the command was successful for all vdevs.
+ * Otherwise the per-vdev errors are returned in "errlist", keyed by the
+ * same names as "vdevs".
+ */
+int
+lzc_trim(const char *poolname, pool_trim_func_t cmd_type, uint64_t rate,
+    nvlist_t *vdevs, nvlist_t **errlist)
+{
+	int error;
+
+	nvlist_t *result = NULL;
+	nvlist_t *args = fnvlist_alloc();
+
+	fnvlist_add_uint64(args, ZPOOL_TRIM_COMMAND, (uint64_t)cmd_type);
+	fnvlist_add_nvlist(args, ZPOOL_TRIM_VDEVS, vdevs);
+	fnvlist_add_uint64(args, ZPOOL_TRIM_RATE, rate);
+
+	error = lzc_ioctl(ZFS_IOC_POOL_TRIM, poolname, args, &result);
+
+	fnvlist_free(args);
+
+	if (errlist != NULL) {
+		nvlist_t *vdev_errlist;
+
+		*errlist = NULL;
+		if (result != NULL && nvlist_lookup_nvlist(result,
+		    ZPOOL_TRIM_VDEVS, &vdev_errlist) == 0)
+			*errlist = fnvlist_dup(vdev_errlist);
+	}
+	fnvlist_free(result);
+
+	return (error);
+}
+
 /*
  * Executes a read-only channel program.
  *
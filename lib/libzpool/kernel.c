@@ -706,6 +706,27 @@ fop_getattr(vnode_t *vp, vattr_t *vap)
 	return (0);
 }
 
+/*
+ * Only F_FREESP is supported, which is mapped to punching a hole in the
+ * backing file.  This is how file vdevs service trim requests.
+ */
+int
+fop_space(vnode_t *vp, int cmd, flock64_t *bfp)
+{
+	if (cmd != F_FREESP)
+		return (EINVAL);
+
+#if defined(FALLOC_FL_PUNCH_HOLE) && defined(FALLOC_FL_KEEP_SIZE)
+	if (fallocate(vp->v_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+	    bfp->l_start, bfp->l_len) == -1)
+		return (errno == EOPNOTSUPP ? ENOTSUP : errno);
+
+	return (0);
+#else
+	return (ENOTSUP);
+#endif
+}
+
 /*
  * =========================================================================
  * Figure out which debugging statements to print
@@ -0,0 +1,475 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * BLAKE3 hashing.
+ *
+ * The input is split into 1KiB chunks which are hashed independently and
+ * then combined in a binary tree of parent nodes.  This follows the
+ * incremental algorithm of the BLAKE3 reference implementation: the
+ * chaining values of completed subtrees are kept on a stack and merged as
+ * soon as it is known that they are not the root.
+ *
+ * Whenever the input contains several whole chunks, a power-of-two subtree
+ * of up to BLAKE3_MAX_SUBTREE_CHUNKS chunks is hashed at once.  Its chunks,
+ * and then each level of its parent nodes, are compressed by the selected
+ * implementation's hash_many, which processes "degree" inputs in parallel.
+ * This is where the SIMD implementations get their speed from; everything
+ * else uses the portable single block compression.
+ */
+
+#include <sys/zfs_context.h>
+#include <blake3/blake3_impl.h>
+
+static const uint32_t blake3_iv[8] = {
+	0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL,
+	0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL
+};
+
+static inline uint32_t
+load32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+	    ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static inline void
+store_cv(uint8_t *out, const uint32_t cv[8])
+{
+	for (int i = 0; i < 8; i++) {
+		out[4 * i + 0] = (uint8_t)(cv[i]);
+		out[4 * i + 1] = (uint8_t)(cv[i] >> 8);
+		out[4 * i + 2] = (uint8_t)(cv[i] >> 16);
+		out[4 * i + 3] = (uint8_t)(cv[i] >> 24);
+	}
+}
+
+static inline void
+load_cv(uint32_t cv[8], const uint8_t *in)
+{
+	for (int i = 0; i < 8; i++)
+		cv[i] = load32(in + 4 * i);
+}
+
+/*
+ * The input of a compression which has not been performed yet: the last
+ * block of a chunk or a parent node, which might turn out to be the root.
+ */
+typedef struct blake3_output {
+	uint32_t	bo_cv[8];
+	uint8_t		bo_block[BLAKE3_BLOCK_LEN];
+	uint64_t	bo_counter;
+	uint8_t		bo_block_len;
+	uint8_t		bo_flags;
+} blake3_output_t;
+
+static void
+blake3_output_cv(const blake3_output_t *o, uint8_t *cv_out)
+{
+	uint32_t cv[8];
+
+	memcpy(cv, o->bo_cv, sizeof (cv));
+	blake3_compress_in_place(cv, o->bo_block, o->bo_block_len,
+	    o->bo_counter, o->bo_flags);
+	store_cv(cv_out, cv);
+}
+
+static void
+blake3_output_root(const blake3_output_t *o, uint8_t *out)
+{
+	uint32_t cv[8];
+
+	memcpy(cv, o->bo_cv, sizeof (cv));
+	blake3_compress_in_place(cv, o->bo_block, o->bo_block_len,
+	    0, o->bo_flags | BLAKE3_ROOT);
+	store_cv(out, cv);
+}
+
+static void
+blake3_parent_output(blake3_output_t *o, const uint8_t *block,
+    const uint32_t key[8], uint8_t flags)
+{
+	memcpy(o->bo_cv, key, sizeof (o->bo_cv));
+	memcpy(o->bo_block, block, BLAKE3_BLOCK_LEN);
+	o->bo_counter = 0;
+	o->bo_block_len = BLAKE3_BLOCK_LEN;
+	o->bo_flags = flags | BLAKE3_PARENT;
+}
+
+static void
+chunk_state_init(blake3_chunk_state_t *cs, const uint32_t key[8],
+    uint64_t chunk_counter, uint8_t flags)
+{
+	memcpy(cs->cs_cv, key, sizeof (cs->cs_cv));
+	cs->cs_chunk_counter = chunk_counter;
+	memset(cs->cs_buf, 0, sizeof (cs->cs_buf));
+	cs->cs_buf_len = 0;
+	cs->cs_blocks_compressed = 0;
+	cs->cs_flags = flags;
+}
+
+static inline size_t
+chunk_state_len(const blake3_chunk_state_t *cs)
+{
+	return (BLAKE3_BLOCK_LEN * (size_t)cs->cs_blocks_compressed +
+	    cs->cs_buf_len);
+}
+
+static inline uint8_t
+chunk_state_start_flag(const blake3_chunk_state_t *cs)
+{
+	return (cs->cs_blocks_compressed == 0 ? BLAKE3_CHUNK_START : 0);
+}
+
+static size_t
+chunk_state_fill_buf(blake3_chunk_state_t *cs, const uint8_t *input,
+    size_t input_len)
+{
+	size_t take = BLAKE3_BLOCK_LEN - cs->cs_buf_len;
+
+	if (take > input_len)
+		take = input_len;
+	memcpy(cs->cs_buf + cs->cs_buf_len, input, take);
+	cs->cs_buf_len += take;
+
+	return (take);
+}
+
+static void
+chunk_state_update(blake3_chunk_state_t *cs, const uint8_t *input,
+    size_t input_len)
+{
+	if (cs->cs_buf_len > 0) {
+		size_t take = chunk_state_fill_buf(cs, input, input_len);
+		input += take;
+		input_len -= take;
+		if (input_len > 0) {
+			blake3_compress_in_place(cs->cs_cv, cs->cs_buf,
+			    BLAKE3_BLOCK_LEN, cs->cs_chunk_counter,
+			    cs->cs_flags | chunk_state_start_flag(cs));
+			cs->cs_blocks_compressed++;
+			cs->cs_buf_len = 0;
+			memset(cs->cs_buf, 0, sizeof (cs->cs_buf));
+		}
+	}
+
+	/* the last block is kept, it needs the CHUNK_END flag */
+	while (input_len > BLAKE3_BLOCK_LEN) {
+		blake3_compress_in_place(cs->cs_cv, input, BLAKE3_BLOCK_LEN,
+		    cs->cs_chunk_counter,
+		    cs->cs_flags | chunk_state_start_flag(cs));
+		cs->cs_blocks_compressed++;
+		input += BLAKE3_BLOCK_LEN;
+		input_len -= BLAKE3_BLOCK_LEN;
+	}
+
+	(void) chunk_state_fill_buf(cs, input, input_len);
+}
+
+static void
+chunk_state_output(const blake3_chunk_state_t *cs, blake3_output_t *o)
+{
+	memcpy(o->bo_cv, cs->cs_cv, sizeof (o->bo_cv));
+	memcpy(o->bo_block, cs->cs_buf, sizeof (o->bo_block));
+	o->bo_counter = cs->cs_chunk_counter;
+	o->bo_block_len = cs->cs_buf_len;
+	o->bo_flags = cs->cs_flags | chunk_state_start_flag(cs) |
+	    BLAKE3_CHUNK_END;
+}
+
+/*
+ * Compress "blocks" blocks of each of num_inputs inputs, which are stride
+ * bytes apart, and write their chaining values to out.  The selected
+ * implementation handles groups of ops->degree inputs; a smaller group at
+ * the end is handed to it as well if reading a whole group's worth of
+ * input stays within the input_size bytes of the buffer, the results of
+ * the extra inputs are simply ignored.  Otherwise it falls back to the
+ * generic implementation.
+ */
+static void
+blake3_hash_many(const blake3_impl_ops_t *ops, const uint8_t *input,
+    size_t input_size, size_t stride, size_t num_inputs, size_t blocks,
+    const uint32_t key[8], uint64_t counter, boolean_t increment_counter,
+    uint8_t flags, uint8_t flags_start, uint8_t flags_end, uint8_t *out)
+{
+	blake3_many_t bm;
+	size_t offset = 0;
+
+	bm.bm_stride = stride;
+	bm.bm_blocks = blocks;
+	bm.bm_flags = flags;
+	bm.bm_flags_start = flags_start;
+	bm.bm_flags_end = flags_end;
+
+	while (num_inputs > 0) {
+		const blake3_impl_ops_t *o = ops;
+		size_t n, i;
+		int w;
+
+		if (num_inputs < o->degree && offset + (o->degree - 1) *
+		    stride + blocks * BLAKE3_BLOCK_LEN > input_size)
+			o = &blake3_generic_impl;
+		n = MIN(num_inputs, o->degree);
+
+		bm.bm_input = input + offset;
+		for (i = 0; i < o->degree; i++) {
+			uint64_t c = counter + (increment_counter ? i : 0);
+
+			for (w = 0; w < 8; w++)
+				bm.bm_cv[w][i] = key[w];
+			bm.bm_ctr_lo[i] = (uint32_t)c;
+			bm.bm_ctr_hi[i] = (uint32_t)(c >> 32);
+		}
+
+		o->hash_many(&bm);
+
+		for (i = 0; i < n; i++) {
+			uint32_t cv[8];
+
+			for (w = 0; w < 8; w++)
+				cv[w] = bm.bm_cv[w][i];
+			store_cv(out, cv);
+			out += BLAKE3_OUT_LEN;
+		}
+
+		offset += n * stride;
+		if (increment_counter)
+			counter += n;
+		num_inputs -= n;
+	}
+}
+
+/*
+ * Hash a power-of-two subtree of at least two whole chunks, and leave the
+ * chaining values of its two children at the start of bctx_cv_buf.  The
+ * parent levels are reduced in place: each group's outputs are written
+ * only after its inputs have been read, and never beyond them.
+ */
+static void
+blake3_compress_subtree(BLAKE3_CTX *ctx, const uint8_t *input,
+    size_t input_len, uint64_t chunk_counter)
+{
+	const blake3_impl_ops_t *ops = ctx->bctx_ops;
+	uint8_t flags = ctx->bctx_chunk.cs_flags;
+	size_t n = input_len / BLAKE3_CHUNK_LEN;
+
+	ASSERT3U(n, >=, 2);
+	ASSERT3U(n, <=, BLAKE3_MAX_SUBTREE_CHUNKS);
+	ASSERT(ISP2(n));
+
+	blake3_hash_many(ops, input, input_len, BLAKE3_CHUNK_LEN, n,
+	    BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN, ctx->bctx_key, chunk_counter,
+	    B_TRUE, flags, BLAKE3_CHUNK_START, BLAKE3_CHUNK_END,
+	    ctx->bctx_cv_buf);
+
+	while (n > 2) {
+		n /= 2;
+		blake3_hash_many(ops, ctx->bctx_cv_buf,
+		    sizeof (ctx->bctx_cv_buf), BLAKE3_BLOCK_LEN, n, 1,
+		    ctx->bctx_key, 0, B_FALSE, flags | BLAKE3_PARENT, 0, 0,
+		    ctx->bctx_cv_buf);
+	}
+}
+
+/*
+ * Merge the completed subtrees on the stack, leaving one entry for every
+ * bit set in total_chunks, i.e. as many as there are complete subtrees in
+ * the input so far.  The most recent entry is only merged once more input
+ * arrives, since until then it could be the last one and so the root.
+ */
+static void
+blake3_merge_cv_stack(BLAKE3_CTX *ctx, uint64_t total_chunks)
+{
+	size_t post_merge_len = 0;
+	blake3_output_t o;
+
+	for (uint64_t t = total_chunks; t != 0; t &= t - 1)
+		post_merge_len++;
+
+	while (ctx->bctx_cv_stack_len > post_merge_len) {
+		uint8_t *parent = &ctx->bctx_cv_stack[
+		    (ctx->bctx_cv_stack_len - 2) * BLAKE3_OUT_LEN];
+
+		blake3_parent_output(&o, parent, ctx->bctx_key,
+		    ctx->bctx_chunk.cs_flags);
+		blake3_output_cv(&o, parent);
+		ctx->bctx_cv_stack_len--;
+	}
+}
+
+static void
+blake3_push_cv(BLAKE3_CTX *ctx, const uint8_t *cv, uint64_t chunk_counter)
+{
+	blake3_merge_cv_stack(ctx, chunk_counter);
+	ASSERT3U(ctx->bctx_cv_stack_len, <=, BLAKE3_MAX_DEPTH);
+	memcpy(&ctx->bctx_cv_stack[ctx->bctx_cv_stack_len * BLAKE3_OUT_LEN],
+	    cv, BLAKE3_OUT_LEN);
+	ctx->bctx_cv_stack_len++;
+}
+
+static void
+blake3_init_common(BLAKE3_CTX *ctx, const uint32_t key[8], uint8_t flags)
+{
+	memcpy(ctx->bctx_key, key, sizeof (ctx->bctx_key));
+	chunk_state_init(&ctx->bctx_chunk, key, 0, flags);
+	ctx->bctx_cv_stack_len = 0;
+	ctx->bctx_ops = blake3_impl_get_ops();
+}
+
+void
+Blake3_Init(BLAKE3_CTX *ctx)
+{
+	blake3_init_common(ctx, blake3_iv, 0);
+}
+
+void
+Blake3_InitKeyed(BLAKE3_CTX *ctx, const uint8_t *key)
+{
+	uint32_t key_words[8];
+
+	load_cv(key_words, key);
+	blake3_init_common(ctx, key_words, BLAKE3_KEYED_HASH);
+}
+
+void
+Blake3_Update(BLAKE3_CTX *ctx, const void *data, size_t len)
+{
+	blake3_chunk_state_t *cs = &ctx->bctx_chunk;
+	const uint8_t *input = data;
+	blake3_output_t o;
+	uint8_t cv[BLAKE3_OUT_LEN];
+
+	if (len == 0)
+		return;
+
+	/* finish the partial chunk left over from the last call first */
+	if (chunk_state_len(cs) > 0) {
+		size_t take = BLAKE3_CHUNK_LEN - chunk_state_len(cs);
+
+		if (take > len)
+			take = len;
+		chunk_state_update(cs, input, take);
+		input += take;
+		len -= take;
+		if (len == 0)
+			return;
+
+		chunk_state_output(cs, &o);
+		blake3_output_cv(&o, cv);
+		blake3_push_cv(ctx, cv, cs->cs_chunk_counter);
+		chunk_state_init(cs, ctx->bctx_key, cs->cs_chunk_counter + 1,
+		    cs->cs_flags);
+	}
+
+	/*
+	 * Hash whole subtrees while more than a chunk is left, so that the
+	 * last chunk, which might be the root, ends up in the chunk state.
+	 * A subtree must start at a multiple of its own size.
+	 */
+	while (len > BLAKE3_CHUNK_LEN) {
+		uint64_t count_so_far = cs->cs_chunk_counter * BLAKE3_CHUNK_LEN;
+		size_t subtree_len = BLAKE3_MAX_SUBTREE_CHUNKS *
+		    BLAKE3_CHUNK_LEN;
+		uint64_t subtree_chunks;
+
+		while (subtree_len > len)
+			subtree_len /= 2;
+		while (((uint64_t)(subtree_len - 1) & count_so_far) != 0)
+			subtree_len /= 2;
+		subtree_chunks = subtree_len / BLAKE3_CHUNK_LEN;
+
+		if (subtree_len <= BLAKE3_CHUNK_LEN) {
+			blake3_chunk_state_t chunk;
+
+			chunk_state_init(&chunk, ctx->bctx_key,
+			    cs->cs_chunk_counter, cs->cs_flags);
+			chunk_state_update(&chunk, input, subtree_len);
+			chunk_state_output(&chunk, &o);
+			blake3_output_cv(&o, cv);
+			blake3_push_cv(ctx, cv, chunk.cs_chunk_counter);
+		} else {
+			blake3_compress_subtree(ctx, input, subtree_len,
+			    cs->cs_chunk_counter);
+			blake3_push_cv(ctx, ctx->bctx_cv_buf,
+			    cs->cs_chunk_counter);
+			blake3_push_cv(ctx, ctx->bctx_cv_buf + BLAKE3_OUT_LEN,
+			    cs->cs_chunk_counter + subtree_chunks / 2);
+		}
+		cs->cs_chunk_counter += subtree_chunks;
+		input += subtree_len;
+		len -= subtree_len;
+	}
+
+	if (len > 0) {
+		chunk_state_update(cs, input, len);
+		blake3_merge_cv_stack(ctx, cs->cs_chunk_counter);
+	}
+}
+
+void
+Blake3_Final(const BLAKE3_CTX *ctx, uint8_t *digest)
+{
+	const blake3_chunk_state_t *cs = &ctx->bctx_chunk;
+	uint8_t parent[BLAKE3_BLOCK_LEN];
+	blake3_output_t o;
+	size_t cvs_remaining;
+
+	/* a single chunk is its own root */
+	if (ctx->bctx_cv_stack_len == 0) {
+		chunk_state_output(cs, &o);
+		blake3_output_root(&o, digest);
+		return;
+	}
+
+	/*
+	 * Otherwise merge everything on the stack, from the most recent
+	 * entry down, with whatever is left in the chunk state.  If the
+	 * input ended on a subtree boundary the chunk state is empty and
+	 * there are at least two entries on the stack.
+	 */
+	if (chunk_state_len(cs) > 0) {
+		cvs_remaining = ctx->bctx_cv_stack_len;
+		chunk_state_output(cs, &o);
+	} else {
+		cvs_remaining = ctx->bctx_cv_stack_len - 2;
+		blake3_parent_output(&o,
+		    &ctx->bctx_cv_stack[cvs_remaining * BLAKE3_OUT_LEN],
+		    ctx->bctx_key, cs->cs_flags);
+	}
+
+	while (cvs_remaining > 0) {
+		cvs_remaining--;
+		memcpy(parent,
+		    &ctx->bctx_cv_stack[cvs_remaining * BLAKE3_OUT_LEN],
+		    BLAKE3_OUT_LEN);
+		blake3_output_cv(&o, parent + BLAKE3_OUT_LEN);
+		blake3_parent_output(&o, parent, ctx->bctx_key, cs->cs_flags);
+	}
+
+	blake3_output_root(&o, digest);
+}
+
+#if defined(_KERNEL)
+EXPORT_SYMBOL(Blake3_Init);
+EXPORT_SYMBOL(Blake3_InitKeyed);
+EXPORT_SYMBOL(Blake3_Update);
+EXPORT_SYMBOL(Blake3_Final);
+#endif
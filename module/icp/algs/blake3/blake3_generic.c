@@ -0,0 +1,151 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Portable BLAKE3 compression function.
+ */
+
+#include <sys/zfs_context.h>
+#include <blake3/blake3_impl.h>
+
+static const uint32_t blake3_iv[8] = {
+	0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL,
+	0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL
+};
+
+static const uint8_t blake3_msg_schedule[7][16] = {
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+	{ 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 },
+	{ 3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1 },
+	{ 10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6 },
+	{ 12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4 },
+	{ 9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7 },
+	{ 11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13 },
+};
+
+#define	ROTR32(w, c)	(((w) >> (c)) | ((w) << (32 - (c))))
+
+static inline uint32_t
+load32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+	    ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static inline void
+blake3_g(uint32_t *s, size_t a, size_t b, size_t c, size_t d,
+    uint32_t x, uint32_t y)
+{
+	s[a] = s[a] + s[b] + x;
+	s[d] = ROTR32(s[d] ^ s[a], 16);
+	s[c] = s[c] + s[d];
+	s[b] = ROTR32(s[b] ^ s[c], 12);
+	s[a] = s[a] + s[b] + y;
+	s[d] = ROTR32(s[d] ^ s[a], 8);
+	s[c] = s[c] + s[d];
+	s[b] = ROTR32(s[b] ^ s[c], 7);
+}
+
+static inline void
+blake3_round(uint32_t s[16], const uint32_t m[16], size_t r)
+{
+	const uint8_t *sched = blake3_msg_schedule[r];
+
+	/* mix the columns */
+	blake3_g(s, 0, 4, 8, 12, m[sched[0]], m[sched[1]]);
+	blake3_g(s, 1, 5, 9, 13, m[sched[2]], m[sched[3]]);
+	blake3_g(s, 2, 6, 10, 14, m[sched[4]], m[sched[5]]);
+	blake3_g(s, 3, 7, 11, 15, m[sched[6]], m[sched[7]]);
+
+	/* mix the diagonals */
+	blake3_g(s, 0, 5, 10, 15, m[sched[8]], m[sched[9]]);
+	blake3_g(s, 1, 6, 11, 12, m[sched[10]], m[sched[11]]);
+	blake3_g(s, 2, 7, 8, 13, m[sched[12]], m[sched[13]]);
+	blake3_g(s, 3, 4, 9, 14, m[sched[14]], m[sched[15]]);
+}
+
+void
+blake3_compress_in_place(uint32_t cv[8],
+    const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len,
+    uint64_t counter, uint8_t flags)
+{
+	uint32_t m[16], s[16];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		m[i] = load32(block + 4 * i);
+
+	for (i = 0; i < 8; i++)
+		s[i] = cv[i];
+	for (i = 0; i < 4; i++)
+		s[8 + i] = blake3_iv[i];
+	s[12] = (uint32_t)counter;
+	s[13] = (uint32_t)(counter >> 32);
+	s[14] = block_len;
+	s[15] = flags;
+
+	for (i = 0; i < 7; i++)
+		blake3_round(s, m, i);
+
+	for (i = 0; i < 8; i++)
+		cv[i] = s[i] ^ s[i + 8];
+}
+
+static void
+blake3_generic_hash_many(blake3_many_t *bm)
+{
+	uint64_t counter = bm->bm_ctr_lo[0] |
+	    ((uint64_t)bm->bm_ctr_hi[0] << 32);
+	uint32_t cv[8];
+	int w;
+
+	for (w = 0; w < 8; w++)
+		cv[w] = bm->bm_cv[w][0];
+
+	for (uint64_t b = 0; b < bm->bm_blocks; b++) {
+		uint32_t flags = bm->bm_flags;
+
+		if (b == 0)
+			flags |= bm->bm_flags_start;
+		if (b + 1 == bm->bm_blocks)
+			flags |= bm->bm_flags_end;
+
+		blake3_compress_in_place(cv,
+		    bm->bm_input + b * BLAKE3_BLOCK_LEN, BLAKE3_BLOCK_LEN,
+		    counter, flags);
+	}
+
+	for (w = 0; w < 8; w++)
+		bm->bm_cv[w][0] = cv[w];
+}
+
+static boolean_t
+blake3_generic_will_work(void)
+{
+	return (B_TRUE);
+}
+
+const blake3_impl_ops_t blake3_generic_impl = {
+	.hash_many = &blake3_generic_hash_many,
+	.is_supported = &blake3_generic_will_work,
+	.degree = 1,
+	.name = "generic"
+};
@@ -0,0 +1,387 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * BLAKE3 implementation selection.
+ *
+ * The implementations differ only in how many inputs their hash_many
+ * compresses in parallel.  Those the CPU supports are benchmarked when the
+ * module loads, in the same way as fletcher_4; the results are reported in
+ * the blake3_bench kstat and the implementation in use can be changed with
+ * the icp_blake3_impl module parameter.  A hash context sticks with the
+ * implementation that was selected when it was initialized.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/crypto/icp.h>
+#include <blake3/blake3_impl.h>
+
+#define	IMPL_FASTEST	(UINT32_MAX)
+#define	IMPL_CYCLE	(UINT32_MAX-1)
+
+#define	BLAKE3_IMPL_READ(i) (*(volatile uint32_t *) &(i))
+
+static const blake3_impl_ops_t *const blake3_all_impl[] = {
+	&blake3_generic_impl,
+#if defined(__x86_64) && defined(HAVE_SSSE3)
+	&blake3_ssse3_impl,
+#endif
+#if defined(__x86_64) && defined(HAVE_AVX2)
+	&blake3_avx2_impl,
+#endif
+#if defined(__x86_64) && defined(HAVE_AVX512F)
+	&blake3_avx512_impl,
+#endif
+};
+
+/* Indicate that benchmark has been completed */
+static boolean_t blake3_impl_initialized = B_FALSE;
+
+/* Select BLAKE3 implementation */
+static uint32_t icp_blake3_impl = IMPL_FASTEST;
+static uint32_t user_sel_impl = IMPL_FASTEST;
+
+/* Hold all supported implementations */
+static size_t blake3_supp_impl_cnt = 0;
+static const blake3_impl_ops_t *blake3_supp_impl[
+    ARRAY_SIZE(blake3_all_impl)];
+
+/* Implementation that contains the fastest method */
+static blake3_impl_ops_t blake3_fastest_impl = {
+	.name = "fastest"
+};
+
+/*
+ * Returns the BLAKE3 operations for hashing.  BLAKE3 is also used before
+ * the ICP is initialized, e.g. by the test programs; the generic
+ * implementation always works.
+ */
+const blake3_impl_ops_t *
+blake3_impl_get_ops(void)
+{
+	const blake3_impl_ops_t *ops = NULL;
+	const uint32_t impl = BLAKE3_IMPL_READ(icp_blake3_impl);
+
+	if (!blake3_impl_initialized)
+		return (&blake3_generic_impl);
+
+	switch (impl) {
+	case IMPL_FASTEST:
+		ops = &blake3_fastest_impl;
+		break;
+	case IMPL_CYCLE:
+	{
+		ASSERT3U(blake3_supp_impl_cnt, >, 0);
+		/* Cycle through supported implementations */
+		static size_t cycle_impl_idx = 0;
+		size_t idx = (++cycle_impl_idx) % blake3_supp_impl_cnt;
+		ops = blake3_supp_impl[idx];
+	}
+	break;
+	default:
+		ASSERT3U(impl, <, blake3_supp_impl_cnt);
+		if (impl < blake3_supp_impl_cnt)
+			ops = blake3_supp_impl[impl];
+		break;
+	}
+
+	ASSERT3P(ops, !=, NULL);
+
+	return (ops);
+}
+
+#if defined(_KERNEL)
+#define	BLAKE3_BENCH_NS	(MSEC2NSEC(10))		/* 10ms */
+
+typedef struct blake3_impl_bench {
+	const char	*bib_name;	/* implementation benchmarked */
+	const char	*bib_fastest;	/* set for the "fastest" entry only */
+	uint64_t	bib_bw;		/* bytes per second */
+} blake3_impl_bench_t;
+
+/* one entry per supported implementation, plus "fastest" */
+static blake3_impl_bench_t blake3_bench[ARRAY_SIZE(blake3_all_impl) + 1];
+static kstat_t *blake3_bench_kstat = NULL;
+
+static int
+blake3_impl_kstat_headers(char *buf, size_t size)
+{
+	ssize_t off = 0;
+
+	off += snprintf(buf + off, size, "%-17s", "implementation");
+	(void) snprintf(buf + off, size - off, "%-15s\n", "bytes/sec");
+
+	return (0);
+}
+
+static int
+blake3_impl_kstat_data(char *buf, size_t size, void *data)
+{
+	blake3_impl_bench_t *bench = data;
+	ssize_t off = 0;
+
+	off += snprintf(buf + off, size - off, "%-17s", bench->bib_name);
+	if (bench->bib_fastest != NULL) {
+		(void) snprintf(buf + off, size - off, "%-15s\n",
+		    bench->bib_fastest);
+	} else {
+		(void) snprintf(buf + off, size - off, "%-15llu\n",
+		    (u_longlong_t)bench->bib_bw);
+	}
+
+	return (0);
+}
+
+static void *
+blake3_impl_kstat_addr(kstat_t *ksp, loff_t n)
+{
+	if (n <= blake3_supp_impl_cnt)
+		ksp->ks_private = (void *) (blake3_bench + n);
+	else
+		ksp->ks_private = NULL;
+
+	return (ksp->ks_private);
+}
+
+static void
+blake3_impl_benchmark(const void *data, size_t size)
+{
+	blake3_impl_bench_t *fastest = &blake3_bench[blake3_supp_impl_cnt];
+	uint64_t run_bw, run_time_ns, best_run = 0;
+	uint8_t digest[BLAKE3_OUT_LEN];
+	size_t best = 0;
+	BLAKE3_CTX *ctx;
+	hrtime_t start;
+	int i, l;
+
+	ctx = kmem_alloc(sizeof (*ctx), KM_SLEEP);
+
+	for (i = 0; i < blake3_supp_impl_cnt; i++) {
+		const blake3_impl_ops_t *ops = blake3_supp_impl[i];
+		uint64_t run_count = 0;
+
+		kpreempt_disable();
+		start = gethrtime();
+		do {
+			for (l = 0; l < 8; l++, run_count++) {
+				Blake3_Init(ctx);
+				ctx->bctx_ops = ops;
+				Blake3_Update(ctx, data, size);
+				Blake3_Final(ctx, digest);
+			}
+			run_time_ns = gethrtime() - start;
+		} while (run_time_ns < BLAKE3_BENCH_NS);
+		kpreempt_enable();
+
+		run_bw = size * run_count * NANOSEC;
+		run_bw /= run_time_ns;	/* B/s */
+
+		blake3_bench[i].bib_name = ops->name;
+		blake3_bench[i].bib_bw = run_bw;
+
+		if (run_bw > best_run) {
+			best_run = run_bw;
+			best = i;
+		}
+	}
+
+	kmem_free(ctx, sizeof (*ctx));
+
+	memcpy(&blake3_fastest_impl, blake3_supp_impl[best],
+	    sizeof (blake3_fastest_impl));
+	fastest->bib_name = "fastest";
+	fastest->bib_fastest = blake3_supp_impl[best]->name;
+}
+#endif
+
+/*
+ * Initialize all supported implementations.
+ */
+void
+blake3_impl_init(void)
+{
+	const blake3_impl_ops_t *curr_impl;
+	int i, c;
+
+	/* move supported impl into blake3_supp_impl */
+	for (i = 0, c = 0; i < ARRAY_SIZE(blake3_all_impl); i++) {
+		curr_impl = blake3_all_impl[i];
+
+		if (curr_impl->is_supported())
+			blake3_supp_impl[c++] = curr_impl;
+	}
+	blake3_supp_impl_cnt = c;
+
+#if !defined(_KERNEL)
+	/* Skip benchmarking and use last implementation as fastest */
+	memcpy(&blake3_fastest_impl,
+	    blake3_supp_impl[blake3_supp_impl_cnt - 1],
+	    sizeof (blake3_fastest_impl));
+#else
+	static const size_t data_size = 128 * 1024;
+	char *databuf;
+
+	/* Benchmark all supported implementations */
+	databuf = vmem_alloc(data_size, KM_SLEEP);
+	for (i = 0; i < data_size / sizeof (uint64_t); i++)
+		((uint64_t *)databuf)[i] = (uintptr_t)(databuf+i); /* warm-up */
+
+	blake3_impl_benchmark(databuf, data_size);
+
+	vmem_free(databuf, data_size);
+
+	/* install kstats for all implementations */
+	blake3_bench_kstat = kstat_create("zfs", 0, "blake3_bench", "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+	if (blake3_bench_kstat != NULL) {
+		blake3_bench_kstat->ks_data = NULL;
+		blake3_bench_kstat->ks_ndata = UINT32_MAX;
+		kstat_set_raw_ops(blake3_bench_kstat,
+		    blake3_impl_kstat_headers,
+		    blake3_impl_kstat_data,
+		    blake3_impl_kstat_addr);
+		kstat_install(blake3_bench_kstat);
+	}
+#endif
+
+	strcpy(blake3_fastest_impl.name, "fastest");
+
+	/* Finish initialization */
+	atomic_swap_32(&icp_blake3_impl, user_sel_impl);
+	blake3_impl_initialized = B_TRUE;
+}
+
+void
+blake3_impl_fini(void)
+{
+#if defined(_KERNEL)
+	if (blake3_bench_kstat != NULL) {
+		kstat_delete(blake3_bench_kstat);
+		blake3_bench_kstat = NULL;
+	}
+#endif
+	blake3_impl_initialized = B_FALSE;
+}
+
+static const struct {
+	char *name;
+	uint32_t sel;
+} blake3_impl_opts[] = {
+		{ "cycle",	IMPL_CYCLE },
+		{ "fastest",	IMPL_FASTEST },
+};
+
+/*
+ * Function sets desired BLAKE3 implementation.
+ *
+ * If we are called before init(), user preference will be saved in
+ * user_sel_impl, and applied in later init() call. This occurs when module
+ * parameter is specified on module load. Otherwise, directly update
+ * icp_blake3_impl.
+ *
+ * @val		Name of BLAKE3 implementation to use
+ */
+int
+blake3_impl_set(const char *val)
+{
+	int err = -EINVAL;
+	char req_name[BLAKE3_IMPL_NAME_MAX];
+	uint32_t impl = BLAKE3_IMPL_READ(user_sel_impl);
+	size_t i;
+
+	/* sanitize input */
+	i = strnlen(val, BLAKE3_IMPL_NAME_MAX);
+	if (i == 0 || i >= BLAKE3_IMPL_NAME_MAX)
+		return (err);
+
+	strlcpy(req_name, val, BLAKE3_IMPL_NAME_MAX);
+	while (i > 0 && isspace(req_name[i-1]))
+		i--;
+	req_name[i] = '\0';
+
+	/* Check mandatory options */
+	for (i = 0; i < ARRAY_SIZE(blake3_impl_opts); i++) {
+		if (strcmp(req_name, blake3_impl_opts[i].name) == 0) {
+			impl = blake3_impl_opts[i].sel;
+			err = 0;
+			break;
+		}
+	}
+
+	/* check all supported impl if init() was already called */
+	if (err != 0 && blake3_impl_initialized) {
+		/* check all supported implementations */
+		for (i = 0; i < blake3_supp_impl_cnt; i++) {
+			if (strcmp(req_name, blake3_supp_impl[i]->name) == 0) {
+				impl = i;
+				err = 0;
+				break;
+			}
+		}
+	}
+
+	if (err == 0) {
+		if (blake3_impl_initialized)
+			atomic_swap_32(&icp_blake3_impl, impl);
+		else
+			atomic_swap_32(&user_sel_impl, impl);
+	}
+
+	return (err);
+}
+
+#if defined(_KERNEL)
+#include <linux/mod_compat.h>
+
+static int
+icp_blake3_impl_set(const char *val, zfs_kernel_param_t *kp)
+{
+	return (blake3_impl_set(val));
+}
+
+static int
+icp_blake3_impl_get(char *buffer, zfs_kernel_param_t *kp)
+{
+	int i, cnt = 0;
+	char *fmt;
+	const uint32_t impl = BLAKE3_IMPL_READ(icp_blake3_impl);
+
+	ASSERT(blake3_impl_initialized);
+
+	/* list mandatory options */
+	for (i = 0; i < ARRAY_SIZE(blake3_impl_opts); i++) {
+		fmt = (impl == blake3_impl_opts[i].sel) ? "[%s] " : "%s ";
+		cnt += sprintf(buffer + cnt, fmt, blake3_impl_opts[i].name);
+	}
+
+	/* list all supported implementations */
+	for (i = 0; i < blake3_supp_impl_cnt; i++) {
+		fmt = (i == impl) ? "[%s] " : "%s ";
+		cnt += sprintf(buffer + cnt, fmt, blake3_supp_impl[i]->name);
+	}
+
+	return (cnt);
+}
+
+module_param_call(icp_blake3_impl, icp_blake3_impl_set, icp_blake3_impl_get,
+    NULL, 0644);
+MODULE_PARM_DESC(icp_blake3_impl, "Select BLAKE3 implementation.");
+#endif
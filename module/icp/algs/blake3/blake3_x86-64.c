@@ -0,0 +1,103 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#if defined(__x86_64)
+
+#include <sys/zfs_context.h>
+#include <linux/simd_x86.h>
+#include <blake3/blake3_impl.h>
+
+#if defined(HAVE_SSSE3)
+extern void blake3_hash_many_ssse3(blake3_many_t *bm);
+
+static void
+blake3_ssse3_hash_many(blake3_many_t *bm)
+{
+	kfpu_begin();
+	blake3_hash_many_ssse3(bm);
+	kfpu_end();
+}
+
+static boolean_t
+blake3_ssse3_will_work(void)
+{
+	return (zfs_ssse3_available());
+}
+
+const blake3_impl_ops_t blake3_ssse3_impl = {
+	.hash_many = &blake3_ssse3_hash_many,
+	.is_supported = &blake3_ssse3_will_work,
+	.degree = 4,
+	.name = "ssse3"
+};
+#endif /* defined(HAVE_SSSE3) */
+
+#if defined(HAVE_AVX2)
+extern void blake3_hash_many_avx2(blake3_many_t *bm);
+
+static void
+blake3_avx2_hash_many(blake3_many_t *bm)
+{
+	kfpu_begin();
+	blake3_hash_many_avx2(bm);
+	kfpu_end();
+}
+
+static boolean_t
+blake3_avx2_will_work(void)
+{
+	return (zfs_avx_available() && zfs_avx2_available());
+}
+
+const blake3_impl_ops_t blake3_avx2_impl = {
+	.hash_many = &blake3_avx2_hash_many,
+	.is_supported = &blake3_avx2_will_work,
+	.degree = 8,
+	.name = "avx2"
+};
+#endif /* defined(HAVE_AVX2) */
+
+#if defined(HAVE_AVX512F)
+extern void blake3_hash_many_avx512(blake3_many_t *bm);
+
+static void
+blake3_avx512_hash_many(blake3_many_t *bm)
+{
+	kfpu_begin();
+	blake3_hash_many_avx512(bm);
+	kfpu_end();
+}
+
+static boolean_t
+blake3_avx512_will_work(void)
+{
+	return (zfs_avx512f_available());
+}
+
+const blake3_impl_ops_t blake3_avx512_impl = {
+	.hash_many = &blake3_avx512_hash_many,
+	.is_supported = &blake3_avx512_will_work,
+	.degree = 16,
+	.name = "avx512"
+};
+#endif /* defined(HAVE_AVX512F) */
+
+#endif /* defined(__x86_64) */
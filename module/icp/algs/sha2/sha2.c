@@ -40,6 +40,7 @@
 #define	_SHA2_IMPL
 #include <sys/sha2.h>
 #include <sha2/sha2_consts.h>
+#include <sha2/sha2_impl.h>
 
 #define	_RESTRICT_KYWD
 
@@ -52,18 +53,8 @@
 static void Encode(uint8_t *, uint32_t *, size_t);
 static void Encode64(uint8_t *, uint64_t *, size_t);
 
-/* userspace only supports the generic version */
-#if	defined(__amd64) && defined(_KERNEL)
-#define	SHA512Transform(ctx, in) SHA512TransformBlocks((ctx), (in), 1)
-#define	SHA256Transform(ctx, in) SHA256TransformBlocks((ctx), (in), 1)
-
-void SHA512TransformBlocks(SHA2_CTX *ctx, const void *in, size_t num);
-void SHA256TransformBlocks(SHA2_CTX *ctx, const void *in, size_t num);
-
-#else
 static void SHA256Transform(SHA2_CTX *, const uint8_t *);
 static void SHA512Transform(SHA2_CTX *, const uint8_t *);
-#endif	/* __amd64 && _KERNEL */
 
 static uint8_t PADDING[128] = { 0x80, /* all zeros */ };
 
@@ -143,7 +134,6 @@ static uint8_t PADDING[128] = { 0x80, /* all zeros */ };
 #endif	/* _BIG_ENDIAN */
 
 
-#if	!defined(__amd64) || !defined(_KERNEL)
 /* SHA256 Transform */
 
 static void
@@ -601,7 +591,42 @@ SHA512Transform(SHA2_CTX *ctx, const uint8_t *blk)
 	ctx->state.s64[7] += h;
 
 }
-#endif	/* !__amd64 || !_KERNEL */
+
+static void
+sha256_generic_transform(SHA2_CTX *ctx, const void *in, size_t num)
+{
+	const uint8_t *blk = in;
+
+	for (; num > 0; num--, blk += 64)
+		SHA256Transform(ctx, blk);
+}
+
+static void
+sha512_generic_transform(SHA2_CTX *ctx, const void *in, size_t num)
+{
+	const uint8_t *blk = in;
+
+	for (; num > 0; num--, blk += 128)
+		SHA512Transform(ctx, blk);
+}
+
+static boolean_t
+sha2_generic_will_work(void)
+{
+	return (B_TRUE);
+}
+
+const sha2_impl_ops_t sha256_generic_impl = {
+	.transform = &sha256_generic_transform,
+	.is_supported = &sha2_generic_will_work,
+	.name = "generic"
+};
+
+const sha2_impl_ops_t sha512_generic_impl = {
+	.transform = &sha512_generic_transform,
+	.is_supported = &sha2_generic_will_work,
+	.name = "generic"
+};
 
 
 /*
@@ -781,15 +806,17 @@ SHA512Init(SHA512_CTX *ctx)
 void
 SHA2Update(SHA2_CTX *ctx, const void *inptr, size_t input_len)
 {
-	uint32_t	i, buf_index, buf_len, buf_limit;
+	uint32_t	i, buf_index, buf_len, buf_limit, block_count;
 	const uint8_t	*input = inptr;
 	uint32_t	algotype = ctx->algotype;
+	const sha2_impl_ops_t *ops;
 
 	/* check for noop */
 	if (input_len == 0)
 		return;
 
 	if (algotype <= SHA256_HMAC_GEN_MECH_INFO_TYPE) {
+		ops = sha256_impl_get_ops();
 		buf_limit = 64;
 
 		/* compute number of bytes mod 64 */
@@ -802,6 +829,7 @@ SHA2Update(SHA2_CTX *ctx, const void *inptr, size_t input_len)
 		ctx->count.c32[0] += (input_len >> 29);
 
 	} else {
+		ops = sha512_impl_get_ops();
 		buf_limit = 128;
 
 		/* compute number of bytes mod 128 */
@@ -831,44 +859,17 @@ SHA2Update(SHA2_CTX *ctx, const void *inptr, size_t input_len)
 		 */
 		if (buf_index) {
 			bcopy(input, &ctx->buf_un.buf8[buf_index], buf_len);
-			if (algotype <= SHA256_HMAC_GEN_MECH_INFO_TYPE)
-				SHA256Transform(ctx, ctx->buf_un.buf8);
-			else
-				SHA512Transform(ctx, ctx->buf_un.buf8);
+			ops->transform(ctx, ctx->buf_un.buf8, 1);
 
 			i = buf_len;
 		}
 
-#if !defined(__amd64) || !defined(_KERNEL)
-		if (algotype <= SHA256_HMAC_GEN_MECH_INFO_TYPE) {
-			for (; i + buf_limit - 1 < input_len; i += buf_limit) {
-				SHA256Transform(ctx, &input[i]);
-			}
-		} else {
-			for (; i + buf_limit - 1 < input_len; i += buf_limit) {
-				SHA512Transform(ctx, &input[i]);
-			}
+		block_count = (input_len - i) / buf_limit;
+		if (block_count > 0) {
+			ops->transform(ctx, &input[i], block_count);
+			i += block_count * buf_limit;
 		}
 
-#else
-		uint32_t block_count;
-		if (algotype <= SHA256_HMAC_GEN_MECH_INFO_TYPE) {
-			block_count = (input_len - i) >> 6;
-			if (block_count > 0) {
-				SHA256TransformBlocks(ctx, &input[i],
-				    block_count);
-				i += block_count << 6;
-			}
-		} else {
-			block_count = (input_len - i) >> 7;
-			if (block_count > 0) {
-				SHA512TransformBlocks(ctx, &input[i],
-				    block_count);
-				i += block_count << 7;
-			}
-		}
-#endif	/* !__amd64 || !_KERNEL */
-
 		/*
 		 * general optimization:
 		 *
@@ -949,8 +950,214 @@ SHA2Final(void *digest, SHA2_CTX *ctx)
 	bzero(ctx, sizeof (*ctx));
 }
 
+/*
+ * Multi-buffer SHA256.
+ *
+ * A SHA256_MB_CTX hashes up to SHA256_MB_MAX_LANES messages in lockstep,
+ * each a whole number of blocks long, though not necessarily fed to
+ * SHA256MBUpdate() in whole blocks.  The block transform of the
+ * multi-buffer implementation selected with icp_sha256_mb_impl works on
+ * degree messages at a time, so a single update covers the lanes in
+ * groups of that size.  Lanes without data in an update are idle; their
+ * state is set aside while their group is transformed.
+ */
+static const uint32_t sha256_iv[8] = {
+	0x6a09e667U, 0xbb67ae85U, 0x3c6ef372U, 0xa54ff53aU,
+	0x510e527fU, 0x9b05688cU, 0x1f83d9abU, 0x5be0cd19U
+};
+
+/*
+ * Transforms one message at a time with the selected sha256
+ * implementation, for when that is faster than any multi-buffer one.
+ */
+static void
+sha256_mb_single_transform(uint32_t *state, const uint8_t **data,
+    size_t num)
+{
+	const sha2_impl_ops_t *ops = sha256_impl_get_ops();
+	SHA2_CTX ctx;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		ctx.state.s32[i] = state[i * SHA256_MB_MAX_LANES];
+	ops->transform(&ctx, data[0], num);
+	for (i = 0; i < 8; i++)
+		state[i * SHA256_MB_MAX_LANES] = ctx.state.s32[i];
+}
+
+const sha2_impl_ops_t sha256_mb_single_impl = {
+	.transform_many = &sha256_mb_single_transform,
+	.is_supported = &sha2_generic_will_work,
+	.degree = 1,
+	.name = "single"
+};
+
+/*
+ * Returns the number of messages the selected multi-buffer implementation
+ * hashes at the cost of one; batching fewer than that gains nothing.
+ */
+size_t
+SHA256MBDegree(void)
+{
+	return (sha256_mb_impl_get_ops()->degree);
+}
+
+void
+SHA256MBInit(SHA256_MB_CTX *ctx, int lanes)
+{
+	int i, l;
+
+	ASSERT3S(lanes, >, 0);
+	ASSERT3S(lanes, <=, SHA256_MB_MAX_LANES);
+
+	for (i = 0; i < 8; i++) {
+		for (l = 0; l < SHA256_MB_MAX_LANES; l++)
+			ctx->state[i][l] = sha256_iv[i];
+	}
+	bzero(ctx->count, sizeof (ctx->count));
+	ctx->buffered = 0;
+	ctx->lanes = lanes;
+}
+
+/*
+ * Transforms len bytes, a multiple of the block size, of data[l] into
+ * each lane l for which data[l] is not NULL.
+ */
+static void
+sha256_mb_blocks(SHA256_MB_CTX *ctx, const uint8_t **data, size_t len)
+{
+	const sha2_impl_ops_t *ops = sha256_mb_impl_get_ops();
+	const uint8_t *lane_data[SHA256_MB_MAX_LANES];
+	int degree = ops->degree;
+	int g, l, i, end, active;
+
+	ASSERT0(len % 64);
+	ASSERT0(SHA256_MB_MAX_LANES % degree);
+
+	for (g = 0; g < ctx->lanes; g += degree) {
+		end = MIN(g + degree, ctx->lanes);
+
+		/* pick an active lane to stand in for the idle ones */
+		for (active = g; active < end; active++) {
+			if (data[active] != NULL)
+				break;
+		}
+		if (active == end)
+			continue;
+
+		for (l = g; l < g + degree; l++) {
+			if (l < ctx->lanes && data[l] != NULL) {
+				lane_data[l] = data[l];
+			} else {
+				lane_data[l] = data[active];
+				for (i = 0; i < 8; i++)
+					ctx->idle[i][l] = ctx->state[i][l];
+			}
+		}
+
+		ops->transform_many(&ctx->state[0][g], &lane_data[g], len / 64);
+
+		for (l = g; l < end; l++) {
+			if (data[l] != NULL)
+				continue;
+			for (i = 0; i < 8; i++)
+				ctx->state[i][l] = ctx->idle[i][l];
+		}
+	}
+}
+
+/*
+ * Hashes len bytes of data[l] into each lane l for which data[l] is not
+ * NULL.  Every update is the same length for all of its lanes, so a
+ * partial block is buffered for all of them alike; a lane may only go
+ * idle at a block boundary.
+ */
+void
+SHA256MBUpdate(SHA256_MB_CTX *ctx, const void **data, size_t len)
+{
+	const uint8_t *lane_data[SHA256_MB_MAX_LANES];
+	size_t off = 0, n;
+	int l;
+
+	while (off < len) {
+		if (ctx->buffered == 0 && len - off >= 64) {
+			n = (len - off) & ~(size_t)63;
+			for (l = 0; l < ctx->lanes; l++) {
+				lane_data[l] = (data[l] == NULL) ? NULL :
+				    (const uint8_t *)data[l] + off;
+			}
+			sha256_mb_blocks(ctx, lane_data, n);
+		} else {
+			n = MIN(64 - ctx->buffered, len - off);
+			for (l = 0; l < ctx->lanes; l++) {
+				lane_data[l] = NULL;
+				if (data[l] == NULL)
+					continue;
+				bcopy((const uint8_t *)data[l] + off,
+				    &ctx->pad[l][ctx->buffered], n);
+				lane_data[l] = ctx->pad[l];
+			}
+			ctx->buffered += n;
+			if (ctx->buffered == 64) {
+				sha256_mb_blocks(ctx, lane_data, 64);
+				ctx->buffered = 0;
+			}
+		}
+
+		for (l = 0; l < ctx->lanes; l++) {
+			if (data[l] != NULL)
+				ctx->count[l] += n;
+		}
+		off += n;
+	}
+}
+
+/*
+ * Pads every lane and stores the SHA256 digest of lane l at offset
+ * l * SHA256_DIGEST_LENGTH of digests.
+ */
+void
+SHA256MBFinal(void *digests, SHA256_MB_CTX *ctx)
+{
+	const uint8_t *data[SHA256_MB_MAX_LANES];
+	uint8_t *digest = digests;
+	uint64_t bits;
+	int i, l;
+
+	ASSERT0(ctx->buffered);
+	for (l = 0; l < ctx->lanes; l++) {
+		ASSERT0(ctx->count[l] % 64);
+		bits = ctx->count[l] * NBBY;
+		bzero(ctx->pad[l], sizeof (ctx->pad[l]));
+		ctx->pad[l][0] = 0x80;
+		for (i = 0; i < sizeof (bits); i++)
+			ctx->pad[l][63 - i] = (uint8_t)(bits >> (i * NBBY));
+		data[l] = ctx->pad[l];
+	}
+	sha256_mb_blocks(ctx, data, sizeof (ctx->pad[0]));
+
+	for (l = 0; l < ctx->lanes; l++) {
+		for (i = 0; i < 8; i++) {
+			uint32_t word = ctx->state[i][l];
+
+			digest[0] = (word >> 24) & 0xff;
+			digest[1] = (word >> 16) & 0xff;
+			digest[2] = (word >> 8) & 0xff;
+			digest[3] = word & 0xff;
+			digest += sizeof (word);
+		}
+	}
+
+	/* zeroize sensitive information */
+	bzero(ctx, sizeof (*ctx));
+}
+
 #ifdef _KERNEL
 EXPORT_SYMBOL(SHA2Init);
 EXPORT_SYMBOL(SHA2Update);
 EXPORT_SYMBOL(SHA2Final);
+EXPORT_SYMBOL(SHA256MBDegree);
+EXPORT_SYMBOL(SHA256MBInit);
+EXPORT_SYMBOL(SHA256MBUpdate);
+EXPORT_SYMBOL(SHA256MBFinal);
 #endif
@@ -0,0 +1,111 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#if defined(__x86_64)
+
+#include <sys/zfs_context.h>
+#include <linux/simd_x86.h>
+#define	_SHA2_IMPL
+#include <sha2/sha2_impl.h>
+
+/*
+ * Multi-buffer SHA256 transforms, which keep one lane of every vector
+ * register per message.  They are only worthwhile with enough messages to
+ * fill the lanes, which the ZIO pipeline provides by batching blocks.
+ */
+
+#if defined(HAVE_SSSE3)
+extern void sha256_mb_ssse3(uint32_t *, const uint8_t **, size_t);
+
+static void
+sha256_mb_ssse3_transform(uint32_t *state, const uint8_t **data, size_t num)
+{
+	kfpu_begin();
+	sha256_mb_ssse3(state, data, num);
+	kfpu_end();
+}
+
+static boolean_t
+sha256_mb_ssse3_will_work(void)
+{
+	return (zfs_ssse3_available());
+}
+
+const sha2_impl_ops_t sha256_mb_ssse3_impl = {
+	.transform_many = &sha256_mb_ssse3_transform,
+	.is_supported = &sha256_mb_ssse3_will_work,
+	.degree = 4,
+	.name = "ssse3"
+};
+#endif /* defined(HAVE_SSSE3) */
+
+#if defined(HAVE_AVX2)
+extern void sha256_mb_avx2(uint32_t *, const uint8_t **, size_t);
+
+static void
+sha256_mb_avx2_transform(uint32_t *state, const uint8_t **data, size_t num)
+{
+	kfpu_begin();
+	sha256_mb_avx2(state, data, num);
+	kfpu_end();
+}
+
+static boolean_t
+sha256_mb_avx2_will_work(void)
+{
+	return (zfs_avx_available() && zfs_avx2_available());
+}
+
+const sha2_impl_ops_t sha256_mb_avx2_impl = {
+	.transform_many = &sha256_mb_avx2_transform,
+	.is_supported = &sha256_mb_avx2_will_work,
+	.degree = 8,
+	.name = "avx2"
+};
+#endif /* defined(HAVE_AVX2) */
+
+#if defined(HAVE_AVX512BW)
+extern void sha256_mb_avx512(uint32_t *, const uint8_t **, size_t);
+
+static void
+sha256_mb_avx512_transform(uint32_t *state, const uint8_t **data,
+    size_t num)
+{
+	kfpu_begin();
+	sha256_mb_avx512(state, data, num);
+	kfpu_end();
+}
+
+static boolean_t
+sha256_mb_avx512_will_work(void)
+{
+	return (zfs_avx512f_available() && zfs_avx512bw_available());
+}
+
+const sha2_impl_ops_t sha256_mb_avx512_impl = {
+	.transform_many = &sha256_mb_avx512_transform,
+	.is_supported = &sha256_mb_avx512_will_work,
+	.degree = 16,
+	.name = "avx512"
+};
+#endif /* defined(HAVE_AVX512BW) */
+
+#endif /* defined(__x86_64) */
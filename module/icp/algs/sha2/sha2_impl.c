@@ -0,0 +1,534 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * SHA-256 and SHA-512 implementation selection.
+ *
+ * Every SHA2 block transform is compiled in and those the CPU supports are
+ * benchmarked when the module loads, in the same way as fletcher_4.  The
+ * results are reported in the sha256_bench and sha512_bench kstats, and the
+ * implementation in use can be changed with the icp_sha256_impl and
+ * icp_sha512_impl module parameters.  All implementations keep the hash
+ * state in the same layout, so switching between them, even in the middle
+ * of a hash, is safe.
+ *
+ * The multi-buffer SHA256 transforms, which hash several messages in
+ * parallel, are selected the same way through sha256_mb_bench and
+ * icp_sha256_mb_impl.  Their benchmark measures the combined throughput
+ * of all lanes, and the "single" implementation, which hashes one message
+ * at a time with the selected sha256 transform, competes with them.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/crypto/icp.h>
+#define	_SHA2_IMPL
+#include <sha2/sha2_impl.h>
+
+#define	IMPL_FASTEST	(UINT32_MAX)
+#define	IMPL_CYCLE	(UINT32_MAX-1)
+
+#define	SHA2_IMPL_READ(i) (*(volatile uint32_t *) &(i))
+
+#define	SHA2_IMPL_MAX	(4)
+
+#define	SHA2_BENCH_NS	(MSEC2NSEC(10))		/* 10ms */
+
+typedef struct sha2_impl_bench {
+	const char	*sib_name;	/* implementation benchmarked */
+	const char	*sib_fastest;	/* set for the "fastest" entry only */
+	uint64_t	sib_bw;		/* bytes per second */
+} sha2_impl_bench_t;
+
+typedef struct sha2_impl_sel {
+	const char		*sis_name;
+	size_t			sis_blocksize;
+	boolean_t		sis_many;	/* multi-buffer transforms */
+	const sha2_impl_ops_t	*sis_all[SHA2_IMPL_MAX];
+	const sha2_impl_ops_t	*sis_supp[SHA2_IMPL_MAX];
+	size_t			sis_supp_cnt;
+	sha2_impl_ops_t		sis_fastest;
+	uint32_t		sis_impl;
+	uint32_t		sis_user_sel;
+	boolean_t		sis_initialized;
+	/* one entry per supported implementation, plus "fastest" */
+	sha2_impl_bench_t	sis_bench[SHA2_IMPL_MAX + 1];
+	kstat_t			*sis_kstat;
+} sha2_impl_sel_t;
+
+static sha2_impl_sel_t sha256_impl_sel = {
+	.sis_name = "sha256",
+	.sis_blocksize = 64,
+	.sis_all = {
+		&sha256_generic_impl,
+#if defined(__x86_64)
+		&sha256_x86_64_impl,
+#endif
+#if defined(__x86_64) && defined(HAVE_SHA)
+		&sha256_shani_impl,
+#endif
+	},
+	.sis_impl = IMPL_FASTEST,
+	.sis_user_sel = IMPL_FASTEST,
+};
+
+static sha2_impl_sel_t sha512_impl_sel = {
+	.sis_name = "sha512",
+	.sis_blocksize = 128,
+	.sis_all = {
+		&sha512_generic_impl,
+#if defined(__x86_64)
+		&sha512_x86_64_impl,
+#endif
+	},
+	.sis_impl = IMPL_FASTEST,
+	.sis_user_sel = IMPL_FASTEST,
+};
+
+static sha2_impl_sel_t sha256_mb_impl_sel = {
+	.sis_name = "sha256_mb",
+	.sis_blocksize = 64,
+	.sis_many = B_TRUE,
+	.sis_all = {
+		&sha256_mb_single_impl,
+#if defined(__x86_64) && defined(HAVE_SSSE3)
+		&sha256_mb_ssse3_impl,
+#endif
+#if defined(__x86_64) && defined(HAVE_AVX2)
+		&sha256_mb_avx2_impl,
+#endif
+#if defined(__x86_64) && defined(HAVE_AVX512BW)
+		&sha256_mb_avx512_impl,
+#endif
+	},
+	.sis_impl = IMPL_FASTEST,
+	.sis_user_sel = IMPL_FASTEST,
+};
+
+static const sha2_impl_ops_t *
+sha2_impl_get_ops(sha2_impl_sel_t *sel)
+{
+	const sha2_impl_ops_t *ops = NULL;
+	const uint32_t impl = SHA2_IMPL_READ(sel->sis_impl);
+
+	/*
+	 * SHA2 is also used before the ICP is initialized, e.g. by libzfs
+	 * and the test programs; the generic implementation always works.
+	 */
+	if (!sel->sis_initialized)
+		return (sel->sis_all[0]);
+
+	switch (impl) {
+	case IMPL_FASTEST:
+		ops = &sel->sis_fastest;
+		break;
+	case IMPL_CYCLE:
+	{
+		ASSERT3U(sel->sis_supp_cnt, >, 0);
+		/* Cycle through supported implementations */
+		static size_t cycle_impl_idx = 0;
+		size_t idx = (++cycle_impl_idx) % sel->sis_supp_cnt;
+		ops = sel->sis_supp[idx];
+	}
+	break;
+	default:
+		ASSERT3U(impl, <, sel->sis_supp_cnt);
+		if (impl < sel->sis_supp_cnt)
+			ops = sel->sis_supp[impl];
+		break;
+	}
+
+	ASSERT3P(ops, !=, NULL);
+
+	return (ops);
+}
+
+const sha2_impl_ops_t *
+sha256_impl_get_ops(void)
+{
+	return (sha2_impl_get_ops(&sha256_impl_sel));
+}
+
+const sha2_impl_ops_t *
+sha512_impl_get_ops(void)
+{
+	return (sha2_impl_get_ops(&sha512_impl_sel));
+}
+
+const sha2_impl_ops_t *
+sha256_mb_impl_get_ops(void)
+{
+	return (sha2_impl_get_ops(&sha256_mb_impl_sel));
+}
+
+#if defined(_KERNEL)
+static int
+sha2_impl_kstat_headers(char *buf, size_t size)
+{
+	ssize_t off = 0;
+
+	off += snprintf(buf + off, size, "%-17s", "implementation");
+	(void) snprintf(buf + off, size - off, "%-15s\n", "bytes/sec");
+
+	return (0);
+}
+
+static int
+sha2_impl_kstat_data(char *buf, size_t size, void *data)
+{
+	sha2_impl_bench_t *bench = data;
+	ssize_t off = 0;
+
+	off += snprintf(buf + off, size - off, "%-17s", bench->sib_name);
+	if (bench->sib_fastest != NULL) {
+		(void) snprintf(buf + off, size - off, "%-15s\n",
+		    bench->sib_fastest);
+	} else {
+		(void) snprintf(buf + off, size - off, "%-15llu\n",
+		    (u_longlong_t)bench->sib_bw);
+	}
+
+	return (0);
+}
+
+static void *
+sha2_impl_kstat_addr(kstat_t *ksp, loff_t n)
+{
+	sha2_impl_sel_t *sel = ksp->ks_data;
+
+	if (n <= sel->sis_supp_cnt)
+		ksp->ks_private = (void *) (sel->sis_bench + n);
+	else
+		ksp->ks_private = NULL;
+
+	return (ksp->ks_private);
+}
+
+static void
+sha2_impl_benchmark(sha2_impl_sel_t *sel, const void *data, size_t size)
+{
+	sha2_impl_bench_t *fastest = &sel->sis_bench[sel->sis_supp_cnt];
+	uint64_t run_bw, run_time_ns, best_run = 0;
+	uint32_t state[8][SHA256_MB_MAX_LANES];
+	const uint8_t *lanes[SHA256_MB_MAX_LANES];
+	size_t best = 0;
+	SHA2_CTX ctx;
+	hrtime_t start;
+	int i, l;
+
+	bzero(&ctx, sizeof (ctx));
+	bzero(state, sizeof (state));
+
+	for (i = 0; i < sel->sis_supp_cnt; i++) {
+		const sha2_impl_ops_t *ops = sel->sis_supp[i];
+		uint64_t run_count = 0;
+
+		/* the lanes of a multi-buffer transform split the data */
+		for (l = 0; sel->sis_many && l < ops->degree; l++) {
+			lanes[l] = (const uint8_t *)data +
+			    l * size / ops->degree;
+		}
+
+		kpreempt_disable();
+		start = gethrtime();
+		do {
+			for (l = 0; l < 8; l++, run_count++) {
+				if (sel->sis_many) {
+					ops->transform_many(&state[0][0],
+					    lanes, size / ops->degree /
+					    sel->sis_blocksize);
+				} else {
+					ops->transform(&ctx, data,
+					    size / sel->sis_blocksize);
+				}
+			}
+			run_time_ns = gethrtime() - start;
+		} while (run_time_ns < SHA2_BENCH_NS);
+		kpreempt_enable();
+
+		run_bw = size * run_count * NANOSEC;
+		run_bw /= run_time_ns;	/* B/s */
+
+		sel->sis_bench[i].sib_name = ops->name;
+		sel->sis_bench[i].sib_bw = run_bw;
+
+		if (run_bw > best_run) {
+			best_run = run_bw;
+			best = i;
+		}
+	}
+
+	memcpy(&sel->sis_fastest, sel->sis_supp[best],
+	    sizeof (sel->sis_fastest));
+	fastest->sib_name = "fastest";
+	fastest->sib_fastest = sel->sis_supp[best]->name;
+}
+#endif
+
+/* ARGSUSED */
+static void
+sha2_impl_sel_init(sha2_impl_sel_t *sel, const void *data, size_t size)
+{
+	const sha2_impl_ops_t *curr_impl;
+	int i, c;
+
+	/* move supported impl into sis_supp */
+	for (i = 0, c = 0; i < SHA2_IMPL_MAX; i++) {
+		curr_impl = sel->sis_all[i];
+
+		if (curr_impl != NULL && curr_impl->is_supported())
+			sel->sis_supp[c++] = curr_impl;
+	}
+	sel->sis_supp_cnt = c;
+
+#if !defined(_KERNEL)
+	/* Skip benchmarking and use last implementation as fastest */
+	memcpy(&sel->sis_fastest, sel->sis_supp[sel->sis_supp_cnt - 1],
+	    sizeof (sel->sis_fastest));
+#else
+	/* Benchmark all supported implementations */
+	sha2_impl_benchmark(sel, data, size);
+
+	/* install kstats for all implementations */
+	char name[KSTAT_STRLEN];
+	(void) snprintf(name, sizeof (name), "%s_bench", sel->sis_name);
+	sel->sis_kstat = kstat_create("zfs", 0, name, "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+	if (sel->sis_kstat != NULL) {
+		sel->sis_kstat->ks_data = sel;
+		sel->sis_kstat->ks_ndata = UINT32_MAX;
+		kstat_set_raw_ops(sel->sis_kstat,
+		    sha2_impl_kstat_headers,
+		    sha2_impl_kstat_data,
+		    sha2_impl_kstat_addr);
+		kstat_install(sel->sis_kstat);
+	}
+#endif
+
+	strcpy(sel->sis_fastest.name, "fastest");
+
+	/* Finish initialization */
+	atomic_swap_32(&sel->sis_impl, sel->sis_user_sel);
+	sel->sis_initialized = B_TRUE;
+}
+
+void
+sha2_impl_init(void)
+{
+#if defined(_KERNEL)
+	static const size_t data_size = 128 * 1024;
+	char *databuf;
+	int i;
+
+	databuf = vmem_alloc(data_size, KM_SLEEP);
+	for (i = 0; i < data_size / sizeof (uint64_t); i++)
+		((uint64_t *)databuf)[i] = (uintptr_t)(databuf+i); /* warm-up */
+
+	sha2_impl_sel_init(&sha256_impl_sel, databuf, data_size);
+	sha2_impl_sel_init(&sha512_impl_sel, databuf, data_size);
+	sha2_impl_sel_init(&sha256_mb_impl_sel, databuf, data_size);
+
+	vmem_free(databuf, data_size);
+#else
+	sha2_impl_sel_init(&sha256_impl_sel, NULL, 0);
+	sha2_impl_sel_init(&sha512_impl_sel, NULL, 0);
+	sha2_impl_sel_init(&sha256_mb_impl_sel, NULL, 0);
+#endif
+}
+
+void
+sha2_impl_fini(void)
+{
+	sha2_impl_sel_t *sels[] = { &sha256_impl_sel, &sha512_impl_sel,
+	    &sha256_mb_impl_sel };
+
+	for (int i = 0; i < ARRAY_SIZE(sels); i++) {
+#if defined(_KERNEL)
+		if (sels[i]->sis_kstat != NULL) {
+			kstat_delete(sels[i]->sis_kstat);
+			sels[i]->sis_kstat = NULL;
+		}
+#endif
+		sels[i]->sis_initialized = B_FALSE;
+	}
+}
+
+static const struct {
+	char *name;
+	uint32_t sel;
+} sha2_impl_opts[] = {
+		{ "cycle",	IMPL_CYCLE },
+		{ "fastest",	IMPL_FASTEST },
+};
+
+/*
+ * Function sets desired sha256 or sha512 implementation.
+ *
+ * If we are called before init(), user preference will be saved in
+ * sis_user_sel, and applied in later init() call. This occurs when module
+ * parameter is specified on module load. Otherwise, directly update
+ * sis_impl.
+ *
+ * @sel		Selector of the algorithm
+ * @val		Name of implementation to use
+ */
+static int
+sha2_impl_set(sha2_impl_sel_t *sel, const char *val)
+{
+	int err = -EINVAL;
+	char req_name[SHA2_IMPL_NAME_MAX];
+	uint32_t impl = SHA2_IMPL_READ(sel->sis_user_sel);
+	size_t i;
+
+	/* sanitize input */
+	i = strnlen(val, SHA2_IMPL_NAME_MAX);
+	if (i == 0 || i >= SHA2_IMPL_NAME_MAX)
+		return (err);
+
+	strlcpy(req_name, val, SHA2_IMPL_NAME_MAX);
+	while (i > 0 && isspace(req_name[i-1]))
+		i--;
+	req_name[i] = '\0';
+
+	/* Check mandatory options */
+	for (i = 0; i < ARRAY_SIZE(sha2_impl_opts); i++) {
+		if (strcmp(req_name, sha2_impl_opts[i].name) == 0) {
+			impl = sha2_impl_opts[i].sel;
+			err = 0;
+			break;
+		}
+	}
+
+	/* check all supported impl if init() was already called */
+	if (err != 0 && sel->sis_initialized) {
+		/* check all supported implementations */
+		for (i = 0; i < sel->sis_supp_cnt; i++) {
+			if (strcmp(req_name, sel->sis_supp[i]->name) == 0) {
+				impl = i;
+				err = 0;
+				break;
+			}
+		}
+	}
+
+	if (err == 0) {
+		if (sel->sis_initialized)
+			atomic_swap_32(&sel->sis_impl, impl);
+		else
+			atomic_swap_32(&sel->sis_user_sel, impl);
+	}
+
+	return (err);
+}
+
+int
+sha256_impl_set(const char *val)
+{
+	return (sha2_impl_set(&sha256_impl_sel, val));
+}
+
+int
+sha512_impl_set(const char *val)
+{
+	return (sha2_impl_set(&sha512_impl_sel, val));
+}
+
+int
+sha256_mb_impl_set(const char *val)
+{
+	return (sha2_impl_set(&sha256_mb_impl_sel, val));
+}
+
+#if defined(_KERNEL)
+#include <linux/mod_compat.h>
+
+static int
+sha2_impl_get(sha2_impl_sel_t *sel, char *buffer)
+{
+	int i, cnt = 0;
+	char *fmt;
+	const uint32_t impl = SHA2_IMPL_READ(sel->sis_impl);
+
+	ASSERT(sel->sis_initialized);
+
+	/* list mandatory options */
+	for (i = 0; i < ARRAY_SIZE(sha2_impl_opts); i++) {
+		fmt = (impl == sha2_impl_opts[i].sel) ? "[%s] " : "%s ";
+		cnt += sprintf(buffer + cnt, fmt, sha2_impl_opts[i].name);
+	}
+
+	/* list all supported implementations */
+	for (i = 0; i < sel->sis_supp_cnt; i++) {
+		fmt = (i == impl) ? "[%s] " : "%s ";
+		cnt += sprintf(buffer + cnt, fmt, sel->sis_supp[i]->name);
+	}
+
+	return (cnt);
+}
+
+static int
+icp_sha256_impl_set(const char *val, zfs_kernel_param_t *kp)
+{
+	return (sha256_impl_set(val));
+}
+
+static int
+icp_sha256_impl_get(char *buffer, zfs_kernel_param_t *kp)
+{
+	return (sha2_impl_get(&sha256_impl_sel, buffer));
+}
+
+static int
+icp_sha512_impl_set(const char *val, zfs_kernel_param_t *kp)
+{
+	return (sha512_impl_set(val));
+}
+
+static int
+icp_sha512_impl_get(char *buffer, zfs_kernel_param_t *kp)
+{
+	return (sha2_impl_get(&sha512_impl_sel, buffer));
+}
+
+static int
+icp_sha256_mb_impl_set(const char *val, zfs_kernel_param_t *kp)
+{
+	return (sha256_mb_impl_set(val));
+}
+
+static int
+icp_sha256_mb_impl_get(char *buffer, zfs_kernel_param_t *kp)
+{
+	return (sha2_impl_get(&sha256_mb_impl_sel, buffer));
+}
+
+module_param_call(icp_sha256_impl, icp_sha256_impl_set, icp_sha256_impl_get,
+    NULL, 0644);
+MODULE_PARM_DESC(icp_sha256_impl, "Select sha256 implementation.");
+
+module_param_call(icp_sha512_impl, icp_sha512_impl_set, icp_sha512_impl_get,
+    NULL, 0644);
+MODULE_PARM_DESC(icp_sha512_impl, "Select sha512 implementation.");
+
+module_param_call(icp_sha256_mb_impl, icp_sha256_mb_impl_set,
+    icp_sha256_mb_impl_get, NULL, 0644);
+MODULE_PARM_DESC(icp_sha256_mb_impl,
+	"Select multi-buffer sha256 implementation.");
+#endif
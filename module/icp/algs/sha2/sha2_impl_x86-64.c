@@ -0,0 +1,53 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#if defined(__x86_64)
+
+#include <sys/zfs_context.h>
+#define	_SHA2_IMPL
+#include <sha2/sha2_impl.h>
+
+/*
+ * The OpenSSL derived routines in asm-x86_64/sha2 use only general purpose
+ * registers, so no FPU state needs to be saved around them.
+ */
+extern void SHA256TransformBlocks(SHA2_CTX *ctx, const void *in, size_t num);
+extern void SHA512TransformBlocks(SHA2_CTX *ctx, const void *in, size_t num);
+
+static boolean_t
+sha2_x86_64_will_work(void)
+{
+	return (B_TRUE);
+}
+
+const sha2_impl_ops_t sha256_x86_64_impl = {
+	.transform = &SHA256TransformBlocks,
+	.is_supported = &sha2_x86_64_will_work,
+	.name = "x86_64"
+};
+
+const sha2_impl_ops_t sha512_x86_64_impl = {
+	.transform = &SHA512TransformBlocks,
+	.is_supported = &sha2_x86_64_will_work,
+	.name = "x86_64"
+};
+
+#endif /* defined(__x86_64) */
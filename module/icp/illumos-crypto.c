@@ -109,6 +109,7 @@
 void __exit
 icp_fini(void)
 {
+	blake3_impl_fini();
 	skein_mod_fini();
 	sha2_mod_fini();
 	sha1_mod_fini();
@@ -145,6 +146,7 @@ icp_init(void)
 	sha1_mod_init();
 	sha2_mod_init();
 	skein_mod_init();
+	blake3_impl_init();
 
 	return (0);
 }
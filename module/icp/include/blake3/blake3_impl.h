@@ -0,0 +1,112 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef	_BLAKE3_IMPL_H
+#define	_BLAKE3_IMPL_H
+
+#include <sys/blake3.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* domain separation flags */
+#define	BLAKE3_CHUNK_START	(1 << 0)
+#define	BLAKE3_CHUNK_END	(1 << 1)
+#define	BLAKE3_PARENT		(1 << 2)
+#define	BLAKE3_ROOT		(1 << 3)
+#define	BLAKE3_KEYED_HASH	(1 << 4)
+
+#define	BLAKE3_MAX_SIMD_DEGREE	16
+
+/*
+ * Arguments of a hash_many call: bm_blocks blocks of each of "degree"
+ * inputs, which are bm_stride bytes apart, are compressed into bm_cv.
+ * The chaining values and counters are transposed, i.e. bm_cv[w][i] is
+ * word w of input i, which is the layout the SIMD implementations work
+ * in.  The offsets are also known to the assembly implementations.
+ */
+typedef struct blake3_many {
+	const uint8_t	*bm_input;
+	uint64_t	bm_stride;
+	uint64_t	bm_blocks;
+	uint32_t	bm_flags;
+	uint32_t	bm_flags_start;		/* added to the first block */
+	uint32_t	bm_flags_end;		/* added to the last block */
+	uint32_t	bm_pad[7];
+	uint32_t	bm_cv[8][BLAKE3_MAX_SIMD_DEGREE];
+	uint32_t	bm_ctr_lo[BLAKE3_MAX_SIMD_DEGREE];
+	uint32_t	bm_ctr_hi[BLAKE3_MAX_SIMD_DEGREE];
+} blake3_many_t;
+
+/*
+ * Methods used to define BLAKE3 implementations
+ *
+ * @blake3_hash_many_f Compresses whole blocks of "degree" inputs at once
+ * @blake3_will_work_f Function tests whether method will function
+ */
+typedef void		(*blake3_hash_many_f)(blake3_many_t *);
+typedef boolean_t	(*blake3_will_work_f)(void);
+
+#define	BLAKE3_IMPL_NAME_MAX (16)
+
+typedef struct blake3_impl_ops {
+	blake3_hash_many_f hash_many;
+	blake3_will_work_f is_supported;
+	size_t degree;
+	char name[BLAKE3_IMPL_NAME_MAX];
+} blake3_impl_ops_t;
+
+extern const blake3_impl_ops_t blake3_generic_impl;
+#if defined(__x86_64) && defined(HAVE_SSSE3)
+extern const blake3_impl_ops_t blake3_ssse3_impl;
+#endif
+#if defined(__x86_64) && defined(HAVE_AVX2)
+extern const blake3_impl_ops_t blake3_avx2_impl;
+#endif
+#if defined(__x86_64) && defined(HAVE_AVX512F)
+extern const blake3_impl_ops_t blake3_avx512_impl;
+#endif
+
+/*
+ * Single block compression, used for partial chunks, parent nodes which
+ * are not hashed in parallel, and the root.
+ */
+extern void blake3_compress_in_place(uint32_t cv[8],
+    const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len,
+    uint64_t counter, uint8_t flags);
+
+/*
+ * Initializes fastest implementation
+ */
+void blake3_impl_init(void);
+void blake3_impl_fini(void);
+
+/*
+ * Get selected BLAKE3 implementation
+ */
+const blake3_impl_ops_t *blake3_impl_get_ops(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _BLAKE3_IMPL_H */
@@ -57,6 +57,68 @@ typedef struct sha2_hmac_ctx {
 	SHA2_CTX		hc_ocontext;	/* outer SHA2 context */
 } sha2_hmac_ctx_t;
 
+/*
+ * Methods used to define sha256 and sha512 implementations
+ *
+ * @sha2_transform_f Hashes a number of whole blocks into the context state
+ * @sha2_transform_many_f Hashes a number of whole blocks of each of degree
+ *                        messages into the transposed states of a
+ *                        SHA256_MB_CTX, starting at the given lane
+ * @sha2_will_work_f Function tests whether method will function
+ */
+typedef void		(*sha2_transform_f)(SHA2_CTX *, const void *, size_t);
+typedef void		(*sha2_transform_many_f)(uint32_t *, const uint8_t **,
+    size_t);
+typedef boolean_t	(*sha2_will_work_f)(void);
+
+#define	SHA2_IMPL_NAME_MAX (16)
+
+typedef struct sha2_impl_ops {
+	sha2_transform_f transform;
+	sha2_transform_many_f transform_many;
+	sha2_will_work_f is_supported;
+	size_t degree;		/* messages per transform_many call */
+	char name[SHA2_IMPL_NAME_MAX];
+} sha2_impl_ops_t;
+
+extern const sha2_impl_ops_t sha256_generic_impl;
+extern const sha2_impl_ops_t sha512_generic_impl;
+#if defined(__x86_64)
+extern const sha2_impl_ops_t sha256_x86_64_impl;
+extern const sha2_impl_ops_t sha512_x86_64_impl;
+#endif
+#if defined(__x86_64) && defined(HAVE_SHA)
+extern const sha2_impl_ops_t sha256_shani_impl;
+#endif
+
+extern const sha2_impl_ops_t sha256_mb_single_impl;
+#if defined(__x86_64) && defined(HAVE_SSSE3)
+extern const sha2_impl_ops_t sha256_mb_ssse3_impl;
+#endif
+#if defined(__x86_64) && defined(HAVE_AVX2)
+extern const sha2_impl_ops_t sha256_mb_avx2_impl;
+#endif
+#if defined(__x86_64) && defined(HAVE_AVX512BW)
+extern const sha2_impl_ops_t sha256_mb_avx512_impl;
+#endif
+
+/*
+ * Initializes fastest implementation
+ */
+void sha2_impl_init(void);
+void sha2_impl_fini(void);
+
+/*
+ * Get selected sha256 and sha512 implementations
+ */
+const sha2_impl_ops_t *sha256_impl_get_ops(void);
+const sha2_impl_ops_t *sha512_impl_get_ops(void);
+
+/*
+ * Get selected multi-buffer sha256 implementation
+ */
+const sha2_impl_ops_t *sha256_mb_impl_get_ops(void);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -219,6 +219,9 @@ sha2_mod_init(void)
 	if ((ret = mod_install(&modlinkage)) != 0)
 		return (ret);
 
+	/* Determine the fastest available implementation. */
+	sha2_impl_init();
+
 	/*
 	 * Register with KCF. If the registration fails, log an
 	 * error but do not uninstall the module, since the functionality
@@ -248,6 +251,8 @@ sha2_mod_fini(void)
 		sha2_prov_handle = 0;
 	}
 
+	sha2_impl_fini();
+
 	return (mod_remove(&modlinkage));
 }
 
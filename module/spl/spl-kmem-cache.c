@@ -867,6 +867,7 @@ spl_magazine_destroy(spl_kmem_cache_t *skc)
  *	KMC_VMEM        Force vmem backed cache
  *	KMC_SLAB        Force Linux slab backed cache
  *	KMC_OFFSLAB	Locate objects off the slab
+ *	KMC_TYPESAFE	Keep freed objects typed for lockless readers (slab)
  */
 spl_kmem_cache_t *
 spl_kmem_cache_create(char *name, size_t size, size_t align,
@@ -942,6 +943,15 @@ spl_kmem_cache_create(char *name, size_t size, size_t align,
 		skc->skc_obj_align = align;
 	}
 
+	/*
+	 * Only the Linux slab can defer reusing the memory of freed objects
+	 * for something else until an RCU grace period has passed.
+	 */
+	if (skc->skc_flags & KMC_TYPESAFE) {
+		ASSERT0(skc->skc_flags & (KMC_KMEM | KMC_VMEM));
+		skc->skc_flags |= KMC_SLAB;
+	}
+
 	/*
 	 * When no specific type of slab is requested (kmem, vmem, or
 	 * linuxslab) then select a cache type based on the object size
@@ -1002,6 +1012,14 @@ spl_kmem_cache_create(char *name, size_t size, size_t align,
 		slabflags |= SLAB_USERCOPY;
 #endif
 
+		if (skc->skc_flags & KMC_TYPESAFE) {
+#if defined(SLAB_TYPESAFE_BY_RCU)
+			slabflags |= SLAB_TYPESAFE_BY_RCU;
+#else
+			slabflags |= SLAB_DESTROY_BY_RCU;
+#endif
+		}
+
 #if defined(HAVE_KMEM_CACHE_CREATE_USERCOPY)
 	/*
 	 * Newer grsec patchset uses kmem_cache_create_usercopy()
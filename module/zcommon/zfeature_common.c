@@ -430,6 +430,41 @@ zpool_feature_init(void)
 	    "Support for separate allocation classes.",
 	    ZFEATURE_FLAG_READONLY_COMPAT, NULL);
 	}
+
+	{
+	static const spa_feature_t zstd_compress_deps[] = {
+		SPA_FEATURE_EXTENSIBLE_DATASET,
+		SPA_FEATURE_NONE
+	};
+	zfeature_register(SPA_FEATURE_ZSTD_COMPRESS,
+	    "org.zfsonlinux:zstd_compress", "zstd_compress",
+	    "zstd compression algorithm support.",
+	    ZFEATURE_FLAG_PER_DATASET, zstd_compress_deps);
+	}
+
+	{
+	static const spa_feature_t blake3_deps[] = {
+		SPA_FEATURE_EXTENSIBLE_DATASET,
+		SPA_FEATURE_NONE
+	};
+	zfeature_register(SPA_FEATURE_BLAKE3,
+	    "org.openzfs:blake3", "blake3",
+	    "BLAKE3 hash algorithm.",
+	    ZFEATURE_FLAG_PER_DATASET, blake3_deps);
+	}
+
+	{
+	static const spa_feature_t zil_chains_deps[] = {
+		SPA_FEATURE_EXTENSIBLE_DATASET,
+		SPA_FEATURE_PROJECT_QUOTA,
+		SPA_FEATURE_NONE
+	};
+	zfeature_register(SPA_FEATURE_ZIL_CHAINS,
+	    "org.zfsonlinux:zil_chains", "zil_chains",
+	    "Intent log written as several concurrent chains.",
+	    ZFEATURE_FLAG_READONLY_COMPAT | ZFEATURE_FLAG_PER_DATASET,
+	    zil_chains_deps);
+	}
 }
 
 #if defined(_KERNEL)
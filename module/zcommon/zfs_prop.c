@@ -82,6 +82,7 @@ zfs_prop_init(void)
 		{ "sha512",	ZIO_CHECKSUM_SHA512 },
 		{ "skein",	ZIO_CHECKSUM_SKEIN },
 		{ "edonr",	ZIO_CHECKSUM_EDONR },
+		{ "blake3",	ZIO_CHECKSUM_BLAKE3 },
 		{ NULL }
 	};
 
@@ -100,6 +101,9 @@ zfs_prop_init(void)
 				ZIO_CHECKSUM_SKEIN | ZIO_CHECKSUM_VERIFY },
 		{ "edonr,verify",
 				ZIO_CHECKSUM_EDONR | ZIO_CHECKSUM_VERIFY },
+		{ "blake3",	ZIO_CHECKSUM_BLAKE3 },
+		{ "blake3,verify",
+				ZIO_CHECKSUM_BLAKE3 | ZIO_CHECKSUM_VERIFY },
 		{ NULL }
 	};
 
@@ -119,6 +123,43 @@ zfs_prop_init(void)
 		{ "gzip-9",	ZIO_COMPRESS_GZIP_9 },
 		{ "zle",	ZIO_COMPRESS_ZLE },
 		{ "lz4",	ZIO_COMPRESS_LZ4 },
+		{ "zstd",	ZIO_COMPRESS_ZSTD_3 },	/* zstd default */
+		{ "zstd-1",	ZIO_COMPRESS_ZSTD_1 },
+		{ "zstd-2",	ZIO_COMPRESS_ZSTD_2 },
+		{ "zstd-3",	ZIO_COMPRESS_ZSTD_3 },
+		{ "zstd-4",	ZIO_COMPRESS_ZSTD_4 },
+		{ "zstd-5",	ZIO_COMPRESS_ZSTD_5 },
+		{ "zstd-6",	ZIO_COMPRESS_ZSTD_6 },
+		{ "zstd-7",	ZIO_COMPRESS_ZSTD_7 },
+		{ "zstd-8",	ZIO_COMPRESS_ZSTD_8 },
+		{ "zstd-9",	ZIO_COMPRESS_ZSTD_9 },
+		{ "zstd-10",	ZIO_COMPRESS_ZSTD_10 },
+		{ "zstd-11",	ZIO_COMPRESS_ZSTD_11 },
+		{ "zstd-12",	ZIO_COMPRESS_ZSTD_12 },
+		{ "zstd-13",	ZIO_COMPRESS_ZSTD_13 },
+		{ "zstd-14",	ZIO_COMPRESS_ZSTD_14 },
+		{ "zstd-15",	ZIO_COMPRESS_ZSTD_15 },
+		{ "zstd-16",	ZIO_COMPRESS_ZSTD_16 },
+		{ "zstd-17",	ZIO_COMPRESS_ZSTD_17 },
+		{ "zstd-18",	ZIO_COMPRESS_ZSTD_18 },
+		{ "zstd-19",	ZIO_COMPRESS_ZSTD_19 },
+		/* zstd-fast default */
+		{ "zstd-fast",	ZIO_COMPRESS_ZSTD_FAST_1 },
+		{ "zstd-fast-1",	ZIO_COMPRESS_ZSTD_FAST_1 },
+		{ "zstd-fast-2",	ZIO_COMPRESS_ZSTD_FAST_2 },
+		{ "zstd-fast-3",	ZIO_COMPRESS_ZSTD_FAST_3 },
+		{ "zstd-fast-4",	ZIO_COMPRESS_ZSTD_FAST_4 },
+		{ "zstd-fast-5",	ZIO_COMPRESS_ZSTD_FAST_5 },
+		{ "zstd-fast-6",	ZIO_COMPRESS_ZSTD_FAST_6 },
+		{ "zstd-fast-7",	ZIO_COMPRESS_ZSTD_FAST_7 },
+		{ "zstd-fast-8",	ZIO_COMPRESS_ZSTD_FAST_8 },
+		{ "zstd-fast-9",	ZIO_COMPRESS_ZSTD_FAST_9 },
+		{ "zstd-fast-10",	ZIO_COMPRESS_ZSTD_FAST_10 },
+		{ "zstd-fast-20",	ZIO_COMPRESS_ZSTD_FAST_20 },
+		{ "zstd-fast-50",	ZIO_COMPRESS_ZSTD_FAST_50 },
+		{ "zstd-fast-100",	ZIO_COMPRESS_ZSTD_FAST_100 },
+		{ "zstd-fast-500",	ZIO_COMPRESS_ZSTD_FAST_500 },
+		{ "zstd-fast-1000",	ZIO_COMPRESS_ZSTD_FAST_1000 },
 		{ NULL }
 	};
 
@@ -243,6 +284,13 @@ zfs_prop_init(void)
 		{ NULL }
 	};
 
+	static zprop_index_t scancache_table[] = {
+		{ "auto",	ZFS_SCANCACHE_AUTO },
+		{ "cold",	ZFS_SCANCACHE_COLD },
+		{ "normal",	ZFS_SCANCACHE_NORMAL },
+		{ NULL }
+	};
+
 	static zprop_index_t sync_table[] = {
 		{ "standard",	ZFS_SYNC_STANDARD },
 		{ "always",	ZFS_SYNC_ALWAYS },
@@ -250,6 +298,13 @@ zfs_prop_init(void)
 		{ NULL }
 	};
 
+	static zprop_index_t direct_table[] = {
+		{ "standard",	ZFS_DIRECT_STANDARD },
+		{ "always",	ZFS_DIRECT_ALWAYS },
+		{ "disabled",	ZFS_DIRECT_DISABLED },
+		{ NULL }
+	};
+
 	static zprop_index_t xattr_table[] = {
 		{ "off",	ZFS_XATTR_OFF },
 		{ "on",		ZFS_XATTR_DIR },
@@ -294,20 +349,26 @@ zfs_prop_init(void)
 	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
 	    "standard | always | disabled", "SYNC",
 	    sync_table);
+	zprop_register_index(ZFS_PROP_DIRECT, "direct", ZFS_DIRECT_STANDARD,
+	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM,
+	    "standard | always | disabled", "DIRECT",
+	    direct_table);
 	zprop_register_index(ZFS_PROP_CHECKSUM, "checksum",
 	    ZIO_CHECKSUM_DEFAULT, PROP_INHERIT, ZFS_TYPE_FILESYSTEM |
 	    ZFS_TYPE_VOLUME,
 	    "on | off | fletcher2 | fletcher4 | sha256 | sha512 | "
-	    "skein | edonr", "CHECKSUM", checksum_table);
+	    "skein | edonr | blake3", "CHECKSUM", checksum_table);
 	zprop_register_index(ZFS_PROP_DEDUP, "dedup", ZIO_CHECKSUM_OFF,
 	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
 	    "on | off | verify | sha256[,verify], sha512[,verify], "
-	    "skein[,verify], edonr,verify", "DEDUP", dedup_table);
+	    "skein[,verify], edonr,verify, blake3[,verify]", "DEDUP",
+	    dedup_table);
 	zprop_register_index(ZFS_PROP_COMPRESSION, "compression",
 	    ZIO_COMPRESS_DEFAULT, PROP_INHERIT,
 	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
-	    "on | off | lzjb | gzip | gzip-[1-9] | zle | lz4", "COMPRESS",
-	    compress_table);
+	    "on | off | lzjb | gzip | gzip-[1-9] | zle | lz4 | zstd | "
+	    "zstd-[1-19] | zstd-fast | zstd-fast-[1-10,20,50,100,500,1000]",
+	    "COMPRESS", compress_table);
 	zprop_register_index(ZFS_PROP_SNAPDIR, "snapdir", ZFS_SNAPDIR_HIDDEN,
 	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM,
 	    "hidden | visible", "SNAPDIR", snapdir_table);
@@ -332,6 +393,10 @@ zfs_prop_init(void)
 	    ZFS_CACHE_ALL, PROP_INHERIT,
 	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_SNAPSHOT | ZFS_TYPE_VOLUME,
 	    "all | none | metadata", "SECONDARYCACHE", cache_table);
+	zprop_register_index(ZFS_PROP_SCANCACHE, "scancache",
+	    ZFS_SCANCACHE_AUTO, PROP_INHERIT,
+	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_SNAPSHOT | ZFS_TYPE_VOLUME,
+	    "auto | cold | normal", "SCANCACHE", scancache_table);
 	zprop_register_index(ZFS_PROP_LOGBIAS, "logbias", ZFS_LOGBIAS_LATENCY,
 	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
 	    "latency | throughput", "LOGBIAS", logbias_table);
@@ -533,11 +598,26 @@ zfs_prop_init(void)
 	zprop_register_number(ZFS_PROP_SNAPSHOT_LIMIT, "snapshot_limit",
 	    UINT64_MAX, PROP_DEFAULT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
 	    "<count> | none", "SSLIMIT");
+	zprop_register_number(ZFS_PROP_ARC_QUOTA, "arc_quota", 0,
+	    PROP_DEFAULT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
+	    "<size> | none", "ARCQUOTA");
+	zprop_register_number(ZFS_PROP_ARC_RESERVE, "arc_reserve", 0,
+	    PROP_DEFAULT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
+	    "<size> | none", "ARCRESERV");
 
 	/* inherit number properties */
 	zprop_register_number(ZFS_PROP_RECORDSIZE, "recordsize",
 	    SPA_OLD_MAXBLOCKSIZE, PROP_INHERIT,
 	    ZFS_TYPE_FILESYSTEM, "512 to 1M, power of 2", "RECSIZE");
+	zprop_register_number(ZFS_PROP_READLIMIT, "readlimit", 0, PROP_INHERIT,
+	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
+	    "<bytes per second> | none", "RLIMIT");
+	zprop_register_number(ZFS_PROP_WRITELIMIT, "writelimit", 0,
+	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
+	    "<bytes per second> | none", "WLIMIT");
+	zprop_register_number(ZFS_PROP_IOPSLIMIT, "iopslimit", 0, PROP_INHERIT,
+	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
+	    "<operations per second> | none", "IOPSLIMIT");
 	zprop_register_number(ZFS_PROP_SPECIAL_SMALL_BLOCKS,
 	    "special_small_blocks", 0, PROP_INHERIT, ZFS_TYPE_FILESYSTEM,
 	    "zero or 512 to 128K, power of 2", "SPECIAL_SMALL_BLOCKS");
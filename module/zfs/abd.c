@@ -136,6 +136,7 @@ typedef struct abd_stats {
 	kstat_named_t abdstat_scatter_orders[MAX_ORDER];
 	kstat_named_t abdstat_scatter_page_multi_chunk;
 	kstat_named_t abdstat_scatter_page_multi_zone;
+	kstat_named_t abdstat_scatter_page_remote;
 	kstat_named_t abdstat_scatter_page_alloc_retry;
 	kstat_named_t abdstat_scatter_sg_table_retry;
 } abd_stats_t;
@@ -182,6 +183,11 @@ static abd_stats_t abd_stats = {
 	 * ABDs are preferentially allocated using pages from a single zone.
 	 */
 	{ "scatter_page_multi_zone",		KSTAT_DATA_UINT64 },
+	/*
+	 * The number of chunks which could not be allocated on the NUMA
+	 * node requested for their ABD and came from another node.
+	 */
+	{ "scatter_page_remote",		KSTAT_DATA_UINT64 },
 	/*
 	 *  The total number of retries encountered when attempting to
 	 *  allocate the pages to populate the scatter ABD.
@@ -243,9 +249,13 @@ abd_alloc_chunk(int nid, gfp_t gfp, unsigned int order)
  * progressively decreased until it can be satisfied without performing
  * reclaim or compaction.  When necessary this function will degenerate to
  * allocating individual pages and allowing reclaim to satisfy allocations.
+ *
+ * Compound pages are only taken from the requested NUMA node, so that a
+ * busy node yields smaller local chunks rather than larger remote ones.
+ * Single pages may fall back to other nodes rather than stall.
  */
 static void
-abd_alloc_pages(abd_t *abd, size_t size)
+abd_alloc_pages(abd_t *abd, size_t size, int nid)
 {
 	struct list_head pages;
 	struct sg_table table;
@@ -257,12 +267,17 @@ abd_alloc_pages(abd_t *abd, size_t size)
 	int nr_pages = abd_chunkcnt_for_bytes(size);
 	int chunks = 0, zones = 0;
 	size_t remaining_size;
-	int nid = NUMA_NO_NODE;
+	int last_nid = NUMA_NO_NODE;
 	int alloc_pages = 0;
 	int order;
 
 	INIT_LIST_HEAD(&pages);
 
+	if (nid < 0 || !node_online(nid))
+		nid = numa_mem_id();
+	if (num_online_nodes() > 1)
+		gfp_comp |= __GFP_THISNODE;
+
 	while (alloc_pages < nr_pages) {
 		unsigned long paddr;
 		unsigned chunk_pages;
@@ -284,10 +299,13 @@ abd_alloc_pages(abd_t *abd, size_t size)
 		page = virt_to_page(paddr);
 		list_add_tail(&page->lru, &pages);
 
-		if ((nid != NUMA_NO_NODE) && (page_to_nid(page) != nid))
+		if ((last_nid != NUMA_NO_NODE) &&
+		    (page_to_nid(page) != last_nid))
 			zones++;
+		if (page_to_nid(page) != nid)
+			ABDSTAT_BUMP(abdstat_scatter_page_remote);
 
-		nid = page_to_nid(page);
+		last_nid = page_to_nid(page);
 		ABDSTAT_BUMP(abdstat_scatter_orders[order]);
 		chunks++;
 		alloc_pages += chunk_pages;
@@ -331,8 +349,9 @@ abd_alloc_pages(abd_t *abd, size_t size)
  * makes no attempt to request contiguous pages and requires the minimal
  * number of kernel interfaces.  It's designed for maximum compatibility.
  */
+/* ARGSUSED */
 static void
-abd_alloc_pages(abd_t *abd, size_t size)
+abd_alloc_pages(abd_t *abd, size_t size, int nid)
 {
 	struct scatterlist *sg = NULL;
 	struct sg_table table;
@@ -455,8 +474,9 @@ sg_next(struct scatterlist *sg)
 	return (sg + 1);
 }
 
+/* ARGSUSED */
 static void
-abd_alloc_pages(abd_t *abd, size_t size)
+abd_alloc_pages(abd_t *abd, size_t size, int nid)
 {
 	unsigned nr_pages = abd_chunkcnt_for_bytes(size);
 	struct scatterlist *sg;
@@ -536,7 +556,9 @@ abd_verify(abd_t *abd)
 	ASSERT3U(abd->abd_size, <=, SPA_MAXBLOCKSIZE);
 	ASSERT3U(abd->abd_flags, ==, abd->abd_flags & (ABD_FLAG_LINEAR |
 	    ABD_FLAG_OWNER | ABD_FLAG_META | ABD_FLAG_MULTI_ZONE |
-	    ABD_FLAG_MULTI_CHUNK));
+	    ABD_FLAG_MULTI_CHUNK | ABD_FLAG_USER));
+	IMPLY(abd->abd_flags & ABD_FLAG_USER,
+	    !(abd->abd_flags & ABD_FLAG_OWNER));
 	IMPLY(abd->abd_parent != NULL, !(abd->abd_flags & ABD_FLAG_OWNER));
 	IMPLY(abd->abd_flags & ABD_FLAG_META, abd->abd_flags & ABD_FLAG_OWNER);
 	if (abd_is_linear(abd)) {
@@ -580,6 +602,16 @@ abd_free_struct(abd_t *abd)
  */
 abd_t *
 abd_alloc(size_t size, boolean_t is_metadata)
+{
+	return (abd_alloc_node(size, is_metadata, ABD_NODE_LOCAL));
+}
+
+/*
+ * As abd_alloc(), but place the data on the given NUMA node when the ABD
+ * is scattered. Linear ABDs come from the kmem caches and are not placed.
+ */
+abd_t *
+abd_alloc_node(size_t size, boolean_t is_metadata, int nid)
 {
 	if (!zfs_abd_scatter_enabled || size <= PAGESIZE)
 		return (abd_alloc_linear(size, is_metadata));
@@ -588,7 +620,7 @@ abd_alloc(size_t size, boolean_t is_metadata)
 
 	abd_t *abd = abd_alloc_struct();
 	abd->abd_flags = ABD_FLAG_OWNER;
-	abd_alloc_pages(abd, size);
+	abd_alloc_pages(abd, size, nid);
 
 	if (is_metadata) {
 		abd->abd_flags |= ABD_FLAG_META;
@@ -771,6 +803,8 @@ abd_get_offset_impl(abd_t *sabd, size_t off, size_t size)
 		ABD_SCATTER(abd).abd_nents = ABD_SCATTER(sabd).abd_nents - i;
 	}
 
+	/* A user's buffer is still theirs to change at any offset. */
+	abd->abd_flags |= (sabd->abd_flags & ABD_FLAG_USER);
 	abd->abd_size = size;
 	abd->abd_parent = sabd;
 	zfs_refcount_create(&abd->abd_children);
@@ -823,6 +857,22 @@ abd_get_from_buf(void *buf, size_t size)
 	return (abd);
 }
 
+/*
+ * Like abd_get_from_buf(), but for a buffer mapped from a user's pages,
+ * which the user may change while it is in use.  Data read into it is
+ * never used to repair other copies of a block, since it may no longer
+ * be the data which was verified.
+ */
+abd_t *
+abd_get_from_user_buf(void *buf, size_t size)
+{
+	abd_t *abd = abd_get_from_buf(buf, size);
+
+	abd->abd_flags |= ABD_FLAG_USER;
+
+	return (abd);
+}
+
 /*
  * Free an ABD allocated from abd_get_offset() or abd_get_from_buf(). Will not
  * free the underlying scatterlist or buffer.
@@ -1264,6 +1314,73 @@ abd_iterate_func2(abd_t *dabd, abd_t *sabd, size_t doff, size_t soff,
 	return (ret);
 }
 
+/*
+ * Iterate over the first sizes[i] bytes of each of the n ABDs abds[i] in
+ * lockstep, calling func with the same length of every one of them at a
+ * time.  Once an ABD is exhausted its buffer is passed as NULL.
+ *
+ * All chunks are mapped at once.  Mapping more than one with
+ * kmap_atomic() would need a KM_* slot each, so callers only batch ABDs
+ * on 64-bit kernels, where kmap_atomic() takes no slot and scatter pages
+ * are never in high memory.
+ */
+int
+abd_iterate_many_func(abd_t **abds, const size_t *sizes, int n,
+    abd_iter_many_func_t *func, void *private)
+{
+	struct abd_iter *aiters;
+	void **bufs;
+	size_t done = 0, len = 0;
+	int i, active, ret = 0;
+
+	aiters = kmem_alloc(n * sizeof (struct abd_iter), KM_SLEEP);
+	bufs = kmem_alloc(n * sizeof (void *), KM_SLEEP);
+
+	for (i = 0; i < n; i++) {
+		ASSERT3U(sizes[i], <=, abds[i]->abd_size);
+		abd_iter_init(&aiters[i], abds[i], 0);
+	}
+
+	for (;;) {
+		active = 0;
+		for (i = 0; i < n; i++) {
+			bufs[i] = NULL;
+			if (done >= sizes[i])
+				continue;
+			abd_iter_map(&aiters[i]);
+			bufs[i] = aiters[i].iter_mapaddr;
+			if (active++ == 0)
+				len = sizes[i] - done;
+			len = MIN(len, MIN(aiters[i].iter_mapsize,
+			    sizes[i] - done));
+		}
+		if (active == 0)
+			break;
+		ASSERT3U(len, >, 0);
+
+		ret = func(bufs, len, private);
+
+		for (i = n - 1; i >= 0; i--) {
+			if (bufs[i] != NULL)
+				abd_iter_unmap(&aiters[i]);
+		}
+
+		if (ret != 0)
+			break;
+
+		for (i = 0; i < n; i++) {
+			if (bufs[i] != NULL)
+				abd_iter_advance(&aiters[i], len);
+		}
+		done += len;
+	}
+
+	kmem_free(bufs, n * sizeof (void *));
+	kmem_free(aiters, n * sizeof (struct abd_iter));
+
+	return (ret);
+}
+
 /*ARGSUSED*/
 static int
 abd_copy_off_cb(void *dbuf, void *sbuf, size_t size, void *private)
@@ -90,6 +90,18 @@
  * locates the requested buffer in the hash table.  It returns
  * NULL for the mutex if the buffer was not in the table.
  *
+ * buf_hash_find_lockless() does the same for arc_read(), but walks
+ * the hash chain without the mutex.  Headers come from KMC_TYPESAFE
+ * caches, so a header which is removed and freed under a walking reader
+ * is still a header, and the hash chains are only ever linked to fully
+ * set up headers.  A header which is found is pinned (b_pins) before the
+ * walk ends, which keeps its memory from being freed and reused, so the
+ * reader may then block on the mutex of its bucket and confirm the
+ * header's identity without walking the chain again.  Cache misses
+ * therefore do not touch the hash table mutexes at all, and hits only
+ * take the mutex of their own bucket, which protects the arc_buf_t list
+ * and ARC state of the header they attach to.
+ *
  * buf_hash_remove() expects the appropriate hash mutex to be
  * already held before it is invoked.
  *
@@ -321,7 +333,8 @@ static kcondvar_t	arc_reclaim_waiters_cv;
  * dropping the sublist lock and evicting from another sublist. A lower
  * value means we're more likely to evict the "correct" header (i.e. the
  * oldest header in the arc state), but comes with higher overhead
- * (i.e. more invocations of arc_evict_state_impl()).
+ * (i.e. more invocations of arc_evict_state_impl()).  Headers passed over
+ * for their dataset or reservation count toward the limit as well.
  */
 int zfs_arc_evict_batch_limit = 10;
 
@@ -415,6 +428,19 @@ unsigned long zfs_arc_meta_limit_percent = 75;
  */
 unsigned long zfs_arc_dnode_limit_percent = 10;
 
+/*
+ * Upper bound, as a percentage of arc_c, on the sum of all per-dataset
+ * arc_reserve values that eviction will honor. Above it reservations are
+ * ignored so that the ARC can always shrink to its target.
+ */
+int zfs_arc_reserve_percent = 50;
+
+/*
+ * When set, eviction first reclaims from the NUMA node holding the most
+ * ARC data so that memory is released evenly across nodes.
+ */
+int zfs_arc_numa_balance = 1;
+
 /*
  * These tunables are Linux specific
  */
@@ -435,6 +461,9 @@ static arc_state_t ARC_mfu;
 static arc_state_t ARC_mfu_ghost;
 static arc_state_t ARC_l2c_only;
 
+/* NUMA nodes with their own ARC accounting, see arc_node_size[] */
+#define	ARC_MAX_NODES		16
+
 typedef struct arc_stats {
 	kstat_named_t arcstat_hits;
 	kstat_named_t arcstat_misses;
@@ -474,6 +503,11 @@ typedef struct arc_stats {
 	 * buffers to reach its target amount.
 	 */
 	kstat_named_t arcstat_evict_not_enough;
+	/*
+	 * Number of buffers skipped because their dataset is below its
+	 * arc_reserve.
+	 */
+	kstat_named_t arcstat_evict_reserve_skip;
 	kstat_named_t arcstat_evict_l2_cached;
 	kstat_named_t arcstat_evict_l2_eligible;
 	kstat_named_t arcstat_evict_l2_ineligible;
@@ -686,6 +720,37 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_l2_psize;
 	/* Not updated directly; only synced in arc_kstat_update. */
 	kstat_named_t arcstat_l2_hdr_size;
+	/*
+	 * Number of L2ARC log blocks written. These are used for restoring
+	 * the L2ARC. Updated during writing of L2ARC log blocks.
+	 */
+	kstat_named_t arcstat_l2_log_blk_writes;
+	/*
+	 * Aligned size of all L2ARC log blocks present on the L2ARC devices.
+	 * Updated during writing, eviction and rebuild of log blocks.
+	 */
+	kstat_named_t arcstat_l2_log_blk_asize;
+	/* Number of L2ARC log blocks present on the L2ARC devices. */
+	kstat_named_t arcstat_l2_log_blk_count;
+	/*
+	 * Number of L2ARC devices whose contents were successfully restored,
+	 * and the reasons for which a rebuild was aborted. Updated during
+	 * L2ARC rebuild.
+	 */
+	kstat_named_t arcstat_l2_rebuild_success;
+	kstat_named_t arcstat_l2_rebuild_abort_unsupported;
+	kstat_named_t arcstat_l2_rebuild_abort_io_errors;
+	kstat_named_t arcstat_l2_rebuild_abort_dh_errors;
+	kstat_named_t arcstat_l2_rebuild_abort_cksum_lb_errors;
+	kstat_named_t arcstat_l2_rebuild_abort_lowmem;
+	/* Logical and aligned size of the restored buffers. */
+	kstat_named_t arcstat_l2_rebuild_size;
+	kstat_named_t arcstat_l2_rebuild_asize;
+	/* Number of buffers restored, and number already present in ARC. */
+	kstat_named_t arcstat_l2_rebuild_bufs;
+	kstat_named_t arcstat_l2_rebuild_bufs_precached;
+	/* Number of log blocks read during rebuild. */
+	kstat_named_t arcstat_l2_rebuild_log_blks;
 	kstat_named_t arcstat_memory_throttle_count;
 	kstat_named_t arcstat_memory_direct_count;
 	kstat_named_t arcstat_memory_indirect_count;
@@ -705,9 +770,19 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_async_upgrade_sync;
 	kstat_named_t arcstat_demand_hit_predictive_prefetch;
 	kstat_named_t arcstat_demand_hit_prescient_prefetch;
+	/*
+	 * Number of blocks admitted on behalf of a sequential scan, and
+	 * therefore placed at the cold end of the MRU state.
+	 */
+	kstat_named_t arcstat_scan_bypassed;
 	kstat_named_t arcstat_need_free;
 	kstat_named_t arcstat_sys_free;
 	kstat_named_t arcstat_raw_size;
+	/*
+	 * ARC data held on each NUMA node, named in arc_init(). Only the
+	 * first arc_numa_nodes entries are exported.
+	 */
+	kstat_named_t arcstat_node_size[ARC_MAX_NODES];
 } arc_stats_t;
 
 static arc_stats_t arc_stats = {
@@ -730,6 +805,7 @@ static arc_stats_t arc_stats = {
 	{ "access_skip",		KSTAT_DATA_UINT64 },
 	{ "evict_skip",			KSTAT_DATA_UINT64 },
 	{ "evict_not_enough",		KSTAT_DATA_UINT64 },
+	{ "evict_reserve_skip",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_cached",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_eligible",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_ineligible",	KSTAT_DATA_UINT64 },
@@ -788,6 +864,20 @@ static arc_stats_t arc_stats = {
 	{ "l2_size",			KSTAT_DATA_UINT64 },
 	{ "l2_asize",			KSTAT_DATA_UINT64 },
 	{ "l2_hdr_size",		KSTAT_DATA_UINT64 },
+	{ "l2_log_blk_writes",		KSTAT_DATA_UINT64 },
+	{ "l2_log_blk_asize",		KSTAT_DATA_UINT64 },
+	{ "l2_log_blk_count",		KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_success",		KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_unsupported",	KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_io_errors",	KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_dh_errors",	KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_cksum_lb_errors",	KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_lowmem",		KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_size",		KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_asize",		KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_bufs",		KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_bufs_precached",	KSTAT_DATA_UINT64 },
+	{ "l2_rebuild_log_blks",	KSTAT_DATA_UINT64 },
 	{ "memory_throttle_count",	KSTAT_DATA_UINT64 },
 	{ "memory_direct_count",	KSTAT_DATA_UINT64 },
 	{ "memory_indirect_count",	KSTAT_DATA_UINT64 },
@@ -806,6 +896,7 @@ static arc_stats_t arc_stats = {
 	{ "async_upgrade_sync",		KSTAT_DATA_UINT64 },
 	{ "demand_hit_predictive_prefetch", KSTAT_DATA_UINT64 },
 	{ "demand_hit_prescient_prefetch", KSTAT_DATA_UINT64 },
+	{ "scan_bypassed",		KSTAT_DATA_UINT64 },
 	{ "arc_need_free",		KSTAT_DATA_UINT64 },
 	{ "arc_sys_free",		KSTAT_DATA_UINT64 },
 	{ "arc_raw_size",		KSTAT_DATA_UINT64 }
@@ -910,6 +1001,68 @@ static list_t arc_prune_list;
 static kmutex_t arc_prune_mtx;
 static taskq_t *arc_prune_taskq;
 
+/*
+ * Per-objset ARC accounting, see arc_tenant_hold(). arc_tenant_reserved
+ * is the sum of at_reserve over all tenants in the tree.
+ */
+static avl_tree_t arc_tenant_tree;
+static krwlock_t arc_tenant_lock;
+static uint64_t arc_tenant_reserved;
+
+/*
+ * NUMA placement of ARC data. Each header remembers the node its data was
+ * allocated on in b_node, and arc_node_size[] tracks the ARC bytes held on
+ * each node. Nodes beyond ARC_MAX_NODES share accounting slots.
+ */
+#define	ARC_HDR_NODE(hdr)	((hdr)->b_l1hdr.b_node % arc_numa_nodes)
+
+static int arc_numa_nodes = 1;
+static aggsum_t arc_node_size[ARC_MAX_NODES];
+
+static inline int
+arc_numa_node_id(void)
+{
+#if defined(_KERNEL)
+	return (numa_node_id());
+#else
+	return (0);
+#endif
+}
+
+/*
+ * Return the node currently holding the most ARC data.
+ */
+static int
+arc_numa_evict_node(void)
+{
+	int64_t max = 0;
+	int node = 0;
+
+	for (int i = 0; i < arc_numa_nodes; i++) {
+		int64_t size = aggsum_value(&arc_node_size[i]);
+		if (size > max) {
+			max = size;
+			node = i;
+		}
+	}
+
+	return (node);
+}
+
+/*
+ * Return the range of sublists of a state's multilist which belong to
+ * the given node, see arc_state_multilist_index_func().
+ */
+static inline void
+arc_numa_sublists(multilist_t *ml, int node, unsigned int *first,
+    unsigned int *count)
+{
+	unsigned int num = multilist_get_num_sublists(ml);
+
+	*first = node * num / arc_numa_nodes;
+	*count = (node + 1) * num / arc_numa_nodes - *first;
+}
+
 #define	GHOST_STATE(state)	\
 	((state) == arc_mru_ghost || (state) == arc_mfu_ghost ||	\
 	(state) == arc_l2c_only)
@@ -924,6 +1077,7 @@ static taskq_t *arc_prune_taskq;
 	((hdr)->b_flags & ARC_FLAG_COMPRESSED_ARC)
 
 #define	HDR_L2CACHE(hdr)	((hdr)->b_flags & ARC_FLAG_L2CACHE)
+#define	HDR_SCAN(hdr)		((hdr)->b_flags & ARC_FLAG_SCAN)
 #define	HDR_L2_READING(hdr)	\
 	(((hdr)->b_flags & ARC_FLAG_IO_IN_PROGRESS) &&	\
 	((hdr)->b_flags & ARC_FLAG_HAS_L2HDR))
@@ -1036,6 +1190,16 @@ int l2arc_noprefetch = B_TRUE;			/* don't cache prefetch bufs */
 int l2arc_feed_again = B_TRUE;			/* turbo warmup */
 int l2arc_norw = B_FALSE;			/* no reads during writes */
 
+/*
+ * Persistent L2ARC tunables. A rebuild of the L2ARC contents is attempted
+ * whenever a cache device is added to a pool (at import or when it is
+ * added at runtime), unless l2arc_rebuild_enabled is zero. Devices
+ * smaller than l2arc_rebuild_blocks_min_l2size do not have their contents
+ * logged at all, since the log block overhead would be disproportionate.
+ */
+int l2arc_rebuild_enabled = B_TRUE;
+unsigned long l2arc_rebuild_blocks_min_l2size = 1024 * 1024 * 1024;
+
 /*
  * L2ARC Internals
  */
@@ -1076,6 +1240,9 @@ static kmutex_t l2arc_feed_thr_lock;
 static kcondvar_t l2arc_feed_thr_cv;
 static uint8_t l2arc_thread_exit;
 
+static kmutex_t l2arc_rebuild_thr_lock;
+static kcondvar_t l2arc_rebuild_thr_cv;
+
 static abd_t *arc_get_data_abd(arc_buf_hdr_t *, uint64_t, void *);
 static void *arc_get_data_buf(arc_buf_hdr_t *, uint64_t, void *);
 static void arc_get_data_impl(arc_buf_hdr_t *, uint64_t, void *);
@@ -1084,6 +1251,7 @@ static void arc_free_data_buf(arc_buf_hdr_t *, void *, uint64_t, void *);
 static void arc_free_data_impl(arc_buf_hdr_t *hdr, uint64_t size, void *tag);
 static void arc_hdr_free_abd(arc_buf_hdr_t *, boolean_t);
 static void arc_hdr_alloc_abd(arc_buf_hdr_t *, boolean_t);
+static void arc_hdr_unpin(arc_buf_hdr_t *);
 static void arc_access(arc_buf_hdr_t *, kmutex_t *);
 static boolean_t arc_is_overflowing(void);
 static void arc_buf_watch(arc_buf_t *);
@@ -1099,6 +1267,30 @@ static inline void arc_hdr_clear_flags(arc_buf_hdr_t *hdr, arc_flags_t flags);
 static boolean_t l2arc_write_eligible(uint64_t, arc_buf_hdr_t *);
 static void l2arc_read_done(zio_t *);
 
+/*
+ * Persistent L2ARC routines.
+ */
+static void l2arc_rebuild_vdev(l2arc_dev_t *);
+static void l2arc_rebuild_thread(void *);
+static int l2arc_rebuild(l2arc_dev_t *);
+static int l2arc_dev_hdr_read(l2arc_dev_t *);
+static void l2arc_dev_hdr_update(l2arc_dev_t *);
+static int l2arc_log_blk_read(l2arc_dev_t *, const l2arc_log_blkptr_t *,
+    const l2arc_log_blkptr_t *, l2arc_log_blk_phys_t *,
+    l2arc_log_blk_phys_t *, zio_t *, zio_t **);
+static zio_t *l2arc_log_blk_fetch(vdev_t *, const l2arc_log_blkptr_t *,
+    l2arc_log_blk_phys_t *);
+static void l2arc_log_blk_fetch_abort(zio_t *);
+static void l2arc_log_blk_fetch_done(zio_t *);
+static void l2arc_log_blk_restore(l2arc_dev_t *,
+    const l2arc_log_blk_phys_t *);
+static void l2arc_hdr_restore(const l2arc_log_ent_phys_t *, l2arc_dev_t *);
+static boolean_t l2arc_log_blkptr_valid(l2arc_dev_t *,
+    const l2arc_log_blkptr_t *);
+static boolean_t l2arc_log_blk_insert(l2arc_dev_t *, const arc_buf_hdr_t *);
+static void l2arc_log_blk_commit(l2arc_dev_t *, zio_t *);
+static uint64_t l2arc_log_blk_overhead(uint64_t, l2arc_dev_t *);
+
 
 /*
  * We use Cityhash for this. It's fast, and has good hash properties without
@@ -1127,6 +1319,8 @@ buf_discard_identity(arc_buf_hdr_t *hdr)
 	hdr->b_birth = 0;
 }
 
+#define	BUF_HASH_NEXT(hdrp)	(*(arc_buf_hdr_t *volatile *)(hdrp))
+
 static arc_buf_hdr_t *
 buf_hash_find(uint64_t spa, const blkptr_t *bp, kmutex_t **lockp)
 {
@@ -1149,6 +1343,83 @@ buf_hash_find(uint64_t spa, const blkptr_t *bp, kmutex_t **lockp)
 	return (NULL);
 }
 
+/*
+ * Every header which may be linked into the hash table is allocated with
+ * one pin, which is dropped by arc_hdr_unpin() in place of freeing it.
+ * Lockless readers pin the headers they find, but only while the header
+ * is still allocated; once the last pin is gone it is being freed and
+ * must not be revived, so this fails instead.
+ */
+static boolean_t
+arc_hdr_trypin(arc_buf_hdr_t *hdr)
+{
+	uint32_t pins;
+
+	do {
+		pins = hdr->b_pins;
+		if (pins == 0)
+			return (B_FALSE);
+	} while (atomic_cas_32(&hdr->b_pins, pins, pins + 1) != pins);
+
+	return (B_TRUE);
+}
+
+/*
+ * Like buf_hash_find(), but without holding the hash lock while looking
+ * for the header.  A header which is concurrently inserted may be missed,
+ * so callers must be prepared to find it in the hash table when they
+ * later try to insert one of their own.
+ */
+static arc_buf_hdr_t *
+buf_hash_find_lockless(uint64_t spa, const blkptr_t *bp, kmutex_t **lockp)
+{
+	const dva_t *dva = BP_IDENTITY(bp);
+	uint64_t birth = BP_PHYSICAL_BIRTH(bp);
+	uint64_t idx = BUF_HASH_INDEX(spa, dva, birth);
+	kmutex_t *hash_lock = BUF_HASH_LOCK(idx);
+	arc_buf_hdr_t *hdr;
+
+top:
+	kmem_cache_typesafe_enter();
+	for (hdr = BUF_HASH_NEXT(&buf_hash_table.ht_table[idx]); hdr != NULL;
+	    hdr = BUF_HASH_NEXT(&hdr->b_hash_next)) {
+		if (HDR_EQUAL(spa, dva, birth, hdr))
+			break;
+	}
+
+	if (hdr == NULL) {
+		kmem_cache_typesafe_exit();
+		*lockp = NULL;
+		return (NULL);
+	}
+
+	/*
+	 * The header may be freed and reused as soon as the typesafe section
+	 * ends, so pin it first.  A header which can no longer be pinned has
+	 * already been unlinked, and a new walk will not find it again.
+	 */
+	if (!arc_hdr_trypin(hdr)) {
+		kmem_cache_typesafe_exit();
+		goto top;
+	}
+	kmem_cache_typesafe_exit();
+
+	/*
+	 * The pinned header may still have been removed from the hash table,
+	 * or have been reused since it was found, so check it again with the
+	 * hash lock held.  While it is in the table, our pin is not the last.
+	 */
+	mutex_enter(hash_lock);
+	if (HDR_IN_HASH_TABLE(hdr) && HDR_EQUAL(spa, dva, birth, hdr)) {
+		arc_hdr_unpin(hdr);
+		*lockp = hash_lock;
+		return (hdr);
+	}
+	mutex_exit(hash_lock);
+	arc_hdr_unpin(hdr);
+	goto top;
+}
+
 /*
  * Insert an entry into the hash table.  If there is already an element
  * equal to elem in the hash table, then the already existing element
@@ -1181,8 +1452,13 @@ buf_hash_insert(arc_buf_hdr_t *hdr, kmutex_t **lockp)
 			return (fhdr);
 	}
 
+	/*
+	 * Lockless readers may follow the chain into this header as soon as
+	 * it is linked, so its identity must be visible to them first.
+	 */
 	hdr->b_hash_next = buf_hash_table.ht_table[idx];
-	buf_hash_table.ht_table[idx] = hdr;
+	membar_producer();
+	BUF_HASH_NEXT(&buf_hash_table.ht_table[idx]) = hdr;
 	arc_hdr_set_flags(hdr, ARC_FLAG_IN_HASH_TABLE);
 
 	/* collect some hash table performance data */
@@ -1214,7 +1490,7 @@ buf_hash_remove(arc_buf_hdr_t *hdr)
 		ASSERT3P(fhdr, !=, NULL);
 		hdrp = &fhdr->b_hash_next;
 	}
-	*hdrp = hdr->b_hash_next;
+	BUF_HASH_NEXT(hdrp) = hdr->b_hash_next;
 	hdr->b_hash_next = NULL;
 	arc_hdr_clear_flags(hdr, ARC_FLAG_IN_HASH_TABLE);
 
@@ -1235,6 +1511,28 @@ static kmem_cache_t *hdr_full_crypt_cache;
 static kmem_cache_t *hdr_l2only_cache;
 static kmem_cache_t *buf_cache;
 
+static kmem_cache_t *
+arc_hdr_cache(arc_buf_hdr_t *hdr)
+{
+	if (!HDR_HAS_L1HDR(hdr))
+		return (hdr_l2only_cache);
+	else if (HDR_PROTECTED(hdr))
+		return (hdr_full_crypt_cache);
+	else
+		return (hdr_full_cache);
+}
+
+/*
+ * Drop a pin taken by arc_hdr_trypin(), or the one a header is allocated
+ * with, and free the header if it was the last one.
+ */
+static void
+arc_hdr_unpin(arc_buf_hdr_t *hdr)
+{
+	if (atomic_dec_32_nv(&hdr->b_pins) == 0)
+		kmem_cache_free(arc_hdr_cache(hdr), hdr);
+}
+
 static void
 buf_fini(void)
 {
@@ -1418,14 +1716,16 @@ retry:
 		goto retry;
 	}
 
+	/* headers stay typed for buf_hash_find_lockless() */
 	hdr_full_cache = kmem_cache_create("arc_buf_hdr_t_full", HDR_FULL_SIZE,
-	    0, hdr_full_cons, hdr_full_dest, hdr_recl, NULL, NULL, 0);
+	    0, hdr_full_cons, hdr_full_dest, hdr_recl, NULL, NULL,
+	    KMC_TYPESAFE);
 	hdr_full_crypt_cache = kmem_cache_create("arc_buf_hdr_t_full_crypt",
 	    HDR_FULL_CRYPT_SIZE, 0, hdr_full_crypt_cons, hdr_full_crypt_dest,
-	    hdr_recl, NULL, NULL, 0);
+	    hdr_recl, NULL, NULL, KMC_TYPESAFE);
 	hdr_l2only_cache = kmem_cache_create("arc_buf_hdr_t_l2only",
 	    HDR_L2ONLY_SIZE, 0, hdr_l2only_cons, hdr_l2only_dest, hdr_recl,
-	    NULL, NULL, 0);
+	    NULL, NULL, KMC_TYPESAFE);
 	buf_cache = kmem_cache_create("arc_buf_t", sizeof (arc_buf_t),
 	    0, buf_cons, buf_dest, NULL, NULL, NULL, 0);
 
@@ -2411,11 +2711,32 @@ add_reference(arc_buf_hdr_t *hdr, void *tag)
 			    hdr);
 			arc_evictable_space_decrement(hdr, state);
 		}
-		/* remove the prefetch flag if we get a reference */
-		arc_hdr_clear_flags(hdr, ARC_FLAG_PREFETCH);
+		/*
+		 * Remove the prefetch flag if we get a reference.  A block
+		 * prefetched for a scan keeps it, so that arc_access() counts
+		 * this reference as its first use rather than as a reuse.
+		 */
+		if (!HDR_SCAN(hdr))
+			arc_hdr_clear_flags(hdr, ARC_FLAG_PREFETCH);
 	}
 }
 
+/*
+ * Add the hdr to its state's list.  Headers admitted by a sequential scan
+ * go to the tail (the cold end) so that they are the first to be evicted;
+ * everything else goes to the head.
+ */
+static void
+arc_state_list_insert(arc_state_t *state, arc_buf_hdr_t *hdr)
+{
+	multilist_t *ml = state->arcs_list[arc_buf_type(hdr)];
+
+	if (HDR_SCAN(hdr))
+		multilist_insert_tail(ml, hdr);
+	else
+		multilist_insert(ml, hdr);
+}
+
 /*
  * Remove a reference from this hdr. When the reference transitions from
  * 1 to 0 and we're not anonymous, then we add this hdr to the arc_state_t's
@@ -2437,7 +2758,7 @@ remove_reference(arc_buf_hdr_t *hdr, kmutex_t *hash_lock, void *tag)
 	 */
 	if (((cnt = zfs_refcount_remove(&hdr->b_l1hdr.b_refcnt, tag)) == 0) &&
 	    (state != arc_anon)) {
-		multilist_insert(state->arcs_list[arc_buf_type(hdr)], hdr);
+		arc_state_list_insert(state, hdr);
 		ASSERT3U(hdr->b_l1hdr.b_bufcnt, >, 0);
 		arc_evictable_space_increment(hdr, state);
 	}
@@ -2549,6 +2870,16 @@ arc_change_state(arc_state_t *new_state, arc_buf_hdr_t *hdr,
 			}
 			arc_evictable_space_decrement(hdr, old_state);
 		}
+
+		/*
+		 * A header leaving a ghost state holds no data yet and is
+		 * on no list, so it can be re-homed to the node of the
+		 * thread that is about to fill it without upsetting
+		 * arc_state_multilist_index_func().
+		 */
+		if (GHOST_STATE(old_state) && HDR_HAS_L1HDR(hdr) &&
+		    hdr->b_l1hdr.b_pabd == NULL && !HDR_HAS_RABD(hdr))
+			hdr->b_l1hdr.b_node = arc_numa_node_id();
 		if (new_state != arc_anon && new_state != arc_l2c_only) {
 			/*
 			 * An L1 header always exists here, since if we're
@@ -2557,7 +2888,7 @@ arc_change_state(arc_state_t *new_state, arc_buf_hdr_t *hdr,
 			 * beforehand.
 			 */
 			ASSERT(HDR_HAS_L1HDR(hdr));
-			multilist_insert(new_state->arcs_list[buftype], hdr);
+			arc_state_list_insert(new_state, hdr);
 
 			if (GHOST_STATE(new_state)) {
 				ASSERT0(bufcnt);
@@ -3033,6 +3364,200 @@ l2arc_free_abd_on_write(abd_t *abd, size_t size, arc_buf_contents_t type)
 	mutex_exit(&l2arc_free_on_write_mtx);
 }
 
+static int
+arc_tenant_compare(const void *x1, const void *x2)
+{
+	const arc_tenant_t *at1 = (const arc_tenant_t *)x1;
+	const arc_tenant_t *at2 = (const arc_tenant_t *)x2;
+
+	int cmp = AVL_CMP(at1->at_spa, at2->at_spa);
+	if (likely(cmp))
+		return (cmp);
+
+	return (AVL_CMP(at1->at_objset, at2->at_objset));
+}
+
+/*
+ * Take an additional hold on a tenant found in arc_tenant_tree. Once the
+ * last hold has been dropped the tenant is being torn down by
+ * arc_tenant_rele() and must not be revived, so this fails instead.
+ */
+static boolean_t
+arc_tenant_tryhold(arc_tenant_t *at)
+{
+	uint64_t refcnt;
+
+	ASSERT(RW_LOCK_HELD(&arc_tenant_lock));
+
+	do {
+		refcnt = at->at_refcnt;
+		if (refcnt == 0)
+			return (B_FALSE);
+	} while (atomic_cas_64(&at->at_refcnt, refcnt, refcnt + 1) != refcnt);
+
+	return (B_TRUE);
+}
+
+static arc_tenant_t *
+arc_tenant_hold_impl(uint64_t spa, uint64_t objset)
+{
+	arc_tenant_t search, *at, *nat;
+	avl_index_t where;
+
+	search.at_spa = spa;
+	search.at_objset = objset;
+
+	rw_enter(&arc_tenant_lock, RW_READER);
+	at = avl_find(&arc_tenant_tree, &search, NULL);
+	if (at != NULL && arc_tenant_tryhold(at)) {
+		rw_exit(&arc_tenant_lock);
+		return (at);
+	}
+	rw_exit(&arc_tenant_lock);
+
+	nat = kmem_zalloc(sizeof (arc_tenant_t), KM_PUSHPAGE);
+	nat->at_spa = spa;
+	nat->at_objset = objset;
+	nat->at_refcnt = 1;
+	aggsum_init(&nat->at_size, 0);
+
+	rw_enter(&arc_tenant_lock, RW_WRITER);
+	at = avl_find(&arc_tenant_tree, &search, &where);
+	if (at != NULL) {
+		if (arc_tenant_tryhold(at)) {
+			rw_exit(&arc_tenant_lock);
+			aggsum_fini(&nat->at_size);
+			kmem_free(nat, sizeof (arc_tenant_t));
+			return (at);
+		}
+
+		/*
+		 * We raced with the final arc_tenant_rele() of the old
+		 * tenant. Take it out of the tree on its behalf so the
+		 * new one can be inserted in its place.
+		 */
+		avl_remove(&arc_tenant_tree, at);
+		at->at_unlinked = B_TRUE;
+		VERIFY3P(avl_find(&arc_tenant_tree, &search, &where), ==, NULL);
+	}
+	avl_insert(&arc_tenant_tree, nat, where);
+	rw_exit(&arc_tenant_lock);
+
+	return (nat);
+}
+
+/*
+ * Return a held reference to the ARC accounting for the given objset,
+ * creating it if necessary. Headers read or written on behalf of the
+ * objset hold their own references, so the tenant (and the bytes charged
+ * to it) outlives the objset_t for as long as any of its data is cached.
+ */
+arc_tenant_t *
+arc_tenant_hold(spa_t *spa, uint64_t objset)
+{
+	return (arc_tenant_hold_impl(spa_load_guid(spa), objset));
+}
+
+void
+arc_tenant_rele(arc_tenant_t *at)
+{
+	if (atomic_dec_64_nv(&at->at_refcnt) != 0)
+		return;
+
+	rw_enter(&arc_tenant_lock, RW_WRITER);
+	if (!at->at_unlinked)
+		avl_remove(&arc_tenant_tree, at);
+	rw_exit(&arc_tenant_lock);
+
+	atomic_add_64(&arc_tenant_reserved, -at->at_reserve);
+	ASSERT0(aggsum_value(&at->at_size));
+	aggsum_fini(&at->at_size);
+	kmem_free(at, sizeof (arc_tenant_t));
+}
+
+void
+arc_tenant_set_quota(arc_tenant_t *at, uint64_t quota)
+{
+	at->at_quota = quota;
+
+	/* let arc_adjust_tenants() trim the tenant to its new quota */
+	if (quota != 0) {
+		mutex_enter(&arc_reclaim_lock);
+		cv_signal(&arc_reclaim_thread_cv);
+		mutex_exit(&arc_reclaim_lock);
+	}
+}
+
+void
+arc_tenant_set_reserve(arc_tenant_t *at, uint64_t reserve)
+{
+	uint64_t old = atomic_swap_64(&at->at_reserve, reserve);
+
+	atomic_add_64(&arc_tenant_reserved, reserve - old);
+}
+
+uint64_t
+arc_tenant_size(arc_tenant_t *at)
+{
+	return (aggsum_value(&at->at_size));
+}
+
+static inline void
+arc_tenant_charge(arc_buf_hdr_t *hdr, int64_t size)
+{
+	arc_tenant_t *at = hdr->b_l1hdr.b_tenant;
+
+	if (at != NULL)
+		aggsum_add(&at->at_size, size);
+}
+
+/*
+ * Attribute the header to the tenant of the given objset, charging it for
+ * whatever data the header already holds. From here on every allocation
+ * and free of the header's data is charged through arc_get_data_impl()
+ * and arc_free_data_impl().
+ */
+static void
+arc_hdr_set_tenant(arc_buf_hdr_t *hdr, uint64_t objset)
+{
+	arc_tenant_t *at;
+	int64_t size = 0;
+
+	ASSERT(HDR_HAS_L1HDR(hdr));
+	ASSERT3P(hdr->b_l1hdr.b_tenant, ==, NULL);
+
+	at = arc_tenant_hold_impl(hdr->b_spa, objset);
+
+	if (hdr->b_l1hdr.b_pabd != NULL)
+		size += arc_hdr_size(hdr);
+	if (HDR_HAS_RABD(hdr))
+		size += HDR_GET_PSIZE(hdr);
+	for (arc_buf_t *buf = hdr->b_l1hdr.b_buf; buf != NULL;
+	    buf = buf->b_next) {
+		if (buf->b_data != NULL && !arc_buf_is_shared(buf))
+			size += arc_buf_size(buf);
+	}
+
+	hdr->b_l1hdr.b_tenant = at;
+	aggsum_add(&at->at_size, size);
+}
+
+static void
+arc_hdr_clear_tenant(arc_buf_hdr_t *hdr)
+{
+	arc_tenant_t *at = hdr->b_l1hdr.b_tenant;
+
+	ASSERT(HDR_HAS_L1HDR(hdr));
+
+	if (at != NULL) {
+		ASSERT3P(hdr->b_l1hdr.b_pabd, ==, NULL);
+		ASSERT(!HDR_HAS_RABD(hdr));
+		ASSERT3P(hdr->b_l1hdr.b_buf, ==, NULL);
+		hdr->b_l1hdr.b_tenant = NULL;
+		arc_tenant_rele(at);
+	}
+}
+
 static void
 arc_hdr_free_on_write(arc_buf_hdr_t *hdr, boolean_t free_rdata)
 {
@@ -3049,6 +3574,8 @@ arc_hdr_free_on_write(arc_buf_hdr_t *hdr, boolean_t free_rdata)
 		    size, hdr);
 	}
 	(void) zfs_refcount_remove_many(&state->arcs_size, size, hdr);
+	arc_tenant_charge(hdr, -size);
+	aggsum_add(&arc_node_size[ARC_HDR_NODE(hdr)], -size);
 	if (type == ARC_BUFC_METADATA) {
 		arc_space_return(size, ARC_SPACE_META);
 	} else {
@@ -3360,6 +3887,9 @@ arc_hdr_alloc(uint64_t spa, int32_t psize, int32_t lsize,
 
 	ASSERT(HDR_EMPTY(hdr));
 	ASSERT3P(hdr->b_l1hdr.b_freeze_cksum, ==, NULL);
+	ASSERT3P(hdr->b_l1hdr.b_tenant, ==, NULL);
+	ASSERT0(hdr->b_pins);
+	hdr->b_pins = 1;
 	HDR_SET_PSIZE(hdr, psize);
 	HDR_SET_LSIZE(hdr, lsize);
 	hdr->b_spa = spa;
@@ -3373,6 +3903,7 @@ arc_hdr_alloc(uint64_t spa, int32_t psize, int32_t lsize,
 	hdr->b_l1hdr.b_state = arc_anon;
 	hdr->b_l1hdr.b_arc_access = 0;
 	hdr->b_l1hdr.b_bufcnt = 0;
+	hdr->b_l1hdr.b_node = arc_numa_node_id();
 	hdr->b_l1hdr.b_buf = NULL;
 
 	/*
@@ -3419,7 +3950,24 @@ arc_hdr_realloc(arc_buf_hdr_t *hdr, kmem_cache_t *old, kmem_cache_t *new)
 	ASSERT(MUTEX_HELD(HDR_LOCK(hdr)));
 	buf_hash_remove(hdr);
 
-	bcopy(hdr, nhdr, HDR_L2ONLY_SIZE);
+	/*
+	 * Lockless readers may still hold pointers to nhdr from its previous
+	 * use, and can pin it as soon as b_pins is nonzero.  The old header's
+	 * pins must not be copied over with its identity, so copy the rest of
+	 * the L2-only part member by member and let b_pins go from 0 to 1 in
+	 * a single store.
+	 */
+	ASSERT0(nhdr->b_pins);
+	nhdr->b_dva = hdr->b_dva;
+	nhdr->b_birth = hdr->b_birth;
+	nhdr->b_type = hdr->b_type;
+	nhdr->b_hash_next = hdr->b_hash_next;
+	nhdr->b_flags = hdr->b_flags;
+	nhdr->b_psize = hdr->b_psize;
+	nhdr->b_lsize = hdr->b_lsize;
+	nhdr->b_spa = hdr->b_spa;
+	nhdr->b_l2hdr = hdr->b_l2hdr;
+	nhdr->b_pins = 1;
 
 	if (new == hdr_full_cache || new == hdr_full_crypt_cache) {
 		arc_hdr_set_flags(nhdr, ARC_FLAG_HAS_L1HDR);
@@ -3429,9 +3977,11 @@ arc_hdr_realloc(arc_buf_hdr_t *hdr, kmem_cache_t *old, kmem_cache_t *new)
 		 * l2c_only even though it's about to change.
 		 */
 		nhdr->b_l1hdr.b_state = arc_l2c_only;
+		nhdr->b_l1hdr.b_node = arc_numa_node_id();
 
 		/* Verify previous threads set to NULL before freeing */
 		ASSERT3P(nhdr->b_l1hdr.b_pabd, ==, NULL);
+		ASSERT3P(nhdr->b_l1hdr.b_tenant, ==, NULL);
 		ASSERT(!HDR_HAS_RABD(hdr));
 	} else {
 		ASSERT3P(hdr->b_l1hdr.b_buf, ==, NULL);
@@ -3457,6 +4007,9 @@ arc_hdr_realloc(arc_buf_hdr_t *hdr, kmem_cache_t *old, kmem_cache_t *new)
 		VERIFY3P(hdr->b_l1hdr.b_pabd, ==, NULL);
 		ASSERT(!HDR_HAS_RABD(hdr));
 
+		/* an l2c_only header holds no ARC data to charge */
+		arc_hdr_clear_tenant(hdr);
+
 		arc_hdr_clear_flags(nhdr, ARC_FLAG_HAS_L1HDR);
 	}
 	/*
@@ -3494,7 +4047,8 @@ arc_hdr_realloc(arc_buf_hdr_t *hdr, kmem_cache_t *old, kmem_cache_t *new)
 	    arc_hdr_size(nhdr), nhdr);
 
 	buf_discard_identity(hdr);
-	kmem_cache_free(old, hdr);
+	ASSERT3P(old, ==, arc_hdr_cache(hdr));
+	arc_hdr_unpin(hdr);
 
 	return (nhdr);
 }
@@ -3544,6 +4098,8 @@ arc_hdr_realloc_crypt(arc_buf_hdr_t *hdr, boolean_t need_crypt)
 	 * No lists are pointing to us (as we asserted above), so we don't
 	 * need to worry about the list nodes.
 	 */
+	ASSERT0(nhdr->b_pins);
+	nhdr->b_pins = 1;
 	nhdr->b_dva = hdr->b_dva;
 	nhdr->b_birth = hdr->b_birth;
 	nhdr->b_type = hdr->b_type;
@@ -3554,6 +4110,7 @@ arc_hdr_realloc_crypt(arc_buf_hdr_t *hdr, boolean_t need_crypt)
 	nhdr->b_l1hdr.b_freeze_cksum = hdr->b_l1hdr.b_freeze_cksum;
 	nhdr->b_l1hdr.b_bufcnt = hdr->b_l1hdr.b_bufcnt;
 	nhdr->b_l1hdr.b_byteswap = hdr->b_l1hdr.b_byteswap;
+	nhdr->b_l1hdr.b_node = hdr->b_l1hdr.b_node;
 	nhdr->b_l1hdr.b_state = hdr->b_l1hdr.b_state;
 	nhdr->b_l1hdr.b_arc_access = hdr->b_l1hdr.b_arc_access;
 	nhdr->b_l1hdr.b_mru_hits = hdr->b_l1hdr.b_mru_hits;
@@ -3563,6 +4120,7 @@ arc_hdr_realloc_crypt(arc_buf_hdr_t *hdr, boolean_t need_crypt)
 	nhdr->b_l1hdr.b_l2_hits = hdr->b_l1hdr.b_l2_hits;
 	nhdr->b_l1hdr.b_acb = hdr->b_l1hdr.b_acb;
 	nhdr->b_l1hdr.b_pabd = hdr->b_l1hdr.b_pabd;
+	nhdr->b_l1hdr.b_tenant = hdr->b_l1hdr.b_tenant;
 
 	/*
 	 * This zfs_refcount_add() exists only to ensure that the individual
@@ -3587,11 +4145,14 @@ arc_hdr_realloc_crypt(arc_buf_hdr_t *hdr, boolean_t need_crypt)
 		arc_hdr_clear_flags(nhdr, ARC_FLAG_PROTECTED);
 	}
 
-	/* unset all members of the original hdr */
+	/*
+	 * Unset all members of the original hdr, except for the flags which
+	 * tell arc_hdr_unpin() which cache it is freed to.
+	 */
 	bzero(&hdr->b_dva, sizeof (dva_t));
 	hdr->b_birth = 0;
 	hdr->b_type = ARC_BUFC_INVALID;
-	hdr->b_flags = 0;
+	hdr->b_flags &= ARC_FLAG_HAS_L1HDR | ARC_FLAG_PROTECTED;
 	hdr->b_psize = 0;
 	hdr->b_lsize = 0;
 	hdr->b_spa = 0;
@@ -3608,6 +4169,7 @@ arc_hdr_realloc_crypt(arc_buf_hdr_t *hdr, boolean_t need_crypt)
 	hdr->b_l1hdr.b_l2_hits = 0;
 	hdr->b_l1hdr.b_acb = NULL;
 	hdr->b_l1hdr.b_pabd = NULL;
+	hdr->b_l1hdr.b_tenant = NULL;
 
 	if (ocache == hdr_full_crypt_cache) {
 		ASSERT(!HDR_HAS_RABD(hdr));
@@ -3620,7 +4182,8 @@ arc_hdr_realloc_crypt(arc_buf_hdr_t *hdr, boolean_t need_crypt)
 	}
 
 	buf_discard_identity(hdr);
-	kmem_cache_free(ocache, hdr);
+	ASSERT3P(ocache, ==, arc_hdr_cache(hdr));
+	arc_hdr_unpin(hdr);
 
 	return (nhdr);
 }
@@ -3837,15 +4400,10 @@ arc_hdr_destroy(arc_buf_hdr_t *hdr)
 	if (HDR_HAS_L1HDR(hdr)) {
 		ASSERT(!multilist_link_active(&hdr->b_l1hdr.b_arc_node));
 		ASSERT3P(hdr->b_l1hdr.b_acb, ==, NULL);
-
-		if (!HDR_PROTECTED(hdr)) {
-			kmem_cache_free(hdr_full_cache, hdr);
-		} else {
-			kmem_cache_free(hdr_full_crypt_cache, hdr);
-		}
-	} else {
-		kmem_cache_free(hdr_l2only_cache, hdr);
+		arc_hdr_clear_tenant(hdr);
 	}
+
+	arc_hdr_unpin(hdr);
 }
 
 void
@@ -3994,6 +4552,20 @@ arc_evict_hdr(arc_buf_hdr_t *hdr, kmutex_t *hash_lock)
 		if (HDR_HAS_RABD(hdr))
 			arc_hdr_free_abd(hdr, B_TRUE);
 
+		/*
+		 * Blocks of a sequential scan are not remembered in the
+		 * ghost lists.  A later pass over the same data would
+		 * otherwise register as ghost hits and make arc_adapt()
+		 * grow the MRU at the expense of the MFU.
+		 */
+		if (HDR_SCAN(hdr) && !HDR_HAS_L2HDR(hdr)) {
+			ARCSTAT_BUMP(arcstat_deleted);
+			arc_change_state(arc_anon, hdr, hash_lock);
+			arc_hdr_destroy(hdr);
+			return (bytes_evicted);
+		}
+		arc_hdr_clear_flags(hdr, ARC_FLAG_SCAN);
+
 		arc_change_state(evicted_state, hdr, hash_lock);
 		ASSERT(HDR_IN_HASH_TABLE(hdr));
 		arc_hdr_set_flags(hdr, ARC_FLAG_IN_HASH_TABLE);
@@ -4003,26 +4575,58 @@ arc_evict_hdr(arc_buf_hdr_t *hdr, kmutex_t *hash_lock)
 	return (bytes_evicted);
 }
 
+/*
+ * Returns true if the header's data is charged to a dataset that is still
+ * within its arc_reserve, and should thus be passed over by eviction.
+ */
+static boolean_t
+arc_hdr_reserved(arc_buf_hdr_t *hdr)
+{
+	arc_tenant_t *at = hdr->b_l1hdr.b_tenant;
+
+	ASSERT(MUTEX_HELD(HDR_LOCK(hdr)));
+
+	if (at == NULL || at->at_reserve == 0 ||
+	    GHOST_STATE(hdr->b_l1hdr.b_state))
+		return (B_FALSE);
+
+	return (aggsum_compare(&at->at_size, at->at_reserve) <= 0);
+}
+
 static uint64_t
 arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
-    uint64_t spa, int64_t bytes)
+    uint64_t spa, arc_tenant_t *tenant, int64_t bytes, boolean_t *more)
 {
 	multilist_sublist_t *mls;
 	uint64_t bytes_evicted = 0;
 	arc_buf_hdr_t *hdr;
 	kmutex_t *hash_lock;
 	int evict_count = 0;
+	boolean_t reserve;
 
 	ASSERT3P(marker, !=, NULL);
 	IMPLY(bytes < 0, bytes == ARC_EVICT_ALL);
 
+	/*
+	 * Reservations are honored only when evicting to a target size,
+	 * and only while they add up to a sane fraction of the ARC.
+	 * Flushing a pool or trimming a tenant to its quota ignores them.
+	 */
+	reserve = (tenant == NULL && bytes != ARC_EVICT_ALL &&
+	    arc_tenant_reserved != 0 &&
+	    arc_tenant_reserved <= arc_c / 100 * zfs_arc_reserve_percent);
+
 	mls = multilist_sublist_lock(ml, idx);
 
+	*more = B_FALSE;
 	for (hdr = multilist_sublist_prev(mls, marker); hdr != NULL;
 	    hdr = multilist_sublist_prev(mls, marker)) {
-		if ((bytes != ARC_EVICT_ALL && bytes_evicted >= bytes) ||
-		    (evict_count >= zfs_arc_evict_batch_limit))
+		if (bytes != ARC_EVICT_ALL && bytes_evicted >= bytes)
+			break;
+		if (evict_count >= zfs_arc_evict_batch_limit) {
+			*more = B_TRUE;
 			break;
+		}
 
 		/*
 		 * To keep our iteration location, move the marker
@@ -4055,6 +4659,17 @@ arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
 			continue;
 		}
 
+		/*
+		 * Or of a certain dataset.  Headers passed over for their
+		 * dataset count toward the batch limit, so that trimming a
+		 * small tenant doesn't hold the sublist lock while walking
+		 * the whole sublist.
+		 */
+		if (tenant != NULL && hdr->b_l1hdr.b_tenant != tenant) {
+			evict_count++;
+			continue;
+		}
+
 		hash_lock = HDR_LOCK(hdr);
 
 		/*
@@ -4069,6 +4684,13 @@ arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
 		ASSERT(!MUTEX_HELD(hash_lock));
 
 		if (mutex_tryenter(hash_lock)) {
+			if (reserve && arc_hdr_reserved(hdr)) {
+				mutex_exit(hash_lock);
+				ARCSTAT_BUMP(arcstat_evict_reserve_skip);
+				evict_count++;
+				continue;
+			}
+
 			uint64_t evicted = arc_evict_hdr(hdr, hash_lock);
 			mutex_exit(hash_lock);
 
@@ -4128,18 +4750,32 @@ arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
  * the given arc state; which is used by arc_flush().
  */
 static uint64_t
-arc_evict_state(arc_state_t *state, uint64_t spa, int64_t bytes,
-    arc_buf_contents_t type)
+arc_evict_state(arc_state_t *state, uint64_t spa, arc_tenant_t *tenant,
+    int64_t bytes, arc_buf_contents_t type)
 {
 	uint64_t total_evicted = 0;
 	multilist_t *ml = state->arcs_list[type];
 	int num_sublists;
+	unsigned int first, count;
 	arc_buf_hdr_t **markers;
 
 	IMPLY(bytes < 0, bytes == ARC_EVICT_ALL);
 
 	num_sublists = multilist_get_num_sublists(ml);
 
+	/*
+	 * For general memory pressure on a NUMA system, start with the
+	 * sublists of the node holding the most ARC data, so that memory
+	 * is released where it is scarcest. If nothing can be evicted
+	 * there we fall back to scanning every sublist below.
+	 */
+	first = 0;
+	count = num_sublists;
+	if (zfs_arc_numa_balance && arc_numa_nodes > 1 &&
+	    num_sublists >= arc_numa_nodes && spa == 0 && tenant == NULL &&
+	    bytes != ARC_EVICT_ALL && !GHOST_STATE(state))
+		arc_numa_sublists(ml, arc_numa_evict_node(), &first, &count);
+
 	/*
 	 * If we've tried to evict from each sublist, made some
 	 * progress, but still have not hit the target number of bytes
@@ -4170,8 +4806,10 @@ arc_evict_state(arc_state_t *state, uint64_t spa, int64_t bytes,
 	 * we're evicting all available buffers.
 	 */
 	while (total_evicted < bytes || bytes == ARC_EVICT_ALL) {
-		int sublist_idx = multilist_get_random_index(ml);
+		int sublist_idx = first +
+		    multilist_get_random_index(ml) % count;
 		uint64_t scan_evicted = 0;
+		boolean_t scan_more = B_FALSE;
 
 		/*
 		 * Try to reduce pinned dnodes with a floor of arc_dnode_limit.
@@ -4192,9 +4830,10 @@ arc_evict_state(arc_state_t *state, uint64_t spa, int64_t bytes,
 		 * (e.g. index 0) would cause evictions to favor certain
 		 * sublists over others.
 		 */
-		for (int i = 0; i < num_sublists; i++) {
+		for (int i = 0; i < count; i++) {
 			uint64_t bytes_remaining;
 			uint64_t bytes_evicted;
+			boolean_t more;
 
 			if (bytes == ARC_EVICT_ALL)
 				bytes_remaining = ARC_EVICT_ALL;
@@ -4204,14 +4843,30 @@ arc_evict_state(arc_state_t *state, uint64_t spa, int64_t bytes,
 				break;
 
 			bytes_evicted = arc_evict_state_impl(ml, sublist_idx,
-			    markers[sublist_idx], spa, bytes_remaining);
+			    markers[sublist_idx], spa, tenant, bytes_remaining,
+			    &more);
 
 			scan_evicted += bytes_evicted;
+			scan_more |= more;
 			total_evicted += bytes_evicted;
 
 			/* we've reached the end, wrap to the beginning */
-			if (++sublist_idx >= num_sublists)
-				sublist_idx = 0;
+			if (++sublist_idx >= first + count)
+				sublist_idx = first;
+		}
+
+		/*
+		 * A sublist which hit the batch limit on headers passed over
+		 * for their dataset or reservation has more to look at.
+		 */
+		if (scan_evicted == 0 && scan_more)
+			continue;
+
+		/* the preferred node is exhausted, widen to all of them */
+		if (scan_evicted == 0 && count != num_sublists) {
+			first = 0;
+			count = num_sublists;
+			continue;
 		}
 
 		/*
@@ -4272,7 +4927,8 @@ arc_flush_state(arc_state_t *state, uint64_t spa, arc_buf_contents_t type,
 	uint64_t evicted = 0;
 
 	while (zfs_refcount_count(&state->arcs_esize[type]) != 0) {
-		evicted += arc_evict_state(state, spa, ARC_EVICT_ALL, type);
+		evicted += arc_evict_state(state, spa, NULL, ARC_EVICT_ALL,
+		    type);
 
 		if (!retry)
 			break;
@@ -4349,7 +5005,7 @@ arc_adjust_impl(arc_state_t *state, uint64_t spa, int64_t bytes,
 	if (bytes > 0 && zfs_refcount_count(&state->arcs_esize[type]) > 0) {
 		delta = MIN(zfs_refcount_count(&state->arcs_esize[type]),
 		    bytes);
-		return (arc_evict_state(state, spa, delta, type));
+		return (arc_evict_state(state, spa, NULL, delta, type));
 	}
 
 	return (0);
@@ -4581,6 +5237,80 @@ arc_adjust_type(arc_state_t *state)
 	return (type);
 }
 
+/*
+ * Evict buffers charged to the given tenant until it is back within its
+ * arc_quota. Data is preferred over metadata, and the MRU over the MFU.
+ */
+static uint64_t
+arc_adjust_tenant(arc_tenant_t *at)
+{
+	arc_state_t *states[] = { arc_mru, arc_mfu };
+	arc_buf_contents_t types[] = { ARC_BUFC_DATA, ARC_BUFC_METADATA };
+	uint64_t total_evicted = 0;
+	uint64_t size = aggsum_value(&at->at_size);
+	uint64_t quota = at->at_quota;
+
+	for (int t = 0; t < ARRAY_SIZE(types); t++) {
+		for (int s = 0; s < ARRAY_SIZE(states); s++) {
+			if (quota == 0 || size <= quota + total_evicted)
+				return (total_evicted);
+
+			total_evicted += arc_evict_state(states[s], 0, at,
+			    size - quota - total_evicted, types[t]);
+		}
+	}
+
+	return (total_evicted);
+}
+
+/*
+ * Bring every dataset that has grown past its arc_quota back within it.
+ * This runs ahead of the ARC-wide adjustment, so space given up by
+ * over-quota datasets is reclaimed first.
+ */
+static uint64_t
+arc_adjust_tenants(void)
+{
+	arc_tenant_t search;
+	arc_tenant_t *at;
+	uint64_t total_evicted = 0;
+
+	rw_enter(&arc_tenant_lock, RW_READER);
+	at = avl_first(&arc_tenant_tree);
+	while (at != NULL) {
+		if (at->at_quota == 0 ||
+		    aggsum_compare(&at->at_size, at->at_quota) <= 0 ||
+		    !arc_tenant_tryhold(at)) {
+			at = AVL_NEXT(&arc_tenant_tree, at);
+			continue;
+		}
+
+		/*
+		 * Eviction can drop the last reference to other tenants,
+		 * which requires arc_tenant_lock as writer, so we must not
+		 * hold the lock while evicting. Remember where we were and
+		 * pick up after this tenant once we're done with it.
+		 */
+		search.at_spa = at->at_spa;
+		search.at_objset = at->at_objset;
+		rw_exit(&arc_tenant_lock);
+
+		total_evicted += arc_adjust_tenant(at);
+		arc_tenant_rele(at);
+
+		avl_index_t where;
+		rw_enter(&arc_tenant_lock, RW_READER);
+		at = avl_find(&arc_tenant_tree, &search, &where);
+		if (at != NULL)
+			at = AVL_NEXT(&arc_tenant_tree, at);
+		else
+			at = avl_nearest(&arc_tenant_tree, where, AVL_AFTER);
+	}
+	rw_exit(&arc_tenant_lock);
+
+	return (total_evicted);
+}
+
 /*
  * Evict buffers from the cache, such that arc_size is capped by arc_c.
  */
@@ -4590,8 +5320,16 @@ arc_adjust(void)
 	uint64_t total_evicted = 0;
 	uint64_t bytes;
 	int64_t target;
-	uint64_t asize = aggsum_value(&arc_size);
-	uint64_t ameta = aggsum_value(&arc_meta_used);
+	uint64_t asize, ameta;
+
+	/*
+	 * Trim datasets that are over their arc_quota before looking at
+	 * the ARC as a whole.
+	 */
+	total_evicted += arc_adjust_tenants();
+
+	asize = aggsum_value(&arc_size);
+	ameta = aggsum_value(&arc_meta_used);
 
 	/*
 	 * If we're over arc_meta_limit, we want to correct that before
@@ -5034,6 +5772,7 @@ arc_kmem_reap_now(void)
 	kmem_cache_reap_now(hdr_full_cache);
 	kmem_cache_reap_now(hdr_l2only_cache);
 	kmem_cache_reap_now(range_seg_cache);
+	zfs_zstd_cache_reap_now();
 
 	if (zio_arena != NULL) {
 		/*
@@ -5428,10 +6167,10 @@ arc_get_data_abd(arc_buf_hdr_t *hdr, uint64_t size, void *tag)
 
 	arc_get_data_impl(hdr, size, tag);
 	if (type == ARC_BUFC_METADATA) {
-		return (abd_alloc(size, B_TRUE));
+		return (abd_alloc_node(size, B_TRUE, hdr->b_l1hdr.b_node));
 	} else {
 		ASSERT(type == ARC_BUFC_DATA);
-		return (abd_alloc(size, B_FALSE));
+		return (abd_alloc_node(size, B_FALSE, hdr->b_l1hdr.b_node));
 	}
 }
 
@@ -5505,6 +6244,23 @@ arc_get_data_impl(arc_buf_hdr_t *hdr, uint64_t size, void *tag)
 	} else {
 		arc_space_consume(size, ARC_SPACE_DATA);
 	}
+	aggsum_add(&arc_node_size[ARC_HDR_NODE(hdr)], size);
+
+	/*
+	 * If this dataset has grown past its arc_quota, kick the reclaim
+	 * thread so arc_adjust_tenants() trims it back down. Unlike the
+	 * overall ARC limit we never block here; the quota is soft.
+	 */
+	arc_tenant_t *at = hdr->b_l1hdr.b_tenant;
+	if (at != NULL) {
+		aggsum_add(&at->at_size, size);
+		if (at->at_quota != 0 &&
+		    aggsum_upper_bound(&at->at_size) > at->at_quota) {
+			mutex_enter(&arc_reclaim_lock);
+			cv_signal(&arc_reclaim_thread_cv);
+			mutex_exit(&arc_reclaim_lock);
+		}
+	}
 
 	/*
 	 * Update the state size.  Note that ghost states have a
@@ -5580,6 +6336,8 @@ arc_free_data_impl(arc_buf_hdr_t *hdr, uint64_t size, void *tag)
 		    size, tag);
 	}
 	(void) zfs_refcount_remove_many(&state->arcs_size, size, tag);
+	arc_tenant_charge(hdr, -size);
+	aggsum_add(&arc_node_size[ARC_HDR_NODE(hdr)], -size);
 
 	VERIFY3U(hdr->b_type, ==, type);
 	if (type == ARC_BUFC_METADATA) {
@@ -5651,8 +6409,11 @@ arc_access(arc_buf_hdr_t *hdr, kmutex_t *hash_lock)
 			/*
 			 * More than 125ms have passed since we
 			 * instantiated this buffer.  Move it to the
-			 * most frequently used state.
+			 * most frequently used state.  A scan block
+			 * that is accessed again is no longer treated
+			 * as part of the scan.
 			 */
+			arc_hdr_clear_flags(hdr, ARC_FLAG_SCAN);
 			hdr->b_l1hdr.b_arc_access = now;
 			DTRACE_PROBE1(new_state__mfu, arc_buf_hdr_t *, hdr);
 			arc_change_state(arc_mfu, hdr, hash_lock);
@@ -6096,7 +6857,7 @@ top:
 		 * Embedded BP's have no DVA and require no I/O to "read".
 		 * Create an anonymous arc buf to back it.
 		 */
-		hdr = buf_hash_find(guid, bp, &hash_lock);
+		hdr = buf_hash_find_lockless(guid, bp, &hash_lock);
 	}
 
 	/*
@@ -6278,6 +7039,7 @@ top:
 				arc_hdr_destroy(hdr);
 				goto top; /* restart the IO request */
 			}
+			arc_hdr_set_tenant(hdr, zb->zb_objset);
 		} else {
 			/*
 			 * This block is in the ghost cache or encrypted data
@@ -6324,6 +7086,8 @@ top:
 			 * avoid hitting an assert in remove_reference().
 			 */
 			arc_access(hdr, hash_lock);
+			if (hdr->b_l1hdr.b_tenant == NULL)
+				arc_hdr_set_tenant(hdr, zb->zb_objset);
 			arc_hdr_alloc_abd(hdr, encrypted_read);
 		}
 
@@ -6365,6 +7129,16 @@ top:
 			arc_hdr_set_flags(hdr, ARC_FLAG_INDIRECT);
 		if (*arc_flags & ARC_FLAG_PREDICTIVE_PREFETCH)
 			arc_hdr_set_flags(hdr, ARC_FLAG_PREDICTIVE_PREFETCH);
+		/*
+		 * Only blocks that are new to the ARC are admitted as part
+		 * of a scan; a ghost hit has already been placed in the MRU
+		 * or MFU state on the strength of its earlier use.
+		 */
+		if ((*arc_flags & ARC_FLAG_SCAN) &&
+		    hdr->b_l1hdr.b_state == arc_anon) {
+			arc_hdr_set_flags(hdr, ARC_FLAG_SCAN);
+			ARCSTAT_BUMP(arcstat_scan_bypassed);
+		}
 		ASSERT(!GHOST_STATE(hdr->b_l1hdr.b_state));
 
 		acb = kmem_zalloc(sizeof (arc_callback_t), KM_SLEEP);
@@ -6778,6 +7552,9 @@ arc_release(arc_buf_t *buf, void *tag)
 
 		(void) zfs_refcount_remove_many(&state->arcs_size,
 		    arc_buf_size(buf), buf);
+		arc_tenant_charge(hdr, -arc_buf_size(buf));
+		aggsum_add(&arc_node_size[ARC_HDR_NODE(hdr)],
+		    -arc_buf_size(buf));
 
 		if (zfs_refcount_is_zero(&hdr->b_l1hdr.b_refcnt)) {
 			ASSERT3P(state, !=, arc_l2c_only);
@@ -6815,6 +7592,8 @@ arc_release(arc_buf_t *buf, void *tag)
 		nhdr->b_l1hdr.b_bufcnt = 1;
 		if (ARC_BUF_ENCRYPTED(buf))
 			nhdr->b_crypt_hdr.b_ebufcnt = 1;
+		aggsum_add(&arc_node_size[ARC_HDR_NODE(nhdr)],
+		    arc_buf_size(buf));
 		nhdr->b_l1hdr.b_mru_hits = 0;
 		nhdr->b_l1hdr.b_mru_ghost_hits = 0;
 		nhdr->b_l1hdr.b_mfu_hits = 0;
@@ -7116,8 +7895,13 @@ arc_write_done(zio_t *zio)
 		}
 		arc_hdr_clear_flags(hdr, ARC_FLAG_IO_IN_PROGRESS);
 		/* if it's not anon, we are doing a scrub */
-		if (exists == NULL && hdr->b_l1hdr.b_state == arc_anon)
+		if (exists == NULL && hdr->b_l1hdr.b_state == arc_anon) {
+			if (hdr->b_l1hdr.b_tenant == NULL) {
+				arc_hdr_set_tenant(hdr,
+				    zio->io_bookmark.zb_objset);
+			}
 			arc_access(hdr, hash_lock);
+		}
 		mutex_exit(hash_lock);
 	} else {
 		arc_hdr_clear_flags(hdr, ARC_FLAG_IO_IN_PROGRESS);
@@ -7402,6 +8186,10 @@ arc_kstat_update(kstat_t *ksp, int rw)
 		ARCSTAT(arcstat_dbuf_size) = aggsum_value(&astat_dbuf_size);
 		ARCSTAT(arcstat_dnode_size) = aggsum_value(&astat_dnode_size);
 		ARCSTAT(arcstat_bonus_size) = aggsum_value(&astat_bonus_size);
+		for (int i = 0; i < arc_numa_nodes; i++) {
+			ARCSTAT(arcstat_node_size[i]) =
+			    aggsum_value(&arc_node_size[i]);
+		}
 
 		as->arcstat_memory_all_bytes.value.ui64 =
 		    arc_all_memory();
@@ -7445,8 +8233,24 @@ arc_state_multilist_index_func(multilist_t *ml, void *obj)
 	 * has a power of two number of sublists, each sublists' usage
 	 * would not be evenly distributed.
 	 */
-	return (buf_hash(hdr->b_spa, &hdr->b_dva, hdr->b_birth) %
-	    multilist_get_num_sublists(ml));
+	uint64_t hash = buf_hash(hdr->b_spa, &hdr->b_dva, hdr->b_birth);
+	unsigned int num = multilist_get_num_sublists(ml);
+	unsigned int first, count;
+
+	/*
+	 * On NUMA systems the sublists are partitioned into one contiguous
+	 * range per node, and a header is placed within the range of the
+	 * node its data lives on. This lets arc_evict_state() target the
+	 * memory of a single node. The hash still spreads headers evenly
+	 * within each range. A header's b_node only changes while it is
+	 * not on any list (see arc_change_state()), so the index is stable.
+	 */
+	if (arc_numa_nodes == 1 || num < arc_numa_nodes ||
+	    !HDR_HAS_L1HDR(hdr))
+		return (hash % num);
+
+	arc_numa_sublists(ml, ARC_HDR_NODE(hdr), &first, &count);
+	return (first + hash % count);
 }
 
 /*
@@ -7623,6 +8427,8 @@ arc_state_init(void)
 	aggsum_init(&astat_bonus_size, 0);
 	aggsum_init(&astat_dnode_size, 0);
 	aggsum_init(&astat_dbuf_size, 0);
+	for (int i = 0; i < ARC_MAX_NODES; i++)
+		aggsum_init(&arc_node_size[i], 0);
 
 	arc_anon->arcs_state = ARC_STATE_ANON;
 	arc_mru->arcs_state = ARC_STATE_MRU;
@@ -7675,6 +8481,8 @@ arc_state_fini(void)
 	aggsum_fini(&astat_bonus_size);
 	aggsum_fini(&astat_dnode_size);
 	aggsum_fini(&astat_dbuf_size);
+	for (int i = 0; i < ARC_MAX_NODES; i++)
+		aggsum_fini(&arc_node_size[i]);
 }
 
 uint64_t
@@ -7706,6 +8514,9 @@ arc_init(void)
 	/* Set to 1/64 of all memory or a minimum of 512K */
 	arc_sys_free = MAX(allmem / 64, (512 * 1024));
 	arc_need_free = 0;
+
+	/* Partition the ARC state sublists per NUMA node */
+	arc_numa_nodes = MIN(nr_node_ids, ARC_MAX_NODES);
 #endif
 
 	/* Set max to 1/2 of all memory */
@@ -7756,13 +8567,24 @@ arc_init(void)
 	    offsetof(arc_prune_t, p_node));
 	mutex_init(&arc_prune_mtx, NULL, MUTEX_DEFAULT, NULL);
 
+	avl_create(&arc_tenant_tree, arc_tenant_compare,
+	    sizeof (arc_tenant_t), offsetof(arc_tenant_t, at_node));
+	rw_init(&arc_tenant_lock, NULL, RW_DEFAULT, NULL);
+
 	arc_prune_taskq = taskq_create("arc_prune", max_ncpus, defclsyspri,
 	    max_ncpus, INT_MAX, TASKQ_PREPOPULATE | TASKQ_DYNAMIC);
 
 	arc_reclaim_thread_exit = B_FALSE;
 
+	for (int i = 0; i < ARC_MAX_NODES; i++) {
+		snprintf(arc_stats.arcstat_node_size[i].name, KSTAT_STRLEN,
+		    "node%d_size", i);
+		arc_stats.arcstat_node_size[i].data_type = KSTAT_DATA_UINT64;
+	}
+
 	arc_ksp = kstat_create("zfs", 0, "arcstats", "misc", KSTAT_TYPE_NAMED,
-	    sizeof (arc_stats) / sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	    sizeof (arc_stats) / sizeof (kstat_named_t) - ARC_MAX_NODES +
+	    arc_numa_nodes, KSTAT_FLAG_VIRTUAL);
 
 	if (arc_ksp != NULL) {
 		arc_ksp->ks_data = &arc_stats;
@@ -7841,6 +8663,8 @@ arc_fini(void)
 
 	list_destroy(&arc_prune_list);
 	mutex_destroy(&arc_prune_mtx);
+	avl_destroy(&arc_tenant_tree);
+	rw_destroy(&arc_tenant_lock);
 	mutex_destroy(&arc_reclaim_lock);
 	cv_destroy(&arc_reclaim_thread_cv);
 	cv_destroy(&arc_reclaim_waiters_cv);
@@ -7969,6 +8793,14 @@ arc_fini(void)
  * 8. If an ARC buffer is written (and dirtied) which also exists in the
  * L2ARC, the now stale L2ARC buffer is immediately dropped.
  *
+ * 9. The L2ARC contents persist across pool export/import and reboots.
+ * Along with the buffers, l2arc_write_buffers() writes log blocks which
+ * describe the buffers it has written, and a device header at the start
+ * of the device which points to the newest log blocks.  When a cache
+ * device is added to the pool, l2arc_rebuild() walks the log blocks and
+ * recreates L2-only ARC headers for the buffers still present on the
+ * device.  See the description of the on-disk format in arc_impl.h.
+ *
  * The performance of the L2ARC can be tweaked by a number of tunables, which
  * may be necessary for different workloads:
  *
@@ -7982,6 +8814,10 @@ arc_fini(void)
  *				since more compressed buffers are likely to
  *				be present
  *	l2arc_feed_secs		seconds between L2ARC writing
+ *	l2arc_rebuild_enabled	restore the L2ARC contents on pool import
+ *	l2arc_rebuild_blocks_min_l2size
+ *				minimum device size for which log blocks are
+ *				written
  *
  * Tunables may be removed or added as future performance improvements are
  * integrated, and also may become zpool properties.
@@ -8083,7 +8919,10 @@ l2arc_dev_get_next(void)
 	first = NULL;
 	next = l2arc_dev_last;
 	do {
-		/* loop around the list looking for a non-faulted vdev */
+		/*
+		 * Loop around the list looking for a non-faulted vdev
+		 * which is not being rebuilt.
+		 */
 		if (next == NULL) {
 			next = list_head(l2arc_dev_list);
 		} else {
@@ -8098,10 +8937,10 @@ l2arc_dev_get_next(void)
 		else if (next == first)
 			break;
 
-	} while (vdev_is_dead(next->l2ad_vdev));
+	} while (vdev_is_dead(next->l2ad_vdev) || next->l2ad_rebuild);
 
 	/* if we were unable to find any usable vdevs, return NULL */
-	if (vdev_is_dead(next->l2ad_vdev))
+	if (vdev_is_dead(next->l2ad_vdev) || next->l2ad_rebuild)
 		next = NULL;
 
 	l2arc_dev_last = next;
@@ -8540,15 +9379,25 @@ l2arc_evict(l2arc_dev_t *dev, uint64_t distance, boolean_t all)
 	arc_buf_hdr_t *hdr, *hdr_prev;
 	kmutex_t *hash_lock;
 	uint64_t taddr;
+	l2arc_lb_ptr_buf_t *lb_ptr_buf, *lb_ptr_buf_prev;
 
 	buflist = &dev->l2ad_buflist;
 
-	if (!all && dev->l2ad_first) {
+	/*
+	 * We need to add in the worst case scenario of log block overhead.
+	 */
+	distance += l2arc_log_blk_overhead(distance, dev);
+
+	if (!all && dev->l2ad_hand + distance > dev->l2ad_end) {
 		/*
-		 * This is the first sweep through the device.  There is
-		 * nothing to evict.
+		 * The write hand restored by l2arc_rebuild() may be too
+		 * close to the end of the device to fit this write. Jump
+		 * to the start of the device now, as l2arc_write_buffers()
+		 * would have done before the device was last exported.
 		 */
-		return;
+		dev->l2ad_hand = dev->l2ad_start;
+		dev->l2ad_evict = dev->l2ad_start;
+		dev->l2ad_first = B_FALSE;
 	}
 
 	if (dev->l2ad_hand >= (dev->l2ad_end - (2 * distance))) {
@@ -8563,6 +9412,51 @@ l2arc_evict(l2arc_dev_t *dev, uint64_t distance, boolean_t all)
 	DTRACE_PROBE4(l2arc__evict, l2arc_dev_t *, dev, list_t *, buflist,
 	    uint64_t, taddr, boolean_t, all);
 
+	if (!all) {
+		/*
+		 * Record the evicted offset even on the first sweep through
+		 * the device, so that the device header always tells the
+		 * rebuild which region may be overwritten next.
+		 */
+		dev->l2ad_evict = MAX(dev->l2ad_evict, taddr);
+	}
+
+	if (!all && dev->l2ad_first) {
+		/*
+		 * This is the first sweep through the device.  There is
+		 * nothing to evict.
+		 */
+		return;
+	}
+
+	/*
+	 * Drop the pointers to any log blocks in the evicted region; their
+	 * space is about to be overwritten.
+	 */
+	mutex_enter(&dev->l2ad_mtx);
+	for (lb_ptr_buf = list_tail(&dev->l2ad_lbptr_list); lb_ptr_buf;
+	    lb_ptr_buf = lb_ptr_buf_prev) {
+		uint64_t asize;
+
+		lb_ptr_buf_prev = list_prev(&dev->l2ad_lbptr_list, lb_ptr_buf);
+
+		if (!all && (lb_ptr_buf->lb_ptr->lbp_daddr >= taddr ||
+		    lb_ptr_buf->lb_ptr->lbp_daddr < dev->l2ad_hand))
+			break;
+
+		asize = L2BLK_GET_PSIZE(lb_ptr_buf->lb_ptr->lbp_prop);
+		ARCSTAT_INCR(arcstat_l2_log_blk_asize, -asize);
+		ARCSTAT_BUMPDOWN(arcstat_l2_log_blk_count);
+		dev->l2ad_lb_asize -= asize;
+		dev->l2ad_lb_count--;
+		vdev_space_update(dev->l2ad_vdev, -asize, 0, 0);
+
+		list_remove(&dev->l2ad_lbptr_list, lb_ptr_buf);
+		kmem_free(lb_ptr_buf->lb_ptr, sizeof (l2arc_log_blkptr_t));
+		kmem_free(lb_ptr_buf, sizeof (l2arc_lb_ptr_buf_t));
+	}
+	mutex_exit(&dev->l2ad_mtx);
+
 top:
 	mutex_enter(&dev->l2ad_mtx);
 	for (hdr = list_tail(buflist); hdr; hdr = hdr_prev) {
@@ -8953,9 +9847,17 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 			write_asize += asize;
 			dev->l2ad_hand += asize;
 
+			/*
+			 * Append buf info to current log and commit if full.
+			 */
+			boolean_t commit = l2arc_log_blk_insert(dev, hdr);
+
 			mutex_exit(hash_lock);
 
 			(void) zio_nowait(wzio);
+
+			if (commit)
+				l2arc_log_blk_commit(dev, pio);
 		}
 
 		multilist_sublist_unlock(mls);
@@ -8983,8 +9885,10 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 	 * Bump device hand to the device start if it is approaching the end.
 	 * l2arc_evict() will already have evicted ahead for this case.
 	 */
-	if (dev->l2ad_hand >= (dev->l2ad_end - target_sz)) {
+	if (dev->l2ad_hand >= (dev->l2ad_end - (target_sz +
+	    l2arc_log_blk_overhead(target_sz, dev)))) {
 		dev->l2ad_hand = dev->l2ad_start;
+		dev->l2ad_evict = dev->l2ad_start;
 		dev->l2ad_first = B_FALSE;
 	}
 
@@ -8992,6 +9896,12 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 	(void) zio_wait(pio);
 	dev->l2ad_writing = B_FALSE;
 
+	/*
+	 * Update the device header now that the buffers and any log blocks
+	 * written along with them are on stable storage.
+	 */
+	l2arc_dev_hdr_update(dev);
+
 	return (write_asize);
 }
 
@@ -9120,22 +10030,48 @@ void
 l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 {
 	l2arc_dev_t *adddev;
+	uint64_t l2dhdr_asize;
 
 	ASSERT(!l2arc_vdev_present(vd));
 
 	/*
-	 * Create a new l2arc device entry.
+	 * Create a new l2arc device entry.  The start of the device is
+	 * reserved for the persistent L2ARC device header.
 	 */
-	adddev = kmem_zalloc(sizeof (l2arc_dev_t), KM_SLEEP);
+	adddev = vmem_zalloc(sizeof (l2arc_dev_t), KM_SLEEP);
+	l2dhdr_asize = vdev_psize_to_asize(vd,
+	    sizeof (l2arc_dev_hdr_phys_t));
 	adddev->l2ad_spa = spa;
 	adddev->l2ad_vdev = vd;
-	adddev->l2ad_start = VDEV_LABEL_START_SIZE;
+	adddev->l2ad_start = VDEV_LABEL_START_SIZE + l2dhdr_asize;
 	adddev->l2ad_end = VDEV_LABEL_START_SIZE + vdev_get_min_asize(vd);
 	adddev->l2ad_hand = adddev->l2ad_start;
+	adddev->l2ad_evict = adddev->l2ad_start;
 	adddev->l2ad_first = B_TRUE;
 	adddev->l2ad_writing = B_FALSE;
+	adddev->l2ad_dev_hdr = kmem_zalloc(l2dhdr_asize, KM_SLEEP);
+	adddev->l2ad_dev_hdr_asize = l2dhdr_asize;
 	list_link_init(&adddev->l2ad_node);
 
+	/*
+	 * Only log the contents of devices which are large enough for the
+	 * log block overhead to be worthwhile.
+	 */
+	if (adddev->l2ad_end - adddev->l2ad_start >=
+	    l2arc_rebuild_blocks_min_l2size) {
+		adddev->l2ad_log_entries = MIN((adddev->l2ad_end -
+		    adddev->l2ad_start) >> SPA_MAXBLOCKSHIFT,
+		    L2ARC_LOG_BLK_MAX_ENTRIES);
+	}
+
+	/*
+	 * Restore the previous contents of the device, unless we're only
+	 * looking at the pool config for import.
+	 */
+	if (adddev->l2ad_log_entries > 0 && l2arc_rebuild_enabled &&
+	    spa_load_state(spa) != SPA_LOAD_TRYIMPORT)
+		adddev->l2ad_rebuild = B_TRUE;
+
 	mutex_init(&adddev->l2ad_mtx, NULL, MUTEX_DEFAULT, NULL);
 	/*
 	 * This is a list of all ARC buffers that are still valid on the
@@ -9144,6 +10080,13 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 	list_create(&adddev->l2ad_buflist, sizeof (arc_buf_hdr_t),
 	    offsetof(arc_buf_hdr_t, b_l2hdr.b_l2node));
 
+	/*
+	 * This is a list of pointers to log blocks that are still present
+	 * on the device.
+	 */
+	list_create(&adddev->l2ad_lbptr_list, sizeof (l2arc_lb_ptr_buf_t),
+	    offsetof(l2arc_lb_ptr_buf_t, node));
+
 	vdev_space_update(vd, 0, 0, adddev->l2ad_end - adddev->l2ad_hand);
 	zfs_refcount_create(&adddev->l2ad_alloc);
 
@@ -9154,6 +10097,9 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 	list_insert_head(l2arc_dev_list, adddev);
 	atomic_inc_64(&l2arc_ndev);
 	mutex_exit(&l2arc_dev_mtx);
+
+	if (adddev->l2ad_rebuild)
+		l2arc_rebuild_vdev(adddev);
 }
 
 /*
@@ -9185,14 +10131,26 @@ l2arc_remove_vdev(vdev_t *vd)
 	atomic_dec_64(&l2arc_ndev);
 	mutex_exit(&l2arc_dev_mtx);
 
+	/*
+	 * Cancel any ongoing rebuild and wait for it to stop.
+	 */
+	mutex_enter(&l2arc_rebuild_thr_lock);
+	remdev->l2ad_rebuild_cancel = B_TRUE;
+	while (remdev->l2ad_rebuild_began)
+		cv_wait(&l2arc_rebuild_thr_cv, &l2arc_rebuild_thr_lock);
+	mutex_exit(&l2arc_rebuild_thr_lock);
+
 	/*
 	 * Clear all buflists and ARC references.  L2ARC device flush.
 	 */
 	l2arc_evict(remdev, 0, B_TRUE);
 	list_destroy(&remdev->l2ad_buflist);
+	ASSERT(list_is_empty(&remdev->l2ad_lbptr_list));
+	list_destroy(&remdev->l2ad_lbptr_list);
 	mutex_destroy(&remdev->l2ad_mtx);
 	zfs_refcount_destroy(&remdev->l2ad_alloc);
-	kmem_free(remdev, sizeof (l2arc_dev_t));
+	kmem_free(remdev->l2ad_dev_hdr, remdev->l2ad_dev_hdr_asize);
+	vmem_free(remdev, sizeof (l2arc_dev_t));
 }
 
 void
@@ -9205,6 +10163,8 @@ l2arc_init(void)
 
 	mutex_init(&l2arc_feed_thr_lock, NULL, MUTEX_DEFAULT, NULL);
 	cv_init(&l2arc_feed_thr_cv, NULL, CV_DEFAULT, NULL);
+	mutex_init(&l2arc_rebuild_thr_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&l2arc_rebuild_thr_cv, NULL, CV_DEFAULT, NULL);
 	mutex_init(&l2arc_dev_mtx, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&l2arc_free_on_write_mtx, NULL, MUTEX_DEFAULT, NULL);
 
@@ -9229,6 +10189,8 @@ l2arc_fini(void)
 
 	mutex_destroy(&l2arc_feed_thr_lock);
 	cv_destroy(&l2arc_feed_thr_cv);
+	mutex_destroy(&l2arc_rebuild_thr_lock);
+	cv_destroy(&l2arc_rebuild_thr_cv);
 	mutex_destroy(&l2arc_dev_mtx);
 	mutex_destroy(&l2arc_free_on_write_mtx);
 
@@ -9260,6 +10222,863 @@ l2arc_stop(void)
 	mutex_exit(&l2arc_feed_thr_lock);
 }
 
+/*
+ * Punches out a rebuild thread for an L2ARC device.  The thread waits for
+ * the pool to finish loading before it starts reading the device.
+ */
+static void
+l2arc_rebuild_vdev(l2arc_dev_t *dev)
+{
+	ASSERT(dev->l2ad_rebuild);
+
+	mutex_enter(&l2arc_rebuild_thr_lock);
+	dev->l2ad_rebuild_began = B_TRUE;
+	mutex_exit(&l2arc_rebuild_thr_lock);
+
+	(void) thread_create(NULL, 0, l2arc_rebuild_thread, dev, 0, &p0,
+	    TS_RUN, minclsyspri);
+}
+
+/*
+ * Main entry point for L2ARC rebuilding.
+ */
+static void
+l2arc_rebuild_thread(void *arg)
+{
+	l2arc_dev_t *dev = arg;
+	fstrans_cookie_t cookie;
+
+	VERIFY(dev->l2ad_rebuild);
+
+	cookie = spl_fstrans_mark();
+	(void) l2arc_rebuild(dev);
+	spl_fstrans_unmark(cookie);
+
+	mutex_enter(&l2arc_rebuild_thr_lock);
+	dev->l2ad_rebuild = B_FALSE;
+	dev->l2ad_rebuild_began = B_FALSE;
+	cv_broadcast(&l2arc_rebuild_thr_cv);
+	mutex_exit(&l2arc_rebuild_thr_lock);
+
+	thread_exit();
+}
+
+/*
+ * Cancel any L2ARC rebuilds on the devices of a pool and wait for them to
+ * stop.  Called from spa_unload() before the pool's config lock is taken
+ * as writer, so that a long running rebuild doesn't hold up the export.
+ */
+void
+l2arc_spa_rebuild_stop(spa_t *spa)
+{
+	l2arc_dev_t *dev;
+
+	ASSERT(MUTEX_HELD(&spa_namespace_lock));
+
+	mutex_enter(&l2arc_dev_mtx);
+	mutex_enter(&l2arc_rebuild_thr_lock);
+	for (dev = list_head(l2arc_dev_list); dev != NULL;
+	    dev = list_next(l2arc_dev_list, dev)) {
+		if (dev->l2ad_spa == spa)
+			dev->l2ad_rebuild_cancel = B_TRUE;
+	}
+	for (dev = list_head(l2arc_dev_list); dev != NULL;
+	    dev = list_next(l2arc_dev_list, dev)) {
+		while (dev->l2ad_spa == spa && dev->l2ad_rebuild_began) {
+			cv_wait(&l2arc_rebuild_thr_cv,
+			    &l2arc_rebuild_thr_lock);
+		}
+	}
+	mutex_exit(&l2arc_rebuild_thr_lock);
+	mutex_exit(&l2arc_dev_mtx);
+}
+
+/*
+ * Returns B_TRUE if check lies within the (possibly wrapped around) range
+ * [bottom, top] of an L2ARC device.
+ */
+static boolean_t
+l2arc_range_check_overlap(uint64_t bottom, uint64_t top, uint64_t check)
+{
+	if (bottom < top)
+		return (bottom <= check && check <= top);
+	else if (bottom > top)
+		return (check <= top || bottom <= check);
+	else
+		return (check == top);
+}
+
+/*
+ * This function implements the actual L2ARC metadata rebuild. It:
+ * starts reading the log block chain and restores each block's contents
+ * to memory (reconstructing arc_buf_hdr_t's).
+ *
+ * Operation stops under any of the following conditions:
+ *
+ * 1) We reach the end of the log block chain.
+ * 2) We encounter *any* error condition (cksum errors, io errors)
+ * 3) The rebuild is cancelled, or the system is running low on memory.
+ */
+static int
+l2arc_rebuild(l2arc_dev_t *dev)
+{
+	vdev_t			*vd = dev->l2ad_vdev;
+	spa_t			*spa = vd->vdev_spa;
+	l2arc_dev_hdr_phys_t	*l2dhdr = dev->l2ad_dev_hdr;
+	l2arc_log_blk_phys_t	*this_lb, *next_lb, *tmp_lb;
+	zio_t			*this_io = NULL, *next_io = NULL;
+	l2arc_log_blkptr_t	lbps[2];
+	l2arc_lb_ptr_buf_t	*lb_ptr_buf;
+	uint64_t		asize;
+	int			err = 0;
+
+	/*
+	 * The pool may still be loading, with its config lock held as
+	 * writer.  Wait for the lock rather than blocking on it, so that a
+	 * concurrent removal of the device (which cancels us and then waits
+	 * for us while holding the config lock) cannot deadlock.
+	 */
+	while (!spa_config_tryenter(spa, SCL_L2ARC, vd, RW_READER)) {
+		if (dev->l2ad_rebuild_cancel)
+			return (SET_ERROR(ECANCELED));
+		delay(MAX(MSEC_TO_TICK(10), 1));
+	}
+
+	/*
+	 * Retrieve the persistent L2ARC device state.  If the device header
+	 * can't be read or doesn't belong to this device, start afresh.
+	 */
+	if ((err = l2arc_dev_hdr_read(dev)) != 0) {
+		bzero(l2dhdr, dev->l2ad_dev_hdr_asize);
+		spa_config_exit(spa, SCL_L2ARC, vd);
+		return (err);
+	}
+
+	dev->l2ad_evict = MAX(l2dhdr->dh_evict, dev->l2ad_start);
+	dev->l2ad_hand = dev->l2ad_start;
+	if (l2dhdr->dh_start_lbps[0].lbp_daddr != 0) {
+		dev->l2ad_hand = l2dhdr->dh_start_lbps[0].lbp_daddr +
+		    L2BLK_GET_PSIZE((&l2dhdr->dh_start_lbps[0])->lbp_prop);
+	}
+	dev->l2ad_first = !!(l2dhdr->dh_flags & L2ARC_DEV_HDR_EVICT_FIRST);
+
+	this_lb = vmem_zalloc(sizeof (*this_lb), KM_SLEEP);
+	next_lb = vmem_zalloc(sizeof (*next_lb), KM_SLEEP);
+
+	bcopy(l2dhdr->dh_start_lbps, lbps, sizeof (lbps));
+
+	for (;;) {
+		if (!l2arc_log_blkptr_valid(dev, &lbps[0]))
+			break;
+
+		if ((err = l2arc_log_blk_read(dev, &lbps[0], &lbps[1],
+		    this_lb, next_lb, this_io, &next_io)) != 0)
+			goto out;
+		this_io = NULL;
+
+		/*
+		 * Our memory pressure valve. If the system is running low
+		 * on memory, rather than swamping memory with new ARC buf
+		 * hdrs, we opt not to rebuild the L2ARC. At this point,
+		 * however, we have already set up our L2ARC dev to chain in
+		 * new metadata log blocks, so the user may choose to offline/
+		 * online the L2ARC dev at a later time (or re-import the pool)
+		 * to reconstruct it (when there's less memory pressure).
+		 */
+		if (arc_reclaim_needed()) {
+			ARCSTAT_BUMP(arcstat_l2_rebuild_abort_lowmem);
+			cmn_err(CE_NOTE, "System running low on memory, "
+			    "aborting L2ARC rebuild.");
+			err = SET_ERROR(ENOMEM);
+			goto out;
+		}
+
+		l2arc_log_blk_restore(dev, this_lb);
+
+		/*
+		 * Remember the log block, so that l2arc_evict() can account
+		 * for it once it is overwritten.
+		 */
+		asize = L2BLK_GET_PSIZE((&lbps[0])->lbp_prop);
+		lb_ptr_buf = kmem_alloc(sizeof (l2arc_lb_ptr_buf_t), KM_SLEEP);
+		lb_ptr_buf->lb_ptr = kmem_alloc(sizeof (l2arc_log_blkptr_t),
+		    KM_SLEEP);
+		bcopy(&lbps[0], lb_ptr_buf->lb_ptr,
+		    sizeof (l2arc_log_blkptr_t));
+		mutex_enter(&dev->l2ad_mtx);
+		list_insert_tail(&dev->l2ad_lbptr_list, lb_ptr_buf);
+		dev->l2ad_lb_asize += asize;
+		dev->l2ad_lb_count++;
+		mutex_exit(&dev->l2ad_mtx);
+		ARCSTAT_INCR(arcstat_l2_log_blk_asize, asize);
+		ARCSTAT_BUMP(arcstat_l2_log_blk_count);
+		vdev_space_update(vd, asize, 0, 0);
+
+		/*
+		 * Protection against loops of log blocks: once the device
+		 * has wrapped around, the chain may lead back into blocks
+		 * which were overwritten by the payload of the newest log
+		 * blocks. If l2ad_evict lies in between the payload start
+		 * of the next log block and that of the present one, we have
+		 * looped around the device and must stop.
+		 */
+		if (!dev->l2ad_first && l2arc_range_check_overlap(
+		    lbps[1].lbp_payload_start, lbps[0].lbp_payload_start,
+		    dev->l2ad_evict))
+			break;
+
+		if (dev->l2ad_rebuild_cancel) {
+			err = SET_ERROR(ECANCELED);
+			goto out;
+		}
+
+		/*
+		 * Advance to the next log block.  The block we prefetched
+		 * is now the current one.
+		 */
+		lbps[0] = lbps[1];
+		lbps[1] = this_lb->lb_prev_lbp;
+		tmp_lb = this_lb;
+		this_lb = next_lb;
+		next_lb = tmp_lb;
+		this_io = next_io;
+		next_io = NULL;
+	}
+
+	if (this_io != NULL)
+		l2arc_log_blk_fetch_abort(this_io);
+out:
+	if (next_io != NULL)
+		l2arc_log_blk_fetch_abort(next_io);
+	vmem_free(this_lb, sizeof (*this_lb));
+	vmem_free(next_lb, sizeof (*next_lb));
+
+	if (err == 0)
+		ARCSTAT_BUMP(arcstat_l2_rebuild_success);
+
+	spa_config_exit(spa, SCL_L2ARC, vd);
+
+	return (err);
+}
+
+/*
+ * Attempts to read the device header on the provided L2ARC device and
+ * validate it against the device.  On success returns 0 and the header
+ * in dev->l2ad_dev_hdr.
+ */
+static int
+l2arc_dev_hdr_read(l2arc_dev_t *dev)
+{
+	l2arc_dev_hdr_phys_t	*l2dhdr = dev->l2ad_dev_hdr;
+	const uint64_t		l2dhdr_asize = dev->l2ad_dev_hdr_asize;
+	vdev_t			*vd = dev->l2ad_vdev;
+	zio_cksum_t		cksum;
+	abd_t			*abd;
+	int			err;
+
+	abd = abd_alloc_linear(l2dhdr_asize, B_TRUE);
+
+	err = zio_wait(zio_read_phys(NULL, vd,
+	    VDEV_LABEL_START_SIZE, l2dhdr_asize, abd,
+	    ZIO_CHECKSUM_OFF, NULL, NULL, ZIO_PRIORITY_ASYNC_READ,
+	    ZIO_FLAG_DONT_CACHE | ZIO_FLAG_CANFAIL |
+	    ZIO_FLAG_DONT_PROPAGATE | ZIO_FLAG_DONT_RETRY |
+	    ZIO_FLAG_SPECULATIVE, B_FALSE));
+
+	abd_copy_to_buf(l2dhdr, abd, l2dhdr_asize);
+	abd_free(abd);
+
+	if (err != 0) {
+		ARCSTAT_BUMP(arcstat_l2_rebuild_abort_io_errors);
+		zfs_dbgmsg("L2ARC IO error (%d) while reading device header, "
+		    "vdev guid: %llu", err, (u_longlong_t)vd->vdev_guid);
+		return (err);
+	}
+
+	/*
+	 * A device which was never written with a header (e.g. one which
+	 * was just added to the pool) has nothing to restore.
+	 */
+	if (l2dhdr->dh_magic != L2ARC_DEV_HDR_MAGIC)
+		return (SET_ERROR(ENOENT));
+
+	fletcher_4_native(l2dhdr, offsetof(l2arc_dev_hdr_phys_t,
+	    dh_self_cksum), NULL, &cksum);
+	if (!ZIO_CHECKSUM_EQUAL(cksum, l2dhdr->dh_self_cksum)) {
+		ARCSTAT_BUMP(arcstat_l2_rebuild_abort_dh_errors);
+		return (SET_ERROR(ECKSUM));
+	}
+
+	if (l2dhdr->dh_version != L2ARC_PERSISTENT_VERSION ||
+	    l2dhdr->dh_spa_guid != spa_guid(vd->vdev_spa) ||
+	    l2dhdr->dh_vdev_guid != vd->vdev_guid ||
+	    l2dhdr->dh_log_entries != dev->l2ad_log_entries ||
+	    l2dhdr->dh_start != dev->l2ad_start ||
+	    l2dhdr->dh_end != dev->l2ad_end ||
+	    l2dhdr->dh_evict > dev->l2ad_end ||
+	    (l2dhdr->dh_start_lbps[0].lbp_daddr != 0 &&
+	    (l2dhdr->dh_start_lbps[0].lbp_daddr < dev->l2ad_start ||
+	    l2dhdr->dh_start_lbps[0].lbp_daddr +
+	    L2BLK_GET_PSIZE((&l2dhdr->dh_start_lbps[0])->lbp_prop) >
+	    dev->l2ad_end))) {
+		/*
+		 * Attempt to rebuild a device containing no actual dev hdr
+		 * or containing a header from some other pool or from another
+		 * version of persistent L2ARC.
+		 */
+		ARCSTAT_BUMP(arcstat_l2_rebuild_abort_unsupported);
+		return (SET_ERROR(ENOTSUP));
+	}
+
+	return (0);
+}
+
+/*
+ * Reads L2ARC log blocks from storage and validates their contents.
+ *
+ * This function implements a simple fetcher to make sure that while
+ * we're processing one buffer the L2ARC is already fetching the next
+ * one in the chain.
+ *
+ * The arguments this_lp and next_lp point to the current and next log
+ * block address in the block chain. Similarly, this_lb and next_lb hold
+ * the l2arc_log_blk_phys_t's of the current and next L2ARC blk.
+ *
+ * The `this_io' and `next_io' arguments are used for block fetching.
+ * When issuing the first blk IO during rebuild, you should pass NULL for
+ * `this_io'. This function will then issue a sync IO to read the block and
+ * also issue an async IO to fetch the next block in the block chain. The
+ * fetched IO is returned in `next_io'. On subsequent calls to this
+ * function, pass the value returned in `next_io' from the previous call
+ * as `this_io' and a fresh `next_io' pointer to hold the next fetch IO.
+ * Prior to the call, you should initialize your `next_io' pointer to be
+ * NULL. If no fetch IO was issued, the pointer is left set at NULL.
+ *
+ * On success, this function returns 0, otherwise it returns an appropriate
+ * error code. On error the fetching IO is aborted and cleared before
+ * returning from this function. Therefore, if we return `success', the
+ * caller can assume that we have taken care of cleanup of fetch IOs.
+ */
+static int
+l2arc_log_blk_read(l2arc_dev_t *dev,
+    const l2arc_log_blkptr_t *this_lbp, const l2arc_log_blkptr_t *next_lbp,
+    l2arc_log_blk_phys_t *this_lb, l2arc_log_blk_phys_t *next_lb,
+    zio_t *this_io, zio_t **next_io)
+{
+	int		err = 0;
+	zio_cksum_t	cksum;
+	abd_t		*abd = NULL;
+	uint64_t	asize;
+
+	ASSERT(this_lbp != NULL && next_lbp != NULL);
+	ASSERT(this_lb != NULL && next_lb != NULL);
+	ASSERT(next_io != NULL && *next_io == NULL);
+	ASSERT(l2arc_log_blkptr_valid(dev, this_lbp));
+
+	/*
+	 * Check to see if we have issued the IO for this log block in a
+	 * previous run. If not, this is the first call, so issue it now.
+	 */
+	if (this_io == NULL) {
+		this_io = l2arc_log_blk_fetch(dev->l2ad_vdev, this_lbp,
+		    this_lb);
+	}
+
+	/*
+	 * Peek to see if we can start issuing the next IO immediately.
+	 */
+	if (l2arc_log_blkptr_valid(dev, next_lbp)) {
+		/*
+		 * Start issuing IO for the next log block early - this
+		 * should help keep the L2ARC device busy while we
+		 * decompress and restore this log block.
+		 */
+		*next_io = l2arc_log_blk_fetch(dev->l2ad_vdev, next_lbp,
+		    next_lb);
+	}
+
+	/* Wait for the IO to read this log block to complete */
+	if ((err = zio_wait(this_io)) != 0) {
+		ARCSTAT_BUMP(arcstat_l2_rebuild_abort_io_errors);
+		zfs_dbgmsg("L2ARC IO error (%d) while reading log block, "
+		    "offset: %llu, vdev guid: %llu", err,
+		    (u_longlong_t)this_lbp->lbp_daddr,
+		    (u_longlong_t)dev->l2ad_vdev->vdev_guid);
+		goto cleanup;
+	}
+
+	/* Make sure the buffer checks out */
+	asize = L2BLK_GET_PSIZE((this_lbp)->lbp_prop);
+	fletcher_4_native(this_lb, asize, NULL, &cksum);
+	if (!ZIO_CHECKSUM_EQUAL(cksum, this_lbp->lbp_cksum)) {
+		ARCSTAT_BUMP(arcstat_l2_rebuild_abort_cksum_lb_errors);
+		zfs_dbgmsg("L2ARC log block cksum failed, offset: %llu, "
+		    "vdev guid: %llu, l2ad_hand: %llu, l2ad_evict: %llu",
+		    (u_longlong_t)this_lbp->lbp_daddr,
+		    (u_longlong_t)dev->l2ad_vdev->vdev_guid,
+		    (u_longlong_t)dev->l2ad_hand,
+		    (u_longlong_t)dev->l2ad_evict);
+		err = SET_ERROR(ECKSUM);
+		goto cleanup;
+	}
+
+	/* Now we can take our time decoding this buffer */
+	switch (L2BLK_GET_COMPRESS((this_lbp)->lbp_prop)) {
+	case ZIO_COMPRESS_OFF:
+		break;
+	case ZIO_COMPRESS_LZ4:
+		abd = abd_alloc_for_io(asize, B_TRUE);
+		abd_copy_from_buf_off(abd, this_lb, 0, asize);
+		if ((err = zio_decompress_data(
+		    L2BLK_GET_COMPRESS((this_lbp)->lbp_prop),
+		    abd, this_lb, asize, sizeof (*this_lb))) != 0) {
+			err = SET_ERROR(EINVAL);
+			goto cleanup;
+		}
+		break;
+	default:
+		err = SET_ERROR(EINVAL);
+		goto cleanup;
+	}
+
+	if (this_lb->lb_magic != L2ARC_LOG_BLK_MAGIC) {
+		err = SET_ERROR(EINVAL);
+		goto cleanup;
+	}
+
+cleanup:
+	/* Abort an in-flight fetch I/O in case of error */
+	if (err != 0 && *next_io != NULL) {
+		l2arc_log_blk_fetch_abort(*next_io);
+		*next_io = NULL;
+	}
+	if (abd != NULL)
+		abd_free(abd);
+	return (err);
+}
+
+/*
+ * Restores the payload of a log block to ARC. This creates empty ARC hdr
+ * entries which only contain an l2arc hdr, essentially restoring the
+ * buffers to their L2ARC evicted state. This function also updates space
+ * usage on the L2ARC vdev to make sure it tracks restored buffers.
+ */
+static void
+l2arc_log_blk_restore(l2arc_dev_t *dev, const l2arc_log_blk_phys_t *lb)
+{
+	uint64_t	size = 0, asize = 0;
+	uint64_t	log_entries = dev->l2ad_log_entries;
+
+	for (int i = log_entries - 1; i >= 0; i--) {
+		/*
+		 * Restore goes in the reverse temporal direction to preserve
+		 * correct temporal ordering of buffers in the l2ad_buflist.
+		 * l2arc_hdr_restore also does a list_insert_tail instead of
+		 * list_insert_head on the l2ad_buflist:
+		 *
+		 *		LIST	l2ad_buflist		LIST
+		 *		HEAD  <------ (time) ------	TAIL
+		 * direction	+-----+-----+-----+-----+-----+    direction
+		 * of l2arc <== | buf | buf | buf | buf | buf | ===> of rebuild
+		 * fill		+-----+-----+-----+-----+-----+
+		 *		^				^
+		 *		|				|
+		 *		|				|
+		 *	l2arc_feed_thread		l2arc_rebuild
+		 *	will place new bufs here	restores bufs here
+		 */
+		const l2arc_log_ent_phys_t *le = &lb->lb_entries[i];
+
+		size += L2BLK_GET_LSIZE((le)->le_prop);
+		asize += vdev_psize_to_asize(dev->l2ad_vdev,
+		    L2BLK_GET_PSIZE((le)->le_prop));
+		l2arc_hdr_restore(le, dev);
+	}
+
+	ARCSTAT_INCR(arcstat_l2_rebuild_size, size);
+	ARCSTAT_INCR(arcstat_l2_rebuild_asize, asize);
+	ARCSTAT_INCR(arcstat_l2_rebuild_bufs, log_entries);
+	ARCSTAT_BUMP(arcstat_l2_rebuild_log_blks);
+}
+
+/*
+ * Restores a single ARC buf hdr from a log entry. The ARC buffer is put
+ * into a state indicating that it has been evicted to L2ARC.
+ */
+static void
+l2arc_hdr_restore(const l2arc_log_ent_phys_t *le, l2arc_dev_t *dev)
+{
+	arc_buf_hdr_t		*hdr, *exists;
+	kmutex_t		*hash_lock;
+	arc_buf_contents_t	type = L2BLK_GET_TYPE((le)->le_prop);
+	uint64_t		psize;
+
+	/*
+	 * Do all the allocation before grabbing any locks, this lets us
+	 * sleep if memory is full and we don't have to deal with failed
+	 * allocations.
+	 */
+	hdr = kmem_cache_alloc(hdr_l2only_cache, KM_SLEEP);
+	ASSERT(HDR_EMPTY(hdr));
+	ASSERT0(hdr->b_pins);
+	hdr->b_pins = 1;
+
+	HDR_SET_PSIZE(hdr, L2BLK_GET_PSIZE((le)->le_prop));
+	HDR_SET_LSIZE(hdr, L2BLK_GET_LSIZE((le)->le_prop));
+	hdr->b_spa = spa_load_guid(dev->l2ad_vdev->vdev_spa);
+	hdr->b_type = type;
+	hdr->b_flags = 0;
+	arc_hdr_set_flags(hdr, arc_bufc_to_flags(type) | ARC_FLAG_HAS_L2HDR);
+	arc_hdr_set_compress(hdr, L2BLK_GET_COMPRESS((le)->le_prop));
+	if (L2BLK_GET_PROTECTED((le)->le_prop))
+		arc_hdr_set_flags(hdr, ARC_FLAG_PROTECTED);
+	if (L2BLK_GET_PREFETCH((le)->le_prop))
+		arc_hdr_set_flags(hdr, ARC_FLAG_PREFETCH);
+
+	hdr->b_l2hdr.b_dev = dev;
+	hdr->b_l2hdr.b_daddr = le->le_daddr;
+	hdr->b_l2hdr.b_hits = 0;
+
+	hdr->b_dva = le->le_dva;
+	hdr->b_birth = le->le_birth;
+
+	exists = buf_hash_insert(hdr, &hash_lock);
+	if (exists) {
+		/*
+		 * Buffer was already cached, no need to restore it.
+		 */
+		mutex_exit(hash_lock);
+		buf_discard_identity(hdr);
+		arc_hdr_unpin(hdr);
+		ARCSTAT_BUMP(arcstat_l2_rebuild_bufs_precached);
+		return;
+	}
+
+	psize = arc_hdr_size(hdr);
+
+	mutex_enter(&dev->l2ad_mtx);
+	list_insert_tail(&dev->l2ad_buflist, hdr);
+	(void) zfs_refcount_add_many(&dev->l2ad_alloc, psize, hdr);
+	mutex_exit(&dev->l2ad_mtx);
+
+	ARCSTAT_INCR(arcstat_l2_lsize, HDR_GET_LSIZE(hdr));
+	ARCSTAT_INCR(arcstat_l2_psize, psize);
+	vdev_space_update(dev->l2ad_vdev, psize, 0, 0);
+
+	mutex_exit(hash_lock);
+}
+
+/*
+ * Starts an asynchronous read IO to read a log block. This is used in log
+ * block reconstruction to start reading the next block before we are done
+ * decoding and reconstructing the current block, to keep the l2arc device
+ * nice and hot with read IO to process.
+ * The returned zio will contain a newly allocated memory buffers for the IO
+ * data which should then be freed by the caller once the zio is no longer
+ * needed (i.e. due to it having completed). If you wish to abort this
+ * zio, you should do so using l2arc_log_blk_fetch_abort, which takes
+ * care of disposing of the allocated buffers correctly.
+ */
+static zio_t *
+l2arc_log_blk_fetch(vdev_t *vd, const l2arc_log_blkptr_t *lbp,
+    l2arc_log_blk_phys_t *lb)
+{
+	uint64_t	asize;
+	zio_t		*pio;
+	abd_t		*abd;
+
+	asize = L2BLK_GET_PSIZE((lbp)->lbp_prop);
+	ASSERT(asize <= sizeof (l2arc_log_blk_phys_t));
+
+	abd = abd_get_from_buf(lb, asize);
+	pio = zio_root(vd->vdev_spa, l2arc_log_blk_fetch_done, abd,
+	    ZIO_FLAG_DONT_CACHE | ZIO_FLAG_CANFAIL |
+	    ZIO_FLAG_DONT_PROPAGATE | ZIO_FLAG_DONT_RETRY);
+	(void) zio_nowait(zio_read_phys(pio, vd, lbp->lbp_daddr, asize, abd,
+	    ZIO_CHECKSUM_OFF, NULL, NULL, ZIO_PRIORITY_ASYNC_READ,
+	    ZIO_FLAG_DONT_CACHE | ZIO_FLAG_CANFAIL | ZIO_FLAG_DONT_RETRY,
+	    B_FALSE));
+
+	return (pio);
+}
+
+/*
+ * Releases the buffer wrapper of a completed log block fetch IO.
+ */
+static void
+l2arc_log_blk_fetch_done(zio_t *zio)
+{
+	abd_put(zio->io_private);
+}
+
+/*
+ * Waits for a log block fetch IO to complete, disregarding its result.
+ */
+static void
+l2arc_log_blk_fetch_abort(zio_t *zio)
+{
+	(void) zio_wait(zio);
+}
+
+/*
+ * Creates a zio to update the device header on an l2arc device.
+ */
+static void
+l2arc_dev_hdr_update(l2arc_dev_t *dev)
+{
+	l2arc_dev_hdr_phys_t	*l2dhdr = dev->l2ad_dev_hdr;
+	const uint64_t		l2dhdr_asize = dev->l2ad_dev_hdr_asize;
+	abd_t			*abd;
+	int			err;
+
+	if (dev->l2ad_log_entries == 0)
+		return;
+
+	l2dhdr->dh_magic = L2ARC_DEV_HDR_MAGIC;
+	l2dhdr->dh_version = L2ARC_PERSISTENT_VERSION;
+	l2dhdr->dh_spa_guid = spa_guid(dev->l2ad_vdev->vdev_spa);
+	l2dhdr->dh_vdev_guid = dev->l2ad_vdev->vdev_guid;
+	l2dhdr->dh_log_entries = dev->l2ad_log_entries;
+	l2dhdr->dh_evict = dev->l2ad_evict;
+	l2dhdr->dh_start = dev->l2ad_start;
+	l2dhdr->dh_end = dev->l2ad_end;
+	l2dhdr->dh_lb_asize = dev->l2ad_lb_asize;
+	l2dhdr->dh_lb_count = dev->l2ad_lb_count;
+	l2dhdr->dh_flags = 0;
+	if (dev->l2ad_first)
+		l2dhdr->dh_flags |= L2ARC_DEV_HDR_EVICT_FIRST;
+
+	fletcher_4_native(l2dhdr, offsetof(l2arc_dev_hdr_phys_t,
+	    dh_self_cksum), NULL, &l2dhdr->dh_self_cksum);
+
+	abd = abd_get_from_buf(l2dhdr, l2dhdr_asize);
+
+	err = zio_wait(zio_write_phys(NULL, dev->l2ad_vdev,
+	    VDEV_LABEL_START_SIZE, l2dhdr_asize, abd, ZIO_CHECKSUM_OFF, NULL,
+	    NULL, ZIO_PRIORITY_ASYNC_WRITE, ZIO_FLAG_CANFAIL, B_FALSE));
+
+	abd_put(abd);
+
+	if (err != 0) {
+		zfs_dbgmsg("L2ARC IO error (%d) while writing device header, "
+		    "vdev guid: %llu", err,
+		    (u_longlong_t)dev->l2ad_vdev->vdev_guid);
+	}
+}
+
+/*
+ * Commits a log block to the L2ARC device. This routine is invoked from
+ * l2arc_write_buffers when the log block fills up.
+ * This function allocates some memory to temporarily hold the serialized
+ * buffer to be written. This is then released in l2arc_write_done.
+ */
+static void
+l2arc_log_blk_commit(l2arc_dev_t *dev, zio_t *pio)
+{
+	l2arc_log_blk_phys_t	*lb = &dev->l2ad_log_blk;
+	l2arc_dev_hdr_phys_t	*l2dhdr = dev->l2ad_dev_hdr;
+	l2arc_log_blkptr_t	*lbp = &l2dhdr->dh_start_lbps[0];
+	uint64_t		psize, asize;
+	zio_t			*wzio;
+	l2arc_lb_ptr_buf_t	*lb_ptr_buf;
+	abd_t			*abd;
+	void			*tmpbuf;
+
+	VERIFY3S(dev->l2ad_log_ent_idx, ==, dev->l2ad_log_entries);
+
+	tmpbuf = zio_buf_alloc(sizeof (*lb));
+
+	lb->lb_magic = L2ARC_LOG_BLK_MAGIC;
+	lb->lb_prev_lbp = l2dhdr->dh_start_lbps[1];
+
+	/* try to compress the buffer */
+	abd = abd_get_from_buf(lb, sizeof (*lb));
+	psize = zio_compress_data(ZIO_COMPRESS_LZ4, abd, tmpbuf,
+	    sizeof (*lb));
+	abd_put(abd);
+
+	/* a log block is never entirely zero */
+	ASSERT(psize != 0);
+	asize = vdev_psize_to_asize(dev->l2ad_vdev, psize);
+
+	/*
+	 * Update the start log block pointer in the device header to point
+	 * to the log block we're about to write.
+	 */
+	l2dhdr->dh_start_lbps[1] = l2dhdr->dh_start_lbps[0];
+	bzero(lbp, sizeof (*lbp));
+	lbp->lbp_daddr = dev->l2ad_hand;
+	lbp->lbp_payload_asize = dev->l2ad_log_blk_payload_asize;
+	lbp->lbp_payload_start = dev->l2ad_log_blk_payload_start;
+
+	if (asize < vdev_psize_to_asize(dev->l2ad_vdev, sizeof (*lb))) {
+		/* compression succeeded */
+		bzero((char *)tmpbuf + psize, asize - psize);
+		L2BLK_SET_COMPRESS(lbp->lbp_prop, ZIO_COMPRESS_LZ4);
+	} else {
+		/* compression failed */
+		bcopy(lb, tmpbuf, sizeof (*lb));
+		asize = vdev_psize_to_asize(dev->l2ad_vdev, sizeof (*lb));
+		L2BLK_SET_COMPRESS(lbp->lbp_prop, ZIO_COMPRESS_OFF);
+	}
+	ASSERT3U(asize, <=, sizeof (*lb));
+	L2BLK_SET_LSIZE(lbp->lbp_prop, sizeof (*lb));
+	L2BLK_SET_PSIZE(lbp->lbp_prop, asize);
+	L2BLK_SET_CHECKSUM(lbp->lbp_prop, ZIO_CHECKSUM_FLETCHER_4);
+
+	/* checksum what we're about to write */
+	fletcher_4_native(tmpbuf, asize, NULL, &lbp->lbp_cksum);
+
+	abd = abd_alloc_for_io(asize, B_TRUE);
+	abd_copy_from_buf(abd, tmpbuf, asize);
+	zio_buf_free(tmpbuf, sizeof (*lb));
+
+	/* perform the write itself */
+	wzio = zio_write_phys(pio, dev->l2ad_vdev, dev->l2ad_hand,
+	    asize, abd, ZIO_CHECKSUM_OFF, NULL, NULL,
+	    ZIO_PRIORITY_ASYNC_WRITE, ZIO_FLAG_CANFAIL, B_FALSE);
+	DTRACE_PROBE2(l2arc__write, vdev_t *, dev->l2ad_vdev, zio_t *, wzio);
+	(void) zio_nowait(wzio);
+
+	dev->l2ad_hand += asize;
+
+	/*
+	 * Include the committed log block's pointer in the list of pointers
+	 * to log blocks present in the L2ARC device.
+	 */
+	lb_ptr_buf = kmem_alloc(sizeof (l2arc_lb_ptr_buf_t), KM_SLEEP);
+	lb_ptr_buf->lb_ptr = kmem_alloc(sizeof (l2arc_log_blkptr_t), KM_SLEEP);
+	bcopy(lbp, lb_ptr_buf->lb_ptr, sizeof (l2arc_log_blkptr_t));
+	mutex_enter(&dev->l2ad_mtx);
+	list_insert_head(&dev->l2ad_lbptr_list, lb_ptr_buf);
+	dev->l2ad_lb_asize += asize;
+	dev->l2ad_lb_count++;
+	mutex_exit(&dev->l2ad_mtx);
+	vdev_space_update(dev->l2ad_vdev, asize, 0, 0);
+
+	/* bump the kstats */
+	ARCSTAT_INCR(arcstat_l2_write_bytes, asize);
+	ARCSTAT_BUMP(arcstat_l2_log_blk_writes);
+	ARCSTAT_INCR(arcstat_l2_log_blk_asize, asize);
+	ARCSTAT_BUMP(arcstat_l2_log_blk_count);
+
+	/* start a new log block */
+	dev->l2ad_log_ent_idx = 0;
+	dev->l2ad_log_blk_payload_asize = 0;
+	dev->l2ad_log_blk_payload_start = 0;
+
+	/* the log block buffer is freed once the write completes */
+	l2arc_free_abd_on_write(abd, asize, ARC_BUFC_METADATA);
+}
+
+/*
+ * Validates an L2ARC log block address to make sure that it can be read
+ * from the provided L2ARC device.
+ */
+static boolean_t
+l2arc_log_blkptr_valid(l2arc_dev_t *dev, const l2arc_log_blkptr_t *lbp)
+{
+	/* L2BLK_GET_PSIZE returns aligned size for log blocks */
+	uint64_t asize = L2BLK_GET_PSIZE((lbp)->lbp_prop);
+	uint64_t end = lbp->lbp_daddr + asize - 1;
+	uint64_t start = lbp->lbp_payload_start;
+	boolean_t evicted = B_FALSE;
+
+	/*
+	 * A log block is valid if all of the following conditions are true:
+	 * - it fits entirely (including its payload) between l2ad_start and
+	 *   l2ad_end
+	 * - it has a valid size
+	 * - neither the log block itself nor part of its payload was evicted
+	 *   by l2arc_evict():
+	 *
+	 *		l2ad_hand          l2ad_evict
+	 *		|			 |	lbp_daddr
+	 *		|     start		 |	|  end
+	 *		|     |			 |	|  |
+	 *		V     V		         V	V  V
+	 *   l2ad_start ============================================ l2ad_end
+	 *                    --------------------------||||
+	 *				^		 ^
+	 *				|		log block
+	 *				payload
+	 */
+
+	evicted =
+	    l2arc_range_check_overlap(start, end, dev->l2ad_hand) ||
+	    l2arc_range_check_overlap(start, end, dev->l2ad_evict) ||
+	    l2arc_range_check_overlap(dev->l2ad_hand, dev->l2ad_evict, start) ||
+	    l2arc_range_check_overlap(dev->l2ad_hand, dev->l2ad_evict, end);
+
+	return (start >= dev->l2ad_start && end <= dev->l2ad_end &&
+	    lbp->lbp_daddr >= dev->l2ad_start && asize > 0 &&
+	    asize <= sizeof (l2arc_log_blk_phys_t) &&
+	    (!evicted || dev->l2ad_first));
+}
+
+/*
+ * Inserts ARC buffer header `hdr' into the current L2ARC log block on
+ * the device. The buffer being inserted must be present in L2ARC.
+ * Returns B_TRUE if the L2ARC log block is full and needs to be committed
+ * to L2ARC, or B_FALSE if it still has room for more ARC buffers.
+ */
+static boolean_t
+l2arc_log_blk_insert(l2arc_dev_t *dev, const arc_buf_hdr_t *hdr)
+{
+	l2arc_log_blk_phys_t	*lb = &dev->l2ad_log_blk;
+	l2arc_log_ent_phys_t	*le;
+
+	if (dev->l2ad_log_entries == 0)
+		return (B_FALSE);
+
+	int index = dev->l2ad_log_ent_idx++;
+
+	ASSERT3S(index, <, dev->l2ad_log_entries);
+	ASSERT(HDR_HAS_L2HDR(hdr));
+
+	le = &lb->lb_entries[index];
+	bzero(le, sizeof (*le));
+	le->le_dva = hdr->b_dva;
+	le->le_birth = hdr->b_birth;
+	le->le_daddr = hdr->b_l2hdr.b_daddr;
+	if (index == 0)
+		dev->l2ad_log_blk_payload_start = le->le_daddr;
+	L2BLK_SET_LSIZE((le)->le_prop, HDR_GET_LSIZE(hdr));
+	L2BLK_SET_PSIZE((le)->le_prop, HDR_GET_PSIZE(hdr));
+	L2BLK_SET_COMPRESS((le)->le_prop, HDR_GET_COMPRESS(hdr));
+	L2BLK_SET_TYPE((le)->le_prop, hdr->b_type);
+	L2BLK_SET_PROTECTED((le)->le_prop, !!(HDR_PROTECTED(hdr)));
+	L2BLK_SET_PREFETCH((le)->le_prop, !!(HDR_PREFETCH(hdr)));
+
+	dev->l2ad_log_blk_payload_asize += vdev_psize_to_asize(dev->l2ad_vdev,
+	    HDR_GET_PSIZE(hdr));
+
+	return (dev->l2ad_log_ent_idx == dev->l2ad_log_entries);
+}
+
+/*
+ * Calculates the maximum overhead of L2ARC metadata log blocks for a given
+ * L2ARC write size. l2arc_evict and l2arc_write_buffers need to include this
+ * overhead in processing to make sure there is enough headroom available
+ * when writing buffers.
+ */
+static uint64_t
+l2arc_log_blk_overhead(uint64_t write_sz, l2arc_dev_t *dev)
+{
+	if (dev->l2ad_log_entries == 0) {
+		return (0);
+	} else {
+		uint64_t log_entries = write_sz >> SPA_MINBLOCKSHIFT;
+
+		uint64_t log_blocks = (log_entries +
+		    dev->l2ad_log_entries - 1) /
+		    dev->l2ad_log_entries;
+
+		return (vdev_psize_to_asize(dev->l2ad_vdev,
+		    sizeof (l2arc_log_blk_phys_t)) * log_blocks);
+	}
+}
+
 #if defined(_KERNEL)
 EXPORT_SYMBOL(arc_buf_size);
 EXPORT_SYMBOL(arc_write);
@@ -9352,6 +11171,14 @@ MODULE_PARM_DESC(l2arc_feed_again, "Turbo L2ARC warmup");
 module_param(l2arc_norw, int, 0644);
 MODULE_PARM_DESC(l2arc_norw, "No reads during writes");
 
+module_param(l2arc_rebuild_enabled, int, 0644);
+MODULE_PARM_DESC(l2arc_rebuild_enabled,
+	"Rebuild the L2ARC when importing a pool");
+
+module_param(l2arc_rebuild_blocks_min_l2size, ulong, 0644);
+MODULE_PARM_DESC(l2arc_rebuild_blocks_min_l2size,
+	"Min size in bytes to write rebuild log blocks in L2ARC");
+
 module_param(zfs_arc_lotsfree_percent, int, 0644);
 MODULE_PARM_DESC(zfs_arc_lotsfree_percent,
 	"System free memory I/O throttle in bytes");
@@ -9369,5 +11196,13 @@ MODULE_PARM_DESC(zfs_arc_dnode_limit_percent,
 module_param(zfs_arc_dnode_reduce_percent, ulong, 0644);
 MODULE_PARM_DESC(zfs_arc_dnode_reduce_percent,
 	"Percentage of excess dnodes to try to unpin");
+
+module_param(zfs_arc_reserve_percent, int, 0644);
+MODULE_PARM_DESC(zfs_arc_reserve_percent,
+	"Percent of ARC that per-dataset arc_reserve may protect");
+
+module_param(zfs_arc_numa_balance, int, 0644);
+MODULE_PARM_DESC(zfs_arc_numa_balance,
+	"Evict first from the NUMA node holding the most ARC data");
 /* END CSTYLED */
 #endif
@@ -0,0 +1,99 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+#include <sys/zfs_context.h>
+#include <sys/zio.h>
+#include <sys/blake3.h>
+
+#include <sys/abd.h>
+
+static int
+blake3_incremental(void *buf, size_t size, void *arg)
+{
+	BLAKE3_CTX *ctx = arg;
+	Blake3_Update(ctx, buf, size);
+	return (0);
+}
+
+/*
+ * Computes a native 256-bit BLAKE3 keyed hash, using the pool's checksum
+ * salt as the key.  Please note that this function requires the presence
+ * of a ctx_template that should be allocated using
+ * abd_checksum_blake3_tmpl_init.  The hash context itself is several
+ * kilobytes, which is too much for the stack.
+ */
+/*ARGSUSED*/
+void
+abd_checksum_blake3_native(abd_t *abd, uint64_t size,
+    const void *ctx_template, zio_cksum_t *zcp)
+{
+	BLAKE3_CTX	*ctx;
+
+	ASSERT(ctx_template != NULL);
+	ctx = kmem_alloc(sizeof (*ctx), KM_SLEEP);
+	Blake3_InitKeyed(ctx, ctx_template);
+	(void) abd_iterate_func(abd, 0, size, blake3_incremental, ctx);
+	Blake3_Final(ctx, (uint8_t *)zcp);
+	kmem_free(ctx, sizeof (*ctx));
+}
+
+/*
+ * Byteswapped version of abd_checksum_blake3_native. This just invokes
+ * the native checksum function and byteswaps the resulting checksum (since
+ * BLAKE3 is internally endian-insensitive).
+ */
+void
+abd_checksum_blake3_byteswap(abd_t *abd, uint64_t size,
+    const void *ctx_template, zio_cksum_t *zcp)
+{
+	zio_cksum_t	tmp;
+
+	abd_checksum_blake3_native(abd, size, ctx_template, &tmp);
+	zcp->zc_word[0] = BSWAP_64(tmp.zc_word[0]);
+	zcp->zc_word[1] = BSWAP_64(tmp.zc_word[1]);
+	zcp->zc_word[2] = BSWAP_64(tmp.zc_word[2]);
+	zcp->zc_word[3] = BSWAP_64(tmp.zc_word[3]);
+}
+
+/*
+ * Allocates a BLAKE3 template, which is just a copy of the key, and
+ * returns a pointer to it.
+ */
+void *
+abd_checksum_blake3_tmpl_init(const zio_cksum_salt_t *salt)
+{
+	uint8_t	*key;
+
+	CTASSERT(sizeof (salt->zcs_bytes) == BLAKE3_KEY_LEN);
+	key = kmem_alloc(BLAKE3_KEY_LEN, KM_SLEEP);
+	bcopy(salt->zcs_bytes, key, BLAKE3_KEY_LEN);
+	return (key);
+}
+
+/*
+ * Frees a BLAKE3 template previously allocated using
+ * abd_checksum_blake3_tmpl_init.
+ */
+void
+abd_checksum_blake3_tmpl_free(void *ctx_template)
+{
+	bzero(ctx_template, BLAKE3_KEY_LEN);
+	kmem_free(ctx_template, BLAKE3_KEY_LEN);
+}
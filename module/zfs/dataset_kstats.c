@@ -34,8 +34,83 @@ static dataset_kstat_values_t empty_dataset_kstats = {
 	{ "nwritten",	KSTAT_DATA_UINT64 },
 	{ "reads",	KSTAT_DATA_UINT64 },
 	{ "nread",	KSTAT_DATA_UINT64 },
+	{ "compress_aborts",	KSTAT_DATA_UINT64 },
+	{ "compress_abort_bytes",	KSTAT_DATA_UINT64 },
+	{ "compress_abort_ns",	KSTAT_DATA_UINT64 },
+	{ "queue_issued",	KSTAT_DATA_UINT64 },
+	{ "queue_issued_bytes",	KSTAT_DATA_UINT64 },
+	{ "queue_wait_ns",	KSTAT_DATA_UINT64 },
+	{ "arc_size",	KSTAT_DATA_UINT64 },
+	{ "read_throttle_ns",	KSTAT_DATA_UINT64 },
+	{
+		{ "read_throttle_100us",	KSTAT_DATA_UINT64 },
+		{ "read_throttle_1ms",	KSTAT_DATA_UINT64 },
+		{ "read_throttle_10ms",	KSTAT_DATA_UINT64 },
+		{ "read_throttle_100ms",	KSTAT_DATA_UINT64 },
+		{ "read_throttle_1s",	KSTAT_DATA_UINT64 },
+		{ "read_throttle_long",	KSTAT_DATA_UINT64 },
+	},
+	{ "write_throttle_ns",	KSTAT_DATA_UINT64 },
+	{
+		{ "write_throttle_100us",	KSTAT_DATA_UINT64 },
+		{ "write_throttle_1ms",	KSTAT_DATA_UINT64 },
+		{ "write_throttle_10ms",	KSTAT_DATA_UINT64 },
+		{ "write_throttle_100ms",	KSTAT_DATA_UINT64 },
+		{ "write_throttle_1s",	KSTAT_DATA_UINT64 },
+		{ "write_throttle_long",	KSTAT_DATA_UINT64 },
+	},
+	{ "zil_commits",	KSTAT_DATA_UINT64 },
+	{ "zil_commit_itxs",	KSTAT_DATA_UINT64 },
+	{ "zil_commit_bytes",	KSTAT_DATA_UINT64 },
+	{
+		{ "zil_commit_ns",	KSTAT_DATA_UINT64 },
+		{ "zil_commit_gather_ns",	KSTAT_DATA_UINT64 },
+		{ "zil_commit_issue_ns",	KSTAT_DATA_UINT64 },
+		{ "zil_commit_wait_ns",	KSTAT_DATA_UINT64 },
+		{ "zil_commit_flush_ns",	KSTAT_DATA_UINT64 },
+	},
+	{
+		{ "zil_commit_100us",	KSTAT_DATA_UINT64 },
+		{ "zil_commit_1ms",	KSTAT_DATA_UINT64 },
+		{ "zil_commit_10ms",	KSTAT_DATA_UINT64 },
+		{ "zil_commit_100ms",	KSTAT_DATA_UINT64 },
+		{ "zil_commit_1s",	KSTAT_DATA_UINT64 },
+		{ "zil_commit_long",	KSTAT_DATA_UINT64 },
+	},
 };
 
+static avl_tree_t dataset_kstats_tree;
+static krwlock_t dataset_kstats_lock;
+
+static int
+dataset_kstats_compare(const void *x1, const void *x2)
+{
+	const dataset_kstats_t *dk1 = x1;
+	const dataset_kstats_t *dk2 = x2;
+
+	int cmp = AVL_CMP((uintptr_t)dk1->dk_spa, (uintptr_t)dk2->dk_spa);
+	if (likely(cmp))
+		return (cmp);
+
+	return (AVL_CMP(dk1->dk_objset_id, dk2->dk_objset_id));
+}
+
+void
+dataset_kstats_init(void)
+{
+	avl_create(&dataset_kstats_tree, dataset_kstats_compare,
+	    sizeof (dataset_kstats_t), offsetof(dataset_kstats_t, dk_node));
+	rw_init(&dataset_kstats_lock, NULL, RW_DEFAULT, NULL);
+}
+
+void
+dataset_kstats_fini(void)
+{
+	ASSERT(avl_is_empty(&dataset_kstats_tree));
+	avl_destroy(&dataset_kstats_tree);
+	rw_destroy(&dataset_kstats_lock);
+}
+
 static int
 dataset_kstats_update(kstat_t *ksp, int rw)
 {
@@ -54,6 +129,38 @@ dataset_kstats_update(kstat_t *ksp, int rw)
 	    aggsum_value(&dk->dk_aggsums.das_reads);
 	dkv->dkv_nread.value.ui64 =
 	    aggsum_value(&dk->dk_aggsums.das_nread);
+	dkv->dkv_compress_aborts.value.ui64 =
+	    aggsum_value(&dk->dk_aggsums.das_compress_aborts);
+	dkv->dkv_compress_abort_bytes.value.ui64 =
+	    aggsum_value(&dk->dk_aggsums.das_compress_abort_bytes);
+	dkv->dkv_compress_abort_ns.value.ui64 =
+	    aggsum_value(&dk->dk_aggsums.das_compress_abort_ns);
+	dkv->dkv_queue_issued.value.ui64 =
+	    aggsum_value(&dk->dk_aggsums.das_queue_issued);
+	dkv->dkv_queue_issued_bytes.value.ui64 =
+	    aggsum_value(&dk->dk_aggsums.das_queue_issued_bytes);
+	dkv->dkv_queue_wait_ns.value.ui64 =
+	    aggsum_value(&dk->dk_aggsums.das_queue_wait_ns);
+	dkv->dkv_arc_size.value.ui64 = arc_tenant_size(dk->dk_arc_tenant);
+	dkv->dkv_read_throttle_ns.value.ui64 = dk->dk_throttle_ns[B_FALSE];
+	dkv->dkv_write_throttle_ns.value.ui64 = dk->dk_throttle_ns[B_TRUE];
+	dkv->dkv_zil_commits.value.ui64 =
+	    aggsum_value(&dk->dk_aggsums.das_zil_commits);
+	dkv->dkv_zil_commit_itxs.value.ui64 =
+	    aggsum_value(&dk->dk_aggsums.das_zil_commit_itxs);
+	dkv->dkv_zil_commit_bytes.value.ui64 =
+	    aggsum_value(&dk->dk_aggsums.das_zil_commit_bytes);
+	for (int s = 0; s < ZIL_COMMIT_STAGES; s++) {
+		dkv->dkv_zil_commit_ns[s].value.ui64 =
+		    aggsum_value(&dk->dk_aggsums.das_zil_commit_ns[s]);
+	}
+	for (int b = 0; b < DATASET_LATENCY_BUCKETS; b++) {
+		dkv->dkv_read_throttle[b].value.ui64 =
+		    dk->dk_throttle[B_FALSE][b];
+		dkv->dkv_write_throttle[b].value.ui64 =
+		    dk->dk_throttle[B_TRUE][b];
+		dkv->dkv_zil_commit[b].value.ui64 = dk->dk_zil_commit[b];
+	}
 
 	return (0);
 }
@@ -125,6 +232,10 @@ dataset_kstats_create(dataset_kstats_t *dk, objset_t *objset)
 	KSTAT_NAMED_STR_BUFLEN(&dk_kstats->dkv_ds_name) =
 	    ZFS_MAX_DATASET_NAME_LEN;
 
+	/* bytes this dataset currently holds in the ARC */
+	dk->dk_arc_tenant = arc_tenant_hold(dmu_objset_spa(objset),
+	    dmu_objset_id(objset));
+
 	kstat->ks_data = dk_kstats;
 	kstat->ks_update = dataset_kstats_update;
 	kstat->ks_private = dk;
@@ -136,6 +247,36 @@ dataset_kstats_create(dataset_kstats_t *dk, objset_t *objset)
 	aggsum_init(&dk->dk_aggsums.das_nwritten, 0);
 	aggsum_init(&dk->dk_aggsums.das_reads, 0);
 	aggsum_init(&dk->dk_aggsums.das_nread, 0);
+	aggsum_init(&dk->dk_aggsums.das_compress_aborts, 0);
+	aggsum_init(&dk->dk_aggsums.das_compress_abort_bytes, 0);
+	aggsum_init(&dk->dk_aggsums.das_compress_abort_ns, 0);
+	aggsum_init(&dk->dk_aggsums.das_queue_issued, 0);
+	aggsum_init(&dk->dk_aggsums.das_queue_issued_bytes, 0);
+	aggsum_init(&dk->dk_aggsums.das_queue_wait_ns, 0);
+	aggsum_init(&dk->dk_aggsums.das_zil_commits, 0);
+	aggsum_init(&dk->dk_aggsums.das_zil_commit_itxs, 0);
+	aggsum_init(&dk->dk_aggsums.das_zil_commit_bytes, 0);
+	for (int s = 0; s < ZIL_COMMIT_STAGES; s++)
+		aggsum_init(&dk->dk_aggsums.das_zil_commit_ns[s], 0);
+	bzero(dk->dk_throttle_ns, sizeof (dk->dk_throttle_ns));
+	bzero(dk->dk_throttle, sizeof (dk->dk_throttle));
+	bzero(dk->dk_zil_commit, sizeof (dk->dk_zil_commit));
+
+	/*
+	 * Should two kstats ever exist for the same objset, the writes are
+	 * only counted against the first.
+	 */
+	dk->dk_spa = dmu_objset_spa(objset);
+	dk->dk_objset_id = dmu_objset_id(objset);
+	dk->dk_holds = 0;
+	mutex_init(&dk->dk_hold_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&dk->dk_hold_cv, NULL, CV_DEFAULT, NULL);
+	rw_enter(&dataset_kstats_lock, RW_WRITER);
+	if (avl_find(&dataset_kstats_tree, dk, NULL) == NULL) {
+		avl_add(&dataset_kstats_tree, dk);
+		dk->dk_registered = B_TRUE;
+	}
+	rw_exit(&dataset_kstats_lock);
 }
 
 void
@@ -144,6 +285,21 @@ dataset_kstats_destroy(dataset_kstats_t *dk)
 	if (dk->dk_kstats == NULL)
 		return;
 
+	if (dk->dk_registered) {
+		rw_enter(&dataset_kstats_lock, RW_WRITER);
+		avl_remove(&dataset_kstats_tree, dk);
+		rw_exit(&dataset_kstats_lock);
+		dk->dk_registered = B_FALSE;
+	}
+
+	/* Wait for the vdev queue flows which still hold the kstats. */
+	mutex_enter(&dk->dk_hold_lock);
+	while (dk->dk_holds != 0)
+		cv_wait(&dk->dk_hold_cv, &dk->dk_hold_lock);
+	mutex_exit(&dk->dk_hold_lock);
+	mutex_destroy(&dk->dk_hold_lock);
+	cv_destroy(&dk->dk_hold_cv);
+
 	dataset_kstat_values_t *dkv = dk->dk_kstats->ks_data;
 	kmem_free(KSTAT_NAMED_STR_PTR(&dkv->dkv_ds_name),
 	    KSTAT_NAMED_STR_BUFLEN(&dkv->dkv_ds_name));
@@ -152,10 +308,69 @@ dataset_kstats_destroy(dataset_kstats_t *dk)
 	kstat_delete(dk->dk_kstats);
 	dk->dk_kstats = NULL;
 
+	arc_tenant_rele(dk->dk_arc_tenant);
+	dk->dk_arc_tenant = NULL;
+
 	aggsum_fini(&dk->dk_aggsums.das_writes);
 	aggsum_fini(&dk->dk_aggsums.das_nwritten);
 	aggsum_fini(&dk->dk_aggsums.das_reads);
 	aggsum_fini(&dk->dk_aggsums.das_nread);
+	aggsum_fini(&dk->dk_aggsums.das_compress_aborts);
+	aggsum_fini(&dk->dk_aggsums.das_compress_abort_bytes);
+	aggsum_fini(&dk->dk_aggsums.das_compress_abort_ns);
+	aggsum_fini(&dk->dk_aggsums.das_queue_issued);
+	aggsum_fini(&dk->dk_aggsums.das_queue_issued_bytes);
+	aggsum_fini(&dk->dk_aggsums.das_queue_wait_ns);
+	aggsum_fini(&dk->dk_aggsums.das_zil_commits);
+	aggsum_fini(&dk->dk_aggsums.das_zil_commit_itxs);
+	aggsum_fini(&dk->dk_aggsums.das_zil_commit_bytes);
+	for (int s = 0; s < ZIL_COMMIT_STAGES; s++)
+		aggsum_fini(&dk->dk_aggsums.das_zil_commit_ns[s]);
+}
+
+/*
+ * While its owner has the objset open, the owner's kstats are reachable as
+ * os_kstats, through which the ZIL and the zio pipeline update them
+ * directly.  The owner attaches them once it owns the objset (again after
+ * every reopen, as it may then own another objset_t), and detaches them
+ * before it disowns it.
+ */
+void
+dataset_kstats_attach(dataset_kstats_t *dk, objset_t *os)
+{
+	if (dk->dk_kstats == NULL)
+		return;
+
+	ASSERT3P(os->os_kstats, ==, NULL);
+	os->os_kstats = dk;
+}
+
+void
+dataset_kstats_detach(dataset_kstats_t *dk, objset_t *os)
+{
+	if (os->os_kstats != dk)
+		return;
+
+	os->os_kstats = NULL;
+
+	/*
+	 * Blocks of the objset may still be on their way through the zio
+	 * pipeline, in the txg being synced or in one not yet synced, and
+	 * may have picked up the kstats before they were detached.  Wait
+	 * for those txgs, so the kstats can be destroyed once this returns.
+	 */
+	spa_t *spa = dmu_objset_spa(os);
+	if (!spa_writeable(spa))
+		return;
+
+	boolean_t dirty = B_FALSE;
+	for (int t = 0; t < TXG_SIZE; t++)
+		dirty |= dmu_objset_is_dirty(os, t);
+
+	if (dirty)
+		txg_wait_synced(dmu_objset_pool(os), 0);
+	else if (spa_syncing_txg(spa) != 0)
+		txg_wait_synced(dmu_objset_pool(os), spa_syncing_txg(spa));
 }
 
 void
@@ -183,3 +398,132 @@ dataset_kstats_update_read_kstats(dataset_kstats_t *dk,
 	aggsum_add(&dk->dk_aggsums.das_reads, 1);
 	aggsum_add(&dk->dk_aggsums.das_nread, nread);
 }
+
+/*
+ * Return the DATASET_LATENCY_BUCKETS bucket which counts the given latency.
+ */
+static int
+dataset_kstats_latency_bucket(hrtime_t latency)
+{
+	hrtime_t limit = USEC2NSEC(100);
+	int b;
+
+	for (b = 0; b < DATASET_LATENCY_BUCKETS - 1; b++) {
+		if (latency <= limit)
+			break;
+		limit *= 10;
+	}
+
+	return (b);
+}
+
+/*
+ * Account for a read or write which was delayed by the dataset's
+ * readlimit/writelimit/iopslimit.
+ */
+void
+dataset_kstats_update_throttle_kstats(dataset_kstats_t *dk, boolean_t write,
+    hrtime_t waited)
+{
+	int b;
+
+	ASSERT3S(waited, >=, 0);
+
+	if (dk->dk_kstats == NULL || waited == 0)
+		return;
+
+	b = dataset_kstats_latency_bucket(waited);
+	atomic_add_64(&dk->dk_throttle_ns[write], waited);
+	atomic_inc_64(&dk->dk_throttle[write][b]);
+}
+
+/*
+ * Called from the zio pipeline when a block was written uncompressed
+ * because it looked incompressible to the early abort probe.  The kstats
+ * are those attached to the objset when its write policy was chosen, see
+ * dmu_write_policy().
+ */
+void
+dataset_kstats_update_compress_kstats(dataset_kstats_t *dk, uint64_t nbytes,
+    hrtime_t saved)
+{
+	ASSERT3S(saved, >=, 0);
+
+	if (dk->dk_kstats == NULL)
+		return;
+
+	aggsum_add(&dk->dk_aggsums.das_compress_aborts, 1);
+	aggsum_add(&dk->dk_aggsums.das_compress_abort_bytes, nbytes);
+	aggsum_add(&dk->dk_aggsums.das_compress_abort_ns, saved);
+}
+
+/*
+ * Look up and hold the kstats of an objset, for a vdev queue flow to keep
+ * while it has i/os queued.  Returns NULL if the objset has no kstats.
+ * dataset_kstats_destroy() waits for the holds to be released.
+ */
+dataset_kstats_t *
+dataset_kstats_hold(spa_t *spa, uint64_t objset_id)
+{
+	dataset_kstats_t search, *dk;
+
+	search.dk_spa = spa;
+	search.dk_objset_id = objset_id;
+
+	rw_enter(&dataset_kstats_lock, RW_READER);
+	dk = avl_find(&dataset_kstats_tree, &search, NULL);
+	if (dk != NULL)
+		atomic_inc_64(&dk->dk_holds);
+	rw_exit(&dataset_kstats_lock);
+
+	return (dk);
+}
+
+void
+dataset_kstats_rele(dataset_kstats_t *dk)
+{
+	if (atomic_dec_64_nv(&dk->dk_holds) == 0) {
+		mutex_enter(&dk->dk_hold_lock);
+		cv_broadcast(&dk->dk_hold_cv);
+		mutex_exit(&dk->dk_hold_lock);
+	}
+}
+
+/*
+ * Called by the vdev queue as it issues an i/o of the objset to a leaf
+ * vdev, while fair queueing is enabled, with the kstats held by its flow.
+ */
+void
+dataset_kstats_update_queue_kstats(dataset_kstats_t *dk, uint64_t nbytes,
+    hrtime_t waited)
+{
+	ASSERT3S(waited, >=, 0);
+
+	aggsum_add(&dk->dk_aggsums.das_queue_issued, 1);
+	aggsum_add(&dk->dk_aggsums.das_queue_issued_bytes, nbytes);
+	aggsum_add(&dk->dk_aggsums.das_queue_wait_ns, waited);
+}
+
+/*
+ * Called by zil_commit() once the commit is on stable storage, with the
+ * number and size of the itxs written out by the commit and the time spent
+ * in each stage of it (see zil_commit_stage_t).
+ */
+void
+dataset_kstats_update_zil_kstats(dataset_kstats_t *dk, uint64_t nitxs,
+    uint64_t nbytes, const hrtime_t *times)
+{
+	int b;
+
+	if (dk->dk_kstats == NULL)
+		return;
+
+	aggsum_add(&dk->dk_aggsums.das_zil_commits, 1);
+	aggsum_add(&dk->dk_aggsums.das_zil_commit_itxs, nitxs);
+	aggsum_add(&dk->dk_aggsums.das_zil_commit_bytes, nbytes);
+	for (int s = 0; s < ZIL_COMMIT_STAGES; s++)
+		aggsum_add(&dk->dk_aggsums.das_zil_commit_ns[s], times[s]);
+
+	b = dataset_kstats_latency_bucket(times[ZIL_COMMIT_TOTAL]);
+	atomic_inc_64(&dk->dk_zil_commit[b]);
+}
@@ -1390,6 +1390,8 @@ dbuf_read_impl(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
 
 	if (DBUF_IS_L2CACHEABLE(db))
 		aflags |= ARC_FLAG_L2CACHE;
+	if (DBUF_IS_SCAN_CACHED(db))
+		aflags |= ARC_FLAG_SCAN;
 
 	dbuf_add_ref(db, NULL);
 
@@ -1482,6 +1484,110 @@ dbuf_fix_old_data(dmu_buf_impl_t *db, uint64_t txg)
 	}
 }
 
+/*
+ * Give a DB_NOFILL dbuf written by dmu_write_direct() the data in buf.
+ * If the dirty record hasn't started syncing yet it takes the data as
+ * well, so that it is in the same state as a buffer which was filled and
+ * then written by dmu_sync().
+ */
+static void
+dbuf_direct_set_data(dmu_buf_impl_t *db, dbuf_dirty_record_t *dr,
+    arc_buf_t *buf)
+{
+	ASSERT(MUTEX_HELD(&db->db_mtx));
+	ASSERT3U(db->db_state, ==, DB_NOFILL);
+	ASSERT3P(db->db_buf, ==, NULL);
+	ASSERT3P(dr->dt.dl.dr_data, ==, NULL);
+
+	dbuf_set_data(db, buf);
+	db->db_state = DB_CACHED;
+	if (db->db_data_pending != dr)
+		dr->dt.dl.dr_data = buf;
+	cv_broadcast(&db->db_changed);
+}
+
+/*
+ * A DB_NOFILL dbuf can only be read if it was written by
+ * dmu_write_direct(), in which case its contents are read back from the
+ * block which was written, or if it has since been synced and it is no
+ * longer dirty, in which case it is read as usual.  Returns 0 once the
+ * dbuf has left the DB_NOFILL state.
+ */
+static int
+dbuf_read_nofill(dmu_buf_impl_t *db)
+{
+	spa_t *spa = db->db_objset->os_spa;
+	dbuf_dirty_record_t *dr;
+	zbookmark_phys_t zb;
+	arc_buf_t *buf;
+	blkptr_t bp;
+	int err;
+
+	SET_BOOKMARK(&zb, dmu_objset_id(db->db_objset),
+	    db->db.db_object, db->db_level, db->db_blkid);
+
+	for (;;) {
+		mutex_enter(&db->db_mtx);
+		while (db->db_state == DB_NOFILL &&
+		    (dr = db->db_last_dirty) != NULL &&
+		    dr->dt.dl.dr_override_state == DR_IN_DMU_SYNC)
+			cv_wait(&db->db_changed, &db->db_mtx);
+
+		if (db->db_state != DB_NOFILL) {
+			mutex_exit(&db->db_mtx);
+			return (0);
+		}
+
+		dr = db->db_last_dirty;
+		if (dr == NULL) {
+			db->db_state = DB_UNCACHED;
+			mutex_exit(&db->db_mtx);
+			return (0);
+		}
+
+		if (!dr->dt.dl.dr_direct ||
+		    dr->dt.dl.dr_override_state != DR_OVERRIDDEN) {
+			mutex_exit(&db->db_mtx);
+			return (SET_ERROR(EIO));
+		}
+		bp = dr->dt.dl.dr_overridden_by;
+		mutex_exit(&db->db_mtx);
+
+		buf = arc_alloc_buf(spa, db, DBUF_GET_BUFC_TYPE(db),
+		    db->db.db_size);
+		if (BP_IS_HOLE(&bp)) {
+			bzero(buf->b_data, db->db.db_size);
+		} else {
+			abd_t *abd = abd_get_from_buf(buf->b_data,
+			    db->db.db_size);
+
+			err = zio_wait(zio_read(NULL, spa, &bp, abd,
+			    db->db.db_size, NULL, NULL, ZIO_PRIORITY_SYNC_READ,
+			    ZIO_FLAG_CANFAIL, &zb));
+			abd_put(abd);
+			if (err != 0) {
+				arc_buf_destroy(buf, db);
+				return (err);
+			}
+		}
+
+		/*
+		 * Another reader may have beaten us to it, or the block may
+		 * have been written again while the db_mtx was dropped.
+		 */
+		mutex_enter(&db->db_mtx);
+		if (db->db_state == DB_NOFILL && db->db_last_dirty == dr &&
+		    dr->dt.dl.dr_override_state == DR_OVERRIDDEN &&
+		    BP_EQUAL(&bp, &dr->dt.dl.dr_overridden_by)) {
+			dbuf_direct_set_data(db, dr, buf);
+			buf = NULL;
+		}
+		mutex_exit(&db->db_mtx);
+		if (buf != NULL)
+			arc_buf_destroy(buf, db);
+	}
+}
+
 int
 dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
 {
@@ -1495,8 +1601,11 @@ dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
 	 */
 	ASSERT(!zfs_refcount_is_zero(&db->db_holds));
 
-	if (db->db_state == DB_NOFILL)
-		return (SET_ERROR(EIO));
+	if (db->db_state == DB_NOFILL) {
+		err = dbuf_read_nofill(db);
+		if (err != 0)
+			return (err);
+	}
 
 	DB_DNODE_ENTER(db);
 	dn = DB_DNODE(db);
@@ -1657,6 +1766,7 @@ dbuf_unoverride(dbuf_dirty_record_t *dr)
 	dr->dt.dl.dr_override_state = DR_NOT_OVERRIDDEN;
 	dr->dt.dl.dr_nopwrite = B_FALSE;
 	dr->dt.dl.dr_has_raw_params = B_FALSE;
+	dr->dt.dl.dr_direct = B_FALSE;
 
 	/*
 	 * Release the already-written buffer, so we leave it in
@@ -1664,9 +1774,11 @@ dbuf_unoverride(dbuf_dirty_record_t *dr)
 	 * modifying the buffer, so they will immediately do
 	 * another (redundant) arc_release().  Therefore, leave
 	 * the buf thawed to save the effort of freezing &
-	 * immediately re-thawing it.
+	 * immediately re-thawing it.  A buffer written directly
+	 * may have no data to release.
 	 */
-	arc_release(dr->dt.dl.dr_data, db);
+	if (dr->dt.dl.dr_data != NULL)
+		arc_release(dr->dt.dl.dr_data, db);
 }
 
 /*
@@ -1715,6 +1827,18 @@ dbuf_free_range(dnode_t *dn, uint64_t start_blkid, uint64_t end_blkid,
 			continue;
 		}
 
+		if (db->db_state == DB_NOFILL && db->db_last_dirty != NULL &&
+		    db->db_last_dirty->dt.dl.dr_direct) {
+			/*
+			 * The block was written by dmu_write_direct() in an
+			 * earlier txg, so give the dbuf a buffer to be
+			 * cleared below like that of any other dirty dbuf.
+			 */
+			dbuf_set_data(db, arc_alloc_buf(dn->dn_objset->os_spa,
+			    db, DBUF_GET_BUFC_TYPE(db), db->db.db_size));
+			db->db_state = DB_CACHED;
+		}
+
 		if (db->db_state == DB_UNCACHED ||
 		    db->db_state == DB_NOFILL ||
 		    db->db_state == DB_EVICTING) {
@@ -1858,6 +1982,12 @@ dbuf_redirty(dbuf_dirty_record_t *dr)
 		dbuf_unoverride(dr);
 		if (db->db.db_object != DMU_META_DNODE_OBJECT &&
 		    db->db_state != DB_NOFILL) {
+			/*
+			 * A buffer which was written directly is being
+			 * filled, so it now has data for this txg.
+			 */
+			if (dr->dt.dl.dr_data == NULL)
+				dr->dt.dl.dr_data = db->db_buf;
 			/* Already released on initial dirty, so just thaw. */
 			ASSERT(arc_released(db->db_buf));
 			arc_buf_thaw(db->db_buf);
@@ -2238,6 +2368,9 @@ dbuf_undirty(dmu_buf_impl_t *db, dmu_tx_t *tx)
 		ASSERT(dr->dt.dl.dr_data != NULL);
 		if (dr->dt.dl.dr_data != db->db_buf)
 			arc_buf_destroy(dr->dt.dl.dr_data, db);
+	} else if (dr->dt.dl.dr_direct) {
+		/* Free the block written by dmu_write_direct(). */
+		dbuf_unoverride(dr);
 	}
 
 	kmem_free(dr, sizeof (dbuf_dirty_record_t));
@@ -2302,18 +2435,8 @@ dmu_buf_will_dirty(dmu_buf_t *db_fake, dmu_tx_t *tx)
 	    DB_RF_MUST_SUCCEED | DB_RF_NOPREFETCH, tx);
 }
 
-void
-dmu_buf_will_not_fill(dmu_buf_t *db_fake, dmu_tx_t *tx)
-{
-	dmu_buf_impl_t *db = (dmu_buf_impl_t *)db_fake;
-
-	db->db_state = DB_NOFILL;
-
-	dmu_buf_will_fill(db_fake, tx);
-}
-
-void
-dmu_buf_will_fill(dmu_buf_t *db_fake, dmu_tx_t *tx)
+static void
+dmu_buf_will_fill_impl(dmu_buf_t *db_fake, boolean_t nofill, dmu_tx_t *tx)
 {
 	dmu_buf_impl_t *db = (dmu_buf_impl_t *)db_fake;
 
@@ -2325,10 +2448,35 @@ dmu_buf_will_fill(dmu_buf_t *db_fake, dmu_tx_t *tx)
 	ASSERT(db->db.db_object != DMU_META_DNODE_OBJECT ||
 	    dmu_tx_private_ok(tx));
 
+	mutex_enter(&db->db_mtx);
+	if (nofill) {
+		db->db_state = DB_NOFILL;
+	} else if (db->db_state == DB_NOFILL) {
+		/*
+		 * The block was written by dmu_write_direct() and is now
+		 * being filled through the dbuf, so it needs a buffer.
+		 */
+		ASSERT3P(db->db_buf, ==, NULL);
+		db->db_state = DB_UNCACHED;
+	}
+	mutex_exit(&db->db_mtx);
+
 	dbuf_noread(db);
 	(void) dbuf_dirty(db, tx);
 }
 
+void
+dmu_buf_will_not_fill(dmu_buf_t *db_fake, dmu_tx_t *tx)
+{
+	dmu_buf_will_fill_impl(db_fake, B_TRUE, tx);
+}
+
+void
+dmu_buf_will_fill(dmu_buf_t *db_fake, dmu_tx_t *tx)
+{
+	dmu_buf_will_fill_impl(db_fake, B_FALSE, tx);
+}
+
 /*
  * This function is effectively the same as dmu_buf_will_dirty(), but
  * indicates the caller expects raw encrypted data in the db, and provides
@@ -2427,6 +2575,126 @@ dmu_buf_write_embedded(dmu_buf_t *dbuf, void *data,
 	dl->dr_overridden_by.blk_birth = db->db_last_dirty->dr_txg;
 }
 
+/*
+ * Direct I/O support.  If the contents of a level 0 dbuf are only on disk,
+ * i.e. it is neither cached nor dirty, return B_TRUE and the block pointer
+ * from which dmu_read_direct() may read them, or a hole if they are zeros.
+ */
+boolean_t
+dbuf_direct_read_bp(dmu_buf_impl_t *db, blkptr_t *bp)
+{
+	boolean_t direct = B_FALSE;
+	dnode_t *dn;
+
+	ASSERT(db->db_blkid != DMU_BONUS_BLKID);
+	ASSERT0(db->db_level);
+
+	DB_DNODE_ENTER(db);
+	dn = DB_DNODE(db);
+	/* We need the struct_rwlock to prevent db_blkptr from changing. */
+	rw_enter(&dn->dn_struct_rwlock, RW_READER);
+	mutex_enter(&db->db_mtx);
+	if (db->db_state == DB_UNCACHED && db->db_last_dirty == NULL) {
+		if (db->db_blkptr == NULL || BP_IS_HOLE(db->db_blkptr) ||
+		    dnode_block_freed(dn, db->db_blkid)) {
+			BP_ZERO(bp);
+			direct = B_TRUE;
+		} else if (!BP_IS_PROTECTED(db->db_blkptr) &&
+		    BP_GET_LSIZE(db->db_blkptr) == db->db.db_size) {
+			*bp = *db->db_blkptr;
+			direct = B_TRUE;
+		}
+	}
+	mutex_exit(&db->db_mtx);
+	rw_exit(&dn->dn_struct_rwlock);
+	DB_DNODE_EXIT(db);
+
+	return (direct);
+}
+
+/*
+ * Prepare a level 0 dbuf for dmu_write_direct() to write its new contents
+ * straight to disk.  Any cached data is dropped and the dbuf is dirtied in
+ * DB_NOFILL state with its dirty record marked DR_IN_DMU_SYNC, exactly as
+ * if dmu_sync() were writing it, until the caller overrides the record's
+ * block pointer.  Returns NULL, leaving the dbuf untouched, if the dbuf's
+ * data is in use or it has dirty data of its own to be written in syncing
+ * context, in which case the write must go through the dbuf.
+ */
+dbuf_dirty_record_t *
+dbuf_direct_dirty(dmu_buf_impl_t *db, dmu_tx_t *tx)
+{
+	dbuf_dirty_record_t *dr;
+	arc_buf_t *buf = NULL;
+
+	ASSERT(db->db_blkid != DMU_BONUS_BLKID);
+	ASSERT0(db->db_level);
+	ASSERT(!zfs_refcount_is_zero(&db->db_holds));
+
+	mutex_enter(&db->db_mtx);
+	while (db->db_state == DB_READ || db->db_state == DB_FILL)
+		cv_wait(&db->db_changed, &db->db_mtx);
+
+	for (dr = db->db_last_dirty; dr != NULL; dr = dr->dr_next) {
+		if (dr->dt.dl.dr_data != NULL ||
+		    dr->dt.dl.dr_override_state != DR_OVERRIDDEN) {
+			mutex_exit(&db->db_mtx);
+			return (NULL);
+		}
+	}
+
+	if (db->db_state == DB_CACHED) {
+		if (zfs_refcount_count(&db->db_holds) > 1 ||
+		    db->db_user != NULL) {
+			mutex_exit(&db->db_mtx);
+			return (NULL);
+		}
+		buf = db->db_buf;
+		db->db_buf = NULL;
+		dbuf_clear_data(db);
+	}
+	ASSERT(db->db_state == DB_UNCACHED || db->db_state == DB_NOFILL);
+	db->db_state = DB_NOFILL;
+	mutex_exit(&db->db_mtx);
+
+	if (buf != NULL)
+		arc_buf_destroy(buf, db);
+
+	dr = dbuf_dirty(db, tx);
+
+	mutex_enter(&db->db_mtx);
+	ASSERT3U(dr->dr_txg, ==, tx->tx_txg);
+	ASSERT3P(dr->dt.dl.dr_data, ==, NULL);
+	ASSERT(dr->dt.dl.dr_override_state == DR_NOT_OVERRIDDEN);
+	BP_ZERO(&dr->dt.dl.dr_overridden_by);
+	dr->dt.dl.dr_override_state = DR_IN_DMU_SYNC;
+	mutex_exit(&db->db_mtx);
+
+	return (dr);
+}
+
+/*
+ * A direct write of this dirty record failed, so give the dbuf a copy of
+ * the data to be written in syncing context instead.  Called with the
+ * db_mtx held.
+ */
+void
+dbuf_direct_fallback(dbuf_dirty_record_t *dr, abd_t *data)
+{
+	dmu_buf_impl_t *db = dr->dr_dbuf;
+	arc_buf_t *buf;
+
+	ASSERT(MUTEX_HELD(&db->db_mtx));
+	ASSERT3P(db->db_last_dirty, ==, dr);
+	ASSERT(dr->dt.dl.dr_override_state == DR_IN_DMU_SYNC);
+
+	buf = arc_alloc_buf(db->db_objset->os_spa, db, DBUF_GET_BUFC_TYPE(db),
+	    db->db.db_size);
+	abd_copy_to_buf(buf->b_data, data, db->db.db_size);
+	dbuf_direct_set_data(db, dr, buf);
+	dr->dt.dl.dr_override_state = DR_NOT_OVERRIDDEN;
+}
+
 /*
  * Directly assign a provided arc buf to a given dbuf if it's not referenced
  * by anybody except our caller. Otherwise copy arcbuf's contents to dbuf.
@@ -2825,6 +3093,15 @@ dbuf_issue_final_prefetch(dbuf_prefetch_arg_t *dpa, blkptr_t *bp)
 	ASSERT3U(dpa->dpa_curlevel, ==, BP_GET_LEVEL(bp));
 	ASSERT3U(dpa->dpa_curlevel, ==, dpa->dpa_zb.zb_level);
 	ASSERT(dpa->dpa_zio != NULL);
+
+	/*
+	 * Let the vdev cache know that this metadata block is wanted, so
+	 * that a read of a nearby block may be inflated to cover it.
+	 */
+	if ((BP_GET_LEVEL(bp) > 0 || DMU_OT_IS_METADATA(BP_GET_TYPE(bp))) &&
+	    BP_GET_TYPE(bp) != DMU_OT_DDT_ZAP)
+		vdev_cache_hint(dpa->dpa_spa, bp);
+
 	(void) arc_read(dpa->dpa_zio, dpa->dpa_spa, bp, NULL, NULL,
 	    dpa->dpa_prio, zio_flags, &aflags, &dpa->dpa_zb);
 }
@@ -3016,6 +3293,10 @@ dbuf_prefetch(dnode_t *dn, int64_t level, uint64_t blkid, zio_priority_t prio,
 	if (DNODE_LEVEL_IS_L2CACHEABLE(dn, level))
 		dpa->dpa_aflags |= ARC_FLAG_L2CACHE;
 
+	/* data blocks of a scancache=cold dataset are always cached cold */
+	if (level == 0 && DNODE_IS_SCAN_CACHED(dn))
+		dpa->dpa_aflags |= ARC_FLAG_SCAN;
+
 	/*
 	 * If we have the indirect just above us, no need to do the asynchronous
 	 * prefetch chain; we'll just run the last step ourselves.  If we're at
@@ -4193,7 +4474,7 @@ dbuf_write_done(zio_t *zio, arc_buf_t *buf, void *vdb)
 	if (db->db_level == 0) {
 		ASSERT(db->db_blkid != DMU_BONUS_BLKID);
 		ASSERT(dr->dt.dl.dr_override_state == DR_NOT_OVERRIDDEN);
-		if (db->db_state != DB_NOFILL) {
+		if (db->db_state != DB_NOFILL && dr->dt.dl.dr_data != NULL) {
 			if (dr->dt.dl.dr_data != db->db_buf)
 				arc_buf_destroy(dr->dt.dl.dr_data, db);
 		}
@@ -4257,7 +4538,8 @@ dbuf_write_override_done(zio_t *zio)
 	if (!BP_EQUAL(zio->io_bp, obp)) {
 		if (!BP_IS_HOLE(obp))
 			dsl_free(spa_get_dsl(zio->io_spa), zio->io_txg, obp);
-		arc_release(dr->dt.dl.dr_data, db);
+		if (dr->dt.dl.dr_data != NULL)
+			arc_release(dr->dt.dl.dr_data, db);
 	}
 	mutex_exit(&db->db_mtx);
 
@@ -4495,6 +4777,13 @@ dbuf_write(dbuf_dirty_record_t *dr, arc_buf_t *data, dmu_tx_t *tx)
 		abd_t *contents = (data != NULL) ?
 		    abd_get_from_buf(data->b_data, arc_buf_size(data)) : NULL;
 
+		/*
+		 * Without the data, the block can't be deduplicated if dedup
+		 * was enabled after it was written by dmu_write_direct().
+		 */
+		if (contents == NULL)
+			zp.zp_dedup = B_FALSE;
+
 		dr->dr_zio = zio_write(zio, os->os_spa, txg,
 		    &dr->dr_bp_copy, contents, db->db.db_size, db->db.db_size,
 		    &zp, dbuf_write_override_ready, NULL, NULL,
@@ -4543,6 +4832,9 @@ EXPORT_SYMBOL(dbuf_loan_arcbuf);
 EXPORT_SYMBOL(dbuf_whichblock);
 EXPORT_SYMBOL(dbuf_read);
 EXPORT_SYMBOL(dbuf_unoverride);
+EXPORT_SYMBOL(dbuf_direct_read_bp);
+EXPORT_SYMBOL(dbuf_direct_dirty);
+EXPORT_SYMBOL(dbuf_direct_fallback);
 EXPORT_SYMBOL(dbuf_free_range);
 EXPORT_SYMBOL(dbuf_new_size);
 EXPORT_SYMBOL(dbuf_release_bp);
@@ -48,6 +48,7 @@
 #include <sys/sa.h>
 #include <sys/zfeature.h>
 #include <sys/abd.h>
+#include <sys/dataset_kstats.h>
 #include <sys/trace_dmu.h>
 #include <sys/zfs_rlock.h>
 #ifdef _KERNEL
@@ -1227,6 +1228,317 @@ dmu_write_embedded(objset_t *os, uint64_t object, uint64_t offset,
 	dmu_buf_rele(db, FTAG);
 }
 
+/*
+ * Direct I/O support.  These routines transfer whole level 0 blocks between
+ * the caller's buffer and disk without copying them through the ARC, which
+ * saves a copy and leaves the ARC to data which benefits from caching.  The
+ * ZPL passes the user's own pages, which the user may change while they are
+ * in use, so neither routine trusts a block in the caller's buffer to still
+ * match its checksum.
+ *
+ * A direct read is issued straight to the block pointer of each dbuf which
+ * is neither cached nor dirty; all other dbufs are read and copied as usual
+ * so that the caller always sees the most recent data.  Direct reads are
+ * speculative: if any fails, perhaps only because the buffer changed under
+ * it, the range is read again through the dbufs, which reports and repairs
+ * any real damage from a buffer of their own.
+ *
+ * A direct write dirties each dbuf without data and writes the block from
+ * open context, exactly as dmu_sync() would, overriding the block pointer
+ * which will be written in syncing context.  Once written, a block which
+ * went to disk straight from the caller's buffer is checksummed again, and
+ * freed if the buffer no longer matches.  A block which can't be written
+ * directly, whose write fails, or which fails that check is instead copied
+ * into the dbuf and written in syncing context.  A failed write is still
+ * reported to the caller, unless it merely failed to allocate space in open
+ * context, which the syncing context write is able to.  Datasets with
+ * deduplication or encryption enabled always use the dbuf.
+ */
+static void
+dmu_read_direct_done(zio_t *zio)
+{
+	abd_put(zio->io_abd);
+}
+
+static int
+dmu_read_direct_dnode(dnode_t *dn, uint64_t offset, uint64_t size,
+    abd_t *data)
+{
+	objset_t *os = dn->dn_objset;
+	dsl_dataset_t *ds = os->os_dsl_dataset;
+	dmu_buf_t **dbp;
+	uint64_t off = 0;
+	int numbufs, i, err;
+	zio_t *rio;
+
+	err = dmu_buf_hold_array_by_dnode(dn, offset, size, FALSE, FTAG,
+	    &numbufs, &dbp, DMU_READ_NO_PREFETCH);
+	if (err)
+		return (err);
+
+	rio = zio_root(os->os_spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+	for (i = 0; i < numbufs; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
+		uint64_t bufoff = offset + off - db->db.db_offset;
+		uint64_t tocpy = MIN(db->db.db_size - bufoff, size - off);
+		zbookmark_phys_t zb;
+		blkptr_t bp;
+
+		if (bufoff == 0 && tocpy == db->db.db_size &&
+		    dbuf_direct_read_bp(db, &bp)) {
+			if (BP_IS_HOLE(&bp)) {
+				abd_zero_off(data, off, tocpy);
+			} else {
+				SET_BOOKMARK(&zb, ds ? ds->ds_object :
+				    DMU_META_OBJSET, db->db.db_object,
+				    db->db_level, db->db_blkid);
+				zio_nowait(zio_read(rio, os->os_spa, &bp,
+				    abd_get_offset_size(data, off, tocpy),
+				    tocpy, dmu_read_direct_done, NULL,
+				    ZIO_PRIORITY_SYNC_READ, ZIO_FLAG_CANFAIL |
+				    ZIO_FLAG_SPECULATIVE, &zb));
+			}
+		} else {
+			err = dbuf_read(db, NULL,
+			    DB_RF_CANFAIL | DB_RF_NOPREFETCH);
+			if (err)
+				break;
+			abd_copy_from_buf_off(data,
+			    (char *)db->db.db_data + bufoff, off, tocpy);
+		}
+		off += tocpy;
+	}
+
+	/*
+	 * A direct read may have failed only because the caller changed the
+	 * buffer under it, so read the whole range again through the dbufs.
+	 */
+	if (zio_wait(rio) != 0 && err == 0) {
+		for (i = 0, off = 0; i < numbufs && err == 0; i++) {
+			dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
+			uint64_t bufoff = offset + off - db->db.db_offset;
+			uint64_t tocpy;
+
+			tocpy = MIN(db->db.db_size - bufoff, size - off);
+			err = dbuf_read(db, NULL,
+			    DB_RF_CANFAIL | DB_RF_NOPREFETCH);
+			if (err == 0) {
+				abd_copy_from_buf_off(data,
+				    (char *)db->db.db_data + bufoff, off,
+				    tocpy);
+			}
+			off += tocpy;
+		}
+	}
+	dmu_buf_rele_array(dbp, numbufs, FTAG);
+
+	return (err);
+}
+
+/*
+ * Read 'size' bytes at 'offset' of the object containing zdb (e.g. its
+ * bonus buffer) into 'data', bypassing the ARC where possible.  Like any
+ * other I/O buffer, 'data' must be aligned to SPA_MINBLOCKSIZE.
+ */
+int
+dmu_read_direct(dmu_buf_t *zdb, uint64_t offset, uint64_t size, abd_t *data)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)zdb;
+	dnode_t *dn;
+	int err;
+
+	if (size == 0)
+		return (0);
+
+	DB_DNODE_ENTER(db);
+	dn = DB_DNODE(db);
+	err = dmu_read_direct_dnode(dn, offset, size, data);
+	DB_DNODE_EXIT(db);
+
+	return (err);
+}
+
+static void
+dmu_write_direct_ready(zio_t *zio)
+{
+	dbuf_dirty_record_t *dr = zio->io_private;
+	blkptr_t *bp = zio->io_bp;
+
+	if (zio->io_error == 0) {
+		if (BP_IS_HOLE(bp)) {
+			/*
+			 * A block of zeros may compress to a hole, but the
+			 * block size still needs to be known for replay.
+			 */
+			BP_SET_LSIZE(bp, dr->dr_dbuf->db.db_size);
+		} else if (!BP_IS_EMBEDDED(bp)) {
+			ASSERT(BP_GET_LEVEL(bp) == 0);
+			BP_SET_FILL(bp, 1);
+		}
+	}
+}
+
+/*
+ * Returns true if the block just written by a direct write may not match
+ * its checksum.  Uncompressed blocks, including the members of a gang block,
+ * are written straight from the caller's buffer, which may have changed while
+ * being written; anything else was written from a private transform buffer.
+ */
+static boolean_t
+dmu_write_direct_changed(zio_t *zio)
+{
+	blkptr_t *bp = zio->io_bp;
+
+	if (BP_IS_HOLE(bp) || BP_IS_EMBEDDED(bp) ||
+	    BP_GET_COMPRESS(bp) != ZIO_COMPRESS_OFF ||
+	    BP_GET_CHECKSUM(bp) == ZIO_CHECKSUM_OFF ||
+	    !abd_is_user(zio->io_abd))
+		return (B_FALSE);
+
+	/* The members of a gang block aren't worth verifying separately. */
+	if (BP_IS_GANG(bp))
+		return (B_TRUE);
+
+	return (zio_checksum_error_impl(zio->io_spa, bp, BP_GET_CHECKSUM(bp),
+	    zio->io_abd, BP_GET_PSIZE(bp), 0, NULL) != 0);
+}
+
+static void
+dmu_write_direct_done(zio_t *zio)
+{
+	dbuf_dirty_record_t *dr = zio->io_private;
+	dmu_buf_impl_t *db = dr->dr_dbuf;
+	boolean_t changed = B_FALSE;
+
+	/*
+	 * A block which no longer matches the caller's buffer may not match
+	 * what reached disk either, so free it and write the buffer as it is
+	 * now from a copy in the dbuf instead.
+	 */
+	if (zio->io_error == 0 && dmu_write_direct_changed(zio)) {
+		zio_free(zio->io_spa, dr->dr_txg, zio->io_bp);
+		changed = B_TRUE;
+	}
+
+	mutex_enter(&db->db_mtx);
+	ASSERT(dr->dt.dl.dr_override_state == DR_IN_DMU_SYNC);
+	if (zio->io_error == 0 && !changed) {
+		dr->dt.dl.dr_overridden_by = *zio->io_bp;
+		dr->dt.dl.dr_override_state = DR_OVERRIDDEN;
+		dr->dt.dl.dr_copies = zio->io_prop.zp_copies;
+		dr->dt.dl.dr_direct = B_TRUE;
+
+		/* See the comment about old style holes in dmu_sync_done(). */
+		if (BP_IS_HOLE(&dr->dt.dl.dr_overridden_by) &&
+		    dr->dt.dl.dr_overridden_by.blk_birth == 0)
+			BP_ZERO(&dr->dt.dl.dr_overridden_by);
+	} else {
+		dbuf_direct_fallback(dr, zio->io_abd);
+
+		/* Don't fail the write for want of space in open context. */
+		if (zio->io_error == ENOSPC)
+			zio->io_error = 0;
+	}
+	cv_broadcast(&db->db_changed);
+	mutex_exit(&db->db_mtx);
+
+	abd_put(zio->io_abd);
+}
+
+static int
+dmu_write_direct_dnode(dnode_t *dn, uint64_t offset, uint64_t size,
+    abd_t *data, dmu_tx_t *tx)
+{
+	objset_t *os = dn->dn_objset;
+	dsl_dataset_t *ds = os->os_dsl_dataset;
+	dmu_buf_t **dbp;
+	boolean_t direct;
+	uint64_t off = 0;
+	int numbufs, i, err;
+	zio_prop_t zp;
+	zio_t *rio;
+
+	err = dmu_buf_hold_array_by_dnode(dn, offset, size, FALSE, FTAG,
+	    &numbufs, &dbp, DMU_READ_PREFETCH);
+	if (err)
+		return (err);
+
+	if (dbp[0]->db_offset != offset ||
+	    dbp[numbufs - 1]->db_offset + dbp[numbufs - 1]->db_size !=
+	    offset + size) {
+		dmu_buf_rele_array(dbp, numbufs, FTAG);
+		return (SET_ERROR(EINVAL));
+	}
+
+	/*
+	 * Dedup and encryption need the block written in syncing context,
+	 * so that the DDT and the dataset's key are updated consistently.
+	 */
+	direct = !os->os_encrypted &&
+	    os->os_dedup_checksum == ZIO_CHECKSUM_OFF;
+
+	dmu_write_policy(os, dn, 0, WP_DMU_SYNC, &zp);
+	zp.zp_nopwrite = B_FALSE;
+
+	rio = zio_root(os->os_spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+	for (i = 0; i < numbufs; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
+		uint64_t blksz = db->db.db_size;
+		dbuf_dirty_record_t *dr = NULL;
+		zbookmark_phys_t zb;
+
+		if (direct)
+			dr = dbuf_direct_dirty(db, tx);
+
+		if (dr == NULL) {
+			dmu_buf_will_fill(&db->db, tx);
+			abd_copy_to_buf_off(db->db.db_data, data, off, blksz);
+			dmu_buf_fill_done(&db->db, tx);
+		} else {
+			SET_BOOKMARK(&zb, ds ? ds->ds_object : DMU_META_OBJSET,
+			    db->db.db_object, db->db_level, db->db_blkid);
+			zio_nowait(zio_write(rio, os->os_spa, dr->dr_txg,
+			    &dr->dt.dl.dr_overridden_by,
+			    abd_get_offset_size(data, off, blksz), blksz, blksz,
+			    &zp, dmu_write_direct_ready, NULL, NULL,
+			    dmu_write_direct_done, dr, ZIO_PRIORITY_SYNC_WRITE,
+			    ZIO_FLAG_CANFAIL, &zb));
+		}
+		off += blksz;
+	}
+
+	err = zio_wait(rio);
+	dmu_buf_rele_array(dbp, numbufs, FTAG);
+
+	return (err == ECKSUM ? SET_ERROR(EIO) : err);
+}
+
+/*
+ * Write 'size' bytes of 'data' at 'offset' of the object containing zdb,
+ * bypassing the ARC where possible.  The range must consist of whole
+ * blocks, and 'data' must be aligned to SPA_MINBLOCKSIZE.  A buffer which
+ * may change until this returns must come from abd_get_from_user_buf(), so
+ * that each block is checked against it once written.
+ */
+int
+dmu_write_direct(dmu_buf_t *zdb, uint64_t offset, uint64_t size, abd_t *data,
+    dmu_tx_t *tx)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)zdb;
+	dnode_t *dn;
+	int err;
+
+	if (size == 0)
+		return (0);
+
+	DB_DNODE_ENTER(db);
+	dn = DB_DNODE(db);
+	err = dmu_write_direct_dnode(dn, offset, size, data, tx);
+	DB_DNODE_EXIT(db);
+
+	return (err);
+}
+
 /*
  * DMU support for xuio
  */
@@ -1831,6 +2143,14 @@ dmu_sync_late_arrival(zio_t *pio, objset_t *os, dmu_sync_cb_t *done, zgd_t *zgd,
 	dmu_sync_arg_t *dsa;
 	dmu_tx_t *tx;
 
+	/*
+	 * The caller holds the dbuf without reading it, since a block
+	 * written by dmu_write_direct() doesn't need its data to be logged.
+	 */
+	if (dbuf_read((dmu_buf_impl_t *)zgd->zgd_db, NULL,
+	    DB_RF_CANFAIL | DB_RF_NOPREFETCH) != 0)
+		return (SET_ERROR(EIO));
+
 	tx = dmu_tx_create(os);
 	dmu_tx_hold_space(tx, zgd->zgd_db->db_size);
 	if (dmu_tx_assign(tx, TXG_WAIT) != 0) {
@@ -1983,6 +2303,18 @@ dmu_sync(zio_t *pio, uint64_t txg, dmu_sync_cb_t *done, zgd_t *zgd)
 
 	ASSERT(dr->dr_next == NULL || dr->dr_next->dr_txg < txg);
 
+	if (dr->dt.dl.dr_override_state == DR_OVERRIDDEN &&
+	    dr->dt.dl.dr_direct) {
+		/*
+		 * This block was written by dmu_write_direct(), so it is
+		 * already on disk and its blkptr can be logged as is.
+		 */
+		*zgd->zgd_bp = dr->dt.dl.dr_overridden_by;
+		mutex_exit(&db->db_mtx);
+		done(zgd, 0);
+		return (0);
+	}
+
 	if (db->db_blkptr != NULL) {
 		/*
 		 * We need to fill in zgd_bp with the current blkptr so that
@@ -2283,6 +2615,7 @@ dmu_write_policy(objset_t *os, dnode_t *dn, int level, int wp, zio_prop_t *zp)
 	bzero(zp->zp_mac, ZIO_DATA_MAC_LEN);
 	zp->zp_zpl_smallblk = DMU_OT_IS_FILE(zp->zp_type) ?
 	    os->os_zpl_special_smallblock : 0;
+	zp->zp_kstats = os->os_kstats;
 
 	ASSERT3U(zp->zp_compress, !=, ZIO_COMPRESS_INHERIT);
 }
@@ -2494,6 +2827,7 @@ dmu_init(void)
 	sa_cache_init();
 	xuio_stat_init();
 	dmu_objset_init();
+	dataset_kstats_init();
 	dnode_init();
 	zfetch_init();
 	dmu_tx_init();
@@ -2511,6 +2845,7 @@ dmu_fini(void)
 	zfetch_fini();
 	dbuf_fini();
 	dnode_fini();
+	dataset_kstats_fini();
 	dmu_objset_fini();
 	xuio_stat_fini();
 	sa_cache_fini();
@@ -2530,6 +2865,8 @@ EXPORT_SYMBOL(dmu_read);
 EXPORT_SYMBOL(dmu_read_by_dnode);
 EXPORT_SYMBOL(dmu_write);
 EXPORT_SYMBOL(dmu_write_by_dnode);
+EXPORT_SYMBOL(dmu_read_direct);
+EXPORT_SYMBOL(dmu_write_direct);
 EXPORT_SYMBOL(dmu_prealloc);
 EXPORT_SYMBOL(dmu_object_info);
 EXPORT_SYMBOL(dmu_object_info_from_dnode);
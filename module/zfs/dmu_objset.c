@@ -83,6 +83,18 @@ int dmu_find_threads = 0;
  */
 int dmu_rescan_dnode_threshold = 1 << DN_MAX_INDBLKSHIFT;
 
+/*
+ * Milliseconds worth of I/O a dataset with a readlimit, writelimit or
+ * iopslimit may issue at once without being throttled.
+ */
+int zfs_iolimit_burst_ms = 100;
+
+/*
+ * The furthest ahead of the current time a dataset's throttles may run,
+ * which bounds how long a single large I/O can be delayed.
+ */
+#define	IOLIMIT_MAX_DEBT	SEC2NSEC(10)
+
 static char *upgrade_tag = "upgrade_tag";
 
 static void dmu_objset_find_dp_cb(void *arg);
@@ -163,6 +175,12 @@ dmu_objset_syncprop(objset_t *os)
 	return (os->os_sync);
 }
 
+zfs_direct_type_t
+dmu_objset_direct(objset_t *os)
+{
+	return (os->os_direct);
+}
+
 zfs_logbias_op_t
 dmu_objset_logbias(objset_t *os)
 {
@@ -256,6 +274,76 @@ secondary_cache_changed_cb(void *arg, uint64_t newval)
 	os->os_secondary_cache = newval;
 }
 
+static void
+scan_cache_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	/*
+	 * Inheritance and range checking should have been done by now.
+	 */
+	ASSERT(newval == ZFS_SCANCACHE_AUTO || newval == ZFS_SCANCACHE_COLD ||
+	    newval == ZFS_SCANCACHE_NORMAL);
+
+	os->os_scan_cache = newval;
+}
+
+static void
+readlimit_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	os->os_readlimit = newval;
+}
+
+static void
+writelimit_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	os->os_writelimit = newval;
+}
+
+static void
+iopslimit_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	os->os_iopslimit = newval;
+}
+
+static void
+arc_quota_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	arc_tenant_set_quota(os->os_arc_tenant, newval);
+}
+
+static void
+arc_reserve_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	arc_tenant_set_reserve(os->os_arc_tenant, newval);
+}
+
+/*
+ * Drop the objset's hold on its ARC accounting. Cached data of the
+ * objset may keep the tenant alive, so clear its limits first.
+ */
+static void
+dmu_objset_arc_tenant_rele(objset_t *os)
+{
+	if (os->os_arc_tenant == NULL)
+		return;
+
+	arc_tenant_set_quota(os->os_arc_tenant, 0);
+	arc_tenant_set_reserve(os->os_arc_tenant, 0);
+	arc_tenant_rele(os->os_arc_tenant);
+	os->os_arc_tenant = NULL;
+}
+
 static void
 sync_changed_cb(void *arg, uint64_t newval)
 {
@@ -272,6 +360,20 @@ sync_changed_cb(void *arg, uint64_t newval)
 		zil_set_sync(os->os_zil, newval);
 }
 
+static void
+direct_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	/*
+	 * Inheritance and range checking should have been done by now.
+	 */
+	ASSERT(newval == ZFS_DIRECT_STANDARD || newval == ZFS_DIRECT_ALWAYS ||
+	    newval == ZFS_DIRECT_DISABLED);
+
+	os->os_direct = newval;
+}
+
 static void
 redundant_metadata_changed_cb(void *arg, uint64_t newval)
 {
@@ -362,8 +464,11 @@ dmu_objset_byteswap(void *buf, size_t size)
 	if (size >= OBJSET_PHYS_SIZE_V2) {
 		dnode_byteswap(&osp->os_userused_dnode);
 		dnode_byteswap(&osp->os_groupused_dnode);
-		if (size >= sizeof (objset_phys_t))
+		if (size >= sizeof (objset_phys_t)) {
 			dnode_byteswap(&osp->os_projectused_dnode);
+			byteswap_uint64_array(osp->os_zil_chains,
+			    sizeof (osp->os_zil_chains));
+		}
 	}
 }
 
@@ -523,7 +628,39 @@ dmu_objset_open_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
 			    zfs_prop_to_name(ZFS_PROP_SECONDARYCACHE),
 			    secondary_cache_changed_cb, os);
 		}
+		if (err == 0) {
+			err = dsl_prop_register(ds,
+			    zfs_prop_to_name(ZFS_PROP_SCANCACHE),
+			    scan_cache_changed_cb, os);
+		}
+		if (err == 0) {
+			err = dsl_prop_register(ds,
+			    zfs_prop_to_name(ZFS_PROP_READLIMIT),
+			    readlimit_changed_cb, os);
+		}
+		if (err == 0) {
+			err = dsl_prop_register(ds,
+			    zfs_prop_to_name(ZFS_PROP_WRITELIMIT),
+			    writelimit_changed_cb, os);
+		}
+		if (err == 0) {
+			err = dsl_prop_register(ds,
+			    zfs_prop_to_name(ZFS_PROP_IOPSLIMIT),
+			    iopslimit_changed_cb, os);
+		}
 		if (!ds->ds_is_snapshot) {
+			os->os_arc_tenant = arc_tenant_hold(spa,
+			    ds->ds_object);
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(ZFS_PROP_ARC_QUOTA),
+				    arc_quota_changed_cb, os);
+			}
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(ZFS_PROP_ARC_RESERVE),
+				    arc_reserve_changed_cb, os);
+			}
 			if (err == 0) {
 				err = dsl_prop_register(ds,
 				    zfs_prop_to_name(ZFS_PROP_CHECKSUM),
@@ -554,6 +691,11 @@ dmu_objset_open_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
 				    zfs_prop_to_name(ZFS_PROP_SYNC),
 				    sync_changed_cb, os);
 			}
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(ZFS_PROP_DIRECT),
+				    direct_changed_cb, os);
+			}
 			if (err == 0) {
 				err = dsl_prop_register(ds,
 				    zfs_prop_to_name(
@@ -580,6 +722,7 @@ dmu_objset_open_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
 		if (needlock)
 			dsl_pool_config_exit(dmu_objset_pool(os), FTAG);
 		if (err != 0) {
+			dmu_objset_arc_tenant_rele(os);
 			arc_buf_destroy(os->os_phys_buf, &os->os_phys_buf);
 			kmem_free(os, sizeof (objset_t));
 			return (err);
@@ -594,14 +737,23 @@ dmu_objset_open_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
 		os->os_dedup_verify = B_FALSE;
 		os->os_logbias = ZFS_LOGBIAS_LATENCY;
 		os->os_sync = ZFS_SYNC_STANDARD;
+		os->os_direct = ZFS_DIRECT_STANDARD;
 		os->os_primary_cache = ZFS_CACHE_ALL;
 		os->os_secondary_cache = ZFS_CACHE_ALL;
+		os->os_scan_cache = ZFS_SCANCACHE_AUTO;
 		os->os_dnodesize = DNODE_MIN_SIZE;
 	}
 
-	if (ds == NULL || !ds->ds_is_snapshot)
+	if (ds == NULL || !ds->ds_is_snapshot) {
 		os->os_zil_header = os->os_phys->os_zil_header;
-	os->os_zil = zil_alloc(os, &os->os_zil_header);
+		if (OBJSET_BUF_HAS_PROJECTUSED(os->os_phys_buf)) {
+			bcopy(os->os_phys->os_zil_chains, os->os_zil_chains,
+			    sizeof (os->os_zil_chains));
+		}
+	}
+	os->os_zil = zil_alloc(os, &os->os_zil_header,
+	    OBJSET_BUF_HAS_PROJECTUSED(os->os_phys_buf) ?
+	    os->os_zil_chains : NULL);
 
 	for (i = 0; i < TXG_SIZE; i++) {
 		os->os_dirty_dnodes[i] = multilist_create(sizeof (dnode_t),
@@ -619,6 +771,7 @@ dmu_objset_open_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
 	mutex_init(&os->os_userused_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&os->os_obj_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&os->os_user_ptr_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&os->os_iolimit_lock, NULL, MUTEX_DEFAULT, NULL);
 	os->os_obj_next_percpu_len = boot_ncpus;
 	os->os_obj_next_percpu = kmem_zalloc(os->os_obj_next_percpu_len *
 	    sizeof (os->os_obj_next_percpu[0]), KM_SLEEP);
@@ -958,6 +1111,7 @@ void
 dmu_objset_evict_done(objset_t *os)
 {
 	ASSERT3P(list_head(&os->os_dnodes), ==, NULL);
+	ASSERT3P(os->os_kstats, ==, NULL);
 
 	dnode_special_close(&os->os_meta_dnode);
 	if (DMU_USERUSED_DNODE(os)) {
@@ -969,6 +1123,7 @@ dmu_objset_evict_done(objset_t *os)
 	zil_free(os->os_zil);
 
 	arc_buf_destroy(os->os_phys_buf, &os->os_phys_buf);
+	dmu_objset_arc_tenant_rele(os);
 
 	/*
 	 * This is a barrier to prevent the objset from going away in
@@ -986,6 +1141,7 @@ dmu_objset_evict_done(objset_t *os)
 	mutex_destroy(&os->os_userused_lock);
 	mutex_destroy(&os->os_obj_lock);
 	mutex_destroy(&os->os_user_ptr_lock);
+	mutex_destroy(&os->os_iolimit_lock);
 	mutex_destroy(&os->os_upgrade_lock);
 	for (int i = 0; i < TXG_SIZE; i++) {
 		multilist_destroy(os->os_dirty_dnodes[i]);
@@ -1786,6 +1942,10 @@ dmu_objset_sync(objset_t *os, zio_t *pio, dmu_tx_t *tx)
 	 */
 	zil_sync(os->os_zil, tx);
 	os->os_phys->os_zil_header = os->os_zil_header;
+	if (OBJSET_BUF_HAS_PROJECTUSED(os->os_phys_buf)) {
+		bcopy(os->os_zil_chains, os->os_phys->os_zil_chains,
+		    sizeof (os->os_zil_chains));
+	}
 	zio_nowait(zio);
 }
 
@@ -2982,6 +3142,83 @@ dmu_objset_willuse_space(objset_t *os, int64_t space, dmu_tx_t *tx)
 	}
 }
 
+/*
+ * Charge an I/O of the given cost to a throttle admitting rate units per
+ * second, and return the time at which it may be issued.  *nextp is the
+ * time at which the throttle next has capacity available; it runs ahead
+ * of the current time while the dataset is over its limit, and anything
+ * less than zfs_iolimit_burst_ms ahead is admitted immediately.
+ */
+static hrtime_t
+dmu_objset_iolimit_charge(hrtime_t *nextp, uint64_t rate, uint64_t cost,
+    hrtime_t now)
+{
+	hrtime_t delay, next;
+
+	if (rate == 0)
+		return (0);
+
+	if (cost / rate >= IOLIMIT_MAX_DEBT / NANOSEC) {
+		delay = IOLIMIT_MAX_DEBT;
+	} else if (rate > UINT64_MAX / NANOSEC) {
+		delay = cost / (rate / NANOSEC);
+	} else {
+		delay = (cost / rate) * NANOSEC +
+		    ((cost % rate) * NANOSEC) / rate;
+	}
+
+	next = MAX(*nextp, now) + delay;
+	*nextp = MIN(next, now + IOLIMIT_MAX_DEBT);
+
+	return (*nextp - MSEC2NSEC(zfs_iolimit_burst_ms));
+}
+
+/*
+ * Charge a read or write of the given size to the objset's
+ * readlimit/writelimit and iopslimit without waiting, and return the
+ * time at which it may be issued, or 0 if it may be issued right away.
+ */
+hrtime_t
+dmu_objset_iolimit_wakeup(objset_t *os, boolean_t write, uint64_t bytes)
+{
+	uint64_t bwlimit = write ? os->os_writelimit : os->os_readlimit;
+	uint64_t iopslimit = os->os_iopslimit;
+	hrtime_t now, wakeup;
+
+	if (bwlimit == 0 && iopslimit == 0)
+		return (0);
+
+	mutex_enter(&os->os_iolimit_lock);
+	now = gethrtime();
+	wakeup = dmu_objset_iolimit_charge(write ? &os->os_write_next :
+	    &os->os_read_next, bwlimit, bytes, now);
+	wakeup = MAX(wakeup, dmu_objset_iolimit_charge(&os->os_iops_next,
+	    iopslimit, 1, now));
+	mutex_exit(&os->os_iolimit_lock);
+
+	return (wakeup > now ? wakeup : 0);
+}
+
+/*
+ * Throttle a read or write of the given size against the objset's
+ * readlimit/writelimit and iopslimit, sleeping until it may be issued.
+ * Returns the time spent asleep.
+ */
+hrtime_t
+dmu_objset_iolimit(objset_t *os, boolean_t write, uint64_t bytes)
+{
+	hrtime_t now, wakeup;
+
+	wakeup = dmu_objset_iolimit_wakeup(os, write, bytes);
+	if (wakeup == 0)
+		return (0);
+
+	now = gethrtime();
+	zfs_sleep_until(wakeup);
+
+	return (gethrtime() - now);
+}
+
 #if defined(_KERNEL)
 EXPORT_SYMBOL(dmu_objset_zil);
 EXPORT_SYMBOL(dmu_objset_pool);
@@ -3027,4 +3264,10 @@ EXPORT_SYMBOL(dmu_objset_projectquota_enabled);
 EXPORT_SYMBOL(dmu_objset_projectquota_present);
 EXPORT_SYMBOL(dmu_objset_projectquota_upgradable);
 EXPORT_SYMBOL(dmu_objset_id_quota_upgrade);
+EXPORT_SYMBOL(dmu_objset_iolimit);
+EXPORT_SYMBOL(dmu_objset_iolimit_wakeup);
+
+module_param(zfs_iolimit_burst_ms, int, 0644);
+MODULE_PARM_DESC(zfs_iolimit_burst_ms,
+	"Milliseconds of I/O a rate limited dataset may issue without delay");
 #endif
@@ -63,6 +63,8 @@
 int zfs_send_corrupt_data = B_FALSE;
 int zfs_send_queue_length = SPA_MAXBLOCKSIZE;
 int zfs_recv_queue_length = SPA_MAXBLOCKSIZE;
+/* Threads writing received records concurrently, 0 means one per CPU */
+int zfs_recv_write_threads = 0;
 /* Set this tunable to FALSE to disable setting of DRR_FLAG_FREERECORDS */
 int zfs_send_set_freerecords_bit = B_TRUE;
 
@@ -652,6 +654,9 @@ backup_do_embed(dmu_sendarg_t *dsp, const blkptr_t *bp)
 	if ((BP_GET_COMPRESS(bp) >= ZIO_COMPRESS_LEGACY_FUNCTIONS &&
 	    !(dsp->dsa_featureflags & DMU_BACKUP_FEATURE_LZ4)))
 		return (B_FALSE);
+	if (ZIO_COMPRESS_IS_ZSTD(BP_GET_COMPRESS(bp)) &&
+	    !(dsp->dsa_featureflags & DMU_BACKUP_FEATURE_ZSTD))
+		return (B_FALSE);
 
 	/*
 	 * Embed type must be explicitly enabled.
@@ -1051,6 +1056,12 @@ dmu_send_impl(void *tag, dsl_pool_t *dp, dsl_dataset_t *to_ds,
 	    spa_feature_is_active(dp->dp_spa, SPA_FEATURE_LZ4_COMPRESS)) {
 		featureflags |= DMU_BACKUP_FEATURE_LZ4;
 	}
+	if ((featureflags &
+	    (DMU_BACKUP_FEATURE_EMBED_DATA | DMU_BACKUP_FEATURE_COMPRESSED |
+	    DMU_BACKUP_FEATURE_RAW)) != 0 &&
+	    to_ds->ds_feature_inuse[SPA_FEATURE_ZSTD_COMPRESS]) {
+		featureflags |= DMU_BACKUP_FEATURE_ZSTD;
+	}
 
 	if (resumeobj != 0 || resumeoff != 0) {
 		featureflags |= DMU_BACKUP_FEATURE_RESUMING;
@@ -1689,7 +1700,8 @@ dmu_recv_begin_check(void *arg, dmu_tx_t *tx)
 	 * The receiving code doesn't know how to translate a WRITE_EMBEDDED
 	 * record to a plain WRITE record, so the pool must have the
 	 * EMBEDDED_DATA feature enabled if the stream has WRITE_EMBEDDED
-	 * records.  Same with WRITE_EMBEDDED records that use LZ4 compression.
+	 * records.  Same with WRITE_EMBEDDED records that use LZ4 compression,
+	 * and with any record that uses zstd compression.
 	 */
 	if ((featureflags & DMU_BACKUP_FEATURE_EMBED_DATA) &&
 	    !spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_EMBEDDED_DATA))
@@ -1697,6 +1709,9 @@ dmu_recv_begin_check(void *arg, dmu_tx_t *tx)
 	if ((featureflags & DMU_BACKUP_FEATURE_LZ4) &&
 	    !spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_LZ4_COMPRESS))
 		return (SET_ERROR(ENOTSUP));
+	if ((featureflags & DMU_BACKUP_FEATURE_ZSTD) &&
+	    !spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_ZSTD_COMPRESS))
+		return (SET_ERROR(ENOTSUP));
 
 	/*
 	 * The receiving code doesn't know how to translate large blocks
@@ -2020,7 +2035,8 @@ dmu_recv_resume_begin_check(void *arg, dmu_tx_t *tx)
 	 * The receiving code doesn't know how to translate a WRITE_EMBEDDED
 	 * record to a plain WRITE record, so the pool must have the
 	 * EMBEDDED_DATA feature enabled if the stream has WRITE_EMBEDDED
-	 * records.  Same with WRITE_EMBEDDED records that use LZ4 compression.
+	 * records.  Same with WRITE_EMBEDDED records that use LZ4 compression,
+	 * and with any record that uses zstd compression.
 	 */
 	if ((featureflags & DMU_BACKUP_FEATURE_EMBED_DATA) &&
 	    !spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_EMBEDDED_DATA))
@@ -2028,6 +2044,9 @@ dmu_recv_resume_begin_check(void *arg, dmu_tx_t *tx)
 	if ((featureflags & DMU_BACKUP_FEATURE_LZ4) &&
 	    !spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_LZ4_COMPRESS))
 		return (SET_ERROR(ENOTSUP));
+	if ((featureflags & DMU_BACKUP_FEATURE_ZSTD) &&
+	    !spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_ZSTD_COMPRESS))
+		return (SET_ERROR(ENOTSUP));
 
 	/*
 	 * The receiving code doesn't know how to translate large blocks
@@ -2248,6 +2267,13 @@ struct receive_record_arg {
 	uint64_t bytes_read; /* bytes read from stream when record created */
 	boolean_t eos_marker; /* Marks the end of the stream */
 	bqueue_node_t node;
+
+	/* Used while the record is queued to a writer taskq. */
+	struct receive_writer_arg *rwa;
+	list_node_t inflight_node;
+	int writer;
+	boolean_t done;
+	uint64_t txg; /* txg the record was written in */
 };
 
 struct receive_writer_arg {
@@ -2281,6 +2307,29 @@ struct receive_writer_arg {
 	uint8_t or_iv[ZIO_DATA_IV_LEN];
 	uint8_t or_mac[ZIO_DATA_MAC_LEN];
 	boolean_t or_byteorder;
+
+	/*
+	 * Single-threaded taskqs writing records for different objects
+	 * concurrently, see receive_record_concurrent().  NULL if all records
+	 * are written by the writer thread.
+	 */
+	taskq_t **writers;
+	int nwriters;
+	uint64_t *writer_txg; /* txg of each writer's current record */
+	kmutex_t writers_lock;
+	kcondvar_t writers_cv;
+	list_t inflight; /* records queued to the writers, in stream order */
+	uint64_t inflight_bytes;
+	int writers_err;
+
+	/*
+	 * Position of the last record which, along with every record before
+	 * it, has been written, and the latest txg any of them was written in.
+	 */
+	uint64_t resume_object;
+	uint64_t resume_offset;
+	uint64_t resume_bytes;
+	uint64_t resume_txg;
 };
 
 struct objlist {
@@ -2506,19 +2555,16 @@ deduce_nblkptr(dmu_object_type_t bonus_type, uint64_t bonus_size)
 }
 
 static void
-save_resume_state(struct receive_writer_arg *rwa,
-    uint64_t object, uint64_t offset, dmu_tx_t *tx)
+save_resume_position(struct receive_writer_arg *rwa,
+    uint64_t object, uint64_t offset, uint64_t bytes_read, dmu_tx_t *tx)
 {
 	int txgoff = dmu_tx_get_txg(tx) & TXG_MASK;
 
-	if (!rwa->resumable)
-		return;
-
 	/*
 	 * We use ds_resume_bytes[] != 0 to indicate that we need to
 	 * update this on disk, so it must not be 0.
 	 */
-	ASSERT(rwa->bytes_read != 0);
+	ASSERT(bytes_read != 0);
 
 	/*
 	 * We only resume from write records, which have a valid
@@ -2534,12 +2580,40 @@ save_resume_state(struct receive_writer_arg *rwa,
 	ASSERT3U(object, >=, rwa->os->os_dsl_dataset->ds_resume_object[txgoff]);
 	ASSERT(object != rwa->os->os_dsl_dataset->ds_resume_object[txgoff] ||
 	    offset >= rwa->os->os_dsl_dataset->ds_resume_offset[txgoff]);
-	ASSERT3U(rwa->bytes_read, >=,
+	ASSERT3U(bytes_read, >=,
 	    rwa->os->os_dsl_dataset->ds_resume_bytes[txgoff]);
 
 	rwa->os->os_dsl_dataset->ds_resume_object[txgoff] = object;
 	rwa->os->os_dsl_dataset->ds_resume_offset[txgoff] = offset;
-	rwa->os->os_dsl_dataset->ds_resume_bytes[txgoff] = rwa->bytes_read;
+	rwa->os->os_dsl_dataset->ds_resume_bytes[txgoff] = bytes_read;
+}
+
+static void
+save_resume_state(struct receive_writer_arg *rwa,
+    uint64_t object, uint64_t offset, dmu_tx_t *tx)
+{
+	uint64_t txg = dmu_tx_get_txg(tx);
+
+	if (!rwa->resumable)
+		return;
+
+	/*
+	 * When records are written concurrently, records preceding this one
+	 * may not have been written yet, or may be written in a later txg.
+	 * Save the last position known to be complete as of this txg instead.
+	 */
+	if (rwa->writers != NULL) {
+		rwa->writer_txg[object % rwa->nwriters] = txg;
+		mutex_enter(&rwa->writers_lock);
+		if (rwa->resume_bytes != 0 && rwa->resume_txg <= txg) {
+			save_resume_position(rwa, rwa->resume_object,
+			    rwa->resume_offset, rwa->resume_bytes, tx);
+		}
+		mutex_exit(&rwa->writers_lock);
+		return;
+	}
+
+	save_resume_position(rwa, object, offset, rwa->bytes_read, tx);
 }
 
 noinline static int
@@ -2856,21 +2930,6 @@ receive_write(struct receive_writer_arg *rwa, struct drr_write *drrw,
 	    !DMU_OT_IS_VALID(drrw->drr_type))
 		return (SET_ERROR(EINVAL));
 
-	/*
-	 * For resuming to work, records must be in increasing order
-	 * by (object, offset).
-	 */
-	if (drrw->drr_object < rwa->last_object ||
-	    (drrw->drr_object == rwa->last_object &&
-	    drrw->drr_offset < rwa->last_offset)) {
-		return (SET_ERROR(EINVAL));
-	}
-	rwa->last_object = drrw->drr_object;
-	rwa->last_offset = drrw->drr_offset;
-
-	if (rwa->last_object > rwa->max_object)
-		rwa->max_object = rwa->last_object;
-
 	if (dmu_object_info(rwa->os, drrw->drr_object, NULL) != 0)
 		return (SET_ERROR(EINVAL));
 
@@ -2946,9 +3005,6 @@ receive_write_byref(struct receive_writer_arg *rwa,
 		ref_os = rwa->os;
 	}
 
-	if (drrwbr->drr_object > rwa->max_object)
-		rwa->max_object = drrwbr->drr_object;
-
 	if (rwa->raw)
 		flags |= DMU_READ_NO_DECRYPT;
 
@@ -3108,9 +3164,6 @@ receive_free(struct receive_writer_arg *rwa, struct drr_free *drrf)
 	if (dmu_object_info(rwa->os, drrf->drr_object, NULL) != 0)
 		return (SET_ERROR(EINVAL));
 
-	if (drrf->drr_object > rwa->max_object)
-		rwa->max_object = drrf->drr_object;
-
 	err = dmu_free_long_range(rwa->os, drrf->drr_object,
 	    drrf->drr_offset, drrf->drr_length);
 
@@ -3630,10 +3683,6 @@ receive_process_record(struct receive_writer_arg *rwa,
 {
 	int err;
 
-	/* Processing in order, therefore bytes_read should be increasing. */
-	ASSERT3U(rrd->bytes_read, >=, rwa->bytes_read);
-	rwa->bytes_read = rrd->bytes_read;
-
 	switch (rrd->header.drr_type) {
 	case DRR_OBJECT:
 	{
@@ -3710,9 +3759,272 @@ receive_process_record(struct receive_writer_arg *rwa,
 	return (err);
 }
 
+static void
+receive_free_payload(struct receive_record_arg *rrd)
+{
+	if (rrd->arc_buf != NULL) {
+		dmu_return_arcbuf(rrd->arc_buf);
+		rrd->arc_buf = NULL;
+		rrd->payload = NULL;
+	} else if (rrd->payload != NULL) {
+		kmem_free(rrd->payload, rrd->payload_size);
+		rrd->payload = NULL;
+	}
+}
+
+/*
+ * Check that records arrive in the order resuming relies on, and track the
+ * highest object referenced, before the record is handed to a writer.
+ */
+static int
+receive_check_order(struct receive_writer_arg *rwa,
+    struct receive_record_arg *rrd)
+{
+	uint64_t object;
+
+	switch (rrd->header.drr_type) {
+	case DRR_WRITE:
+	{
+		struct drr_write *drrw = &rrd->header.drr_u.drr_write;
+
+		/*
+		 * For resuming to work, records must be in increasing order
+		 * by (object, offset).
+		 */
+		if (drrw->drr_object < rwa->last_object ||
+		    (drrw->drr_object == rwa->last_object &&
+		    drrw->drr_offset < rwa->last_offset)) {
+			return (SET_ERROR(EINVAL));
+		}
+		rwa->last_object = drrw->drr_object;
+		rwa->last_offset = drrw->drr_offset;
+		object = drrw->drr_object;
+		break;
+	}
+	case DRR_WRITE_BYREF:
+		object = rrd->header.drr_u.drr_write_byref.drr_object;
+		break;
+	case DRR_FREE:
+		object = rrd->header.drr_u.drr_free.drr_object;
+		break;
+	default:
+		return (0);
+	}
+
+	if (object > rwa->max_object)
+		rwa->max_object = object;
+
+	return (0);
+}
+
+/*
+ * DRR_WRITE, DRR_WRITE_BYREF and DRR_FREE records only modify the contents
+ * of a single existing object, so records for different objects may be
+ * written concurrently.  Records for the same object go to the same writer
+ * and are written in stream order.  A DRR_WRITE_BYREF record which refers
+ * to a different object in the dataset being received must wait for that
+ * object's writes, and a DRR_FREE record of a resumable receive has no tx
+ * to track the txg it was written in, so those are written in order.
+ */
+static boolean_t
+receive_record_concurrent(struct receive_writer_arg *rwa,
+    struct receive_record_arg *rrd, uint64_t *objectp)
+{
+	switch (rrd->header.drr_type) {
+	case DRR_WRITE:
+		*objectp = rrd->header.drr_u.drr_write.drr_object;
+		return (B_TRUE);
+	case DRR_WRITE_BYREF:
+	{
+		struct drr_write_byref *drrwbr =
+		    &rrd->header.drr_u.drr_write_byref;
+
+		*objectp = drrwbr->drr_object;
+		return (drrwbr->drr_toguid != drrwbr->drr_refguid ||
+		    drrwbr->drr_refobject == drrwbr->drr_object);
+	}
+	case DRR_FREE:
+		*objectp = rrd->header.drr_u.drr_free.drr_object;
+		return (!rwa->resumable);
+	default:
+		return (B_FALSE);
+	}
+}
+
+/*
+ * Record that rrd, and every record preceding it, has been written.
+ */
+static void
+receive_advance_resume(struct receive_writer_arg *rwa,
+    struct receive_record_arg *rrd)
+{
+	uint64_t object, offset;
+
+	ASSERT(MUTEX_HELD(&rwa->writers_lock));
+
+	switch (rrd->header.drr_type) {
+	case DRR_WRITE:
+		object = rrd->header.drr_u.drr_write.drr_object;
+		offset = rrd->header.drr_u.drr_write.drr_offset;
+		break;
+	case DRR_WRITE_BYREF:
+		object = rrd->header.drr_u.drr_write_byref.drr_object;
+		offset = rrd->header.drr_u.drr_write_byref.drr_offset;
+		break;
+	case DRR_WRITE_EMBEDDED:
+		object = rrd->header.drr_u.drr_write_embedded.drr_object;
+		offset = rrd->header.drr_u.drr_write_embedded.drr_offset;
+		break;
+	default:
+		return;
+	}
+
+	rwa->resume_object = object;
+	rwa->resume_offset = offset;
+	rwa->resume_bytes = rrd->bytes_read;
+	rwa->resume_txg = MAX(rwa->resume_txg, rrd->txg);
+}
+
+static void
+receive_writer_task(void *arg)
+{
+	struct receive_record_arg *rrd = arg;
+	struct receive_writer_arg *rwa = rrd->rwa;
+	uint64_t *txgp = &rwa->writer_txg[rrd->writer];
+	int err = 0;
+
+	*txgp = 0;
+	if (rwa->writers_err == 0)
+		err = receive_process_record(rwa, rrd);
+	else
+		receive_free_payload(rrd);
+
+	mutex_enter(&rwa->writers_lock);
+	if (rwa->writers_err == 0)
+		rwa->writers_err = err;
+	rrd->txg = *txgp;
+	rrd->done = B_TRUE;
+
+	/*
+	 * Retire the records at the head of the stream which have been
+	 * written, advancing the position saved for resuming.
+	 */
+	while ((rrd = list_head(&rwa->inflight)) != NULL && rrd->done) {
+		list_remove(&rwa->inflight, rrd);
+		rwa->inflight_bytes -= sizeof (*rrd) + rrd->payload_size;
+		if (rwa->writers_err == 0)
+			receive_advance_resume(rwa, rrd);
+		kmem_free(rrd, sizeof (*rrd));
+	}
+	cv_broadcast(&rwa->writers_cv);
+	mutex_exit(&rwa->writers_lock);
+}
+
+/*
+ * Wait for the writers to write every record queued to them.
+ */
+static int
+receive_writers_drain(struct receive_writer_arg *rwa)
+{
+	int err;
+
+	if (rwa->writers == NULL)
+		return (0);
+
+	mutex_enter(&rwa->writers_lock);
+	while (!list_is_empty(&rwa->inflight))
+		cv_wait(&rwa->writers_cv, &rwa->writers_lock);
+	err = rwa->writers_err;
+	mutex_exit(&rwa->writers_lock);
+
+	return (err);
+}
+
+static int
+receive_writer_dispatch(struct receive_writer_arg *rwa,
+    struct receive_record_arg *rrd, uint64_t object)
+{
+	uint64_t size = sizeof (*rrd) + rrd->payload_size;
+	int err;
+
+	rrd->rwa = rwa;
+	rrd->writer = object % rwa->nwriters;
+	rrd->done = B_FALSE;
+	rrd->txg = 0;
+
+	/*
+	 * Records queued to the writers are no longer bounded by the
+	 * receive queue, so bound them by its length here as well.
+	 */
+	mutex_enter(&rwa->writers_lock);
+	while (rwa->writers_err == 0 && !list_is_empty(&rwa->inflight) &&
+	    rwa->inflight_bytes + size > zfs_recv_queue_length)
+		cv_wait(&rwa->writers_cv, &rwa->writers_lock);
+	err = rwa->writers_err;
+	if (err == 0) {
+		list_insert_tail(&rwa->inflight, rrd);
+		rwa->inflight_bytes += size;
+	}
+	mutex_exit(&rwa->writers_lock);
+
+	if (err != 0) {
+		receive_free_payload(rrd);
+		kmem_free(rrd, sizeof (*rrd));
+		return (err);
+	}
+
+	VERIFY3U(taskq_dispatch(rwa->writers[rrd->writer],
+	    receive_writer_task, rrd, TQ_SLEEP), !=, TASKQID_INVALID);
+
+	return (0);
+}
+
+/*
+ * Hand the record to a writer, or wait for the writers to drain and commit
+ * it to the pool ourselves.  Consumes rrd.
+ */
+static int
+receive_dispatch_record(struct receive_writer_arg *rwa,
+    struct receive_record_arg *rrd)
+{
+	uint64_t object;
+	int err;
+
+	/* Processing in order, therefore bytes_read should be increasing. */
+	ASSERT3U(rrd->bytes_read, >=, rwa->bytes_read);
+	rwa->bytes_read = rrd->bytes_read;
+
+	err = receive_check_order(rwa, rrd);
+	if (err == 0 && rwa->writers != NULL) {
+		if (receive_record_concurrent(rwa, rrd, &object))
+			return (receive_writer_dispatch(rwa, rrd, object));
+		err = receive_writers_drain(rwa);
+	}
+
+	if (err == 0) {
+		err = receive_process_record(rwa, rrd);
+		if (err == 0 && rwa->writers != NULL) {
+			/*
+			 * Nothing else is being written, so every tx assigned
+			 * from now on is in the same or a later txg as this
+			 * record.
+			 */
+			rrd->txg = 0;
+			mutex_enter(&rwa->writers_lock);
+			receive_advance_resume(rwa, rrd);
+			mutex_exit(&rwa->writers_lock);
+		}
+	} else {
+		receive_free_payload(rrd);
+	}
+	kmem_free(rrd, sizeof (*rrd));
+
+	return (err);
+}
+
 /*
  * dmu_recv_stream's worker thread; pull records off the queue, and then call
- * receive_process_record  When we're done, signal the main thread and exit.
+ * receive_dispatch_record  When we're done, signal the main thread and exit.
  */
 static void
 receive_writer_thread(void *arg)
@@ -3720,6 +4032,7 @@ receive_writer_thread(void *arg)
 	struct receive_writer_arg *rwa = arg;
 	struct receive_record_arg *rrd;
 	fstrans_cookie_t cookie = spl_fstrans_mark();
+	int err;
 
 	for (rrd = bqueue_dequeue(&rwa->q); !rrd->eos_marker;
 	    rrd = bqueue_dequeue(&rwa->q)) {
@@ -3729,18 +4042,18 @@ receive_writer_thread(void *arg)
 		 * can exit.
 		 */
 		if (rwa->err == 0) {
-			rwa->err = receive_process_record(rwa, rrd);
-		} else if (rrd->arc_buf != NULL) {
-			dmu_return_arcbuf(rrd->arc_buf);
-			rrd->arc_buf = NULL;
-			rrd->payload = NULL;
-		} else if (rrd->payload != NULL) {
-			kmem_free(rrd->payload, rrd->payload_size);
-			rrd->payload = NULL;
+			rwa->err = receive_dispatch_record(rwa, rrd);
+		} else {
+			receive_free_payload(rrd);
+			kmem_free(rrd, sizeof (*rrd));
 		}
-		kmem_free(rrd, sizeof (*rrd));
 	}
 	kmem_free(rrd, sizeof (*rrd));
+
+	err = receive_writers_drain(rwa);
+	if (rwa->err == 0)
+		rwa->err = err;
+
 	mutex_enter(&rwa->mutex);
 	rwa->done = B_TRUE;
 	cv_signal(&rwa->cv);
@@ -3783,7 +4096,9 @@ resume_check(struct receive_arg *ra, nvlist_t *begin_nvl)
  * onto an internal blocking queue.  The worker thread will pull the records off
  * the queue, and actually write the data into the DMU.  This way, the worker
  * thread doesn't have to wait for reads to complete, since everything it needs
- * (the indirect blocks) will be prefetched.
+ * (the indirect blocks) will be prefetched.  The worker thread in turn hands
+ * writes and frees of different objects to a set of writer taskqs, see
+ * receive_record_concurrent().
  *
  * NB: callers *must* call dmu_recv_end() if this succeeds.
  */
@@ -3798,6 +4113,7 @@ dmu_recv_stream(dmu_recv_cookie_t *drc, vnode_t *vp, offset_t *voffp,
 	uint32_t payloadlen;
 	void *payload;
 	nvlist_t *begin_nvl = NULL;
+	int nwriters;
 
 	ra = kmem_zalloc(sizeof (*ra), KM_SLEEP);
 	rwa = kmem_zalloc(sizeof (*rwa), KM_SLEEP);
@@ -3931,6 +4247,24 @@ dmu_recv_stream(dmu_recv_cookie_t *drc, vnode_t *vp, offset_t *voffp,
 	rwa->raw = drc->drc_raw;
 	rwa->os->os_raw_receive = drc->drc_raw;
 
+	mutex_init(&rwa->writers_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&rwa->writers_cv, NULL, CV_DEFAULT, NULL);
+	list_create(&rwa->inflight, sizeof (struct receive_record_arg),
+	    offsetof(struct receive_record_arg, inflight_node));
+	nwriters = zfs_recv_write_threads > 0 ?
+	    zfs_recv_write_threads : boot_ncpus;
+	if (nwriters > 1) {
+		rwa->nwriters = nwriters;
+		rwa->writers = kmem_alloc(nwriters * sizeof (taskq_t *),
+		    KM_SLEEP);
+		rwa->writer_txg = kmem_zalloc(nwriters * sizeof (uint64_t),
+		    KM_SLEEP);
+		for (int i = 0; i < nwriters; i++) {
+			rwa->writers[i] = taskq_create("z_recv_write", 1,
+			    minclsyspri, 1, INT_MAX, TASKQ_PREPOPULATE);
+		}
+	}
+
 	(void) thread_create(NULL, 0, receive_writer_thread, rwa, 0, curproc,
 	    TS_RUN, minclsyspri);
 	/*
@@ -4007,6 +4341,15 @@ dmu_recv_stream(dmu_recv_cookie_t *drc, vnode_t *vp, offset_t *voffp,
 		}
 	}
 
+	if (rwa->writers != NULL) {
+		for (int i = 0; i < rwa->nwriters; i++)
+			taskq_destroy(rwa->writers[i]);
+		kmem_free(rwa->writers, rwa->nwriters * sizeof (taskq_t *));
+		kmem_free(rwa->writer_txg, rwa->nwriters * sizeof (uint64_t));
+	}
+	list_destroy(&rwa->inflight);
+	cv_destroy(&rwa->writers_cv);
+	mutex_destroy(&rwa->writers_lock);
 	cv_destroy(&rwa->cv);
 	mutex_destroy(&rwa->mutex);
 	bqueue_destroy(&rwa->q);
@@ -4358,4 +4701,8 @@ MODULE_PARM_DESC(zfs_send_queue_length, "Maximum send queue length");
 
 module_param(zfs_recv_queue_length, int, 0644);
 MODULE_PARM_DESC(zfs_recv_queue_length, "Maximum receive queue length");
+
+module_param(zfs_recv_write_threads, int, 0644);
+MODULE_PARM_DESC(zfs_recv_write_threads,
+	"Threads writing received records concurrently (0 = one per CPU)");
 #endif
@@ -118,7 +118,7 @@ traverse_zil_record(zilog_t *zilog, lr_t *lrc, void *arg, uint64_t claim_txg)
 }
 
 static void
-traverse_zil(traverse_data_t *td, zil_header_t *zh)
+traverse_zil(traverse_data_t *td, zil_header_t *zh, zil_chain_head_t *zch)
 {
 	uint64_t claim_txg = zh->zh_claim_txg;
 
@@ -129,7 +129,8 @@ traverse_zil(traverse_data_t *td, zil_header_t *zh)
 	if (claim_txg == 0 && spa_writeable(td->td_spa))
 		return;
 
-	zilog_t *zilog = zil_alloc(spa_get_dsl(td->td_spa)->dp_meta_objset, zh);
+	zilog_t *zilog = zil_alloc(spa_get_dsl(td->td_spa)->dp_meta_objset, zh,
+	    zch);
 	(void) zil_parse(zilog, traverse_zil_block, traverse_zil_record, td,
 	    claim_txg, !(td->td_flags & TRAVERSE_NO_DECRYPT));
 	zil_free(zilog);
@@ -653,7 +654,9 @@ traverse_impl(spa_t *spa, dsl_dataset_t *ds, uint64_t objset, blkptr_t *rootbp,
 				goto out;
 		} else {
 			osp = buf->b_data;
-			traverse_zil(td, &osp->os_zil_header);
+			traverse_zil(td, &osp->os_zil_header,
+			    OBJSET_BUF_HAS_PROJECTUSED(buf) ?
+			    osp->os_zil_chains : NULL);
 			arc_buf_destroy(buf, &buf);
 		}
 	}
@@ -54,6 +54,8 @@ unsigned int	zfetch_max_distance = 8 * 1024 * 1024;
 unsigned int	zfetch_max_idistance = 64 * 1024 * 1024;
 /* max number of bytes in an array_read in which we allow prefetching (1MB) */
 unsigned long	zfetch_array_rd_sz = 1024 * 1024;
+/* min bytes read by a stream before it is cached as a scan (default 64MB) */
+unsigned int	zfetch_scan_distance = 64 * 1024 * 1024;
 
 typedef struct zfetch_stats {
 	kstat_named_t zfetchstat_hits;
@@ -187,6 +189,7 @@ dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid)
 	}
 
 	zstream_t *zs = kmem_zalloc(sizeof (*zs), KM_SLEEP);
+	zs->zs_start_blkid = blkid;
 	zs->zs_blkid = blkid;
 	zs->zs_pf_blkid = blkid;
 	zs->zs_ipf_blkid = blkid;
@@ -214,6 +217,7 @@ dmu_zfetch(zfetch_t *zf, uint64_t blkid, uint64_t nblks, boolean_t fetch_data)
 	uint64_t end_of_access_blkid;
 	end_of_access_blkid = blkid + nblks;
 	spa_t *spa = zf->zf_dnode->dn_objset->os_spa;
+	arc_flags_t pf_aflags = ARC_FLAG_PREDICTIVE_PREFETCH;
 
 	if (zfs_prefetch_disable)
 		return;
@@ -335,6 +339,19 @@ dmu_zfetch(zfetch_t *zf, uint64_t blkid, uint64_t nblks, boolean_t fetch_data)
 	ipf_istart = P2ROUNDUP(ipf_start, 1 << epbs) >> epbs;
 	ipf_iend = P2ROUNDUP(zs->zs_ipf_blkid, 1 << epbs) >> epbs;
 
+	/*
+	 * A stream that has read zfetch_scan_distance bytes sequentially is
+	 * most likely a single pass over a large file (e.g. a backup or a
+	 * copy).  Ask the ARC to cache the data blocks we prefetch for it at
+	 * the cold end, so that it does not flush the working set.
+	 */
+	if (zfetch_scan_distance != 0 &&
+	    zf->zf_dnode->dn_objset->os_scan_cache == ZFS_SCANCACHE_AUTO &&
+	    !DMU_OT_IS_METADATA(zf->zf_dnode->dn_type) &&
+	    (end_of_access_blkid - zs->zs_start_blkid) *
+	    zf->zf_dnode->dn_datablksz >= zfetch_scan_distance)
+		pf_aflags |= ARC_FLAG_SCAN;
+
 	zs->zs_atime = gethrtime();
 	zs->zs_blkid = end_of_access_blkid;
 	mutex_exit(&zs->zs_lock);
@@ -348,7 +365,7 @@ dmu_zfetch(zfetch_t *zf, uint64_t blkid, uint64_t nblks, boolean_t fetch_data)
 
 	for (int i = 0; i < pf_nblks; i++) {
 		dbuf_prefetch(zf->zf_dnode, 0, pf_start + i,
-		    ZIO_PRIORITY_ASYNC_READ, ARC_FLAG_PREDICTIVE_PREFETCH);
+		    ZIO_PRIORITY_ASYNC_READ, pf_aflags);
 	}
 	for (int64_t iblk = ipf_istart; iblk < ipf_iend; iblk++) {
 		dbuf_prefetch(zf->zf_dnode, 1, iblk,
@@ -374,5 +391,9 @@ MODULE_PARM_DESC(zfetch_max_distance,
 
 module_param(zfetch_array_rd_sz, ulong, 0644);
 MODULE_PARM_DESC(zfetch_array_rd_sz, "Number of bytes in a array_read");
+
+module_param(zfetch_scan_distance, uint, 0644);
+MODULE_PARM_DESC(zfetch_scan_distance,
+	"Min bytes read by a stream before it is cached as a scan");
 /* END CSTYLED */
 #endif
@@ -1205,7 +1205,7 @@ dsl_scan_check_suspend(dsl_scan_t *scn, const zbookmark_phys_t *zb)
 
 typedef struct zil_scan_arg {
 	dsl_pool_t	*zsa_dp;
-	zil_header_t	*zsa_zh;
+	uint64_t	zsa_objset;
 } zil_scan_arg_t;
 
 /* ARGSUSED */
@@ -1215,7 +1215,6 @@ dsl_scan_zil_block(zilog_t *zilog, blkptr_t *bp, void *arg, uint64_t claim_txg)
 	zil_scan_arg_t *zsa = arg;
 	dsl_pool_t *dp = zsa->zsa_dp;
 	dsl_scan_t *scn = dp->dp_scan;
-	zil_header_t *zh = zsa->zsa_zh;
 	zbookmark_phys_t zb;
 
 	if (BP_IS_HOLE(bp) || bp->blk_birth <= scn->scn_phys.scn_cur_min_txg)
@@ -1230,8 +1229,8 @@ dsl_scan_zil_block(zilog_t *zilog, blkptr_t *bp, void *arg, uint64_t claim_txg)
 	if (claim_txg == 0 && bp->blk_birth >= spa_min_claim_txg(dp->dp_spa))
 		return (0);
 
-	SET_BOOKMARK(&zb, zh->zh_log.blk_cksum.zc_word[ZIL_ZC_OBJSET],
-	    ZB_ZIL_OBJECT, ZB_ZIL_LEVEL, bp->blk_cksum.zc_word[ZIL_ZC_SEQ]);
+	SET_BOOKMARK(&zb, zsa->zsa_objset, ZB_ZIL_OBJECT, ZB_ZIL_LEVEL,
+	    bp->blk_cksum.zc_word[ZIL_ZC_SEQ]);
 
 	VERIFY(0 == scan_funcs[scn->scn_phys.scn_func](dp, bp, &zb));
 	return (0);
@@ -1245,7 +1244,6 @@ dsl_scan_zil_record(zilog_t *zilog, lr_t *lrc, void *arg, uint64_t claim_txg)
 		zil_scan_arg_t *zsa = arg;
 		dsl_pool_t *dp = zsa->zsa_dp;
 		dsl_scan_t *scn = dp->dp_scan;
-		zil_header_t *zh = zsa->zsa_zh;
 		lr_write_t *lr = (lr_write_t *)lrc;
 		blkptr_t *bp = &lr->lr_blkptr;
 		zbookmark_phys_t zb;
@@ -1262,8 +1260,7 @@ dsl_scan_zil_record(zilog_t *zilog, lr_t *lrc, void *arg, uint64_t claim_txg)
 		if (claim_txg == 0 || bp->blk_birth < claim_txg)
 			return (0);
 
-		SET_BOOKMARK(&zb, zh->zh_log.blk_cksum.zc_word[ZIL_ZC_OBJSET],
-		    lr->lr_foid, ZB_ZIL_LEVEL,
+		SET_BOOKMARK(&zb, zsa->zsa_objset, lr->lr_foid, ZB_ZIL_LEVEL,
 		    lr->lr_offset / BP_GET_LSIZE(bp));
 
 		VERIFY(0 == scan_funcs[scn->scn_phys.scn_func](dp, bp, &zb));
@@ -1272,10 +1269,11 @@ dsl_scan_zil_record(zilog_t *zilog, lr_t *lrc, void *arg, uint64_t claim_txg)
 }
 
 static void
-dsl_scan_zil(dsl_pool_t *dp, zil_header_t *zh)
+dsl_scan_zil(dsl_pool_t *dp, objset_t *os)
 {
+	zil_header_t *zh = &os->os_zil_header;
 	uint64_t claim_txg = zh->zh_claim_txg;
-	zil_scan_arg_t zsa = { dp, zh };
+	zil_scan_arg_t zsa = { dp, dmu_objset_id(os) };
 	zilog_t *zilog;
 
 	ASSERT(spa_writeable(dp->dp_spa));
@@ -1287,7 +1285,9 @@ dsl_scan_zil(dsl_pool_t *dp, zil_header_t *zh)
 	if (claim_txg == 0)
 		return;
 
-	zilog = zil_alloc(dp->dp_meta_objset, zh);
+	zilog = zil_alloc(dp->dp_meta_objset, zh,
+	    OBJSET_BUF_HAS_PROJECTUSED(os->os_phys_buf) ?
+	    os->os_zil_chains : NULL);
 
 	(void) zil_parse(zilog, dsl_scan_zil_block, dsl_scan_zil_record, &zsa,
 	    claim_txg, B_FALSE);
@@ -2184,7 +2184,7 @@ dsl_scan_visitds(dsl_scan_t *scn, uint64_t dsobj, dmu_tx_t *tx)
 		if (dmu_objset_from_ds(ds, &os) != 0) {
 			goto out;
 		}
-		dsl_scan_zil(dp, &os->os_zil_header);
+		dsl_scan_zil(dp, os);
 	}
 
 	/*
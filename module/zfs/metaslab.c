@@ -181,6 +181,21 @@ int metaslab_lba_weighting_enabled = B_TRUE;
  */
 int metaslab_bias_enabled = B_TRUE;
 
+/*
+ * Enable/disable weighting metaslab groups by their measured write
+ * throughput.  See metaslab_class_perf_update().
+ */
+int metaslab_perf_bias_enabled = B_TRUE;
+
+/*
+ * A group's throughput is only measured in txgs in which at least this
+ * many bytes were written to it, and its weight is kept within these
+ * bounds so that a slow group is still written to, and measured.
+ */
+#define	METASLAB_PERF_MIN_BYTES		(1ULL << 20)
+#define	METASLAB_PERF_MIN_WEIGHT	25
+#define	METASLAB_PERF_MAX_WEIGHT	400
+
 
 /*
  * Enable/disable remapping of indirect DVAs to their concrete vdevs.
@@ -647,6 +662,7 @@ metaslab_group_create(metaslab_class_t *mc, vdev_t *vd, int allocators)
 	mg->mg_initialized = B_FALSE;
 	mg->mg_no_free_space = B_TRUE;
 	mg->mg_allocators = allocators;
+	mg->mg_perf_weight = 100;
 
 	mg->mg_alloc_queue_depth = kmem_zalloc(allocators *
 	    sizeof (zfs_refcount_t), KM_SLEEP);
@@ -1533,6 +1549,7 @@ metaslab_init(metaslab_group_t *mg, uint64_t id, uint64_t object, uint64_t txg,
 	 */
 	ms->ms_allocatable = range_tree_create_impl(&rt_avl_ops,
 	    &ms->ms_allocatable_by_size, metaslab_rangesize_compare, 0);
+	ms->ms_trim = range_tree_create(NULL, NULL);
 	metaslab_group_add(mg, ms);
 
 	metaslab_set_fragmentation(ms);
@@ -1602,6 +1619,10 @@ metaslab_fini(metaslab_t *msp)
 
 	range_tree_destroy(msp->ms_checkpointing);
 
+	ASSERT0(msp->ms_trimming);
+	range_tree_vacate(msp->ms_trim, NULL, NULL);
+	range_tree_destroy(msp->ms_trim);
+
 	mutex_exit(&msp->ms_lock);
 	cv_destroy(&msp->ms_load_cv);
 	mutex_destroy(&msp->ms_lock);
@@ -2565,6 +2586,20 @@ metaslab_sync(metaslab_t *msp, uint64_t txg)
 	dmu_tx_commit(tx);
 }
 
+/*
+ * Queue a freed range for autotrim.  The range is cleared first since
+ * ms_trim may still hold part of it if it was claimed and freed again
+ * without going through metaslab_block_alloc().
+ */
+static void
+metaslab_trim_add(void *arg, uint64_t offset, uint64_t size)
+{
+	metaslab_t *msp = arg;
+
+	range_tree_clear(msp->ms_trim, offset, size);
+	range_tree_add(msp->ms_trim, offset, size);
+}
+
 /*
  * Called after a transaction group has completely synced to mark
  * all of the metaslab's free space as usable.
@@ -2640,6 +2675,18 @@ metaslab_sync_done(metaslab_t *msp, uint64_t txg)
 	 */
 	metaslab_load_wait(msp);
 
+	/*
+	 * The frees which are about to become allocatable again are
+	 * queued for autotrim.
+	 */
+	if (spa_get_autotrim(spa) == ZPOOL_AUTOTRIM_ON) {
+		range_tree_walk(*defer_tree, metaslab_trim_add, msp);
+		if (!defer_allowed) {
+			range_tree_walk(msp->ms_freed, metaslab_trim_add,
+			    msp);
+		}
+	}
+
 	/*
 	 * Move the frees from the defer_tree back to the free
 	 * range tree (if it's loaded). Swap the freed_tree and
@@ -2959,6 +3006,94 @@ metaslab_group_alloc_verify(spa_t *spa, const blkptr_t *bp, void *tag,
 #endif
 }
 
+/*
+ * Account for an async write of the given size, queued at the given time,
+ * which has just completed on the group's vdev.
+ */
+void
+metaslab_group_perf_sample(metaslab_group_t *mg, uint64_t size,
+    hrtime_t queued)
+{
+	hrtime_t start;
+
+	atomic_add_64(&mg->mg_perf_bytes, size);
+	mg->mg_perf_end = gethrtime();
+
+	while ((start = mg->mg_perf_start) == 0 || queued < start) {
+		if (atomic_cas_64((uint64_t *)&mg->mg_perf_start, start,
+		    queued) == start)
+			break;
+	}
+}
+
+/*
+ * Scale a queue depth by the group's weight.
+ */
+uint64_t
+metaslab_group_perf_scale(metaslab_group_t *mg, uint64_t depth)
+{
+	if (!metaslab_perf_bias_enabled)
+		return (depth);
+
+	return (MAX(depth * mg->mg_perf_weight / 100, 1));
+}
+
+/*
+ * Update the throughput of each group in the class from the writes of the
+ * last txg, and weight each group by its throughput relative to the class
+ * average.  Called from spa_sync() before any allocations are made, so no
+ * async writes are in flight.
+ */
+void
+metaslab_class_perf_update(metaslab_class_t *mc)
+{
+	metaslab_group_t *mg, *rotor = mc->mc_rotor;
+	uint64_t total = 0, groups = 0;
+
+	if (rotor == NULL)
+		return;
+
+	mg = rotor;
+	do {
+		uint64_t bytes = mg->mg_perf_bytes;
+		hrtime_t delta = mg->mg_perf_end - mg->mg_perf_start;
+
+		if (bytes >= METASLAB_PERF_MIN_BYTES && delta > 0) {
+			uint64_t rate = bytes * NANOSEC / delta;
+
+			/*
+			 * Give the latest txg a quarter of the weight, so a
+			 * single slow txg doesn't swing the weights.
+			 */
+			if (mg->mg_perf_rate == 0)
+				mg->mg_perf_rate = rate;
+			else
+				mg->mg_perf_rate = (mg->mg_perf_rate * 3 +
+				    rate) / 4;
+		}
+		mg->mg_perf_bytes = 0;
+		mg->mg_perf_start = 0;
+		mg->mg_perf_end = 0;
+
+		if (mg->mg_perf_rate != 0) {
+			total += mg->mg_perf_rate;
+			groups++;
+		}
+	} while ((mg = mg->mg_next) != rotor);
+
+	do {
+		uint64_t weight = 100;
+
+		if (metaslab_perf_bias_enabled && groups > 1 &&
+		    mg->mg_perf_rate != 0) {
+			weight = mg->mg_perf_rate * groups * 100 / total;
+			weight = MIN(MAX(weight, METASLAB_PERF_MIN_WEIGHT),
+			    METASLAB_PERF_MAX_WEIGHT);
+		}
+		mg->mg_perf_weight = weight;
+	} while ((mg = mg->mg_next) != rotor);
+}
+
 static uint64_t
 metaslab_block_alloc(metaslab_t *msp, uint64_t size, uint64_t txg)
 {
@@ -2977,6 +3112,7 @@ metaslab_block_alloc(metaslab_t *msp, uint64_t size, uint64_t txg)
 		VERIFY0(P2PHASE(size, 1ULL << vd->vdev_ashift));
 		VERIFY3U(range_tree_space(rt) - size, <=, msp->ms_size);
 		range_tree_remove(rt, start, size);
+		range_tree_clear(msp->ms_trim, start, size);
 
 		if (range_tree_is_empty(msp->ms_allocating[txg & TXG_MASK]))
 			vdev_dirty(mg->mg_vd, VDD_METASLAB, msp, txg);
@@ -3027,9 +3163,10 @@ find_valid_metaslab(metaslab_group_t *mg, uint64_t activation_weight,
 		}
 
 		/*
-		 * If the selected metaslab is condensing, skip it.
+		 * If the selected metaslab is condensing or being trimmed,
+		 * skip it.
 		 */
-		if (msp->ms_condensing)
+		if (msp->ms_condensing || msp->ms_trimming > 0)
 			continue;
 
 		*was_active = msp->ms_allocator != -1;
@@ -3201,6 +3338,19 @@ metaslab_group_alloc_normal(metaslab_group_t *mg, zio_alloc_list_t *zal,
 			continue;
 		}
 
+		/*
+		 * Likewise, the free space of a metaslab which is being
+		 * trimmed must not be handed out until the trim completes.
+		 */
+		if (msp->ms_trimming > 0) {
+			metaslab_trace_add(zal, mg, msp, asize, d,
+			    TRACE_TRIMMING, allocator);
+			metaslab_passivate(msp, msp->ms_weight &
+			    ~METASLAB_ACTIVE_MASK);
+			mutex_exit(&msp->ms_lock);
+			continue;
+		}
+
 		offset = metaslab_block_alloc(msp, asize, txg);
 		metaslab_trace_add(zal, mg, msp, asize, d, offset, allocator);
 
@@ -3494,9 +3644,19 @@ top:
 				mg->mg_bias = 0;
 			}
 
+			/*
+			 * Faster groups get a proportionately larger share
+			 * of each iteration around the rotor.
+			 */
+			int64_t aliquot = mg->mg_aliquot + mg->mg_bias;
+			if (metaslab_perf_bias_enabled) {
+				aliquot = aliquot *
+				    (int64_t)mg->mg_perf_weight / 100;
+			}
+
 			if ((flags & METASLAB_FASTWRITE) ||
 			    atomic_add_64_nv(&mc->mc_aliquot, asize) >=
-			    mg->mg_aliquot + mg->mg_bias) {
+			    aliquot) {
 				mc->mc_rotor = mg->mg_next;
 				mc->mc_aliquot = 0;
 			}
@@ -3911,6 +4071,7 @@ metaslab_claim_concrete(vdev_t *vd, uint64_t offset, uint64_t size,
 	VERIFY3U(range_tree_space(msp->ms_allocatable) - size, <=,
 	    msp->ms_size);
 	range_tree_remove(msp->ms_allocatable, offset, size);
+	range_tree_clear(msp->ms_trim, offset, size);
 
 	if (spa_writeable(spa)) {	/* don't dirty if we're zdb(1M) */
 		if (range_tree_is_empty(msp->ms_allocating[txg & TXG_MASK]))
@@ -4294,6 +4455,10 @@ module_param(metaslab_bias_enabled, int, 0644);
 MODULE_PARM_DESC(metaslab_bias_enabled,
 	"enable metaslab group biasing");
 
+module_param(metaslab_perf_bias_enabled, int, 0644);
+MODULE_PARM_DESC(metaslab_perf_bias_enabled,
+	"enable metaslab group biasing by measured write throughput");
+
 module_param(zfs_metaslab_segment_weight_enabled, int, 0644);
 MODULE_PARM_DESC(zfs_metaslab_segment_weight_enabled,
 	"enable segment-based metaslab selection");
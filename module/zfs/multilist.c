@@ -141,17 +141,8 @@ multilist_destroy(multilist_t *ml)
 	kmem_free(ml, sizeof (multilist_t));
 }
 
-/*
- * Insert the given object into the multilist.
- *
- * This function will insert the object specified into the sublist
- * determined using the function given at multilist creation time.
- *
- * The sublist locks are automatically acquired if not already held, to
- * ensure consistency when inserting and removing from multiple threads.
- */
-void
-multilist_insert(multilist_t *ml, void *obj)
+static void
+multilist_insert_impl(multilist_t *ml, void *obj, boolean_t tail)
 {
 	unsigned int sublist_idx = ml->ml_index_func(ml, obj);
 	multilist_sublist_t *mls;
@@ -180,12 +171,40 @@ multilist_insert(multilist_t *ml, void *obj)
 
 	ASSERT(!multilist_link_active(multilist_d2l(ml, obj)));
 
-	multilist_sublist_insert_head(mls, obj);
+	if (tail)
+		multilist_sublist_insert_tail(mls, obj);
+	else
+		multilist_sublist_insert_head(mls, obj);
 
 	if (need_lock)
 		mutex_exit(&mls->mls_lock);
 }
 
+/*
+ * Insert the given object into the multilist.
+ *
+ * This function will insert the object specified into the sublist
+ * determined using the function given at multilist creation time.
+ *
+ * The sublist locks are automatically acquired if not already held, to
+ * ensure consistency when inserting and removing from multiple threads.
+ */
+void
+multilist_insert(multilist_t *ml, void *obj)
+{
+	multilist_insert_impl(ml, obj, B_FALSE);
+}
+
+/*
+ * Same as multilist_insert(), but the object is placed at the tail of
+ * its sublist rather than at the head.
+ */
+void
+multilist_insert_tail(multilist_t *ml, void *obj)
+{
+	multilist_insert_impl(ml, obj, B_TRUE);
+}
+
 /*
  * Remove the given object from the multilist.
  *
@@ -208,7 +227,7 @@ multilist_remove(multilist_t *ml, void *obj)
 	ASSERT3U(sublist_idx, <, ml->ml_num_sublists);
 
 	mls = &ml->ml_sublists[sublist_idx];
-	/* See comment in multilist_insert(). */
+	/* See comment in multilist_insert_impl(). */
 	need_lock = !MUTEX_HELD(&mls->mls_lock);
 
 	if (need_lock)
@@ -243,7 +262,7 @@ multilist_is_empty(multilist_t *ml)
 {
 	for (int i = 0; i < ml->ml_num_sublists; i++) {
 		multilist_sublist_t *mls = &ml->ml_sublists[i];
-		/* See comment in multilist_insert(). */
+		/* See comment in multilist_insert_impl(). */
 		boolean_t need_lock = !MUTEX_HELD(&mls->mls_lock);
 
 		if (need_lock)
@@ -77,6 +77,88 @@ bswap:
 	zcp->zc_word[3] = BE_64(tmp.zc_word[3]);
 }
 
+typedef struct sha256_many {
+	SHA256_MB_CTX	sm_ctx;
+	zio_cksum_t	sm_digests[SHA256_MB_MAX_LANES];
+	abd_t		*sm_abds[SHA256_MB_MAX_LANES];
+	size_t		sm_sizes[SHA256_MB_MAX_LANES];
+	int		sm_lanes[SHA256_MB_MAX_LANES];
+} sha256_many_t;
+
+static int
+sha_many_incremental(void **bufs, size_t size, void *arg)
+{
+	SHA256_MB_CTX *ctx = arg;
+	SHA256MBUpdate(ctx, (const void **)bufs, size);
+	return (0);
+}
+
+/*
+ * Returns how many blocks of the given size abd_checksum_SHA256_many()
+ * checksums at the cost of one, or 1 if it has nothing to gain.
+ */
+int
+abd_checksum_SHA256_degree(uint64_t size)
+{
+#if defined(_KERNEL) && !defined(_LP64)
+	/* abd_iterate_many_func() maps the chunks of all ABDs at once */
+	return (1);
+#else
+	if (size % SHA256_BLOCK_LENGTH != 0 || qat_checksum_use_accel(size))
+		return (1);
+
+	return (SHA256MBDegree());
+#endif
+}
+
+/*
+ * Checksums n ABDs at once with the multi-buffer SHA256 implementation.
+ * Blocks which would be offloaded to QAT, or which are not a whole number
+ * of SHA256 blocks, are checksummed one at a time.
+ */
+/*ARGSUSED*/
+void
+abd_checksum_SHA256_many(abd_t **abds, const uint64_t *sizes, int n,
+    const void *ctx_template, zio_cksum_t *zcps)
+{
+	sha256_many_t *sm;
+	int i, lanes = 0;
+
+	ASSERT3S(n, <=, SHA256_MB_MAX_LANES);
+
+	sm = kmem_alloc(sizeof (*sm), KM_SLEEP);
+	for (i = 0; i < n; i++) {
+		if (abd_checksum_SHA256_degree(sizes[i]) == 1) {
+			abd_checksum_SHA256(abds[i], sizes[i], ctx_template,
+			    &zcps[i]);
+			continue;
+		}
+		sm->sm_abds[lanes] = abds[i];
+		sm->sm_sizes[lanes] = sizes[i];
+		sm->sm_lanes[lanes] = i;
+		lanes++;
+	}
+
+	if (lanes > 0) {
+		SHA256MBInit(&sm->sm_ctx, lanes);
+		(void) abd_iterate_many_func(sm->sm_abds, sm->sm_sizes, lanes,
+		    sha_many_incremental, &sm->sm_ctx);
+		SHA256MBFinal(sm->sm_digests, &sm->sm_ctx);
+	}
+
+	for (i = 0; i < lanes; i++) {
+		zio_cksum_t *tmp = &sm->sm_digests[i];
+		zio_cksum_t *zcp = &zcps[sm->sm_lanes[i]];
+
+		/* See the comment in abd_checksum_SHA256() */
+		zcp->zc_word[0] = BE_64(tmp->zc_word[0]);
+		zcp->zc_word[1] = BE_64(tmp->zc_word[1]);
+		zcp->zc_word[2] = BE_64(tmp->zc_word[2]);
+		zcp->zc_word[3] = BE_64(tmp->zc_word[3]);
+	}
+	kmem_free(sm, sizeof (*sm));
+}
+
 /*ARGSUSED*/
 void
 abd_checksum_SHA512_native(abd_t *abd, uint64_t size,
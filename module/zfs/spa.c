@@ -54,6 +54,7 @@
 #include <sys/ddt.h>
 #include <sys/vdev_impl.h>
 #include <sys/vdev_removal.h>
+#include <sys/vdev_trim.h>
 #include <sys/vdev_indirect_mapping.h>
 #include <sys/vdev_indirect_births.h>
 #include <sys/vdev_disk.h>
@@ -149,6 +150,7 @@ const zio_taskq_info_t zio_taskqs[ZIO_TYPES][ZIO_TASKQ_TYPES] = {
 	{ ZTI_P(12, 8),	ZTI_NULL,	ZTI_ONE,	ZTI_NULL }, /* FREE */
 	{ ZTI_ONE,	ZTI_NULL,	ZTI_ONE,	ZTI_NULL }, /* CLAIM */
 	{ ZTI_ONE,	ZTI_NULL,	ZTI_ONE,	ZTI_NULL }, /* IOCTL */
+	{ ZTI_N(4),	ZTI_NULL,	ZTI_ONE,	ZTI_NULL }, /* TRIM */
 };
 
 static void spa_sync_version(void *arg, dmu_tx_t *tx);
@@ -552,6 +554,7 @@ spa_prop_validate(spa_t *spa, nvlist_t *props)
 		case ZPOOL_PROP_AUTOREPLACE:
 		case ZPOOL_PROP_LISTSNAPS:
 		case ZPOOL_PROP_AUTOEXPAND:
+		case ZPOOL_PROP_AUTOTRIM:
 			error = nvpair_value_uint64(elem, &intval);
 			if (!error && intval > 1)
 				error = SET_ERROR(EINVAL);
@@ -1437,6 +1440,17 @@ spa_unload(spa_t *spa)
 	 */
 	spa_async_suspend(spa);
 
+	/*
+	 * Stop any L2ARC rebuilds, which hold the config lock as reader.
+	 */
+	l2arc_spa_rebuild_stop(spa);
+
+	/*
+	 * Stop the trim threads, which also hold the config lock as reader.
+	 */
+	vdev_autotrim_stop_all(spa);
+	vdev_trim_stop_all(spa, VDEV_TRIM_ACTIVE);
+
 	/*
 	 * Stop syncing.
 	 */
@@ -3494,6 +3508,7 @@ spa_ld_get_props(spa_t *spa)
 		spa_prop_find(spa, ZPOOL_PROP_DELEGATION, &spa->spa_delegation);
 		spa_prop_find(spa, ZPOOL_PROP_FAILUREMODE, &spa->spa_failmode);
 		spa_prop_find(spa, ZPOOL_PROP_AUTOEXPAND, &spa->spa_autoexpand);
+		spa_prop_find(spa, ZPOOL_PROP_AUTOTRIM, &spa->spa_autotrim);
 		spa_prop_find(spa, ZPOOL_PROP_MULTIHOST, &spa->spa_multihost);
 		spa_prop_find(spa, ZPOOL_PROP_DEDUPDITTO,
 		    &spa->spa_dedup_ditto);
@@ -4240,6 +4255,11 @@ spa_load_impl(spa_t *spa, spa_import_type_t type, char **ereport)
 		spa_restart_removal(spa);
 
 		spa_spawn_aux_threads(spa);
+
+		/*
+		 * Start the autotrim threads if the property is on.
+		 */
+		spa_async_request(spa, SPA_ASYNC_AUTOTRIM_RESTART);
 	}
 
 	spa_load_note(spa, "LOADED");
@@ -5240,6 +5260,7 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 	spa->spa_delegation = zpool_prop_default_numeric(ZPOOL_PROP_DELEGATION);
 	spa->spa_failmode = zpool_prop_default_numeric(ZPOOL_PROP_FAILUREMODE);
 	spa->spa_autoexpand = zpool_prop_default_numeric(ZPOOL_PROP_AUTOEXPAND);
+	spa->spa_autotrim = zpool_prop_default_numeric(ZPOOL_PROP_AUTOTRIM);
 	spa->spa_multihost = zpool_prop_default_numeric(ZPOOL_PROP_MULTIHOST);
 
 	if (props != NULL) {
@@ -6839,6 +6860,101 @@ spa_vdev_setfru(spa_t *spa, uint64_t guid, const char *newfru)
 	return (spa_vdev_set_common(spa, guid, newfru, B_FALSE));
 }
 
+static int
+spa_vdev_trim_impl(spa_t *spa, uint64_t guid, uint64_t cmd_type,
+    uint64_t rate)
+{
+	vdev_t *vd, *tvd;
+	int error = 0;
+
+	/*
+	 * The namespace lock prevents the vdev tree from changing, it is
+	 * held across vdev_trim_stop() which must not be called with the
+	 * config lock held since the trim threads acquire it.
+	 */
+	mutex_enter(&spa_namespace_lock);
+
+	spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
+	vd = spa_lookup_by_guid(spa, guid, B_FALSE);
+	if (vd == NULL || vd->vdev_detached) {
+		error = SET_ERROR(ENODEV);
+	} else if (!vdev_is_concrete(vd->vdev_top)) {
+		error = SET_ERROR(ENOTSUP);
+	} else if (vd->vdev_top->vdev_removing) {
+		error = SET_ERROR(EBUSY);
+	} else if (!vdev_writeable(vd)) {
+		error = SET_ERROR(EROFS);
+	}
+	spa_config_exit(spa, SCL_CONFIG, FTAG);
+
+	if (error != 0) {
+		mutex_exit(&spa_namespace_lock);
+		return (error);
+	}
+
+	tvd = vd->vdev_top;
+	mutex_enter(&tvd->vdev_trim_lock);
+	switch (cmd_type) {
+	case POOL_TRIM_START:
+		if (tvd->vdev_trim_thread != NULL) {
+			/* Only the rate of a running trim can be changed */
+			tvd->vdev_trim_rate = rate;
+			cv_broadcast(&tvd->vdev_trim_cv);
+		} else {
+			vdev_trim(tvd, rate);
+		}
+		break;
+	case POOL_TRIM_CANCEL:
+		if (tvd->vdev_trim_state != VDEV_TRIM_ACTIVE &&
+		    tvd->vdev_trim_state != VDEV_TRIM_SUSPENDED)
+			error = SET_ERROR(ESRCH);
+		else
+			vdev_trim_stop(tvd, VDEV_TRIM_CANCELED);
+		break;
+	case POOL_TRIM_SUSPEND:
+		if (tvd->vdev_trim_state != VDEV_TRIM_ACTIVE)
+			error = SET_ERROR(ESRCH);
+		else
+			vdev_trim_stop(tvd, VDEV_TRIM_SUSPENDED);
+		break;
+	default:
+		panic("invalid cmd_type %llu", (unsigned long long)cmd_type);
+	}
+	mutex_exit(&tvd->vdev_trim_lock);
+
+	mutex_exit(&spa_namespace_lock);
+
+	return (error);
+}
+
+/*
+ * Start, cancel or suspend the manual trim of the top-level vdevs which
+ * contain the vdevs listed in "nv".  Trims are always performed on whole
+ * top-level vdevs since the free space is tracked by their metaslabs.
+ * The error for each vdev which failed is added to "vdev_errlist" under
+ * the vdev's name, and the number of failures is returned.
+ */
+int
+spa_vdev_trim(spa_t *spa, nvlist_t *nv, uint64_t cmd_type, uint64_t rate,
+    nvlist_t *vdev_errlist)
+{
+	int total_errors = 0;
+
+	for (nvpair_t *pair = nvlist_next_nvpair(nv, NULL);
+	    pair != NULL; pair = nvlist_next_nvpair(nv, pair)) {
+		uint64_t vdev_guid = fnvpair_value_uint64(pair);
+
+		int error = spa_vdev_trim_impl(spa, vdev_guid, cmd_type, rate);
+		if (error != 0) {
+			fnvlist_add_int64(vdev_errlist, nvpair_name(pair),
+			    error);
+			total_errors++;
+		}
+	}
+
+	return (total_errors);
+}
+
 /*
  * ==========================================================================
  * SPA Scanning
@@ -7000,6 +7116,17 @@ spa_async_thread(void *arg)
 		(void) spa_vdev_state_exit(spa, NULL, 0);
 	}
 
+	/*
+	 * Start or stop the autotrim threads after the property changed
+	 * or the pool was imported.
+	 */
+	if (tasks & SPA_ASYNC_AUTOTRIM_RESTART) {
+		mutex_enter(&spa_namespace_lock);
+		vdev_autotrim_stop_all(spa);
+		vdev_autotrim(spa);
+		mutex_exit(&spa_namespace_lock);
+	}
+
 	if ((tasks & SPA_ASYNC_AUTOEXPAND) && !spa_suspended(spa)) {
 		spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
 		spa_async_autoexpand(spa, spa->spa_root_vdev);
@@ -7529,6 +7656,11 @@ spa_sync_props(void *arg, dmu_tx_t *tx)
 					spa_async_request(spa,
 					    SPA_ASYNC_AUTOEXPAND);
 				break;
+			case ZPOOL_PROP_AUTOTRIM:
+				spa->spa_autotrim = intval;
+				spa_async_request(spa,
+				    SPA_ASYNC_AUTOTRIM_RESTART);
+				break;
 			case ZPOOL_PROP_MULTIHOST:
 				spa->spa_multihost = intval;
 				break;
@@ -7748,11 +7880,20 @@ spa_sync(spa_t *spa, uint64_t txg)
 		}
 	}
 
+	/*
+	 * Weight each metaslab group by the write throughput it achieved
+	 * in the previous txgs.
+	 */
+	metaslab_class_perf_update(normal);
+	metaslab_class_perf_update(special);
+	metaslab_class_perf_update(dedup);
+
 	/*
 	 * Set the top-level vdev's max queue depth. Evaluate each
 	 * top-level's async write queue depth in case it changed.
 	 * The max queue depth will not change in the middle of syncing
-	 * out this txg.
+	 * out this txg.  Faster top-levels get proportionately deeper
+	 * queues.
 	 */
 	uint64_t slots_per_allocator = 0;
 	for (int c = 0; c < rvd->vdev_children; c++) {
@@ -7775,13 +7916,16 @@ spa_sync(spa_t *spa, uint64_t txg)
 		for (int i = 0; i < spa->spa_alloc_count; i++)
 			ASSERT0(zfs_refcount_count(
 			    &(mg->mg_alloc_queue_depth[i])));
-		mg->mg_max_alloc_queue_depth = max_queue_depth;
+		mg->mg_max_alloc_queue_depth =
+		    metaslab_group_perf_scale(mg, max_queue_depth);
 
+		uint64_t def_queue_depth =
+		    metaslab_group_perf_scale(mg, zfs_vdev_def_queue_depth);
 		for (int i = 0; i < spa->spa_alloc_count; i++) {
 			mg->mg_cur_max_alloc_queue_depth[i] =
-			    zfs_vdev_def_queue_depth;
+			    def_queue_depth;
 		}
-		slots_per_allocator += zfs_vdev_def_queue_depth;
+		slots_per_allocator += def_queue_depth;
 	}
 
 	for (int i = 0; i < spa->spa_alloc_count; i++) {
@@ -8009,6 +8153,15 @@ spa_sync(spa_t *spa, uint64_t txg)
 	 * that txg has been completed.
 	 */
 	spa->spa_ubsync = spa->spa_uberblock;
+
+	/*
+	 * Have the autotrim threads trim the frees which were queued over
+	 * the last zfs_trim_txg_batch txgs.
+	 */
+	if (spa_get_autotrim(spa) == ZPOOL_AUTOTRIM_ON &&
+	    zfs_trim_txg_batch != 0 && txg % zfs_trim_txg_batch == 0)
+		vdev_autotrim_kick(spa);
+
 	spa_config_exit(spa, SCL_CONFIG, FTAG);
 
 	spa_handle_ignored_writes(spa);
@@ -40,6 +40,7 @@
 #include <sys/vdev_impl.h>
 #include <sys/vdev_file.h>
 #include <sys/vdev_raidz.h>
+#include <sys/vdev_trim.h>
 #include <sys/metaslab.h>
 #include <sys/uberblock_impl.h>
 #include <sys/txg.h>
@@ -651,6 +652,15 @@ spa_add(const char *name, nvlist_t *config, const char *altroot)
 	for (int t = 0; t < TXG_SIZE; t++)
 		bplist_create(&spa->spa_free_bplist[t]);
 
+	for (int c = 0; c < ZIO_CHECKSUM_FUNCTIONS; c++) {
+		spa_cksum_batch_t *scb = &spa->spa_cksum_batch[c];
+
+		mutex_init(&scb->scb_lock, NULL, MUTEX_DEFAULT, NULL);
+		taskq_init_ent(&scb->scb_flush_ent);
+		scb->scb_spa = spa;
+		scb->scb_checksum = c;
+	}
+
 	(void) strlcpy(spa->spa_name, name, sizeof (spa->spa_name));
 	spa->spa_state = POOL_STATE_UNINITIALIZED;
 	spa->spa_freeze_txg = UINT64_MAX;
@@ -804,6 +814,10 @@ spa_remove(spa_t *spa)
 	mutex_destroy(&spa->spa_proc_lock);
 	mutex_destroy(&spa->spa_props_lock);
 	mutex_destroy(&spa->spa_cksum_tmpls_lock);
+	for (int c = 0; c < ZIO_CHECKSUM_FUNCTIONS; c++) {
+		ASSERT0(spa->spa_cksum_batch[c].scb_count);
+		mutex_destroy(&spa->spa_cksum_batch[c].scb_lock);
+	}
 	mutex_destroy(&spa->spa_scrub_lock);
 	mutex_destroy(&spa->spa_suspend_lock);
 	mutex_destroy(&spa->spa_vdev_top_lock);
@@ -1120,12 +1134,19 @@ spa_l2cache_activate(vdev_t *vd)
  * Lock the given spa_t for the purpose of adding or removing a vdev.
  * Grabs the global spa_namespace_lock plus the spa config lock for writing.
  * It returns the next transaction group for the spa_t.
+ *
+ * The trim threads hold the config lock as reader while they run, so they
+ * are stopped here and restarted by spa_vdev_exit().
  */
 uint64_t
 spa_vdev_enter(spa_t *spa)
 {
 	mutex_enter(&spa->spa_vdev_top_lock);
 	mutex_enter(&spa_namespace_lock);
+
+	vdev_autotrim_stop_all(spa);
+	vdev_trim_stop_all(spa, VDEV_TRIM_ACTIVE);
+
 	return (spa_vdev_config_enter(spa));
 }
 
@@ -1219,6 +1240,10 @@ int
 spa_vdev_exit(spa_t *spa, vdev_t *vd, uint64_t txg, int error)
 {
 	spa_vdev_config_exit(spa, vd, txg, error, FTAG);
+
+	vdev_trim_restart(spa);
+	vdev_autotrim(spa);
+
 	mutex_exit(&spa_namespace_lock);
 	mutex_exit(&spa->spa_vdev_top_lock);
 
@@ -1808,6 +1833,12 @@ spa_get_failmode(spa_t *spa)
 	return (spa->spa_failmode);
 }
 
+uint64_t
+spa_get_autotrim(spa_t *spa)
+{
+	return (spa->spa_autotrim);
+}
+
 boolean_t
 spa_suspended(spa_t *spa)
 {
@@ -2109,6 +2140,7 @@ spa_init(int mode)
 	dmu_init();
 	zil_init();
 	vdev_cache_stat_init();
+	vdev_queue_cache_init();
 	vdev_mirror_stat_init();
 	vdev_raidz_math_init();
 	vdev_file_init();
@@ -2130,6 +2162,7 @@ spa_fini(void)
 
 	vdev_file_fini();
 	vdev_cache_stat_fini();
+	vdev_queue_cache_fini();
 	vdev_mirror_stat_fini();
 	vdev_raidz_math_fini();
 	zil_fini();
@@ -2625,6 +2658,7 @@ EXPORT_SYMBOL(spa_preferred_class);
 EXPORT_SYMBOL(spa_max_replication);
 EXPORT_SYMBOL(spa_prev_software_version);
 EXPORT_SYMBOL(spa_get_failmode);
+EXPORT_SYMBOL(spa_get_autotrim);
 EXPORT_SYMBOL(spa_suspended);
 EXPORT_SYMBOL(spa_bootfs);
 EXPORT_SYMBOL(spa_delegation);
@@ -242,6 +242,19 @@ vdev_default_asize(vdev_t *vd, uint64_t psize)
 	return (asize);
 }
 
+/*
+ * Default range translation function: the child vdev stores the range at
+ * the same offset as its parent.  This is what's used by mirrors, spares
+ * and replacing vdevs, whose children each hold a full copy of the data.
+ */
+/* ARGSUSED */
+void
+vdev_default_xlate(vdev_t *vd, const range_seg_t *in, range_seg_t *out)
+{
+	out->rs_start = in->rs_start;
+	out->rs_end = in->rs_end;
+}
+
 /*
  * Get the minimum allocatable size. We define the allocatable size as
  * the vdev's asize rounded to the nearest metaslab. This allows us to
@@ -515,6 +528,9 @@ vdev_alloc_common(spa_t *spa, uint_t id, uint64_t guid, vdev_ops_t *ops)
 	mutex_init(&vd->vdev_dtl_lock, NULL, MUTEX_NOLOCKDEP, NULL);
 	mutex_init(&vd->vdev_stat_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&vd->vdev_probe_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&vd->vdev_trim_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&vd->vdev_trim_cv, NULL, CV_DEFAULT, NULL);
+	cv_init(&vd->vdev_autotrim_cv, NULL, CV_DEFAULT, NULL);
 	mutex_init(&vd->vdev_queue_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&vd->vdev_scan_io_queue_lock, NULL, MUTEX_DEFAULT, NULL);
 
@@ -946,6 +962,12 @@ vdev_free(vdev_t *vd)
 	mutex_destroy(&vd->vdev_probe_lock);
 	mutex_destroy(&vd->vdev_scan_io_queue_lock);
 
+	ASSERT3P(vd->vdev_trim_thread, ==, NULL);
+	ASSERT3P(vd->vdev_autotrim_thread, ==, NULL);
+	mutex_destroy(&vd->vdev_trim_lock);
+	cv_destroy(&vd->vdev_trim_cv);
+	cv_destroy(&vd->vdev_autotrim_cv);
+
 	zfs_ratelimit_fini(&vd->vdev_delay_rl);
 	zfs_ratelimit_fini(&vd->vdev_checksum_rl);
 
@@ -996,6 +1018,20 @@ vdev_top_transfer(vdev_t *svd, vdev_t *tvd)
 	tvd->vdev_alloc_bias = svd->vdev_alloc_bias;
 	svd->vdev_alloc_bias = VDEV_BIAS_NONE;
 
+	/*
+	 * The trim threads were stopped by spa_vdev_enter(), carry over
+	 * the progress of any manual trim so that it can be resumed.
+	 */
+	ASSERT3P(svd->vdev_trim_thread, ==, NULL);
+	ASSERT3P(svd->vdev_autotrim_thread, ==, NULL);
+	tvd->vdev_trim_state = svd->vdev_trim_state;
+	tvd->vdev_trim_rate = svd->vdev_trim_rate;
+	tvd->vdev_trim_last_ms = svd->vdev_trim_last_ms;
+	tvd->vdev_trim_action_time = svd->vdev_trim_action_time;
+	tvd->vdev_trim_bytes_done = svd->vdev_trim_bytes_done;
+	tvd->vdev_trim_bytes_est = svd->vdev_trim_bytes_est;
+	svd->vdev_trim_state = VDEV_TRIM_NONE;
+
 	tvd->vdev_stat.vs_alloc = svd->vdev_stat.vs_alloc;
 	tvd->vdev_stat.vs_space = svd->vdev_stat.vs_space;
 	tvd->vdev_stat.vs_dspace = svd->vdev_stat.vs_dspace;
@@ -3693,7 +3729,7 @@ static void
 vdev_get_child_stat(vdev_t *cvd, vdev_stat_t *vs, vdev_stat_t *cvs)
 {
 	int t;
-	for (t = 0; t < ZIO_TYPES; t++) {
+	for (t = 0; t < VS_ZIO_TYPES; t++) {
 		vs->vs_ops[t] += cvs->vs_ops[t];
 		vs->vs_bytes[t] += cvs->vs_bytes[t];
 	}
@@ -3725,6 +3761,7 @@ vdev_get_child_stat_ex(vdev_t *cvd, vdev_stat_ex_t *vsx, vdev_stat_ex_t *cvsx)
 		}
 		vsx->vsx_active_queue[t] += cvsx->vsx_active_queue[t];
 		vsx->vsx_pend_queue[t] += cvsx->vsx_pend_queue[t];
+		vsx->vsx_max_queue[t] += cvsx->vsx_max_queue[t];
 
 		for (b = 0; b < ARRAY_SIZE(vsx->vsx_ind_histo[0]); b++)
 			vsx->vsx_ind_histo[t][b] += cvsx->vsx_ind_histo[t][b];
@@ -3798,6 +3835,7 @@ vdev_get_stats_ex_impl(vdev_t *vd, vdev_stat_t *vs, vdev_stat_ex_t *vsx)
 			    vd->vdev_queue.vq_class[t].vqc_active;
 			vsx->vsx_pend_queue[t] = avl_numnodes(
 			    &vd->vdev_queue.vq_class[t].vqc_queued_tree);
+			vsx->vsx_max_queue[t] = vdev_queue_max_active(vd, t);
 		}
 	}
 }
@@ -3831,6 +3869,27 @@ vdev_get_stats_ex(vdev_t *vd, vdev_stat_t *vs, vdev_stat_ex_t *vsx)
 			vs->vs_fragmentation = (vd->vdev_mg != NULL) ?
 			    vd->vdev_mg->mg_fragmentation : 0;
 		}
+
+		/*
+		 * Trims are driven by the top-level vdev, its leaves report
+		 * the same state and whether they support trim at all.
+		 */
+		if (tvd != NULL) {
+			mutex_enter(&tvd->vdev_trim_lock);
+			vs->vs_trim_state = tvd->vdev_trim_state;
+			if (vd == tvd) {
+				vs->vs_trim_action_time =
+				    tvd->vdev_trim_action_time;
+				vs->vs_trim_bytes_done =
+				    tvd->vdev_trim_bytes_done;
+				vs->vs_trim_bytes_est =
+				    tvd->vdev_trim_bytes_est;
+				vs->vs_trim_rate = tvd->vdev_trim_rate;
+			}
+			mutex_exit(&tvd->vdev_trim_lock);
+		}
+		if (vd->vdev_ops->vdev_op_leaf)
+			vs->vs_trim_notsup = !vd->vdev_has_trim;
 	}
 
 	ASSERT(spa_config_held(vd->vdev_spa, SCL_ALL, RW_READER) != 0);
@@ -3934,8 +3993,14 @@ vdev_stat_update(zio_t *zio, uint64_t psize)
 		if (vd->vdev_ops->vdev_op_leaf &&
 		    (zio->io_priority < ZIO_PRIORITY_NUM_QUEUEABLE)) {
 
-			vs->vs_ops[type]++;
-			vs->vs_bytes[type] += psize;
+			/*
+			 * vs_ops[] is fixed in size, trims are accounted
+			 * for as ioctls.
+			 */
+			zio_type_t vs_type = MIN(type, ZIO_TYPE_IOCTL);
+
+			vs->vs_ops[vs_type]++;
+			vs->vs_bytes[vs_type] += psize;
 
 			if (flags & ZIO_FLAG_DELEGATED) {
 				vsx->vsx_agg_histo[zio->io_priority]
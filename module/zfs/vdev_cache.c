@@ -28,6 +28,7 @@
 
 #include <sys/zfs_context.h>
 #include <sys/spa.h>
+#include <sys/arc.h>
 #include <sys/vdev_impl.h>
 #include <sys/zio.h>
 #include <sys/kstat.h>
@@ -43,14 +44,22 @@
  * reads into a single 64k read followed by 127 cache hits; this reduces
  * latency dramatically.  In the worst case, it can turn an isolated 512-byte
  * read into a 64k read, which doesn't affect latency all that much but is
- * terribly wasteful of bandwidth.  A more intelligent version of the cache
- * could keep track of access patterns and not do read-ahead unless it sees
- * at least two temporally close I/Os to the same region.  Currently, only
- * metadata I/O is inflated.  A futher enhancement could take advantage of
- * more semantic information about the I/O.  And it could use something
- * faster than an AVL tree; that was chosen solely for convenience.
+ * terribly wasteful of bandwidth.  Only metadata I/O is cached, and to
+ * avoid the worst case a read is only inflated when the DMU has told us
+ * that it is about to read other blocks in the same region.  It could use
+ * something faster than an AVL tree; that was chosen solely for convenience.
  *
- * There are five cache operations: allocate, fill, read, write, evict.
+ * Hints.  When dbuf_prefetch() issues a read for a metadata block it first
+ * records the block's DVAs as hints with vdev_cache_hint().  Hints are kept
+ * on the top-level vdev, in DVA offset space, and at most
+ * zfs_vdev_cache_hints of them are kept per vdev with the oldest discarded
+ * first.  When a read misses the cache, the hints in its cache block are
+ * claimed, and the read is only inflated if some of them are for blocks
+ * other than the one being read.  Leaf offsets can only be mapped back to
+ * DVA offsets below mirror and single disk top-level vdevs, so reads from
+ * the children of raidz vdevs are never inflated.
+ *
+ * There are six cache operations: hint, allocate, fill, read, write, evict.
  *
  * (1) Allocate.  This reserves a cache entry for the specified region.
  *     We separate the allocate and fill operations so that multiple threads
@@ -64,7 +73,9 @@
  * (4) Write.  Update cache contents after write completion.
  *
  * (5) Evict.  When allocating a new entry, we evict the oldest (LRU) entry
- *     if the total cache size exceeds zfs_vdev_cache_size.
+ *     if the total cache size exceeds zfs_vdev_cache_size, or if the size of
+ *     all vdev caches exceeds 1/(2^zfs_vdev_cache_arc_shift) of the ARC's
+ *     target size.
  */
 
 /*
@@ -74,18 +85,15 @@
  * All i/os smaller than zfs_vdev_cache_max will be turned into
  * 1<<zfs_vdev_cache_bshift byte reads by the vdev_cache (aka software
  * track buffer).  At most zfs_vdev_cache_size bytes will be kept in each
- * vdev's vdev_cache.
- *
- * TODO: Note that with the current ZFS code, it turns out that the
- * vdev cache is not helpful, and in some cases actually harmful.  It
- * is better if we disable this.  Once some time has passed, we should
- * actually remove this to simplify the code.  For now we just disable
- * it by setting the zfs_vdev_cache_size to zero.  Note that Solaris 11
- * has made these same changes.
+ * vdev's vdev_cache, and all vdev caches together are limited to
+ * 1/(2^zfs_vdev_cache_arc_shift) of the ARC's target size.  Setting
+ * zfs_vdev_cache_size to zero disables the cache.
  */
 int zfs_vdev_cache_max = 1<<14;			/* 16KB */
-int zfs_vdev_cache_size = 0;
+int zfs_vdev_cache_size = 10 * 1024 * 1024;
 int zfs_vdev_cache_bshift = 16;
+int zfs_vdev_cache_arc_shift = 7;
+int zfs_vdev_cache_hints = 1024;
 
 #define	VCBS (1 << zfs_vdev_cache_bshift)	/* 64KB */
 
@@ -95,15 +103,31 @@ typedef struct vdc_stats {
 	kstat_named_t vdc_stat_delegations;
 	kstat_named_t vdc_stat_hits;
 	kstat_named_t vdc_stat_misses;
+	kstat_named_t vdc_stat_unhinted;
+	kstat_named_t vdc_stat_hints;
+	kstat_named_t vdc_stat_hints_claimed;
+	kstat_named_t vdc_stat_hints_dropped;
+	kstat_named_t vdc_stat_readahead_bytes;
+	kstat_named_t vdc_stat_waste_bytes;
+	kstat_named_t vdc_stat_size;
 } vdc_stats_t;
 
 static vdc_stats_t vdc_stats = {
 	{ "delegations",	KSTAT_DATA_UINT64 },
 	{ "hits",		KSTAT_DATA_UINT64 },
-	{ "misses",		KSTAT_DATA_UINT64 }
+	{ "misses",		KSTAT_DATA_UINT64 },
+	{ "unhinted",		KSTAT_DATA_UINT64 },
+	{ "hints",		KSTAT_DATA_UINT64 },
+	{ "hints_claimed",	KSTAT_DATA_UINT64 },
+	{ "hints_dropped",	KSTAT_DATA_UINT64 },
+	{ "readahead_bytes",	KSTAT_DATA_UINT64 },
+	{ "waste_bytes",	KSTAT_DATA_UINT64 },
+	{ "size",		KSTAT_DATA_UINT64 }
 };
 
 #define	VDCSTAT_BUMP(stat)	atomic_inc_64(&vdc_stats.stat.value.ui64);
+#define	VDCSTAT_INCR(stat, val)	\
+	atomic_add_64(&vdc_stats.stat.value.ui64, (val));
 
 static inline int
 vdev_cache_offset_compare(const void *a1, const void *a2)
@@ -130,6 +154,143 @@ vdev_cache_lastused_compare(const void *a1, const void *a2)
 	return (vdev_cache_offset_compare(a1, a2));
 }
 
+static int
+vdev_cache_hint_compare(const void *a1, const void *a2)
+{
+	const vdev_cache_hint_t *vch1 = (const vdev_cache_hint_t *)a1;
+	const vdev_cache_hint_t *vch2 = (const vdev_cache_hint_t *)a2;
+
+	return (AVL_CMP(vch1->vch_offset, vch2->vch_offset));
+}
+
+/*
+ * Leaf offsets can be mapped back to DVA offsets, and so hints used, only
+ * for vdevs below mirror and single disk top-level vdevs.
+ */
+static boolean_t
+vdev_cache_hintable(vdev_t *tvd)
+{
+	return (tvd != NULL && (tvd->vdev_ops == &vdev_mirror_ops ||
+	    tvd->vdev_ops->vdev_op_leaf));
+}
+
+static void
+vdev_cache_hint_remove(vdev_cache_t *vc, vdev_cache_hint_t *vch)
+{
+	ASSERT(MUTEX_HELD(&vc->vc_hint_lock));
+
+	avl_remove(&vc->vc_hint_tree, vch);
+	list_remove(&vc->vc_hint_list, vch);
+	kmem_free(vch, sizeof (vdev_cache_hint_t));
+}
+
+static void
+vdev_cache_hint_add(vdev_t *tvd, uint64_t offset, uint64_t size)
+{
+	vdev_cache_t *vc = &tvd->vdev_cache;
+	vdev_cache_hint_t *vch, vch_search;
+	avl_index_t where;
+
+	vch_search.vch_offset = offset;
+
+	mutex_enter(&vc->vc_hint_lock);
+	if (avl_find(&vc->vc_hint_tree, &vch_search, &where) != NULL) {
+		mutex_exit(&vc->vc_hint_lock);
+		return;
+	}
+
+	vch = kmem_alloc(sizeof (vdev_cache_hint_t), KM_NOSLEEP);
+	if (vch == NULL) {
+		mutex_exit(&vc->vc_hint_lock);
+		return;
+	}
+	vch->vch_offset = offset;
+	vch->vch_size = size;
+	avl_insert(&vc->vc_hint_tree, vch, where);
+	list_insert_tail(&vc->vc_hint_list, vch);
+	VDCSTAT_BUMP(vdc_stat_hints);
+
+	while (avl_numnodes(&vc->vc_hint_tree) > MAX(zfs_vdev_cache_hints, 0)) {
+		vdev_cache_hint_remove(vc, list_head(&vc->vc_hint_list));
+		VDCSTAT_BUMP(vdc_stat_hints_dropped);
+	}
+	mutex_exit(&vc->vc_hint_lock);
+}
+
+/*
+ * Record that the given metadata block is about to be read, so that a read
+ * of a nearby block may be inflated to cover it.
+ */
+void
+vdev_cache_hint(spa_t *spa, const blkptr_t *bp)
+{
+	if (zfs_vdev_cache_size == 0 || zfs_vdev_cache_hints <= 0)
+		return;
+
+	if (BP_IS_HOLE(bp) || BP_IS_EMBEDDED(bp) ||
+	    BP_GET_PSIZE(bp) > zfs_vdev_cache_max)
+		return;
+
+	if (!spa_config_tryenter(spa, SCL_ZIO, FTAG, RW_READER))
+		return;
+
+	for (int d = 0; d < BP_GET_NDVAS(bp); d++) {
+		const dva_t *dva = &bp->blk_dva[d];
+		vdev_t *tvd = vdev_lookup_top(spa, DVA_GET_VDEV(dva));
+
+		if (vdev_cache_hintable(tvd) && !DVA_GET_GANG(dva)) {
+			vdev_cache_hint_add(tvd, DVA_GET_OFFSET(dva),
+			    DVA_GET_ASIZE(dva));
+		}
+	}
+
+	spa_config_exit(spa, SCL_ZIO, FTAG);
+}
+
+/*
+ * Claim the hints for the cache block at the given leaf offset.  Returns
+ * B_TRUE if any of them were for blocks other than the one being read.
+ */
+static boolean_t
+vdev_cache_hint_claim(zio_t *zio, uint64_t cache_offset)
+{
+	vdev_t *tvd = zio->io_vd->vdev_top;
+	vdev_cache_t *vc;
+	vdev_cache_hint_t *vch, vch_search;
+	uint64_t io_start, start, end;
+	avl_index_t where;
+	boolean_t hinted = B_FALSE;
+
+	if (!vdev_cache_hintable(tvd) ||
+	    cache_offset < VDEV_LABEL_START_SIZE)
+		return (B_FALSE);
+
+	vc = &tvd->vdev_cache;
+	io_start = zio->io_offset - VDEV_LABEL_START_SIZE;
+	start = cache_offset - VDEV_LABEL_START_SIZE;
+	end = start + VCBS;
+
+	mutex_enter(&vc->vc_hint_lock);
+	vch_search.vch_offset = start;
+	vch = avl_find(&vc->vc_hint_tree, &vch_search, &where);
+	if (vch == NULL)
+		vch = avl_nearest(&vc->vc_hint_tree, where, AVL_AFTER);
+
+	while (vch != NULL && vch->vch_offset < end) {
+		vdev_cache_hint_t *next = AVL_NEXT(&vc->vc_hint_tree, vch);
+
+		if (vch->vch_offset != io_start) {
+			hinted = B_TRUE;
+			VDCSTAT_BUMP(vdc_stat_hints_claimed);
+		}
+		vdev_cache_hint_remove(vc, vch);
+		vch = next;
+	}
+	mutex_exit(&vc->vc_hint_lock);
+
+	return (hinted);
+}
+
 /*
  * Evict the specified entry from the cache.
  */
@@ -142,10 +303,27 @@ vdev_cache_evict(vdev_cache_t *vc, vdev_cache_entry_t *ve)
 
 	avl_remove(&vc->vc_lastused_tree, ve);
 	avl_remove(&vc->vc_offset_tree, ve);
+	VDCSTAT_INCR(vdc_stat_waste_bytes, VCBS - MIN(ve->ve_used, VCBS));
+	VDCSTAT_INCR(vdc_stat_size, -VCBS);
 	abd_free(ve->ve_abd);
 	kmem_free(ve, sizeof (vdev_cache_entry_t));
 }
 
+/*
+ * Returns B_TRUE if adding an entry would take this vdev's cache over
+ * zfs_vdev_cache_size, or all vdev caches over their share of the ARC.
+ */
+static boolean_t
+vdev_cache_full(vdev_cache_t *vc)
+{
+	if ((avl_numnodes(&vc->vc_lastused_tree) << zfs_vdev_cache_bshift) >
+	    zfs_vdev_cache_size)
+		return (B_TRUE);
+
+	return (vdc_stats.vdc_stat_size.value.ui64 + VCBS >
+	    arc_target_bytes() >> zfs_vdev_cache_arc_shift);
+}
+
 /*
  * Allocate an entry in the cache.  At the point we don't have the data,
  * we're just creating a placeholder so that multiple threads don't all
@@ -167,10 +345,9 @@ vdev_cache_allocate(zio_t *zio)
 	 * If adding a new entry would exceed the cache size,
 	 * evict the oldest entry (LRU).
 	 */
-	if ((avl_numnodes(&vc->vc_lastused_tree) << zfs_vdev_cache_bshift) >
-	    zfs_vdev_cache_size) {
+	if (vdev_cache_full(vc)) {
 		ve = avl_first(&vc->vc_lastused_tree);
-		if (ve->ve_fill_io != NULL)
+		if (ve == NULL || ve->ve_fill_io != NULL)
 			return (NULL);
 		ASSERT3U(ve->ve_hits, !=, 0);
 		vdev_cache_evict(vc, ve);
@@ -180,6 +357,7 @@ vdev_cache_allocate(zio_t *zio)
 	ve->ve_offset = offset;
 	ve->ve_lastused = ddi_get_lbolt();
 	ve->ve_abd = abd_alloc_for_io(VCBS, B_TRUE);
+	VDCSTAT_INCR(vdc_stat_size, VCBS);
 
 	avl_add(&vc->vc_offset_tree, ve);
 	avl_add(&vc->vc_lastused_tree, ve);
@@ -202,6 +380,7 @@ vdev_cache_hit(vdev_cache_t *vc, vdev_cache_entry_t *ve, zio_t *zio)
 	}
 
 	ve->ve_hits++;
+	ve->ve_used += zio->io_size;
 	abd_copy_off(zio->io_abd, ve->ve_abd, 0, cache_phase, zio->io_size);
 }
 
@@ -301,6 +480,16 @@ vdev_cache_read(zio_t *zio)
 		return (B_TRUE);
 	}
 
+	/*
+	 * Only read ahead when the DMU has asked for other blocks in this
+	 * cache block, otherwise the read-ahead is likely to be wasted.
+	 */
+	if (!vdev_cache_hint_claim(zio, cache_offset)) {
+		mutex_exit(&vc->vc_lock);
+		VDCSTAT_BUMP(vdc_stat_unhinted);
+		return (B_FALSE);
+	}
+
 	ve = vdev_cache_allocate(zio);
 
 	if (ve == NULL) {
@@ -319,6 +508,7 @@ vdev_cache_read(zio_t *zio)
 	mutex_exit(&vc->vc_lock);
 	zio_nowait(fio);
 	VDCSTAT_BUMP(vdc_stat_misses);
+	VDCSTAT_INCR(vdc_stat_readahead_bytes, VCBS - zio->io_size);
 
 	return (B_TRUE);
 }
@@ -368,11 +558,17 @@ vdev_cache_purge(vdev_t *vd)
 {
 	vdev_cache_t *vc = &vd->vdev_cache;
 	vdev_cache_entry_t *ve;
+	vdev_cache_hint_t *vch;
 
 	mutex_enter(&vc->vc_lock);
 	while ((ve = avl_first(&vc->vc_offset_tree)) != NULL)
 		vdev_cache_evict(vc, ve);
 	mutex_exit(&vc->vc_lock);
+
+	mutex_enter(&vc->vc_hint_lock);
+	while ((vch = list_head(&vc->vc_hint_list)) != NULL)
+		vdev_cache_hint_remove(vc, vch);
+	mutex_exit(&vc->vc_hint_lock);
 }
 
 void
@@ -389,6 +585,15 @@ vdev_cache_init(vdev_t *vd)
 	avl_create(&vc->vc_lastused_tree, vdev_cache_lastused_compare,
 	    sizeof (vdev_cache_entry_t),
 	    offsetof(struct vdev_cache_entry, ve_lastused_node));
+
+	mutex_init(&vc->vc_hint_lock, NULL, MUTEX_DEFAULT, NULL);
+
+	avl_create(&vc->vc_hint_tree, vdev_cache_hint_compare,
+	    sizeof (vdev_cache_hint_t),
+	    offsetof(struct vdev_cache_hint, vch_offset_node));
+
+	list_create(&vc->vc_hint_list, sizeof (vdev_cache_hint_t),
+	    offsetof(struct vdev_cache_hint, vch_list_node));
 }
 
 void
@@ -400,8 +605,11 @@ vdev_cache_fini(vdev_t *vd)
 
 	avl_destroy(&vc->vc_offset_tree);
 	avl_destroy(&vc->vc_lastused_tree);
+	avl_destroy(&vc->vc_hint_tree);
+	list_destroy(&vc->vc_hint_list);
 
 	mutex_destroy(&vc->vc_lock);
+	mutex_destroy(&vc->vc_hint_lock);
 }
 
 void
@@ -434,4 +642,12 @@ MODULE_PARM_DESC(zfs_vdev_cache_size, "Total size of the per-disk cache");
 
 module_param(zfs_vdev_cache_bshift, int, 0644);
 MODULE_PARM_DESC(zfs_vdev_cache_bshift, "Shift size to inflate reads too");
+
+module_param(zfs_vdev_cache_arc_shift, int, 0644);
+MODULE_PARM_DESC(zfs_vdev_cache_arc_shift,
+	"Limit all vdev caches to 1/(2^shift) of the ARC target size");
+
+module_param(zfs_vdev_cache_hints, int, 0644);
+MODULE_PARM_DESC(zfs_vdev_cache_hints,
+	"Max metadata read-ahead hints kept per vdev");
 #endif
@@ -327,6 +327,9 @@ vdev_disk_open(vdev_t *v, uint64_t *psize, uint64_t *max_psize,
 	/* Inform the ZIO pipeline that we are non-rotational */
 	v->vdev_nonrot = blk_queue_nonrot(bdev_get_queue(vd->vd_bdev));
 
+	/* Inform the ZIO pipeline that the device supports discard */
+	v->vdev_has_trim = blk_queue_discard(bdev_get_queue(vd->vd_bdev));
+
 	/* Physical volume size in bytes for the partition */
 	*psize = bdev_capacity(vd->vd_bdev);
 
@@ -751,6 +754,16 @@ vdev_disk_io_start(zio_t *zio)
 		rw_exit(&vd->vd_lock);
 		zio_execute(zio);
 		return;
+	case ZIO_TYPE_TRIM:
+		/*
+		 * Discards are issued synchronously; the trim thread bounds
+		 * how many are outstanding so this does not stall the taskq.
+		 */
+		zio->io_error = -blkdev_issue_discard(vd->vd_bdev,
+		    zio->io_offset >> 9, zio->io_size >> 9, GFP_NOFS, 0);
+		rw_exit(&vd->vd_lock);
+		zio_interrupt(zio);
+		return;
 	case ZIO_TYPE_WRITE:
 		rw = WRITE;
 #if defined(HAVE_BLK_QUEUE_HAVE_BIO_RW_UNPLUG)
@@ -883,6 +896,7 @@ vdev_ops_t vdev_disk_ops = {
 	vdev_disk_hold,
 	vdev_disk_rele,
 	NULL,
+	vdev_default_xlate,
 	VDEV_TYPE_DISK,		/* name of this vdev type */
 	B_TRUE			/* leaf vdev */
 };
@@ -63,6 +63,13 @@ vdev_file_open(vdev_t *vd, uint64_t *psize, uint64_t *max_psize,
 	/* Rotational optimizations only make sense on block devices */
 	vd->vdev_nonrot = B_TRUE;
 
+	/*
+	 * Allow TRIM on file based vdevs.  This may not always be supported,
+	 * since it depends on your kernel version and underlying filesystem
+	 * type but it is always safe to attempt.
+	 */
+	vd->vdev_has_trim = B_TRUE;
+
 	/*
 	 * We must have a pathname, and it must be absolute.
 	 */
@@ -175,6 +182,28 @@ vdev_file_io_strategy(void *arg)
 	zio_delay_interrupt(zio);
 }
 
+/*
+ * Free the requested range by punching a hole in the backing file.
+ */
+static void
+vdev_file_io_trim(void *arg)
+{
+	zio_t *zio = (zio_t *)arg;
+	vdev_file_t *vf = zio->io_vd->vdev_tsd;
+	flock64_t flck;
+
+	bzero(&flck, sizeof (flck));
+	flck.l_type = F_FREESP;
+	flck.l_start = zio->io_offset;
+	flck.l_len = zio->io_size;
+	flck.l_whence = 0;
+
+	zio->io_error = VOP_SPACE(vf->vf_vnode, F_FREESP, &flck,
+	    0, 0, kcred, NULL);
+
+	zio_interrupt(zio);
+}
+
 static void
 vdev_file_io_fsync(void *arg)
 {
@@ -231,6 +260,12 @@ vdev_file_io_start(zio_t *zio)
 		return;
 	}
 
+	if (zio->io_type == ZIO_TYPE_TRIM) {
+		VERIFY3U(taskq_dispatch(vdev_file_taskq, vdev_file_io_trim,
+		    zio, TQ_SLEEP), !=, TASKQID_INVALID);
+		return;
+	}
+
 	zio->io_target_timestamp = zio_handle_io_delay(zio);
 
 	VERIFY3U(taskq_dispatch(vdev_file_taskq, vdev_file_io_strategy, zio,
@@ -254,6 +289,7 @@ vdev_ops_t vdev_file_ops = {
 	vdev_file_hold,
 	vdev_file_rele,
 	NULL,
+	vdev_default_xlate,
 	VDEV_TYPE_FILE,		/* name of this vdev type */
 	B_TRUE			/* leaf vdev */
 };
@@ -289,6 +325,7 @@ vdev_ops_t vdev_disk_ops = {
 	vdev_file_hold,
 	vdev_file_rele,
 	NULL,
+	vdev_default_xlate,
 	VDEV_TYPE_DISK,		/* name of this vdev type */
 	B_TRUE			/* leaf vdev */
 };
@@ -0,0 +1,278 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/spa_impl.h>
+#include <sys/vdev_impl.h>
+#include <sys/zio.h>
+#include <sys/abd.h>
+
+/*
+ * Hedged reads
+ *
+ * A read from a mirror or raidz vdev normally completes only once every
+ * child I/O it issued has completed, so a single device which stalls for
+ * hundreds of milliseconds stalls the read with it even though the data
+ * could have been read from a sibling or reconstructed from parity.  When
+ * zfs_vdev_hedge_read_ms is set, reads issued by these vdevs are instead
+ * "hedged": the child reads are issued with zio_vdev_detached_io() into
+ * private buffers, and the parent waits on a null child zio, the gate,
+ * rather than on the reads themselves.  If the reads haven't completed
+ * within zfs_vdev_hedge_read_ms the vdev issues reads to alternate
+ * children, and as soon as enough reads have completed to satisfy the
+ * parent their data is copied into the parent's buffers and the gate is
+ * executed.  Any reads still outstanding at that point are ignored when
+ * they complete.
+ *
+ * The vdev specific policy is provided by a vdev_hedge_ops_t.  Its
+ * callbacks are called with vh_lock held and only while the parent is
+ * still waiting, so they may freely examine and update the parent's
+ * vdev specific state.  Reads created by the callbacks with
+ * vdev_hedge_read() are issued once vh_lock has been dropped, since a
+ * read can complete synchronously.
+ *
+ * Each hedge holds SCL_ZIO as reader until the last of its reads has
+ * completed, because the parent's hold on the config may be dropped
+ * while those reads are still outstanding.  Hedging is skipped rather
+ * than wait for the lock when there is a writer waiting.
+ */
+
+/*
+ * Time in milliseconds a read may be outstanding before alternate
+ * reads are issued, or zero to disable hedged reads.
+ */
+int zfs_vdev_hedge_read_ms = 0;
+
+boolean_t
+vdev_hedge_enabled(zio_t *zio)
+{
+	if (zfs_vdev_hedge_read_ms <= 0)
+		return (B_FALSE);
+
+	if (zio->io_type != ZIO_TYPE_READ || zio->io_bp == NULL)
+		return (B_FALSE);
+
+	if (zio->io_priority != ZIO_PRIORITY_SYNC_READ &&
+	    zio->io_priority != ZIO_PRIORITY_ASYNC_READ)
+		return (B_FALSE);
+
+	/*
+	 * Scrubs, resilvers and repairs want to read every child anyway,
+	 * prefetches aren't latency sensitive, and retries should take the
+	 * well trodden path.
+	 */
+	if (zio->io_flags & (ZIO_FLAG_SCRUB | ZIO_FLAG_RESILVER |
+	    ZIO_FLAG_IO_REPAIR | ZIO_FLAG_SPECULATIVE | ZIO_FLAG_IO_RETRY))
+		return (B_FALSE);
+
+	return (B_TRUE);
+}
+
+/*
+ * Prepare to hedge the reads of the given mirror or raidz zio, which has
+ * the given number of children.  Returns with vh_lock held, or NULL if
+ * the reads can't be hedged and must be issued as usual.
+ */
+vdev_hedge_t *
+vdev_hedge_create(zio_t *zio, int children, const vdev_hedge_ops_t *ops)
+{
+	vdev_hedge_t *vh;
+
+	ASSERT(vdev_hedge_enabled(zio));
+
+	vh = kmem_zalloc(offsetof(vdev_hedge_t, vh_child[children]),
+	    KM_SLEEP);
+
+	if (!spa_config_tryenter(zio->io_spa, SCL_ZIO, vh, RW_READER)) {
+		kmem_free(vh, offsetof(vdev_hedge_t, vh_child[children]));
+		return (NULL);
+	}
+
+	mutex_init(&vh->vh_lock, NULL, MUTEX_DEFAULT, NULL);
+	vh->vh_zio = zio;
+	vh->vh_gate = zio_null(zio, zio->io_spa, zio->io_vd, NULL, NULL, 0);
+	vh->vh_ops = ops;
+	vh->vh_spa = zio->io_spa;
+	vh->vh_refs = 1;
+	vh->vh_issue = -1;
+	vh->vh_children = children;
+	for (int c = 0; c < children; c++)
+		vh->vh_child[c].vhc_hedge = vh;
+
+	mutex_enter(&vh->vh_lock);
+
+	return (vh);
+}
+
+static void
+vdev_hedge_rele(vdev_hedge_t *vh)
+{
+	uint64_t refs;
+
+	mutex_enter(&vh->vh_lock);
+	refs = --vh->vh_refs;
+	mutex_exit(&vh->vh_lock);
+
+	if (refs != 0)
+		return;
+
+	ASSERT3P(vh->vh_zio, ==, NULL);
+	ASSERT3P(vh->vh_gate, ==, NULL);
+	ASSERT0(vh->vh_pending);
+
+	spa_config_exit(vh->vh_spa, SCL_ZIO, vh);
+	mutex_destroy(&vh->vh_lock);
+	kmem_free(vh, offsetof(vdev_hedge_t, vh_child[vh->vh_children]));
+}
+
+/*
+ * Drop vh_lock, then issue the reads created while it was held and
+ * execute the gate if the parent has been released.
+ */
+static void
+vdev_hedge_exit(vdev_hedge_t *vh)
+{
+	zio_t *gate = NULL;
+	int c;
+
+	ASSERT(MUTEX_HELD(&vh->vh_lock));
+
+	c = vh->vh_issue;
+	vh->vh_issue = -1;
+	if (vh->vh_released) {
+		gate = vh->vh_gate;
+		vh->vh_gate = NULL;
+	}
+	mutex_exit(&vh->vh_lock);
+
+	while (c != -1) {
+		vdev_hedge_child_t *vhc = &vh->vh_child[c];
+		zio_t *zio = vhc->vhc_zio;
+
+		c = vhc->vhc_next;
+		vhc->vhc_zio = NULL;
+		zio_nowait(zio);
+	}
+
+	if (gate != NULL)
+		zio_nowait(gate);
+}
+
+static void
+vdev_hedge_read_done(zio_t *zio)
+{
+	vdev_hedge_child_t *vhc = zio->io_private;
+	vdev_hedge_t *vh = vhc->vhc_hedge;
+
+	mutex_enter(&vh->vh_lock);
+	ASSERT3U(vh->vh_pending, >, 0);
+	vh->vh_pending--;
+	if (vh->vh_zio != NULL)
+		vh->vh_ops->vho_done(vh, vhc - vh->vh_child, zio);
+	vdev_hedge_exit(vh);
+
+	abd_free(zio->io_abd);
+	vdev_hedge_rele(vh);
+}
+
+/*
+ * Create a read of child c into a private buffer, to be issued once
+ * vh_lock is dropped.  Each child may only be read once.
+ */
+void
+vdev_hedge_read(vdev_hedge_t *vh, int c, vdev_t *vd, uint64_t offset,
+    uint64_t size, blkptr_t *bp)
+{
+	vdev_hedge_child_t *vhc = &vh->vh_child[c];
+	zio_t *pio = vh->vh_zio;
+
+	ASSERT(MUTEX_HELD(&vh->vh_lock));
+	ASSERT3P(pio, !=, NULL);
+	ASSERT(!vhc->vhc_issued);
+
+	vhc->vhc_zio = zio_vdev_detached_io(pio, bp, vd, offset,
+	    abd_alloc_sametype(pio->io_abd, size), size,
+	    vdev_hedge_read_done, vhc);
+	vhc->vhc_issued = B_TRUE;
+	vhc->vhc_next = vh->vh_issue;
+	vh->vh_issue = c;
+	vh->vh_pending++;
+	vh->vh_refs++;
+}
+
+/*
+ * Let the parent proceed.  Its vdev specific state must reflect the
+ * reads which have completed, and it will not be accessed again.
+ */
+void
+vdev_hedge_release(vdev_hedge_t *vh)
+{
+	ASSERT(MUTEX_HELD(&vh->vh_lock));
+	ASSERT3P(vh->vh_zio, !=, NULL);
+
+	vh->vh_zio = NULL;
+	vh->vh_released = B_TRUE;
+}
+
+static void
+vdev_hedge_timeout(void *arg)
+{
+	vdev_hedge_t *vh = arg;
+
+	mutex_enter(&vh->vh_lock);
+	if (vh->vh_zio != NULL)
+		vh->vh_ops->vho_timeout(vh);
+	vdev_hedge_exit(vh);
+	vdev_hedge_rele(vh);
+}
+
+/*
+ * Called once the initial reads have been created.  Arms the timer which
+ * issues the alternate reads, drops vh_lock and issues the reads.  If the
+ * timer can't be armed, the alternate reads are issued immediately.
+ */
+void
+vdev_hedge_start(vdev_hedge_t *vh)
+{
+	taskqid_t id;
+
+	ASSERT(MUTEX_HELD(&vh->vh_lock));
+	ASSERT3U(vh->vh_pending, >, 0);
+
+	vh->vh_refs++;
+	id = taskq_dispatch_delay(system_delay_taskq, vdev_hedge_timeout, vh,
+	    TQ_NOSLEEP, ddi_get_lbolt() +
+	    MAX(MSEC_TO_TICK(zfs_vdev_hedge_read_ms), 1));
+	if (id == TASKQID_INVALID) {
+		vh->vh_refs--;
+		vh->vh_ops->vho_timeout(vh);
+	}
+
+	vdev_hedge_exit(vh);
+	vdev_hedge_rele(vh);
+}
+
+#if defined(_KERNEL)
+module_param(zfs_vdev_hedge_read_ms, int, 0644);
+MODULE_PARM_DESC(zfs_vdev_hedge_read_ms,
+	"Milliseconds before hedging a slow mirror or raidz read, 0 disables");
+#endif
@@ -269,6 +269,28 @@ vdev_config_generate_stats(vdev_t *vd, nvlist_t *nv)
 	fnvlist_add_uint64(nvx, ZPOOL_CONFIG_VDEV_SCRUB_PEND_QUEUE,
 	    vsx->vsx_pend_queue[ZIO_PRIORITY_SCRUB]);
 
+	/* ZIOs which may be in flight to disk */
+	fnvlist_add_uint64(nvx, ZPOOL_CONFIG_VDEV_SYNC_R_MAX_QUEUE,
+	    vsx->vsx_max_queue[ZIO_PRIORITY_SYNC_READ]);
+
+	fnvlist_add_uint64(nvx, ZPOOL_CONFIG_VDEV_SYNC_W_MAX_QUEUE,
+	    vsx->vsx_max_queue[ZIO_PRIORITY_SYNC_WRITE]);
+
+	fnvlist_add_uint64(nvx, ZPOOL_CONFIG_VDEV_ASYNC_R_MAX_QUEUE,
+	    vsx->vsx_max_queue[ZIO_PRIORITY_ASYNC_READ]);
+
+	fnvlist_add_uint64(nvx, ZPOOL_CONFIG_VDEV_ASYNC_W_MAX_QUEUE,
+	    vsx->vsx_max_queue[ZIO_PRIORITY_ASYNC_WRITE]);
+
+	fnvlist_add_uint64(nvx, ZPOOL_CONFIG_VDEV_SCRUB_MAX_QUEUE,
+	    vsx->vsx_max_queue[ZIO_PRIORITY_SCRUB]);
+
+	/* Allocation weight, see metaslab_class_perf_update() */
+	if (vd == vd->vdev_top && vd->vdev_mg != NULL) {
+		fnvlist_add_uint64(nvx, ZPOOL_CONFIG_VDEV_ALLOC_WEIGHT,
+		    vd->vdev_mg->mg_perf_weight);
+	}
+
 	/* Histograms */
 	fnvlist_add_uint64_array(nvx, ZPOOL_CONFIG_VDEV_TOT_R_LAT_HISTO,
 	    vsx->vsx_total_histo[ZIO_TYPE_READ],
@@ -347,6 +369,31 @@ vdev_config_generate_stats(vdev_t *vd, nvlist_t *nv)
 	    vsx->vsx_agg_histo[ZIO_PRIORITY_SCRUB],
 	    ARRAY_SIZE(vsx->vsx_agg_histo[ZIO_PRIORITY_SCRUB]));
 
+	/* zil_commit() latencies, which are kept for the whole pool */
+	if (vd == vd->vdev_spa->spa_root_vdev) {
+		spa_t *spa = vd->vdev_spa;
+
+		fnvlist_add_uint64_array(nvx, ZPOOL_CONFIG_ZIL_COMMIT_LAT_HISTO,
+		    spa->spa_zil_histo[ZIL_COMMIT_TOTAL],
+		    ARRAY_SIZE(spa->spa_zil_histo[ZIL_COMMIT_TOTAL]));
+
+		fnvlist_add_uint64_array(nvx, ZPOOL_CONFIG_ZIL_GATHER_LAT_HISTO,
+		    spa->spa_zil_histo[ZIL_COMMIT_GATHER],
+		    ARRAY_SIZE(spa->spa_zil_histo[ZIL_COMMIT_GATHER]));
+
+		fnvlist_add_uint64_array(nvx, ZPOOL_CONFIG_ZIL_ISSUE_LAT_HISTO,
+		    spa->spa_zil_histo[ZIL_COMMIT_ISSUE],
+		    ARRAY_SIZE(spa->spa_zil_histo[ZIL_COMMIT_ISSUE]));
+
+		fnvlist_add_uint64_array(nvx, ZPOOL_CONFIG_ZIL_WAIT_LAT_HISTO,
+		    spa->spa_zil_histo[ZIL_COMMIT_WAIT],
+		    ARRAY_SIZE(spa->spa_zil_histo[ZIL_COMMIT_WAIT]));
+
+		fnvlist_add_uint64_array(nvx, ZPOOL_CONFIG_ZIL_FLUSH_LAT_HISTO,
+		    spa->spa_zil_histo[ZIL_COMMIT_FLUSH],
+		    ARRAY_SIZE(spa->spa_zil_histo[ZIL_COMMIT_FLUSH]));
+	}
+
 	/* Add extended stats nvlist to main nvlist */
 	fnvlist_add_nvlist(nv, ZPOOL_CONFIG_VDEV_STATS_EX, nvx);
 
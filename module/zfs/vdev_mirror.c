@@ -31,6 +31,7 @@
 #include <sys/spa.h>
 #include <sys/vdev_impl.h>
 #include <sys/zio.h>
+#include <sys/zio_checksum.h>
 #include <sys/abd.h>
 #include <sys/fs/zfs.h>
 
@@ -48,6 +49,10 @@ typedef struct mirror_stats {
 
 	kstat_named_t vdev_mirror_stat_preferred_found;
 	kstat_named_t vdev_mirror_stat_preferred_not_found;
+
+	kstat_named_t vdev_mirror_stat_latency_clamped;
+
+	kstat_named_t vdev_mirror_stat_hedged;
 } mirror_stats_t;
 
 static mirror_stats_t mirror_stats = {
@@ -65,6 +70,10 @@ static mirror_stats_t mirror_stats = {
 	{ "preferred_found",			KSTAT_DATA_UINT64 },
 	/* Preferred child vdev not found or equal load  */
 	{ "preferred_not_found",		KSTAT_DATA_UINT64 },
+	/* Latency scaled load exceeded the maximum load */
+	{ "latency_clamped",			KSTAT_DATA_UINT64 },
+	/* Alternate child read issued for a slow or failed hedged read */
+	{ "hedged",				KSTAT_DATA_UINT64 },
 
 };
 
@@ -105,6 +114,7 @@ typedef struct mirror_child {
 	uint8_t		mc_tried;
 	uint8_t		mc_skipped;
 	uint8_t		mc_speculative;
+	uint8_t		mc_hedged;
 } mirror_child_t;
 
 typedef struct mirror_map {
@@ -137,6 +147,12 @@ static int zfs_vdev_mirror_rotating_seek_offset = 1 * 1024 * 1024;
 static int zfs_vdev_mirror_non_rotating_inc = 0;
 static int zfs_vdev_mirror_non_rotating_seek_inc = 1;
 
+/*
+ * Scale the load of each child by its measured device service time, so
+ * reads are steered away from slower or temporarily stalled children.
+ */
+static int zfs_vdev_mirror_latency_aware = 1;
+
 static inline size_t
 vdev_mirror_map_size(int children)
 {
@@ -172,6 +188,38 @@ static const zio_vsd_ops_t vdev_mirror_vsd_ops = {
 	.vsd_cksum_report = zio_vsd_default_cksum_report
 };
 
+/*
+ * Scale the queue and locality based load of a child by its measured
+ * service time.  The latency is rounded down to a power of two so that
+ * children of similar speed continue to be chosen between by queue length
+ * and locality alone, while a child which is several times slower than
+ * its siblings, because it is of a slower media type or is suffering
+ * from a firmware hiccup, only receives reads once their queues are
+ * correspondingly longer.  Children without a recent latency measurement
+ * are not scaled so they are probed with reads.
+ */
+static int
+vdev_mirror_load_latency(vdev_t *vd, int load)
+{
+	hrtime_t lat;
+	uint64_t scaled;
+
+	if (!zfs_vdev_mirror_latency_aware)
+		return (load);
+
+	lat = NSEC2USEC(vdev_queue_latency(vd));
+	if (lat <= 0)
+		return (load);
+
+	scaled = (uint64_t)(load + 1) << (highbit64(lat) - 1);
+	if (scaled > INT_MAX) {
+		MIRROR_BUMP(vdev_mirror_stat_latency_clamped);
+		return (INT_MAX);
+	}
+
+	return ((int)scaled);
+}
+
 static int
 vdev_mirror_load(mirror_map_t *mm, vdev_t *vd, uint64_t zio_offset)
 {
@@ -201,39 +249,41 @@ vdev_mirror_load(mirror_map_t *mm, vdev_t *vd, uint64_t zio_offset)
 		/* Non-rotating media. */
 		if (last_offset == zio_offset) {
 			MIRROR_BUMP(vdev_mirror_stat_non_rotating_linear);
-			return (load + zfs_vdev_mirror_non_rotating_inc);
+			load += zfs_vdev_mirror_non_rotating_inc;
+		} else {
+			/*
+			 * Apply a seek penalty even for non-rotating devices
+			 * as sequential I/O's can be aggregated into fewer
+			 * operations on the device, thus avoiding unnecessary
+			 * per-command overhead and boosting performance.
+			 */
+			MIRROR_BUMP(vdev_mirror_stat_non_rotating_seek);
+			load += zfs_vdev_mirror_non_rotating_seek_inc;
 		}
 
-		/*
-		 * Apply a seek penalty even for non-rotating devices as
-		 * sequential I/O's can be aggregated into fewer operations on
-		 * the device, thus avoiding unnecessary per-command overhead
-		 * and boosting performance.
-		 */
-		MIRROR_BUMP(vdev_mirror_stat_non_rotating_seek);
-		return (load + zfs_vdev_mirror_non_rotating_seek_inc);
+		return (vdev_mirror_load_latency(vd, load));
 	}
 
-	/* Rotating media I/O's which directly follow the last I/O. */
+	offset_diff = (int64_t)(last_offset - zio_offset);
 	if (last_offset == zio_offset) {
+		/* Rotating media I/O's which directly follow the last I/O. */
 		MIRROR_BUMP(vdev_mirror_stat_rotating_linear);
-		return (load + zfs_vdev_mirror_rotating_inc);
-	}
-
-	/*
-	 * Apply half the seek increment to I/O's within seek offset
-	 * of the last I/O issued to this vdev as they should incur less
-	 * of a seek increment.
-	 */
-	offset_diff = (int64_t)(last_offset - zio_offset);
-	if (ABS(offset_diff) < zfs_vdev_mirror_rotating_seek_offset) {
+		load += zfs_vdev_mirror_rotating_inc;
+	} else if (ABS(offset_diff) < zfs_vdev_mirror_rotating_seek_offset) {
+		/*
+		 * Apply half the seek increment to I/O's within seek offset
+		 * of the last I/O issued to this vdev as they should incur
+		 * less of a seek increment.
+		 */
 		MIRROR_BUMP(vdev_mirror_stat_rotating_offset);
-		return (load + (zfs_vdev_mirror_rotating_seek_inc / 2));
+		load += (zfs_vdev_mirror_rotating_seek_inc / 2);
+	} else {
+		/* Apply the full seek increment to all other I/O's. */
+		MIRROR_BUMP(vdev_mirror_stat_rotating_seek);
+		load += zfs_vdev_mirror_rotating_seek_inc;
 	}
 
-	/* Apply the full seek increment to all other I/O's. */
-	MIRROR_BUMP(vdev_mirror_stat_rotating_seek);
-	return (load + zfs_vdev_mirror_rotating_seek_inc);
+	return (vdev_mirror_load_latency(vd, load));
 }
 
 /*
@@ -503,6 +553,152 @@ vdev_mirror_child_select(zio_t *zio)
 	return (-1);
 }
 
+/*
+ * Issue a hedged read to the best child which hasn't yet been read.
+ * Children whose DTL contains the block aren't hedged to; if they are
+ * all that's left they are tried by vdev_mirror_io_done() as usual.
+ */
+static boolean_t
+vdev_mirror_hedge_next(vdev_hedge_t *vh, zio_t *zio)
+{
+	mirror_map_t *mm = zio->io_vsd;
+	mirror_child_t *mc;
+	int c;
+
+	c = vdev_mirror_child_select(zio);
+	if (c < 0)
+		return (B_FALSE);
+
+	mc = &mm->mm_child[c];
+	if (mc->mc_skipped || vh->vh_child[c].vhc_issued)
+		return (B_FALSE);
+
+	mc->mc_tried = 1;
+	mc->mc_hedged = 1;
+	vdev_hedge_read(vh, c, mc->mc_vd, mc->mc_offset, zio->io_size,
+	    zio->io_bp);
+
+	return (B_TRUE);
+}
+
+/*
+ * Children whose reads are still outstanding are treated as untried by
+ * vdev_mirror_io_done(), so they are neither counted as good copies nor
+ * repaired.
+ */
+static void
+vdev_mirror_hedge_release(vdev_hedge_t *vh, mirror_map_t *mm)
+{
+	for (int c = 0; c < mm->mm_children; c++) {
+		mirror_child_t *mc = &mm->mm_child[c];
+
+		if (mc->mc_hedged) {
+			mc->mc_hedged = 0;
+			mc->mc_tried = 0;
+		}
+	}
+
+	vdev_hedge_release(vh);
+}
+
+static void
+vdev_mirror_hedge_done(vdev_hedge_t *vh, int c, zio_t *zio)
+{
+	zio_t *pio = vh->vh_zio;
+	mirror_map_t *mm = pio->io_vsd;
+	mirror_child_t *mc = &mm->mm_child[c];
+	int error = zio->io_error;
+
+	/*
+	 * The read isn't a child of the mirror zio, so its checksum must
+	 * be verified here rather than by the pipeline.
+	 */
+	if (error == 0) {
+		zio_bad_cksum_t zbc;
+
+		bzero(&zbc, sizeof (zio_bad_cksum_t));
+		error = zio_checksum_error(zio, &zbc);
+		if (error == ECKSUM) {
+			vdev_t *vd = mc->mc_vd;
+
+			mutex_enter(&vd->vdev_stat_lock);
+			vd->vdev_stat.vs_checksum_errors++;
+			mutex_exit(&vd->vdev_stat_lock);
+
+			zfs_ereport_post_checksum(pio->io_spa, vd,
+			    &pio->io_bookmark, pio, mc->mc_offset,
+			    zio->io_size, NULL, zio->io_abd, &zbc);
+		}
+	}
+
+	mc->mc_error = error;
+	mc->mc_tried = 1;
+	mc->mc_skipped = 0;
+	mc->mc_hedged = 0;
+
+	if (error == 0) {
+		abd_copy(pio->io_abd, zio->io_abd, pio->io_size);
+		vdev_mirror_hedge_release(vh, mm);
+		return;
+	}
+
+	if (vdev_mirror_hedge_next(vh, pio)) {
+		MIRROR_BUMP(vdev_mirror_stat_hedged);
+		return;
+	}
+
+	if (vh->vh_pending == 0)
+		vdev_mirror_hedge_release(vh, mm);
+}
+
+static void
+vdev_mirror_hedge_timeout(vdev_hedge_t *vh)
+{
+	if (vdev_mirror_hedge_next(vh, vh->vh_zio))
+		MIRROR_BUMP(vdev_mirror_stat_hedged);
+}
+
+static const vdev_hedge_ops_t vdev_mirror_hedge_ops = {
+	.vho_done = vdev_mirror_hedge_done,
+	.vho_timeout = vdev_mirror_hedge_timeout
+};
+
+/*
+ * Read child c with a hedged read, so that if it is slow the read is
+ * reissued to another child.  Returns B_FALSE if the read must be
+ * issued as usual instead.
+ */
+static boolean_t
+vdev_mirror_hedge(zio_t *zio, int c)
+{
+	mirror_map_t *mm = zio->io_vsd;
+	mirror_child_t *mc = &mm->mm_child[c];
+	vdev_hedge_t *vh;
+
+	if (mm->mm_root || mm->mm_replacing || mm->mm_children < 2 ||
+	    mc->mc_skipped || !vdev_hedge_enabled(zio))
+		return (B_FALSE);
+
+	for (int i = 0; i < mm->mm_children; i++) {
+		if (!mm->mm_child[i].mc_vd->vdev_ops->vdev_op_leaf)
+			return (B_FALSE);
+	}
+
+	vh = vdev_hedge_create(zio, mm->mm_children, &vdev_mirror_hedge_ops);
+	if (vh == NULL)
+		return (B_FALSE);
+
+	zio->io_pipeline &= ~ZIO_STAGE_CHECKSUM_VERIFY;
+
+	mc->mc_tried = 1;
+	mc->mc_hedged = 1;
+	vdev_hedge_read(vh, c, mc->mc_vd, mc->mc_offset, zio->io_size,
+	    zio->io_bp);
+	vdev_hedge_start(vh);
+
+	return (B_TRUE);
+}
+
 static void
 vdev_mirror_io_start(zio_t *zio)
 {
@@ -546,6 +742,10 @@ vdev_mirror_io_start(zio_t *zio)
 		 * For normal reads just pick one child.
 		 */
 		c = vdev_mirror_child_select(zio);
+		if (c >= 0 && vdev_mirror_hedge(zio, c)) {
+			zio_execute(zio);
+			return;
+		}
 		children = (c >= 0);
 	} else {
 		ASSERT(zio->io_type == ZIO_TYPE_WRITE);
@@ -660,7 +860,13 @@ vdev_mirror_io_done(zio_t *zio)
 		ASSERT(zio->io_error != 0);
 	}
 
+	/*
+	 * The good data may be in a user's buffer, which they are free to
+	 * have changed since it was verified, so it can't be trusted for
+	 * repair.  Damage is left for a scrub or a read through the ARC.
+	 */
 	if (good_copies && spa_writeable(zio->io_spa) &&
+	    !abd_is_user(zio->io_abd) &&
 	    (unexpected_errors ||
 	    (zio->io_flags & ZIO_FLAG_RESILVER) ||
 	    ((zio->io_flags & ZIO_FLAG_SCRUB) && mm->mm_replacing))) {
@@ -740,6 +946,7 @@ vdev_ops_t vdev_mirror_ops = {
 	NULL,
 	NULL,
 	NULL,
+	vdev_default_xlate,
 	VDEV_TYPE_MIRROR,	/* name of this vdev type */
 	B_FALSE			/* not a leaf vdev */
 };
@@ -755,6 +962,7 @@ vdev_ops_t vdev_replacing_ops = {
 	NULL,
 	NULL,
 	NULL,
+	vdev_default_xlate,
 	VDEV_TYPE_REPLACING,	/* name of this vdev type */
 	B_FALSE			/* not a leaf vdev */
 };
@@ -770,6 +978,7 @@ vdev_ops_t vdev_spare_ops = {
 	NULL,
 	NULL,
 	NULL,
+	vdev_default_xlate,
 	VDEV_TYPE_SPARE,	/* name of this vdev type */
 	B_FALSE			/* not a leaf vdev */
 };
@@ -797,5 +1006,9 @@ MODULE_PARM_DESC(zfs_vdev_mirror_non_rotating_inc,
 module_param(zfs_vdev_mirror_non_rotating_seek_inc, int, 0644);
 MODULE_PARM_DESC(zfs_vdev_mirror_non_rotating_seek_inc,
 	"Non-rotating media load increment for seeking I/O's");
+
+module_param(zfs_vdev_mirror_latency_aware, int, 0644);
+MODULE_PARM_DESC(zfs_vdev_mirror_latency_aware,
+	"Scale mirror child load by measured device latency");
 /* END CSTYLED */
 #endif
@@ -38,6 +38,10 @@
 #include <sys/spa_impl.h>
 #include <sys/kstat.h>
 #include <sys/abd.h>
+#include <sys/dataset_kstats.h>
+#if defined(_KERNEL) && defined(HAVE_BLK_QUEUE_HAVE_BLK_PLUG)
+#include <linux/blkdev.h>
+#endif
 
 /*
  * ZFS I/O Scheduler
@@ -141,6 +145,10 @@ uint32_t zfs_vdev_max_active = 1000;
  * zfs_vdev_scrub_max_active will cause the scrub or resilver to complete
  * more quickly, but reads and writes to have higher latency and lower
  * throughput.
+ *
+ * Trims are issued from the lowest priority queue.  Many devices service
+ * a discard by stalling their other outstanding commands, so by default
+ * only a single trim is allowed to be active per device.
  */
 uint32_t zfs_vdev_sync_read_min_active = 10;
 uint32_t zfs_vdev_sync_read_max_active = 10;
@@ -154,6 +162,8 @@ uint32_t zfs_vdev_scrub_min_active = 1;
 uint32_t zfs_vdev_scrub_max_active = 2;
 uint32_t zfs_vdev_removal_min_active = 1;
 uint32_t zfs_vdev_removal_max_active = 2;
+uint32_t zfs_vdev_trim_min_active = 1;
+uint32_t zfs_vdev_trim_max_active = 1;
 
 /*
  * When the pool has less than zfs_vdev_async_write_active_min_dirty_percent
@@ -175,6 +185,65 @@ int zfs_vdev_aggregation_limit = 1 << 20;
 int zfs_vdev_read_gap_limit = 32 << 10;
 int zfs_vdev_write_gap_limit = 4 << 10;
 
+/*
+ * The device service time of each leaf vdev is tracked as an exponentially
+ * weighted moving average, with each new sample given a weight of
+ * 1/2^VDEV_QUEUE_LATENCY_SHIFT.  Samples older than VDEV_QUEUE_LATENCY_STALE
+ * are no longer considered representative of the device.
+ */
+#define	VDEV_QUEUE_LATENCY_SHIFT	3
+#define	VDEV_QUEUE_LATENCY_STALE	SEC2NSEC(1)
+
+/*
+ * When zfs_vdev_queue_adaptive is set, the max_active of each class of each
+ * leaf vdev is adjusted every zfs_vdev_queue_adapt_interval_ms, rather than
+ * being fixed by the tunables above.  For each class the mean device
+ * service time over the interval is compared with a baseline, the lowest
+ * mean seen recently.  If the mean exceeds the baseline by more than
+ * zfs_vdev_queue_latency_pct percent the device is congested and the depth
+ * is cut by a quarter, and otherwise, if i/os of the class were held back
+ * by the depth during the interval, it is grown by one.  Since deeper
+ * queues of one class raise the latency of every class, congestion of a
+ * class also cuts the depth of all lower priority classes.
+ *
+ * The depth never drops below the class's min_active.  The synchronous and
+ * asynchronous read and write classes may grow up to zfs_vdev_max_active,
+ * while scrub, removal and trim i/os, which are meant to stay in the
+ * background, are limited to their max_active.  Async writes continue to
+ * be scaled between min_active and the depth by the amount of dirty data.
+ *
+ * The baseline tracks any decrease immediately but rises by only
+ * 1/2^VDEV_QUEUE_BASE_SHIFT of the difference per interval, so a change
+ * in the workload or the device is eventually accepted as the new normal.
+ */
+int zfs_vdev_queue_adaptive = 0;
+int zfs_vdev_queue_adapt_interval_ms = 100;
+int zfs_vdev_queue_latency_pct = 200;
+
+#define	VDEV_QUEUE_BASE_SHIFT	4
+
+/*
+ * Within each class i/os are normally issued in LBA or FIFO order, so an
+ * objset with many i/os queued gets a correspondingly large share of the
+ * device.  When zfs_vdev_fair_queue is set, the i/os queued to each leaf
+ * vdev are also grouped into flows by objset, and each class instead
+ * issues from its flows by deficit round robin: each flow in turn may
+ * issue up to zfs_vdev_fair_quantum bytes, in the class's usual order,
+ * before the next flow gets its turn.  Aggregation is unaffected, and may
+ * pull i/os of other flows into the aggregate, which are charged to those
+ * flows.  While enabled, the number of bytes issued for each dataset and
+ * the time its i/os spent queued are added to the dataset's kstats.
+ */
+int zfs_vdev_fair_queue = 0;
+int zfs_vdev_fair_quantum = 128 << 10;
+
+/*
+ * When an i/o completes, every queued i/o which may now be issued is
+ * gathered while holding vq_lock, up to VDEV_QUEUE_ISSUE_BATCH at a time,
+ * and then issued together by vdev_queue_issue().
+ */
+#define	VDEV_QUEUE_ISSUE_BATCH	16
+
 /*
  * Define the queue depth percentage for each top-level. This percentage is
  * used in conjunction with zfs_vdev_async_max_active to determine how many
@@ -200,6 +269,11 @@ int zfs_vdev_queue_depth_pct = 300;
  */
 int zfs_vdev_def_queue_depth = 32;
 
+/*
+ * Flows are allocated under vq_lock, KM_NOSLEEP from their own cache, and
+ * keep their (empty) per-class trees while cached.
+ */
+static kmem_cache_t *vdev_queue_flow_cache;
 
 int
 vdev_queue_offset_compare(const void *x1, const void *x2)
@@ -224,11 +298,14 @@ vdev_queue_class_tree(vdev_queue_t *vq, zio_priority_t p)
 static inline avl_tree_t *
 vdev_queue_type_tree(vdev_queue_t *vq, zio_type_t t)
 {
-	ASSERT(t == ZIO_TYPE_READ || t == ZIO_TYPE_WRITE);
+	ASSERT(t == ZIO_TYPE_READ || t == ZIO_TYPE_WRITE ||
+	    t == ZIO_TYPE_TRIM);
 	if (t == ZIO_TYPE_READ)
 		return (&vq->vq_read_offset_tree);
-	else
+	else if (t == ZIO_TYPE_WRITE)
 		return (&vq->vq_write_offset_tree);
+	else
+		return (&vq->vq_trim_offset_tree);
 }
 
 int
@@ -245,6 +322,25 @@ vdev_queue_timestamp_compare(const void *x1, const void *x2)
 	return (AVL_PCMP(z1, z2));
 }
 
+/*
+ * The synchronous i/o queues are dispatched in FIFO rather than LBA order.
+ * This provides more consistent latency for these i/os.
+ */
+static inline boolean_t
+vdev_queue_class_fifo(zio_priority_t p)
+{
+	return (p == ZIO_PRIORITY_SYNC_READ || p == ZIO_PRIORITY_SYNC_WRITE);
+}
+
+static int
+vdev_queue_flow_compare(const void *x1, const void *x2)
+{
+	const vdev_queue_flow_t *f1 = x1;
+	const vdev_queue_flow_t *f2 = x2;
+
+	return (AVL_CMP(f1->vqf_objset, f2->vqf_objset));
+}
+
 static int
 vdev_queue_class_min_active(zio_priority_t p)
 {
@@ -261,6 +357,8 @@ vdev_queue_class_min_active(zio_priority_t p)
 		return (zfs_vdev_scrub_min_active);
 	case ZIO_PRIORITY_REMOVAL:
 		return (zfs_vdev_removal_min_active);
+	case ZIO_PRIORITY_TRIM:
+		return (zfs_vdev_trim_min_active);
 	default:
 		panic("invalid priority %u", p);
 		return (0);
@@ -268,7 +366,7 @@ vdev_queue_class_min_active(zio_priority_t p)
 }
 
 static int
-vdev_queue_max_async_writes(spa_t *spa)
+vdev_queue_max_async_writes(spa_t *spa, int max_active)
 {
 	int writes;
 	uint64_t dirty = 0;
@@ -284,20 +382,20 @@ vdev_queue_max_async_writes(spa_t *spa)
 	 * completion of dmu_objset_open_impl().
 	 */
 	if (dp == NULL)
-		return (zfs_vdev_async_write_max_active);
+		return (max_active);
 
 	/*
 	 * Sync tasks correspond to interactive user actions. To reduce the
 	 * execution time of those actions we push data out as fast as possible.
 	 */
 	if (spa_has_pending_synctask(spa))
-		return (zfs_vdev_async_write_max_active);
+		return (max_active);
 
 	dirty = dp->dp_dirty_total;
 	if (dirty < min_bytes)
 		return (zfs_vdev_async_write_min_active);
 	if (dirty > max_bytes)
-		return (zfs_vdev_async_write_max_active);
+		return (max_active);
 
 	/*
 	 * linear interpolation:
@@ -306,17 +404,17 @@ vdev_queue_max_async_writes(spa_t *spa)
 	 * move up by min_writes
 	 */
 	writes = (dirty - min_bytes) *
-	    (zfs_vdev_async_write_max_active -
+	    (max_active -
 	    zfs_vdev_async_write_min_active) /
 	    (max_bytes - min_bytes) +
 	    zfs_vdev_async_write_min_active;
 	ASSERT3U(writes, >=, zfs_vdev_async_write_min_active);
-	ASSERT3U(writes, <=, zfs_vdev_async_write_max_active);
+	ASSERT3U(writes, <=, max_active);
 	return (writes);
 }
 
 static int
-vdev_queue_class_max_active(spa_t *spa, zio_priority_t p)
+vdev_queue_class_tunable_max_active(zio_priority_t p)
 {
 	switch (p) {
 	case ZIO_PRIORITY_SYNC_READ:
@@ -326,17 +424,33 @@ vdev_queue_class_max_active(spa_t *spa, zio_priority_t p)
 	case ZIO_PRIORITY_ASYNC_READ:
 		return (zfs_vdev_async_read_max_active);
 	case ZIO_PRIORITY_ASYNC_WRITE:
-		return (vdev_queue_max_async_writes(spa));
+		return (zfs_vdev_async_write_max_active);
 	case ZIO_PRIORITY_SCRUB:
 		return (zfs_vdev_scrub_max_active);
 	case ZIO_PRIORITY_REMOVAL:
 		return (zfs_vdev_removal_max_active);
+	case ZIO_PRIORITY_TRIM:
+		return (zfs_vdev_trim_max_active);
 	default:
 		panic("invalid priority %u", p);
 		return (0);
 	}
 }
 
+static int
+vdev_queue_class_max_active(spa_t *spa, vdev_queue_t *vq, zio_priority_t p)
+{
+	int max_active = vdev_queue_class_tunable_max_active(p);
+
+	if (zfs_vdev_queue_adaptive && vq->vq_class[p].vqc_max_active != 0)
+		max_active = vq->vq_class[p].vqc_max_active;
+
+	if (p == ZIO_PRIORITY_ASYNC_WRITE)
+		return (vdev_queue_max_async_writes(spa, max_active));
+
+	return (max_active);
+}
+
 /*
  * Return the i/o class to issue from, or ZIO_PRIORITY_MAX_QUEUEABLE if
  * there is no eligible class.
@@ -363,10 +477,12 @@ vdev_queue_class_to_issue(vdev_queue_t *vq)
 	 * maximum # outstanding i/os.
 	 */
 	for (p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
-		if (avl_numnodes(vdev_queue_class_tree(vq, p)) > 0 &&
-		    vq->vq_class[p].vqc_active <
-		    vdev_queue_class_max_active(spa, p))
+		if (avl_numnodes(vdev_queue_class_tree(vq, p)) == 0)
+			continue;
+		if (vq->vq_class[p].vqc_active <
+		    vdev_queue_class_max_active(spa, vq, p))
 			return (p);
+		vq->vq_class[p].vqc_limited = B_TRUE;
 	}
 
 	/* No eligible queued i/os */
@@ -391,48 +507,178 @@ vdev_queue_init(vdev_t *vd)
 	avl_create(vdev_queue_type_tree(vq, ZIO_TYPE_WRITE),
 	    vdev_queue_offset_compare, sizeof (zio_t),
 	    offsetof(struct zio, io_offset_node));
+	avl_create(vdev_queue_type_tree(vq, ZIO_TYPE_TRIM),
+	    vdev_queue_offset_compare, sizeof (zio_t),
+	    offsetof(struct zio, io_offset_node));
 
 	for (p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
-		int (*compfn) (const void *, const void *);
-
-		/*
-		 * The synchronous i/o queues are dispatched in FIFO rather
-		 * than LBA order. This provides more consistent latency for
-		 * these i/os.
-		 */
-		if (p == ZIO_PRIORITY_SYNC_READ || p == ZIO_PRIORITY_SYNC_WRITE)
-			compfn = vdev_queue_timestamp_compare;
-		else
-			compfn = vdev_queue_offset_compare;
-		avl_create(vdev_queue_class_tree(vq, p), compfn,
-		    sizeof (zio_t), offsetof(struct zio, io_queue_node));
+		avl_create(vdev_queue_class_tree(vq, p),
+		    vdev_queue_class_fifo(p) ? vdev_queue_timestamp_compare :
+		    vdev_queue_offset_compare, sizeof (zio_t),
+		    offsetof(struct zio, io_queue_node));
+		list_create(&vq->vq_class[p].vqc_flow_list,
+		    sizeof (vdev_queue_flow_t),
+		    offsetof(vdev_queue_flow_t, vqf_class[p].vqfc_node));
 	}
+	avl_create(&vq->vq_flow_tree, vdev_queue_flow_compare,
+	    sizeof (vdev_queue_flow_t), offsetof(vdev_queue_flow_t, vqf_node));
 
 	vq->vq_last_offset = 0;
 }
 
+/*ARGSUSED*/
+static int
+vdev_queue_flow_cons(void *vbuf, void *unused, int kmflag)
+{
+	vdev_queue_flow_t *vqf = vbuf;
+
+	bzero(vqf, sizeof (vdev_queue_flow_t));
+	for (zio_priority_t p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
+		avl_create(&vqf->vqf_class[p].vqfc_queued_tree,
+		    vdev_queue_class_fifo(p) ? vdev_queue_timestamp_compare :
+		    vdev_queue_offset_compare, sizeof (zio_t),
+		    offsetof(struct zio, io_flow_node));
+		list_link_init(&vqf->vqf_class[p].vqfc_node);
+	}
+
+	return (0);
+}
+
+/*ARGSUSED*/
+static void
+vdev_queue_flow_dest(void *vbuf, void *unused)
+{
+	vdev_queue_flow_t *vqf = vbuf;
+
+	for (zio_priority_t p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++)
+		avl_destroy(&vqf->vqf_class[p].vqfc_queued_tree);
+}
+
+void
+vdev_queue_cache_init(void)
+{
+	vdev_queue_flow_cache = kmem_cache_create("vdev_queue_flow_cache",
+	    sizeof (vdev_queue_flow_t), 0, vdev_queue_flow_cons,
+	    vdev_queue_flow_dest, NULL, NULL, NULL, 0);
+}
+
+void
+vdev_queue_cache_fini(void)
+{
+	kmem_cache_destroy(vdev_queue_flow_cache);
+}
+
 void
 vdev_queue_fini(vdev_t *vd)
 {
 	vdev_queue_t *vq = &vd->vdev_queue;
 
-	for (zio_priority_t p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++)
+	for (zio_priority_t p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
 		avl_destroy(vdev_queue_class_tree(vq, p));
+		list_destroy(&vq->vq_class[p].vqc_flow_list);
+	}
+	avl_destroy(&vq->vq_flow_tree);
 	avl_destroy(&vq->vq_active_tree);
 	avl_destroy(vdev_queue_type_tree(vq, ZIO_TYPE_READ));
 	avl_destroy(vdev_queue_type_tree(vq, ZIO_TYPE_WRITE));
+	avl_destroy(vdev_queue_type_tree(vq, ZIO_TYPE_TRIM));
 
 	mutex_destroy(&vq->vq_lock);
 }
 
+/*
+ * Add a queued i/o to the tree of its class and, when fair queueing is
+ * enabled, to its objset's flow.  A new flow holds the objset's dataset
+ * kstats, if it has any, so the i/os it issues are accounted without a
+ * lookup.  Should no flow be available, the i/o is queued as if fair
+ * queueing were disabled.
+ */
+static void
+vdev_queue_class_add(vdev_queue_t *vq, zio_t *zio)
+{
+	zio_priority_t p = zio->io_priority;
+	vdev_queue_flow_t *vqf, search;
+	vdev_queue_flow_class_t *vqfc;
+	avl_index_t where;
+
+	ASSERT(MUTEX_HELD(&vq->vq_lock));
+	ASSERT3U(p, <, ZIO_PRIORITY_NUM_QUEUEABLE);
+	ASSERT3P(zio->io_flow, ==, NULL);
+
+	avl_add(vdev_queue_class_tree(vq, p), zio);
+
+	if (!zfs_vdev_fair_queue) {
+		vq->vq_class[p].vqc_unflowed++;
+		return;
+	}
+
+	search.vqf_objset = zio->io_bookmark.zb_objset;
+	vqf = avl_find(&vq->vq_flow_tree, &search, &where);
+	if (vqf == NULL) {
+		vqf = kmem_cache_alloc(vdev_queue_flow_cache, KM_NOSLEEP);
+		if (vqf == NULL) {
+			vq->vq_class[p].vqc_unflowed++;
+			return;
+		}
+		vqf->vqf_objset = search.vqf_objset;
+		vqf->vqf_kstats = dataset_kstats_hold(zio->io_spa,
+		    search.vqf_objset);
+		avl_insert(&vq->vq_flow_tree, vqf, where);
+	}
+
+	vqfc = &vqf->vqf_class[p];
+	if (avl_is_empty(&vqfc->vqfc_queued_tree)) {
+		ASSERT0(vqfc->vqfc_deficit);
+		list_insert_tail(&vq->vq_class[p].vqc_flow_list, vqf);
+	}
+	avl_add(&vqfc->vqfc_queued_tree, zio);
+	vqf->vqf_queued++;
+	zio->io_flow = vqf;
+}
+
+static void
+vdev_queue_class_remove(vdev_queue_t *vq, zio_t *zio)
+{
+	zio_priority_t p = zio->io_priority;
+	vdev_queue_flow_t *vqf = zio->io_flow;
+	vdev_queue_flow_class_t *vqfc;
+
+	ASSERT(MUTEX_HELD(&vq->vq_lock));
+	ASSERT3U(p, <, ZIO_PRIORITY_NUM_QUEUEABLE);
+
+	avl_remove(vdev_queue_class_tree(vq, p), zio);
+
+	if (vqf == NULL) {
+		ASSERT3U(vq->vq_class[p].vqc_unflowed, >, 0);
+		vq->vq_class[p].vqc_unflowed--;
+		return;
+	}
+
+	vqfc = &vqf->vqf_class[p];
+	avl_remove(&vqfc->vqfc_queued_tree, zio);
+	if (avl_is_empty(&vqfc->vqfc_queued_tree)) {
+		list_remove(&vq->vq_class[p].vqc_flow_list, vqf);
+		vqfc->vqfc_deficit = 0;
+	}
+	zio->io_flow = NULL;
+
+	if (--vqf->vqf_queued == 0) {
+		avl_remove(&vq->vq_flow_tree, vqf);
+		if (vqf->vqf_kstats != NULL) {
+			dataset_kstats_rele(vqf->vqf_kstats);
+			vqf->vqf_kstats = NULL;
+		}
+		kmem_cache_free(vdev_queue_flow_cache, vqf);
+	}
+}
+
 static void
 vdev_queue_io_add(vdev_queue_t *vq, zio_t *zio)
 {
 	spa_t *spa = zio->io_spa;
 	spa_history_kstat_t *shk = &spa->spa_stats.io_history;
 
-	ASSERT3U(zio->io_priority, <, ZIO_PRIORITY_NUM_QUEUEABLE);
-	avl_add(vdev_queue_class_tree(vq, zio->io_priority), zio);
+	vdev_queue_class_add(vq, zio);
 	avl_add(vdev_queue_type_tree(vq, zio->io_type), zio);
 
 	if (shk->kstat != NULL) {
@@ -442,14 +688,26 @@ vdev_queue_io_add(vdev_queue_t *vq, zio_t *zio)
 	}
 }
 
+/*
+ * Remove an i/o from the queue as it is issued, charging it to its flow.
+ */
 static void
 vdev_queue_io_remove(vdev_queue_t *vq, zio_t *zio)
 {
 	spa_t *spa = zio->io_spa;
 	spa_history_kstat_t *shk = &spa->spa_stats.io_history;
 
-	ASSERT3U(zio->io_priority, <, ZIO_PRIORITY_NUM_QUEUEABLE);
-	avl_remove(vdev_queue_class_tree(vq, zio->io_priority), zio);
+	if (zio->io_flow != NULL) {
+		vdev_queue_flow_t *vqf = zio->io_flow;
+
+		vqf->vqf_class[zio->io_priority].vqfc_deficit -= zio->io_size;
+		if (vqf->vqf_kstats != NULL) {
+			dataset_kstats_update_queue_kstats(vqf->vqf_kstats,
+			    zio->io_size, gethrtime() - zio->io_timestamp);
+		}
+	}
+
+	vdev_queue_class_remove(vq, zio);
 	avl_remove(vdev_queue_type_tree(vq, zio->io_type), zio);
 
 	if (shk->kstat != NULL) {
@@ -548,6 +806,13 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 	if (zio->io_flags & ZIO_FLAG_DONT_AGGREGATE || limit == 0)
 		return (NULL);
 
+	/*
+	 * Trims are not aggregated, their size is already bounded by
+	 * zfs_trim_extent_bytes_max and there is no data to copy.
+	 */
+	if (zio->io_type == ZIO_TYPE_TRIM)
+		return (NULL);
+
 	first = last = zio;
 
 	if (zio->io_type == ZIO_TYPE_READ)
@@ -699,6 +964,43 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 	return (aio);
 }
 
+/*
+ * Return the queued i/o of the given class to issue next by deficit round
+ * robin across flows.  The flow at the head of the class's list issues
+ * i/os until its deficit is used up, at which point it is granted another
+ * zfs_vdev_fair_quantum bytes and moved to the tail.  Within the flow the
+ * i/o is chosen as it would be from the class as a whole.
+ */
+static zio_t *
+vdev_queue_fair_to_issue(vdev_queue_t *vq, zio_priority_t p)
+{
+	list_t *flows = &vq->vq_class[p].vqc_flow_list;
+	int64_t quantum = MAX(zfs_vdev_fair_quantum, SPA_MINBLOCKSIZE);
+	vdev_queue_flow_t *vqf;
+	avl_index_t idx;
+	avl_tree_t *tree;
+	zio_t *zio;
+
+	ASSERT(MUTEX_HELD(&vq->vq_lock));
+	ASSERT0(vq->vq_class[p].vqc_unflowed);
+
+	while ((vqf = list_head(flows))->vqf_class[p].vqfc_deficit <= 0) {
+		vqf->vqf_class[p].vqfc_deficit += quantum;
+		list_remove(flows, vqf);
+		list_insert_tail(flows, vqf);
+	}
+
+	tree = &vqf->vqf_class[p].vqfc_queued_tree;
+	vq->vq_io_search.io_timestamp = 0;
+	vq->vq_io_search.io_offset = vq->vq_last_offset - 1;
+	VERIFY3P(avl_find(tree, &vq->vq_io_search, &idx), ==, NULL);
+	zio = avl_nearest(tree, idx, AVL_AFTER);
+	if (zio == NULL)
+		zio = avl_first(tree);
+
+	return (zio);
+}
+
 static zio_t *
 vdev_queue_io_to_issue(vdev_queue_t *vq)
 {
@@ -723,13 +1025,17 @@ again:
 	 *
 	 * For FIFO queues (sync), issue the i/o with the lowest timestamp.
 	 */
-	tree = vdev_queue_class_tree(vq, p);
-	vq->vq_io_search.io_timestamp = 0;
-	vq->vq_io_search.io_offset = vq->vq_last_offset - 1;
-	VERIFY3P(avl_find(tree, &vq->vq_io_search, &idx), ==, NULL);
-	zio = avl_nearest(tree, idx, AVL_AFTER);
-	if (zio == NULL)
-		zio = avl_first(tree);
+	if (zfs_vdev_fair_queue && vq->vq_class[p].vqc_unflowed == 0) {
+		zio = vdev_queue_fair_to_issue(vq, p);
+	} else {
+		tree = vdev_queue_class_tree(vq, p);
+		vq->vq_io_search.io_timestamp = 0;
+		vq->vq_io_search.io_offset = vq->vq_last_offset - 1;
+		VERIFY3P(avl_find(tree, &vq->vq_io_search, &idx), ==, NULL);
+		zio = avl_nearest(tree, idx, AVL_AFTER);
+		if (zio == NULL)
+			zio = avl_first(tree);
+	}
 	ASSERT3U(zio->io_priority, ==, p);
 
 	aio = vdev_queue_aggregate(vq, zio);
@@ -777,12 +1083,14 @@ vdev_queue_io(zio_t *zio)
 		    zio->io_priority != ZIO_PRIORITY_SCRUB &&
 		    zio->io_priority != ZIO_PRIORITY_REMOVAL)
 			zio->io_priority = ZIO_PRIORITY_ASYNC_READ;
-	} else {
-		ASSERT(zio->io_type == ZIO_TYPE_WRITE);
+	} else if (zio->io_type == ZIO_TYPE_WRITE) {
 		if (zio->io_priority != ZIO_PRIORITY_SYNC_WRITE &&
 		    zio->io_priority != ZIO_PRIORITY_ASYNC_WRITE &&
 		    zio->io_priority != ZIO_PRIORITY_REMOVAL)
 			zio->io_priority = ZIO_PRIORITY_ASYNC_WRITE;
+	} else {
+		ASSERT(zio->io_type == ZIO_TYPE_TRIM);
+		zio->io_priority = ZIO_PRIORITY_TRIM;
 	}
 
 	zio->io_flags |= ZIO_FLAG_DONT_CACHE | ZIO_FLAG_DONT_QUEUE;
@@ -804,30 +1112,170 @@ vdev_queue_io(zio_t *zio)
 	return (nio);
 }
 
+/*
+ * Fold the device service time of a completed read or write into the
+ * moving average kept for the vdev.  The service time is measured from
+ * when the I/O was handed to the device rather than when it was queued,
+ * so it reflects the speed of the device and not our own queueing.  The
+ * average is restarted when the previous sample is stale, so a device
+ * which recovers from a hiccup isn't penalized for long after.
+ */
+static void
+vdev_queue_update_latency(vdev_queue_t *vq, zio_t *zio)
+{
+	hrtime_t now = gethrtime();
+
+	ASSERT(MUTEX_HELD(&vq->vq_lock));
+
+	if (zio->io_type == ZIO_TYPE_TRIM || zio->io_delay <= 0)
+		return;
+
+	if (vq->vq_io_lat_ewma == 0 ||
+	    now - vq->vq_io_complete_ts > VDEV_QUEUE_LATENCY_STALE) {
+		vq->vq_io_lat_ewma = zio->io_delay;
+	} else {
+		vq->vq_io_lat_ewma += (zio->io_delay - vq->vq_io_lat_ewma) /
+		    (1 << VDEV_QUEUE_LATENCY_SHIFT);
+	}
+}
+
+static uint32_t
+vdev_queue_class_adapt(vdev_queue_class_t *vqc, zio_priority_t p,
+    boolean_t congested)
+{
+	uint32_t min_active = vdev_queue_class_min_active(p);
+	uint32_t max_active = vdev_queue_class_tunable_max_active(p);
+	uint32_t depth = vqc->vqc_max_active;
+
+	if (p <= ZIO_PRIORITY_ASYNC_WRITE)
+		max_active = MAX(max_active, zfs_vdev_max_active);
+
+	if (depth == 0)
+		depth = vdev_queue_class_tunable_max_active(p);
+
+	if (congested)
+		depth -= MAX(depth / 4, 1);
+	else if (vqc->vqc_limited)
+		depth++;
+
+	return (MIN(MAX(depth, min_active), max_active));
+}
+
+/*
+ * Adjust the depth of each class of the vdev once per interval, as
+ * described above zfs_vdev_queue_adaptive.  The classes are visited in
+ * priority order so that congestion of a class is also held against
+ * all lower priority classes.
+ */
+static void
+vdev_queue_adapt(vdev_queue_t *vq, zio_t *zio, hrtime_t now)
+{
+	boolean_t congested = B_FALSE;
+
+	ASSERT(MUTEX_HELD(&vq->vq_lock));
+
+	if (zio->io_delay > 0) {
+		vdev_queue_class_t *vqc = &vq->vq_class[zio->io_priority];
+
+		vqc->vqc_lat_sum += zio->io_delay;
+		vqc->vqc_lat_count++;
+	}
+
+	if (now - vq->vq_adapt_ts <
+	    MSEC2NSEC(MAX(zfs_vdev_queue_adapt_interval_ms, 1)))
+		return;
+	vq->vq_adapt_ts = now;
+
+	for (zio_priority_t p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
+		vdev_queue_class_t *vqc = &vq->vq_class[p];
+
+		if (vqc->vqc_lat_count != 0) {
+			hrtime_t lat = vqc->vqc_lat_sum / vqc->vqc_lat_count;
+			hrtime_t base = vqc->vqc_lat_base;
+
+			if (base != 0 &&
+			    lat * 100 > base * zfs_vdev_queue_latency_pct)
+				congested = B_TRUE;
+
+			if (base == 0 || lat < base)
+				base = lat;
+			else
+				base += (lat - base) >> VDEV_QUEUE_BASE_SHIFT;
+			vqc->vqc_lat_base = base;
+		}
+
+		vqc->vqc_max_active = vdev_queue_class_adapt(vqc, p,
+		    congested);
+		vqc->vqc_limited = B_FALSE;
+		vqc->vqc_lat_sum = 0;
+		vqc->vqc_lat_count = 0;
+	}
+}
+
+/*
+ * Issue a batch of i/os returned by vdev_queue_io_to_issue().  On Linux
+ * the bios they submit are held in a plug until the whole batch has been
+ * submitted, so the block layer can merge them and hand them to the
+ * device's hardware queue together rather than one request at a time.
+ */
+static void
+vdev_queue_issue(zio_t **batch, int count)
+{
+#if defined(_KERNEL) && defined(HAVE_BLK_QUEUE_HAVE_BLK_PLUG)
+	struct blk_plug plug;
+
+	if (count > 1)
+		blk_start_plug(&plug);
+#endif
+
+	for (int i = 0; i < count; i++) {
+		zio_t *nio = batch[i];
+
+		if (nio->io_done == vdev_queue_agg_io_done) {
+			zio_nowait(nio);
+		} else {
+			zio_vdev_io_reissue(nio);
+			zio_execute(nio);
+		}
+	}
+
+#if defined(_KERNEL) && defined(HAVE_BLK_QUEUE_HAVE_BLK_PLUG)
+	if (count > 1)
+		blk_finish_plug(&plug);
+#endif
+}
+
 void
 vdev_queue_io_done(zio_t *zio)
 {
 	vdev_queue_t *vq = &zio->io_vd->vdev_queue;
+	zio_t *batch[VDEV_QUEUE_ISSUE_BATCH];
 	zio_t *nio;
+	int count;
 
 	mutex_enter(&vq->vq_lock);
 
 	vdev_queue_pending_remove(vq, zio);
 
 	zio->io_delta = gethrtime() - zio->io_timestamp;
+	vdev_queue_update_latency(vq, zio);
 	vq->vq_io_complete_ts = gethrtime();
+	if (zfs_vdev_queue_adaptive)
+		vdev_queue_adapt(vq, zio, vq->vq_io_complete_ts);
 	vq->vq_io_delta_ts = vq->vq_io_complete_ts - zio->io_timestamp;
 
-	while ((nio = vdev_queue_io_to_issue(vq)) != NULL) {
-		mutex_exit(&vq->vq_lock);
-		if (nio->io_done == vdev_queue_agg_io_done) {
-			zio_nowait(nio);
-		} else {
-			zio_vdev_io_reissue(nio);
-			zio_execute(nio);
+	do {
+		count = 0;
+		while (count < VDEV_QUEUE_ISSUE_BATCH &&
+		    (nio = vdev_queue_io_to_issue(vq)) != NULL)
+			batch[count++] = nio;
+
+		if (count != 0) {
+			mutex_exit(&vq->vq_lock);
+			vdev_queue_issue(batch, count);
+			mutex_enter(&vq->vq_lock);
 		}
-		mutex_enter(&vq->vq_lock);
-	}
+	} while (count != 0);
 
 	mutex_exit(&vq->vq_lock);
 }
@@ -855,11 +1303,13 @@ vdev_queue_change_io_priority(zio_t *zio, zio_priority_t priority)
 		    priority != ZIO_PRIORITY_ASYNC_READ &&
 		    priority != ZIO_PRIORITY_SCRUB)
 			priority = ZIO_PRIORITY_ASYNC_READ;
-	} else {
-		ASSERT(zio->io_type == ZIO_TYPE_WRITE);
+	} else if (zio->io_type == ZIO_TYPE_WRITE) {
 		if (priority != ZIO_PRIORITY_SYNC_WRITE &&
 		    priority != ZIO_PRIORITY_ASYNC_WRITE)
 			priority = ZIO_PRIORITY_ASYNC_WRITE;
+	} else {
+		ASSERT(zio->io_type == ZIO_TYPE_TRIM);
+		priority = ZIO_PRIORITY_TRIM;
 	}
 
 	mutex_enter(&vq->vq_lock);
@@ -873,9 +1323,9 @@ vdev_queue_change_io_priority(zio_t *zio, zio_priority_t priority)
 	 */
 	tree = vdev_queue_class_tree(vq, zio->io_priority);
 	if (avl_find(tree, zio, NULL) == zio) {
-		avl_remove(vdev_queue_class_tree(vq, zio->io_priority), zio);
+		vdev_queue_class_remove(vq, zio);
 		zio->io_priority = priority;
-		avl_add(vdev_queue_class_tree(vq, zio->io_priority), zio);
+		vdev_queue_class_add(vq, zio);
 	} else if (avl_find(&vq->vq_active_tree, zio, NULL) != zio) {
 		zio->io_priority = priority;
 	}
@@ -901,6 +1351,40 @@ vdev_queue_last_offset(vdev_t *vd)
 	return (vd->vdev_queue.vq_last_offset);
 }
 
+/*
+ * Returns the expected service time of an I/O issued to the vdev, or zero
+ * when it is unknown.  A device which has I/Os outstanding but hasn't
+ * completed any of them recently is stalled, and the time since its last
+ * completion is a better estimate than the average.
+ */
+hrtime_t
+vdev_queue_latency(vdev_t *vd)
+{
+	vdev_queue_t *vq = &vd->vdev_queue;
+	hrtime_t idle = gethrtime() - vq->vq_io_complete_ts;
+
+	if (idle <= VDEV_QUEUE_LATENCY_STALE)
+		return (vq->vq_io_lat_ewma);
+
+	if (vdev_queue_length(vd) == 0)
+		return (0);
+
+	return (MAX(vq->vq_io_lat_ewma, idle));
+}
+
+/*
+ * Returns the number of i/os of the given class which may currently be
+ * active on the vdev.  Like vdev_queue_length() this is only used for
+ * reporting, so vq_lock isn't taken.
+ */
+int
+vdev_queue_max_active(vdev_t *vd, zio_priority_t p)
+{
+	ASSERT3U(p, <, ZIO_PRIORITY_NUM_QUEUEABLE);
+
+	return (vdev_queue_class_max_active(vd->vdev_spa, &vd->vdev_queue, p));
+}
+
 #if defined(_KERNEL)
 module_param(zfs_vdev_aggregation_limit, int, 0644);
 MODULE_PARM_DESC(zfs_vdev_aggregation_limit, "Max vdev I/O aggregation size");
@@ -944,6 +1428,12 @@ MODULE_PARM_DESC(zfs_vdev_scrub_max_active, "Max active scrub I/Os per vdev");
 module_param(zfs_vdev_scrub_min_active, int, 0644);
 MODULE_PARM_DESC(zfs_vdev_scrub_min_active, "Min active scrub I/Os per vdev");
 
+module_param(zfs_vdev_trim_max_active, int, 0644);
+MODULE_PARM_DESC(zfs_vdev_trim_max_active, "Max active trim I/Os per vdev");
+
+module_param(zfs_vdev_trim_min_active, int, 0644);
+MODULE_PARM_DESC(zfs_vdev_trim_min_active, "Min active trim I/Os per vdev");
+
 module_param(zfs_vdev_sync_read_max_active, int, 0644);
 MODULE_PARM_DESC(zfs_vdev_sync_read_max_active,
 	"Max active sync read I/Os per vdev");
@@ -963,4 +1453,24 @@ MODULE_PARM_DESC(zfs_vdev_sync_write_min_active,
 module_param(zfs_vdev_queue_depth_pct, int, 0644);
 MODULE_PARM_DESC(zfs_vdev_queue_depth_pct,
 	"Queue depth percentage for each top-level vdev");
+
+module_param(zfs_vdev_fair_queue, int, 0644);
+MODULE_PARM_DESC(zfs_vdev_fair_queue,
+	"Share each vdev queue class fairly between datasets");
+
+module_param(zfs_vdev_fair_quantum, int, 0644);
+MODULE_PARM_DESC(zfs_vdev_fair_quantum,
+	"Bytes each dataset may issue per fair queueing round");
+
+module_param(zfs_vdev_queue_adaptive, int, 0644);
+MODULE_PARM_DESC(zfs_vdev_queue_adaptive,
+	"Adjust per-vdev max active I/Os by observed latency");
+
+module_param(zfs_vdev_queue_adapt_interval_ms, int, 0644);
+MODULE_PARM_DESC(zfs_vdev_queue_adapt_interval_ms,
+	"Milliseconds between adaptive queue depth adjustments");
+
+module_param(zfs_vdev_queue_latency_pct, int, 0644);
+MODULE_PARM_DESC(zfs_vdev_queue_latency_pct,
+	"Latency over baseline percentage at which queue depth is reduced");
 #endif
@@ -1644,6 +1644,131 @@ vdev_raidz_child_done(zio_t *zio)
  *      vdevs have had errors, then create zio read operations to the parity
  *      columns' VDevs as well.
  */
+/*
+ * Hedged reads.  The data columns are read into private buffers and, if
+ * they haven't all been read within zfs_vdev_hedge_read_ms or one of them
+ * fails, the parity columns are read as well.  The read completes as soon
+ * as enough columns have been read to reconstruct the rest.  Columns still
+ * outstanding at that point are marked as skipped, so that
+ * vdev_raidz_io_done() reconstructs them or, failing that, rereads them.
+ */
+static boolean_t
+vdev_raidz_hedge_parity(vdev_hedge_t *vh, zio_t *zio)
+{
+	raidz_map_t *rm = zio->io_vsd;
+	raidz_col_t *rc;
+
+	if (vh->vh_child[0].vhc_issued)
+		return (B_FALSE);
+
+	for (int c = 0; c < rm->rm_firstdatacol; c++) {
+		rc = &rm->rm_col[c];
+		vdev_hedge_read(vh, c, zio->io_vd->vdev_child[rc->rc_devidx],
+		    rc->rc_offset, rc->rc_size, NULL);
+	}
+
+	return (B_TRUE);
+}
+
+static void
+vdev_raidz_hedge_release(vdev_hedge_t *vh, raidz_map_t *rm)
+{
+	for (int c = 0; c < rm->rm_cols; c++) {
+		raidz_col_t *rc = &rm->rm_col[c];
+
+		if (vh->vh_child[c].vhc_issued && !rc->rc_tried) {
+			rc->rc_error = SET_ERROR(ESTALE);
+			rc->rc_skipped = 1;
+		}
+	}
+
+	vdev_hedge_release(vh);
+}
+
+static void
+vdev_raidz_hedge_done(vdev_hedge_t *vh, int c, zio_t *zio)
+{
+	zio_t *pio = vh->vh_zio;
+	raidz_map_t *rm = pio->io_vsd;
+	raidz_col_t *rc = &rm->rm_col[c];
+	int missing = 0;
+	int parity = 0;
+
+	rc->rc_error = zio->io_error;
+	rc->rc_tried = 1;
+	rc->rc_skipped = 0;
+	if (zio->io_error == 0)
+		abd_copy(rc->rc_abd, zio->io_abd, rc->rc_size);
+
+	for (c = 0; c < rm->rm_cols; c++) {
+		rc = &rm->rm_col[c];
+		if (!rc->rc_tried || rc->rc_error != 0) {
+			if (c >= rm->rm_firstdatacol)
+				missing++;
+		} else if (c < rm->rm_firstdatacol) {
+			parity++;
+		}
+	}
+
+	if (missing <= parity)
+		vdev_raidz_hedge_release(vh, rm);
+	else if (zio->io_error != 0 && vdev_raidz_hedge_parity(vh, pio))
+		return;
+	else if (vh->vh_pending == 0)
+		vdev_raidz_hedge_release(vh, rm);
+}
+
+static void
+vdev_raidz_hedge_timeout(vdev_hedge_t *vh)
+{
+	(void) vdev_raidz_hedge_parity(vh, vh->vh_zio);
+}
+
+static const vdev_hedge_ops_t vdev_raidz_hedge_ops = {
+	.vho_done = vdev_raidz_hedge_done,
+	.vho_timeout = vdev_raidz_hedge_timeout
+};
+
+/*
+ * Read the data columns with hedged reads.  Returns B_FALSE if the read
+ * must be issued as usual instead, which is always the case when a
+ * column is known to be missing.
+ */
+static boolean_t
+vdev_raidz_hedge(zio_t *zio)
+{
+	vdev_t *vd = zio->io_vd;
+	raidz_map_t *rm = zio->io_vsd;
+	raidz_col_t *rc;
+	vdev_t *cvd;
+	vdev_hedge_t *vh;
+	int c;
+
+	if (!vdev_hedge_enabled(zio))
+		return (B_FALSE);
+
+	for (c = 0; c < rm->rm_cols; c++) {
+		rc = &rm->rm_col[c];
+		cvd = vd->vdev_child[rc->rc_devidx];
+		if (!cvd->vdev_ops->vdev_op_leaf || !vdev_readable(cvd) ||
+		    vdev_dtl_contains(cvd, DTL_MISSING, zio->io_txg, 1))
+			return (B_FALSE);
+	}
+
+	vh = vdev_hedge_create(zio, rm->rm_cols, &vdev_raidz_hedge_ops);
+	if (vh == NULL)
+		return (B_FALSE);
+
+	for (c = rm->rm_firstdatacol; c < rm->rm_cols; c++) {
+		rc = &rm->rm_col[c];
+		vdev_hedge_read(vh, c, vd->vdev_child[rc->rc_devidx],
+		    rc->rc_offset, rc->rc_size, NULL);
+	}
+	vdev_hedge_start(vh);
+
+	return (B_TRUE);
+}
+
 static void
 vdev_raidz_io_start(zio_t *zio)
 {
@@ -1694,6 +1819,11 @@ vdev_raidz_io_start(zio_t *zio)
 
 	ASSERT(zio->io_type == ZIO_TYPE_READ);
 
+	if (vdev_raidz_hedge(zio)) {
+		zio_execute(zio);
+		return;
+	}
+
 	/*
 	 * Iterate over the columns in reverse order so that we hit the parity
 	 * last -- any errors along the way will force us to read the parity.
@@ -2252,7 +2382,9 @@ vdev_raidz_io_done(zio_t *zio)
 done:
 	zio_checksum_verified(zio);
 
+	/* See the comment about a user's buffer in vdev_mirror_io_done(). */
 	if (zio->io_error == 0 && spa_writeable(zio->io_spa) &&
+	    !abd_is_user(zio->io_abd) &&
 	    (unexpected_errors || (zio->io_flags & ZIO_FLAG_RESILVER))) {
 		/*
 		 * Use the good data we have in hand to repair damaged children.
@@ -2323,6 +2455,44 @@ vdev_raidz_need_resilver(vdev_t *vd, uint64_t offset, size_t psize)
 	return (B_FALSE);
 }
 
+/*
+ * Translate a range on the raidz vdev to the range on child "cvd" which
+ * holds its data and parity.  A raidz allocation is laid out one sector at
+ * a time across the children in order, so sector "b" of the raidz vdev is
+ * stored in row b / width of child b % width.
+ */
+static void
+vdev_raidz_xlate(vdev_t *cvd, const range_seg_t *in, range_seg_t *res)
+{
+	vdev_t *raidvd = cvd->vdev_parent;
+	ASSERT(raidvd->vdev_ops == &vdev_raidz_ops);
+
+	uint64_t width = raidvd->vdev_children;
+	uint64_t tgt_col = cvd->vdev_id;
+	uint64_t ashift = raidvd->vdev_top->vdev_ashift;
+
+	/* make sure the offsets are block-aligned */
+	ASSERT0(P2PHASE(in->rs_start, 1ULL << ashift));
+	ASSERT0(P2PHASE(in->rs_end, 1ULL << ashift));
+	uint64_t b_start = in->rs_start >> ashift;
+	uint64_t b_end = in->rs_end >> ashift;
+
+	/* the first and last row of this column within [b_start, b_end) */
+	uint64_t start_row = 0;
+	if (b_start > tgt_col)
+		start_row = ((b_start - tgt_col - 1) / width) + 1;
+
+	uint64_t end_row = 0;
+	if (b_end > tgt_col)
+		end_row = ((b_end - tgt_col - 1) / width) + 1;
+
+	res->rs_start = start_row << ashift;
+	res->rs_end = end_row << ashift;
+
+	ASSERT3U(res->rs_start, <=, in->rs_start);
+	ASSERT3U(res->rs_end - res->rs_start, <=, in->rs_end - in->rs_start);
+}
+
 vdev_ops_t vdev_raidz_ops = {
 	vdev_raidz_open,
 	vdev_raidz_close,
@@ -2334,6 +2504,7 @@ vdev_ops_t vdev_raidz_ops = {
 	NULL,
 	NULL,
 	NULL,
+	vdev_raidz_xlate,
 	VDEV_TYPE_RAIDZ,	/* name of this vdev type */
 	B_FALSE			/* not a leaf vdev */
 };
@@ -0,0 +1,656 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/spa_impl.h>
+#include <sys/vdev_impl.h>
+#include <sys/vdev_trim.h>
+#include <sys/metaslab_impl.h>
+#include <sys/range_tree.h>
+#include <sys/zio.h>
+
+/*
+ * TRIM informs the underlying devices which ranges no longer hold any
+ * data, which for flash devices reduces write amplification and keeps
+ * steady-state latency low.  Free space is trimmed in two ways:
+ *
+ * - A manual trim ("zpool trim") walks the free space of every metaslab
+ *   of a top-level vdev once.  It may be rate limited, suspended and
+ *   resumed, and its progress is reported by "zpool status".
+ *
+ * - When the "autotrim" pool property is on, metaslab_sync_done() adds
+ *   the ranges which are freed each txg to the metaslab's ms_trim tree.
+ *   Every zfs_trim_txg_batch txgs spa_sync() kicks the autotrim thread,
+ *   which trims whatever has accumulated.  Batching the frees this way
+ *   coalesces adjacent ranges into fewer, larger trims.
+ *
+ * Both run in a dedicated thread per top-level vdev.  Trims are issued in
+ * the address space of the top-level vdev and translated to each leaf with
+ * the vdev_op_xlate() callback of the intervening vdevs.  While a metaslab
+ * is being trimmed its ms_trimming count is raised, which prevents the
+ * allocator from handing out the ranges being trimmed.  Any range which is
+ * allocated is also cleared from ms_trim so autotrim never discards data.
+ *
+ * The trim threads only hold SCL_CONFIG as reader while they look up the
+ * next metaslab, each trim holds SCL_STATE_ALL as reader until it
+ * completes.  Metaslabs and vdevs are only freed by operations which go
+ * through spa_vdev_enter(), which stops the threads first and restarts
+ * them from spa_vdev_exit(), so the threads may safely keep using them
+ * without the config lock.  Manual trim progress is kept in memory only
+ * and does not survive an export.
+ */
+
+/*
+ * Maximum size of a single trim issued to a top-level vdev.  Larger free
+ * ranges are split into several trims.
+ */
+unsigned int zfs_trim_extent_bytes_max = 128 * 1024 * 1024;
+
+/*
+ * Minimum size of a free range worth trimming.  Smaller ranges are skipped
+ * since the cost of the command outweighs the benefit for the device.
+ */
+unsigned int zfs_trim_extent_bytes_min = 32 * 1024;
+
+/*
+ * Maximum number of trims outstanding per leaf vdev.
+ */
+unsigned int zfs_trim_queue_limit = 10;
+
+/*
+ * Number of txgs worth of frees which autotrim accumulates before they
+ * are trimmed.
+ */
+unsigned int zfs_trim_txg_batch = 32;
+
+typedef struct trim_args {
+	vdev_t		*trim_vdev;		/* top-level vdev */
+	range_tree_t	*trim_tree;		/* ranges to trim */
+	boolean_t	trim_manual;		/* manual or autotrim */
+	uint64_t	trim_extent_bytes_max;
+	hrtime_t	trim_start_time;	/* for rate limiting */
+	uint64_t	trim_bytes_issued;	/* for rate limiting */
+	uint64_t	trim_inflight;
+	uint64_t	trim_inflight_max;
+	kmutex_t	trim_lock;		/* protects trim_inflight */
+	kcondvar_t	trim_cv;
+} trim_args_t;
+
+static boolean_t
+vdev_trim_should_stop(trim_args_t *ta)
+{
+	vdev_t *vd = ta->trim_vdev;
+
+	if (ta->trim_manual ? vd->vdev_trim_exit_wanted :
+	    vd->vdev_autotrim_exit_wanted)
+		return (B_TRUE);
+
+	return (vd->vdev_removing || vd->vdev_detached ||
+	    !vdev_is_concrete(vd));
+}
+
+static uint64_t
+vdev_trim_count_leaves(vdev_t *vd)
+{
+	uint64_t leaves = 0;
+
+	if (vd->vdev_ops->vdev_op_leaf)
+		return (1);
+
+	for (uint64_t c = 0; c < vd->vdev_children; c++)
+		leaves += vdev_trim_count_leaves(vd->vdev_child[c]);
+
+	return (leaves);
+}
+
+static void
+trim_args_init(trim_args_t *ta, vdev_t *vd, boolean_t manual)
+{
+	bzero(ta, sizeof (*ta));
+	ta->trim_vdev = vd;
+	ta->trim_tree = range_tree_create(NULL, NULL);
+	ta->trim_manual = manual;
+	ta->trim_extent_bytes_max = MAX(P2ALIGN(zfs_trim_extent_bytes_max,
+	    1ULL << vd->vdev_ashift), 1ULL << vd->vdev_ashift);
+	ta->trim_start_time = gethrtime();
+	mutex_init(&ta->trim_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&ta->trim_cv, NULL, CV_DEFAULT, NULL);
+}
+
+static void
+trim_args_fini(trim_args_t *ta)
+{
+	ASSERT0(ta->trim_inflight);
+	range_tree_vacate(ta->trim_tree, NULL, NULL);
+	range_tree_destroy(ta->trim_tree);
+	mutex_destroy(&ta->trim_lock);
+	cv_destroy(&ta->trim_cv);
+}
+
+static void
+vdev_trim_cb(zio_t *zio)
+{
+	trim_args_t *ta = zio->io_private;
+
+	spa_config_exit(zio->io_spa, SCL_STATE_ALL, zio->io_vd);
+
+	mutex_enter(&ta->trim_lock);
+	ASSERT3U(ta->trim_inflight, >, 0);
+	ta->trim_inflight--;
+	cv_broadcast(&ta->trim_cv);
+	mutex_exit(&ta->trim_lock);
+}
+
+static void
+vdev_trim_wait(trim_args_t *ta, uint64_t limit)
+{
+	mutex_enter(&ta->trim_lock);
+	while (ta->trim_inflight > limit)
+		cv_wait(&ta->trim_cv, &ta->trim_lock);
+	mutex_exit(&ta->trim_lock);
+}
+
+/*
+ * Issue a trim for the range "rs" of vdev "vd", which is expressed in the
+ * address space of "vd".  Interior vdevs translate the range for each of
+ * their children until the leaves are reached.
+ */
+static void
+vdev_trim_issue(trim_args_t *ta, vdev_t *vd, const range_seg_t *rs)
+{
+	spa_t *spa = vd->vdev_spa;
+
+	if (rs->rs_end <= rs->rs_start)
+		return;
+
+	if (!vd->vdev_ops->vdev_op_leaf) {
+		if (vd->vdev_ops->vdev_op_xlate == NULL)
+			return;
+
+		for (uint64_t c = 0; c < vd->vdev_children; c++) {
+			vdev_t *cvd = vd->vdev_child[c];
+			range_seg_t crs;
+
+			vd->vdev_ops->vdev_op_xlate(cvd, rs, &crs);
+			vdev_trim_issue(ta, cvd, &crs);
+		}
+		return;
+	}
+
+	if (!vd->vdev_has_trim || !vdev_writeable(vd))
+		return;
+
+	mutex_enter(&ta->trim_lock);
+	while (ta->trim_inflight >= ta->trim_inflight_max)
+		cv_wait(&ta->trim_cv, &ta->trim_lock);
+	ta->trim_inflight++;
+	mutex_exit(&ta->trim_lock);
+
+	spa_config_enter(spa, SCL_STATE_ALL, vd, RW_READER);
+	zio_nowait(zio_trim(NULL, vd, rs->rs_start + VDEV_LABEL_START_SIZE,
+	    rs->rs_end - rs->rs_start, vdev_trim_cb, ta, ZIO_PRIORITY_TRIM,
+	    ZIO_FLAG_CANFAIL | ZIO_FLAG_DONT_PROPAGATE | ZIO_FLAG_DONT_RETRY));
+}
+
+/*
+ * Returns the rate in bytes/sec at which this manual trim has been
+ * issuing trims since it was started.
+ */
+static uint64_t
+vdev_trim_calculate_rate(trim_args_t *ta)
+{
+	uint64_t elapsed_ms = NSEC2MSEC(gethrtime() - ta->trim_start_time);
+
+	return (ta->trim_bytes_issued * 1000 / (elapsed_ms + 1));
+}
+
+static int
+vdev_trim_range(trim_args_t *ta, uint64_t start, uint64_t size)
+{
+	vdev_t *vd = ta->trim_vdev;
+	range_seg_t rs;
+
+	if (ta->trim_manual) {
+		mutex_enter(&vd->vdev_trim_lock);
+		while (vd->vdev_trim_rate != 0 && !vdev_trim_should_stop(ta) &&
+		    vdev_trim_calculate_rate(ta) > vd->vdev_trim_rate) {
+			(void) cv_timedwait(&vd->vdev_trim_cv,
+			    &vd->vdev_trim_lock,
+			    ddi_get_lbolt() + MSEC_TO_TICK(10));
+		}
+		vd->vdev_trim_bytes_done += size;
+		mutex_exit(&vd->vdev_trim_lock);
+	}
+
+	if (vdev_trim_should_stop(ta))
+		return (SET_ERROR(EINTR));
+
+	rs.rs_start = start;
+	rs.rs_end = start + size;
+	vdev_trim_issue(ta, vd, &rs);
+	ta->trim_bytes_issued += size;
+
+	return (0);
+}
+
+/*
+ * Trim every range in ta->trim_tree which is at least
+ * zfs_trim_extent_bytes_min long, then wait for the trims to complete.
+ */
+static int
+vdev_trim_ranges(trim_args_t *ta)
+{
+	avl_tree_t *t = &ta->trim_tree->rt_root;
+	int error = 0;
+
+	ta->trim_inflight_max = MAX(1, zfs_trim_queue_limit *
+	    vdev_trim_count_leaves(ta->trim_vdev));
+
+	for (range_seg_t *rs = avl_first(t); rs != NULL && error == 0;
+	    rs = AVL_NEXT(t, rs)) {
+		uint64_t size = rs->rs_end - rs->rs_start;
+
+		if (size < zfs_trim_extent_bytes_min)
+			continue;
+
+		for (uint64_t off = 0; off < size && error == 0;
+		    off += ta->trim_extent_bytes_max) {
+			error = vdev_trim_range(ta, rs->rs_start + off,
+			    MIN(size - off, ta->trim_extent_bytes_max));
+		}
+	}
+
+	vdev_trim_wait(ta, 0);
+	range_tree_vacate(ta->trim_tree, NULL, NULL);
+
+	return (error);
+}
+
+static void
+vdev_trim_thread(void *arg)
+{
+	vdev_t *vd = arg;
+	spa_t *spa = vd->vdev_spa;
+	trim_args_t ta;
+	int error = 0;
+
+	trim_args_init(&ta, vd, B_TRUE);
+
+	for (;;) {
+		metaslab_t *msp;
+		uint64_t ms_id;
+
+		mutex_enter(&vd->vdev_trim_lock);
+		ms_id = vd->vdev_trim_last_ms;
+		mutex_exit(&vd->vdev_trim_lock);
+
+		spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
+		if (vdev_trim_should_stop(&ta)) {
+			spa_config_exit(spa, SCL_CONFIG, FTAG);
+			error = SET_ERROR(EINTR);
+			break;
+		}
+		if (ms_id >= vd->vdev_ms_count) {
+			spa_config_exit(spa, SCL_CONFIG, FTAG);
+			break;
+		}
+
+		msp = vd->vdev_ms[ms_id];
+		spa_config_exit(spa, SCL_CONFIG, FTAG);
+
+		if (msp != NULL) {
+			mutex_enter(&msp->ms_lock);
+			metaslab_load_wait(msp);
+			if (!msp->ms_loaded)
+				error = metaslab_load(msp);
+			if (error == 0) {
+				msp->ms_trimming++;
+				range_tree_walk(msp->ms_allocatable,
+				    range_tree_add, ta.trim_tree);
+				range_tree_vacate(msp->ms_trim, NULL, NULL);
+			}
+			mutex_exit(&msp->ms_lock);
+
+			if (error == 0) {
+				error = vdev_trim_ranges(&ta);
+
+				mutex_enter(&msp->ms_lock);
+				msp->ms_trimming--;
+				mutex_exit(&msp->ms_lock);
+			}
+		}
+
+		if (error != 0)
+			break;
+
+		mutex_enter(&vd->vdev_trim_lock);
+		vd->vdev_trim_last_ms = ms_id + 1;
+		mutex_exit(&vd->vdev_trim_lock);
+	}
+
+	trim_args_fini(&ta);
+
+	mutex_enter(&vd->vdev_trim_lock);
+	if (error == 0) {
+		vd->vdev_trim_state = VDEV_TRIM_COMPLETE;
+		vd->vdev_trim_action_time = gethrestime_sec();
+		vd->vdev_trim_bytes_done = vd->vdev_trim_bytes_est;
+	}
+	vd->vdev_trim_thread = NULL;
+	cv_broadcast(&vd->vdev_trim_cv);
+	mutex_exit(&vd->vdev_trim_lock);
+
+	thread_exit();
+}
+
+/*
+ * Start or resume a manual trim of the top-level vdev "vd".  The caller
+ * must hold vdev_trim_lock.
+ */
+void
+vdev_trim(vdev_t *vd, uint64_t rate)
+{
+	ASSERT(MUTEX_HELD(&vd->vdev_trim_lock));
+	ASSERT3P(vd, ==, vd->vdev_top);
+	ASSERT(vdev_is_concrete(vd));
+	ASSERT3P(vd->vdev_trim_thread, ==, NULL);
+	ASSERT(!vd->vdev_trim_exit_wanted);
+
+	if (vd->vdev_trim_state != VDEV_TRIM_ACTIVE &&
+	    vd->vdev_trim_state != VDEV_TRIM_SUSPENDED) {
+		vd->vdev_trim_last_ms = 0;
+		vd->vdev_trim_bytes_done = 0;
+		vd->vdev_trim_bytes_est = vd->vdev_stat.vs_space -
+		    MIN(vd->vdev_stat.vs_alloc, vd->vdev_stat.vs_space);
+	}
+	if (vd->vdev_trim_state != VDEV_TRIM_ACTIVE)
+		vd->vdev_trim_action_time = gethrestime_sec();
+
+	vd->vdev_trim_state = VDEV_TRIM_ACTIVE;
+	vd->vdev_trim_rate = rate;
+	vd->vdev_trim_thread = thread_create(NULL, 0, vdev_trim_thread, vd,
+	    0, &p0, TS_RUN, minclsyspri);
+}
+
+/*
+ * Stop the manual trim of the top-level vdev "vd" and wait for its thread
+ * to exit.  A target state of VDEV_TRIM_ACTIVE leaves the trim marked as
+ * active so that vdev_trim_restart() resumes it later.  The caller must
+ * hold vdev_trim_lock.
+ */
+void
+vdev_trim_stop(vdev_t *vd, vdev_trim_state_t tgt_state)
+{
+	ASSERT(MUTEX_HELD(&vd->vdev_trim_lock));
+
+	if (vd->vdev_trim_thread != NULL) {
+		vd->vdev_trim_exit_wanted = B_TRUE;
+		cv_broadcast(&vd->vdev_trim_cv);
+		while (vd->vdev_trim_thread != NULL)
+			cv_wait(&vd->vdev_trim_cv, &vd->vdev_trim_lock);
+		vd->vdev_trim_exit_wanted = B_FALSE;
+	}
+
+	if (tgt_state != VDEV_TRIM_ACTIVE &&
+	    vd->vdev_trim_state != VDEV_TRIM_COMPLETE) {
+		vd->vdev_trim_state = tgt_state;
+		vd->vdev_trim_action_time = gethrestime_sec();
+	}
+}
+
+void
+vdev_trim_stop_all(spa_t *spa, vdev_trim_state_t tgt_state)
+{
+	vdev_t *rvd = spa->spa_root_vdev;
+
+	if (rvd == NULL)
+		return;
+
+	for (uint64_t c = 0; c < rvd->vdev_children; c++) {
+		vdev_t *vd = rvd->vdev_child[c];
+
+		mutex_enter(&vd->vdev_trim_lock);
+		vdev_trim_stop(vd, tgt_state);
+		mutex_exit(&vd->vdev_trim_lock);
+	}
+}
+
+/*
+ * Resume the manual trims which were stopped by vdev_trim_stop_all() while
+ * leaving them active.  Trims of vdevs which have since been removed are
+ * canceled.
+ */
+void
+vdev_trim_restart(spa_t *spa)
+{
+	vdev_t *rvd = spa->spa_root_vdev;
+
+	ASSERT(MUTEX_HELD(&spa_namespace_lock));
+
+	if (rvd == NULL || !spa_writeable(spa))
+		return;
+
+	for (uint64_t c = 0; c < rvd->vdev_children; c++) {
+		vdev_t *vd = rvd->vdev_child[c];
+
+		mutex_enter(&vd->vdev_trim_lock);
+		if (vd->vdev_trim_state == VDEV_TRIM_ACTIVE &&
+		    vd->vdev_trim_thread == NULL) {
+			if (vdev_is_concrete(vd) && !vd->vdev_removing) {
+				vdev_trim(vd, vd->vdev_trim_rate);
+			} else {
+				vd->vdev_trim_state = VDEV_TRIM_CANCELED;
+				vd->vdev_trim_action_time = gethrestime_sec();
+			}
+		}
+		mutex_exit(&vd->vdev_trim_lock);
+	}
+}
+
+static void
+vdev_autotrim_thread(void *arg)
+{
+	vdev_t *vd = arg;
+	spa_t *spa = vd->vdev_spa;
+	trim_args_t ta;
+
+	trim_args_init(&ta, vd, B_FALSE);
+
+	mutex_enter(&vd->vdev_trim_lock);
+	while (!vdev_trim_should_stop(&ta)) {
+		if (vd->vdev_autotrim_kicks == 0) {
+			cv_wait(&vd->vdev_autotrim_cv, &vd->vdev_trim_lock);
+			continue;
+		}
+		vd->vdev_autotrim_kicks = 0;
+		mutex_exit(&vd->vdev_trim_lock);
+
+		for (uint64_t i = 0; ; i++) {
+			metaslab_t *msp;
+
+			spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
+			if (i >= vd->vdev_ms_count ||
+			    vdev_trim_should_stop(&ta)) {
+				spa_config_exit(spa, SCL_CONFIG, FTAG);
+				break;
+			}
+
+			msp = vd->vdev_ms[i];
+			spa_config_exit(spa, SCL_CONFIG, FTAG);
+			if (msp == NULL)
+				continue;
+
+			mutex_enter(&msp->ms_lock);
+			if (range_tree_is_empty(msp->ms_trim)) {
+				mutex_exit(&msp->ms_lock);
+				continue;
+			}
+			msp->ms_trimming++;
+			range_tree_swap(&msp->ms_trim, &ta.trim_tree);
+			mutex_exit(&msp->ms_lock);
+
+			(void) vdev_trim_ranges(&ta);
+
+			mutex_enter(&msp->ms_lock);
+			msp->ms_trimming--;
+			mutex_exit(&msp->ms_lock);
+		}
+
+		mutex_enter(&vd->vdev_trim_lock);
+	}
+	mutex_exit(&vd->vdev_trim_lock);
+
+	trim_args_fini(&ta);
+
+	mutex_enter(&vd->vdev_trim_lock);
+	vd->vdev_autotrim_thread = NULL;
+	cv_broadcast(&vd->vdev_autotrim_cv);
+	mutex_exit(&vd->vdev_trim_lock);
+
+	thread_exit();
+}
+
+/*
+ * Start the autotrim threads of all top-level vdevs when the autotrim
+ * property is on.  When it is off any frees still queued for autotrim
+ * are discarded.
+ */
+void
+vdev_autotrim(spa_t *spa)
+{
+	vdev_t *rvd = spa->spa_root_vdev;
+
+	ASSERT(MUTEX_HELD(&spa_namespace_lock));
+
+	if (rvd == NULL || !spa_writeable(spa))
+		return;
+
+	if (spa_get_autotrim(spa) != ZPOOL_AUTOTRIM_ON) {
+		spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
+		for (uint64_t c = 0; c < rvd->vdev_children; c++) {
+			vdev_t *vd = rvd->vdev_child[c];
+
+			for (uint64_t m = 0; m < vd->vdev_ms_count; m++) {
+				metaslab_t *msp = vd->vdev_ms[m];
+
+				if (msp == NULL)
+					continue;
+				mutex_enter(&msp->ms_lock);
+				range_tree_vacate(msp->ms_trim, NULL, NULL);
+				mutex_exit(&msp->ms_lock);
+			}
+		}
+		spa_config_exit(spa, SCL_CONFIG, FTAG);
+		return;
+	}
+
+	for (uint64_t c = 0; c < rvd->vdev_children; c++) {
+		vdev_t *vd = rvd->vdev_child[c];
+
+		mutex_enter(&vd->vdev_trim_lock);
+		if (vd->vdev_autotrim_thread == NULL &&
+		    vdev_is_concrete(vd) && !vd->vdev_removing) {
+			ASSERT(!vd->vdev_autotrim_exit_wanted);
+			vd->vdev_autotrim_kicks = 0;
+			vd->vdev_autotrim_thread = thread_create(NULL, 0,
+			    vdev_autotrim_thread, vd, 0, &p0, TS_RUN,
+			    minclsyspri);
+		}
+		mutex_exit(&vd->vdev_trim_lock);
+	}
+}
+
+void
+vdev_autotrim_stop_all(spa_t *spa)
+{
+	vdev_t *rvd = spa->spa_root_vdev;
+
+	if (rvd == NULL)
+		return;
+
+	for (uint64_t c = 0; c < rvd->vdev_children; c++) {
+		vdev_t *vd = rvd->vdev_child[c];
+
+		mutex_enter(&vd->vdev_trim_lock);
+		if (vd->vdev_autotrim_thread != NULL) {
+			vd->vdev_autotrim_exit_wanted = B_TRUE;
+			cv_broadcast(&vd->vdev_autotrim_cv);
+			while (vd->vdev_autotrim_thread != NULL) {
+				cv_wait(&vd->vdev_autotrim_cv,
+				    &vd->vdev_trim_lock);
+			}
+			vd->vdev_autotrim_exit_wanted = B_FALSE;
+		}
+		mutex_exit(&vd->vdev_trim_lock);
+	}
+}
+
+/*
+ * Called from spa_sync() every zfs_trim_txg_batch txgs to have the
+ * autotrim threads trim the frees which accumulated in the meantime.
+ */
+void
+vdev_autotrim_kick(spa_t *spa)
+{
+	vdev_t *rvd = spa->spa_root_vdev;
+
+	ASSERT(spa_config_held(spa, SCL_CONFIG, RW_READER));
+
+	for (uint64_t c = 0; c < rvd->vdev_children; c++) {
+		vdev_t *vd = rvd->vdev_child[c];
+
+		mutex_enter(&vd->vdev_trim_lock);
+		if (vd->vdev_autotrim_thread != NULL) {
+			vd->vdev_autotrim_kicks++;
+			cv_broadcast(&vd->vdev_autotrim_cv);
+		}
+		mutex_exit(&vd->vdev_trim_lock);
+	}
+}
+
+#if defined(_KERNEL)
+EXPORT_SYMBOL(vdev_trim);
+EXPORT_SYMBOL(vdev_trim_stop);
+EXPORT_SYMBOL(vdev_trim_stop_all);
+EXPORT_SYMBOL(vdev_trim_restart);
+EXPORT_SYMBOL(vdev_autotrim);
+EXPORT_SYMBOL(vdev_autotrim_stop_all);
+EXPORT_SYMBOL(vdev_autotrim_kick);
+
+/* BEGIN CSTYLED */
+module_param(zfs_trim_extent_bytes_max, uint, 0644);
+MODULE_PARM_DESC(zfs_trim_extent_bytes_max,
+	"Max size of a single trim issued to a top-level vdev");
+
+module_param(zfs_trim_extent_bytes_min, uint, 0644);
+MODULE_PARM_DESC(zfs_trim_extent_bytes_min,
+	"Min size of a free range worth trimming");
+
+module_param(zfs_trim_queue_limit, uint, 0644);
+MODULE_PARM_DESC(zfs_trim_queue_limit,
+	"Max number of outstanding trims per leaf vdev");
+
+module_param(zfs_trim_txg_batch, uint, 0644);
+MODULE_PARM_DESC(zfs_trim_txg_batch,
+	"Number of txgs of frees autotrim accumulates before trimming");
+/* END CSTYLED */
+#endif
@@ -226,6 +226,7 @@ extern void zfs_init(void);
 extern void zfs_fini(void);
 
 uint_t zfs_fsyncer_key;
+uint_t zfs_replay_eof_key;
 extern uint_t rrw_tsd_key;
 static uint_t zfs_allow_log_key;
 
@@ -3830,6 +3831,75 @@ zfs_ioc_pool_discard_checkpoint(const char *poolname, nvlist_t *innvl,
 	return (spa_checkpoint_discard(poolname));
 }
 
+/*
+ * innvl: {
+ *     "trim_command" -> POOL_TRIM_{START|CANCEL|SUSPEND} (uint64)
+ *     "trim_vdevs": { -> vdevs to trim (nvlist)
+ *         "vdev_path_1": vdev_guid_1, (uint64),
+ *         "vdev_path_2": vdev_guid_2, (uint64),
+ *         ...
+ *     },
+ *     (optional) "trim_rate" -> trim rate in bytes/sec, 0 = unlimited (uint64)
+ * }
+ *
+ * outnvl: {
+ *     "trim_vdevs": { -> trim errors (nvlist)
+ *         "vdev_path_1": errno, see spa_vdev_trim() for errnos (int64)
+ *         "vdev_path_2": errno, ... (int64)
+ *         ...
+ *     }
+ * }
+ *
+ * EINVAL is returned for an unknown command or if any of the provided vdev
+ * guids have been specified with a type other than uint64.
+ */
+static const zfs_ioc_key_t zfs_keys_pool_trim[] = {
+	{ZPOOL_TRIM_COMMAND,	DATA_TYPE_UINT64,		0},
+	{ZPOOL_TRIM_VDEVS,	DATA_TYPE_NVLIST,		0},
+	{ZPOOL_TRIM_RATE,	DATA_TYPE_UINT64,		ZK_OPTIONAL},
+};
+
+static int
+zfs_ioc_pool_trim(const char *poolname, nvlist_t *innvl, nvlist_t *outnvl)
+{
+	uint64_t cmd_type, rate;
+	nvlist_t *vdev_guids;
+	spa_t *spa;
+	int error, total_errors;
+
+	if (nvlist_lookup_uint64(innvl, ZPOOL_TRIM_COMMAND, &cmd_type) != 0 ||
+	    cmd_type >= POOL_TRIM_FUNCS)
+		return (SET_ERROR(EINVAL));
+
+	if (nvlist_lookup_nvlist(innvl, ZPOOL_TRIM_VDEVS, &vdev_guids) != 0)
+		return (SET_ERROR(EINVAL));
+
+	for (nvpair_t *pair = nvlist_next_nvpair(vdev_guids, NULL);
+	    pair != NULL; pair = nvlist_next_nvpair(vdev_guids, pair)) {
+		uint64_t vdev_guid;
+		if (nvpair_value_uint64(pair, &vdev_guid) != 0)
+			return (SET_ERROR(EINVAL));
+	}
+
+	if (nvlist_lookup_uint64(innvl, ZPOOL_TRIM_RATE, &rate) != 0)
+		rate = 0;
+
+	if ((error = spa_open(poolname, &spa, FTAG)) != 0)
+		return (error);
+
+	nvlist_t *vdev_errlist = fnvlist_alloc();
+	total_errors = spa_vdev_trim(spa, vdev_guids, cmd_type, rate,
+	    vdev_errlist);
+
+	if (!nvlist_empty(vdev_errlist))
+		fnvlist_add_nvlist(outnvl, ZPOOL_TRIM_VDEVS, vdev_errlist);
+	fnvlist_free(vdev_errlist);
+
+	spa_close(spa, FTAG);
+
+	return (total_errors > 0 ? SET_ERROR(EINVAL) : 0);
+}
+
 /*
  * inputs:
  * zc_name		name of dataset to destroy
@@ -4117,6 +4187,21 @@ zfs_check_settable(const char *dsname, nvpair_t *pair, cred_t *cr)
 				spa_close(spa, FTAG);
 			}
 
+			if (zio_compress_to_feature(intval) !=
+			    SPA_FEATURE_NONE) {
+				spa_t *spa;
+
+				if ((err = spa_open(dsname, &spa, FTAG)) != 0)
+					return (err);
+
+				if (!spa_feature_is_enabled(spa,
+				    zio_compress_to_feature(intval))) {
+					spa_close(spa, FTAG);
+					return (SET_ERROR(ENOTSUP));
+				}
+				spa_close(spa, FTAG);
+			}
+
 			/*
 			 * If this is a bootable dataset then
 			 * verify that the compression algorithm
@@ -6634,6 +6719,11 @@ zfs_ioctl_init(void)
 	    zfs_keys_pool_discard_checkpoint,
 	    ARRAY_SIZE(zfs_keys_pool_discard_checkpoint));
 
+	zfs_ioctl_register("zpool_trim", ZFS_IOC_POOL_TRIM,
+	    zfs_ioc_pool_trim, zfs_secpolicy_config, POOL_NAME,
+	    POOL_CHECK_SUSPENDED | POOL_CHECK_READONLY, B_TRUE, B_TRUE,
+	    zfs_keys_pool_trim, ARRAY_SIZE(zfs_keys_pool_trim));
+
 	/* IOCTLS that use the legacy function signature */
 
 	zfs_ioctl_register_legacy(ZFS_IOC_POOL_FREEZE, zfs_ioc_pool_freeze,
@@ -7366,6 +7456,7 @@ _init(void)
 		goto out;
 
 	tsd_create(&zfs_fsyncer_key, NULL);
+	tsd_create(&zfs_replay_eof_key, NULL);
 	tsd_create(&rrw_tsd_key, rrw_tsd_destroy);
 	tsd_create(&zfs_allow_log_key, zfs_allow_log_destroy);
 
@@ -7401,6 +7492,7 @@ _fini(void)
 	zvol_fini();
 
 	tsd_destroy(&zfs_fsyncer_key);
+	tsd_destroy(&zfs_replay_eof_key);
 	tsd_destroy(&rrw_tsd_key);
 	tsd_destroy(&zfs_allow_log_key);
 
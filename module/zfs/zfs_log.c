@@ -508,7 +508,11 @@ zfs_log_write(zilog_t *zilog, dmu_tx_t *tx, int txtype,
 		return;
 	}
 
-	if (zilog->zl_logbias == ZFS_LOGBIAS_THROUGHPUT)
+	/*
+	 * A direct write has already put the data on disk, so its blkptr
+	 * can be logged without copying the data back out of the pool.
+	 */
+	if (zilog->zl_logbias == ZFS_LOGBIAS_THROUGHPUT || (ioflag & O_DIRECT))
 		write_state = WR_INDIRECT;
 	else if (!spa_has_slogs(zilog->zl_spa) &&
 	    resid >= zfs_immediate_write_sz)
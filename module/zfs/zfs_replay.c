@@ -665,7 +665,7 @@ zfs_replay_write(void *arg1, void *arg2, boolean_t byteswap)
 	char *data = (char *)(lr + 1);	/* data follows lr_write_t */
 	znode_t	*zp;
 	int error, written;
-	uint64_t eod, offset, length;
+	uint64_t eod, offset, length, replay_eof;
 
 	if (byteswap)
 		byteswap_uint64_array(lr, sizeof (*lr));
@@ -693,10 +693,12 @@ zfs_replay_write(void *arg1, void *arg2, boolean_t byteswap)
 	 * write needs to be there. So we write the whole block and
 	 * reduce the eof. This needs to be done within the single dmu
 	 * transaction created within vn_rdwr -> zfs_write. So a possible
-	 * new end of file is passed through in zfsvfs->z_replay_eof
+	 * new end of file is passed through in zfs_replay_eof_key, which
+	 * is per-thread as zil_replay() may apply writes to different
+	 * objects concurrently.
 	 */
 
-	zfsvfs->z_replay_eof = 0; /* 0 means don't change end of file */
+	replay_eof = 0; /* 0 means don't change end of file */
 
 	/* If it's a dmu_sync() block, write the whole block */
 	if (lr->lr_common.lrc_reclen == sizeof (lr_write_t)) {
@@ -706,9 +708,10 @@ zfs_replay_write(void *arg1, void *arg2, boolean_t byteswap)
 			length = blocksize;
 		}
 		if (zp->z_size < eod)
-			zfsvfs->z_replay_eof = eod;
+			replay_eof = eod;
 	}
 
+	(void) tsd_set(zfs_replay_eof_key, &replay_eof);
 	written = zpl_write_common(ZTOI(zp), data, length, &offset,
 	    UIO_SYSSPACE, 0, kcred);
 	if (written < 0)
@@ -716,8 +719,8 @@ zfs_replay_write(void *arg1, void *arg2, boolean_t byteswap)
 	else if (written < length)
 		error = SET_ERROR(EIO); /* short write */
 
+	(void) tsd_set(zfs_replay_eof_key, NULL);
 	iput(ZTOI(zp));
-	zfsvfs->z_replay_eof = 0;	/* safety */
 
 	return (error);
 }
@@ -981,4 +984,5 @@ zil_replay_func_t *zfs_replay_vector[TX_MAX_TYPE] = {
 	zfs_replay_create,	/* TX_MKDIR_ATTR */
 	zfs_replay_create_acl,	/* TX_MKDIR_ACL_ATTR */
 	zfs_replay_write2,	/* TX_WRITE2 */
+	zfs_replay_error,	/* TX_BATCH */
 };
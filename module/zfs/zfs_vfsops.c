@@ -1260,6 +1260,7 @@ zfsvfs_setup(zfsvfs_t *zfsvfs, boolean_t mounting)
 		ASSERT3P(zfsvfs->z_kstat.dk_kstats, ==, NULL);
 		dataset_kstats_create(&zfsvfs->z_kstat, zfsvfs->z_os);
 	}
+	dataset_kstats_attach(&zfsvfs->z_kstat, zfsvfs->z_os);
 
 	/*
 	 * Set the objset user_ptr to track its zfsvfs.
@@ -1741,6 +1742,7 @@ zfsvfs_teardown(zfsvfs_t *zfsvfs, boolean_t unmounting)
 	 * Unregister properties.
 	 */
 	zfs_unregister_callbacks(zfsvfs);
+	dataset_kstats_detach(&zfsvfs->z_kstat, zfsvfs->z_os);
 
 	/*
 	 * Evict cached data. We must write out any dirty data before
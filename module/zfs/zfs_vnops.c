@@ -51,6 +51,7 @@
 #include <sys/fs/zfs.h>
 #include <sys/dmu.h>
 #include <sys/dmu_objset.h>
+#include <sys/dmu_impl.h>
 #include <sys/spa.h>
 #include <sys/txg.h>
 #include <sys/dbuf.h>
@@ -412,6 +413,132 @@ mappedread(struct inode *ip, int nbytes, uio_t *uio)
 	}
 	return (error);
 }
+
+/*
+ * Direct I/O.  Whole, recordsize aligned blocks of a read or write which
+ * requests it, either with O_DIRECT or the "direct" property, are
+ * transferred between the caller's buffer and disk by dmu_read_direct()
+ * and dmu_write_direct() without being copied through the ARC.  User
+ * buffers are pinned and mapped into the kernel for the duration of the
+ * transfer.  The caller remains free to change them meanwhile, so the DMU
+ * checks each block written from them against its checksum, and rereads
+ * through the ARC any block which fails to read into them; see the comment
+ * above dmu_read_direct_done().  Memory mapped files always use the page
+ * cache.
+ */
+typedef struct zfs_dio {
+	struct page	**zd_pages;
+	int		zd_npages;
+	void		*zd_addr;
+	abd_t		*zd_abd;
+} zfs_dio_t;
+
+static boolean_t
+zfs_dio_requested(znode_t *zp, int ioflag)
+{
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+
+	if (zp->z_is_mapped)
+		return (B_FALSE);
+
+	switch (dmu_objset_direct(zfsvfs->z_os)) {
+	case ZFS_DIRECT_ALWAYS:
+		return (B_TRUE);
+	case ZFS_DIRECT_DISABLED:
+		return (B_FALSE);
+	default:
+		return (!!(ioflag & O_DIRECT));
+	}
+}
+
+/*
+ * Map the next len bytes of the uio, which must be contiguous and aligned
+ * like any other I/O buffer, for direct I/O.  The uio is not advanced.
+ */
+static int
+zfs_dio_get(uio_t *uio, size_t len, uio_rw_t rw, zfs_dio_t *dio)
+{
+	const struct iovec *iov = uio->uio_iov;
+	unsigned long addr;
+	int n;
+
+	if (uio->uio_iovcnt == 0 || iov->iov_len - uio->uio_skip < len)
+		return (SET_ERROR(EINVAL));
+
+	addr = (unsigned long)iov->iov_base + uio->uio_skip;
+	if (!IS_P2ALIGNED(addr, SPA_MINBLOCKSIZE))
+		return (SET_ERROR(EINVAL));
+	bzero(dio, sizeof (*dio));
+
+	switch (uio->uio_segflg) {
+	case UIO_SYSSPACE:
+		dio->zd_abd = abd_get_from_user_buf((void *)addr, len);
+		return (0);
+	case UIO_USERSPACE:
+		break;
+	default:
+		return (SET_ERROR(EINVAL));
+	}
+
+	dio->zd_npages = DIV_ROUND_UP(offset_in_page(addr) + len, PAGE_SIZE);
+	dio->zd_pages = kmem_alloc(dio->zd_npages * sizeof (struct page *),
+	    KM_SLEEP);
+
+	n = get_user_pages_fast(addr & PAGE_MASK, dio->zd_npages,
+	    rw == UIO_READ, dio->zd_pages);
+	if (n == dio->zd_npages) {
+		dio->zd_addr = vmap(dio->zd_pages, n, VM_MAP, PAGE_KERNEL);
+		if (dio->zd_addr != NULL) {
+			dio->zd_abd = abd_get_from_user_buf(
+			    (char *)dio->zd_addr + offset_in_page(addr), len);
+			return (0);
+		}
+	}
+
+	while (n > 0)
+		put_page(dio->zd_pages[--n]);
+	kmem_free(dio->zd_pages, dio->zd_npages * sizeof (struct page *));
+
+	return (SET_ERROR(EFAULT));
+}
+
+static void
+zfs_dio_put(zfs_dio_t *dio, uio_rw_t rw)
+{
+	int i;
+
+	abd_put(dio->zd_abd);
+	if (dio->zd_pages == NULL)
+		return;
+
+	vunmap(dio->zd_addr);
+	for (i = 0; i < dio->zd_npages; i++) {
+		if (rw == UIO_READ)
+			set_page_dirty_lock(dio->zd_pages[i]);
+		put_page(dio->zd_pages[i]);
+	}
+	kmem_free(dio->zd_pages, dio->zd_npages * sizeof (struct page *));
+}
+
+static int
+zfs_read_direct(znode_t *zp, uio_t *uio, ssize_t nbytes)
+{
+	zfs_dio_t dio;
+	int error;
+
+	if (zfs_dio_get(uio, nbytes, UIO_READ, &dio) != 0) {
+		return (dmu_read_uio_dbuf(sa_get_db(zp->z_sa_hdl),
+		    uio, nbytes));
+	}
+
+	error = dmu_read_direct(sa_get_db(zp->z_sa_hdl), uio->uio_loffset,
+	    nbytes, dio.zd_abd);
+	zfs_dio_put(&dio, UIO_READ);
+	if (error == 0)
+		uioskip(uio, nbytes);
+
+	return (error);
+}
 #endif /* _KERNEL */
 
 unsigned long zfs_read_chunk_size = 1024 * 1024; /* Tunable */
@@ -474,6 +601,18 @@ zfs_read(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 	    (ioflag & FRSYNC || zfsvfs->z_os->os_sync == ZFS_SYNC_ALWAYS))
 		zil_commit(zfsvfs->z_log, zp->z_id);
 
+	/*
+	 * Wait for the dataset's readlimit/iopslimit to admit the read
+	 * before taking the range lock, so a throttled reader doesn't hold
+	 * up writers to the same range.
+	 */
+	if (uio->uio_loffset < zp->z_size) {
+		hrtime_t waited = dmu_objset_iolimit(zfsvfs->z_os, B_FALSE,
+		    MIN(uio->uio_resid, zp->z_size - uio->uio_loffset));
+		dataset_kstats_update_throttle_kstats(&zfsvfs->z_kstat,
+		    B_FALSE, waited);
+	}
+
 	/*
 	 * Lock the range against changes.
 	 */
@@ -492,6 +631,7 @@ zfs_read(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 	ASSERT(uio->uio_loffset < zp->z_size);
 	ssize_t n = MIN(uio->uio_resid, zp->z_size - uio->uio_loffset);
 	ssize_t start_resid = n;
+	boolean_t direct = zfs_dio_requested(zp, ioflag);
 
 #ifdef HAVE_UIO_ZEROCOPY
 	xuio_t *xuio = NULL;
@@ -529,7 +669,13 @@ zfs_read(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 		ssize_t nbytes = MIN(n, zfs_read_chunk_size -
 		    P2PHASE(uio->uio_loffset, zfs_read_chunk_size));
 
-		if (zp->z_is_mapped && !(ioflag & O_DIRECT)) {
+		if (direct && n >= zp->z_blksz &&
+		    uio->uio_loffset % zp->z_blksz == 0) {
+			nbytes = MAX(nbytes, zp->z_blksz);
+			nbytes -= nbytes % zp->z_blksz;
+			error = zfs_read_direct(zp, uio, nbytes);
+		} else if (zp->z_is_mapped) {
+			/* Even O_DIRECT must see data dirtied through mmap. */
 			error = mappedread(ip, nbytes, uio);
 		} else {
 			error = dmu_read_uio_dbuf(sa_get_db(zp->z_sa_hdl),
@@ -636,6 +782,13 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 		return (SET_ERROR(EINVAL));
 	}
 
+	/*
+	 * Wait for the dataset's writelimit/iopslimit to admit the write.
+	 */
+	hrtime_t waited = dmu_objset_iolimit(zfsvfs->z_os, B_TRUE, n);
+	dataset_kstats_update_throttle_kstats(&zfsvfs->z_kstat, B_TRUE,
+	    waited);
+
 	int max_blksz = zfsvfs->z_max_blksz;
 	xuio_t *xuio = NULL;
 
@@ -724,6 +877,8 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 
 		arc_buf_t *abuf = NULL;
 		const iovec_t *aiov = NULL;
+		boolean_t direct = B_FALSE;
+		zfs_dio_t dio;
 		if (xuio) {
 #ifdef HAVE_UIO_ZEROCOPY
 			ASSERT(i_iov < iovcnt);
@@ -736,6 +891,14 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 			    aiov->iov_len == arc_buf_size(abuf)));
 			i_iov++;
 #endif
+		} else if (n >= max_blksz && P2PHASE(woff, max_blksz) == 0 &&
+		    zfs_dio_requested(zp, ioflag) &&
+		    zfs_dio_get(uio, max_blksz, UIO_WRITE, &dio) == 0) {
+			/*
+			 * This write covers a full block, which will be
+			 * written directly from the caller's pinned buffer.
+			 */
+			direct = B_TRUE;
 		} else if (n >= max_blksz && woff >= zp->z_size &&
 		    P2PHASE(woff, max_blksz) == 0 &&
 		    zp->z_blksz == max_blksz) {
@@ -772,6 +935,8 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 			dmu_tx_abort(tx);
 			if (abuf != NULL)
 				dmu_return_arcbuf(abuf);
+			if (direct)
+				zfs_dio_put(&dio, UIO_WRITE);
 			break;
 		}
 
@@ -800,6 +965,12 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 			zfs_range_reduce(rl, woff, n);
 		}
 
+		/* Only whole blocks of the file can be written directly. */
+		if (direct && zp->z_blksz != max_blksz) {
+			zfs_dio_put(&dio, UIO_WRITE);
+			direct = B_FALSE;
+		}
+
 		/*
 		 * XXX - should we really limit each write to z_max_blksz?
 		 * Perhaps we should use SPA_MAXBLOCKSIZE chunks?
@@ -807,7 +978,17 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 		ssize_t nbytes = MIN(n, max_blksz - P2PHASE(woff, max_blksz));
 
 		ssize_t tx_bytes;
-		if (abuf == NULL) {
+		if (direct) {
+			ASSERT3S(nbytes, ==, max_blksz);
+			error = dmu_write_direct(sa_get_db(zp->z_sa_hdl),
+			    woff, nbytes, dio.zd_abd, tx);
+			zfs_dio_put(&dio, UIO_WRITE);
+			tx_bytes = 0;
+			if (error == 0) {
+				tx_bytes = nbytes;
+				uioskip(uio, tx_bytes);
+			}
+		} else if (abuf == NULL) {
 			tx_bytes = uio->uio_resid;
 			error = dmu_write_uio_dbuf(sa_get_db(zp->z_sa_hdl),
 			    uio, nbytes, tx);
@@ -837,7 +1018,7 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 			ASSERT(tx_bytes <= uio->uio_resid);
 			uioskip(uio, tx_bytes);
 		}
-		if (tx_bytes && zp->z_is_mapped && !(ioflag & O_DIRECT)) {
+		if (tx_bytes && zp->z_is_mapped) {
 			update_pages(ip, woff,
 			    tx_bytes, zfsvfs->z_os, zp->z_id);
 		}
@@ -893,15 +1074,21 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 		}
 		/*
 		 * If we are replaying and eof is non zero then force
-		 * the file size to the specified eof. Note, there's no
-		 * concurrency during replay.
+		 * the file size to the specified eof.  The eof is passed
+		 * per-thread since records for different objects may be
+		 * replayed concurrently; see zfs_replay_write().
 		 */
-		if (zfsvfs->z_replay && zfsvfs->z_replay_eof != 0)
-			zp->z_size = zfsvfs->z_replay_eof;
+		if (zfsvfs->z_replay) {
+			uint64_t *replay_eof = tsd_get(zfs_replay_eof_key);
+
+			if (replay_eof != NULL && *replay_eof != 0)
+				zp->z_size = *replay_eof;
+		}
 
 		error = sa_bulk_update(zp->z_sa_hdl, bulk, count, tx);
 
-		zfs_log_write(zilog, tx, TX_WRITE, zp, woff, tx_bytes, ioflag,
+		zfs_log_write(zilog, tx, TX_WRITE, zp, woff, tx_bytes,
+		    direct ? (ioflag | O_DIRECT) : (ioflag & ~O_DIRECT),
 		    NULL, NULL);
 		dmu_tx_commit(tx);
 
@@ -1069,9 +1256,13 @@ zfs_get_data(void *arg, lr_write_t *lr, char *buf, struct lwb *lwb, zio_t *zio)
 			zil_fault_io = 0;
 		}
 #endif
+		/*
+		 * The dbuf's data is only needed if dmu_sync() has to write
+		 * it, so don't read back a block written by direct I/O.
+		 */
 		if (error == 0)
-			error = dmu_buf_hold(os, object, offset, zgd, &db,
-			    DMU_READ_NO_PREFETCH);
+			error = dmu_buf_hold_noread(os, object, offset, zgd,
+			    &db);
 
 		if (error == 0) {
 			blkptr_t *bp = &lr->lr_blkptr;
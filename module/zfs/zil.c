@@ -43,6 +43,7 @@
 #include <sys/metaslab.h>
 #include <sys/trace_zil.h>
 #include <sys/abd.h>
+#include <sys/dataset_kstats.h>
 
 /*
  * The ZFS Intent Log (ZIL) saves "transaction records" (itxs) of system
@@ -91,6 +92,24 @@
  */
 int zfs_commit_timeout_pct = 5;
 
+/*
+ * When zil_commit() is being called more often than an lwb takes to be
+ * written, the lwb is kept open for up to this long (beyond the timeout
+ * above) so that the commits expected to arrive meanwhile are written out
+ * with it, rather than each waiting for a write of its own.  A lone
+ * committer is never held open for longer than zfs_commit_timeout_pct
+ * allows.  Zero disables it.
+ */
+unsigned long zfs_commit_coalesce_us = 50;
+
+/*
+ * Number of log chains a dataset writes concurrently once the zil_chains
+ * feature is enabled, at most ZIL_MAX_CHAINS.  Each commit writes its
+ * itxs to a single chain, so committers on different chains don't wait
+ * for each other's log writes.  It takes effect when the log is opened.
+ */
+int zil_chains = 1;
+
 /*
  * See zil.h for more information about these fields.
  */
@@ -117,6 +136,12 @@ static kstat_t *zil_ksp;
  */
 int zil_replay_disable = 0;
 
+/*
+ * Number of threads used to replay independent log records concurrently.
+ * Zero sizes the pool by the number of CPUs; one replays serially.
+ */
+int zil_replay_threads = 0;
+
 /*
  * Tunable parameter for debugging or performance analysis.  Setting
  * zfs_nocacheflush will cause corruption on power loss if a volatile
@@ -201,6 +226,90 @@ zil_header_in_syncing_context(zilog_t *zilog)
 	return ((zil_header_t *)zilog->zl_header);
 }
 
+/*
+ * Number of chains the log can have on disk; the heads of the chains
+ * after the first only exist in objsets with room for them.
+ */
+static int
+zil_max_chains(zilog_t *zilog)
+{
+	return (zilog->zl_chain_heads != NULL ? ZIL_MAX_CHAINS : 1);
+}
+
+/*
+ * Copy out the head of chain c.  The first chain is the one described
+ * by the log header itself.
+ */
+static void
+zil_chain_head_get(zilog_t *zilog, int c, zil_chain_head_t *zch)
+{
+	const zil_header_t *zh = zilog->zl_header;
+
+	if (c == 0) {
+		bzero(zch, sizeof (zil_chain_head_t));
+		zch->zch_log = zh->zh_log;
+		zch->zch_claim_blk_seq = zh->zh_claim_blk_seq;
+		zch->zch_claim_lr_seq = zh->zh_claim_lr_seq;
+	} else {
+		*zch = zilog->zl_chain_heads[c - 1];
+	}
+}
+
+/*
+ * Update the head of chain c, in syncing context.
+ */
+static void
+zil_chain_head_set(zilog_t *zilog, int c, const zil_chain_head_t *zch)
+{
+	zil_header_t *zh = zil_header_in_syncing_context(zilog);
+
+	if (c == 0) {
+		zh->zh_log = zch->zch_log;
+		zh->zh_claim_blk_seq = zch->zch_claim_blk_seq;
+		zh->zh_claim_lr_seq = zch->zch_claim_lr_seq;
+	} else {
+		zilog->zl_chain_heads[c - 1] = *zch;
+	}
+}
+
+/*
+ * Return B_TRUE if none of the chains of the log has any blocks.
+ */
+static boolean_t
+zil_log_is_hole(zilog_t *zilog)
+{
+	for (int c = 0; c < zil_max_chains(zilog); c++) {
+		zil_chain_head_t zch;
+
+		zil_chain_head_get(zilog, c, &zch);
+		if (!BP_IS_HOLE(&zch.zch_log))
+			return (B_FALSE);
+	}
+
+	return (B_TRUE);
+}
+
+/*
+ * Return the limits up to which chain zch is parsed: the highest block
+ * and record sequence numbers claimed, once the log has been claimed.
+ */
+static void
+zil_chain_claim_limits(zilog_t *zilog, const zil_chain_head_t *zch,
+    uint64_t *claim_blk_seqp, uint64_t *claim_lr_seqp)
+{
+	const zil_header_t *zh = zilog->zl_header;
+	boolean_t claimed = !!zh->zh_claim_txg;
+
+	*claim_blk_seqp = claimed ? zch->zch_claim_blk_seq : UINT64_MAX;
+	*claim_lr_seqp = claimed ? zch->zch_claim_lr_seq : UINT64_MAX;
+
+	/*
+	 * Old logs didn't record the maximum zh_claim_lr_seq.
+	 */
+	if (!(zh->zh_flags & ZIL_CLAIM_LR_SEQ_VALID))
+		*claim_lr_seqp = UINT64_MAX;
+}
+
 static void
 zil_init_log_chain(zilog_t *zilog, blkptr_t *bp)
 {
@@ -212,18 +321,10 @@ zil_init_log_chain(zilog_t *zilog, blkptr_t *bp)
 	zc->zc_word[ZIL_ZC_SEQ] = 1ULL;
 }
 
-/*
- * Read a log block and make sure it's valid.
- */
-static int
-zil_read_log_block(zilog_t *zilog, boolean_t decrypt, const blkptr_t *bp,
-    blkptr_t *nbp, void *dst, char **end)
+static enum zio_flag
+zil_log_block_zio_flags(zilog_t *zilog, boolean_t decrypt)
 {
 	enum zio_flag zio_flags = ZIO_FLAG_CANFAIL;
-	arc_flags_t aflags = ARC_FLAG_WAIT;
-	arc_buf_t *abuf = NULL;
-	zbookmark_phys_t zb;
-	int error;
 
 	if (zilog->zl_header->zh_claim_txg == 0)
 		zio_flags |= ZIO_FLAG_SPECULATIVE | ZIO_FLAG_SCRUB;
@@ -234,6 +335,42 @@ zil_read_log_block(zilog_t *zilog, boolean_t decrypt, const blkptr_t *bp,
 	if (!decrypt)
 		zio_flags |= ZIO_FLAG_RAW;
 
+	return (zio_flags);
+}
+
+/*
+ * Start reading the next log block in the chain while the records of
+ * the current one are being parsed.  The block may never have been
+ * written, so the read is speculative.
+ */
+static void
+zil_prefetch_log_block(zilog_t *zilog, boolean_t decrypt, const blkptr_t *bp)
+{
+	enum zio_flag zio_flags = zil_log_block_zio_flags(zilog, decrypt);
+	arc_flags_t aflags = ARC_FLAG_NOWAIT | ARC_FLAG_PREFETCH;
+	zbookmark_phys_t zb;
+
+	SET_BOOKMARK(&zb, bp->blk_cksum.zc_word[ZIL_ZC_OBJSET],
+	    ZB_ZIL_OBJECT, ZB_ZIL_LEVEL, bp->blk_cksum.zc_word[ZIL_ZC_SEQ]);
+
+	(void) arc_read(NULL, zilog->zl_spa, bp, NULL, NULL,
+	    ZIO_PRIORITY_SYNC_READ, zio_flags | ZIO_FLAG_SPECULATIVE,
+	    &aflags, &zb);
+}
+
+/*
+ * Read a log block and make sure it's valid.
+ */
+static int
+zil_read_log_block(zilog_t *zilog, boolean_t decrypt, const blkptr_t *bp,
+    blkptr_t *nbp, void *dst, char **end)
+{
+	enum zio_flag zio_flags = zil_log_block_zio_flags(zilog, decrypt);
+	arc_flags_t aflags = ARC_FLAG_WAIT;
+	arc_buf_t *abuf = NULL;
+	zbookmark_phys_t zb;
+	int error;
+
 	SET_BOOKMARK(&zb, bp->blk_cksum.zc_word[ZIL_ZC_OBJSET],
 	    ZB_ZIL_OBJECT, ZB_ZIL_LEVEL, bp->blk_cksum.zc_word[ZIL_ZC_SEQ]);
 
@@ -337,35 +474,56 @@ zil_read_log_data(zilog_t *zilog, const lr_write_t *lr, void *wbuf)
 }
 
 /*
- * Parse the intent log, and call parse_func for each valid record within.
+ * Start reading the data block of an indirect TX_WRITE record ahead of
+ * its replay.
  */
-int
-zil_parse(zilog_t *zilog, zil_parse_blk_func_t *parse_blk_func,
+static void
+zil_prefetch_log_data(zilog_t *zilog, const lr_write_t *lr)
+{
+	enum zio_flag zio_flags = ZIO_FLAG_CANFAIL | ZIO_FLAG_SPECULATIVE;
+	const blkptr_t *bp = &lr->lr_blkptr;
+	arc_flags_t aflags = ARC_FLAG_NOWAIT | ARC_FLAG_PREFETCH;
+	zbookmark_phys_t zb;
+
+	if (BP_IS_HOLE(bp))
+		return;
+
+	if (zilog->zl_header->zh_claim_txg == 0)
+		zio_flags |= ZIO_FLAG_SCRUB;
+
+	SET_BOOKMARK(&zb, dmu_objset_id(zilog->zl_os), lr->lr_foid,
+	    ZB_ZIL_LEVEL, lr->lr_offset / BP_GET_LSIZE(bp));
+
+	(void) arc_read(NULL, zilog->zl_spa, bp, NULL, NULL,
+	    ZIO_PRIORITY_SYNC_READ, zio_flags, &aflags, &zb);
+}
+
+/*
+ * Parse chain c of the intent log; see zil_parse().
+ */
+static int
+zil_parse_chain(zilog_t *zilog, int c, zil_parse_blk_func_t *parse_blk_func,
     zil_parse_lr_func_t *parse_lr_func, void *arg, uint64_t txg,
-    boolean_t decrypt)
+    boolean_t decrypt, char *lrbuf)
 {
-	const zil_header_t *zh = zilog->zl_header;
-	boolean_t claimed = !!zh->zh_claim_txg;
-	uint64_t claim_blk_seq = claimed ? zh->zh_claim_blk_seq : UINT64_MAX;
-	uint64_t claim_lr_seq = claimed ? zh->zh_claim_lr_seq : UINT64_MAX;
+	zilog_chain_t *zlc = &zilog->zl_chains[c];
+	zil_chain_head_t zch;
+	uint64_t claim_blk_seq, claim_lr_seq;
 	uint64_t max_blk_seq = 0;
 	uint64_t max_lr_seq = 0;
 	uint64_t blk_count = 0;
 	uint64_t lr_count = 0;
 	blkptr_t blk, next_blk;
-	char *lrbuf, *lrp;
+	char *lrp;
 	int error = 0;
 
 	bzero(&next_blk, sizeof (blkptr_t));
 
-	/*
-	 * Old logs didn't record the maximum zh_claim_lr_seq.
-	 */
-	if (!(zh->zh_flags & ZIL_CLAIM_LR_SEQ_VALID))
-		claim_lr_seq = UINT64_MAX;
+	zil_chain_head_get(zilog, c, &zch);
+	zil_chain_claim_limits(zilog, &zch, &claim_blk_seq, &claim_lr_seq);
 
 	/*
-	 * Starting at the block pointed to by zh_log we read the log chain.
+	 * Starting at the head of the chain we read the log chain.
 	 * For each block in the chain we strongly check that block to
 	 * ensure its validity.  We stop when an invalid block is found.
 	 * For each block pointer in the chain we call parse_blk_func().
@@ -373,10 +531,7 @@ zil_parse(zilog_t *zilog, zil_parse_blk_func_t *parse_blk_func,
 	 * If the log has been claimed, stop if we encounter a sequence
 	 * number greater than the highest claimed sequence number.
 	 */
-	lrbuf = zio_buf_alloc(SPA_OLD_MAXBLOCKSIZE);
-	zil_bp_tree_init(zilog);
-
-	for (blk = zh->zh_log; !BP_IS_HOLE(&blk); blk = next_blk) {
+	for (blk = zch.zch_log; !BP_IS_HOLE(&blk); blk = next_blk) {
 		uint64_t blk_seq = blk.blk_cksum.zc_word[ZIL_ZC_SEQ];
 		int reclen;
 		char *end = NULL;
@@ -399,6 +554,10 @@ zil_parse(zilog_t *zilog, zil_parse_blk_func_t *parse_blk_func,
 		if (error != 0)
 			break;
 
+		if (!BP_IS_HOLE(&next_blk) &&
+		    next_blk.blk_cksum.zc_word[ZIL_ZC_SEQ] <= claim_blk_seq)
+			zil_prefetch_log_block(zilog, decrypt, &next_blk);
+
 		for (lrp = lrbuf; lrp < end; lrp += reclen) {
 			lr_t *lr = (lr_t *)lrp;
 			reclen = lr->lrc_reclen;
@@ -415,16 +574,63 @@ zil_parse(zilog_t *zilog, zil_parse_blk_func_t *parse_blk_func,
 		}
 	}
 done:
-	zilog->zl_parse_error = error;
-	zilog->zl_parse_blk_seq = max_blk_seq;
-	zilog->zl_parse_lr_seq = max_lr_seq;
-	zilog->zl_parse_blk_count = blk_count;
-	zilog->zl_parse_lr_count = lr_count;
+	zlc->zlc_parse_blk_seq = max_blk_seq;
+	zlc->zlc_parse_lr_seq = max_lr_seq;
+	zilog->zl_parse_blk_count += blk_count;
+	zilog->zl_parse_lr_count += lr_count;
 
-	ASSERT(!claimed || !(zh->zh_flags & ZIL_CLAIM_LR_SEQ_VALID) ||
+	ASSERT(!zilog->zl_header->zh_claim_txg ||
+	    !(zilog->zl_header->zh_flags & ZIL_CLAIM_LR_SEQ_VALID) ||
 	    (max_blk_seq == claim_blk_seq && max_lr_seq == claim_lr_seq) ||
 	    (decrypt && error == EIO));
 
+	return (error);
+}
+
+/*
+ * Parse the intent log, and call parse_func for each valid record within.
+ * A log written as several chains is parsed one chain after the other,
+ * so the records are not seen in sequence number order.
+ */
+int
+zil_parse(zilog_t *zilog, zil_parse_blk_func_t *parse_blk_func,
+    zil_parse_lr_func_t *parse_lr_func, void *arg, uint64_t txg,
+    boolean_t decrypt)
+{
+	uint64_t max_blk_seq = 0;
+	uint64_t max_lr_seq = 0;
+	char *lrbuf;
+	int error = 0;
+
+	zilog->zl_parse_blk_count = 0;
+	zilog->zl_parse_lr_count = 0;
+
+	lrbuf = zio_buf_alloc(SPA_OLD_MAXBLOCKSIZE);
+	zil_bp_tree_init(zilog);
+
+	for (int c = 0; c < zil_max_chains(zilog); c++) {
+		zilog_chain_t *zlc = &zilog->zl_chains[c];
+		int cerror;
+
+		cerror = zil_parse_chain(zilog, c, parse_blk_func,
+		    parse_lr_func, arg, txg, decrypt, lrbuf);
+		max_blk_seq = MAX(max_blk_seq, zlc->zlc_parse_blk_seq);
+		max_lr_seq = MAX(max_lr_seq, zlc->zlc_parse_lr_seq);
+
+		/*
+		 * A chain ending in a block that can't be read is the
+		 * normal end of the log, so report any other error ahead
+		 * of that.
+		 */
+		if (cerror != 0 && (error == 0 || error == ECKSUM ||
+		    error == ENOENT))
+			error = cerror;
+	}
+
+	zilog->zl_parse_error = error;
+	zilog->zl_parse_blk_seq = max_blk_seq;
+	zilog->zl_parse_lr_seq = max_lr_seq;
+
 	zil_bp_tree_fini(zilog);
 	zio_buf_free(lrbuf, SPA_OLD_MAXBLOCKSIZE);
 
@@ -538,23 +744,28 @@ zil_lwb_vdev_compare(const void *x1, const void *x2)
 }
 
 static lwb_t *
-zil_alloc_lwb(zilog_t *zilog, blkptr_t *bp, boolean_t slog, uint64_t txg,
+zil_alloc_lwb(zilog_chain_t *zlc, blkptr_t *bp, boolean_t slog, uint64_t txg,
     boolean_t fastwrite)
 {
+	zilog_t *zilog = zlc->zlc_zilog;
 	lwb_t *lwb;
 
 	lwb = kmem_cache_alloc(zil_lwb_cache, KM_SLEEP);
 	lwb->lwb_zilog = zilog;
+	lwb->lwb_chain = zlc;
 	lwb->lwb_blk = *bp;
 	lwb->lwb_fastwrite = fastwrite;
 	lwb->lwb_slog = slog;
 	lwb->lwb_state = LWB_STATE_CLOSED;
 	lwb->lwb_buf = zio_buf_alloc(BP_GET_LSIZE(bp));
 	lwb->lwb_max_txg = txg;
+	lwb->lwb_batch_start = 0;
+	lwb->lwb_batch = NULL;
 	lwb->lwb_write_zio = NULL;
 	lwb->lwb_root_zio = NULL;
 	lwb->lwb_tx = NULL;
 	lwb->lwb_issued_timestamp = 0;
+	lwb->lwb_written_timestamp = 0;
 	if (BP_GET_CHECKSUM(bp) == ZIO_CHECKSUM_ZILOG2) {
 		lwb->lwb_nused = sizeof (zil_chain_t);
 		lwb->lwb_sz = BP_GET_LSIZE(bp);
@@ -564,7 +775,7 @@ zil_alloc_lwb(zilog_t *zilog, blkptr_t *bp, boolean_t slog, uint64_t txg,
 	}
 
 	mutex_enter(&zilog->zl_lock);
-	list_insert_tail(&zilog->zl_lwb_list, lwb);
+	list_insert_tail(&zlc->zlc_lwb_list, lwb);
 	mutex_exit(&zilog->zl_lock);
 
 	ASSERT(!MUTEX_HELD(&lwb->lwb_vdev_lock));
@@ -588,13 +799,14 @@ zil_free_lwb(zilog_t *zilog, lwb_t *lwb)
 	ASSERT3U(lwb->lwb_max_txg, <=, spa_syncing_txg(zilog->zl_spa));
 	ASSERT(lwb->lwb_state == LWB_STATE_CLOSED ||
 	    lwb->lwb_state == LWB_STATE_DONE);
+	ASSERT3P(lwb->lwb_batch, ==, NULL);
 
 	/*
-	 * Clear the zilog's field to indicate this lwb is no longer
+	 * Clear the chain's field to indicate this lwb is no longer
 	 * valid, and prevent use-after-free errors.
 	 */
-	if (zilog->zl_last_lwb_opened == lwb)
-		zilog->zl_last_lwb_opened = NULL;
+	if (lwb->lwb_chain->zlc_last_lwb_opened == lwb)
+		lwb->lwb_chain->zlc_last_lwb_opened = NULL;
 
 	kmem_cache_free(zil_lwb_cache, lwb);
 }
@@ -656,12 +868,13 @@ zilog_is_dirty(zilog_t *zilog)
 }
 
 /*
- * Create an on-disk intent log.
+ * Create chain zlc of the on-disk intent log.
  */
 static lwb_t *
-zil_create(zilog_t *zilog)
+zil_create(zilog_chain_t *zlc)
 {
-	const zil_header_t *zh = zilog->zl_header;
+	zilog_t *zilog = zlc->zlc_zilog;
+	zil_chain_head_t zch;
 	lwb_t *lwb = NULL;
 	uint64_t txg = 0;
 	dmu_tx_t *tx = NULL;
@@ -675,10 +888,11 @@ zil_create(zilog_t *zilog)
 	 */
 	txg_wait_synced(zilog->zl_dmu_pool, zilog->zl_destroy_txg);
 
-	ASSERT(zh->zh_claim_txg == 0);
-	ASSERT(zh->zh_replay_seq == 0);
+	ASSERT(zilog->zl_header->zh_claim_txg == 0);
+	ASSERT(zilog->zl_header->zh_replay_seq == 0);
 
-	blk = zh->zh_log;
+	zil_chain_head_get(zilog, zlc->zlc_id, &zch);
+	blk = zch.zch_log;
 
 	/*
 	 * Allocate an initial log block if:
@@ -708,19 +922,21 @@ zil_create(zilog_t *zilog)
 	 * Allocate a log write block (lwb) for the first log block.
 	 */
 	if (error == 0)
-		lwb = zil_alloc_lwb(zilog, &blk, slog, txg, fastwrite);
+		lwb = zil_alloc_lwb(zlc, &blk, slog, txg, fastwrite);
 
 	/*
 	 * If we just allocated the first log block, commit our transaction
-	 * and wait for zil_sync() to stuff the block pointer into zh_log.
-	 * (zh is part of the MOS, so we cannot modify it in open context.)
+	 * and wait for zil_sync() to stuff the block pointer into the head
+	 * of the chain.  (zh is part of the MOS, so we cannot modify it in
+	 * open context.)
 	 */
 	if (tx != NULL) {
 		dmu_tx_commit(tx);
 		txg_wait_synced(zilog->zl_dmu_pool, txg);
 	}
 
-	ASSERT(bcmp(&blk, &zh->zh_log, sizeof (blk)) == 0);
+	zil_chain_head_get(zilog, zlc->zlc_id, &zch);
+	ASSERT(bcmp(&blk, &zch.zch_log, sizeof (blk)) == 0);
 
 	return (lwb);
 }
@@ -738,6 +954,7 @@ void
 zil_destroy(zilog_t *zilog, boolean_t keep_first)
 {
 	const zil_header_t *zh = zilog->zl_header;
+	boolean_t in_memory = B_FALSE;
 	lwb_t *lwb;
 	dmu_tx_t *tx;
 	uint64_t txg;
@@ -749,9 +966,21 @@ zil_destroy(zilog_t *zilog, boolean_t keep_first)
 
 	zilog->zl_old_header = *zh;		/* debugging aid */
 
-	if (BP_IS_HOLE(&zh->zh_log))
+	if (zil_log_is_hole(zilog))
 		return;
 
+	/*
+	 * Only the first block of the first chain can be kept; the blocks
+	 * of any other chain are freed along with it.
+	 */
+	for (int c = 1; c < zil_max_chains(zilog) && keep_first; c++) {
+		zil_chain_head_t zch;
+
+		zil_chain_head_get(zilog, c, &zch);
+		if (!BP_IS_HOLE(&zch.zch_log))
+			keep_first = B_FALSE;
+	}
+
 	tx = dmu_tx_create(zilog->zl_os);
 	VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
 	dsl_dataset_dirty(dmu_objset_ds(zilog->zl_os), tx);
@@ -763,23 +992,27 @@ zil_destroy(zilog_t *zilog, boolean_t keep_first)
 	zilog->zl_destroy_txg = txg;
 	zilog->zl_keep_first = keep_first;
 
-	if (!list_is_empty(&zilog->zl_lwb_list)) {
-		ASSERT(zh->zh_claim_txg == 0);
-		VERIFY(!keep_first);
-		while ((lwb = list_head(&zilog->zl_lwb_list)) != NULL) {
+	for (int c = 0; c < zilog->zl_nchains; c++) {
+		zilog_chain_t *zlc = &zilog->zl_chains[c];
+
+		while ((lwb = list_head(&zlc->zlc_lwb_list)) != NULL) {
+			ASSERT(zh->zh_claim_txg == 0);
+			VERIFY(!keep_first);
+			in_memory = B_TRUE;
+
 			if (lwb->lwb_fastwrite)
 				metaslab_fastwrite_unmark(zilog->zl_spa,
 				    &lwb->lwb_blk);
 
-			list_remove(&zilog->zl_lwb_list, lwb);
+			list_remove(&zlc->zlc_lwb_list, lwb);
 			if (lwb->lwb_buf != NULL)
 				zio_buf_free(lwb->lwb_buf, lwb->lwb_sz);
 			zio_free(zilog->zl_spa, txg, &lwb->lwb_blk);
 			zil_free_lwb(zilog, lwb);
 		}
-	} else if (!keep_first) {
-		zil_destroy_sync(zilog, tx);
 	}
+	if (!in_memory && !keep_first)
+		zil_destroy_sync(zilog, tx);
 	mutex_exit(&zilog->zl_lock);
 
 	dmu_tx_commit(tx);
@@ -788,7 +1021,8 @@ zil_destroy(zilog_t *zilog, boolean_t keep_first)
 void
 zil_destroy_sync(zilog_t *zilog, dmu_tx_t *tx)
 {
-	ASSERT(list_is_empty(&zilog->zl_lwb_list));
+	for (int c = 0; c < ZIL_MAX_CHAINS; c++)
+		ASSERT(list_is_empty(&zilog->zl_chains[c].zlc_lwb_list));
 	(void) zil_parse(zilog, zil_free_log_block,
 	    zil_free_log_record, tx, zilog->zl_header->zh_claim_txg, B_FALSE);
 }
@@ -853,11 +1087,15 @@ zil_claim(dsl_pool_t *dp, dsl_dataset_t *ds, void *txarg)
 	if (spa_get_log_state(zilog->zl_spa) == SPA_LOG_CLEAR ||
 	    (zilog->zl_spa->spa_uberblock.ub_checkpoint_txg != 0 &&
 	    zh->zh_claim_txg == 0)) {
-		if (!BP_IS_HOLE(&zh->zh_log)) {
+		if (!zil_log_is_hole(zilog)) {
 			(void) zil_parse(zilog, zil_clear_log_block,
 			    zil_noop_log_record, tx, first_txg, B_FALSE);
 		}
 		BP_ZERO(&zh->zh_log);
+		if (zilog->zl_chain_heads != NULL) {
+			bzero(zilog->zl_chain_heads, sizeof (zil_chain_head_t) *
+			    (ZIL_MAX_CHAINS - 1));
+		}
 		if (os->os_encrypted)
 			os->os_next_write_raw[tx->tx_txg & TXG_MASK] = B_TRUE;
 		dsl_dataset_dirty(dmu_objset_ds(os), tx);
@@ -879,12 +1117,19 @@ zil_claim(dsl_pool_t *dp, dsl_dataset_t *ds, void *txarg)
 	 * or destroy beyond the last block we successfully claimed.
 	 */
 	ASSERT3U(zh->zh_claim_txg, <=, first_txg);
-	if (zh->zh_claim_txg == 0 && !BP_IS_HOLE(&zh->zh_log)) {
+	if (zh->zh_claim_txg == 0 && !zil_log_is_hole(zilog)) {
 		(void) zil_parse(zilog, zil_claim_log_block,
 		    zil_claim_log_record, tx, first_txg, B_FALSE);
 		zh->zh_claim_txg = first_txg;
-		zh->zh_claim_blk_seq = zilog->zl_parse_blk_seq;
-		zh->zh_claim_lr_seq = zilog->zl_parse_lr_seq;
+		for (int c = 0; c < zil_max_chains(zilog); c++) {
+			zilog_chain_t *zlc = &zilog->zl_chains[c];
+			zil_chain_head_t zch;
+
+			zil_chain_head_get(zilog, c, &zch);
+			zch.zch_claim_blk_seq = zlc->zlc_parse_blk_seq;
+			zch.zch_claim_lr_seq = zlc->zlc_parse_lr_seq;
+			zil_chain_head_set(zilog, c, &zch);
+		}
 		if (zilog->zl_parse_lr_count || zilog->zl_parse_blk_count > 1)
 			zh->zh_flags |= ZIL_REPLAY_NEEDED;
 		zh->zh_flags |= ZIL_CLAIM_LR_SEQ_VALID;
@@ -909,7 +1154,6 @@ zil_check_log_chain(dsl_pool_t *dp, dsl_dataset_t *ds, void *tx)
 {
 	zilog_t *zilog;
 	objset_t *os;
-	blkptr_t *bp;
 	int error;
 
 	ASSERT(tx == NULL);
@@ -922,18 +1166,23 @@ zil_check_log_chain(dsl_pool_t *dp, dsl_dataset_t *ds, void *tx)
 	}
 
 	zilog = dmu_objset_zil(os);
-	bp = (blkptr_t *)&zilog->zl_header->zh_log;
 
-	if (!BP_IS_HOLE(bp)) {
+	for (int c = 0; c < zil_max_chains(zilog); c++) {
+		zil_chain_head_t zch;
+		blkptr_t *bp = &zch.zch_log;
 		vdev_t *vd;
 		boolean_t valid = B_TRUE;
 
+		zil_chain_head_get(zilog, c, &zch);
+		if (BP_IS_HOLE(bp))
+			continue;
+
 		/*
-		 * Check the first block and determine if it's on a log device
-		 * which may have been removed or faulted prior to loading this
-		 * pool.  If so, there's no point in checking the rest of the
-		 * log as its content should have already been synced to the
-		 * pool.
+		 * Check the first block of each chain and determine if it's
+		 * on a log device which may have been removed or faulted
+		 * prior to loading this pool.  If so, there's no point in
+		 * checking the rest of the log as its content should have
+		 * already been synced to the pool.
 		 */
 		spa_config_enter(os->os_spa, SCL_STATE, FTAG, RW_READER);
 		vd = vdev_lookup_top(os->os_spa, DVA_GET_VDEV(&bp->blk_dva[0]));
@@ -943,7 +1192,9 @@ zil_check_log_chain(dsl_pool_t *dp, dsl_dataset_t *ds, void *tx)
 
 		if (!valid)
 			return (0);
+	}
 
+	if (!zil_log_is_hole(zilog)) {
 		/*
 		 * Check whether the current uberblock is checkpointed (e.g.
 		 * we are rewinding) and whether the current header has been
@@ -1031,6 +1282,98 @@ zil_commit_waiter_link_nolwb(zil_commit_waiter_t *zcw, list_t *nolwb)
 	mutex_exit(&zcw->zcw_lock);
 }
 
+/*
+ * This function is used when the given waiter is to be linked into a
+ * batch's "zib_waiters" list, i.e. when the itx is committed as part of
+ * that batch of a multi-chain log.
+ */
+static void
+zil_commit_waiter_link_batch(zil_commit_waiter_t *zcw, zil_batch_t *zib)
+{
+	mutex_enter(&zcw->zcw_lock);
+	ASSERT(!list_link_active(&zcw->zcw_node));
+	ASSERT3P(zcw->zcw_lwb, ==, NULL);
+	ASSERT3P(zcw->zcw_batch, ==, NULL);
+	list_insert_tail(&zib->zib_waiters, zcw);
+	zcw->zcw_batch = zib;
+	mutex_exit(&zcw->zcw_lock);
+}
+
+/*
+ * Acknowledge the batches at the head of zl_batch_list that are complete,
+ * destroying their itxs and signalling their waiters.  A batch is
+ * complete once its TX_BATCH record is on stable storage, or once
+ * zh_batch_seq is known to be past it, its itxs having been synced to
+ * the main pool.  Replay stops at the first batch that isn't on disk, so
+ * the batches after one whose write failed fail as well, until the
+ * header on disk no longer needs the failed one.
+ */
+static void
+zil_batch_ack(zilog_t *zilog)
+{
+	zil_batch_t *zib;
+
+	ASSERT(MUTEX_HELD(&zilog->zl_lock));
+
+	if (zilog->zl_batch_broken_txg != 0 &&
+	    spa_last_synced_txg(zilog->zl_spa) >= zilog->zl_batch_broken_txg) {
+		zilog->zl_batch_broken = 0;
+		zilog->zl_batch_broken_txg = 0;
+	}
+
+	while ((zib = list_head(&zilog->zl_batch_list)) != NULL) {
+		boolean_t safe = (zib->zib_start < zilog->zl_batch_safe);
+		zil_commit_waiter_t *zcw;
+		itx_t *itx;
+		int error = 0;
+
+		/*
+		 * A batch whose TX_BATCH lwb is in flight stays around
+		 * until the lwb is done, as the lwb refers to it.
+		 */
+		if (!zib->zib_placed ||
+		    !(zib->zib_done || (safe && !zib->zib_written)))
+			break;
+		list_remove(&zilog->zl_batch_list, zib);
+
+		if (!safe) {
+			error = zib->zib_error;
+			if (error != 0 && zilog->zl_batch_broken == 0)
+				zilog->zl_batch_broken = zib->zib_start;
+			if (error == 0 && zilog->zl_batch_broken != 0)
+				error = SET_ERROR(EIO);
+			if (error == 0 && zib->zib_end > zib->zib_start)
+				zilog->zl_commit_lr_seq = zib->zib_end - 1;
+		}
+
+		while ((itx = list_head(&zib->zib_itxs)) != NULL) {
+			list_remove(&zib->zib_itxs, itx);
+			zil_itx_destroy(itx);
+		}
+
+		while ((zcw = list_head(&zib->zib_waiters)) != NULL) {
+			mutex_enter(&zcw->zcw_lock);
+
+			list_remove(&zib->zib_waiters, zcw);
+			ASSERT3P(zcw->zcw_batch, ==, zib);
+			zcw->zcw_batch = NULL;
+
+			zcw->zcw_zio_error = error;
+			zcw->zcw_time[ZIL_COMMIT_FLUSH] = zib->zib_flush;
+
+			ASSERT3B(zcw->zcw_done, ==, B_FALSE);
+			zcw->zcw_done = B_TRUE;
+			cv_broadcast(&zcw->zcw_cv);
+
+			mutex_exit(&zcw->zcw_lock);
+		}
+
+		list_destroy(&zib->zib_itxs);
+		list_destroy(&zib->zib_waiters);
+		kmem_free(zib, sizeof (zil_batch_t));
+	}
+}
+
 void
 zil_lwb_add_block(lwb_t *lwb, const blkptr_t *bp)
 {
@@ -1079,6 +1422,7 @@ zil_lwb_flush_vdevs_done(zio_t *zio)
 	zilog_t *zilog = lwb->lwb_zilog;
 	dmu_tx_t *tx = lwb->lwb_tx;
 	zil_commit_waiter_t *zcw;
+	zil_batch_t *zib;
 	itx_t *itx;
 
 	spa_config_exit(zilog->zl_spa, SCL_STATE, lwb);
@@ -1099,17 +1443,21 @@ zil_lwb_flush_vdevs_done(zio_t *zio)
 	lwb->lwb_tx = NULL;
 
 	ASSERT3U(lwb->lwb_issued_timestamp, >, 0);
-	zilog->zl_last_lwb_latency = gethrtime() - lwb->lwb_issued_timestamp;
+	ASSERT3U(lwb->lwb_written_timestamp, >, 0);
+	hrtime_t now = gethrtime();
+	zilog->zl_last_lwb_latency = now - lwb->lwb_issued_timestamp;
 
 	lwb->lwb_root_zio = NULL;
 	lwb->lwb_state = LWB_STATE_DONE;
 
-	if (zilog->zl_last_lwb_opened == lwb) {
+	if (lwb->lwb_chain->zlc_last_lwb_opened == lwb &&
+	    zilog->zl_nchains == 1) {
 		/*
 		 * Remember the highest committed log sequence number
 		 * for ztest. We only update this value when all the log
 		 * writes succeeded, because ztest wants to ASSERT that
-		 * it got the whole log chain.
+		 * it got the whole log chain.  A multi-chain log does
+		 * this as its batches are acknowledged.
 		 */
 		zilog->zl_commit_lr_seq = zilog->zl_lr_seq;
 	}
@@ -1129,6 +1477,8 @@ zil_lwb_flush_vdevs_done(zio_t *zio)
 		zcw->zcw_lwb = NULL;
 
 		zcw->zcw_zio_error = zio->io_error;
+		zcw->zcw_time[ZIL_COMMIT_FLUSH] =
+		    now - lwb->lwb_written_timestamp;
 
 		ASSERT3B(zcw->zcw_done, ==, B_FALSE);
 		zcw->zcw_done = B_TRUE;
@@ -1137,6 +1487,14 @@ zil_lwb_flush_vdevs_done(zio_t *zio)
 		mutex_exit(&zcw->zcw_lock);
 	}
 
+	if ((zib = lwb->lwb_batch) != NULL) {
+		lwb->lwb_batch = NULL;
+		zib->zib_done = B_TRUE;
+		zib->zib_error = zio->io_error;
+		zib->zib_flush = now - lwb->lwb_written_timestamp;
+		zil_batch_ack(zilog);
+	}
+
 	mutex_exit(&zilog->zl_lock);
 
 	/*
@@ -1184,6 +1542,7 @@ zil_lwb_write_done(zio_t *zio)
 	mutex_enter(&zilog->zl_lock);
 	lwb->lwb_write_zio = NULL;
 	lwb->lwb_fastwrite = FALSE;
+	lwb->lwb_written_timestamp = gethrtime();
 	mutex_exit(&zilog->zl_lock);
 
 	if (avl_numnodes(t) == 0)
@@ -1220,10 +1579,11 @@ zil_lwb_write_done(zio_t *zio)
 static void
 zil_lwb_write_open(zilog_t *zilog, lwb_t *lwb)
 {
+	zilog_chain_t *zlc = lwb->lwb_chain;
 	zbookmark_phys_t zb;
 	zio_priority_t prio;
 
-	ASSERT(MUTEX_HELD(&zilog->zl_issuer_lock));
+	ASSERT(MUTEX_HELD(&zlc->zlc_issuer_lock));
 	ASSERT3P(lwb, !=, NULL);
 	EQUIV(lwb->lwb_root_zio == NULL, lwb->lwb_state == LWB_STATE_CLOSED);
 	EQUIV(lwb->lwb_root_zio != NULL, lwb->lwb_state == LWB_STATE_OPENED);
@@ -1243,7 +1603,7 @@ zil_lwb_write_open(zilog_t *zilog, lwb_t *lwb)
 			lwb->lwb_fastwrite = 1;
 		}
 
-		if (!lwb->lwb_slog || zilog->zl_cur_used <= zil_slog_bulk)
+		if (!lwb->lwb_slog || zlc->zlc_cur_used <= zil_slog_bulk)
 			prio = ZIO_PRIORITY_SYNC_WRITE;
 		else
 			prio = ZIO_PRIORITY_ASYNC_WRITE;
@@ -1262,7 +1622,7 @@ zil_lwb_write_open(zilog_t *zilog, lwb_t *lwb)
 		lwb->lwb_state = LWB_STATE_OPENED;
 
 		/*
-		 * The zilog's "zl_last_lwb_opened" field is used to
+		 * The chain's "zlc_last_lwb_opened" field is used to
 		 * build the lwb/zio dependency chain, which is used to
 		 * preserve the ordering of lwb completions that is
 		 * required by the semantics of the ZIL. Each new lwb
@@ -1276,7 +1636,7 @@ zil_lwb_write_open(zilog_t *zilog, lwb_t *lwb)
 		 * dependency graph ensures the waiters are woken in the
 		 * correct order (the same order the lwbs were created).
 		 */
-		lwb_t *last_lwb_opened = zilog->zl_last_lwb_opened;
+		lwb_t *last_lwb_opened = zlc->zlc_last_lwb_opened;
 		if (last_lwb_opened != NULL &&
 		    last_lwb_opened->lwb_state != LWB_STATE_DONE) {
 			ASSERT(last_lwb_opened->lwb_state == LWB_STATE_OPENED ||
@@ -1285,7 +1645,7 @@ zil_lwb_write_open(zilog_t *zilog, lwb_t *lwb)
 			zio_add_child(lwb->lwb_root_zio,
 			    last_lwb_opened->lwb_root_zio);
 		}
-		zilog->zl_last_lwb_opened = lwb;
+		zlc->zlc_last_lwb_opened = lwb;
 	}
 	mutex_exit(&zilog->zl_lock);
 
@@ -1308,13 +1668,36 @@ uint64_t zil_block_buckets[] = {
     UINT64_MAX
 };
 
+/*
+ * Issue the zios of the lwbs on the given list, which were closed by
+ * zil_lwb_write_issue(), in the order they were closed.
+ */
+static void
+zil_issue_lwbs(list_t *ilwbs)
+{
+	lwb_t *lwb;
+
+	while ((lwb = list_head(ilwbs)) != NULL) {
+		list_remove(ilwbs, lwb);
+		ASSERT3S(lwb->lwb_state, ==, LWB_STATE_ISSUED);
+		lwb->lwb_issued_timestamp = gethrtime();
+		zio_nowait(lwb->lwb_root_zio);
+		zio_nowait(lwb->lwb_write_zio);
+	}
+}
+
 /*
  * Start a log block write and advance to the next log block.
- * Calls are serialized.
+ * Calls are serialized.  The lwb is added to ilwbs, and its zios are
+ * only issued when the caller passes the list to zil_issue_lwbs().
+ * Since the lwb holds a tx open until its write is done, that must
+ * happen before the caller waits on anything which may depend on the
+ * txg syncing.
  */
 static lwb_t *
-zil_lwb_write_issue(zilog_t *zilog, lwb_t *lwb)
+zil_lwb_write_issue(zilog_t *zilog, lwb_t *lwb, list_t *ilwbs)
 {
+	zilog_chain_t *zlc = lwb->lwb_chain;
 	lwb_t *nlwb = NULL;
 	zil_chain_t *zilc;
 	spa_t *spa = zilog->zl_spa;
@@ -1325,7 +1708,7 @@ zil_lwb_write_issue(zilog_t *zilog, lwb_t *lwb)
 	int i, error;
 	boolean_t slog;
 
-	ASSERT(MUTEX_HELD(&zilog->zl_issuer_lock));
+	ASSERT(MUTEX_HELD(&zlc->zlc_issuer_lock));
 	ASSERT3P(lwb->lwb_root_zio, !=, NULL);
 	ASSERT3P(lwb->lwb_write_zio, !=, NULL);
 	ASSERT3S(lwb->lwb_state, ==, LWB_STATE_OPENED);
@@ -1381,16 +1764,16 @@ zil_lwb_write_issue(zilog_t *zilog, lwb_t *lwb)
 	 * the maximum block size because we can exhaust the available
 	 * pool log space.
 	 */
-	zil_blksz = zilog->zl_cur_used + sizeof (zil_chain_t);
+	zil_blksz = zlc->zlc_cur_used + sizeof (zil_chain_t);
 	for (i = 0; zil_blksz > zil_block_buckets[i]; i++)
 		continue;
 	zil_blksz = zil_block_buckets[i];
 	if (zil_blksz == UINT64_MAX)
 		zil_blksz = SPA_OLD_MAXBLOCKSIZE;
-	zilog->zl_prev_blks[zilog->zl_prev_rotor] = zil_blksz;
+	zlc->zlc_prev_blks[zlc->zlc_prev_rotor] = zil_blksz;
 	for (i = 0; i < ZIL_PREV_BLKS; i++)
-		zil_blksz = MAX(zil_blksz, zilog->zl_prev_blks[i]);
-	zilog->zl_prev_rotor = (zilog->zl_prev_rotor + 1) & (ZIL_PREV_BLKS - 1);
+		zil_blksz = MAX(zil_blksz, zlc->zlc_prev_blks[i]);
+	zlc->zlc_prev_rotor = (zlc->zlc_prev_rotor + 1) & (ZIL_PREV_BLKS - 1);
 
 	BP_ZERO(bp);
 	error = zio_alloc_zil(spa, zilog->zl_os, txg, bp, zil_blksz, &slog);
@@ -1409,7 +1792,7 @@ zil_lwb_write_issue(zilog_t *zilog, lwb_t *lwb)
 		/*
 		 * Allocate a new log write block (lwb).
 		 */
-		nlwb = zil_alloc_lwb(zilog, bp, slog, txg, TRUE);
+		nlwb = zil_alloc_lwb(zlc, bp, slog, txg, TRUE);
 	}
 
 	if (BP_GET_CHECKSUM(&lwb->lwb_blk) == ZIO_CHECKSUM_ZILOG2) {
@@ -1434,11 +1817,8 @@ zil_lwb_write_issue(zilog_t *zilog, lwb_t *lwb)
 	spa_config_enter(zilog->zl_spa, SCL_STATE, lwb, RW_READER);
 
 	zil_lwb_add_block(lwb, &lwb->lwb_blk);
-	lwb->lwb_issued_timestamp = gethrtime();
 	lwb->lwb_state = LWB_STATE_ISSUED;
-
-	zio_nowait(lwb->lwb_root_zio);
-	zio_nowait(lwb->lwb_write_zio);
+	list_insert_tail(ilwbs, lwb);
 
 	/*
 	 * If there was an allocation failure then nlwb will be null which
@@ -1447,15 +1827,22 @@ zil_lwb_write_issue(zilog_t *zilog, lwb_t *lwb)
 	return (nlwb);
 }
 
+/*
+ * Copy the record of an itx into lwb, issuing it and continuing in the
+ * next lwb of its chain as it fills up.  For a multi-chain log, zib is
+ * the batch the itx is written out in.
+ */
 static lwb_t *
-zil_lwb_commit(zilog_t *zilog, itx_t *itx, lwb_t *lwb)
+zil_lwb_commit(zilog_t *zilog, itx_t *itx, lwb_t *lwb, zil_batch_t *zib,
+    list_t *ilwbs)
 {
+	zilog_chain_t *zlc = lwb->lwb_chain;
 	lr_t *lrcb, *lrc;
 	lr_write_t *lrwb, *lrw;
 	char *lr_buf;
 	uint64_t dlen, dnow, lwb_sp, reclen, txg;
 
-	ASSERT(MUTEX_HELD(&zilog->zl_issuer_lock));
+	ASSERT(MUTEX_HELD(&zlc->zlc_issuer_lock));
 	ASSERT3P(lwb, !=, NULL);
 	ASSERT3P(lwb->lwb_buf, !=, NULL);
 
@@ -1477,6 +1864,7 @@ zil_lwb_commit(zilog_t *zilog, itx_t *itx, lwb_t *lwb)
 	 * For more details, see the comment above zil_commit().
 	 */
 	if (lrc->lrc_txtype == TX_COMMIT) {
+		ASSERT3P(zib, ==, NULL);
 		mutex_enter(&zilog->zl_lock);
 		zil_commit_waiter_link_lwb(itx->itx_private, lwb);
 		itx->itx_private = NULL;
@@ -1491,10 +1879,10 @@ zil_lwb_commit(zilog_t *zilog, itx_t *itx, lwb_t *lwb)
 		dlen = 0;
 	}
 	reclen = lrc->lrc_reclen;
-	zilog->zl_cur_used += (reclen + dlen);
+	zlc->zlc_cur_used += (reclen + dlen);
 	txg = lrc->lrc_txg;
 
-	ASSERT3U(zilog->zl_cur_used, <, UINT64_MAX - (reclen + dlen));
+	ASSERT3U(zlc->zlc_cur_used, <, UINT64_MAX - (reclen + dlen));
 
 cont:
 	/*
@@ -1505,7 +1893,7 @@ cont:
 	if (reclen > lwb_sp || (reclen + dlen > lwb_sp &&
 	    lwb_sp < ZIL_MAX_WASTE_SPACE && (dlen % ZIL_MAX_LOG_DATA == 0 ||
 	    lwb_sp < reclen + dlen % ZIL_MAX_LOG_DATA))) {
-		lwb = zil_lwb_write_issue(zilog, lwb);
+		lwb = zil_lwb_write_issue(zilog, lwb, ilwbs);
 		if (lwb == NULL)
 			return (NULL);
 		zil_lwb_write_open(zilog, lwb);
@@ -1526,8 +1914,10 @@ cont:
 	 * If it's a write, fetch the data or get its blkptr as appropriate.
 	 */
 	if (lrc->lrc_txtype == TX_WRITE) {
-		if (txg > spa_freeze_txg(zilog->zl_spa))
+		if (txg > spa_freeze_txg(zilog->zl_spa)) {
+			zil_issue_lwbs(ilwbs);
 			txg_wait_synced(zilog->zl_dmu_pool, txg);
+		}
 		if (itx->itx_wr_state == WR_COPIED) {
 			ZIL_STAT_BUMP(zil_itx_copied_count);
 			ZIL_STAT_INCR(zil_itx_copied_bytes, lrw->lr_length);
@@ -1552,6 +1942,13 @@ cont:
 				    lrw->lr_length);
 			}
 
+			/*
+			 * Fetching the data may wait on a range lock held
+			 * by a thread waiting for the txg to sync, so the
+			 * lwbs closed so far must be issued first.
+			 */
+			zil_issue_lwbs(ilwbs);
+
 			/*
 			 * We pass in the "lwb_write_zio" rather than
 			 * "lwb_root_zio" so that the "lwb_write_zio"
@@ -1587,8 +1984,21 @@ cont:
 	 * log record sequence number.  Note that this is generally not
 	 * equal to the itx sequence number because not all transactions
 	 * are synchronous, and sometimes spa_sync() gets there first.
+	 * A batch takes its sequence numbers from the range reserved for
+	 * it, ending with the TX_BATCH record.
 	 */
-	lrcb->lrc_seq = ++zilog->zl_lr_seq;
+	if (zib == NULL) {
+		lrcb->lrc_seq = ++zilog->zl_lr_seq;
+	} else if (lrc->lrc_txtype == TX_BATCH) {
+		lrcb->lrc_seq = zib->zib_end - 1;
+		lwb->lwb_batch = zib;
+		zib->zib_written = B_TRUE;
+	} else {
+		lrcb->lrc_seq = zib->zib_next_seq++;
+		ASSERT3U(lrcb->lrc_seq, <, zib->zib_end - 1);
+	}
+	if (zib != NULL)
+		lwb->lwb_batch_start = zib->zib_start;
 	lwb->lwb_nused += reclen + dnow;
 
 	zil_lwb_add_txg(lwb, txg);
@@ -1598,7 +2008,7 @@ cont:
 
 	dlen -= dnow;
 	if (dlen > 0) {
-		zilog->zl_cur_used += reclen;
+		zlc->zlc_cur_used += reclen;
 		goto cont;
 	}
 
@@ -1885,15 +2295,15 @@ zil_clean(zilog_t *zilog, uint64_t synced_txg)
 
 /*
  * This function will traverse the queue of itxs that need to be
- * committed, and move them onto the ZIL's zl_itx_commit_list.
+ * committed, and move them onto the chain's zlc_itx_commit_list.
  */
 static void
-zil_get_commit_list(zilog_t *zilog)
+zil_get_commit_list(zilog_t *zilog, zilog_chain_t *zlc)
 {
 	uint64_t otxg, txg;
-	list_t *commit_list = &zilog->zl_itx_commit_list;
+	list_t *commit_list = &zlc->zlc_itx_commit_list;
 
-	ASSERT(MUTEX_HELD(&zilog->zl_issuer_lock));
+	ASSERT(MUTEX_HELD(&zlc->zlc_issuer_lock));
 
 	if (spa_freeze_txg(zilog->zl_spa) != UINT64_MAX) /* ziltest support */
 		otxg = ZILTEST_TXG;
@@ -1915,11 +2325,11 @@ zil_get_commit_list(zilog_t *zilog)
 		}
 
 		/*
-		 * If we're adding itx records to the zl_itx_commit_list,
+		 * If we're adding itx records to the zlc_itx_commit_list,
 		 * then the zil better be dirty in this "txg". We can assert
 		 * that here since we're holding the itxg_lock which will
 		 * prevent spa_sync from cleaning it. Once we add the itxs
-		 * to the zl_itx_commit_list we must commit it to disk even
+		 * to the zlc_itx_commit_list we must commit it to disk even
 		 * if it's unnecessary (i.e. the txg was synced).
 		 */
 		ASSERT(zilog_is_dirty_in_txg(zilog, txg) ||
@@ -1996,20 +2406,21 @@ zil_async_to_sync(zilog_t *zilog, uint64_t foid)
  * from generating new lwbs when it's unnecessary to do so.
  */
 static void
-zil_prune_commit_list(zilog_t *zilog)
+zil_prune_commit_list(zilog_chain_t *zlc)
 {
+	zilog_t *zilog = zlc->zlc_zilog;
 	itx_t *itx;
 
-	ASSERT(MUTEX_HELD(&zilog->zl_issuer_lock));
+	ASSERT(MUTEX_HELD(&zlc->zlc_issuer_lock));
 
-	while ((itx = list_head(&zilog->zl_itx_commit_list)) != NULL) {
+	while ((itx = list_head(&zlc->zlc_itx_commit_list)) != NULL) {
 		lr_t *lrc = &itx->itx_lr;
 		if (lrc->lrc_txtype != TX_COMMIT)
 			break;
 
 		mutex_enter(&zilog->zl_lock);
 
-		lwb_t *last_lwb = zilog->zl_last_lwb_opened;
+		lwb_t *last_lwb = zlc->zlc_last_lwb_opened;
 		if (last_lwb == NULL || last_lwb->lwb_state == LWB_STATE_DONE) {
 			/*
 			 * All of the itxs this waiter was waiting on
@@ -2025,7 +2436,7 @@ zil_prune_commit_list(zilog_t *zilog)
 
 		mutex_exit(&zilog->zl_lock);
 
-		list_remove(&zilog->zl_itx_commit_list, itx);
+		list_remove(&zlc->zlc_itx_commit_list, itx);
 		zil_itx_destroy(itx);
 	}
 
@@ -2033,12 +2444,12 @@ zil_prune_commit_list(zilog_t *zilog)
 }
 
 static void
-zil_commit_writer_stall(zilog_t *zilog)
+zil_commit_writer_stall(zilog_chain_t *zlc)
 {
 	/*
 	 * When zio_alloc_zil() fails to allocate the next lwb block on
 	 * disk, we must call txg_wait_synced() to ensure all of the
-	 * lwbs in the zilog's zl_lwb_list are synced and then freed (in
+	 * lwbs in the chain's zlc_lwb_list are synced and then freed (in
 	 * zil_sync()), such that any subsequent ZIL writer (i.e. a call
 	 * to zil_process_commit_list()) will have to call zil_create(),
 	 * and start a new ZIL chain.
@@ -2050,14 +2461,14 @@ zil_commit_writer_stall(zilog_t *zilog)
 	 * crash (because the previous lwb on-disk would not point to
 	 * it).
 	 *
-	 * We must hold the zilog's zl_issuer_lock while we do this, to
+	 * We must hold the chain's zlc_issuer_lock while we do this, to
 	 * ensure no new threads enter zil_process_commit_list() until
-	 * all lwb's in the zl_lwb_list have been synced and freed
+	 * all lwb's in the zlc_lwb_list have been synced and freed
 	 * (which is achieved via the txg_wait_synced() call).
 	 */
-	ASSERT(MUTEX_HELD(&zilog->zl_issuer_lock));
-	txg_wait_synced(zilog->zl_dmu_pool, 0);
-	ASSERT3P(list_tail(&zilog->zl_lwb_list), ==, NULL);
+	ASSERT(MUTEX_HELD(&zlc->zlc_issuer_lock));
+	txg_wait_synced(zlc->zlc_zilog->zl_dmu_pool, 0);
+	ASSERT3P(list_tail(&zlc->zlc_lwb_list), ==, NULL);
 }
 
 /*
@@ -2067,36 +2478,38 @@ zil_commit_writer_stall(zilog_t *zilog)
  * lwb will be issued to the zio layer to be written to disk.
  */
 static void
-zil_process_commit_list(zilog_t *zilog)
+zil_process_commit_list(zilog_chain_t *zlc, zil_commit_waiter_t *zcw,
+    list_t *ilwbs)
 {
+	zilog_t *zilog = zlc->zlc_zilog;
 	spa_t *spa = zilog->zl_spa;
 	list_t nolwb_itxs;
 	list_t nolwb_waiters;
 	lwb_t *lwb;
 	itx_t *itx;
 
-	ASSERT(MUTEX_HELD(&zilog->zl_issuer_lock));
+	ASSERT(MUTEX_HELD(&zlc->zlc_issuer_lock));
 
 	/*
 	 * Return if there's nothing to commit before we dirty the fs by
 	 * calling zil_create().
 	 */
-	if (list_head(&zilog->zl_itx_commit_list) == NULL)
+	if (list_head(&zlc->zlc_itx_commit_list) == NULL)
 		return;
 
 	list_create(&nolwb_itxs, sizeof (itx_t), offsetof(itx_t, itx_node));
 	list_create(&nolwb_waiters, sizeof (zil_commit_waiter_t),
 	    offsetof(zil_commit_waiter_t, zcw_node));
 
-	lwb = list_tail(&zilog->zl_lwb_list);
+	lwb = list_tail(&zlc->zlc_lwb_list);
 	if (lwb == NULL) {
-		lwb = zil_create(zilog);
+		lwb = zil_create(zlc);
 	} else {
 		ASSERT3S(lwb->lwb_state, !=, LWB_STATE_ISSUED);
 		ASSERT3S(lwb->lwb_state, !=, LWB_STATE_DONE);
 	}
 
-	while ((itx = list_head(&zilog->zl_itx_commit_list)) != NULL) {
+	while ((itx = list_head(&zlc->zlc_itx_commit_list)) != NULL) {
 		lr_t *lrc = &itx->itx_lr;
 		uint64_t txg = lrc->lrc_txg;
 
@@ -2110,7 +2523,7 @@ zil_process_commit_list(zilog_t *zilog)
 			    zilog_t *, zilog, itx_t *, itx);
 		}
 
-		list_remove(&zilog->zl_itx_commit_list, itx);
+		list_remove(&zlc->zlc_itx_commit_list, itx);
 
 		boolean_t synced = txg <= spa_last_synced_txg(spa);
 		boolean_t frozen = txg > spa_freeze_txg(spa);
@@ -2160,8 +2573,19 @@ zil_process_commit_list(zilog_t *zilog)
 		 * value can't be trusted.
 		 */
 		if (frozen || !synced || lrc->lrc_txtype == TX_COMMIT) {
+			if (lrc->lrc_txtype != TX_COMMIT) {
+				zcw->zcw_nitxs++;
+				zcw->zcw_nbytes += lrc->lrc_reclen;
+				if (lrc->lrc_txtype == TX_WRITE &&
+				    itx->itx_wr_state == WR_NEED_COPY) {
+					zcw->zcw_nbytes +=
+					    ((lr_write_t *)lrc)->lr_length;
+				}
+			}
+
 			if (lwb != NULL) {
-				lwb = zil_lwb_commit(zilog, itx, lwb);
+				lwb = zil_lwb_commit(zilog, itx, lwb, NULL,
+				    ilwbs);
 
 				if (lwb == NULL)
 					list_insert_tail(&nolwb_itxs, itx);
@@ -2186,9 +2610,11 @@ zil_process_commit_list(zilog_t *zilog)
 		 * This indicates zio_alloc_zil() failed to allocate the
 		 * "next" lwb on-disk. When this happens, we must stall
 		 * the ZIL write pipeline; see the comment within
-		 * zil_commit_writer_stall() for more details.
+		 * zil_commit_writer_stall() for more details.  The lwbs
+		 * already closed must be issued for the txg to sync.
 		 */
-		zil_commit_writer_stall(zilog);
+		zil_issue_lwbs(ilwbs);
+		zil_commit_writer_stall(zlc);
 
 		/*
 		 * Additionally, we have to signal and mark the "nolwb"
@@ -2268,37 +2694,322 @@ zil_process_commit_list(zilog_t *zilog)
 }
 
 /*
- * This function is responsible for ensuring the passed in commit waiter
- * (and associated commit itx) is committed to an lwb. If the waiter is
- * not already committed to an lwb, all itxs in the zilog's queue of
- * itxs will be processed. The assumption is the passed in waiter's
- * commit itx will found in the queue just like the other non-commit
- * itxs, such that when the entire queue is processed, the waiter will
- * have been committed to an lwb.
- *
- * The lwb associated with the passed in waiter is not guaranteed to
- * have been issued by the time this function completes. If the lwb is
- * not issued, we rely on future calls to zil_commit_writer() to issue
- * the lwb, or the timeout mechanism found in zil_commit_waiter().
+ * Return B_TRUE if chain c may be written.  Once the pool is frozen, the
+ * head of a new chain would never reach it, so only the chains which were
+ * anchored before the freeze are written.
  */
-static void
-zil_commit_writer(zilog_t *zilog, zil_commit_waiter_t *zcw)
+static boolean_t
+zil_chain_writable(zilog_t *zilog, int c)
 {
-	ASSERT(!MUTEX_HELD(&zilog->zl_lock));
-	ASSERT(spa_writeable(zilog->zl_spa));
+	zil_chain_head_t zch;
 
-	mutex_enter(&zilog->zl_issuer_lock);
+	if (spa_freeze_txg(zilog->zl_spa) == UINT64_MAX)
+		return (B_TRUE);
 
-	if (zcw->zcw_lwb != NULL || zcw->zcw_done) {
-		/*
-		 * It's possible that, while we were waiting to acquire
-		 * the "zl_issuer_lock", another thread committed this
-		 * waiter to an lwb. If that occurs, we bail out early,
-		 * without processing any of the zilog's queue of itxs.
-		 *
-		 * On certain workloads and system configurations, the
-		 * "zl_issuer_lock" can become highly contended. In an
-		 * attempt to reduce this contention, we immediately drop
+	zil_chain_head_get(zilog, c, &zch);
+	return (!BP_IS_HOLE(&zch.zch_log));
+}
+
+/*
+ * Pick the chain a commit writer writes to, and take its issuer lock.
+ * Writers start at a chain picked by CPU and take the first one that
+ * isn't busy, only queueing up on that chain when all of them are.  A
+ * frozen pool with no anchored chain writes the first, as a single chain
+ * log would.
+ */
+static zilog_chain_t *
+zil_chain_enter(zilog_t *zilog)
+{
+	int nchains = zilog->zl_nchains;
+	zilog_chain_t *zlc;
+	int c, i;
+
+	kpreempt_disable();
+	c = CPU_SEQID % nchains;
+	kpreempt_enable();
+
+	for (i = 0; i < nchains; i++) {
+		if (zil_chain_writable(zilog, (c + i) % nchains))
+			break;
+	}
+	if (i == nchains) {
+		zlc = &zilog->zl_chains[0];
+		mutex_enter(&zlc->zlc_issuer_lock);
+		return (zlc);
+	}
+	c = (c + i) % nchains;
+
+	for (i = 0; i < nchains; i++) {
+		int n = (c + i) % nchains;
+
+		if (!zil_chain_writable(zilog, n))
+			continue;
+		zlc = &zilog->zl_chains[n];
+		if (mutex_tryenter(&zlc->zlc_issuer_lock))
+			return (zlc);
+	}
+
+	zlc = &zilog->zl_chains[c];
+	mutex_enter(&zlc->zlc_issuer_lock);
+	return (zlc);
+}
+
+/*
+ * Return an upper bound on the number of log records an itx is written
+ * out as.  A WR_NEED_COPY write is split into one record per log block
+ * it spans, and every block after the first holds at least
+ * ZIL_MIN_LOG_DATA of it.
+ */
+static uint64_t
+zil_itx_max_records(itx_t *itx)
+{
+	lr_t *lrc = &itx->itx_lr;
+
+	if (lrc->lrc_txtype == TX_COMMIT)
+		return (0);
+
+	if (lrc->lrc_txtype == TX_WRITE && itx->itx_wr_state == WR_NEED_COPY) {
+		uint64_t dlen = P2ROUNDUP_TYPED(((lr_write_t *)lrc)->lr_length,
+		    sizeof (uint64_t), uint64_t);
+		return (2 + dlen / ZIL_MIN_LOG_DATA);
+	}
+
+	return (1);
+}
+
+/*
+ * Reserve the sequence numbers of a new batch for the itxs on the chain's
+ * commit list.  This is done under zl_gather_lock, along with gathering
+ * the itxs, so that the batches are in the same order as their itxs.
+ */
+static zil_batch_t *
+zil_batch_reserve(zilog_t *zilog, zilog_chain_t *zlc)
+{
+	list_t *commit_list = &zlc->zlc_itx_commit_list;
+	uint64_t nrecords = 0;
+	zil_batch_t *zib;
+	itx_t *itx;
+
+	ASSERT(MUTEX_HELD(&zilog->zl_gather_lock));
+
+	for (itx = list_head(commit_list); itx != NULL;
+	    itx = list_next(commit_list, itx))
+		nrecords += zil_itx_max_records(itx);
+	if (nrecords != 0)
+		nrecords++;		/* for the TX_BATCH record */
+
+	zib = kmem_zalloc(sizeof (zil_batch_t), KM_SLEEP);
+	list_create(&zib->zib_itxs, sizeof (itx_t), offsetof(itx_t, itx_node));
+	list_create(&zib->zib_waiters, sizeof (zil_commit_waiter_t),
+	    offsetof(zil_commit_waiter_t, zcw_node));
+
+	mutex_enter(&zilog->zl_lock);
+	zib->zib_start = zib->zib_next_seq = zilog->zl_lr_seq + 1;
+	zilog->zl_lr_seq += nrecords;
+	zib->zib_end = zilog->zl_lr_seq + 1;
+	list_insert_tail(&zilog->zl_batch_list, zib);
+	mutex_exit(&zilog->zl_lock);
+
+	return (zib);
+}
+
+/*
+ * The multi-chain counterpart of zil_commit_writer_stall().  Once a chain
+ * fails to allocate its next block, the batch being written to it can't
+ * be completed on disk, so it's completed by syncing the txgs of its
+ * itxs instead, and moving zh_batch_seq past it.  This is done for all
+ * the batches reserved so far, so that replay doesn't depend on any lwb
+ * of the chain written until now, and the chain can start anew.
+ */
+static void
+zil_commit_batch_stall(zilog_t *zilog, zilog_chain_t *zlc, list_t *ilwbs)
+{
+	dsl_pool_t *dp = zilog->zl_dmu_pool;
+	uint64_t floor, txg;
+	dmu_tx_t *tx;
+
+	ASSERT(MUTEX_HELD(&zlc->zlc_issuer_lock));
+
+	mutex_enter(&zilog->zl_lock);
+	floor = zilog->zl_lr_seq + 1;
+	mutex_exit(&zilog->zl_lock);
+
+	/*
+	 * The itxs of the batches below the floor are from txgs up to
+	 * the one open now, so they are in the pool once it syncs.
+	 */
+	zil_issue_lwbs(ilwbs);
+	txg_wait_synced(dp, 0);
+
+	mutex_enter(&zilog->zl_lock);
+	zilog->zl_batch_floor = MAX(zilog->zl_batch_floor, floor);
+	mutex_exit(&zilog->zl_lock);
+
+	/*
+	 * Have zil_sync() write the new zh_batch_seq out.
+	 */
+	tx = dmu_tx_create(zilog->zl_os);
+	VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+	dsl_dataset_dirty(dmu_objset_ds(zilog->zl_os), tx);
+	txg = dmu_tx_get_txg(tx);
+	dmu_tx_commit(tx);
+	txg_wait_synced(dp, txg);
+
+	mutex_enter(&zilog->zl_lock);
+	zilog->zl_batch_safe = MAX(zilog->zl_batch_safe, floor);
+	mutex_exit(&zilog->zl_lock);
+
+	ASSERT3P(list_tail(&zlc->zlc_lwb_list), ==, NULL);
+}
+
+/*
+ * Write out the itxs on the chain's commit list as batch zib of a
+ * multi-chain log.  The batch ends with a TX_BATCH record, and the lwb
+ * holding it is issued right away: the batch's waiters are signalled
+ * once that lwb is done, and every batch before it is acknowledged too.
+ */
+static void
+zil_process_batch(zilog_chain_t *zlc, zil_batch_t *zib,
+    zil_commit_waiter_t *zcw, list_t *ilwbs)
+{
+	zilog_t *zilog = zlc->zlc_zilog;
+	spa_t *spa = zilog->zl_spa;
+	uint64_t max_txg = 0;
+	lwb_t *lwb = NULL;
+	itx_t *itx;
+
+	ASSERT(MUTEX_HELD(&zlc->zlc_issuer_lock));
+
+	/*
+	 * Don't dirty the fs by calling zil_create() if there's nothing
+	 * but commit itxs to write out.
+	 */
+	if (zib->zib_end > zib->zib_start) {
+		lwb = list_tail(&zlc->zlc_lwb_list);
+		if (lwb == NULL) {
+			lwb = zil_create(zlc);
+		} else {
+			ASSERT3S(lwb->lwb_state, !=, LWB_STATE_ISSUED);
+			ASSERT3S(lwb->lwb_state, !=, LWB_STATE_DONE);
+		}
+	}
+
+	while ((itx = list_head(&zlc->zlc_itx_commit_list)) != NULL) {
+		lr_t *lrc = &itx->itx_lr;
+		uint64_t txg = lrc->lrc_txg;
+
+		ASSERT3U(txg, !=, 0);
+
+		list_remove(&zlc->zlc_itx_commit_list, itx);
+
+		/*
+		 * A commit itx needs no lwb of its own, as its waiter is
+		 * signalled along with the batch.
+		 */
+		if (lrc->lrc_txtype == TX_COMMIT) {
+			mutex_enter(&zilog->zl_lock);
+			zil_commit_waiter_link_batch(itx->itx_private, zib);
+			itx->itx_private = NULL;
+			mutex_exit(&zilog->zl_lock);
+			list_insert_tail(&zib->zib_itxs, itx);
+			continue;
+		}
+
+		/*
+		 * See zil_process_commit_list() for why itxs whose txg
+		 * has synced are skipped, unless the pool is frozen.
+		 */
+		if (txg <= spa_last_synced_txg(spa) &&
+		    txg <= spa_freeze_txg(spa)) {
+			zil_itx_destroy(itx);
+			continue;
+		}
+
+		zcw->zcw_nitxs++;
+		zcw->zcw_nbytes += lrc->lrc_reclen;
+		if (lrc->lrc_txtype == TX_WRITE &&
+		    itx->itx_wr_state == WR_NEED_COPY)
+			zcw->zcw_nbytes += ((lr_write_t *)lrc)->lr_length;
+
+		max_txg = MAX(max_txg, txg);
+		if (lwb != NULL)
+			lwb = zil_lwb_commit(zilog, itx, lwb, zib, ilwbs);
+		list_insert_tail(&zib->zib_itxs, itx);
+	}
+
+	if (lwb != NULL) {
+		lr_batch_t *lr;
+
+		itx = zil_itx_create(TX_BATCH, sizeof (*lr));
+		lr = (lr_batch_t *)&itx->itx_lr;
+		lr->lr_common.lrc_txg = max_txg;
+		lr->lr_start = zib->zib_start;
+		lr->lr_end = zib->zib_end;
+
+		lwb = zil_lwb_commit(zilog, itx, lwb, zib, ilwbs);
+		list_insert_tail(&zib->zib_itxs, itx);
+		if (lwb != NULL)
+			lwb = zil_lwb_write_issue(zilog, lwb, ilwbs);
+
+		/*
+		 * Size the chain's next block by what its next batch
+		 * writes out, as in zil_commit_waiter_timeout().
+		 */
+		zlc->zlc_cur_used = 0;
+
+		if (lwb == NULL)
+			zil_commit_batch_stall(zilog, zlc, ilwbs);
+	} else if (zib->zib_end > zib->zib_start) {
+		zil_commit_batch_stall(zilog, zlc, ilwbs);
+	}
+
+	mutex_enter(&zilog->zl_lock);
+	zib->zib_placed = B_TRUE;
+	if (zib->zib_end == zib->zib_start)
+		zib->zib_done = B_TRUE;
+	zil_batch_ack(zilog);
+	mutex_exit(&zilog->zl_lock);
+}
+
+/*
+ * This function is responsible for ensuring the passed in commit waiter
+ * (and associated commit itx) is committed to an lwb. If the waiter is
+ * not already committed to an lwb, all itxs in the zilog's queue of
+ * itxs will be processed. The assumption is the passed in waiter's
+ * commit itx will found in the queue just like the other non-commit
+ * itxs, such that when the entire queue is processed, the waiter will
+ * have been committed to an lwb.
+ *
+ * The lwb associated with the passed in waiter is not guaranteed to
+ * have been issued by the time this function completes. If the lwb is
+ * not issued, we rely on future calls to zil_commit_writer() to issue
+ * the lwb, or the timeout mechanism found in zil_commit_waiter().
+ */
+static void
+zil_commit_writer(zilog_t *zilog, zil_commit_waiter_t *zcw)
+{
+	zilog_chain_t *zlc;
+	list_t ilwbs;
+	hrtime_t gathered = 0;
+
+	ASSERT(!MUTEX_HELD(&zilog->zl_lock));
+	ASSERT(spa_writeable(zilog->zl_spa));
+
+	list_create(&ilwbs, sizeof (lwb_t), offsetof(lwb_t, lwb_issue_node));
+	hrtime_t start = gethrtime();
+	zlc = zil_chain_enter(zilog);
+
+	if (zcw->zcw_lwb != NULL || zcw->zcw_batch != NULL || zcw->zcw_done) {
+		/*
+		 * It's possible that, while we were waiting to acquire
+		 * the "zlc_issuer_lock", another thread committed this
+		 * waiter to an lwb (or batch). If that occurs, we bail out
+		 * early, without processing any of the zilog's queue of
+		 * itxs.
+		 *
+		 * On certain workloads and system configurations, the
+		 * "zlc_issuer_lock" can become highly contended. In an
+		 * attempt to reduce this contention, we immediately drop
 		 * the lock if the waiter has already been processed.
 		 *
 		 * We've measured this optimization to reduce CPU spent
@@ -2311,18 +3022,43 @@ zil_commit_writer(zilog_t *zilog, zil_commit_waiter_t *zcw)
 
 	ZIL_STAT_BUMP(zil_commit_writer_count);
 
-	zil_get_commit_list(zilog);
-	zil_prune_commit_list(zilog);
-	zil_process_commit_list(zilog);
+	if (zilog->zl_nchains == 1) {
+		zil_get_commit_list(zilog, zlc);
+		zil_prune_commit_list(zlc);
+		gathered = gethrtime();
+		zcw->zcw_time[ZIL_COMMIT_GATHER] = gathered - start;
+		zil_process_commit_list(zlc, zcw, &ilwbs);
+	} else {
+		zil_batch_t *zib;
+
+		mutex_enter(&zilog->zl_gather_lock);
+		zil_get_commit_list(zilog, zlc);
+		zib = zil_batch_reserve(zilog, zlc);
+		mutex_exit(&zilog->zl_gather_lock);
+		gathered = gethrtime();
+		zcw->zcw_time[ZIL_COMMIT_GATHER] = gathered - start;
+		zil_process_batch(zlc, zib, zcw, &ilwbs);
+	}
 
 out:
-	mutex_exit(&zilog->zl_issuer_lock);
+	mutex_exit(&zlc->zlc_issuer_lock);
+	zil_issue_lwbs(&ilwbs);
+	list_destroy(&ilwbs);
+
+	/*
+	 * The gather and issue times are only those of the thread which
+	 * wrote out the commit list; a commit which was picked up by
+	 * another thread's zil_commit_writer() just waits for it.
+	 */
+	if (gathered != 0)
+		zcw->zcw_time[ZIL_COMMIT_ISSUE] = gethrtime() - gathered;
 }
 
 static void
 zil_commit_waiter_timeout(zilog_t *zilog, zil_commit_waiter_t *zcw)
 {
-	ASSERT(!MUTEX_HELD(&zilog->zl_issuer_lock));
+	list_t ilwbs;
+
 	ASSERT(MUTEX_HELD(&zcw->zcw_lock));
 	ASSERT3B(zcw->zcw_done, ==, B_FALSE);
 
@@ -2330,11 +3066,14 @@ zil_commit_waiter_timeout(zilog_t *zilog, zil_commit_waiter_t *zcw)
 	ASSERT3P(lwb, !=, NULL);
 	ASSERT3S(lwb->lwb_state, !=, LWB_STATE_CLOSED);
 
+	zilog_chain_t *zlc = lwb->lwb_chain;
+	ASSERT(!MUTEX_HELD(&zlc->zlc_issuer_lock));
+
 	/*
 	 * If the lwb has already been issued by another thread, we can
 	 * immediately return since there's no work to be done (the
 	 * point of this function is to issue the lwb). Additionally, we
-	 * do this prior to acquiring the zl_issuer_lock, to avoid
+	 * do this prior to acquiring the zlc_issuer_lock, to avoid
 	 * acquiring it when it's not necessary to do so.
 	 */
 	if (lwb->lwb_state == LWB_STATE_ISSUED ||
@@ -2343,13 +3082,15 @@ zil_commit_waiter_timeout(zilog_t *zilog, zil_commit_waiter_t *zcw)
 
 	/*
 	 * In order to call zil_lwb_write_issue() we must hold the
-	 * zilog's "zl_issuer_lock". We can't simply acquire that lock,
+	 * chain's "zlc_issuer_lock". We can't simply acquire that lock,
 	 * since we're already holding the commit waiter's "zcw_lock",
 	 * and those two locks are acquired in the opposite order
-	 * elsewhere.
+	 * elsewhere.  The chain stays valid as long as the zilog does,
+	 * even if the lwb is freed meanwhile.
 	 */
+	list_create(&ilwbs, sizeof (lwb_t), offsetof(lwb_t, lwb_issue_node));
 	mutex_exit(&zcw->zcw_lock);
-	mutex_enter(&zilog->zl_issuer_lock);
+	mutex_enter(&zlc->zlc_issuer_lock);
 	mutex_enter(&zcw->zcw_lock);
 
 	/*
@@ -2367,11 +3108,11 @@ zil_commit_waiter_timeout(zilog_t *zilog, zil_commit_waiter_t *zcw)
 
 	/*
 	 * We've already checked this above, but since we hadn't acquired
-	 * the zilog's zl_issuer_lock, we have to perform this check a
+	 * the chain's zlc_issuer_lock, we have to perform this check a
 	 * second time while holding the lock.
 	 *
 	 * We don't need to hold the zl_lock since the lwb cannot transition
-	 * from OPENED to ISSUED while we hold the zl_issuer_lock. The lwb
+	 * from OPENED to ISSUED while we hold the zlc_issuer_lock. The lwb
 	 * _can_ transition from ISSUED to DONE, but it's OK to race with
 	 * that transition since we treat the lwb the same, whether it's in
 	 * the ISSUED or DONE states.
@@ -2379,7 +3120,7 @@ zil_commit_waiter_timeout(zilog_t *zilog, zil_commit_waiter_t *zcw)
 	 * The important thing, is we treat the lwb differently depending on
 	 * if it's ISSUED or OPENED, and block any other threads that might
 	 * attempt to issue this lwb. For that reason we hold the
-	 * zl_issuer_lock when checking the lwb_state; we must not call
+	 * zlc_issuer_lock when checking the lwb_state; we must not call
 	 * zil_lwb_write_issue() if the lwb had already been issued.
 	 *
 	 * See the comment above the lwb_state_t structure definition for
@@ -2397,23 +3138,23 @@ zil_commit_waiter_timeout(zilog_t *zilog, zil_commit_waiter_t *zcw)
 	 * since we've reached the commit waiter's timeout and it still
 	 * hasn't been issued.
 	 */
-	lwb_t *nlwb = zil_lwb_write_issue(zilog, lwb);
+	lwb_t *nlwb = zil_lwb_write_issue(zilog, lwb, &ilwbs);
 
 	IMPLY(nlwb != NULL, lwb->lwb_state != LWB_STATE_OPENED);
 
 	/*
 	 * Since the lwb's zio hadn't been issued by the time this thread
-	 * reached its timeout, we reset the zilog's "zl_cur_used" field
+	 * reached its timeout, we reset the chain's "zlc_cur_used" field
 	 * to influence the zil block size selection algorithm.
 	 *
 	 * By having to issue the lwb's zio here, it means the size of the
 	 * lwb was too large, given the incoming throughput of itxs.  By
-	 * setting "zl_cur_used" to zero, we communicate this fact to the
+	 * setting "zlc_cur_used" to zero, we communicate this fact to the
 	 * block size selection algorithm, so it can take this information
 	 * into account, and potentially select a smaller size for the
 	 * next lwb block that is allocated.
 	 */
-	zilog->zl_cur_used = 0;
+	zlc->zlc_cur_used = 0;
 
 	if (nlwb == NULL) {
 		/*
@@ -2439,13 +3180,47 @@ zil_commit_waiter_timeout(zilog_t *zilog, zil_commit_waiter_t *zcw)
 		 *   lock, which occurs prior to calling dmu_tx_commit()
 		 */
 		mutex_exit(&zcw->zcw_lock);
-		zil_commit_writer_stall(zilog);
+		zil_issue_lwbs(&ilwbs);
+		zil_commit_writer_stall(zlc);
 		mutex_enter(&zcw->zcw_lock);
 	}
 
 out:
-	mutex_exit(&zilog->zl_issuer_lock);
+	mutex_exit(&zlc->zlc_issuer_lock);
 	ASSERT(MUTEX_HELD(&zcw->zcw_lock));
+
+	zil_issue_lwbs(&ilwbs);
+	list_destroy(&ilwbs);
+}
+
+/*
+ * Return how long a commit waiter should let its lwb stay open, waiting
+ * for it to fill up, before issuing it.
+ *
+ * Normally this is a small percentage of the latency of an lwb write.
+ * When the commit interval, i.e. the time between calls to zil_commit(),
+ * is shorter than that latency, the next commit will most likely arrive
+ * while this one would still be waiting for its lwb to be written.  Keeping
+ * the lwb open for about one more commit interval then writes both commits
+ * out at once, instead of making the next commit wait for a write of its
+ * own once this one's completes.  This adaptive part of the timeout is
+ * bounded by zfs_commit_coalesce_us, and doesn't apply to a lone committer
+ * since its commit interval is longer than the write latency.
+ */
+static hrtime_t
+zil_commit_timeout(zilog_t *zilog)
+{
+	hrtime_t latency = zilog->zl_last_lwb_latency;
+	hrtime_t interval = zilog->zl_commit_interval;
+	int pct = MAX(zfs_commit_timeout_pct, 1);
+	hrtime_t sleep = (latency * pct) / 100;
+
+	if (interval > 0 && interval < latency) {
+		sleep = MAX(sleep, MIN(interval,
+		    USEC2NSEC(zfs_commit_coalesce_us)));
+	}
+
+	return (sleep);
 }
 
 /*
@@ -2471,19 +3246,18 @@ static void
 zil_commit_waiter(zilog_t *zilog, zil_commit_waiter_t *zcw)
 {
 	ASSERT(!MUTEX_HELD(&zilog->zl_lock));
-	ASSERT(!MUTEX_HELD(&zilog->zl_issuer_lock));
 	ASSERT(spa_writeable(zilog->zl_spa));
 
 	mutex_enter(&zcw->zcw_lock);
 
 	/*
 	 * The timeout is scaled based on the lwb latency to avoid
-	 * significantly impacting the latency of each individual itx.
-	 * For more details, see the comment at the bottom of the
-	 * zil_process_commit_list() function.
+	 * significantly impacting the latency of each individual itx,
+	 * and stretched when more commits are expected to join the lwb;
+	 * see zil_commit_timeout(). For more details, see the comment
+	 * at the bottom of the zil_process_commit_list() function.
 	 */
-	int pct = MAX(zfs_commit_timeout_pct, 1);
-	hrtime_t sleep = (zilog->zl_last_lwb_latency * pct) / 100;
+	hrtime_t sleep = zil_commit_timeout(zilog);
 	hrtime_t wakeup = gethrtime() + sleep;
 	boolean_t timedout = B_FALSE;
 
@@ -2509,6 +3283,10 @@ zil_commit_waiter(zilog_t *zilog, zil_commit_waiter_t *zcw)
 		 * "zcw" variable) to be found in this "in between" state;
 		 * where it's "zcw_lwb" field is NULL, and it hasn't yet
 		 * been skipped, so it's "zcw_done" field is still B_FALSE.
+		 *
+		 * The waiters of a multi-chain log are linked to a batch
+		 * rather than to an lwb, and never need the timeout, as
+		 * the lwb ending a batch is issued right away.
 		 */
 		IMPLY(lwb != NULL, lwb->lwb_state != LWB_STATE_CLOSED);
 
@@ -2576,8 +3354,12 @@ zil_alloc_commit_waiter(void)
 	mutex_init(&zcw->zcw_lock, NULL, MUTEX_DEFAULT, NULL);
 	list_link_init(&zcw->zcw_node);
 	zcw->zcw_lwb = NULL;
+	zcw->zcw_batch = NULL;
 	zcw->zcw_done = B_FALSE;
 	zcw->zcw_zio_error = 0;
+	zcw->zcw_nitxs = 0;
+	zcw->zcw_nbytes = 0;
+	bzero(zcw->zcw_time, sizeof (zcw->zcw_time));
 
 	return (zcw);
 }
@@ -2587,6 +3369,7 @@ zil_free_commit_waiter(zil_commit_waiter_t *zcw)
 {
 	ASSERT(!list_link_active(&zcw->zcw_node));
 	ASSERT3P(zcw->zcw_lwb, ==, NULL);
+	ASSERT3P(zcw->zcw_batch, ==, NULL);
 	ASSERT3B(zcw->zcw_done, ==, B_TRUE);
 	mutex_destroy(&zcw->zcw_lock);
 	cv_destroy(&zcw->zcw_cv);
@@ -2718,9 +3501,10 @@ zil_commit_itx_assign(zilog_t *zilog, zil_commit_waiter_t *zcw)
  *      much of the underlying storage performance as possible, we rely
  *      on two fundamental concepts:
  *
- *          1. The creation and issuance of lwb zio's is protected by
- *             the zilog's "zl_issuer_lock", which ensures only a single
- *             thread is creating and/or issuing lwb's at a time
+ *          1. The creation of lwb zio's is protected by the chain's
+ *             "zlc_issuer_lock", which ensures only a single thread is
+ *             creating lwb's at a time. The zio's are issued once the
+ *             lock has been dropped, see zil_issue_lwbs()
  *          2. The "previous" lwb is a child of the "current" lwb
  *             (leveraging the zio parent-child dependency graph)
  *
@@ -2758,8 +3542,12 @@ zil_commit(zilog_t *zilog, uint64_t foid)
 		 * would break the semantics of zil_commit(); thus, we're
 		 * verifying that truth before we return to the caller.
 		 */
-		ASSERT(list_is_empty(&zilog->zl_lwb_list));
-		ASSERT3P(zilog->zl_last_lwb_opened, ==, NULL);
+		for (int c = 0; c < ZIL_MAX_CHAINS; c++) {
+			ASSERT(list_is_empty(
+			    &zilog->zl_chains[c].zlc_lwb_list));
+			ASSERT3P(zilog->zl_chains[c].zlc_last_lwb_opened, ==,
+			    NULL);
+		}
 		for (int i = 0; i < TXG_SIZE; i++)
 			ASSERT3P(zilog->zl_itxg[i].itxg_itxs, ==, NULL);
 		return;
@@ -2780,11 +3568,58 @@ zil_commit(zilog_t *zilog, uint64_t foid)
 	zil_commit_impl(zilog, foid);
 }
 
+/*
+ * Account the time spent in each stage of a commit, once it's done.
+ */
+static void
+zil_commit_stats_update(zilog_t *zilog, zil_commit_waiter_t *zcw)
+{
+	spa_t *spa = zilog->zl_spa;
+	dataset_kstats_t *dk = zilog->zl_os->os_kstats;
+
+	DTRACE_PROBE2(zil__commit__done,
+	    zilog_t *, zilog, zil_commit_waiter_t *, zcw);
+
+	for (int s = 0; s < ZIL_COMMIT_STAGES; s++) {
+		hrtime_t t = zcw->zcw_time[s];
+
+		if (t > 0)
+			atomic_inc_64(&spa->spa_zil_histo[s][L_HISTO(t)]);
+	}
+
+	/*
+	 * Only the objset's owner commits through zil_commit(), while its
+	 * kstats are attached.  zil_suspend() may commit on behalf of any
+	 * holder, so its commit is not counted.
+	 */
+	if (dk != NULL && !zilog->zl_suspending) {
+		dataset_kstats_update_zil_kstats(dk, zcw->zcw_nitxs,
+		    zcw->zcw_nbytes, zcw->zcw_time);
+	}
+}
+
 void
 zil_commit_impl(zilog_t *zilog, uint64_t foid)
 {
+	hrtime_t start = gethrtime();
+
 	ZIL_STAT_BUMP(zil_commit_count);
 
+	/*
+	 * Keep a moving average of the commit interval, used to size the
+	 * window in which an open lwb waits for more commits to join it;
+	 * see zil_commit_timeout(). It's updated without a lock, like
+	 * zl_last_lwb_latency, since an occasional lost update is harmless.
+	 */
+	hrtime_t last = zilog->zl_last_commit;
+	zilog->zl_last_commit = start;
+	if (last != 0 && start > last) {
+		hrtime_t interval = MIN(start - last, SEC2NSEC(1));
+		zilog->zl_commit_interval = (zilog->zl_commit_interval *
+		    (ZIL_COMMIT_INTERVAL_WEIGHT - 1) + interval) /
+		    ZIL_COMMIT_INTERVAL_WEIGHT;
+	}
+
 	/*
 	 * Move the "async" itxs for the specified foid to the "sync"
 	 * queues, such that they will be later committed (or skipped)
@@ -2815,7 +3650,13 @@ zil_commit_impl(zilog_t *zilog, uint64_t foid)
 	zil_commit_itx_assign(zilog, zcw);
 
 	zil_commit_writer(zilog, zcw);
+	hrtime_t written = gethrtime();
 	zil_commit_waiter(zilog, zcw);
+	hrtime_t now = gethrtime();
+
+	zcw->zcw_time[ZIL_COMMIT_WAIT] = now - written;
+	zcw->zcw_time[ZIL_COMMIT_TOTAL] = now - start;
+	zil_commit_stats_update(zilog, zcw);
 
 	if (zcw->zcw_zio_error != 0) {
 		/*
@@ -2834,6 +3675,47 @@ zil_commit_impl(zilog_t *zilog, uint64_t foid)
 	zil_free_commit_waiter(zcw);
 }
 
+/*
+ * Return the zh_batch_seq of a multi-chain log as of txg: the start of
+ * the first batch that might not be in the pool once txg has synced, so
+ * replay may still need it.  That's the first batch not yet written out
+ * to its chain, or the first with records in an lwb that's either not
+ * yet written or holds records of txgs after txg, unless a stall has
+ * moved the floor past them.
+ */
+static uint64_t
+zil_batch_seq(zilog_t *zilog, uint64_t txg)
+{
+	uint64_t seq = zilog->zl_lr_seq + 1;
+	zil_batch_t *zib;
+
+	ASSERT(MUTEX_HELD(&zilog->zl_lock));
+
+	for (zib = list_head(&zilog->zl_batch_list); zib != NULL;
+	    zib = list_next(&zilog->zl_batch_list, zib)) {
+		if (!zib->zib_placed) {
+			seq = MIN(seq, zib->zib_start);
+			break;
+		}
+	}
+
+	for (int c = 0; c < zilog->zl_nchains; c++) {
+		list_t *lwbs = &zilog->zl_chains[c].zlc_lwb_list;
+		lwb_t *lwb;
+
+		for (lwb = list_head(lwbs); lwb != NULL;
+		    lwb = list_next(lwbs, lwb)) {
+			if (lwb->lwb_batch_start == 0 ||
+			    (lwb->lwb_buf == NULL && lwb->lwb_max_txg <= txg))
+				continue;
+			seq = MIN(seq, lwb->lwb_batch_start);
+			break;
+		}
+	}
+
+	return (MAX(seq, zilog->zl_batch_floor));
+}
+
 /*
  * Called in syncing context to free committed log blocks and update log header.
  */
@@ -2844,6 +3726,9 @@ zil_sync(zilog_t *zilog, dmu_tx_t *tx)
 	uint64_t txg = dmu_tx_get_txg(tx);
 	spa_t *spa = zilog->zl_spa;
 	uint64_t *replayed_seq = &zilog->zl_replayed_seq[txg & TXG_MASK];
+	boolean_t logging = B_FALSE;
+	boolean_t activate = B_FALSE;
+	uint64_t batch_seq = 0;
 	lwb_t *lwb;
 
 	/*
@@ -2858,7 +3743,7 @@ zil_sync(zilog_t *zilog, dmu_tx_t *tx)
 	ASSERT(zilog->zl_stop_sync == 0);
 
 	if (*replayed_seq != 0) {
-		ASSERT(zh->zh_replay_seq < *replayed_seq);
+		ASSERT(zh->zh_replay_seq <= *replayed_seq);
 		zh->zh_replay_seq = *replayed_seq;
 		*replayed_seq = 0;
 	}
@@ -2866,9 +3751,15 @@ zil_sync(zilog_t *zilog, dmu_tx_t *tx)
 	if (zilog->zl_destroy_txg == txg) {
 		blkptr_t blk = zh->zh_log;
 
-		ASSERT(list_head(&zilog->zl_lwb_list) == NULL);
+		for (int c = 0; c < ZIL_MAX_CHAINS; c++)
+			ASSERT(list_is_empty(
+			    &zilog->zl_chains[c].zlc_lwb_list));
 
 		bzero(zh, sizeof (zil_header_t));
+		if (zilog->zl_chain_heads != NULL) {
+			bzero(zilog->zl_chain_heads, sizeof (zil_chain_head_t) *
+			    (ZIL_MAX_CHAINS - 1));
+		}
 		bzero(zilog->zl_replayed_seq, sizeof (zilog->zl_replayed_seq));
 
 		if (zilog->zl_keep_first) {
@@ -2885,37 +3776,95 @@ zil_sync(zilog_t *zilog, dmu_tx_t *tx)
 		}
 	}
 
-	while ((lwb = list_head(&zilog->zl_lwb_list)) != NULL) {
-		zh->zh_log = lwb->lwb_blk;
-		if (lwb->lwb_buf != NULL || lwb->lwb_max_txg > txg)
-			break;
-		list_remove(&zilog->zl_lwb_list, lwb);
-		zio_free(spa, txg, &lwb->lwb_blk);
-		zil_free_lwb(zilog, lwb);
+	if (zilog->zl_nchains > 1)
+		batch_seq = zil_batch_seq(zilog, txg);
+
+	for (int c = 0; c < zilog->zl_nchains; c++) {
+		zilog_chain_t *zlc = &zilog->zl_chains[c];
+		zil_chain_head_t zch;
+
+		if (list_is_empty(&zlc->zlc_lwb_list))
+			continue;
+		logging = B_TRUE;
+
+		zil_chain_head_get(zilog, c, &zch);
+		while ((lwb = list_head(&zlc->zlc_lwb_list)) != NULL) {
+			zch.zch_log = lwb->lwb_blk;
+			if (lwb->lwb_buf != NULL || lwb->lwb_max_txg > txg)
+				break;
+
+			/*
+			 * Replay of a multi-chain log starts from the
+			 * batch at zh_batch_seq, so the records of that
+			 * batch and later ones must stay in the chain.
+			 */
+			if (zilog->zl_nchains > 1 &&
+			    lwb->lwb_batch_start >= batch_seq)
+				break;
+
+			list_remove(&zlc->zlc_lwb_list, lwb);
+			zio_free(spa, txg, &lwb->lwb_blk);
+			zil_free_lwb(zilog, lwb);
+
+			/*
+			 * If we don't have anything left in the lwb list then
+			 * we've had an allocation failure and we need to zero
+			 * out the chain's blkptr so that we don't end
+			 * up freeing the same block twice.
+			 */
+			if (list_head(&zlc->zlc_lwb_list) == NULL)
+				BP_ZERO(&zch.zch_log);
+		}
+		zil_chain_head_set(zilog, c, &zch);
 
 		/*
-		 * If we don't have anything left in the lwb list then
-		 * we've had an allocation failure and we need to zero
-		 * out the zil_header blkptr so that we don't end
-		 * up freeing the same block twice.
+		 * Remove fastwrite on any blocks that have been
+		 * pre-allocated for the next commit. This prevents
+		 * fastwrite counter pollution by unused, long-lived LWBs.
 		 */
-		if (list_head(&zilog->zl_lwb_list) == NULL)
-			BP_ZERO(&zh->zh_log);
+		for (; lwb != NULL; lwb = list_next(&zlc->zlc_lwb_list, lwb)) {
+			if (lwb->lwb_fastwrite && !lwb->lwb_write_zio) {
+				metaslab_fastwrite_unmark(zilog->zl_spa,
+				    &lwb->lwb_blk);
+				lwb->lwb_fastwrite = 0;
+			}
+		}
 	}
 
-	/*
-	 * Remove fastwrite on any blocks that have been pre-allocated for
-	 * the next commit. This prevents fastwrite counter pollution by
-	 * unused, long-lived LWBs.
-	 */
-	for (; lwb != NULL; lwb = list_next(&zilog->zl_lwb_list, lwb)) {
-		if (lwb->lwb_fastwrite && !lwb->lwb_write_zio) {
-			metaslab_fastwrite_unmark(zilog->zl_spa, &lwb->lwb_blk);
-			lwb->lwb_fastwrite = 0;
-		}
+	if (zilog->zl_nchains > 1 &&
+	    (logging || (zh->zh_flags & ZIL_MULTI_CHAIN))) {
+		zh->zh_flags |= ZIL_MULTI_CHAIN;
+		zh->zh_batch_seq = batch_seq;
+		activate = logging;
+
+		/*
+		 * Once replay starts past the batch whose write failed,
+		 * the batches after it no longer need to fail; see
+		 * zil_batch_ack().
+		 */
+		if (zilog->zl_batch_broken != 0 &&
+		    zilog->zl_batch_broken_txg == 0 &&
+		    batch_seq > zilog->zl_batch_broken)
+			zilog->zl_batch_broken_txg = txg;
+	} else if (logging && (zh->zh_flags & ZIL_MULTI_CHAIN)) {
+		/*
+		 * The log is written as a single chain again, after the
+		 * chains of the previous multi-chain log were destroyed.
+		 */
+		zh->zh_flags &= ~ZIL_MULTI_CHAIN;
+		zh->zh_batch_seq = 0;
 	}
 
 	mutex_exit(&zilog->zl_lock);
+
+	if (activate) {
+		dsl_dataset_t *ds = dmu_objset_ds(zilog->zl_os);
+
+		mutex_enter(&ds->ds_lock);
+		ds->ds_feature_activation_needed[SPA_FEATURE_ZIL_CHAINS] =
+		    B_TRUE;
+		mutex_exit(&ds->ds_lock);
+	}
 }
 
 /* ARGSUSED */
@@ -2987,13 +3936,14 @@ zil_set_logbias(zilog_t *zilog, uint64_t logbias)
 }
 
 zilog_t *
-zil_alloc(objset_t *os, zil_header_t *zh_phys)
+zil_alloc(objset_t *os, zil_header_t *zh_phys, zil_chain_head_t *zch_phys)
 {
 	zilog_t *zilog;
 
 	zilog = kmem_zalloc(sizeof (zilog_t), KM_SLEEP);
 
 	zilog->zl_header = zh_phys;
+	zilog->zl_chain_heads = zch_phys;
 	zilog->zl_os = os;
 	zilog->zl_spa = dmu_objset_spa(os);
 	zilog->zl_dmu_pool = dmu_objset_pool(os);
@@ -3001,22 +3951,36 @@ zil_alloc(objset_t *os, zil_header_t *zh_phys)
 	zilog->zl_logbias = dmu_objset_logbias(os);
 	zilog->zl_sync = dmu_objset_syncprop(os);
 	zilog->zl_dirty_max_txg = 0;
-	zilog->zl_last_lwb_opened = NULL;
 	zilog->zl_last_lwb_latency = 0;
+	zilog->zl_last_commit = 0;
+	zilog->zl_commit_interval = 0;
+	zilog->zl_nchains = 1;
 
 	mutex_init(&zilog->zl_lock, NULL, MUTEX_DEFAULT, NULL);
-	mutex_init(&zilog->zl_issuer_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&zilog->zl_gather_lock, NULL, MUTEX_DEFAULT, NULL);
 
 	for (int i = 0; i < TXG_SIZE; i++) {
 		mutex_init(&zilog->zl_itxg[i].itxg_lock, NULL,
 		    MUTEX_DEFAULT, NULL);
 	}
 
-	list_create(&zilog->zl_lwb_list, sizeof (lwb_t),
-	    offsetof(lwb_t, lwb_node));
+	for (int c = 0; c < ZIL_MAX_CHAINS; c++) {
+		zilog_chain_t *zlc = &zilog->zl_chains[c];
+
+		zlc->zlc_zilog = zilog;
+		zlc->zlc_id = c;
+		zlc->zlc_last_lwb_opened = NULL;
+		mutex_init(&zlc->zlc_issuer_lock, NULL, MUTEX_DEFAULT, NULL);
+
+		list_create(&zlc->zlc_lwb_list, sizeof (lwb_t),
+		    offsetof(lwb_t, lwb_node));
+
+		list_create(&zlc->zlc_itx_commit_list, sizeof (itx_t),
+		    offsetof(itx_t, itx_node));
+	}
 
-	list_create(&zilog->zl_itx_commit_list, sizeof (itx_t),
-	    offsetof(itx_t, itx_node));
+	list_create(&zilog->zl_batch_list, sizeof (zil_batch_t),
+	    offsetof(zil_batch_t, zib_node));
 
 	cv_init(&zilog->zl_cv_suspend, NULL, CV_DEFAULT, NULL);
 
@@ -3033,11 +3997,20 @@ zil_free(zilog_t *zilog)
 	ASSERT0(zilog->zl_suspend);
 	ASSERT0(zilog->zl_suspending);
 
-	ASSERT(list_is_empty(&zilog->zl_lwb_list));
-	list_destroy(&zilog->zl_lwb_list);
+	for (int c = 0; c < ZIL_MAX_CHAINS; c++) {
+		zilog_chain_t *zlc = &zilog->zl_chains[c];
+
+		ASSERT(list_is_empty(&zlc->zlc_lwb_list));
+		list_destroy(&zlc->zlc_lwb_list);
+
+		ASSERT(list_is_empty(&zlc->zlc_itx_commit_list));
+		list_destroy(&zlc->zlc_itx_commit_list);
 
-	ASSERT(list_is_empty(&zilog->zl_itx_commit_list));
-	list_destroy(&zilog->zl_itx_commit_list);
+		mutex_destroy(&zlc->zlc_issuer_lock);
+	}
+
+	ASSERT(list_is_empty(&zilog->zl_batch_list));
+	list_destroy(&zilog->zl_batch_list);
 
 	for (i = 0; i < TXG_SIZE; i++) {
 		/*
@@ -3052,7 +4025,7 @@ zil_free(zilog_t *zilog)
 		mutex_destroy(&zilog->zl_itxg[i].itxg_lock);
 	}
 
-	mutex_destroy(&zilog->zl_issuer_lock);
+	mutex_destroy(&zilog->zl_gather_lock);
 	mutex_destroy(&zilog->zl_lock);
 
 	cv_destroy(&zilog->zl_cv_suspend);
@@ -3067,13 +4040,28 @@ zilog_t *
 zil_open(objset_t *os, zil_get_data_t *get_data)
 {
 	zilog_t *zilog = dmu_objset_zil(os);
+	spa_t *spa = zilog->zl_spa;
 
 	ASSERT3P(zilog->zl_get_data, ==, NULL);
-	ASSERT3P(zilog->zl_last_lwb_opened, ==, NULL);
-	ASSERT(list_is_empty(&zilog->zl_lwb_list));
+	for (int c = 0; c < ZIL_MAX_CHAINS; c++) {
+		ASSERT3P(zilog->zl_chains[c].zlc_last_lwb_opened, ==, NULL);
+		ASSERT(list_is_empty(&zilog->zl_chains[c].zlc_lwb_list));
+	}
+	ASSERT(list_is_empty(&zilog->zl_batch_list));
 
 	zilog->zl_get_data = get_data;
 
+	/*
+	 * The number of chains written is fixed while the log is open.
+	 * Chains other than the first need the zil_chains feature, and
+	 * room for their heads in the objset.
+	 */
+	zilog->zl_nchains = 1;
+	if (zil_chains > 1 && zilog->zl_chain_heads != NULL &&
+	    spa_writeable(spa) && !dmu_objset_is_snapshot(os) &&
+	    spa_feature_is_enabled(spa, SPA_FEATURE_ZIL_CHAINS))
+		zilog->zl_nchains = MIN(zil_chains, ZIL_MAX_CHAINS);
+
 	return (zilog);
 }
 
@@ -3089,17 +4077,21 @@ zil_close(zilog_t *zilog)
 	if (!dmu_objset_is_snapshot(zilog->zl_os)) {
 		zil_commit(zilog, 0);
 	} else {
-		ASSERT3P(list_tail(&zilog->zl_lwb_list), ==, NULL);
+		for (int c = 0; c < zilog->zl_nchains; c++) {
+			ASSERT3P(list_tail(&zilog->zl_chains[c].zlc_lwb_list),
+			    ==, NULL);
+		}
 		ASSERT0(zilog->zl_dirty_max_txg);
 		ASSERT3B(zilog_is_dirty(zilog), ==, B_FALSE);
 	}
 
 	mutex_enter(&zilog->zl_lock);
-	lwb = list_tail(&zilog->zl_lwb_list);
-	if (lwb == NULL)
-		txg = zilog->zl_dirty_max_txg;
-	else
-		txg = MAX(zilog->zl_dirty_max_txg, lwb->lwb_max_txg);
+	txg = zilog->zl_dirty_max_txg;
+	for (int c = 0; c < zilog->zl_nchains; c++) {
+		lwb = list_tail(&zilog->zl_chains[c].zlc_lwb_list);
+		if (lwb != NULL)
+			txg = MAX(txg, lwb->lwb_max_txg);
+	}
 	mutex_exit(&zilog->zl_lock);
 
 	/*
@@ -3118,21 +4110,27 @@ zil_close(zilog_t *zilog)
 	zilog->zl_get_data = NULL;
 
 	/*
-	 * We should have only one lwb left on the list; remove it now.
+	 * We should have only one lwb left on each chain; remove it now.
 	 */
 	mutex_enter(&zilog->zl_lock);
-	lwb = list_head(&zilog->zl_lwb_list);
-	if (lwb != NULL) {
-		ASSERT3P(lwb, ==, list_tail(&zilog->zl_lwb_list));
+	for (int c = 0; c < zilog->zl_nchains; c++) {
+		zilog_chain_t *zlc = &zilog->zl_chains[c];
+
+		lwb = list_head(&zlc->zlc_lwb_list);
+		if (lwb == NULL)
+			continue;
+
+		ASSERT3P(lwb, ==, list_tail(&zlc->zlc_lwb_list));
 		ASSERT3S(lwb->lwb_state, !=, LWB_STATE_ISSUED);
 
 		if (lwb->lwb_fastwrite)
 			metaslab_fastwrite_unmark(zilog->zl_spa, &lwb->lwb_blk);
 
-		list_remove(&zilog->zl_lwb_list, lwb);
+		list_remove(&zlc->zlc_lwb_list, lwb);
 		zio_buf_free(lwb->lwb_buf, lwb->lwb_sz);
 		zil_free_lwb(zilog, lwb);
 	}
+	ASSERT(list_is_empty(&zilog->zl_batch_list));
 	mutex_exit(&zilog->zl_lock);
 }
 
@@ -3189,7 +4187,7 @@ zil_suspend(const char *osname, void **cookiep)
 	 * for the suspend because it's already suspended, or there's no ZIL.
 	 */
 	if (cookiep == NULL && !zilog->zl_suspending &&
-	    (zilog->zl_suspend > 0 || BP_IS_HOLE(&zh->zh_log))) {
+	    (zilog->zl_suspend > 0 || zil_log_is_hole(zilog))) {
 		mutex_exit(&zilog->zl_lock);
 		dmu_objset_rele(os, suspend_tag);
 		return (0);
@@ -3222,7 +4220,7 @@ zil_suspend(const char *osname, void **cookiep)
 	 * be active (e.g. filesystem not mounted), so there's nothing
 	 * to clean up.
 	 */
-	if (BP_IS_HOLE(&zh->zh_log)) {
+	if (zil_log_is_hole(zilog)) {
 		ASSERT(cookiep != NULL); /* fast path already handled */
 
 		*cookiep = os;
@@ -3307,20 +4305,52 @@ zil_resume(void *cookie)
 	dsl_dataset_rele(dmu_objset_ds(os), suspend_tag);
 }
 
+/*
+ * Records which modify a single existing object, and whose replay vectors
+ * don't share state through the replay argument, may be replayed
+ * concurrently with records for other objects.  Records for the same
+ * object are hashed to the same single-threaded taskq so they are applied
+ * in log order.  Every other record waits for the taskqs to drain and is
+ * replayed by the parsing thread.  TX_SETATTR and TX_ACL are excluded as
+ * the ZPL stashes their FUID tables in the zfsvfs while replaying them.
+ */
+#define	ZIL_REPLAY_CONCURRENT(txtype) \
+	((txtype) == TX_WRITE || (txtype) == TX_WRITE2 || \
+	(txtype) == TX_TRUNCATE)
+
+/*
+ * Bound on the bytes of log records and data dispatched to the replay
+ * taskqs but not yet replayed.
+ */
+#define	ZIL_REPLAY_MAX_INFLIGHT	(64ULL << 20)
+
 typedef struct zil_replay_arg {
 	zil_replay_func_t **zr_replay;
 	void		*zr_arg;
 	boolean_t	zr_byteswap;
 	char		*zr_lr;
+	zilog_t		*zr_zilog;
+	taskq_t		**zr_taskqs;	/* NULL when replaying serially */
+	int		zr_ntaskqs;
+	kmutex_t	zr_lock;
+	kcondvar_t	zr_cv;
+	uint64_t	zr_inflight;	/* records dispatched, not replayed */
+	uint64_t	zr_inflight_bytes;
+	uint64_t	zr_dispatched_seq; /* last dispatched record */
+	int		zr_error;	/* first error seen by a taskq */
 } zil_replay_arg_t;
 
-static int
-zil_replay_error(zilog_t *zilog, lr_t *lr, int error)
+typedef struct zil_replay_rec {
+	zil_replay_arg_t *zrr_zr;
+	char		*zrr_lr;	/* copy of the record and its data */
+	uint64_t	zrr_size;
+} zil_replay_rec_t;
+
+static void
+zil_replay_warn(zilog_t *zilog, lr_t *lr, int error)
 {
 	char name[ZFS_MAX_DATASET_NAME_LEN];
 
-	zilog->zl_replaying_seq--;	/* didn't actually replay this one */
-
 	dmu_objset_name(zilog->zl_os, name);
 
 	cmn_err(CE_WARN, "ZFS replay transaction error %d, "
@@ -3328,32 +4358,30 @@ zil_replay_error(zilog_t *zilog, lr_t *lr, int error)
 	    (u_longlong_t)lr->lrc_seq,
 	    (u_longlong_t)(lr->lrc_txtype & ~TX_CI),
 	    (lr->lrc_txtype & TX_CI) ? "CI" : "");
-
-	return (error);
 }
 
 static int
-zil_replay_log_record(zilog_t *zilog, lr_t *lr, void *zra, uint64_t claim_txg)
+zil_replay_error(zilog_t *zilog, lr_t *lr, int error)
 {
-	zil_replay_arg_t *zr = zra;
-	const zil_header_t *zh = zilog->zl_header;
-	uint64_t reclen = lr->lrc_reclen;
-	uint64_t txtype = lr->lrc_txtype;
-	int error = 0;
-
-	zilog->zl_replaying_seq = lr->lrc_seq;
-
-	if (lr->lrc_seq <= zh->zh_replay_seq)	/* already replayed */
-		return (0);
+	zilog->zl_replaying_seq--;	/* didn't actually replay this one */
 
-	if (lr->lrc_txg < claim_txg)		/* already committed */
-		return (0);
+	zil_replay_warn(zilog, lr, error);
 
-	/* Strip case-insensitive bit, still present in log record */
-	txtype &= ~TX_CI;
+	return (error);
+}
 
-	if (txtype == 0 || txtype >= TX_MAX_TYPE)
-		return (zil_replay_error(zilog, lr, EINVAL));
+/*
+ * Replay the copy of a log record in buf, which has room for the data
+ * of an indirect TX_WRITE after the record.
+ */
+static int
+zil_replay_apply(zil_replay_arg_t *zr, char *buf)
+{
+	zilog_t *zilog = zr->zr_zilog;
+	lr_t *lr = (lr_t *)buf;
+	uint64_t reclen = lr->lrc_reclen;
+	uint64_t txtype = lr->lrc_txtype & ~TX_CI;
+	int error;
 
 	/*
 	 * If this record type can be logged out of order, the object
@@ -3366,19 +4394,14 @@ zil_replay_log_record(zilog_t *zilog, lr_t *lr, void *zra, uint64_t claim_txg)
 			return (0);
 	}
 
-	/*
-	 * Make a copy of the data so we can revise and extend it.
-	 */
-	bcopy(lr, zr->zr_lr, reclen);
-
 	/*
 	 * If this is a TX_WRITE with a blkptr, suck in the data.
 	 */
 	if (txtype == TX_WRITE && reclen == sizeof (lr_write_t)) {
 		error = zil_read_log_data(zilog, (lr_write_t *)lr,
-		    zr->zr_lr + reclen);
+		    buf + reclen);
 		if (error != 0)
-			return (zil_replay_error(zilog, lr, error));
+			return (error);
 	}
 
 	/*
@@ -3389,7 +4412,7 @@ zil_replay_log_record(zilog_t *zilog, lr_t *lr, void *zra, uint64_t claim_txg)
 	 * the lr was byteswapped, undo it before invoking the replay vector.
 	 */
 	if (zr->zr_byteswap)
-		byteswap_uint64_array(zr->zr_lr, reclen);
+		byteswap_uint64_array(buf, reclen);
 
 	/*
 	 * We must now do two things atomically: replay this log record,
@@ -3397,7 +4420,7 @@ zil_replay_log_record(zilog_t *zilog, lr_t *lr, void *zra, uint64_t claim_txg)
 	 * we did so. At the end of each replay function the sequence number
 	 * is updated if we are in replay mode.
 	 */
-	error = zr->zr_replay[txtype](zr->zr_arg, zr->zr_lr, zr->zr_byteswap);
+	error = zr->zr_replay[txtype](zr->zr_arg, buf, zr->zr_byteswap);
 	if (error != 0) {
 		/*
 		 * The DMU's dnode layer doesn't see removes until the txg
@@ -3407,10 +4430,168 @@ zil_replay_log_record(zilog_t *zilog, lr_t *lr, void *zra, uint64_t claim_txg)
 		 * specify B_FALSE for byteswap now, so we don't do it twice.
 		 */
 		txg_wait_synced(spa_get_dsl(zilog->zl_spa), 0);
-		error = zr->zr_replay[txtype](zr->zr_arg, zr->zr_lr, B_FALSE);
-		if (error != 0)
-			return (zil_replay_error(zilog, lr, error));
+		error = zr->zr_replay[txtype](zr->zr_arg, buf, B_FALSE);
+	}
+
+	return (error);
+}
+
+static void
+zil_replay_task(void *arg)
+{
+	zil_replay_rec_t *zrr = arg;
+	zil_replay_arg_t *zr = zrr->zrr_zr;
+	zilog_t *zilog = zr->zr_zilog;
+	lr_t lr = *(lr_t *)zrr->zrr_lr;
+	int error = 0;
+
+	if (zr->zr_error == 0)
+		error = zil_replay_apply(zr, zrr->zrr_lr);
+	if (error != 0)
+		zil_replay_warn(zilog, &lr, error);
+
+	mutex_enter(&zr->zr_lock);
+	if (zr->zr_error == 0)
+		zr->zr_error = error;
+	zr->zr_inflight_bytes -= zrr->zrr_size;
+
+	/*
+	 * Concurrently replayed records complete out of order, so the
+	 * sequence number recorded with them (zl_replaying_seq) is only
+	 * advanced once every dispatched record has been replayed.  A
+	 * record replayed now may land in a later txg than one that
+	 * records its sequence number, so advancing it any earlier could
+	 * skip the record if we crash during replay.  Until then,
+	 * re-replaying these records is harmless.
+	 */
+	if (--zr->zr_inflight == 0 && zr->zr_error == 0)
+		zilog->zl_replaying_seq = zr->zr_dispatched_seq;
+	cv_broadcast(&zr->zr_cv);
+	mutex_exit(&zr->zr_lock);
+
+	vmem_free(zrr->zrr_lr, zrr->zrr_size);
+	kmem_free(zrr, sizeof (zil_replay_rec_t));
+}
+
+/*
+ * Wait for all dispatched records to be replayed.
+ */
+static int
+zil_replay_drain(zil_replay_arg_t *zr)
+{
+	int error;
+
+	if (zr->zr_taskqs == NULL)
+		return (0);
+
+	mutex_enter(&zr->zr_lock);
+	while (zr->zr_inflight != 0)
+		cv_wait(&zr->zr_cv, &zr->zr_lock);
+	error = zr->zr_error;
+	mutex_exit(&zr->zr_lock);
+
+	return (error);
+}
+
+static int
+zil_replay_dispatch(zil_replay_arg_t *zr, lr_t *lr)
+{
+	uint64_t reclen = lr->lrc_reclen;
+	uint64_t object = LR_FOID_GET_OBJ(((lr_ooo_t *)lr)->lr_foid);
+	uint64_t size = reclen;
+	zil_replay_rec_t *zrr;
+	int error;
+
+	if ((lr->lrc_txtype & ~TX_CI) == TX_WRITE &&
+	    reclen == sizeof (lr_write_t)) {
+		lr_write_t *lrw = (lr_write_t *)lr;
+
+		size += MAX(BP_GET_LSIZE(&lrw->lr_blkptr), lrw->lr_length);
+		zil_prefetch_log_data(zr->zr_zilog, lrw);
 	}
+
+	mutex_enter(&zr->zr_lock);
+	while (zr->zr_error == 0 && zr->zr_inflight != 0 &&
+	    zr->zr_inflight_bytes + size > ZIL_REPLAY_MAX_INFLIGHT)
+		cv_wait(&zr->zr_cv, &zr->zr_lock);
+	error = zr->zr_error;
+	if (error == 0) {
+		zr->zr_inflight++;
+		zr->zr_inflight_bytes += size;
+		zr->zr_dispatched_seq = lr->lrc_seq;
+	}
+	mutex_exit(&zr->zr_lock);
+
+	if (error != 0)
+		return (error);
+
+	zrr = kmem_alloc(sizeof (zil_replay_rec_t), KM_SLEEP);
+	zrr->zrr_zr = zr;
+	zrr->zrr_size = size;
+	zrr->zrr_lr = vmem_alloc(size, KM_SLEEP);
+	bcopy(lr, zrr->zrr_lr, reclen);
+
+	VERIFY3U(taskq_dispatch(zr->zr_taskqs[object % zr->zr_ntaskqs],
+	    zil_replay_task, zrr, TQ_SLEEP), !=, TASKQID_INVALID);
+
+	return (0);
+}
+
+static int
+zil_replay_log_record(zilog_t *zilog, lr_t *lr, void *zra, uint64_t claim_txg)
+{
+	zil_replay_arg_t *zr = zra;
+	const zil_header_t *zh = zilog->zl_header;
+	uint64_t reclen = lr->lrc_reclen;
+	uint64_t txtype = lr->lrc_txtype;
+	int error = 0;
+
+	/*
+	 * A TX_BATCH record only marks the end of a batch, and has nothing
+	 * to replay.  Account for its sequence number without waiting for
+	 * the records dispatched ahead of it.
+	 */
+	if ((txtype & ~TX_CI) == TX_BATCH) {
+		mutex_enter(&zr->zr_lock);
+		if (zr->zr_inflight != 0)
+			zr->zr_dispatched_seq = lr->lrc_seq;
+		else
+			zilog->zl_replaying_seq = lr->lrc_seq;
+		mutex_exit(&zr->zr_lock);
+		return (0);
+	}
+
+	if (zr->zr_taskqs != NULL && ZIL_REPLAY_CONCURRENT(txtype & ~TX_CI) &&
+	    lr->lrc_seq > zh->zh_replay_seq && lr->lrc_txg >= claim_txg)
+		return (zil_replay_dispatch(zr, lr));
+
+	error = zil_replay_drain(zr);
+	if (error != 0)
+		return (error);
+
+	zilog->zl_replaying_seq = lr->lrc_seq;
+
+	if (lr->lrc_seq <= zh->zh_replay_seq)	/* already replayed */
+		return (0);
+
+	if (lr->lrc_txg < claim_txg)		/* already committed */
+		return (0);
+
+	/* Strip case-insensitive bit, still present in log record */
+	txtype &= ~TX_CI;
+
+	if (txtype == 0 || txtype >= TX_MAX_TYPE)
+		return (zil_replay_error(zilog, lr, EINVAL));
+
+	/*
+	 * Make a copy of the data so we can revise and extend it.
+	 */
+	bcopy(lr, zr->zr_lr, reclen);
+
+	error = zil_replay_apply(zr, zr->zr_lr);
+	if (error != 0)
+		return (zil_replay_error(zilog, lr, error));
+
 	return (0);
 }
 
@@ -3423,6 +4604,196 @@ zil_incr_blks(zilog_t *zilog, blkptr_t *bp, void *arg, uint64_t claim_txg)
 	return (0);
 }
 
+/* ARGSUSED */
+static int
+zil_noop_log_block(zilog_t *zilog, blkptr_t *bp, void *arg, uint64_t claim_txg)
+{
+	return (0);
+}
+
+/*
+ * A batch of a multi-chain log, as described by its TX_BATCH record.
+ */
+typedef struct zil_replay_batch {
+	avl_node_t	zrb_node;
+	uint64_t	zrb_start;
+	uint64_t	zrb_end;
+} zil_replay_batch_t;
+
+static int
+zil_replay_batch_compare(const void *x1, const void *x2)
+{
+	const zil_replay_batch_t *zrb1 = x1;
+	const zil_replay_batch_t *zrb2 = x2;
+
+	return (AVL_CMP(zrb1->zrb_start, zrb2->zrb_start));
+}
+
+/* ARGSUSED */
+static int
+zil_replay_batch_add(zilog_t *zilog, lr_t *lr, void *arg, uint64_t claim_txg)
+{
+	avl_tree_t *t = arg;
+	lr_batch_t *lrb = (lr_batch_t *)lr;
+	zil_replay_batch_t *zrb, search;
+	avl_index_t where;
+
+	if ((lr->lrc_txtype & ~TX_CI) != TX_BATCH)
+		return (0);
+
+	search.zrb_start = lrb->lr_start;
+	if (avl_find(t, &search, &where) != NULL)
+		return (0);
+
+	zrb = kmem_alloc(sizeof (zil_replay_batch_t), KM_SLEEP);
+	zrb->zrb_start = lrb->lr_start;
+	zrb->zrb_end = lrb->lr_end;
+	avl_insert(t, zrb, where);
+
+	return (0);
+}
+
+/*
+ * Position in one chain of a multi-chain log being replayed.
+ */
+typedef struct zil_replay_cursor {
+	blkptr_t	zrc_blk;	/* next block to read */
+	uint64_t	zrc_claim_blk_seq;
+	uint64_t	zrc_claim_lr_seq;
+	char		*zrc_buf;	/* records of the current block */
+	char		*zrc_lrp;	/* next record in zrc_buf */
+	char		*zrc_end;
+	boolean_t	zrc_done;
+} zil_replay_cursor_t;
+
+/*
+ * Return the next record of the chain, reading its next block as needed,
+ * or NULL at the end of the chain.
+ */
+static lr_t *
+zil_replay_cursor_peek(zilog_t *zilog, zil_replay_cursor_t *zrc)
+{
+	lr_t *lr;
+
+	while (!zrc->zrc_done && zrc->zrc_lrp == zrc->zrc_end) {
+		blkptr_t next_blk;
+
+		if (BP_IS_HOLE(&zrc->zrc_blk) ||
+		    zrc->zrc_blk.blk_cksum.zc_word[ZIL_ZC_SEQ] >
+		    zrc->zrc_claim_blk_seq ||
+		    zil_read_log_block(zilog, B_TRUE, &zrc->zrc_blk, &next_blk,
+		    zrc->zrc_buf, &zrc->zrc_end) != 0) {
+			zrc->zrc_done = B_TRUE;
+			break;
+		}
+		zilog->zl_replay_blks++;
+		zrc->zrc_lrp = zrc->zrc_buf;
+		zrc->zrc_blk = next_blk;
+
+		if (!BP_IS_HOLE(&next_blk) &&
+		    next_blk.blk_cksum.zc_word[ZIL_ZC_SEQ] <=
+		    zrc->zrc_claim_blk_seq)
+			zil_prefetch_log_block(zilog, B_TRUE, &next_blk);
+	}
+
+	if (zrc->zrc_done)
+		return (NULL);
+
+	lr = (lr_t *)zrc->zrc_lrp;
+	if (lr->lrc_seq > zrc->zrc_claim_lr_seq) {
+		zrc->zrc_done = B_TRUE;
+		return (NULL);
+	}
+
+	return (lr);
+}
+
+/*
+ * Replay a log written as several chains.  The TX_BATCH records found in
+ * a first pass over the chains give the batches that were completely
+ * written; starting at zh_batch_seq, replay runs up to the first batch
+ * that's missing.  The chains are then merged by sequence number, so
+ * the records are replayed in the order they were committed.
+ */
+static void
+zil_replay_chains(zilog_t *zilog, zil_replay_arg_t *zr)
+{
+	const zil_header_t *zh = zilog->zl_header;
+	int nchains = zil_max_chains(zilog);
+	zil_replay_cursor_t *zrcs;
+	zil_replay_batch_t *zrb, search;
+	avl_tree_t batches;
+	void *cookie = NULL;
+	uint64_t start_seq = zh->zh_batch_seq;
+	uint64_t end_seq = start_seq;
+
+	avl_create(&batches, zil_replay_batch_compare,
+	    sizeof (zil_replay_batch_t),
+	    offsetof(zil_replay_batch_t, zrb_node));
+	(void) zil_parse(zilog, zil_noop_log_block, zil_replay_batch_add,
+	    &batches, zh->zh_claim_txg, B_TRUE);
+
+	search.zrb_start = end_seq;
+	while ((zrb = avl_find(&batches, &search, NULL)) != NULL &&
+	    zrb->zrb_end > end_seq) {
+		end_seq = zrb->zrb_end;
+		search.zrb_start = end_seq;
+	}
+
+	while ((zrb = avl_destroy_nodes(&batches, &cookie)) != NULL)
+		kmem_free(zrb, sizeof (zil_replay_batch_t));
+	avl_destroy(&batches);
+
+	zrcs = kmem_zalloc(nchains * sizeof (zil_replay_cursor_t), KM_SLEEP);
+	for (int c = 0; c < nchains; c++) {
+		zil_replay_cursor_t *zrc = &zrcs[c];
+		zil_chain_head_t zch;
+
+		zil_chain_head_get(zilog, c, &zch);
+		zil_chain_claim_limits(zilog, &zch, &zrc->zrc_claim_blk_seq,
+		    &zrc->zrc_claim_lr_seq);
+		zrc->zrc_blk = zch.zch_log;
+		if (BP_IS_HOLE(&zrc->zrc_blk))
+			zrc->zrc_done = B_TRUE;
+		else
+			zrc->zrc_buf = zio_buf_alloc(SPA_OLD_MAXBLOCKSIZE);
+	}
+
+	while (start_seq < end_seq) {
+		zil_replay_cursor_t *min_zrc = NULL;
+		lr_t *min_lr = NULL;
+
+		for (int c = 0; c < nchains; c++) {
+			zil_replay_cursor_t *zrc = &zrcs[c];
+			lr_t *lr;
+
+			while ((lr = zil_replay_cursor_peek(zilog, zrc)) !=
+			    NULL && lr->lrc_seq < start_seq)
+				zrc->zrc_lrp += lr->lrc_reclen;
+
+			if (lr != NULL &&
+			    (min_lr == NULL || lr->lrc_seq < min_lr->lrc_seq)) {
+				min_zrc = zrc;
+				min_lr = lr;
+			}
+		}
+
+		if (min_lr == NULL || min_lr->lrc_seq >= end_seq)
+			break;
+
+		if (zil_replay_log_record(zilog, min_lr, zr,
+		    zh->zh_claim_txg) != 0)
+			break;
+		min_zrc->zrc_lrp += min_lr->lrc_reclen;
+	}
+
+	for (int c = 0; c < nchains; c++) {
+		if (zrcs[c].zrc_buf != NULL)
+			zio_buf_free(zrcs[c].zrc_buf, SPA_OLD_MAXBLOCKSIZE);
+	}
+	kmem_free(zrcs, nchains * sizeof (zil_replay_cursor_t));
+}
+
 /*
  * If this dataset has a non-empty intent log, replay it and destroy it.
  */
@@ -3432,6 +4803,7 @@ zil_replay(objset_t *os, void *arg, zil_replay_func_t *replay_func[TX_MAX_TYPE])
 	zilog_t *zilog = dmu_objset_zil(os);
 	const zil_header_t *zh = zilog->zl_header;
 	zil_replay_arg_t zr;
+	int nthreads;
 
 	if ((zh->zh_flags & ZIL_REPLAY_NEEDED) == 0) {
 		zil_destroy(zilog, B_TRUE);
@@ -3440,8 +4812,37 @@ zil_replay(objset_t *os, void *arg, zil_replay_func_t *replay_func[TX_MAX_TYPE])
 
 	zr.zr_replay = replay_func;
 	zr.zr_arg = arg;
-	zr.zr_byteswap = BP_SHOULD_BYTESWAP(&zh->zh_log);
+	zr.zr_byteswap = B_FALSE;
+	for (int c = 0; c < zil_max_chains(zilog); c++) {
+		zil_chain_head_t zch;
+
+		zil_chain_head_get(zilog, c, &zch);
+		if (!BP_IS_HOLE(&zch.zch_log)) {
+			zr.zr_byteswap = BP_SHOULD_BYTESWAP(&zch.zch_log);
+			break;
+		}
+	}
 	zr.zr_lr = vmem_alloc(2 * SPA_MAXBLOCKSIZE, KM_SLEEP);
+	zr.zr_zilog = zilog;
+	zr.zr_taskqs = NULL;
+	zr.zr_ntaskqs = 0;
+	zr.zr_inflight = 0;
+	zr.zr_inflight_bytes = 0;
+	zr.zr_dispatched_seq = 0;
+	zr.zr_error = 0;
+	mutex_init(&zr.zr_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&zr.zr_cv, NULL, CV_DEFAULT, NULL);
+
+	nthreads = zil_replay_threads > 0 ? zil_replay_threads : boot_ncpus;
+	if (nthreads > 1) {
+		zr.zr_ntaskqs = nthreads;
+		zr.zr_taskqs = kmem_alloc(nthreads * sizeof (taskq_t *),
+		    KM_SLEEP);
+		for (int i = 0; i < nthreads; i++) {
+			zr.zr_taskqs[i] = taskq_create("zil_replay", 1,
+			    defclsyspri, 1, INT_MAX, TASKQ_PREPOPULATE);
+		}
+	}
 
 	/*
 	 * Wait for in-progress removes to sync before starting replay.
@@ -3451,10 +4852,23 @@ zil_replay(objset_t *os, void *arg, zil_replay_func_t *replay_func[TX_MAX_TYPE])
 	zilog->zl_replay = B_TRUE;
 	zilog->zl_replay_time = ddi_get_lbolt();
 	ASSERT(zilog->zl_replay_blks == 0);
-	(void) zil_parse(zilog, zil_incr_blks, zil_replay_log_record, &zr,
-	    zh->zh_claim_txg, B_TRUE);
+	if (zh->zh_flags & ZIL_MULTI_CHAIN) {
+		zil_replay_chains(zilog, &zr);
+	} else {
+		(void) zil_parse(zilog, zil_incr_blks, zil_replay_log_record,
+		    &zr, zh->zh_claim_txg, B_TRUE);
+	}
+	(void) zil_replay_drain(&zr);
 	vmem_free(zr.zr_lr, 2 * SPA_MAXBLOCKSIZE);
 
+	if (zr.zr_taskqs != NULL) {
+		for (int i = 0; i < zr.zr_ntaskqs; i++)
+			taskq_destroy(zr.zr_taskqs[i]);
+		kmem_free(zr.zr_taskqs, zr.zr_ntaskqs * sizeof (taskq_t *));
+	}
+	cv_destroy(&zr.zr_cv);
+	mutex_destroy(&zr.zr_lock);
+
 	zil_destroy(zilog, B_FALSE);
 	txg_wait_synced(zilog->zl_dmu_pool, zilog->zl_destroy_txg);
 	zilog->zl_replay = B_FALSE;
@@ -3519,9 +4933,20 @@ EXPORT_SYMBOL(zil_set_logbias);
 module_param(zfs_commit_timeout_pct, int, 0644);
 MODULE_PARM_DESC(zfs_commit_timeout_pct, "ZIL block open timeout percentage");
 
+module_param(zfs_commit_coalesce_us, ulong, 0644);
+MODULE_PARM_DESC(zfs_commit_coalesce_us,
+	"Max time ZIL block held open for expected commits");
+
+module_param(zil_chains, int, 0644);
+MODULE_PARM_DESC(zil_chains, "Number of log chains written per dataset");
+
 module_param(zil_replay_disable, int, 0644);
 MODULE_PARM_DESC(zil_replay_disable, "Disable intent logging replay");
 
+module_param(zil_replay_threads, int, 0644);
+MODULE_PARM_DESC(zil_replay_threads,
+	"Threads replaying log records concurrently (0 = one per CPU)");
+
 module_param(zfs_nocacheflush, int, 0644);
 MODULE_PARM_DESC(zfs_nocacheflush, "Disable cache flushes");
 
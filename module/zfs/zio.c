@@ -47,6 +47,7 @@
 #include <sys/abd.h>
 #include <sys/dsl_crypt.h>
 #include <sys/cityhash.h>
+#include <sys/dataset_kstats.h>
 
 /*
  * ==========================================================================
@@ -58,7 +59,7 @@ const char *zio_type_name[ZIO_TYPES] = {
 	 * Note: Linux kernel thread name length is limited
 	 * so these names will differ from upstream open zfs.
 	 */
-	"z_null", "z_rd", "z_wr", "z_fr", "z_cl", "z_ioctl"
+	"z_null", "z_rd", "z_wr", "z_fr", "z_cl", "z_ioctl", "z_trim"
 };
 
 int zio_dva_throttle_enabled = B_TRUE;
@@ -106,6 +107,12 @@ int zfs_sync_pass_rewrite = 2; /* rewrite new bps starting in this pass */
 
 int zio_requeue_io_start_cut_in_line = 1;
 
+/*
+ * Gather asynchronous writes in the issue taskq so their checksums can be
+ * generated several blocks at a time by checksums which support it.
+ */
+int zio_checksum_batch_enabled = 1;
+
 #ifdef ZFS_DEBUG
 int zio_buf_debug_limit = 16384;
 #else
@@ -201,6 +208,7 @@ zio_init(void)
 	zio_inject_init();
 
 	lz4_init();
+	zstd_init();
 }
 
 void
@@ -245,6 +253,7 @@ zio_fini(void)
 	zio_inject_fini();
 
 	lz4_fini();
+	zstd_fini();
 }
 
 /*
@@ -1209,6 +1218,31 @@ zio_ioctl(zio_t *pio, spa_t *spa, vdev_t *vd, int cmd,
 	return (zio);
 }
 
+/*
+ * Discard the given physical range of a leaf vdev.  The offset is relative
+ * to the start of the device and must not overlap the vdev labels.
+ */
+zio_t *
+zio_trim(zio_t *pio, vdev_t *vd, uint64_t offset, uint64_t size,
+    zio_done_func_t *done, void *private, zio_priority_t priority,
+    enum zio_flag flags)
+{
+	zio_t *zio;
+
+	ASSERT(vd->vdev_ops->vdev_op_leaf);
+	ASSERT3U(offset, >=, VDEV_LABEL_START_SIZE);
+	ASSERT3U(offset + size, <=, vd->vdev_psize - VDEV_LABEL_END_SIZE);
+	ASSERT0(P2PHASE(offset, SPA_MINBLOCKSIZE));
+	ASSERT0(P2PHASE(size, SPA_MINBLOCKSIZE));
+
+	zio = zio_create(pio, vd->vdev_spa, 0, NULL, NULL, size, size, done,
+	    private, ZIO_TYPE_TRIM, priority, flags | ZIO_FLAG_PHYSICAL |
+	    ZIO_FLAG_DONT_AGGREGATE | ZIO_FLAG_DONT_CACHE, vd, offset, NULL,
+	    ZIO_STAGE_OPEN, ZIO_TRIM_PIPELINE);
+
+	return (zio);
+}
+
 zio_t *
 zio_read_phys(zio_t *pio, vdev_t *vd, uint64_t offset, uint64_t size,
     abd_t *data, int checksum, zio_done_func_t *done, void *private,
@@ -1360,6 +1394,37 @@ zio_vdev_delegated_io(vdev_t *vd, uint64_t offset, abd_t *data, uint64_t size,
 	return (zio);
 }
 
+/*
+ * Create a read of part of pio's block from the leaf vdev vd which, unlike
+ * zio_vdev_child_io(), is not a child of pio.  pio may therefore complete
+ * while the read is still outstanding, which is how hedged reads are able
+ * to ignore a slow device.  Everything needed from pio is copied when the
+ * read is created, and the read never verifies a checksum or posts a
+ * checksum ereport on its own since that requires the logical I/O.  The
+ * caller must keep the vdev from going away until the read is done, and
+ * do any checksum verification of bp in the done callback.
+ */
+zio_t *
+zio_vdev_detached_io(zio_t *pio, blkptr_t *bp, vdev_t *vd, uint64_t offset,
+    abd_t *data, uint64_t size, zio_done_func_t *done, void *private)
+{
+	zio_t *zio;
+
+	ASSERT(vd->vdev_ops->vdev_op_leaf);
+	ASSERT3U(pio->io_type, ==, ZIO_TYPE_READ);
+	ASSERT3U(size, !=, 0);
+	ASSERT(done != NULL);
+
+	zio = zio_create(NULL, pio->io_spa, pio->io_txg, bp, data, size, size,
+	    done, private, ZIO_TYPE_READ, pio->io_priority,
+	    ZIO_VDEV_CHILD_FLAGS(pio), vd, offset + VDEV_LABEL_START_SIZE,
+	    &pio->io_bookmark, ZIO_STAGE_VDEV_IO_START >> 1,
+	    ZIO_VDEV_CHILD_PIPELINE);
+	ASSERT3U(zio->io_child_type, ==, ZIO_CHILD_VDEV);
+
+	return (zio);
+}
+
 void
 zio_flush(zio_t *zio, vdev_t *vd)
 {
@@ -1564,8 +1629,14 @@ zio_write_compress(zio_t *zio)
 	/* If it's a compressed write that is not raw, compress the buffer. */
 	if (compress != ZIO_COMPRESS_OFF &&
 	    !(zio->io_flags & ZIO_FLAG_RAW_COMPRESS)) {
+		zio_compress_abort_t za;
 		void *cbuf = zio_buf_alloc(lsize);
-		psize = zio_compress_data(compress, zio->io_abd, cbuf, lsize);
+		psize = zio_compress_data_early_abort(compress, zio->io_abd,
+		    cbuf, lsize, &za);
+		if (za.za_aborted && zp->zp_kstats != NULL) {
+			dataset_kstats_update_compress_kstats(zp->zp_kstats,
+			    lsize, za.za_saved);
+		}
 		if (psize == 0 || psize == lsize) {
 			compress = ZIO_COMPRESS_OFF;
 			zio_buf_free(cbuf, lsize);
@@ -2404,6 +2475,7 @@ static zio_gang_issue_func_t *zio_gang_issue_func[ZIO_TYPES] = {
 	zio_rewrite_gang,
 	zio_free_gang,
 	zio_claim_gang,
+	NULL,
 	NULL
 };
 
@@ -2717,6 +2789,7 @@ zio_write_gang_block(zio_t *pio)
 		bzero(zp.zp_salt, ZIO_DATA_SALT_LEN);
 		bzero(zp.zp_iv, ZIO_DATA_IV_LEN);
 		bzero(zp.zp_mac, ZIO_DATA_MAC_LEN);
+		zp.zp_kstats = NULL;
 
 		zio_t *cio = zio_write(zio, spa, txg, &gbh->zg_blkptr[g],
 		    abd_get_offset(pio->io_abd, pio->io_size - resid), lsize,
@@ -3674,7 +3747,8 @@ zio_vdev_io_start(zio_t *zio)
 	}
 
 	if (vd->vdev_ops->vdev_op_leaf &&
-	    (zio->io_type == ZIO_TYPE_READ || zio->io_type == ZIO_TYPE_WRITE)) {
+	    (zio->io_type == ZIO_TYPE_READ || zio->io_type == ZIO_TYPE_WRITE ||
+	    zio->io_type == ZIO_TYPE_TRIM)) {
 
 		if (zio->io_type == ZIO_TYPE_READ && vdev_cache_read(zio))
 			return (zio);
@@ -3705,7 +3779,8 @@ zio_vdev_io_done(zio_t *zio)
 		return (NULL);
 	}
 
-	ASSERT(zio->io_type == ZIO_TYPE_READ || zio->io_type == ZIO_TYPE_WRITE);
+	ASSERT(zio->io_type == ZIO_TYPE_READ ||
+	    zio->io_type == ZIO_TYPE_WRITE || zio->io_type == ZIO_TYPE_TRIM);
 
 	if (zio->io_delay)
 		zio->io_delay = gethrtime() - zio->io_delay;
@@ -3724,10 +3799,14 @@ zio_vdev_io_done(zio_t *zio)
 		if (zio_injection_enabled && zio->io_error == 0)
 			zio->io_error = zio_handle_label_injection(zio, EIO);
 
+		/*
+		 * A failed trim is harmless, the data in the range was
+		 * already free, so there is no reason to probe the device.
+		 */
 		if (zio->io_error) {
 			if (!vdev_accessible(vd, zio)) {
 				zio->io_error = SET_ERROR(ENXIO);
-			} else {
+			} else if (zio->io_type != ZIO_TYPE_TRIM) {
 				unexpected_error = B_TRUE;
 			}
 		}
@@ -3862,6 +3941,14 @@ zio_vdev_io_assess(zio_t *zio)
 	    zio->io_cmd == DKIOCFLUSHWRITECACHE && vd != NULL)
 		vd->vdev_nowritecache = B_TRUE;
 
+	/*
+	 * Likewise, a device which rejects a discard is not going to accept
+	 * one later, so stop issuing trims to it.
+	 */
+	if (zio->io_error == ENOTSUP &&
+	    zio->io_type == ZIO_TYPE_TRIM && vd != NULL)
+		vd->vdev_has_trim = B_FALSE;
+
 	if (zio->io_error)
 		zio->io_pipeline = ZIO_INTERLOCK_PIPELINE;
 
@@ -4065,11 +4152,107 @@ zio_encrypt(zio_t *zio)
  * Generate and verify checksums
  * ==========================================================================
  */
+/*
+ * Checksum whatever writes have been gathered in the batch and send them
+ * on down the pipeline.
+ */
+static void
+zio_checksum_batch_flush(void *arg)
+{
+	spa_cksum_batch_t *scb = arg;
+	zio_t *zios[ZIO_CHECKSUM_MANY_MAX];
+	int n;
+
+	mutex_enter(&scb->scb_lock);
+	scb->scb_flush_pending = B_FALSE;
+	n = scb->scb_count;
+	bcopy(scb->scb_zios, zios, n * sizeof (zio_t *));
+	scb->scb_count = 0;
+	mutex_exit(&scb->scb_lock);
+
+	if (n == 0)
+		return;
+
+	if (n == 1) {
+		zio_checksum_compute(zios[0], scb->scb_checksum,
+		    zios[0]->io_abd, zios[0]->io_size);
+	} else {
+		zio_checksum_compute_many(zios, n, scb->scb_checksum);
+	}
+
+	for (int i = 0; i < n - 1; i++)
+		zio_taskq_dispatch(zios[i], ZIO_TASKQ_ISSUE, B_TRUE);
+	zio_execute(zios[n - 1]);
+}
+
+/*
+ * Returns how many blocks to gather before generating the checksum of
+ * this write, or 1 if it should not be batched.  Only asynchronous writes
+ * running in the issue taskq are, so that the flush task dispatched to the
+ * same taskq always gets to them.
+ */
+static int
+zio_checksum_batch_degree(zio_t *zio, enum zio_checksum checksum)
+{
+	zio_checksum_info_t *ci = &zio_checksum_table[checksum];
+
+	if (!zio_checksum_batch_enabled || ci->ci_func_many == NULL ||
+	    zio->io_type != ZIO_TYPE_WRITE ||
+	    zio->io_priority != ZIO_PRIORITY_ASYNC_WRITE ||
+	    (zio->io_flags & (ZIO_FLAG_CONFIG_WRITER | ZIO_FLAG_PROBE)) ||
+	    !zio_taskq_member(zio, ZIO_TASKQ_ISSUE))
+		return (1);
+
+	return (MIN(ci->ci_degree(zio->io_size), ZIO_CHECKSUM_MANY_MAX));
+}
+
+/*
+ * Writes whose checksum can process several blocks at the cost of one are
+ * set aside until enough of them have arrived to fill the checksum's
+ * lanes.  The write that completes a batch checksums all of them and
+ * carries on, requeueing the others; a partial batch is flushed once the
+ * taskq runs out of other writes to gather.  Returns the zio to continue
+ * with, or NULL if it was set aside.
+ */
+static zio_t *
+zio_checksum_batch(zio_t *zio, enum zio_checksum checksum, int degree)
+{
+	spa_t *spa = zio->io_spa;
+	spa_cksum_batch_t *scb = &spa->spa_cksum_batch[checksum];
+	zio_t *zios[ZIO_CHECKSUM_MANY_MAX];
+	int n;
+
+	mutex_enter(&scb->scb_lock);
+	scb->scb_zios[scb->scb_count++] = zio;
+	if (scb->scb_count < degree) {
+		if (!scb->scb_flush_pending) {
+			scb->scb_flush_pending = B_TRUE;
+			spa_taskq_dispatch_ent(spa, ZIO_TYPE_WRITE,
+			    ZIO_TASKQ_ISSUE, zio_checksum_batch_flush, scb, 0,
+			    &scb->scb_flush_ent);
+		}
+		mutex_exit(&scb->scb_lock);
+		return (NULL);
+	}
+	n = scb->scb_count;
+	bcopy(scb->scb_zios, zios, n * sizeof (zio_t *));
+	scb->scb_count = 0;
+	mutex_exit(&scb->scb_lock);
+
+	zio_checksum_compute_many(zios, n, checksum);
+
+	for (int i = 0; i < n - 1; i++)
+		zio_taskq_dispatch(zios[i], ZIO_TASKQ_ISSUE, B_TRUE);
+
+	return (zio);
+}
+
 static zio_t *
 zio_checksum_generate(zio_t *zio)
 {
 	blkptr_t *bp = zio->io_bp;
 	enum zio_checksum checksum;
+	int degree;
 
 	if (bp == NULL) {
 		/*
@@ -4088,6 +4271,10 @@ zio_checksum_generate(zio_t *zio)
 			checksum = ZIO_CHECKSUM_GANG_HEADER;
 		} else {
 			checksum = BP_GET_CHECKSUM(bp);
+			degree = zio_checksum_batch_degree(zio, checksum);
+			if (degree > 1)
+				return (zio_checksum_batch(zio, checksum,
+				    degree));
 		}
 	}
 
@@ -4297,6 +4484,11 @@ zio_dva_throttle_done(zio_t *zio)
 	    pio->io_allocator, B_TRUE);
 	mutex_exit(&pio->io_lock);
 
+	if (zio->io_error == 0) {
+		metaslab_group_perf_sample(vd->vdev_mg, zio->io_size,
+		    zio->io_queued_timestamp);
+	}
+
 	metaslab_class_throttle_unreserve(zio->io_metaslab_class, 1,
 	    pio->io_allocator, pio);
 
@@ -4434,10 +4626,11 @@ zio_done(zio_t *zio)
 		 * If this I/O is attached to a particular vdev,
 		 * generate an error message describing the I/O failure
 		 * at the block level.  We ignore these errors if the
-		 * device is currently unavailable.
+		 * device is currently unavailable, and for trims which
+		 * never affect the data stored on the device.
 		 */
 		if (zio->io_error != ECKSUM && zio->io_vd != NULL &&
-		    !vdev_is_dead(zio->io_vd))
+		    zio->io_type != ZIO_TYPE_TRIM && !vdev_is_dead(zio->io_vd))
 			zfs_ereport_post(FM_EREPORT_ZFS_IO, zio->io_spa,
 			    zio->io_vd, &zio->io_bookmark, zio, 0, 0);
 
@@ -4821,6 +5014,10 @@ MODULE_PARM_DESC(zio_delay_max, "Max zio millisec delay before posting event");
 module_param(zio_requeue_io_start_cut_in_line, int, 0644);
 MODULE_PARM_DESC(zio_requeue_io_start_cut_in_line, "Prioritize requeued I/O");
 
+module_param(zio_checksum_batch_enabled, int, 0644);
+MODULE_PARM_DESC(zio_checksum_batch_enabled,
+	"Generate checksums of several writes at once");
+
 module_param(zfs_sync_pass_deferred_free, int, 0644);
 MODULE_PARM_DESC(zfs_sync_pass_deferred_free,
 	"Defer frees starting in this pass");
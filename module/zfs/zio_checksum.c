@@ -179,7 +179,8 @@ zio_checksum_info_t zio_checksum_table[ZIO_CHECKSUM_FUNCTIONS] = {
 	    NULL, NULL, ZCHECKSUM_FLAG_METADATA, "fletcher4"},
 	{{abd_checksum_SHA256,		abd_checksum_SHA256},
 	    NULL, NULL, ZCHECKSUM_FLAG_METADATA | ZCHECKSUM_FLAG_DEDUP |
-	    ZCHECKSUM_FLAG_NOPWRITE, "sha256"},
+	    ZCHECKSUM_FLAG_NOPWRITE, "sha256",
+	    abd_checksum_SHA256_many, abd_checksum_SHA256_degree},
 	{{abd_fletcher_4_native,	abd_fletcher_4_byteswap},
 	    NULL, NULL, ZCHECKSUM_FLAG_EMBEDDED, "zilog2"},
 	{{abd_checksum_off,		abd_checksum_off},
@@ -195,6 +196,10 @@ zio_checksum_info_t zio_checksum_table[ZIO_CHECKSUM_FUNCTIONS] = {
 	    abd_checksum_edonr_tmpl_init, abd_checksum_edonr_tmpl_free,
 	    ZCHECKSUM_FLAG_METADATA | ZCHECKSUM_FLAG_SALTED |
 	    ZCHECKSUM_FLAG_NOPWRITE, "edonr"},
+	{{abd_checksum_blake3_native,	abd_checksum_blake3_byteswap},
+	    abd_checksum_blake3_tmpl_init, abd_checksum_blake3_tmpl_free,
+	    ZCHECKSUM_FLAG_METADATA | ZCHECKSUM_FLAG_DEDUP |
+	    ZCHECKSUM_FLAG_SALTED | ZCHECKSUM_FLAG_NOPWRITE, "blake3"},
 };
 
 /*
@@ -213,6 +218,8 @@ zio_checksum_to_feature(enum zio_checksum cksum)
 		return (SPA_FEATURE_SKEIN);
 	case ZIO_CHECKSUM_EDONR:
 		return (SPA_FEATURE_EDONR);
+	case ZIO_CHECKSUM_BLAKE3:
+		return (SPA_FEATURE_BLAKE3);
 	default:
 		return (SPA_FEATURE_NONE);
 	}
@@ -402,6 +409,47 @@ zio_checksum_compute(zio_t *zio, enum zio_checksum checksum,
 	}
 }
 
+/*
+ * Generate the checksums of several non-gang, non-embedded blocks at
+ * once.  This is equivalent to calling zio_checksum_compute() on each zio,
+ * but lets a checksum with a ci_func_many hash the blocks in parallel.
+ */
+void
+zio_checksum_compute_many(zio_t **zios, int n, enum zio_checksum checksum)
+{
+	zio_checksum_info_t *ci = &zio_checksum_table[checksum];
+	spa_t *spa = zios[0]->io_spa;
+	boolean_t insecure = (ci->ci_flags & ZCHECKSUM_FLAG_DEDUP) == 0;
+	abd_t *abds[ZIO_CHECKSUM_MANY_MAX];
+	uint64_t sizes[ZIO_CHECKSUM_MANY_MAX];
+	zio_cksum_t cksums[ZIO_CHECKSUM_MANY_MAX];
+	int i;
+
+	ASSERT3S(n, <=, ZIO_CHECKSUM_MANY_MAX);
+	ASSERT(ci->ci_func_many != NULL);
+	ASSERT0(ci->ci_flags & ZCHECKSUM_FLAG_EMBEDDED);
+
+	zio_checksum_template_init(checksum, spa);
+
+	for (i = 0; i < n; i++) {
+		ASSERT3P(zios[i]->io_spa, ==, spa);
+		abds[i] = zios[i]->io_abd;
+		sizes[i] = zios[i]->io_size;
+	}
+
+	ci->ci_func_many(abds, sizes, n, spa->spa_cksum_tmpls[checksum],
+	    cksums);
+
+	for (i = 0; i < n; i++) {
+		blkptr_t *bp = zios[i]->io_bp;
+		zio_cksum_t saved = bp->blk_cksum;
+
+		if (BP_USES_CRYPT(bp) && BP_GET_TYPE(bp) != DMU_OT_OBJSET)
+			zio_checksum_handle_crypt(&cksums[i], &saved, insecure);
+		bp->blk_cksum = cksums[i];
+	}
+}
+
 int
 zio_checksum_error_impl(spa_t *spa, const blkptr_t *bp,
     enum zio_checksum checksum, abd_t *abd, uint64_t size, uint64_t offset,
@@ -43,6 +43,15 @@
  */
 unsigned long zio_decompress_fail_fraction = 0;
 
+/*
+ * Before running an expensive compression function (gzip, zstd-3 and up)
+ * on a block of at least zio_compress_early_abort_min_size bytes, check
+ * with lz4 and zstd-1 that the block is compressible at all, and write it
+ * uncompressed if it is not.
+ */
+int zio_compress_early_abort = 1;
+unsigned long zio_compress_early_abort_min_size = SPA_OLD_MAXBLOCKSIZE;
+
 /*
  * Compression vectors.
  */
@@ -62,9 +71,52 @@ zio_compress_info_t zio_compress_table[ZIO_COMPRESS_FUNCTIONS] = {
 	{"gzip-8",		8,	gzip_compress,	gzip_decompress},
 	{"gzip-9",		9,	gzip_compress,	gzip_decompress},
 	{"zle",			64,	zle_compress,	zle_decompress},
-	{"lz4",			0,	lz4_compress_zfs, lz4_decompress_zfs}
+	{"lz4",			0,	lz4_compress_zfs, lz4_decompress_zfs},
+	{"zstd-1",		1,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-2",		2,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-3",		3,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-4",		4,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-5",		5,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-6",		6,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-7",		7,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-8",		8,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-9",		9,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-10",		10,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-11",		11,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-12",		12,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-13",		13,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-14",		14,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-15",		15,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-16",		16,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-17",		17,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-18",		18,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-19",		19,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-fast-1",		-1,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-fast-2",		-2,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-fast-3",		-3,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-fast-4",		-4,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-fast-5",		-5,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-fast-6",		-6,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-fast-7",		-7,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-fast-8",		-8,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-fast-9",		-9,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-fast-10",	-10,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-fast-20",	-20,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-fast-50",	-50,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-fast-100",	-100,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-fast-500",	-500,	zfs_zstd_compress, zfs_zstd_decompress},
+	{"zstd-fast-1000",	-1000,	zfs_zstd_compress, zfs_zstd_decompress}
 };
 
+spa_feature_t
+zio_compress_to_feature(enum zio_compress comp)
+{
+	if (ZIO_COMPRESS_IS_ZSTD(comp))
+		return (SPA_FEATURE_ZSTD_COMPRESS);
+
+	return (SPA_FEATURE_NONE);
+}
+
 enum zio_compress
 zio_compress_select(spa_t *spa, enum zio_compress child,
     enum zio_compress parent)
@@ -101,10 +153,70 @@ zio_compress_zeroed_cb(void *data, size_t len, void *private)
 	return (0);
 }
 
-size_t
-zio_compress_data(enum zio_compress c, abd_t *src, void *dst, size_t s_len)
+/*
+ * Running estimate of what each compression function costs, in nanoseconds
+ * per KiB of input.  Updated without locking; a lost update only makes the
+ * estimate a little staler.
+ */
+static uint64_t zio_compress_cost[ZIO_COMPRESS_FUNCTIONS];
+
+static void
+zio_compress_cost_update(enum zio_compress c, hrtime_t delta, size_t s_len)
+{
+	uint64_t sample = (uint64_t)delta * 1024 / s_len;
+	uint64_t cost = zio_compress_cost[c];
+
+	if (cost == 0)
+		zio_compress_cost[c] = sample;
+	else
+		zio_compress_cost[c] = cost - (cost >> 3) + (sample >> 3);
+}
+
+/*
+ * Only the slow compressors are worth probing ahead of time: for gzip and
+ * the stronger zstd levels a failed attempt on incompressible data costs
+ * many times more than a pass of lz4.
+ */
+static boolean_t
+zio_compress_is_expensive(enum zio_compress c)
+{
+	return ((c >= ZIO_COMPRESS_GZIP_1 && c <= ZIO_COMPRESS_GZIP_9) ||
+	    (c >= ZIO_COMPRESS_ZSTD_3 && c <= ZIO_COMPRESS_ZSTD_19));
+}
+
+/*
+ * Size of the sample of a block given a second look by zstd-1.
+ */
+#define	ZIO_COMPRESS_PROBE_SAMPLE	(16 * 1024)
+
+/*
+ * Returns B_TRUE if a cheap compressor can reach the required ratio on
+ * this block.  lz4 gives up quickly on incompressible input, but it misses
+ * some data which the entropy coders handle well, so zstd-1 gets a second
+ * look before the block is written out uncompressed.  A full zstd-1 pass
+ * would cost much of what the probe is meant to save, so it only looks at
+ * a sample from the middle of the block.
+ */
+static boolean_t
+zio_compress_probe(void *src, void *dst, size_t s_len, size_t d_len)
+{
+	size_t sample = MIN(s_len, ZIO_COMPRESS_PROBE_SAMPLE);
+	size_t off = P2ALIGN((s_len - sample) / 2, sizeof (uint64_t));
+	size_t sample_d_len = sample - (sample >> 3);
+
+	if (lz4_compress_zfs(src, dst, s_len, d_len, 0) <= d_len)
+		return (B_TRUE);
+
+	return (zfs_zstd_compress((char *)src + off, dst, sample,
+	    sample_d_len, 1) <= sample_d_len);
+}
+
+static size_t
+zio_compress_data_impl(enum zio_compress c, abd_t *src, void *dst,
+    size_t s_len, zio_compress_abort_t *za)
 {
 	size_t c_len, d_len;
+	hrtime_t start;
 	zio_compress_info_t *ci = &zio_compress_table[c];
 
 	ASSERT((uint_t)c < ZIO_COMPRESS_FUNCTIONS);
@@ -125,7 +237,24 @@ zio_compress_data(enum zio_compress c, abd_t *src, void *dst, size_t s_len)
 
 	/* No compression algorithms can read from ABDs directly */
 	void *tmp = abd_borrow_buf_copy(src, s_len);
+
+	start = gethrtime();
+	if (za != NULL && zio_compress_early_abort &&
+	    s_len >= zio_compress_early_abort_min_size &&
+	    zio_compress_is_expensive(c) &&
+	    !zio_compress_probe(tmp, dst, s_len, d_len)) {
+		hrtime_t saved = (hrtime_t)(zio_compress_cost[c] * s_len /
+		    1024) - (gethrtime() - start);
+
+		abd_return_buf(src, tmp, s_len);
+		za->za_aborted = B_TRUE;
+		za->za_saved = MAX(saved, 0);
+		return (s_len);
+	}
+
+	start = gethrtime();
 	c_len = ci->ci_compress(tmp, dst, s_len, d_len, ci->ci_level);
+	zio_compress_cost_update(c, gethrtime() - start, s_len);
 	abd_return_buf(src, tmp, s_len);
 
 	if (c_len > d_len)
@@ -135,6 +264,29 @@ zio_compress_data(enum zio_compress c, abd_t *src, void *dst, size_t s_len)
 	return (c_len);
 }
 
+size_t
+zio_compress_data(enum zio_compress c, abd_t *src, void *dst, size_t s_len)
+{
+	return (zio_compress_data_impl(c, src, dst, s_len, NULL));
+}
+
+/*
+ * Like zio_compress_data(), but an expensive compression function is only
+ * run if a cheap probe finds the block compressible.  This must not be used
+ * where the result has to match an existing block pointer (e.g. when the
+ * ARC recompresses a block for the L2ARC), since the outcome depends on
+ * tunables.  When the block is given up on, za describes what was saved.
+ */
+size_t
+zio_compress_data_early_abort(enum zio_compress c, abd_t *src, void *dst,
+    size_t s_len, zio_compress_abort_t *za)
+{
+	za->za_aborted = B_FALSE;
+	za->za_saved = 0;
+
+	return (zio_compress_data_impl(c, src, dst, s_len, za));
+}
+
 int
 zio_decompress_data_buf(enum zio_compress c, void *src, void *dst,
     size_t s_len, size_t d_len)
@@ -166,3 +318,15 @@ zio_decompress_data(enum zio_compress c, abd_t *src, void *dst,
 
 	return (ret);
 }
+
+#if defined(_KERNEL)
+/* BEGIN CSTYLED */
+module_param(zio_compress_early_abort, int, 0644);
+MODULE_PARM_DESC(zio_compress_early_abort,
+	"Skip expensive compression of blocks which look incompressible");
+
+module_param(zio_compress_early_abort_min_size, ulong, 0644);
+MODULE_PARM_DESC(zio_compress_early_abort_min_size,
+	"Smallest block size probed before expensive compression");
+/* END CSTYLED */
+#endif
@@ -643,6 +643,7 @@ zil_replay_func_t *zvol_replay_vector[TX_MAX_TYPE] = {
 	zvol_replay_err,	/* TX_MKDIR_ATTR */
 	zvol_replay_err,	/* TX_MKDIR_ACL_ATTR */
 	zvol_replay_err,	/* TX_WRITE2 */
+	zvol_replay_err,	/* TX_BATCH */
 };
 
 /*
@@ -930,6 +931,31 @@ zvol_read(void *arg)
 	kmem_free(zvr, sizeof (zv_request_t));
 }
 
+/*
+ * Hold back a request which exceeds the volume's I/O limits in the
+ * context of its submitter, before it takes its range lock and ties up
+ * a zvol_taskq thread.  zv_suspend_lock is dropped while sleeping, so
+ * that a throttled volume can still be suspended.
+ */
+static void
+zvol_iolimit(zvol_state_t *zv, boolean_t write, uint64_t size)
+{
+	hrtime_t now, wakeup;
+
+	ASSERT(RW_READ_HELD(&zv->zv_suspend_lock));
+
+	wakeup = dmu_objset_iolimit_wakeup(zv->zv_objset, write, size);
+	if (wakeup == 0)
+		return;
+
+	rw_exit(&zv->zv_suspend_lock);
+	now = gethrtime();
+	zfs_sleep_until(wakeup);
+	dataset_kstats_update_throttle_kstats(&zv->zv_kstat, write,
+	    gethrtime() - now);
+	rw_enter(&zv->zv_suspend_lock, RW_READER);
+}
+
 static MAKE_REQUEST_FN_RET
 zvol_request(struct request_queue *q, struct bio *bio)
 {
@@ -976,6 +1002,9 @@ zvol_request(struct request_queue *q, struct bio *bio)
 			goto out;
 		}
 
+		if (!bio_is_discard(bio) && !bio_is_secure_erase(bio))
+			zvol_iolimit(zv, B_TRUE, size);
+
 		zvr = kmem_alloc(sizeof (zv_request_t), KM_SLEEP);
 		zvr->zv = zv;
 		zvr->bio = bio;
@@ -1013,6 +1042,7 @@ zvol_request(struct request_queue *q, struct bio *bio)
 		zvr->bio = bio;
 
 		rw_enter(&zv->zv_suspend_lock, RW_READER);
+		zvol_iolimit(zv, B_FALSE, size);
 
 		zvr->rl = zfs_range_lock(&zv->zv_range_lock, offset, size,
 		    RL_READER);
@@ -1173,6 +1203,7 @@ zvol_setup_zv(zvol_state_t *zv)
 		set_disk_ro(zv->zv_disk, 0);
 		zv->zv_flags &= ~ZVOL_RDONLY;
 	}
+	dataset_kstats_attach(&zv->zv_kstat, os);
 	return (0);
 }
 
@@ -1188,6 +1219,7 @@ zvol_shutdown_zv(zvol_state_t *zv)
 
 	zil_close(zv->zv_zilog);
 	zv->zv_zilog = NULL;
+	dataset_kstats_detach(&zv->zv_kstat, zv->zv_objset);
 
 	dnode_rele(zv->zv_dn, FTAG);
 	zv->zv_dn = NULL;
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under both the BSD-style license (found in
+ * the LICENSE file in the root directory of the upstream source tree) and
+ * the GPLv2 (found in the COPYING file in the root directory of the
+ * upstream source tree).  You may select, at your option, one of the above-
+ * listed licenses.
+ */
+
+/*
+ * This file provides the libc dependencies that zstd requires.  It replaces
+ * the upstream lib/common/zstd_deps.h so the same library source can be
+ * built both into the kernel module and into libzpool.  Like the upstream
+ * file it is meant to be included multiple times, each time with a different
+ * set of ZSTD_DEPS_NEED_* macros defined.
+ *
+ * In the kernel there is no general purpose allocator which zstd could call
+ * on its own.  ZFS always hands zstd a custom allocator (see zfs_zstd.c),
+ * so the default allocation hooks below simply fail.
+ */
+
+/* Need: ZSTD_memcpy(), ZSTD_memmove(), ZSTD_memset(), size_t, INT_MAX */
+#ifndef ZSTD_DEPS_COMMON
+#define	ZSTD_DEPS_COMMON
+
+#include <limits.h>
+#include <stddef.h>
+#include <string.h>
+
+#define	ZSTD_memcpy(d, s, l)	__builtin_memcpy((d), (s), (l))
+#define	ZSTD_memmove(d, s, l)	__builtin_memmove((d), (s), (l))
+#define	ZSTD_memset(p, v, l)	__builtin_memset((p), (v), (l))
+
+#endif /* ZSTD_DEPS_COMMON */
+
+/* Need: ZSTD_malloc(), ZSTD_calloc(), ZSTD_free() */
+#ifdef ZSTD_DEPS_NEED_MALLOC
+#ifndef ZSTD_DEPS_MALLOC
+#define	ZSTD_DEPS_MALLOC
+
+#ifdef _KERNEL
+#define	ZSTD_malloc(s)		((void)(s), NULL)
+#define	ZSTD_calloc(n, s)	((void)(n), (void)(s), NULL)
+#define	ZSTD_free(p)		((void)(p))
+#else
+#include <stdlib.h>
+
+#define	ZSTD_malloc(s)		malloc(s)
+#define	ZSTD_calloc(n, s)	calloc((n), (s))
+#define	ZSTD_free(p)		free((p))
+#endif
+
+#endif /* ZSTD_DEPS_MALLOC */
+#endif /* ZSTD_DEPS_NEED_MALLOC */
+
+/* Need: ZSTD_div64() */
+#ifdef ZSTD_DEPS_NEED_MATH64
+#ifndef ZSTD_DEPS_MATH64
+#define	ZSTD_DEPS_MATH64
+
+#ifdef _KERNEL
+#include <linux/math64.h>
+
+#define	ZSTD_div64(dividend, divisor)	div_u64((dividend), (divisor))
+#else
+#define	ZSTD_div64(dividend, divisor)	((dividend) / (divisor))
+#endif
+
+#endif /* ZSTD_DEPS_MATH64 */
+#endif /* ZSTD_DEPS_NEED_MATH64 */
+
+/* Need: assert() */
+#ifdef ZSTD_DEPS_NEED_ASSERT
+#ifndef ZSTD_DEPS_ASSERT
+#define	ZSTD_DEPS_ASSERT
+
+#ifdef _KERNEL
+#include <linux/bug.h>
+
+#define	assert(x)	WARN_ON(!(x))
+#else
+#include <assert.h>
+#endif
+
+#endif /* ZSTD_DEPS_ASSERT */
+#endif /* ZSTD_DEPS_NEED_ASSERT */
+
+/* Need: ZSTD_DEBUG_PRINT() */
+#ifdef ZSTD_DEPS_NEED_IO
+#ifndef ZSTD_DEPS_IO
+#define	ZSTD_DEPS_IO
+
+#ifdef _KERNEL
+#include <linux/printk.h>
+
+#define	ZSTD_DEBUG_PRINT(...)	pr_debug(__VA_ARGS__)
+#else
+#include <stdio.h>
+
+#define	ZSTD_DEBUG_PRINT(...)	fprintf(stderr, __VA_ARGS__)
+#endif
+
+#endif /* ZSTD_DEPS_IO */
+#endif /* ZSTD_DEPS_NEED_IO */
+
+/* Only requested when <stdint.h> is known to be present. */
+#ifdef ZSTD_DEPS_NEED_STDINT
+#ifndef ZSTD_DEPS_STDINT
+#define	ZSTD_DEPS_STDINT
+
+#include <stdint.h>
+
+#endif /* ZSTD_DEPS_STDINT */
+#endif /* ZSTD_DEPS_NEED_STDINT */
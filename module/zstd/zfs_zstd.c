@@ -0,0 +1,315 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Zstandard compression for ZFS.
+ *
+ * The zstd library itself lives in module/zstd/lib and is used unmodified;
+ * this file adapts it to the zio_compress_func_t / zio_decompress_func_t
+ * interfaces.
+ *
+ * Compressed block layout
+ * -----------------------
+ * A zstd frame must be handed to the decoder with its exact length, but the
+ * physical size of a block is rounded up to the vdev's allocation size.  We
+ * therefore prefix every frame with a small big-endian header which records
+ * the length of the frame and the version of the library which wrote it:
+ *
+ *	+-----------+-----------+----------------------------------+
+ *	| c_len (4) | vers (4)  | zstd frame (c_len bytes)         |
+ *	+-----------+-----------+----------------------------------+
+ *
+ * The compression level is not stored: it is part of the block pointer's
+ * compression function (ZIO_COMPRESS_ZSTD_*), which is how the ARC and
+ * L2ARC are able to recompress a block into a bit-identical copy.
+ *
+ * Contexts
+ * --------
+ * Creating a zstd context means allocating and initializing anywhere from a
+ * few hundred kilobytes to several megabytes of tables, which would dwarf
+ * the cost of compressing a single record.  Instead we keep one compression
+ * and one decompression context per CPU, each protected by its own lock.
+ * A caller picks the context belonging to the CPU it is running on, so
+ * contention is rare and only occurs when a thread is preempted while
+ * holding a context.  The contexts are created on first use and grow to fit
+ * the largest level and record size they have seen; zfs_zstd_cache_reap_now()
+ * releases the idle ones when the ARC is asked to give memory back.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/zio_compress.h>
+
+#define	ZSTD_STATIC_LINKING_ONLY
+#include "lib/zstd.h"
+#include "lib/zstd_errors.h"
+
+typedef struct zfs_zstd_header {
+	uint32_t	zh_c_len;	/* length of the zstd frame */
+	uint32_t	zh_version;	/* ZSTD_VERSION_NUMBER of the writer */
+	char		zh_data[];
+} zfs_zstd_header_t;
+
+typedef struct zfs_zstd_cctx {
+	kmutex_t	zc_lock;
+	ZSTD_CCtx	*zc_cctx;
+} ____cacheline_aligned zfs_zstd_cctx_t;
+
+typedef struct zfs_zstd_dctx {
+	kmutex_t	zd_lock;
+	ZSTD_DCtx	*zd_dctx;
+} ____cacheline_aligned zfs_zstd_dctx_t;
+
+static zfs_zstd_cctx_t *zfs_zstd_cctx;
+static zfs_zstd_dctx_t *zfs_zstd_dctx;
+static uint_t zfs_zstd_nctx;
+
+/*
+ * zstd frees memory without telling us its size, so every allocation
+ * records its own size in front of the memory handed to the library.
+ */
+typedef struct zfs_zstd_alloc {
+	size_t		za_size;
+	uint64_t	za_pad;		/* keep the buffer 16-byte aligned */
+	char		za_data[];
+} zfs_zstd_alloc_t;
+
+/* ARGSUSED */
+static void *
+zfs_zstd_alloc(void *opaque, size_t size)
+{
+	zfs_zstd_alloc_t *za;
+
+	za = vmem_alloc(sizeof (zfs_zstd_alloc_t) + size, KM_SLEEP);
+	za->za_size = sizeof (zfs_zstd_alloc_t) + size;
+
+	return (za->za_data);
+}
+
+/* ARGSUSED */
+static void
+zfs_zstd_free(void *opaque, void *ptr)
+{
+	zfs_zstd_alloc_t *za;
+
+	if (ptr == NULL)
+		return;
+
+	za = (zfs_zstd_alloc_t *)((char *)ptr -
+	    offsetof(zfs_zstd_alloc_t, za_data));
+	vmem_free(za, za->za_size);
+}
+
+static const ZSTD_customMem zfs_zstd_mem = {
+	.customAlloc = zfs_zstd_alloc,
+	.customFree = zfs_zstd_free,
+	.opaque = NULL,
+};
+
+static uint_t
+zfs_zstd_ctx_index(void)
+{
+	uint_t idx;
+
+	kpreempt_disable();
+	idx = CPU_SEQID % zfs_zstd_nctx;
+	kpreempt_enable();
+
+	return (idx);
+}
+
+size_t
+zfs_zstd_compress(void *s_start, void *d_start, size_t s_len, size_t d_len,
+    int level)
+{
+	zfs_zstd_header_t *hdr = d_start;
+	zfs_zstd_cctx_t *zc;
+	size_t c_len;
+
+	ASSERT(d_len <= s_len);
+	ASSERT(level >= ZSTD_minCLevel() && level <= ZSTD_maxCLevel());
+
+	if (d_len <= sizeof (zfs_zstd_header_t))
+		return (s_len);
+
+	zc = &zfs_zstd_cctx[zfs_zstd_ctx_index()];
+	mutex_enter(&zc->zc_lock);
+
+	if (zc->zc_cctx == NULL) {
+		zc->zc_cctx = ZSTD_createCCtx_advanced(zfs_zstd_mem);
+		if (zc->zc_cctx == NULL) {
+			mutex_exit(&zc->zc_lock);
+			return (s_len);
+		}
+	}
+
+	/*
+	 * The block pointer checksum already covers the data, so skip the
+	 * frame checksum.  Pledging the source size lets zstd size its
+	 * tables for this record instead of for an unbounded stream.
+	 */
+	(void) ZSTD_CCtx_reset(zc->zc_cctx, ZSTD_reset_session_and_parameters);
+	(void) ZSTD_CCtx_setParameter(zc->zc_cctx,
+	    ZSTD_c_compressionLevel, level);
+	(void) ZSTD_CCtx_setParameter(zc->zc_cctx, ZSTD_c_checksumFlag, 0);
+	(void) ZSTD_CCtx_setPledgedSrcSize(zc->zc_cctx, s_len);
+
+	c_len = ZSTD_compress2(zc->zc_cctx, hdr->zh_data,
+	    d_len - sizeof (zfs_zstd_header_t), s_start, s_len);
+
+	mutex_exit(&zc->zc_lock);
+
+	/*
+	 * An error here almost always means the output did not fit in
+	 * d_len, i.e. the block is not compressible enough to be worth it.
+	 */
+	if (ZSTD_isError(c_len))
+		return (s_len);
+
+	hdr->zh_c_len = BE_32(c_len);
+	hdr->zh_version = BE_32(ZSTD_VERSION_NUMBER);
+
+	return (sizeof (zfs_zstd_header_t) + c_len);
+}
+
+/* ARGSUSED */
+int
+zfs_zstd_decompress(void *s_start, void *d_start, size_t s_len, size_t d_len,
+    int level)
+{
+	const zfs_zstd_header_t *hdr = s_start;
+	zfs_zstd_dctx_t *zd;
+	size_t c_len, ret;
+
+	if (s_len < sizeof (zfs_zstd_header_t))
+		return (-1);
+
+	c_len = BE_32(hdr->zh_c_len);
+	if (c_len > s_len - sizeof (zfs_zstd_header_t))
+		return (-1);
+
+	zd = &zfs_zstd_dctx[zfs_zstd_ctx_index()];
+	mutex_enter(&zd->zd_lock);
+
+	if (zd->zd_dctx == NULL) {
+		zd->zd_dctx = ZSTD_createDCtx_advanced(zfs_zstd_mem);
+		if (zd->zd_dctx == NULL) {
+			mutex_exit(&zd->zd_lock);
+			return (-1);
+		}
+	}
+
+	ret = ZSTD_decompressDCtx(zd->zd_dctx, d_start, d_len,
+	    hdr->zh_data, c_len);
+
+	mutex_exit(&zd->zd_lock);
+
+	if (ZSTD_isError(ret) || ret != d_len)
+		return (-1);
+
+	return (0);
+}
+
+/*
+ * Release the memory held by idle contexts.  Contexts which are in use are
+ * simply skipped; they will be reaped the next time around.
+ */
+void
+zfs_zstd_cache_reap_now(void)
+{
+	for (uint_t i = 0; i < zfs_zstd_nctx; i++) {
+		zfs_zstd_cctx_t *zc = &zfs_zstd_cctx[i];
+		zfs_zstd_dctx_t *zd = &zfs_zstd_dctx[i];
+
+		if (mutex_tryenter(&zc->zc_lock)) {
+			ZSTD_freeCCtx(zc->zc_cctx);
+			zc->zc_cctx = NULL;
+			mutex_exit(&zc->zc_lock);
+		}
+		if (mutex_tryenter(&zd->zd_lock)) {
+			ZSTD_freeDCtx(zd->zd_dctx);
+			zd->zd_dctx = NULL;
+			mutex_exit(&zd->zd_lock);
+		}
+	}
+}
+
+void
+zstd_init(void)
+{
+	zfs_zstd_nctx = max_ncpus;
+	zfs_zstd_cctx = kmem_zalloc(zfs_zstd_nctx * sizeof (zfs_zstd_cctx_t),
+	    KM_SLEEP);
+	zfs_zstd_dctx = kmem_zalloc(zfs_zstd_nctx * sizeof (zfs_zstd_dctx_t),
+	    KM_SLEEP);
+
+	for (uint_t i = 0; i < zfs_zstd_nctx; i++) {
+		mutex_init(&zfs_zstd_cctx[i].zc_lock, NULL,
+		    MUTEX_DEFAULT, NULL);
+		mutex_init(&zfs_zstd_dctx[i].zd_lock, NULL,
+		    MUTEX_DEFAULT, NULL);
+	}
+}
+
+void
+zstd_fini(void)
+{
+	for (uint_t i = 0; i < zfs_zstd_nctx; i++) {
+		ZSTD_freeCCtx(zfs_zstd_cctx[i].zc_cctx);
+		ZSTD_freeDCtx(zfs_zstd_dctx[i].zd_dctx);
+		mutex_destroy(&zfs_zstd_cctx[i].zc_lock);
+		mutex_destroy(&zfs_zstd_dctx[i].zd_lock);
+	}
+
+	kmem_free(zfs_zstd_cctx, zfs_zstd_nctx * sizeof (zfs_zstd_cctx_t));
+	kmem_free(zfs_zstd_dctx, zfs_zstd_nctx * sizeof (zfs_zstd_dctx_t));
+	zfs_zstd_cctx = NULL;
+	zfs_zstd_dctx = NULL;
+	zfs_zstd_nctx = 0;
+}
+
+#if defined(_KERNEL)
+#include <linux/module.h>
+
+static int __init
+zfs_zstd_module_init(void)
+{
+	return (0);
+}
+
+static void __exit
+zfs_zstd_module_fini(void)
+{
+}
+
+module_init(zfs_zstd_module_init);
+module_exit(zfs_zstd_module_fini);
+
+EXPORT_SYMBOL(zfs_zstd_compress);
+EXPORT_SYMBOL(zfs_zstd_decompress);
+EXPORT_SYMBOL(zfs_zstd_cache_reap_now);
+EXPORT_SYMBOL(zstd_init);
+EXPORT_SYMBOL(zstd_fini);
+
+MODULE_DESCRIPTION("Zstandard compression for ZFS");
+MODULE_AUTHOR(ZFS_META_AUTHOR);
+MODULE_LICENSE("Dual BSD/GPL");
+MODULE_VERSION(ZFS_META_VERSION "-" ZFS_META_RELEASE);
+#endif
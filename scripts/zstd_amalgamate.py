@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+#
+# Generate module/zstd/lib/zstd.c from an upstream zstd source tree.
+#
+# Usage: zstd_amalgamate.py <zstd>/lib module/zstd/lib/zstd.c
+#
+# The library sources needed by ZFS are concatenated in the order below and
+# every local header they include is inlined the first time it is seen.
+# zstd.h, zstd_errors.h and zstd_deps.h are left as includes; the first two
+# are copied verbatim next to the output and the last is provided by ZFS.
+# Multithreading, legacy formats, tracing and the x86-64 assembly decoder
+# are not used.
+#
+import os
+import re
+import sys
+
+PROLOGUE = """/*
+ * Zstandard 1.5.7 single-file library for ZFS.
+ *
+ * This file is generated from the upstream lib/common, lib/compress and
+ * lib/decompress sources by inlining every local header exactly once.
+ * Do not edit it by hand; see module/zstd/README.zfs for how to
+ * regenerate it.
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under both the BSD-style license (found in
+ * the LICENSE file in the root directory of the upstream source tree) and
+ * the GPLv2 (found in the COPYING file in the root directory of the
+ * upstream source tree).  You may select, at your option, one of the above-
+ * listed licenses.
+ */
+
+#define	DEBUGLEVEL		0
+#define	ZSTD_LEGACY_SUPPORT	0
+#define	ZSTD_NO_TRACE
+#define	ZSTD_TRACE		0
+#define	ZSTD_DISABLE_ASM	1
+#define	ZSTD_STATIC_LINKING_ONLY
+#define	XXH_NAMESPACE		ZSTD_
+#define	XXH_PRIVATE_API
+#define	XXH_INLINE_ALL
+#ifdef _KERNEL
+#define	XXH_NO_STDLIB
+#endif
+
+"""
+SRC = sys.argv[1]
+OUT = sys.argv[2]
+FILES = """common/debug.c common/entropy_common.c common/error_private.c
+common/fse_decompress.c common/zstd_common.c
+compress/fse_compress.c compress/hist.c compress/huf_compress.c
+compress/zstd_compress_literals.c compress/zstd_compress_sequences.c
+compress/zstd_compress_superblock.c compress/zstd_compress.c
+compress/zstd_double_fast.c compress/zstd_fast.c compress/zstd_lazy.c
+compress/zstd_ldm.c compress/zstd_opt.c compress/zstd_preSplit.c
+decompress/huf_decompress.c decompress/zstd_ddict.c
+decompress/zstd_decompress.c decompress/zstd_decompress_block.c""".split()
+KEEP = {"zstd.h", "zstd_errors.h", "zstd_deps.h"}
+SKIP = {"zstd_legacy.h", "zstdmt_compress.h", "pool.h", "threading.h"}
+inc = re.compile(r'^\s*#\s*include\s+"([^"]+)"')
+seen = set()
+out = []
+def emit(path):
+    with open(path) as f:
+        for line in f:
+            m = inc.match(line)
+            if not m:
+                out.append(line)
+                continue
+            name = m.group(1)
+            base = os.path.basename(name)
+            if base in KEEP:
+                out.append('#include "%s"\n' % base)
+                continue
+            if base in SKIP:
+                out.append(line)
+                continue
+            p = os.path.normpath(os.path.join(os.path.dirname(path), name))
+            if p in seen:
+                continue
+            seen.add(p)
+            out.append("/**** start inlining %s ****/\n" % os.path.relpath(p, SRC))
+            emit(p)
+            out.append("/**** ended inlining %s ****/\n" % os.path.relpath(p, SRC))
+out.append(PROLOGUE)
+for f in FILES:
+    p = os.path.join(SRC, f)
+    seen.add(p)
+    out.append("/**** start inlining %s ****/\n" % f)
+    emit(p)
+    out.append("/**** ended inlining %s ****/\n" % f)
+open(OUT, "w").write("".join(out))
@@ -296,6 +296,24 @@ test_pool_discard_checkpoint(const char *pool)
 		    NULL, 0);
 }
 
+static void
+test_pool_trim(const char *pool)
+{
+	nvlist_t *required = fnvlist_alloc();
+	nvlist_t *optional = fnvlist_alloc();
+	nvlist_t *vdevs = fnvlist_alloc();
+
+	fnvlist_add_uint64(required, ZPOOL_TRIM_COMMAND, POOL_TRIM_CANCEL);
+	fnvlist_add_nvlist(required, ZPOOL_TRIM_VDEVS, vdevs);
+	fnvlist_add_uint64(optional, ZPOOL_TRIM_RATE, 0);
+
+	IOC_INPUT_TEST(ZFS_IOC_POOL_TRIM, pool, required, optional, 0);
+
+	nvlist_free(vdevs);
+	nvlist_free(optional);
+	nvlist_free(required);
+}
+
 static void
 test_log_history(const char *pool)
 {
@@ -700,6 +718,7 @@ zfs_ioc_input_tests(const char *pool)
 	test_pool_reopen(pool);
 	test_pool_checkpoint(pool);
 	test_pool_discard_checkpoint(pool);
+	test_pool_trim(pool);
 	test_log_history(pool);
 
 	test_create(dataset);
@@ -870,6 +889,7 @@ validate_ioc_values(void)
 	    ZFS_IOC_BASE + 76 == ZFS_IOC_REMAP &&
 	    ZFS_IOC_BASE + 77 == ZFS_IOC_POOL_CHECKPOINT &&
 	    ZFS_IOC_BASE + 78 == ZFS_IOC_POOL_DISCARD_CHECKPOINT &&
+	    ZFS_IOC_BASE + 79 == ZFS_IOC_POOL_TRIM &&
 	    LINUX_IOC_BASE + 1 == ZFS_IOC_EVENTS_NEXT &&
 	    LINUX_IOC_BASE + 2 == ZFS_IOC_EVENTS_CLEAR &&
 	    LINUX_IOC_BASE + 3 == ZFS_IOC_EVENTS_SEEK);
@@ -0,0 +1,247 @@
+/*
+ * CDDL HEADER START
+ *
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef _GNU_SOURCE
+#define	_GNU_SOURCE
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+
+/*
+ * Exercise O_DIRECT I/O against a file that is also in use through
+ * other paths.
+ *
+ * mix:      Write a file with O_DIRECT, then map it.  Modify half of the
+ *           blocks through the mapping and the other half with O_DIRECT
+ *           writes, and verify each side observes the other's changes.
+ *
+ * scribble: Issue O_DIRECT writes while another thread keeps modifying
+ *           the buffer being written.  The contents written are
+ *           undefined, but reading them back must not fail.
+ */
+
+static size_t bsize;
+static int count;
+static volatile int done;
+
+static void
+usage(const char *prog)
+{
+	(void) fprintf(stderr,
+	    "usage: %s <mix|scribble> <file> <blocksize> <count>\n", prog);
+	exit(2);
+}
+
+static void
+fill(char *buf, int block, int seed)
+{
+	size_t i;
+
+	for (i = 0; i < bsize; i++)
+		buf[i] = (char)(block * 31 + i + seed);
+}
+
+static int
+check(const char *what, const char *buf, int block, int seed)
+{
+	size_t i;
+
+	for (i = 0; i < bsize; i++) {
+		if (buf[i] != (char)(block * 31 + i + seed)) {
+			(void) fprintf(stderr, "%s: block %d differs at "
+			    "offset %zu\n", what, block, i);
+			return (1);
+		}
+	}
+
+	return (0);
+}
+
+static void *
+alloc_buf(void)
+{
+	void *buf;
+	int error;
+
+	if ((error = posix_memalign(&buf, getpagesize(), bsize)) != 0) {
+		(void) fprintf(stderr, "posix_memalign: %s\n", strerror(error));
+		exit(1);
+	}
+
+	return (buf);
+}
+
+static void
+do_pwrite(int fd, const char *buf, int block)
+{
+	if (pwrite(fd, buf, bsize, (off_t)block * bsize) != (ssize_t)bsize) {
+		perror("pwrite");
+		exit(1);
+	}
+}
+
+static void
+do_pread(int fd, char *buf, int block)
+{
+	if (pread(fd, buf, bsize, (off_t)block * bsize) != (ssize_t)bsize) {
+		perror("pread");
+		exit(1);
+	}
+}
+
+static int
+mix(const char *path)
+{
+	char *buf = alloc_buf();
+	char *map;
+	int fd, i, errors = 0;
+
+	if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_DIRECT,
+	    0644)) < 0) {
+		perror("open");
+		return (1);
+	}
+
+	for (i = 0; i < count; i++) {
+		fill(buf, i, 0);
+		do_pwrite(fd, buf, i);
+	}
+
+	map = mmap(NULL, bsize * count, PROT_READ | PROT_WRITE, MAP_SHARED,
+	    fd, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		return (1);
+	}
+
+	for (i = 0; i < count; i++)
+		errors += check("mapped read", map + i * bsize, i, 0);
+
+	/*
+	 * Dirty the even blocks through the mapping without syncing them,
+	 * and overwrite the odd blocks with O_DIRECT while still mapped.
+	 */
+	for (i = 0; i < count; i += 2)
+		fill(map + i * bsize, i, 1);
+	for (i = 1; i < count; i += 2) {
+		fill(buf, i, 2);
+		do_pwrite(fd, buf, i);
+	}
+
+	for (i = 0; i < count; i++) {
+		do_pread(fd, buf, i);
+		errors += check("direct read", buf, i, (i % 2) ? 2 : 1);
+		errors += check("mapped read", map + i * bsize, i,
+		    (i % 2) ? 2 : 1);
+	}
+
+	if (munmap(map, bsize * count) != 0) {
+		perror("munmap");
+		return (1);
+	}
+	(void) close(fd);
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		perror("open");
+		return (1);
+	}
+	for (i = 0; i < count; i++) {
+		do_pread(fd, buf, i);
+		errors += check("buffered read", buf, i, (i % 2) ? 2 : 1);
+	}
+	(void) close(fd);
+	free(buf);
+
+	return (errors != 0);
+}
+
+static void *
+scribbler(void *arg)
+{
+	volatile char *buf = arg;
+	size_t i = 0;
+
+	while (!done) {
+		buf[i]++;
+		i = (i + 4093) % bsize;
+	}
+
+	return (NULL);
+}
+
+static int
+scribble(const char *path)
+{
+	char *buf = alloc_buf();
+	pthread_t tid;
+	int fd, i, pass;
+
+	if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_DIRECT,
+	    0644)) < 0) {
+		perror("open");
+		return (1);
+	}
+
+	fill(buf, 0, 0);
+	if (pthread_create(&tid, NULL, scribbler, buf) != 0) {
+		perror("pthread_create");
+		return (1);
+	}
+	for (pass = 0; pass < 4; pass++) {
+		for (i = 0; i < count; i++)
+			do_pwrite(fd, buf, i);
+		if (fsync(fd) != 0) {
+			perror("fsync");
+			return (1);
+		}
+	}
+	done = 1;
+	(void) pthread_join(tid, NULL);
+
+	for (i = 0; i < count; i++)
+		do_pread(fd, buf, i);
+
+	(void) close(fd);
+	free(buf);
+
+	return (0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 5)
+		usage(argv[0]);
+
+	bsize = strtoul(argv[3], NULL, 0);
+	count = atoi(argv[4]);
+	if (bsize == 0 || bsize % getpagesize() != 0 || count <= 0)
+		usage(argv[0]);
+
+	if (strcmp(argv[1], "mix") == 0)
+		return (mix(argv[2]));
+	else if (strcmp(argv[1], "scribble") == 0)
+		return (scribble(argv[2]));
+
+	usage(argv[0]);
+	return (2);
+}
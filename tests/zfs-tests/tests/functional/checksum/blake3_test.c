@@ -0,0 +1,328 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * This is just to keep the compiler happy about sys/time.h not declaring
+ * gettimeofday due to -D_KERNEL (we can do this since we're actually
+ * running in userspace, but we need -D_KERNEL for the remaining BLAKE3 code).
+ */
+#ifdef	_KERNEL
+#undef	_KERNEL
+#endif
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <sys/blake3.h>
+#define NOTE(x)
+typedef enum boolean { B_FALSE, B_TRUE } boolean_t;
+typedef	unsigned long long	u_longlong_t;
+
+extern void blake3_impl_init(void);
+extern int blake3_impl_set(const char *);
+
+/*
+ * Every implementation which may be compiled in; those which are not, or
+ * which the CPU does not support, are rejected by blake3_impl_set().
+ */
+const char	*blake3_impls[] = { "generic", "ssse3", "avx2", "avx512" };
+
+/*
+ * Test vectors from the BLAKE3 reference test_vectors.json.  The input
+ * of each is the repeating byte sequence 0, 1, ..., 250 truncated to
+ * the given length; the keyed hashes use blake3_test_key.
+ */
+const uint8_t	*blake3_test_key = (const uint8_t *)
+	"whats the Elvish word for friend";
+
+typedef struct blake3_test {
+	size_t		bt_len;
+	const char	*bt_hash;
+	const char	*bt_keyed_hash;
+} blake3_test_t;
+
+const blake3_test_t	blake3_tests[] = {
+	{ 0,
+	    "af1349b9f5f9a1a6a0404dea36dcc949"
+	    "9bcb25c9adc112b7cc9a93cae41f3262",
+	    "92b2b75604ed3c761f9d6f62392c8a92"
+	    "27ad0ea3f09573e783f1498a4ed60d26" },
+	{ 1,
+	    "2d3adedff11b61f14c886e35afa03673"
+	    "6dcd87a74d27b5c1510225d0f592e213",
+	    "6d7878dfff2f485635d39013278ae14f"
+	    "1454b8c0a3a2d34bc1ab38228a80c95b" },
+	{ 63,
+	    "e9bc37a594daad83be9470df7f7b3798"
+	    "297c3d834ce80ba85d6e207627b7db7b",
+	    "bb1eb5d4afa793c1ebdd9fb08def6c36"
+	    "d10096986ae0cfe148cd101170ce37ae" },
+	{ 64,
+	    "4eed7141ea4a5cd4b788606bd23f46e2"
+	    "12af9cacebacdc7d1f4c6dc7f2511b98",
+	    "ba8ced36f327700d213f120b1a207a3b"
+	    "8c04330528586f414d09f2f7d9ccb7e6" },
+	{ 65,
+	    "de1e5fa0be70df6d2be8fffd0e99ceaa"
+	    "8eb6e8c93a63f2d8d1c30ecb6b263dee",
+	    "c0a4edefa2d2accb9277c371ac12fcdb"
+	    "b52988a86edc54f0716e1591b4326e72" },
+	{ 1023,
+	    "10108970eeda3eb932baac1428c7a216"
+	    "3b0e924c9a9e25b35bba72b28f70bd11",
+	    "c951ecdf03288d0fcc96ee3413563d8a"
+	    "6d3589547f2c2fb36d9786470f1b9d6e" },
+	{ 1024,
+	    "42214739f095a406f3fc83deb889744a"
+	    "c00df831c10daa55189b5d121c855af7",
+	    "75c46f6f3d9eb4f55ecaaee480db732e"
+	    "6c2105546f1e675003687c31719c7ba4" },
+	{ 1025,
+	    "d00278ae47eb27b34faecf67b4fe263f"
+	    "82d5412916c1ffd97c8cb7fb814b8444",
+	    "357dc55de0c7e382c900fd6e320acc04"
+	    "146be01db6a8ce7210b7189bd664ea69" },
+	{ 2048,
+	    "e776b6028c7cd22a4d0ba182a8bf6220"
+	    "5d2ef576467e838ed6f2529b85fba24a",
+	    "879cf1fa2ea0e79126cb1063617a05b6"
+	    "ad9d0b696d0d757cf053439f60a99dd1" },
+	{ 2049,
+	    "5f4d72f40d7a5f82b15ca2b2e44b1de3"
+	    "c2ef86c426c95c1af0b6879522563030",
+	    "9f29700902f7c86e514ddc4df1e3049f"
+	    "258b2472b6dd5267f61bf13983b78dd5" },
+	{ 3072,
+	    "b98cb0ff3623be03326b373de6b90952"
+	    "18513e64f1ee2edd2525c7ad1e5cffd2",
+	    "044a0e7b172a312dc02a4c9a818c036f"
+	    "fa2776368d7f528268d2e6b5df191770" },
+	{ 3073,
+	    "7124b49501012f81cc7f11ca069ec922"
+	    "6cecb8a2c850cfe644e327d22d3e1cd3",
+	    "68dede9bef00ba89e43f31a6825f4cf4"
+	    "33389fedae75c04ee9f0cf16a427c95a" },
+	{ 4096,
+	    "015094013f57a5277b59d8475c050104"
+	    "2c0b642e531b0a1c8f58d2163229e969",
+	    "befc660aea2f1718884cd8deb9902811"
+	    "d332f4fc4a38cf7c7300d597a081bfc0" },
+	{ 4097,
+	    "9b4052b38f1c5fc8b1f9ff7ac7b27cd2"
+	    "42487b3d890d15c96a1c25b8aa0fb995",
+	    "00df940cd36bb9fa7cbbc3556744e0db"
+	    "c8191401afe70520ba292ee3ca80abbc" },
+	{ 5120,
+	    "9cadc15fed8b5d854562b26a9536d970"
+	    "7cadeda9b143978f319ab34230535833",
+	    "2c493e48e9b9bf31e0553a22b23503c0"
+	    "a3388f035cece68eb438d22fa1943e20" },
+	{ 5121,
+	    "628bd2cb2004694adaab7bbd778a25df"
+	    "25c47b9d4155a55f8fbd79f2fe154cff",
+	    "6ccf1c34753e7a044db80798ecd0782a"
+	    "8f76f33563accaddbfbb2e0ea4b2d024" },
+	{ 6144,
+	    "3e2e5b74e048f3add6d21faab3f83aa4"
+	    "4d3b2278afb83b80b3c35164ebeca205",
+	    "3d6b6d21281d0ade5b2b016ae4034c5d"
+	    "ec10ca7e475f90f76eac7138e9bc8f1d" },
+	{ 6145,
+	    "f1323a8631446cc50536a9f705ee5cb6"
+	    "19424d46887f3c376c695b70e0f0507f",
+	    "9ac301e9e39e45e3250a7e3b3df701aa"
+	    "0fb6889fbd80eeecf28dbc6300fbc539" },
+	{ 7168,
+	    "61da957ec2499a95d6b8023e2b0e604e"
+	    "c7f6b50e80a9678b89d2628e99ada77a",
+	    "b42835e40e9d4a7f42ad8cc04f85a963"
+	    "a76e18198377ed84adddeaecacc6f3fc" },
+	{ 7169,
+	    "a003fc7a51754a9b3c7fae0367ab3d78"
+	    "2dccf28855a03d435f8cfe74605e7817",
+	    "ed9b1a922c046fdb3d423ae34e143b05"
+	    "ca1bf28b710432857bf738bcedbfa511" },
+	{ 8192,
+	    "aae792484c8efe4f19e2ca7d371d8c46"
+	    "7ffb10748d8a5a1ae579948f718a2a63",
+	    "dc9637c8845a770b4cbf76b8daec0eeb"
+	    "f7dc2eac11498517f08d44c8fc00d58a" },
+	{ 8193,
+	    "bab6c09cb8ce8cf459261398d2e7aef3"
+	    "5700bf488116ceb94a36d0f5f1b7bc3b",
+	    "954a2a75420c8d6547e3ba5b98d963e6"
+	    "fa6491addc8c023189cc519821b4a1f5" },
+	{ 16384,
+	    "f875d6646de28985646f34ee13be9a57"
+	    "6fd515f76b5b0a26bb324735041ddde4",
+	    "9e9fc4eb7cf081ea7c47d1807790ed21"
+	    "1bfec56aa25bb7037784c13c4b707b0d" },
+	{ 31744,
+	    "62b6960e1a44bcc1eb1a611a8d6235b6"
+	    "b4b78f32e7abc4fb4c6cdcce94895c47",
+	    "efa53b389ab67c593dba624d898d0f73"
+	    "53ab99e4ac9d42302ee64cbf9939a419" },
+	{ 102400,
+	    "bc3e3d41a1146b069abffad3c0d44860"
+	    "cf664390afce4d9661f7902e7943e085",
+	    "1c35d1a5811083fd7119f5d5d1ba027b"
+	    "4d01c0c6c49fb6ff2cf75393ea5db4a7" },
+};
+
+#define	BLAKE3_MAX_TEST_LEN	102400
+
+/*
+ * Piece sizes used to feed the incremental tests, chosen to straddle
+ * block and chunk boundaries.
+ */
+const size_t	blake3_piece_sizes[] = { 1, 63, 65, 1000, 4096 };
+
+static void
+blake3_hex(const uint8_t *digest, char *hex)
+{
+	for (int i = 0; i < BLAKE3_OUT_LEN; i++)
+		(void) sprintf(hex + 2 * i, "%02x", digest[i]);
+}
+
+static boolean_t
+blake3_check(const uint8_t *input, size_t len, const uint8_t *key,
+    size_t piece, const char *expected)
+{
+	BLAKE3_CTX	ctx;
+	uint8_t		digest[BLAKE3_OUT_LEN];
+	char		hex[2 * BLAKE3_OUT_LEN + 1];
+	size_t		off;
+
+	if (key != NULL)
+		Blake3_InitKeyed(&ctx, key);
+	else
+		Blake3_Init(&ctx);
+	for (off = 0; off < len; off += piece)
+		Blake3_Update(&ctx, input + off,
+		    len - off < piece ? len - off : piece);
+	Blake3_Final(&ctx, digest);
+	blake3_hex(digest, hex);
+
+	return (strcmp(hex, expected) == 0 ? B_TRUE : B_FALSE);
+}
+
+/*
+ * Local reimplementation of cmn_err, since it's used in blake3_impl.c.
+ */
+/*ARGSUSED*/
+void
+cmn_err(int level, char *format, ...)
+{
+	va_list ap;
+	va_start(ap, format);
+	/* LINTED: E_SEC_PRINTF_VAR_FMT */
+	(void) vfprintf(stderr, format, ap);
+	va_end(ap);
+}
+
+int
+main(int argc, char *argv[])
+{
+	boolean_t	failed = B_FALSE;
+	uint64_t	cpu_mhz = 0;
+	uint8_t		*input;
+	int		i, j, k;
+
+	if (argc == 2)
+		cpu_mhz = atoi(argv[1]);
+
+	input = malloc(BLAKE3_MAX_TEST_LEN);
+	for (i = 0; i < BLAKE3_MAX_TEST_LEN; i++)
+		input[i] = i % 251;
+
+	blake3_impl_init();
+
+	for (j = 0; j < sizeof (blake3_impls) / sizeof (blake3_impls[0]); j++) {
+		const char *impl = blake3_impls[j];
+
+		if (blake3_impl_set(impl) != 0)
+			continue;
+
+		(void) printf("Running algorithm correctness tests "
+		    "(blake3 %s):\n", impl);
+		for (i = 0; i < sizeof (blake3_tests) /
+		    sizeof (blake3_tests[0]); i++) {
+			const blake3_test_t *bt = &blake3_tests[i];
+			boolean_t ok;
+
+			ok = blake3_check(input, bt->bt_len, NULL,
+			    BLAKE3_MAX_TEST_LEN, bt->bt_hash) &&
+			    blake3_check(input, bt->bt_len, blake3_test_key,
+			    BLAKE3_MAX_TEST_LEN, bt->bt_keyed_hash);
+			for (k = 0; k < sizeof (blake3_piece_sizes) /
+			    sizeof (blake3_piece_sizes[0]); k++) {
+				ok = ok && blake3_check(input, bt->bt_len,
+				    blake3_test_key, blake3_piece_sizes[k],
+				    bt->bt_keyed_hash);
+			}
+
+			(void) printf("BLAKE3    Message: %-6llu\tResult: %s\n",
+			    (u_longlong_t)bt->bt_len, ok ? "OK" : "FAILED!");
+			if (!ok)
+				failed = B_TRUE;
+		}
+	}
+
+	free(input);
+
+	if (failed)
+		return (1);
+
+	for (j = 0; j < sizeof (blake3_impls) / sizeof (blake3_impls[0]); j++) {
+		const char *impl = blake3_impls[j];
+		BLAKE3_CTX	ctx;
+		uint8_t		digest[BLAKE3_OUT_LEN];
+		uint8_t		block[131072];
+		uint64_t	delta;
+		double		cpb = 0;
+		struct timeval	start, end;
+
+		if (blake3_impl_set(impl) != 0)
+			continue;
+
+		(void) printf("Running performance tests (hashing 1024 MiB of "
+		    "data, %s):\n", impl);
+		bzero(block, sizeof (block));
+		(void) gettimeofday(&start, NULL);
+		Blake3_Init(&ctx);
+		for (i = 0; i < 8192; i++)
+			Blake3_Update(&ctx, block, sizeof (block));
+		Blake3_Final(&ctx, digest);
+		(void) gettimeofday(&end, NULL);
+		delta = (end.tv_sec * 1000000llu + end.tv_usec) -
+		    (start.tv_sec * 1000000llu + start.tv_usec);
+		if (cpu_mhz != 0) {
+			cpb = (cpu_mhz * 1e6 * ((double)delta /
+			    1000000)) / (8192 * 128 * 1024);
+		}
+		(void) printf("BLAKE3    %llu us (%.02f CPB)\n",
+		    (u_longlong_t)delta, cpb);
+	}
+
+	return (0);
+}
@@ -43,6 +43,17 @@
 typedef enum boolean { B_FALSE, B_TRUE } boolean_t;
 typedef	unsigned long long	u_longlong_t;
 
+extern void sha2_impl_init(void);
+extern int sha256_impl_set(const char *);
+extern int sha512_impl_set(const char *);
+extern int sha256_mb_impl_set(const char *);
+
+/*
+ * Every implementation which may be compiled in; those which are not, or
+ * which the CPU does not support, are rejected by the *_impl_set() calls.
+ */
+const char	*sha2_impls[] = { "generic", "x86_64", "shani" };
+const char	*sha256_mb_impls[] = { "single", "ssse3", "avx2", "avx512" };
 
 /*
  * Test messages from:
@@ -187,6 +198,61 @@ cmn_err(int level, char *format, ...)
 	va_end(ap);
 }
 
+/*
+ * Hashes messages of a different number of blocks in every lane, fed in
+ * steps which are not a whole number of blocks, and compares the digests
+ * against those of SHA2Update().  Lane 0 stays idle throughout.
+ */
+static boolean_t
+sha256_mb_test(void)
+{
+	static uint8_t	data[SHA256_MB_MAX_LANES][SHA256_MB_MAX_LANES * 192];
+	SHA256_MB_CTX	mbctx;
+	SHA2_CTX	ctx;
+	uint8_t		digests[SHA256_MB_MAX_LANES][SHA256_DIGEST_LENGTH];
+	uint8_t		digest[SHA256_DIGEST_LENGTH];
+	const void	*bufs[SHA256_MB_MAX_LANES];
+	size_t		done = 0, step;
+	boolean_t	failed = B_FALSE;
+	int		l;
+
+	for (l = 0; l < SHA256_MB_MAX_LANES; l++) {
+		for (int i = 0; i < sizeof (data[l]); i++)
+			data[l][i] = (uint8_t)(l * 31 + i);
+	}
+
+	SHA256MBInit(&mbctx, SHA256_MB_MAX_LANES);
+	for (;;) {
+		step = 100;
+		for (l = 0; l < SHA256_MB_MAX_LANES; l++) {
+			if (done < l * 192 && l * 192 - done < step)
+				step = l * 192 - done;
+		}
+		if (done + step > (SHA256_MB_MAX_LANES - 1) * 192)
+			break;
+		for (l = 0; l < SHA256_MB_MAX_LANES; l++)
+			bufs[l] = (done < l * 192) ? &data[l][done] : NULL;
+		SHA256MBUpdate(&mbctx, bufs, step);
+		done += step;
+	}
+	SHA256MBFinal(digests, &mbctx);
+
+	for (l = 0; l < SHA256_MB_MAX_LANES; l++) {
+		SHA2Init(SHA256_MECH_INFO_TYPE, &ctx);
+		SHA2Update(&ctx, data[l], l * 192);
+		SHA2Final(digest, &ctx);
+		if (bcmp(digest, digests[l], sizeof (digest)) != 0) {
+			(void) printf("SHA256-MB   Lane %2d\tResult: FAILED!\n",
+			    l);
+			failed = B_TRUE;
+		}
+	}
+	if (!failed)
+		(void) printf("SHA256-MB   Lanes 0-15\tResult: OK\n");
+
+	return (failed);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -241,25 +307,108 @@ main(int argc, char *argv[])
 		NOTE(CONSTCOND)						\
 	} while (0)
 
-	(void) printf("Running algorithm correctness tests:\n");
-	SHA2_ALGO_TEST(test_msg0, 256, 256, sha256_test_digests[0]);
-	SHA2_ALGO_TEST(test_msg1, 256, 256, sha256_test_digests[1]);
-	SHA2_ALGO_TEST(test_msg0, 384, 384, sha384_test_digests[0]);
-	SHA2_ALGO_TEST(test_msg2, 384, 384, sha384_test_digests[2]);
-	SHA2_ALGO_TEST(test_msg0, 512, 512, sha512_test_digests[0]);
-	SHA2_ALGO_TEST(test_msg2, 512, 512, sha512_test_digests[2]);
-	SHA2_ALGO_TEST(test_msg0, 512_224, 224, sha512_224_test_digests[0]);
-	SHA2_ALGO_TEST(test_msg2, 512_224, 224, sha512_224_test_digests[2]);
-	SHA2_ALGO_TEST(test_msg0, 512_256, 256, sha512_256_test_digests[0]);
-	SHA2_ALGO_TEST(test_msg2, 512_256, 256, sha512_256_test_digests[2]);
+#define	SHA256_MB_PERF_TEST()						\
+	do {								\
+		SHA256_MB_CTX	ctx;					\
+		uint8_t		digests[SHA256_MB_MAX_LANES][32];	\
+		uint8_t		*block = calloc(1, 131072);		\
+		const void	*bufs[SHA256_MB_MAX_LANES];		\
+		uint64_t	delta;					\
+		double		cpb = 0;				\
+		int		i;					\
+		struct timeval	start, end;				\
+		for (i = 0; i < SHA256_MB_MAX_LANES; i++)		\
+			bufs[i] = block;				\
+		(void) gettimeofday(&start, NULL);			\
+		for (i = 0; i < 8192 / SHA256_MB_MAX_LANES; i++) {	\
+			SHA256MBInit(&ctx, SHA256_MB_MAX_LANES);	\
+			SHA256MBUpdate(&ctx, bufs, 131072);		\
+			SHA256MBFinal(digests, &ctx);			\
+		}							\
+		(void) gettimeofday(&end, NULL);			\
+		free(block);						\
+		delta = (end.tv_sec * 1000000llu + end.tv_usec) -	\
+		    (start.tv_sec * 1000000llu + start.tv_usec);	\
+		if (cpu_mhz != 0) {					\
+			cpb = (cpu_mhz * 1e6 * ((double)delta /		\
+			    1000000)) / (8192 * 128 * 1024);		\
+		}							\
+		(void) printf("SHA256-MB   %llu us (%.02f CPB)\n",	\
+		    (u_longlong_t)delta, cpb);				\
+		NOTE(CONSTCOND)						\
+	} while (0)
+
+	sha2_impl_init();
+
+	for (int j = 0; j < sizeof (sha2_impls) / sizeof (sha2_impls[0]); j++) {
+		const char *impl = sha2_impls[j];
+
+		if (sha256_impl_set(impl) == 0) {
+			(void) printf("Running algorithm correctness tests "
+			    "(sha256 %s):\n", impl);
+			SHA2_ALGO_TEST(test_msg0, 256, 256,
+			    sha256_test_digests[0]);
+			SHA2_ALGO_TEST(test_msg1, 256, 256,
+			    sha256_test_digests[1]);
+		}
+
+		if (sha512_impl_set(impl) == 0) {
+			(void) printf("Running algorithm correctness tests "
+			    "(sha512 %s):\n", impl);
+			SHA2_ALGO_TEST(test_msg0, 384, 384,
+			    sha384_test_digests[0]);
+			SHA2_ALGO_TEST(test_msg2, 384, 384,
+			    sha384_test_digests[2]);
+			SHA2_ALGO_TEST(test_msg0, 512, 512,
+			    sha512_test_digests[0]);
+			SHA2_ALGO_TEST(test_msg2, 512, 512,
+			    sha512_test_digests[2]);
+			SHA2_ALGO_TEST(test_msg0, 512_224, 224,
+			    sha512_224_test_digests[0]);
+			SHA2_ALGO_TEST(test_msg2, 512_224, 224,
+			    sha512_224_test_digests[2]);
+			SHA2_ALGO_TEST(test_msg0, 512_256, 256,
+			    sha512_256_test_digests[0]);
+			SHA2_ALGO_TEST(test_msg2, 512_256, 256,
+			    sha512_256_test_digests[2]);
+		}
+	}
+
+	for (int j = 0; j < sizeof (sha256_mb_impls) /
+	    sizeof (sha256_mb_impls[0]); j++) {
+		const char *impl = sha256_mb_impls[j];
+
+		if (sha256_mb_impl_set(impl) == 0) {
+			(void) printf("Running algorithm correctness tests "
+			    "(sha256_mb %s):\n", impl);
+			if (sha256_mb_test())
+				failed = B_TRUE;
+		}
+	}
 
 	if (failed)
 		return (1);
 
-	(void) printf("Running performance tests (hashing 1024 MiB of "
-	    "data):\n");
-	SHA2_PERF_TEST(256, 256);
-	SHA2_PERF_TEST(512, 512);
+	for (int j = 0; j < sizeof (sha2_impls) / sizeof (sha2_impls[0]); j++) {
+		const char *impl = sha2_impls[j];
+
+		(void) printf("Running performance tests (hashing 1024 MiB of "
+		    "data, %s):\n", impl);
+		if (sha256_impl_set(impl) == 0)
+			SHA2_PERF_TEST(256, 256);
+		if (sha512_impl_set(impl) == 0)
+			SHA2_PERF_TEST(512, 512);
+	}
+
+	for (int j = 0; j < sizeof (sha256_mb_impls) /
+	    sizeof (sha256_mb_impls[0]); j++) {
+		const char *impl = sha256_mb_impls[j];
+
+		(void) printf("Running performance tests (hashing 1024 MiB of "
+		    "data, sha256_mb %s):\n", impl);
+		if (sha256_mb_impl_set(impl) == 0)
+			SHA256_MB_PERF_TEST();
+	}
 
 	return (0);
 }